@@ -45,6 +45,13 @@ struct PiiAtomicIntImpl
   int operator-- () { return --i; }
   int operator-- (int) { return i--; }
   int operator-= (int val) { return i -= val; }
+  int exchange(int val) { int iOld = i; i = val; return iOld; }
+  bool compare_exchange_strong(int& expected, int val)
+  {
+    if (i != expected) { expected = i; return false; }
+    i = val;
+    return true;
+  }
   bool operator== (const PiiAtomicIntImpl& other) const { return i == other.i; }
   bool operator!= (const PiiAtomicIntImpl& other) const { return i != other.i; }
   int i;
@@ -66,6 +73,9 @@ public:
   int deref() { return --_value; }
   int load() const { return _value.load(); }
   void store(int value) { _value.store(value); }
+  int loadAcquire() const { return _value.load(); }
+  bool testAndSet(int expected, int value) { return _value.compare_exchange_strong(expected, value); }
+  int fetchAndStore(int value) { return _value.exchange(value); }
 
   int operator++ () { return ++_value; }
   int operator++ (int) { return _value++; }
@@ -112,12 +122,24 @@ public:
 #endif
   }
 
+  int loadAcquire() const
+  {
+#if QT_VERSION >= 0x050000
+    return _value.loadAcquire();
+#else
+    return const_cast<QAtomicInt&>(_value).fetchAndAddAcquire(0);
+#endif
+  }
+
+  bool testAndSet(int expected, int value) { return _value.testAndSetOrdered(expected, value); }
+  int fetchAndStore(int value) { return _value.fetchAndStoreOrdered(value); }
+
   int operator++ () { return _value.fetchAndAddOrdered(1) + 1; }
   int operator++ (int) { return _value.fetchAndAddOrdered(1); }
   int operator-- () { return _value.fetchAndAddOrdered(-1) - 1; }
   int operator-- (int) { return _value.fetchAndAddOrdered(-1); }
   int operator+= (int value) { return _value.fetchAndAddOrdered(value) + value; }
-  int operator-= (int value) { return _value.fetchAndAddOrdered(value) - value; }
+  int operator-= (int value) { return _value.fetchAndAddOrdered(-value) - value; }
 
   bool operator== (const PiiAtomicInt& other) const { return load() == other.load(); }
   bool operator!= (const PiiAtomicInt& other) const { return load() != other.load(); }
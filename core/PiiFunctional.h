@@ -462,6 +462,42 @@ namespace Pii
     return BinaryReverseArgs<Function>(function);
   }
 
+  /**
+   * A unary function that binds the first argument of a binary
+   * function to a constant value. Calling the function with `x`
+   * returns *function*(*value*, `x`). This is an equivalent of
+   * `std::binder1st`, which is not available in all C++ versions.
+   *
+   * ~~~(c++)
+   * // Calculates 1 - x for each element
+   * mat.map(Pii::bindFirst(std::minus<double>(), 1.0));
+   * ~~~
+   */
+  template <class Function>
+  struct BindFirst :
+    public UnaryFunction<typename Function::second_argument_type,
+                         typename Function::result_type>
+  {
+    BindFirst(const Function& function, typename Function::first_argument_type value) :
+      function(function), value(value)
+    {}
+
+    typename Function::result_type operator() (typename Function::second_argument_type b) const
+    {
+      return function(value, b);
+    }
+
+    Function function;
+    typename Function::first_argument_type value;
+  };
+
+  template <class Function>
+  inline BindFirst<Function> bindFirst(const Function& function,
+                                       typename Function::first_argument_type value)
+  {
+    return BindFirst<Function>(function, value);
+  }
+
   /**
    * A unary function (predicate) that always returns `true`.
    */
@@ -943,7 +943,9 @@ namespace Pii
    */
 
 #define MEDIAN_ELEM_SWAP(a,b) { tmp=(a);(a)=(b);(b)=tmp; }
-#define MEDIAN_SORT(a,b) { if ((a)>(b)) MEDIAN_ELEM_SWAP((a),(b)); }
+// Branchless compare-and-swap. Compilers turn qMin/qMax into
+// conditional moves, which avoids mispredictions on noisy data.
+#define MEDIAN_SORT(a,b) { tmp=qMin((a),(b)); (b)=qMax((a),(b)); (a)=tmp; }
 
   template <class Iterator> typename std::iterator_traits<Iterator>::value_type fastMedian(Iterator data, int len)
   {
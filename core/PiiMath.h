@@ -17,6 +17,7 @@
 #define _PIIMATH_H
 
 #include "PiiMatrix.h"
+#include "PiiMatrixMultiply.h"
 #include "PiiTypeTraits.h"
 #include "PiiMathDefs.h"
 #include "PiiFunctional.h"
@@ -2383,7 +2384,9 @@ namespace Pii
 }
 
 /**
- * Matrix multiplication. Returns *mat1* * *mat2*.
+ * Matrix multiplication. Returns *mat1* * *mat2*. Large `float` and
+ * `double` products are calculated with a cache-blocked algorithm
+ * (see Pii::multiplyBlocked()).
  *
  * @exception PiiMathException& if matrix sizes don't match
  */
@@ -2402,6 +2405,8 @@ operator* (const PiiConceptualMatrix<Matrix1>& mat1,
 
   typedef PII_COMBINE_TYPES(typename Matrix1::value_type, typename Matrix2::value_type) T;
   PiiMatrix<T, Matrix1::staticRows, Matrix2::staticColumns> result(PiiMatrix<T>::uninitialized(iRows1, iCols2));
+  if (Pii::multiplyBlocked(m1, m2, result))
+    return result;
   for (int r=0; r<iRows1; ++r)
     {
       T* pRow = result[r];
@@ -0,0 +1,133 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "PiiParallel.h"
+#include "PiiAtomicInt.h"
+
+#ifndef PII_NO_QT
+#  include <QThread>
+#  include <QThreadPool>
+#  include <QRunnable>
+#  include <QSemaphore>
+#endif
+
+PiiParallelTask::~PiiParallelTask()
+{}
+
+#ifndef PII_NO_QT
+namespace
+{
+  // Chunks are handed out to whoever asks first. Pool threads may
+  // still hold a reference to the job after the calling thread has
+  // returned, which is why the job is reference counted.
+  class ParallelJob
+  {
+  public:
+    ParallelJob(PiiParallelTask* task, int count, int chunkCount) :
+      _pTask(task), _iCount(count), _iChunkCount(chunkCount), _iNextChunk(0), _iRefCount(1)
+    {}
+
+    void work()
+    {
+      for (;;)
+        {
+          const int iChunk = _iNextChunk++;
+          if (iChunk >= _iChunkCount)
+            break;
+          _pTask->process(int(qint64(_iCount) * iChunk / _iChunkCount),
+                          int(qint64(_iCount) * (iChunk+1) / _iChunkCount));
+          _finishedChunks.release();
+        }
+    }
+
+    void waitForAll() { _finishedChunks.acquire(_iChunkCount); }
+
+    void ref() { _iRefCount.ref(); }
+    void deref()
+    {
+      if (_iRefCount.deref() == 0)
+        delete this;
+    }
+
+  private:
+    PiiParallelTask* _pTask;
+    int _iCount, _iChunkCount;
+    PiiAtomicInt _iNextChunk, _iRefCount;
+    QSemaphore _finishedChunks;
+  };
+
+  class ParallelRunnable : public QRunnable
+  {
+  public:
+    ParallelRunnable(ParallelJob* job) : _pJob(job) { job->ref(); }
+    ~ParallelRunnable() { _pJob->deref(); }
+
+    void run() { _pJob->work(); }
+
+  private:
+    ParallelJob* _pJob;
+  };
+
+  // A separate pool keeps parallel kernels from competing with
+  // unrelated tasks in QThreadPool::globalInstance().
+  QThreadPool* parallelPool()
+  {
+    static QThreadPool pool;
+    return &pool;
+  }
+}
+#endif
+
+namespace Pii
+{
+  int parallelThreadCount(int threadCount)
+  {
+#ifndef PII_NO_QT
+    if (threadCount <= 0)
+      return qMax(1, QThread::idealThreadCount());
+#endif
+    return qMax(1, threadCount);
+  }
+
+  void runParallel(int count, int chunkCount, PiiParallelTask* task)
+  {
+    chunkCount = qMin(chunkCount, count);
+    if (chunkCount <= 0)
+      return;
+#ifndef PII_NO_QT
+    if (chunkCount > 1)
+      {
+        ParallelJob* pJob = new ParallelJob(task, count, chunkCount);
+        QThreadPool* pPool = parallelPool();
+        for (int i=1; i<chunkCount; ++i)
+          {
+            ParallelRunnable* pRunnable = new ParallelRunnable(pJob);
+            // Don't queue: if no thread is free now, do the work here.
+            if (!pPool->tryStart(pRunnable))
+              {
+                delete pRunnable;
+                break;
+              }
+          }
+        pJob->work();
+        pJob->waitForAll();
+        pJob->deref();
+        return;
+      }
+#endif
+    task->process(0, count);
+  }
+}
@@ -0,0 +1,102 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIIPARALLEL_H
+#define _PIIPARALLEL_H
+
+#include "PiiGlobal.h"
+
+/**
+ * An interface for tasks that can process any subrange of a
+ * sequence independently of the others. See [Pii::runParallel()] and
+ * [Pii::parallelFor()].
+ */
+class PII_CORE_EXPORT PiiParallelTask
+{
+public:
+  virtual ~PiiParallelTask();
+
+  /**
+   * Processes items from `first` up to but not including `last`.
+   * This function is called concurrently from many threads with
+   * non-overlapping ranges. It must not throw exceptions.
+   */
+  virtual void process(int first, int last) = 0;
+};
+
+namespace Pii
+{
+  /**
+   * Returns the number of threads used if `threadCount` threads are
+   * requested. Zero or a negative value means one thread per
+   * processor core. The return value is always at least one.
+   */
+  PII_CORE_EXPORT int parallelThreadCount(int threadCount);
+
+  /**
+   * Divides the range [0, `count`) into `chunkCount` consecutive
+   * chunks of (almost) equal size and calls `task`->process() for
+   * each. The chunks are processed by the calling thread and a
+   * thread pool shared by all parallel tasks in the process. The
+   * function returns once all chunks have been processed.
+   *
+   * Pool threads are only used if they are idle. If the pool is
+   * busy, the calling thread processes the remaining chunks itself.
+   * Therefore, nested parallel calls cannot deadlock, and
+   * `chunkCount` is an upper limit for the number of threads used.
+   */
+  PII_CORE_EXPORT void runParallel(int count, int chunkCount, PiiParallelTask* task);
+
+  /// @internal
+  template <class Function> class ParallelFunctionTask : public PiiParallelTask
+  {
+  public:
+    ParallelFunctionTask(Function function) : _function(function) {}
+    void process(int first, int last) { _function(first, last); }
+
+  private:
+    Function _function;
+  };
+
+  /**
+   * Calls `function`(first, last) in parallel for `chunkCount`
+   * consecutive chunks of the range [0, `count`). `function` must
+   * be thread-safe and must not throw exceptions.
+   *
+   * ~~~(c++)
+   * struct Square
+   * {
+   *   Square(double* data) : pData(data) {}
+   *   void operator() (int first, int last) const
+   *   {
+   *     for (int i=first; i<last; ++i)
+   *       pData[i] *= pData[i];
+   *   }
+   *   double* pData;
+   * };
+   *
+   * QVector<double> vecData(1000000, 2.0);
+   * Pii::parallelFor(vecData.size(), Pii::parallelThreadCount(0), Square(vecData.data()));
+   * ~~~
+   */
+  template <class Function> void parallelFor(int count, int chunkCount, Function function)
+  {
+    ParallelFunctionTask<Function> task(function);
+    runParallel(count, chunkCount, &task);
+  }
+}
+
+#endif //_PIIPARALLEL_H
@@ -0,0 +1,69 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiParker.h"
+
+// Number of times park() checks the permit before going to sleep.
+static const int iSpinCount = 64;
+
+PiiParker::PiiParker() :
+  _iGeneration(0)
+{}
+
+bool PiiParker::park(unsigned long time)
+{
+  for (int i=0; i<iSpinCount; ++i)
+    if (_iPermit.loadAcquire() == 1 && _iPermit.testAndSet(1, 0))
+      return true;
+
+  QMutexLocker lock(&_mutex);
+  // The waiter count must be incremented before checking the permit.
+  // unpark() does the same in reverse order, which ensures that
+  // either we see the permit or unpark() sees us.
+  ++_iWaiters;
+  const int iGeneration = _iGeneration;
+  bool bReleased = true;
+  while (!_iPermit.testAndSet(1, 0) && iGeneration == _iGeneration)
+    {
+      if (!_condition.wait(&_mutex, time))
+        {
+          bReleased = false;
+          break;
+        }
+    }
+  --_iWaiters;
+  return bReleased;
+}
+
+void PiiParker::unpark()
+{
+  _iPermit.fetchAndStore(1);
+  if (_iWaiters.load() > 0)
+    {
+      QMutexLocker lock(&_mutex);
+      _condition.wakeOne();
+    }
+}
+
+void PiiParker::unparkAll()
+{
+  _iPermit.fetchAndStore(0);
+  if (_iWaiters.load() > 0)
+    {
+      QMutexLocker lock(&_mutex);
+      ++_iGeneration;
+      _condition.wakeAll();
+    }
+}
@@ -0,0 +1,96 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIPARKER_H
+#define _PIIPARKER_H
+
+#include <QWaitCondition>
+#include <QMutex>
+#include "PiiAtomicInt.h"
+
+/**
+ * A lightweight replacement for PiiWaitCondition in `NoQueue` mode.
+ * PiiParker holds a single permit. [unpark()] makes the permit
+ * available, and [park()] consumes it, blocking the calling thread
+ * if the permit is not available.
+ *
+ * The difference to PiiWaitCondition is that PiiParker keeps its
+ * state in atomic integers and uses a mutex only if a thread actually
+ * needs to sleep. If nobody is waiting, unpark() is just a single
+ * atomic exchange. Similarly, park() returns immediately without
+ * locking if the permit is available. This makes the class suitable
+ * for hand-off points that are passed thousands of times a second but
+ * seldom block, such as the input queues between operations.
+ *
+ * ~~~(c++)
+ * PiiParker parker;
+ *
+ * // Thread 1
+ * while (!queue.tryPop(obj))
+ *   parker.park();
+ *
+ * // Thread 2
+ * queue.push(obj);
+ * parker.unpark();
+ * ~~~
+ */
+class PII_CORE_EXPORT PiiParker
+{
+public:
+  PiiParker();
+
+  /**
+   * Waits until the permit becomes available and consumes it. If the
+   * permit is already available, returns immediately. Before going
+   * to sleep, the function spins for a short while, because the
+   * permit is often released just a few microseconds later.
+   *
+   * @param time the maximum time to wait in milliseconds. ULONG_MAX
+   * means forever.
+   *
+   * @return `true` if the permit was consumed or [unparkAll()] was
+   * called, `false` on timeout.
+   */
+  bool park(unsigned long time = ULONG_MAX);
+
+  /**
+   * Makes the permit available. If one or more threads are parked,
+   * one of them will be released. Calling this function many times
+   * before park() is the same as calling it once.
+   */
+  void unpark();
+
+  /**
+   * Releases all threads that are currently parked and clears the
+   * permit.
+   */
+  void unparkAll();
+
+  /**
+   * Returns the number of threads currently parked.
+   */
+  int waiterCount() const { return _iWaiters.load(); }
+
+private:
+  PiiAtomicInt _iPermit, _iWaiters;
+  // Incremented by unparkAll(). Protected by _mutex.
+  int _iGeneration;
+  QMutex _mutex;
+  QWaitCondition _condition;
+
+  PII_DISABLE_COPY(PiiParker);
+};
+
+#endif //_PIIPARKER_H
@@ -16,23 +16,92 @@
 #include "PiiReadWriteLock.h"
 
 #include <QThread>
+#include <QThreadStorage>
+#include <QVarLengthArray>
 
 // Note: Similarities to QReadWriteLock are not coincidental.
 
-PiiReadWriteLock::Data::Data(bool recursive) :
+namespace
+{
+  enum { ReaderSlotCount = 32 };
+
+  // The number of read and write locks a thread holds on a
+  // distributed lock.
+  struct HeldLock
+  {
+    const void* pLock;
+    int iReads, iWrites;
+  };
+
+  // Per-thread bookkeeping for locks in DistributedReaders mode.
+  struct ThreadLockState
+  {
+    ThreadLockState(int slot) : iSlot(slot) {}
+
+    HeldLock& find(const void* lock)
+    {
+      for (int i=0; i<lstHeld.size(); ++i)
+        if (lstHeld[i].pLock == lock)
+          return lstHeld[i];
+      HeldLock held = { lock, 0, 0 };
+      lstHeld.append(held);
+      return lstHeld[lstHeld.size()-1];
+    }
+
+    void release(const HeldLock& held)
+    {
+      if (held.iReads != 0 || held.iWrites != 0)
+        return;
+      for (int i=0; i<lstHeld.size(); ++i)
+        if (&lstHeld[i] == &held)
+          {
+            lstHeld.remove(i);
+            return;
+          }
+    }
+
+    const int iSlot;
+    QVarLengthArray<HeldLock, 4> lstHeld;
+  };
+
+  ThreadLockState* threadLockState()
+  {
+    static QThreadStorage<ThreadLockState*> states;
+    static PiiAtomicInt iNextSlot;
+    if (!states.hasLocalData())
+      states.setLocalData(new ThreadLockState((iNextSlot++ & 0x7fffffff) % ReaderSlotCount));
+    return states.localData();
+  }
+}
+
+// Each slot occupies a cache line of its own.
+struct PiiReadWriteLock::ReaderSlot
+{
+  PiiAtomicInt iReaders;
+  char padding[64 - sizeof(PiiAtomicInt)];
+};
+
+PiiReadWriteLock::Data::Data(bool recursive, bool distributed) :
   currentWriter(0),
-  bRecursive(recursive),
+  bRecursive(recursive || distributed),
   iActiveReaders(0),
   iActiveWriters(0),
   iWaitingReaders(0),
-  iWaitingWriters(0)
+  iWaitingWriters(0),
+  pReaderSlots(distributed ? new ReaderSlot[ReaderSlotCount] : 0)
 {}
 
-PiiReadWriteLock::PiiReadWriteLock() : d(new Data(false))
+PiiReadWriteLock::Data::~Data()
+{
+  delete[] pReaderSlots;
+}
+
+PiiReadWriteLock::PiiReadWriteLock() : d(new Data(false, false))
 {
 }
 
-PiiReadWriteLock::PiiReadWriteLock(RecursionMode mode) : d(new Data(mode == Recursive))
+PiiReadWriteLock::PiiReadWriteLock(RecursionMode mode, ReaderMode readerMode) :
+  d(new Data(mode == Recursive, readerMode == DistributedReaders))
 {
 }
 
@@ -43,6 +112,12 @@ PiiReadWriteLock::~PiiReadWriteLock()
 
 void PiiReadWriteLock::lockForRead()
 {
+  if (d->pReaderSlots != 0)
+    {
+      lockForDistributedRead();
+      return;
+    }
+
   QMutexLocker lock(&d->mutex);
 
   Qt::HANDLE self = 0;
@@ -83,6 +158,12 @@ void PiiReadWriteLock::lockForRead()
 
 void PiiReadWriteLock::lockForWrite()
 {
+  if (d->pReaderSlots != 0)
+    {
+      lockForDistributedWrite();
+      return;
+    }
+
   QMutexLocker lock(&d->mutex);
 
   Qt::HANDLE self = 0;
@@ -117,6 +198,12 @@ void PiiReadWriteLock::lockForWrite()
 
 void PiiReadWriteLock::unlockRead()
 {
+  if (d->pReaderSlots != 0)
+    {
+      unlockDistributedRead();
+      return;
+    }
+
   QMutexLocker lock(&d->mutex);
 
   Q_ASSERT(d->iActiveReaders > 0);
@@ -136,6 +223,12 @@ void PiiReadWriteLock::unlockRead()
 
 void PiiReadWriteLock::unlockWrite()
 {
+  if (d->pReaderSlots != 0)
+    {
+      unlockDistributedWrite();
+      return;
+    }
+
   QMutexLocker lock(&d->mutex);
 
   Q_ASSERT(d->iActiveWriters > 0);
@@ -155,3 +248,102 @@ void PiiReadWriteLock::wakeUp()
   else if (d->iWaitingReaders)
     d->readerWait.wakeAll();
 }
+
+/* In DistributedReaders mode, readers increment the counter in their
+ * slot and then check if there are pending writers. Writers first
+ * increment the pending writer count and then check the counters.
+ * Since both use ordered atomic operations, either the reader sees
+ * the writer or the writer sees the reader.
+ */
+void PiiReadWriteLock::lockForDistributedRead()
+{
+  ThreadLockState* pState = threadLockState();
+  HeldLock& held = pState->find(this);
+  PiiAtomicInt& iReaders = d->pReaderSlots[pState->iSlot].iReaders;
+
+  ++iReaders;
+  // A thread that already holds the lock must not wait for pending
+  // writers. Otherwise it would deadlock with them.
+  if (d->iPendingWriters.load() == 0 || held.iReads > 0 || held.iWrites > 0)
+    {
+      ++held.iReads;
+      return;
+    }
+  --iReaders;
+
+  QMutexLocker lock(&d->mutex);
+  // A writer may have seen our transient increment.
+  d->writerWait.wakeAll();
+  while (d->iPendingWriters.load() > 0)
+    {
+      ++d->iWaitingReaders;
+      d->readerWait.wait(&d->mutex);
+      --d->iWaitingReaders;
+    }
+  // Writers can only become pending while holding the mutex.
+  ++iReaders;
+  ++held.iReads;
+}
+
+void PiiReadWriteLock::unlockDistributedRead()
+{
+  ThreadLockState* pState = threadLockState();
+  HeldLock& held = pState->find(this);
+  Q_ASSERT(held.iReads > 0);
+  --held.iReads;
+  pState->release(held);
+
+  --d->pReaderSlots[pState->iSlot].iReaders;
+  if (d->iPendingWriters.load() > 0)
+    {
+      QMutexLocker lock(&d->mutex);
+      d->writerWait.wakeAll();
+    }
+}
+
+void PiiReadWriteLock::lockForDistributedWrite()
+{
+  HeldLock& held = threadLockState()->find(this);
+  if (held.iWrites > 0)
+    {
+      ++held.iWrites;
+      return;
+    }
+
+  QMutexLocker lock(&d->mutex);
+  // Stop new readers from entering.
+  ++d->iPendingWriters;
+  while (d->iActiveWriters > 0)
+    d->writerWait.wait(&d->mutex);
+  // Our own read locks are counted in the slots, too.
+  while (distributedReaderCount() > held.iReads)
+    d->writerWait.wait(&d->mutex);
+
+  ++d->iActiveWriters;
+  ++held.iWrites;
+}
+
+void PiiReadWriteLock::unlockDistributedWrite()
+{
+  ThreadLockState* pState = threadLockState();
+  HeldLock& held = pState->find(this);
+  Q_ASSERT(held.iWrites > 0);
+  if (--held.iWrites > 0)
+    return;
+  pState->release(held);
+
+  QMutexLocker lock(&d->mutex);
+  --d->iActiveWriters;
+  if (--d->iPendingWriters == 0 && d->iWaitingReaders > 0)
+    d->readerWait.wakeAll();
+  // Let the next writer in, if any.
+  d->writerWait.wakeAll();
+}
+
+int PiiReadWriteLock::distributedReaderCount() const
+{
+  int iCount = 0;
+  for (int i=0; i<ReaderSlotCount; ++i)
+    iCount += d->pReaderSlots[i].iReaders.load();
+  return iCount;
+}
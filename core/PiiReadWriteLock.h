@@ -17,6 +17,7 @@
 #define _PIIREADWRITELOCK_H
 
 #include "PiiGlobal.h"
+#include "PiiAtomicInt.h"
 
 #include <QMutex>
 #include <QWaitCondition>
@@ -31,14 +32,29 @@
  * Note that there is no unlock() function. Instead, a read lock must
  * be released with unlockRead() and a write lock with unlockWrite().
  *
+ * By default, all lock operations modify a shared state protected by
+ * a mutex. If the lock is frequently acquired for reading in many
+ * threads simultaneously, the mutex becomes a bottleneck even if
+ * there are no writers. In `DistributedReaders` mode, each thread
+ * registers itself as a reader by incrementing a counter in a slot
+ * of its own. Reading threads never touch the mutex or any memory
+ * location shared with other readers unless a writer is active or
+ * waiting. The price is that writers need to check the counters of
+ * all slots, which makes write locking slower. Locks in
+ * `DistributedReaders` mode are always recursive.
+ *
+ * ~~~(c++)
+ * PiiReadWriteLock lock(PiiReadWriteLock::Recursive, PiiReadWriteLock::DistributedReaders);
+ * ~~~
  */
 class PII_CORE_EXPORT PiiReadWriteLock
 {
 public:
   enum RecursionMode { Recursive, NonRecursive };
+  enum ReaderMode { CentralizedReaders, DistributedReaders };
 
   PiiReadWriteLock();
-  PiiReadWriteLock(RecursionMode mode);
+  PiiReadWriteLock(RecursionMode mode, ReaderMode readerMode = CentralizedReaders);
   ~PiiReadWriteLock();
 
   void lockForRead();
@@ -48,10 +64,12 @@ public:
 
 private:
   typedef QHash<Qt::HANDLE, int> ThreadHash;
+  struct ReaderSlot;
   class Data
   {
   public:
-    Data (bool recursive);
+    Data (bool recursive, bool distributed);
+    ~Data();
 
     QMutex mutex;
     QWaitCondition readerWait, writerWait;
@@ -59,9 +77,17 @@ private:
     Qt::HANDLE currentWriter;
     bool bRecursive;
     int iActiveReaders, iActiveWriters, iWaitingReaders, iWaitingWriters;
+    // Only in DistributedReaders mode
+    ReaderSlot* pReaderSlots;
+    PiiAtomicInt iPendingWriters;
   } *d;
 
   inline void wakeUp();
+  void lockForDistributedRead();
+  void lockForDistributedWrite();
+  void unlockDistributedRead();
+  void unlockDistributedWrite();
+  int distributedReaderCount() const;
 
   PII_DISABLE_COPY(PiiReadWriteLock);
 };
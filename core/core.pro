@@ -14,7 +14,7 @@ qt {
 } else {
   SOURCES += PiiBits.cc PiiColorTable.cc PiiConstCharWrapper.cc PiiException.cc PiiGlobal.cc \
     PiiInvalidArgumentException.cc PiiIOException.cc PiiMath.cc PiiMathException.cc \
-    PiiPtrHolder.cc PiiRandom.cc PiiResourceStatement.cc PiiResourceDatabase.cc \
+    PiiParallel.cc PiiPtrHolder.cc PiiRandom.cc PiiResourceStatement.cc PiiResourceDatabase.cc \
     PiiSharedObject.cc PiiSharedPtr.cc PiiSimpleMemoryManager.cc PiiTimer.cc PiiVariant.cc \
     PiiVersionNumber.cc
   SOURCES += stdwrapper/*.cc matrix/*.cc
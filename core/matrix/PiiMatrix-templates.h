@@ -193,15 +193,11 @@ PiiMatrix<T>& PiiMatrix<T,-1,-1>::operator= (const PiiConceptualMatrix<Matrix>&
     {
       PiiMatrix matCopy(PiiMatrixData::createUninitializedData(other.self()->rows(), other.self()->columns(),
                                                                other.self()->columns() * sizeof(T)));
-      Pii::transform(other.self()->begin(), other.self()->end(), matCopy.begin(),
-                     Pii::Cast<typename Matrix::value_type,T>());
+      Pii::transformRows(*other.self(), matCopy, Pii::Cast<typename Matrix::value_type,T>());
       *this = matCopy;
     }
   else
-    {
-      Pii::transform(other.self()->begin(), other.self()->end(), begin(),
-                     Pii::Cast<typename Matrix::value_type,T>());
-    }
+    Pii::transformRows(*other.self(), *this, Pii::Cast<typename Matrix::value_type,T>());
   return *this;
 }
 
@@ -185,9 +185,16 @@ public:
    * rows. The stride may be different from sizeof(datatype) *
    * columns() for two reasons:
    *
-   * - Matrix rows are aligned to four-byte boundaries. For example,
-   * if the data type is `char`, and the matrix has three columns
-   * (three bytes per row), *stride* will be four.
+   * - Matrix rows are aligned. Rows narrower than
+   * PiiMatrixAllocator::alignment() (64 bytes by default) are aligned
+   * to four-byte boundaries. For example, if the data type is `char`,
+   * and the matrix has three columns (three bytes per row), *stride*
+   * will be four. Wider rows are aligned to the full alignment: a
+   * `char` matrix with 100 columns has a stride of 128. Note that
+   * older versions always used four-byte alignment. Code that assumes
+   * `stride() == (columns() * sizeof(T) + 3) & ~3` must either use
+   * stride() or disable row alignment with
+   * PiiMatrixAllocator::setRowAlignmentEnabled().
    *
    * - The matrix references external data. In this case the stride
    * may be anything, but always larger than or equal to the number of
@@ -299,6 +306,27 @@ template <class T> struct PiiMatrixTraits<PiiMatrix<T,-1,-1> >
  * PiiInvalidArgumentException if the sizes of two matrices do not
  * match for calculation.
  *
+ * Element-wise operators never create temporary matrices. Instead,
+ * they return lightweight transforms (PiiUnaryMatrixTransform,
+ * PiiBinaryMatrixTransform) that refer to their operands. A chain of
+ * operations is evaluated in a single pass, one row at a time, once
+ * the result is assigned to a matrix. A scalar operand is converted
+ * to the element type of the matrix, and the calculation is
+ * performed in that type. To calculate in a wider type, convert the
+ * matrix lazily with [cast()].
+ *
+ * ~~~(c++)
+ * PiiMatrix<unsigned char> image(480, 640);
+ * PiiMatrix<float> background(480, 640);
+ * // One pass, no temporaries. The expression is evaluated as float.
+ * PiiMatrix<float> normalized((image.cast<float>() - 128) * 0.0078125f + background);
+ * // Evaluated as unsigned char: image - 128 wraps around.
+ * PiiMatrix<unsigned char> shifted(image - 128);
+ * ~~~
+ *
+ * Since the transforms only store references, an unevaluated
+ * expression must not outlive the statement it was created in.
+ *
  * The data within a matrix is organized so that the items in a row
  * (scan line) always occupy adjacent memory locations. The pointer to
  * the beginning to each row is returned by [row(int)]. Each row is
@@ -374,8 +402,7 @@ public:
                                                              other.self()->columns(),
                                                              other.self()->columns() * sizeof(T)))
   {
-    Pii::transform(other.self()->begin(), other.self()->end(), begin(),
-                   Pii::Cast<typename Matrix::value_type,T>());
+    Pii::transformRows(*other.self(), *this, Pii::Cast<typename Matrix::value_type,T>());
   }
 
   /**
@@ -0,0 +1,459 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "PiiMatrixAllocator.h"
+
+#include <PiiAtomicInt.h>
+#include <PiiSynchronized.h>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QList>
+#include <cstdlib>
+
+#ifndef PII_NO_QT
+#  include <QThreadStorage>
+#endif
+
+namespace
+{
+  enum
+  {
+    MinBlockShift = 6,
+    MaxBlockShift = 28,
+    StepsPerShift = 8,
+    SizeClassCount = (MaxBlockShift - MinBlockShift) * StepsPerShift + 1,
+    ThreadCacheBlocks = 4,
+    ThreadCacheBytes = 4 << 20
+  };
+
+  enum Counter
+  {
+    AllocationCounter,
+    PoolHitCounter,
+    SystemAllocationCounter,
+    ReleaseCounter,
+    CounterCount
+  };
+
+  // Released blocks are chained through their first bytes.
+  struct FreeBlock
+  {
+    FreeBlock* pNext;
+  };
+
+  // Returns the size class of a block of the given size and stores
+  // the size of the class to *classSize*. Returns -1 for blocks that
+  // are too large to be pooled.
+  int sizeClass(std::size_t bytes, std::size_t* classSize)
+  {
+    if (bytes <= (std::size_t(1) << MinBlockShift))
+      {
+        *classSize = std::size_t(1) << MinBlockShift;
+        return 0;
+      }
+    // bytes is in (2^iShift, 2^(iShift+1)]
+    int iShift = 0;
+    for (std::size_t i = bytes - 1; i >>= 1; ) ++iShift;
+    if (iShift >= MaxBlockShift)
+      {
+        *classSize = bytes;
+        return -1;
+      }
+    const std::size_t iBase = std::size_t(1) << iShift, iStep = iBase / StepsPerShift;
+    const std::size_t iSteps = (bytes - iBase + iStep - 1) / iStep;
+    *classSize = iBase + iSteps * iStep;
+    return (iShift - MinBlockShift) * StepsPerShift + int(iSteps);
+  }
+
+  std::size_t classSize(int sizeClass)
+  {
+    if (sizeClass <= 0)
+      return sizeClass == 0 ? std::size_t(1) << MinBlockShift : 0;
+    const int iShift = (sizeClass - 1) / StepsPerShift + MinBlockShift;
+    const std::size_t iBase = std::size_t(1) << iShift;
+    return iBase + std::size_t((sizeClass - 1) % StepsPerShift + 1) * (iBase / StepsPerShift);
+  }
+}
+
+class PiiMatrixAllocator::Data
+{
+public:
+  Data() :
+    iAlignment(64),
+    bPoolingEnabled(true),
+    bRowAlignmentEnabled(true),
+    iGeneration(0),
+    lPoolCapacity(qint64(256) << 20),
+    lPooledBytes(0),
+    iPooledBlocks(0)
+  {
+    for (int i=0; i<SizeClassCount; ++i)
+      apPool[i] = 0;
+    for (int i=0; i<CounterCount; ++i)
+      aiFinishedCounters[i] = aiCounterBase[i] = 0;
+  }
+
+  // Takes a block from the shared pool or returns 0.
+  void* take(int sizeClass)
+  {
+    QMutexLocker lock(&mutex);
+    FreeBlock* pBlock = apPool[sizeClass];
+    if (pBlock != 0)
+      {
+        apPool[sizeClass] = pBlock->pNext;
+        lPooledBytes -= classSize(sizeClass);
+        --iPooledBlocks;
+      }
+    return pBlock;
+  }
+
+  // Puts a block to the shared pool or releases it if the pool is full.
+  void put(void* block, int sizeClass)
+  {
+    const std::size_t iSize = classSize(sizeClass);
+    synchronized (&mutex)
+      {
+        if (bPoolingEnabled && lPooledBytes + qint64(iSize) <= lPoolCapacity)
+          {
+            FreeBlock* pBlock = static_cast<FreeBlock*>(block);
+            pBlock->pNext = apPool[sizeClass];
+            apPool[sizeClass] = pBlock;
+            lPooledBytes += iSize;
+            ++iPooledBlocks;
+            return;
+          }
+      }
+    std::free(block);
+  }
+
+  void clear()
+  {
+    // Makes all thread caches release their blocks the next time
+    // they are used.
+    ++iGeneration;
+    QMutexLocker lock(&mutex);
+    for (int i=0; i<SizeClassCount; ++i)
+      {
+        while (FreeBlock* pBlock = apPool[i])
+          {
+            apPool[i] = pBlock->pNext;
+            std::free(pBlock);
+          }
+      }
+    lPooledBytes = 0;
+    iPooledBlocks = 0;
+  }
+
+  // Returns the current value of a statistics counter. Must be
+  // called with mutex locked.
+  int counter(int index) const;
+
+  volatile std::size_t iAlignment;
+  volatile bool bPoolingEnabled, bRowAlignmentEnabled;
+  PiiAtomicInt iGeneration;
+  // Counts allocations by threads that have no cache.
+  PiiAtomicInt aiSharedCounters[CounterCount];
+
+  QMutex mutex;
+  qint64 lPoolCapacity, lPooledBytes;
+  int iPooledBlocks;
+  FreeBlock* apPool[SizeClassCount];
+  // Thread caches in existence, the summed counters of finished
+  // threads and the counter values at the last resetStatistics().
+  QList<ThreadCache*> lstCaches;
+  int aiFinishedCounters[CounterCount];
+  int aiCounterBase[CounterCount];
+};
+
+// A per-thread cache of released blocks. Only the owner thread
+// modifies the cache. Statistics are counted here as well so that
+// allocations don't touch shared memory.
+class PiiMatrixAllocator::ThreadCache
+{
+public:
+  ThreadCache() : iBytes(0)
+  {
+    for (int i=0; i<SizeClassCount; ++i)
+      {
+        apBlocks[i] = 0;
+        aiCounts[i] = 0;
+      }
+    for (int i=0; i<CounterCount; ++i)
+      aiCounters[i] = 0;
+    Data* d = PiiMatrixAllocator::data();
+    iGeneration = d->iGeneration.load();
+    synchronized (&d->mutex) d->lstCaches << this;
+  }
+
+  ~ThreadCache()
+  {
+    flush();
+    Data* d = PiiMatrixAllocator::data();
+    synchronized (&d->mutex)
+      {
+        d->lstCaches.removeAt(d->lstCaches.indexOf(this));
+        for (int i=0; i<CounterCount; ++i)
+          d->aiFinishedCounters[i] += aiCounters[i];
+      }
+  }
+
+  void* take(int sizeClass)
+  {
+    FreeBlock* pBlock = apBlocks[sizeClass];
+    if (pBlock != 0)
+      {
+        apBlocks[sizeClass] = pBlock->pNext;
+        --aiCounts[sizeClass];
+        iBytes -= classSize(sizeClass);
+      }
+    return pBlock;
+  }
+
+  bool put(void* block, int sizeClass)
+  {
+    const std::size_t iSize = classSize(sizeClass);
+    if (aiCounts[sizeClass] >= ThreadCacheBlocks || iBytes + iSize > std::size_t(ThreadCacheBytes))
+      return false;
+    FreeBlock* pBlock = static_cast<FreeBlock*>(block);
+    pBlock->pNext = apBlocks[sizeClass];
+    apBlocks[sizeClass] = pBlock;
+    ++aiCounts[sizeClass];
+    iBytes += iSize;
+    return true;
+  }
+
+  // Moves all cached blocks to the shared pool.
+  void flush()
+  {
+    if (iBytes == 0)
+      return;
+    Data* d = PiiMatrixAllocator::data();
+    for (int i=0; i<SizeClassCount; ++i)
+      while (void* pBlock = take(i))
+        d->put(pBlock, i);
+  }
+
+  // Returns all cached blocks to the system if the shared pool has
+  // been cleared since the last call.
+  void trim(Data* d)
+  {
+    const int iCurrentGeneration = d->iGeneration.load();
+    if (iCurrentGeneration == iGeneration)
+      return;
+    iGeneration = iCurrentGeneration;
+    for (int i=0; i<SizeClassCount; ++i)
+      while (void* pBlock = take(i))
+        std::free(pBlock);
+  }
+
+  std::size_t iBytes;
+  int iGeneration;
+  // Read by other threads without synchronization. The values may
+  // be slightly out of date.
+  volatile int aiCounters[CounterCount];
+
+private:
+  FreeBlock* apBlocks[SizeClassCount];
+  int aiCounts[SizeClassCount];
+};
+
+int PiiMatrixAllocator::Data::counter(int index) const
+{
+  int iValue = aiSharedCounters[index].load() + aiFinishedCounters[index];
+  for (int i=0; i<lstCaches.size(); ++i)
+    iValue += lstCaches[i]->aiCounters[index];
+  return iValue;
+}
+
+PiiMatrixAllocator::Data* PiiMatrixAllocator::data()
+{
+  // Never deleted because thread caches may be flushed during static
+  // destruction.
+  static Data* pData = new Data;
+  return pData;
+}
+
+PiiMatrixAllocator::ThreadCache* PiiMatrixAllocator::threadCache()
+{
+#ifndef PII_NO_QT
+  static QThreadStorage<ThreadCache*> caches;
+  if (!caches.hasLocalData())
+    caches.setLocalData(new ThreadCache);
+  return caches.localData();
+#else
+  return 0;
+#endif
+}
+
+namespace
+{
+  template <class Cache, class Data> inline void count(Cache* cache, Data* d, int counter)
+  {
+    if (cache != 0)
+      ++cache->aiCounters[counter];
+    else
+      ++d->aiSharedCounters[counter];
+  }
+}
+
+void* PiiMatrixAllocator::allocate(std::size_t bytes, int* sizeClass)
+{
+  Data* d = data();
+  ThreadCache* pCache = threadCache();
+  count(pCache, d, AllocationCounter);
+
+  std::size_t iClassSize;
+  *sizeClass = d->bPoolingEnabled ? ::sizeClass(bytes, &iClassSize) : -1;
+  if (*sizeClass == -1)
+    {
+      count(pCache, d, SystemAllocationCounter);
+      return std::malloc(bytes);
+    }
+
+  void* pBlock = 0;
+  if (pCache != 0)
+    {
+      pCache->trim(d);
+      pBlock = pCache->take(*sizeClass);
+    }
+  if (pBlock == 0)
+    pBlock = d->take(*sizeClass);
+  if (pBlock != 0)
+    {
+      count(pCache, d, PoolHitCounter);
+      return pBlock;
+    }
+  count(pCache, d, SystemAllocationCounter);
+  return std::malloc(iClassSize);
+}
+
+void PiiMatrixAllocator::release(void* block, int sizeClass)
+{
+  if (block == 0)
+    return;
+  Data* d = data();
+  ThreadCache* pCache = threadCache();
+  count(pCache, d, ReleaseCounter);
+  if (sizeClass == -1)
+    {
+      std::free(block);
+      return;
+    }
+
+  if (!d->bPoolingEnabled)
+    {
+      // Pooling was disabled after the block was allocated.
+      if (pCache != 0)
+        pCache->flush();
+      std::free(block);
+      return;
+    }
+  if (pCache != 0)
+    {
+      pCache->trim(d);
+      if (pCache->put(block, sizeClass))
+        return;
+    }
+  d->put(block, sizeClass);
+}
+
+std::size_t PiiMatrixAllocator::blockSize(int sizeClass)
+{
+  return classSize(sizeClass);
+}
+
+void PiiMatrixAllocator::setAlignment(std::size_t alignment)
+{
+  std::size_t iAlignment = 8;
+  while (iAlignment < alignment)
+    iAlignment <<= 1;
+  data()->iAlignment = iAlignment;
+}
+
+std::size_t PiiMatrixAllocator::alignment()
+{
+  return data()->iAlignment;
+}
+
+void PiiMatrixAllocator::setPoolingEnabled(bool poolingEnabled)
+{
+  data()->bPoolingEnabled = poolingEnabled;
+  if (!poolingEnabled)
+    {
+      ThreadCache* pCache = threadCache();
+      if (pCache != 0)
+        pCache->flush();
+      data()->clear();
+    }
+}
+
+bool PiiMatrixAllocator::isPoolingEnabled()
+{
+  return data()->bPoolingEnabled;
+}
+
+void PiiMatrixAllocator::setRowAlignmentEnabled(bool rowAlignmentEnabled)
+{
+  data()->bRowAlignmentEnabled = rowAlignmentEnabled;
+}
+
+bool PiiMatrixAllocator::isRowAlignmentEnabled()
+{
+  return data()->bRowAlignmentEnabled;
+}
+
+void PiiMatrixAllocator::setPoolCapacity(qint64 poolCapacity)
+{
+  synchronized (&data()->mutex) data()->lPoolCapacity = poolCapacity;
+}
+
+qint64 PiiMatrixAllocator::poolCapacity()
+{
+  QMutexLocker lock(&data()->mutex);
+  return data()->lPoolCapacity;
+}
+
+PiiMatrixAllocator::Statistics PiiMatrixAllocator::statistics()
+{
+  Data* d = data();
+  Statistics result;
+  QMutexLocker lock(&d->mutex);
+  result.iAllocations = d->counter(AllocationCounter) - d->aiCounterBase[AllocationCounter];
+  result.iPoolHits = d->counter(PoolHitCounter) - d->aiCounterBase[PoolHitCounter];
+  result.iSystemAllocations = d->counter(SystemAllocationCounter) - d->aiCounterBase[SystemAllocationCounter];
+  result.iReleases = d->counter(ReleaseCounter) - d->aiCounterBase[ReleaseCounter];
+  result.iPooledBlocks = d->iPooledBlocks;
+  result.lPooledBytes = d->lPooledBytes;
+  return result;
+}
+
+void PiiMatrixAllocator::resetStatistics()
+{
+  // Counters owned by other threads are never written to. Instead,
+  // the current values are stored as a base level.
+  Data* d = data();
+  QMutexLocker lock(&d->mutex);
+  for (int i=0; i<CounterCount; ++i)
+    d->aiCounterBase[i] = d->counter(i);
+}
+
+void PiiMatrixAllocator::clear()
+{
+  ThreadCache* pCache = threadCache();
+  if (pCache != 0)
+    pCache->flush();
+  data()->clear();
+}
@@ -0,0 +1,164 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIIMATRIXALLOCATOR_H
+#define _PIIMATRIXALLOCATOR_H
+
+#include <PiiGlobal.h>
+#include <cstddef>
+
+/**
+ * Memory allocator for matrix data. All memory for PiiMatrix
+ * instances is allocated through this class. The allocator has two
+ * tasks:
+ *
+ * - Align matrix data so that it can be efficiently accessed with
+ *   SIMD instructions. The first element of each internally
+ *   allocated matrix and, for rows at least [alignment()] bytes
+ *   wide, the first element of each row will be aligned to an
+ *   [alignment()] boundary.
+ *
+ * - Recycle memory blocks. Image processing pipelines allocate and
+ *   release buffers of the same size repeatedly. Released blocks
+ *   are stored in size-class pools and reused. Each thread has a
+ *   small cache of its own, which makes allocating and releasing
+ *   most blocks lock-free. Blocks that don't fit in a thread's cache
+ *   are moved to a shared pool. Blocks that don't fit in the shared
+ *   pool either are returned to the system.
+ *
+ * Block sizes are rounded up to the closest size class. There are
+ * eight size classes between successive powers of two, which wastes
+ * at most 12.5% of memory. Blocks larger than 256 MB are never
+ * pooled.
+ *
+ * ~~~(c++)
+ * // Use plain malloc() and free().
+ * PiiMatrixAllocator::setPoolingEnabled(false);
+ * // Align to 32-byte boundaries.
+ * PiiMatrixAllocator::setAlignment(32);
+ * ~~~
+ *
+ * @internal
+ */
+class PII_CORE_EXPORT PiiMatrixAllocator
+{
+public:
+  /**
+   * Allocation statistics.
+   */
+  struct Statistics
+  {
+    /// The total number of allocated blocks.
+    int iAllocations;
+    /// The number of blocks allocated from the pools.
+    int iPoolHits;
+    /// The number of blocks allocated from the system.
+    int iSystemAllocations;
+    /// The total number of released blocks.
+    int iReleases;
+    /// The number of blocks currently in the shared pool.
+    int iPooledBlocks;
+    /// The number of bytes currently in the shared pool.
+    qint64 lPooledBytes;
+  };
+
+  /**
+   * Allocates a block of at least *bytes* bytes. The returned block
+   * is aligned at least as malloc() would align it. Stores the size
+   * class of the block to *sizeClass*, which must be passed to
+   * [release()].
+   */
+  static void* allocate(std::size_t bytes, int* sizeClass);
+
+  /**
+   * Releases a *block* allocated with [allocate()].
+   */
+  static void release(void* block, int sizeClass);
+
+  /**
+   * Returns the number of bytes that can be stored in a block of the
+   * given size class. Returns zero if *sizeClass* is not pooled.
+   */
+  static std::size_t blockSize(int sizeClass);
+
+  /**
+   * Sets the alignment of matrix data. Must be a power of two and at
+   * least eight. Other values will be rounded up to the next valid
+   * alignment. The default is 64, which matches the cache line size
+   * and the widest SIMD registers on current processors. The setting
+   * only affects matrices allocated after the change.
+   */
+  static void setAlignment(std::size_t alignment);
+  static std::size_t alignment();
+
+  /**
+   * Enables or disables row alignment. If row alignment is enabled
+   * (the default), the stride of matrices whose rows are at least
+   * [alignment()] bytes wide is rounded up to a multiple of
+   * [alignment()]. This changes the memory layout compared to older
+   * versions, which always rounded the stride up to a multiple of
+   * four bytes. If row alignment is disabled, the old layout will be
+   * used, and only the first row will be aligned. The setting only
+   * affects matrices allocated after the change.
+   */
+  static void setRowAlignmentEnabled(bool rowAlignmentEnabled);
+  static bool isRowAlignmentEnabled();
+
+  /**
+   * Enables or disables pooling. If pooling is disabled, memory is
+   * allocated and released with malloc() and free(). Disabling
+   * pooling releases pooled blocks to the system. Pooling is enabled
+   * by default.
+   */
+  static void setPoolingEnabled(bool poolingEnabled);
+  static bool isPoolingEnabled();
+
+  /**
+   * Sets the maximum number of bytes retained in the shared pool.
+   * The default is 256 MB. Thread caches are not included, but
+   * each of them holds at most 4 MB.
+   */
+  static void setPoolCapacity(qint64 poolCapacity);
+  static qint64 poolCapacity();
+
+  /**
+   * Returns allocation statistics. Each thread counts its own
+   * allocations, and the counters of threads other than the calling
+   * one may be slightly out of date.
+   */
+  static Statistics statistics();
+
+  /**
+   * Resets all counters in allocation statistics.
+   */
+  static void resetStatistics();
+
+  /**
+   * Returns all blocks in the shared pool to the system. Blocks in
+   * the cache of the calling thread are released immediately, and
+   * those in the caches of other threads next time the threads
+   * allocate or release memory.
+   */
+  static void clear();
+
+private:
+  class Data;
+  class ThreadCache;
+  static Data* data();
+  static ThreadCache* threadCache();
+};
+
+#endif //_PIIMATRIXALLOCATOR_H
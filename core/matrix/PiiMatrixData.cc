@@ -14,6 +14,7 @@
  */
 
 #include "PiiMatrixData.h"
+#include <PiiBits.h>
 #include <cstdlib>
 #include <cstring>
 #include <new>
@@ -26,18 +27,48 @@ PiiMatrixData* PiiMatrixData::sharedNull()
 
 PiiMatrixData* PiiMatrixData::allocate(int rows, int columns, std::size_t stride)
 {
-  void* bfr = std::malloc(headerSize() + rows * stride);
-  return new (bfr) PiiMatrixData(rows, columns, stride);
+  // The header is placed right before the data buffer, which must be
+  // aligned.
+  const std::size_t iAlignMask = PiiMatrixAllocator::alignment() - 1;
+  int iSizeClass;
+  char* pBlock = static_cast<char*>(PiiMatrixAllocator::allocate(headerSize() + iAlignMask + rows * stride,
+                                                                 &iSizeClass));
+  char* pBuffer = Pii::alignAddress(pBlock + headerSize(), iAlignMask);
+  PiiMatrixData* pData = new (pBuffer - headerSize()) PiiMatrixData(rows, columns, stride);
+  pData->pBlock = pBlock;
+  pData->iSizeClass = iSizeClass;
+  return pData;
 }
 
 PiiMatrixData* PiiMatrixData::reallocate(PiiMatrixData* d, int rows)
 {
-  // This may move the contents of d into a new memory location
-  d = static_cast<PiiMatrixData*>(std::realloc(d, headerSize() + rows * d->iStride));
-  // If the data buffer is internal, we need to fix the data pointer
+  // The block may already be large enough.
+  const std::size_t iBufferOffset = d->bufferAddress() - static_cast<char*>(d->pBlock);
+  if (iBufferOffset + rows * d->iStride <= PiiMatrixAllocator::blockSize(d->iSizeClass))
+    {
+      if (d->bufferType == InternalBuffer)
+        d->pBuffer = d->bufferAddress();
+      return d;
+    }
+
+  PiiMatrixData* pData = allocate(rows, d->iColumns, d->iStride);
+  pData->iRefCount = d->iRefCount.load();
+  pData->iLastRef = d->iLastRef;
+  pData->iRows = d->iRows;
+  pData->iCapacity = d->iCapacity;
+  pData->bufferType = d->bufferType;
+  pData->pSourceData = d->pSourceData;
+  // If the data buffer is internal, we need to move the contents.
   if (d->bufferType == InternalBuffer)
-    d->pBuffer = d->bufferAddress();
-  return d;
+    {
+      pData->pBuffer = pData->bufferAddress();
+      if (d->pBuffer != 0)
+        std::memcpy(pData->pBuffer, d->pBuffer, qMin(d->iRows, rows) * d->iStride);
+    }
+  else
+    pData->pBuffer = d->pBuffer;
+  PiiMatrixAllocator::release(d->pBlock, d->iSizeClass);
+  return pData;
 }
 
 void PiiMatrixData::destroy()
@@ -46,7 +77,7 @@ void PiiMatrixData::destroy()
     std::free(pBuffer);
   else if (pSourceData != 0)
     pSourceData->release();
-  std::free(this);
+  PiiMatrixAllocator::release(pBlock, iSizeClass);
 }
 
 PiiMatrixData* PiiMatrixData::createUninitializedData(int rows, int columns, std::size_t bytesPerRow, std::size_t stride)
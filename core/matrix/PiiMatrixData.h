@@ -18,6 +18,7 @@
 
 #include <PiiGlobal.h>
 #include <PiiAtomicInt.h>
+#include "PiiMatrixAllocator.h"
 
 /// @internal
 struct PII_CORE_EXPORT PiiMatrixData
@@ -34,7 +35,9 @@ struct PII_CORE_EXPORT PiiMatrixData
     iCapacity(0),
     bufferType(InternalBuffer),
     pSourceData(0),
-    pBuffer(0)
+    pBuffer(0),
+    pBlock(0),
+    iSizeClass(-1)
   {}
 
   PiiMatrixData(int rows, int columns, std::size_t stride) :
@@ -46,7 +49,9 @@ struct PII_CORE_EXPORT PiiMatrixData
     iCapacity(rows),
     bufferType(InternalBuffer),
     pSourceData(0),
-    pBuffer(0)
+    pBuffer(0),
+    pBlock(0),
+    iSizeClass(-1)
   {}
 
   PiiAtomicInt iRefCount;
@@ -65,12 +70,24 @@ struct PII_CORE_EXPORT PiiMatrixData
   PiiMatrixData* pSourceData;
   // Points to the first element of the matrix.
   void* pBuffer;
+  // The memory block this structure lives in, and its size class
+  // (see PiiMatrixAllocator).
+  void* pBlock;
+  int iSizeClass;
 
   void* row(int index) { return static_cast<char*>(pBuffer) + iStride * index; }
   const void* row(int index) const { return static_cast<const char*>(pBuffer) + iStride * index; }
 
-  // Aligns row width to a four-byte boundary
-  static std::size_t alignedWidth(std::size_t bytes) { return (bytes + 3) & ~3; }
+  // Aligns row width to PiiMatrixAllocator::alignment(). Rows
+  // narrower than that, and all rows if row alignment is disabled,
+  // are aligned to a four-byte boundary to avoid wasting memory.
+  static std::size_t alignedWidth(std::size_t bytes)
+  {
+    const std::size_t iAlignment = PiiMatrixAllocator::alignment();
+    if (bytes < iAlignment || !PiiMatrixAllocator::isRowAlignmentEnabled())
+      return (bytes + 3) & ~std::size_t(3);
+    return (bytes + iAlignment - 1) & ~(iAlignment - 1);
+  }
   // Returns the size of this structure rounded up to closest multiple of 8.
   static std::size_t headerSize() { return (sizeof(PiiMatrixData) + 7) & ~7; }
   // Returns a pointer to the beginning of an internally allocated buffer.
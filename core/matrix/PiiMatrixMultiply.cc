@@ -0,0 +1,295 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "PiiMatrixMultiply.h"
+
+#include <cstring>
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+#include <PiiParallel.h>
+
+namespace
+{
+  // Block sizes. A KC-by-NC block of B is packed once per KC-wide
+  // slice and reused for all rows. An MC-by-KC block of A (less than
+  // 256 kB of doubles) stays in L2 cache while it is multiplied by
+  // the packed B.
+  enum { MC = 128, KC = 256, NC = 2048 };
+
+  // The number of multiply-adds each thread should do at least.
+  const double dMinOperationsPerThread = 1 << 23;
+
+  template <class T> struct Tile;
+  // Register tile sizes. A full tile of C is kept in eight SSE
+  // registers.
+  template <> struct Tile<float> { enum { MR = 4, NR = 8 }; };
+  template <> struct Tile<double> { enum { MR = 4, NR = 4 }; };
+
+  template <class T> inline const T* rowAt(const T* ptr, std::size_t stride, int row)
+  {
+    return reinterpret_cast<const T*>(reinterpret_cast<const char*>(ptr) + stride * row);
+  }
+
+  template <class T> inline T* rowAt(T* ptr, std::size_t stride, int row)
+  {
+    return reinterpret_cast<T*>(reinterpret_cast<char*>(ptr) + stride * row);
+  }
+
+  // Packs an mc-by-kc block of A into MR-row slivers. In each sliver,
+  // the MR elements of a column are stored next to each other. Rows
+  // beyond mc are filled with zeros.
+  template <class T> void packA(int mc, int kc, const T* a, std::size_t stride, T* packed)
+  {
+    const int MR = Tile<T>::MR;
+    for (int i=0; i<mc; i += MR)
+      {
+        const int iRows = qMin(int(MR), mc - i);
+        for (int r=0; r<iRows; ++r)
+          {
+            const T* pRow = rowAt(a, stride, i + r);
+            for (int p=0; p<kc; ++p)
+              packed[p*MR + r] = pRow[p];
+          }
+        for (int r=iRows; r<MR; ++r)
+          for (int p=0; p<kc; ++p)
+            packed[p*MR + r] = 0;
+        packed += kc * MR;
+      }
+  }
+
+  // Packs a kc-by-nc block of B into NR-column slivers. Columns
+  // beyond nc are filled with zeros.
+  template <class T> void packB(int kc, int nc, const T* b, std::size_t stride, T* packed)
+  {
+    const int NR = Tile<T>::NR;
+    for (int j=0; j<nc; j += NR)
+      {
+        const int iColumns = qMin(int(NR), nc - j);
+        for (int p=0; p<kc; ++p)
+          {
+            const T* pRow = rowAt(b, stride, p) + j;
+            T* pTarget = packed + p*NR;
+            int c=0;
+            for (; c<iColumns; ++c) pTarget[c] = pRow[c];
+            for (; c<NR; ++c) pTarget[c] = 0;
+          }
+        packed += kc * NR;
+      }
+  }
+
+  // Multiplies an MR-by-kc sliver of A by a kc-by-NR sliver of B and
+  // stores the result to tile.
+  template <class T> inline void multiplyTile(int kc, const T* a, const T* b, T* tile)
+  {
+    const int MR = Tile<T>::MR, NR = Tile<T>::NR;
+    T aSums[MR][NR];
+    for (int i=0; i<MR; ++i)
+      for (int j=0; j<NR; ++j)
+        aSums[i][j] = 0;
+    for (int p=0; p<kc; ++p, a += MR, b += NR)
+      for (int i=0; i<MR; ++i)
+        for (int j=0; j<NR; ++j)
+          aSums[i][j] += a[i] * b[j];
+    std::memcpy(tile, aSums, sizeof(aSums));
+  }
+
+#ifdef __SSE2__
+  template <> inline void multiplyTile<double>(int kc, const double* a, const double* b, double* tile)
+  {
+    __m128d c00 = _mm_setzero_pd(), c01 = _mm_setzero_pd(),
+      c10 = _mm_setzero_pd(), c11 = _mm_setzero_pd(),
+      c20 = _mm_setzero_pd(), c21 = _mm_setzero_pd(),
+      c30 = _mm_setzero_pd(), c31 = _mm_setzero_pd();
+    for (int p=0; p<kc; ++p, a += 4, b += 4)
+      {
+        const __m128d b0 = _mm_loadu_pd(b), b1 = _mm_loadu_pd(b + 2);
+        __m128d ai = _mm_set1_pd(a[0]);
+        c00 = _mm_add_pd(c00, _mm_mul_pd(ai, b0)); c01 = _mm_add_pd(c01, _mm_mul_pd(ai, b1));
+        ai = _mm_set1_pd(a[1]);
+        c10 = _mm_add_pd(c10, _mm_mul_pd(ai, b0)); c11 = _mm_add_pd(c11, _mm_mul_pd(ai, b1));
+        ai = _mm_set1_pd(a[2]);
+        c20 = _mm_add_pd(c20, _mm_mul_pd(ai, b0)); c21 = _mm_add_pd(c21, _mm_mul_pd(ai, b1));
+        ai = _mm_set1_pd(a[3]);
+        c30 = _mm_add_pd(c30, _mm_mul_pd(ai, b0)); c31 = _mm_add_pd(c31, _mm_mul_pd(ai, b1));
+      }
+    _mm_storeu_pd(tile, c00); _mm_storeu_pd(tile + 2, c01);
+    _mm_storeu_pd(tile + 4, c10); _mm_storeu_pd(tile + 6, c11);
+    _mm_storeu_pd(tile + 8, c20); _mm_storeu_pd(tile + 10, c21);
+    _mm_storeu_pd(tile + 12, c30); _mm_storeu_pd(tile + 14, c31);
+  }
+
+  template <> inline void multiplyTile<float>(int kc, const float* a, const float* b, float* tile)
+  {
+    __m128 c00 = _mm_setzero_ps(), c01 = _mm_setzero_ps(),
+      c10 = _mm_setzero_ps(), c11 = _mm_setzero_ps(),
+      c20 = _mm_setzero_ps(), c21 = _mm_setzero_ps(),
+      c30 = _mm_setzero_ps(), c31 = _mm_setzero_ps();
+    for (int p=0; p<kc; ++p, a += 4, b += 8)
+      {
+        const __m128 b0 = _mm_loadu_ps(b), b1 = _mm_loadu_ps(b + 4);
+        __m128 ai = _mm_set1_ps(a[0]);
+        c00 = _mm_add_ps(c00, _mm_mul_ps(ai, b0)); c01 = _mm_add_ps(c01, _mm_mul_ps(ai, b1));
+        ai = _mm_set1_ps(a[1]);
+        c10 = _mm_add_ps(c10, _mm_mul_ps(ai, b0)); c11 = _mm_add_ps(c11, _mm_mul_ps(ai, b1));
+        ai = _mm_set1_ps(a[2]);
+        c20 = _mm_add_ps(c20, _mm_mul_ps(ai, b0)); c21 = _mm_add_ps(c21, _mm_mul_ps(ai, b1));
+        ai = _mm_set1_ps(a[3]);
+        c30 = _mm_add_ps(c30, _mm_mul_ps(ai, b0)); c31 = _mm_add_ps(c31, _mm_mul_ps(ai, b1));
+      }
+    _mm_storeu_ps(tile, c00); _mm_storeu_ps(tile + 4, c01);
+    _mm_storeu_ps(tile + 8, c10); _mm_storeu_ps(tile + 12, c11);
+    _mm_storeu_ps(tile + 16, c20); _mm_storeu_ps(tile + 20, c21);
+    _mm_storeu_ps(tile + 24, c30); _mm_storeu_ps(tile + 28, c31);
+  }
+#endif
+
+  // Multiplies packed blocks of A (mc-by-kc) and B (kc-by-nc) and
+  // adds the result to C. If accumulate is false, C is overwritten.
+  template <class T> void multiplyPacked(int mc, int nc, int kc,
+                                         const T* packedA, const T* packedB,
+                                         T* c, std::size_t stride, bool accumulate)
+  {
+    const int MR = Tile<T>::MR, NR = Tile<T>::NR;
+    T aTile[MR*NR];
+    for (int j=0; j<nc; j += NR)
+      {
+        const int iColumns = qMin(int(NR), nc - j);
+        for (int i=0; i<mc; i += MR)
+          {
+            multiplyTile(kc, packedA + i*kc, packedB + j*kc, aTile);
+            const int iRows = qMin(int(MR), mc - i);
+            for (int r=0; r<iRows; ++r)
+              {
+                T* pRow = rowAt(c, stride, i + r) + j;
+                const T* pTileRow = aTile + r*NR;
+                if (accumulate)
+                  for (int s=0; s<iColumns; ++s) pRow[s] += pTileRow[s];
+                else
+                  for (int s=0; s<iColumns; ++s) pRow[s] = pTileRow[s];
+              }
+          }
+      }
+  }
+
+  // Calculates rows [firstRow, lastRow) of C.
+  template <class T> void multiplyRows(int firstRow, int lastRow, int n, int k,
+                                       const T* a, std::size_t aStride,
+                                       const T* b, std::size_t bStride,
+                                       T* c, std::size_t cStride)
+  {
+    const int MR = Tile<T>::MR, NR = Tile<T>::NR;
+    T* pPackedA = new T[(MC + MR) * KC];
+    T* pPackedB = new T[KC * (NC + NR)];
+
+    for (int jc=0; jc<n; jc += NC)
+      {
+        const int nc = qMin(int(NC), n - jc);
+        for (int pc=0; pc<k; pc += KC)
+          {
+            const int kc = qMin(int(KC), k - pc);
+            packB(kc, nc, rowAt(b, bStride, pc) + jc, bStride, pPackedB);
+            for (int ic=firstRow; ic<lastRow; ic += MC)
+              {
+                const int mc = qMin(int(MC), lastRow - ic);
+                packA(mc, kc, rowAt(a, aStride, ic) + pc, aStride, pPackedA);
+                multiplyPacked(mc, nc, kc, pPackedA, pPackedB,
+                               rowAt(c, cStride, ic) + jc, cStride, pc != 0);
+              }
+          }
+      }
+
+    delete[] pPackedA;
+    delete[] pPackedB;
+  }
+
+  // Multiplies stripes of MC rows in parallel.
+  template <class T> class MultiplyFunction
+  {
+  public:
+    MultiplyFunction(int m, int n, int k,
+                     const T* a, std::size_t aStride,
+                     const T* b, std::size_t bStride,
+                     T* c, std::size_t cStride) :
+      _iM(m), _iN(n), _iK(k),
+      _pA(a), _pB(b), _pC(c),
+      _iAStride(aStride), _iBStride(bStride), _iCStride(cStride)
+    {}
+
+    void operator() (int firstStripe, int lastStripe) const
+    {
+      multiplyRows(firstStripe * MC, qMin(_iM, lastStripe * MC), _iN, _iK,
+                   _pA, _iAStride, _pB, _iBStride, _pC, _iCStride);
+    }
+
+  private:
+    int _iM, _iN, _iK;
+    const T* _pA;
+    const T* _pB;
+    T* _pC;
+    std::size_t _iAStride, _iBStride, _iCStride;
+  };
+
+  template <class T> void multiplyMatrices(int m, int n, int k,
+                                           const T* a, std::size_t aStride,
+                                           const T* b, std::size_t bStride,
+                                           T* c, std::size_t cStride)
+  {
+    if (m <= 0 || n <= 0)
+      return;
+    if (k <= 0)
+      {
+        for (int r=0; r<m; ++r)
+          std::memset(rowAt(c, cStride, r), 0, sizeof(T) * n);
+        return;
+      }
+
+    // Each thread gets at least one stripe of MC rows. The threads
+    // come from the shared pool, which is not oversubscribed if the
+    // product is calculated within another parallel task.
+    const int iStripes = (m + MC - 1) / MC;
+    const int iThreads = qMin(qMin(Pii::parallelThreadCount(0), iStripes),
+                              int(double(m) * n * k / dMinOperationsPerThread));
+    if (iThreads > 1)
+      {
+        Pii::parallelFor(iStripes, iThreads,
+                         MultiplyFunction<T>(m, n, k, a, aStride, b, bStride, c, cStride));
+        return;
+      }
+    multiplyRows(0, m, n, k, a, aStride, b, bStride, c, cStride);
+  }
+}
+
+namespace Pii
+{
+  void multiplyBlocked(int m, int n, int k,
+                       const float* a, std::size_t aStride,
+                       const float* b, std::size_t bStride,
+                       float* c, std::size_t cStride)
+  {
+    ::multiplyMatrices(m, n, k, a, aStride, b, bStride, c, cStride);
+  }
+
+  void multiplyBlocked(int m, int n, int k,
+                       const double* a, std::size_t aStride,
+                       const double* b, std::size_t bStride,
+                       double* c, std::size_t cStride)
+  {
+    ::multiplyMatrices(m, n, k, a, aStride, b, bStride, c, cStride);
+  }
+}
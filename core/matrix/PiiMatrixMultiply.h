@@ -0,0 +1,92 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIIMATRIXMULTIPLY_H
+#define _PIIMATRIXMULTIPLY_H
+
+#include "PiiMatrix.h"
+
+namespace Pii
+{
+  /**
+   * Calculates the matrix product *C* = *A* * *B* with a cache-blocked
+   * algorithm. *A* is an *m*-by-*k* matrix, *B* a *k*-by-*n* matrix
+   * and *C* an *m*-by-*n* matrix. Each matrix is given as a pointer to
+   * its first element and a stride, which is the number of bytes
+   * between the beginnings of successive rows. *C* must not overlap
+   * with *A* or *B*.
+   *
+   * The matrices are multiplied in blocks that fit into processor
+   * caches. The blocks are packed into contiguous buffers and
+   * multiplied with a kernel that keeps a small tile of *C* in
+   * registers. SSE2 instructions are used if available. Large
+   * products are split into horizontal stripes that are computed in
+   * parallel.
+   *
+   * There is usually no need to call these functions directly. The
+   * matrix multiplication operator uses them automatically for
+   * large enough `float` and `double` matrices.
+   */
+  PII_CORE_EXPORT void multiplyBlocked(int m, int n, int k,
+                                       const float* a, std::size_t aStride,
+                                       const float* b, std::size_t bStride,
+                                       float* c, std::size_t cStride);
+  /// @overload
+  PII_CORE_EXPORT void multiplyBlocked(int m, int n, int k,
+                                       const double* a, std::size_t aStride,
+                                       const double* b, std::size_t bStride,
+                                       double* c, std::size_t cStride);
+
+  /// @hide
+  // Products smaller than this many multiply-adds use the naive loop.
+  enum { BlockedMultiplyThreshold = 32*32*32 };
+
+  template <class T, class Matrix> inline PiiMatrix<T> plainMatrix(const Matrix& mat) { return PiiMatrix<T>(mat); }
+  template <class T> inline const PiiMatrix<T>& plainMatrix(const PiiMatrix<T>& mat) { return mat; }
+
+  template <class T, class Matrix1, class Matrix2, class Result>
+  inline bool multiplyBlocked(const Matrix1& m1, const Matrix2& m2, Result& result)
+  {
+    const int iRows = m1.rows(), iColumns = m2.columns(), iInner = m1.columns();
+    if (double(iRows) * iColumns * iInner < BlockedMultiplyThreshold)
+      return false;
+    // The kernel needs direct access to rows. Expressions, transposed
+    // and type-converted matrices are evaluated first.
+    const PiiMatrix<T> matA(plainMatrix<T>(m1)), matB(plainMatrix<T>(m2));
+    multiplyBlocked(iRows, iColumns, iInner,
+                    matA[0], matA.stride(),
+                    matB[0], matB.stride(),
+                    result[0], result.stride());
+    return true;
+  }
+
+  // Only float and double have a blocked implementation.
+  template <class Matrix1, class Matrix2, class T, int rows, int columns>
+  inline bool multiplyBlocked(const Matrix1&, const Matrix2&, PiiMatrix<T,rows,columns>&) { return false; }
+  template <class Matrix1, class Matrix2, int rows, int columns>
+  inline bool multiplyBlocked(const Matrix1& m1, const Matrix2& m2, PiiMatrix<float,rows,columns>& result)
+  {
+    return multiplyBlocked<float>(m1, m2, result);
+  }
+  template <class Matrix1, class Matrix2, int rows, int columns>
+  inline bool multiplyBlocked(const Matrix1& m1, const Matrix2& m2, PiiMatrix<double,rows,columns>& result)
+  {
+    return multiplyBlocked<double>(m1, m2, result);
+  }
+  /// @endhide
+}
+
+#endif //_PIIMATRIXMULTIPLY_H
@@ -27,7 +27,7 @@ public:
   ~QVarLengthArray()
   {
     if (_ptr != _array)
-      delete _ptr;
+      delete[] _ptr;
   }
 
   T& operator[] (int index) { return _ptr[index]; }
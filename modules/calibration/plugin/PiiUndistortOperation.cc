@@ -18,7 +18,8 @@
 #include <PiiYdinTypes.h>
 
 PiiUndistortOperation::Data::Data() :
-  interpolation(Pii::LinearInterpolation)
+  interpolation(Pii::LinearInterpolation),
+  iTileThreads(1)
 {
   intrinsic.focalLength.x = 1000;
   intrinsic.focalLength.y = 1000;
@@ -58,6 +59,7 @@ void PiiUndistortOperation::check(bool reset)
 void PiiUndistortOperation::invalidate()
 {
   PII_D;
+  d->remap = PiiRemap();
   d->dmatMap.resize(0,0);
   d->imatMap.resize(0,0);
 }
@@ -79,27 +81,56 @@ template <class T> void PiiUndistortOperation::undistort(const PiiVariant& obj)
   PII_D;
   PiiMatrix<T> matImage(obj.valueAs<PiiMatrix<T> >());
 
-  PiiTypelessMatrix* pMat = d->interpolation == Pii::LinearInterpolation ?
-    static_cast<PiiTypelessMatrix*>(&d->dmatMap) :
-    static_cast<PiiTypelessMatrix*>(&d->imatMap);
+  if (!PiiRemap::supportsSourceSize(matImage.rows(), matImage.columns()))
+    {
+      undistortLarge(matImage);
+      return;
+    }
 
-  if (pMat->rows() != matImage.rows() ||
-      pMat->columns() != matImage.columns())
+  // The map is compiled once and reused until the camera parameters
+  // or the size of the input image change.
+  if (d->remap.sourceRows() != matImage.rows() ||
+      d->remap.sourceColumns() != matImage.columns())
     {
-      PiiCalibration::CameraParameters intrinsic(_d()->intrinsic);
-      if (Pii::isNan(intrinsic.center.x))
-        intrinsic.center.x = double(matImage.columns()/2 - 0.5);
-      if (Pii::isNan(intrinsic.center.y))
-        intrinsic.center.y = double(matImage.rows()/2 - 0.5);
+      PiiCalibration::CameraParameters intrinsic(centeredParameters(matImage.rows(), matImage.columns()));
       if (d->interpolation == Pii::LinearInterpolation)
-        d->dmatMap = PiiCalibration::undistortMap(matImage.rows(), matImage.columns(), intrinsic);
+        d->remap = PiiRemap(PiiCalibration::undistortMap(matImage.rows(), matImage.columns(), intrinsic),
+                            matImage.rows(), matImage.columns());
       else
-        d->imatMap = PiiCalibration::undistortMapInt(matImage.rows(), matImage.columns(), intrinsic);
+        d->remap = PiiRemap(PiiCalibration::undistortMapInt(matImage.rows(), matImage.columns(), intrinsic),
+                            matImage.rows(), matImage.columns());
     }
+  emitObject(d->remap.apply(matImage, T(0), d->iTileThreads));
+}
+
+template <class T> void PiiUndistortOperation::undistortLarge(const PiiMatrix<T>& image)
+{
+  PII_D;
   if (d->interpolation == Pii::LinearInterpolation)
-    emitObject(PiiImage::remap(matImage, d->dmatMap));
+    {
+      if (d->dmatMap.rows() != image.rows() || d->dmatMap.columns() != image.columns())
+        d->dmatMap = PiiCalibration::undistortMap(image.rows(), image.columns(),
+                                                  centeredParameters(image.rows(), image.columns()));
+      emitObject(PiiImage::remap(image, d->dmatMap));
+    }
   else
-    emitObject(PiiImage::remap(matImage, d->imatMap));
+    {
+      if (d->imatMap.rows() != image.rows() || d->imatMap.columns() != image.columns())
+        d->imatMap = PiiCalibration::undistortMapInt(image.rows(), image.columns(),
+                                                     centeredParameters(image.rows(), image.columns()));
+      emitObject(PiiImage::remap(image, d->imatMap));
+    }
+}
+
+PiiCalibration::CameraParameters PiiUndistortOperation::centeredParameters(int rows, int columns) const
+{
+  const PII_D;
+  PiiCalibration::CameraParameters intrinsic(d->intrinsic);
+  if (Pii::isNan(intrinsic.center.x))
+    intrinsic.center.x = double(columns/2 - 0.5);
+  if (Pii::isNan(intrinsic.center.y))
+    intrinsic.center.y = double(rows/2 - 0.5);
+  return intrinsic;
 }
 
 
@@ -153,5 +184,7 @@ PiiVariant PiiUndistortOperation::cameraParameters() const
                                       d->intrinsic.p2));
 }
 
-void PiiUndistortOperation::setInterpolation(Pii::Interpolation interpolation) { _d()->interpolation = interpolation; }
+void PiiUndistortOperation::setInterpolation(Pii::Interpolation interpolation) { _d()->interpolation = interpolation; invalidate(); }
 Pii::Interpolation PiiUndistortOperation::interpolation() const { return _d()->interpolation; }
+void PiiUndistortOperation::setTileThreads(int tileThreads) { _d()->iTileThreads = tileThreads; }
+int PiiUndistortOperation::tileThreads() const { return _d()->iTileThreads; }
@@ -18,6 +18,7 @@
 
 #include <PiiDefaultOperation.h>
 #include "PiiCalibration.h"
+#include <PiiRemap.h>
 
 /**
  * Corrects lens distortion.
@@ -97,6 +98,14 @@ class PiiUndistortOperation : public PiiDefaultOperation
    */
   Q_PROPERTY(Pii::Interpolation interpolation READ interpolation WRITE setInterpolation);
 
+  /**
+   * The number of threads used for correcting a single image. If this
+   * value is greater than one, the output image is divided into
+   * horizontal bands that are filled in parallel. 0 means one thread
+   * per processor core. The default value is 1.
+   */
+  Q_PROPERTY(int tileThreads READ tileThreads WRITE setTileThreads);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   PiiUndistortOperation();
@@ -126,6 +135,8 @@ protected:
   PiiVariant cameraParameters() const;
   void setInterpolation(Pii::Interpolation interpolation);
   Pii::Interpolation interpolation() const;
+  void setTileThreads(int tileThreads);
+  int tileThreads() const;
 
 private:
   /// @internal
@@ -135,13 +146,18 @@ private:
     Data();
 
     PiiCalibration::CameraParameters intrinsic;
+    PiiRemap remap;
+    // Uncompiled maps for images PiiRemap cannot handle.
     PiiImage::DoubleCoordinateMap dmatMap;
     PiiImage::IntCoordinateMap imatMap;
     Pii::Interpolation interpolation;
+    int iTileThreads;
   };
   PII_D_FUNC;
 
   template <class T> void undistort(const PiiVariant& obj);
+  template <class T> void undistortLarge(const PiiMatrix<T>& image);
+  PiiCalibration::CameraParameters centeredParameters(int rows, int columns) const;
   void invalidate();
 };
 
@@ -15,6 +15,10 @@
 
 #include "PiiBayerConverter.h"
 
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
 namespace PiiCamera
 {
   PiiMatrix<PiiColor4<> > rggbToRgb(const PiiMatrix<unsigned char>& encoded)
@@ -26,4 +30,479 @@ namespace PiiCamera
   {
     return bayerToRgb(encoded, GrbgDecoder<unsigned char>(), Rgb4Pixel<>());
   }
+
+  namespace
+  {
+    // The ways a color channel can be interpolated at a pixel. See
+    // the interpolators in PiiBayerConverter.h.
+    enum Interpolation { Center, Horizontal, Vertical, Straight, Diagonal };
+
+    // Returns the color channel (0 = red, 1 = green, 2 = blue) of each
+    // pixel in the 2-by-2 cell at the top left corner of the image.
+    bool bayerCell(ImageFormat format, int colors[2][2])
+    {
+      static const int aCells[4][2][2] =
+        {
+          { { 0, 1 }, { 1, 2 } }, // RGGB
+          { { 2, 1 }, { 1, 0 } }, // BGGR
+          { { 1, 2 }, { 0, 1 } }, // GBRG
+          { { 1, 0 }, { 2, 1 } }  // GRBG
+        };
+      int iIndex = 0;
+      switch (format)
+        {
+        case BayerRGGBFormat: iIndex = 0; break;
+        case BayerBGGRFormat: iIndex = 1; break;
+        case BayerGBRGFormat: iIndex = 2; break;
+        case BayerGRBGFormat: iIndex = 3; break;
+        default: return false;
+        }
+      for (int r=0; r<2; ++r)
+        for (int c=0; c<2; ++c)
+          colors[r][c] = aCells[iIndex][r][c];
+      return true;
+    }
+
+    Interpolation interpolation(const int colors[2][2], int row, int column, int channel)
+    {
+      const int iColor = colors[row & 1][column & 1];
+      if (iColor == channel)
+        return Center;
+      if (channel == 1)
+        return Straight;
+      if (iColor != 1)
+        return Diagonal;
+      return colors[row & 1][(column+1) & 1] == channel ? Horizontal : Vertical;
+    }
+
+    /* The interpolators average the neighbors that exist. This is
+     * what their border functions (top(), left() etc.) do, so border
+     * pixels can be handled with a single function.
+     */
+    template <class T> int borderValue(const PiiMatrix<T>& encoded, int row, int column, Interpolation interpolation)
+    {
+      static const int aOffsets[5][5][2] =
+        {
+          { { 0, 0 } },
+          { { 0, -1 }, { 0, 1 } },
+          { { -1, 0 }, { 1, 0 } },
+          { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } },
+          { { -1, -1 }, { -1, 1 }, { 1, -1 }, { 1, 1 } }
+        };
+      static const int aCounts[5] = { 1, 2, 2, 4, 4 };
+      int iSum = 0, iCount = 0;
+      for (int i=0; i<aCounts[interpolation]; ++i)
+        {
+          const int r = row + aOffsets[interpolation][i][0], c = column + aOffsets[interpolation][i][1];
+          if (r >= 0 && r < encoded.rows() && c >= 0 && c < encoded.columns())
+            {
+              iSum += encoded(r,c);
+              ++iCount;
+            }
+        }
+      return iSum / iCount;
+    }
+
+    // result[i] = (a[i] + b[i]) >> 1
+    template <class T> inline void average2Scalar(const T* a, const T* b, T* result, int i, int n)
+    {
+      for (; i<n; ++i)
+        result[i] = T((int(a[i]) + int(b[i])) >> 1);
+    }
+
+    // result[i] = (a[i] + b[i] + c[i] + d[i]) >> 2
+    template <class T> inline void average4Scalar(const T* a, const T* b, const T* c, const T* d,
+                                                  T* result, int i, int n)
+    {
+      for (; i<n; ++i)
+        result[i] = T((int(a[i]) + int(b[i]) + int(c[i]) + int(d[i])) >> 2);
+    }
+
+#ifdef __SSE2__
+#  define PII_LOAD(PTR) _mm_loadu_si128(reinterpret_cast<const __m128i*>(PTR))
+#  define PII_STORE(PTR, VALUE) _mm_storeu_si128(reinterpret_cast<__m128i*>(PTR), VALUE)
+#endif
+
+    void average2(const unsigned char* a, const unsigned char* b, unsigned char* result, int n)
+    {
+      int i = 0;
+#ifdef __SSE2__
+      // _mm_avg_epu8 rounds up. Subtracting the lowest bit of a^b
+      // rounds down instead.
+      const __m128i one = _mm_set1_epi8(1);
+      for (; i<=n-16; i+=16)
+        {
+          const __m128i va = PII_LOAD(a+i), vb = PII_LOAD(b+i);
+          PII_STORE(result+i, _mm_sub_epi8(_mm_avg_epu8(va, vb),
+                                           _mm_and_si128(_mm_xor_si128(va, vb), one)));
+        }
+#endif
+      average2Scalar(a, b, result, i, n);
+    }
+
+    void average2(const unsigned short* a, const unsigned short* b, unsigned short* result, int n)
+    {
+      int i = 0;
+#ifdef __SSE2__
+      const __m128i one = _mm_set1_epi16(1);
+      for (; i<=n-8; i+=8)
+        {
+          const __m128i va = PII_LOAD(a+i), vb = PII_LOAD(b+i);
+          PII_STORE(result+i, _mm_sub_epi16(_mm_avg_epu16(va, vb),
+                                            _mm_and_si128(_mm_xor_si128(va, vb), one)));
+        }
+#endif
+      average2Scalar(a, b, result, i, n);
+    }
+
+    void average4(const unsigned char* a, const unsigned char* b, const unsigned char* c, const unsigned char* d,
+                  unsigned char* result, int n)
+    {
+      int i = 0;
+#ifdef __SSE2__
+      // Sums of four bytes need ten bits -> unpack to 16 bits.
+      const __m128i zero = _mm_setzero_si128();
+#  define PII_SUM4(UNPACK)                                              \
+      _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(UNPACK(va, zero), UNPACK(vb, zero)), \
+                                   _mm_add_epi16(UNPACK(vc, zero), UNPACK(vd, zero))), 2)
+      for (; i<=n-16; i+=16)
+        {
+          const __m128i va = PII_LOAD(a+i), vb = PII_LOAD(b+i), vc = PII_LOAD(c+i), vd = PII_LOAD(d+i);
+          PII_STORE(result+i, _mm_packus_epi16(PII_SUM4(_mm_unpacklo_epi8), PII_SUM4(_mm_unpackhi_epi8)));
+        }
+#  undef PII_SUM4
+#endif
+      average4Scalar(a, b, c, d, result, i, n);
+    }
+
+    void average4(const unsigned short* a, const unsigned short* b, const unsigned short* c, const unsigned short* d,
+                  unsigned short* result, int n)
+    {
+      int i = 0;
+#ifdef __SSE2__
+      // Sums are calculated with 32 bits. SSE2 can only pack signed
+      // 32-bit values, so the results are biased by -32768 before
+      // packing, and the bias is removed with an xor afterwards.
+      const __m128i zero = _mm_setzero_si128(), bias32 = _mm_set1_epi32(32768), bias16 = _mm_set1_epi16(short(0x8000));
+#  define PII_SUM4(UNPACK)                                              \
+      _mm_sub_epi32(_mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(UNPACK(va, zero), UNPACK(vb, zero)), \
+                                                 _mm_add_epi32(UNPACK(vc, zero), UNPACK(vd, zero))), 2), bias32)
+      for (; i<=n-8; i+=8)
+        {
+          const __m128i va = PII_LOAD(a+i), vb = PII_LOAD(b+i), vc = PII_LOAD(c+i), vd = PII_LOAD(d+i);
+          PII_STORE(result+i, _mm_xor_si128(_mm_packs_epi32(PII_SUM4(_mm_unpacklo_epi16), PII_SUM4(_mm_unpackhi_epi16)),
+                                            bias16));
+        }
+#  undef PII_SUM4
+#endif
+      average4Scalar(a, b, c, d, result, i, n);
+    }
+
+    // Returns a mask that selects the elements on even columns.
+#ifdef __SSE2__
+    inline __m128i evenColumnMask(const unsigned char*) { return _mm_set1_epi16(0x00ff); }
+    inline __m128i evenColumnMask(const unsigned short*) { return _mm_set1_epi32(0xffff); }
+#endif
+
+    // result[c] = even[c] for even c and odd[c] for odd c
+    template <class T> void mergeColumns(const T* even, const T* odd, T* result, int first, int last)
+    {
+      int c = first;
+      if (c & 1)
+        result[c] = odd[c], ++c;
+#ifdef __SSE2__
+      const int iStep = 16 / sizeof(T);
+      const __m128i mask = evenColumnMask(even);
+      for (; c<=last-iStep; c+=iStep)
+        PII_STORE(result+c, _mm_or_si128(_mm_and_si128(mask, PII_LOAD(even+c)),
+                                         _mm_andnot_si128(mask, PII_LOAD(odd+c))));
+#endif
+      for (; c<last; ++c)
+        result[c] = c & 1 ? odd[c] : even[c];
+    }
+
+    template <class T> void storeGray(const T* red, const T* green, const T* blue, T* result, int first, int last)
+    {
+      for (int c=first; c<last; ++c)
+        result[c] = T((int(red[c]) + int(green[c]) + int(blue[c])) / 3);
+    }
+
+    void storeGray(const unsigned char* red, const unsigned char* green, const unsigned char* blue,
+                   unsigned char* result, int first, int last)
+    {
+      int c = first;
+#ifdef __SSE2__
+      // x/3 = (x * 0xaaab) >> 17 for all sums of three bytes.
+      const __m128i zero = _mm_setzero_si128(), third = _mm_set1_epi16(short(0xaaab));
+#  define PII_THIRD(UNPACK)                                             \
+      _mm_srli_epi16(_mm_mulhi_epu16(_mm_add_epi16(_mm_add_epi16(UNPACK(vr, zero), UNPACK(vg, zero)), \
+                                                   UNPACK(vb, zero)), third), 1)
+      for (; c<=last-16; c+=16)
+        {
+          const __m128i vr = PII_LOAD(red+c), vg = PII_LOAD(green+c), vb = PII_LOAD(blue+c);
+          PII_STORE(result+c, _mm_packus_epi16(PII_THIRD(_mm_unpacklo_epi8), PII_THIRD(_mm_unpackhi_epi8)));
+        }
+#  undef PII_THIRD
+#endif
+      storeGray<unsigned char>(red, green, blue, result, c, last);
+    }
+
+    template <class T, class Color> void storeRgb(const T* red, const T* green, const T* blue,
+                                                  Color* result, int first, int last)
+    {
+      for (int c=first; c<last; ++c)
+        result[c] = Color(red[c], green[c], blue[c]);
+    }
+
+    void storeRgb(const unsigned char* red, const unsigned char* green, const unsigned char* blue,
+                  PiiColor4<unsigned char>* result, int first, int last)
+    {
+      int c = first;
+#ifdef __SSE2__
+      // PiiColor4 is stored as B,G,R,A. Interleave 16 pixels at a
+      // time with a zero alpha.
+      const __m128i zero = _mm_setzero_si128();
+      for (; c<=last-16; c+=16)
+        {
+          const __m128i vr = PII_LOAD(red+c), vg = PII_LOAD(green+c), vb = PII_LOAD(blue+c);
+          const __m128i bgLow = _mm_unpacklo_epi8(vb, vg), bgHigh = _mm_unpackhi_epi8(vb, vg);
+          const __m128i raLow = _mm_unpacklo_epi8(vr, zero), raHigh = _mm_unpackhi_epi8(vr, zero);
+          __m128i* pTarget = reinterpret_cast<__m128i*>(result + c);
+          _mm_storeu_si128(pTarget, _mm_unpacklo_epi16(bgLow, raLow));
+          _mm_storeu_si128(pTarget + 1, _mm_unpackhi_epi16(bgLow, raLow));
+          _mm_storeu_si128(pTarget + 2, _mm_unpacklo_epi16(bgHigh, raHigh));
+          _mm_storeu_si128(pTarget + 3, _mm_unpackhi_epi16(bgHigh, raHigh));
+        }
+#endif
+      storeRgb<unsigned char>(red, green, blue, result, c, last);
+    }
+
+#ifdef __SSE2__
+#  undef PII_LOAD
+#  undef PII_STORE
+#endif
+
+    /* Sinks receive decoded pixels. set() stores a single pixel.
+     * setRow() stores the pixels from *first* to *last*-1 on a row,
+     * given the values of each color channel on that row. The
+     * channel pointers are indexed by column. A sink may provide a
+     * buffer the channel it needs is merged into directly.
+     */
+    template <class Color> struct RgbSink
+    {
+      typedef typename Color::Type T;
+      RgbSink(int rows, int columns) : matResult(PiiMatrix<Color>::uninitialized(rows, columns)) {}
+      void set(int row, int column, int red, int green, int blue)
+      {
+        matResult(row, column) = Color(T(red), T(green), T(blue));
+      }
+      T* channelBuffer(int) { return 0; }
+      void setRow(int row, const T* red, const T* green, const T* blue, int first, int last)
+      {
+        storeRgb(red, green, blue, matResult[row], first, last);
+      }
+      PiiMatrix<Color> matResult;
+    };
+
+    template <class T> struct GraySink
+    {
+      GraySink(int rows, int columns) : matResult(PiiMatrix<T>::uninitialized(rows, columns)) {}
+      void set(int row, int column, int red, int green, int blue)
+      {
+        matResult(row, column) = T((red + green + blue) / 3);
+      }
+      T* channelBuffer(int) { return 0; }
+      void setRow(int row, const T* red, const T* green, const T* blue, int first, int last)
+      {
+        storeGray(red, green, blue, matResult[row], first, last);
+      }
+      PiiMatrix<T> matResult;
+    };
+
+    template <class T> struct ChannelSink
+    {
+      ChannelSink(int rows, int columns, int channel) :
+        matResult(PiiMatrix<T>::uninitialized(rows, columns)), iChannel(channel)
+      {}
+      void set(int row, int column, int red, int green, int blue)
+      {
+        matResult(row, column) = T(iChannel == 0 ? red : iChannel == 1 ? green : blue);
+      }
+      // The channel is merged directly into the result.
+      T* channelBuffer(int row) { return matResult[row]; }
+      void setRow(int, const T*, const T*, const T*, int, int) {}
+      PiiMatrix<T> matResult;
+      int iChannel;
+    };
+
+    /* Decodes the whole image into *sink*. The interior of each row
+     * is processed by calculating the averages of horizontal,
+     * vertical, straight and diagonal neighbors for the whole row
+     * into buffers. Each color channel is then merged from the
+     * buffers that correspond to the even and odd columns of the
+     * row. *channels* is a bit mask of the needed color channels (bit
+     * 0 = red). Averages not needed by any of them are not
+     * calculated.
+     */
+    template <class T, class Sink> void decodeBayer(const PiiMatrix<T>& encoded, const int colors[2][2],
+                                                    int channels, Sink& sink)
+    {
+      const int iRows = encoded.rows(), iCols = encoded.columns();
+
+      // Borders
+      for (int r=0; r<iRows; ++r)
+        {
+          const int iStep = r == 0 || r == iRows-1 ? 1 : iCols-1;
+          for (int c=0; c<iCols; c += iStep)
+            sink.set(r, c,
+                     borderValue(encoded, r, c, interpolation(colors, r, c, 0)),
+                     borderValue(encoded, r, c, interpolation(colors, r, c, 1)),
+                     borderValue(encoded, r, c, interpolation(colors, r, c, 2)));
+        }
+      if (iRows < 3 || iCols < 3)
+        return;
+
+      // Rows 1-4 store the averages, rows 5-7 the merged channels.
+      PiiMatrix<T> matBuffers(PiiMatrix<T>::uninitialized(8, iCols));
+      const int iInner = iCols - 2;
+      for (int r=1; r<iRows-1; ++r)
+        {
+          const T* pRow0 = encoded[r-1], *pRow1 = encoded[r], *pRow2 = encoded[r+1];
+          // Averages indexed by column like the source rows. The
+          // center is the row itself.
+          const T* apValues[5] = { pRow1, matBuffers[Horizontal], matBuffers[Vertical],
+                                   matBuffers[Straight], matBuffers[Diagonal] };
+          const T* apChannels[3] = { pRow1, pRow1, pRow1 };
+          bool abNeeded[5] = { false, false, false, false, false };
+          for (int iChannel=0; iChannel<3; ++iChannel)
+            if (channels & (1 << iChannel))
+              for (int p=0; p<2; ++p)
+                abNeeded[interpolation(colors, r, p, iChannel)] = true;
+
+          if (abNeeded[Horizontal])
+            average2(pRow1, pRow1 + 2, matBuffers[Horizontal] + 1, iInner);
+          if (abNeeded[Vertical])
+            average2(pRow0 + 1, pRow2 + 1, matBuffers[Vertical] + 1, iInner);
+          if (abNeeded[Straight])
+            average4(pRow0 + 1, pRow2 + 1, pRow1, pRow1 + 2, matBuffers[Straight] + 1, iInner);
+          if (abNeeded[Diagonal])
+            average4(pRow0, pRow0 + 2, pRow2, pRow2 + 2, matBuffers[Diagonal] + 1, iInner);
+
+          for (int iChannel=0; iChannel<3; ++iChannel)
+            if (channels & (1 << iChannel))
+              {
+                T* pTarget = sink.channelBuffer(r);
+                if (pTarget == 0)
+                  pTarget = matBuffers[5 + iChannel];
+                mergeColumns(apValues[interpolation(colors, r, 0, iChannel)],
+                             apValues[interpolation(colors, r, 1, iChannel)],
+                             pTarget, 1, iCols-1);
+                apChannels[iChannel] = pTarget;
+              }
+
+          sink.setRow(r, apChannels[0], apChannels[1], apChannels[2], 1, iCols-1);
+        }
+    }
+
+    template <class Color, class T> PiiMatrix<Color> fastBayerToRgb(const PiiMatrix<T>& encoded, ImageFormat format)
+    {
+      int aColors[2][2];
+      if (encoded.rows() < 2 || encoded.columns() < 2 || !bayerCell(format, aColors))
+        return PiiMatrix<Color>(encoded.rows(), encoded.columns());
+      RgbSink<Color> sink(encoded.rows(), encoded.columns());
+      decodeBayer(encoded, aColors, 7, sink);
+      return sink.matResult;
+    }
+
+    template <class T> PiiMatrix<T> fastBayerToGray(const PiiMatrix<T>& encoded, ImageFormat format)
+    {
+      int aColors[2][2];
+      if (encoded.rows() < 2 || encoded.columns() < 2 || !bayerCell(format, aColors))
+        return PiiMatrix<T>(encoded.rows(), encoded.columns());
+      GraySink<T> sink(encoded.rows(), encoded.columns());
+      decodeBayer(encoded, aColors, 7, sink);
+      return sink.matResult;
+    }
+
+    template <class T> PiiMatrix<T> fastBayerChannel(const PiiMatrix<T>& encoded, ImageFormat format, int channel)
+    {
+      int aColors[2][2];
+      if (encoded.rows() < 2 || encoded.columns() < 2 || channel < 0 || channel > 2 ||
+          !bayerCell(format, aColors))
+        return PiiMatrix<T>(encoded.rows(), encoded.columns());
+      ChannelSink<T> sink(encoded.rows(), encoded.columns(), channel);
+      decodeBayer(encoded, aColors, 1 << channel, sink);
+      return sink.matResult;
+    }
+
+    template <class Color, class T> PiiMatrix<Color> bayerToHalfRgb(const PiiMatrix<T>& encoded, ImageFormat format)
+    {
+      typedef typename Color::Type U;
+      int aColors[2][2];
+      if (!bayerCell(format, aColors))
+        return PiiMatrix<Color>(encoded.rows() / 2, encoded.columns() / 2);
+      PiiMatrix<Color> matResult(PiiMatrix<Color>::uninitialized(encoded.rows() / 2, encoded.columns() / 2));
+
+      // Positions of red and blue in the cell. Greens are on the
+      // other diagonal.
+      int iRed = 0, iBlue = 0;
+      for (int i=0; i<4; ++i)
+        {
+          if (aColors[i>>1][i&1] == 0) iRed = i;
+          else if (aColors[i>>1][i&1] == 2) iBlue = i;
+        }
+      const int iGreen1 = iRed ^ 1, iGreen2 = iRed ^ 2;
+
+      for (int r=0; r<matResult.rows(); ++r)
+        {
+          const T* apRows[2] = { encoded[2*r], encoded[2*r+1] };
+          const T* pRed = apRows[iRed >> 1] + (iRed & 1), *pBlue = apRows[iBlue >> 1] + (iBlue & 1),
+            *pGreen1 = apRows[iGreen1 >> 1] + (iGreen1 & 1), *pGreen2 = apRows[iGreen2 >> 1] + (iGreen2 & 1);
+          Color* pResult = matResult[r];
+          for (int c=0; c<matResult.columns(); ++c)
+            pResult[c] = Color(U(pRed[2*c]), U((int(pGreen1[2*c]) + int(pGreen2[2*c])) >> 1), U(pBlue[2*c]));
+        }
+      return matResult;
+    }
+  }
+
+  PiiMatrix<PiiColor4<> > fastBayerToRgb(const PiiMatrix<unsigned char>& encoded, ImageFormat format)
+  {
+    return fastBayerToRgb<PiiColor4<> >(encoded, format);
+  }
+
+  PiiMatrix<PiiColor<unsigned short> > fastBayerToRgb(const PiiMatrix<unsigned short>& encoded, ImageFormat format)
+  {
+    return fastBayerToRgb<PiiColor<unsigned short> >(encoded, format);
+  }
+
+  PiiMatrix<unsigned char> fastBayerToGray(const PiiMatrix<unsigned char>& encoded, ImageFormat format)
+  {
+    return fastBayerToGray<unsigned char>(encoded, format);
+  }
+
+  PiiMatrix<unsigned short> fastBayerToGray(const PiiMatrix<unsigned short>& encoded, ImageFormat format)
+  {
+    return fastBayerToGray<unsigned short>(encoded, format);
+  }
+
+  PiiMatrix<unsigned char> fastBayerChannel(const PiiMatrix<unsigned char>& encoded, ImageFormat format, int channel)
+  {
+    return fastBayerChannel<unsigned char>(encoded, format, channel);
+  }
+
+  PiiMatrix<unsigned short> fastBayerChannel(const PiiMatrix<unsigned short>& encoded, ImageFormat format, int channel)
+  {
+    return fastBayerChannel<unsigned short>(encoded, format, channel);
+  }
+
+  PiiMatrix<PiiColor4<> > bayerToHalfRgb(const PiiMatrix<unsigned char>& encoded, ImageFormat format)
+  {
+    return bayerToHalfRgb<PiiColor4<> >(encoded, format);
+  }
+
+  PiiMatrix<PiiColor<unsigned short> > bayerToHalfRgb(const PiiMatrix<unsigned short>& encoded, ImageFormat format)
+  {
+    return bayerToHalfRgb<PiiColor<unsigned short> >(encoded, format);
+  }
 }
@@ -19,6 +19,7 @@
 #include <PiiMatrix.h>
 #include <PiiColor.h>
 #include <PiiCameraGlobal.h>
+#include "PiiCamera.h"
 
 namespace PiiCamera
 {
@@ -280,6 +281,16 @@ namespace PiiCamera
                         CenterInterpolator<T>,StraightInterpolator<T>,DiagonalInterpolator<T> >
   {};
 
+  /**
+   * Bayer decoding structure for GBRG color ordering.
+   */
+  template <class T = unsigned char> struct GbrgDecoder :
+    public BayerDecoder<VerticalInterpolator<T>,CenterInterpolator<T>,HorizontalInterpolator<T>,
+                        DiagonalInterpolator<T>,StraightInterpolator<T>,CenterInterpolator<T>,
+                        CenterInterpolator<T>,StraightInterpolator<T>,DiagonalInterpolator<T>,
+                        HorizontalInterpolator<T>,CenterInterpolator<T>,VerticalInterpolator<T> >
+  {};
+
   /**
    * Rgb color pixel type functor for Bayer decoding. Uses PiiColor<T>
    * as output type. Use this structure as a model for new pixel types.
@@ -591,6 +602,7 @@ namespace PiiCamera
                              decoder.interpolatorG00.bottomLeft(row0, row1),
                              decoder.interpolatorB00.bottomLeft(row0, row1));
 
+        ++row0; ++row1;
         // Bottom Row
         for (c = 1; c<encoded.columns()-1; ++c, ++row0, ++row1)
           {
@@ -626,6 +638,86 @@ namespace PiiCamera
    * into a 32-bit RGB color image.
    */
   PII_CAMERA_EXPORT PiiMatrix<PiiColor4<> > grbgToRgb(const PiiMatrix<unsigned char>& encoded);
+
+  /**
+   * Decodes a Bayer-encoded 8-bit image into a 32-bit RGB color
+   * image using bilinear interpolation. The result is the same as
+   * that of [bayerToRgb()] with the decoder that matches *format*,
+   * but the conversion is much faster. Whole rows of interpolated
+   * values are calculated at once with SIMD instructions, if
+   * available, and only the border pixels are handled separately.
+   *
+   * @param encoded a Bayer-encoded image
+   *
+   * @param format the color ordering of *encoded*. One of
+   * `BayerRGGBFormat`, `BayerBGGRFormat`, `BayerGBRGFormat` and
+   * `BayerGRBGFormat`.
+   *
+   * @return decoded color image. The size of this image equals that
+   * of *encoded*. If *encoded* is smaller than 2x2 or *format* is not
+   * a Bayer format, a zero matrix is returned.
+   *
+   * ~~~(c++)
+   * PiiMatrix<unsigned char> encoded;
+   * PiiMatrix<PiiColor4<> > rgbImage = PiiCamera::fastBayerToRgb(encoded, PiiCamera::BayerBGGRFormat);
+   * ~~~
+   */
+  PII_CAMERA_EXPORT PiiMatrix<PiiColor4<> > fastBayerToRgb(const PiiMatrix<unsigned char>& encoded,
+                                                           ImageFormat format);
+  /**
+   * Decodes a Bayer-encoded 16-bit image into a three-channel 16-bit
+   * color image.
+   */
+  PII_CAMERA_EXPORT PiiMatrix<PiiColor<unsigned short> > fastBayerToRgb(const PiiMatrix<unsigned short>& encoded,
+                                                                        ImageFormat format);
+
+  /**
+   * Decodes a Bayer-encoded image directly into gray levels. Each
+   * pixel is the average of the interpolated color channels, as with
+   * [GrayPixel]. No color image is created in between.
+   */
+  PII_CAMERA_EXPORT PiiMatrix<unsigned char> fastBayerToGray(const PiiMatrix<unsigned char>& encoded,
+                                                             ImageFormat format);
+  /**
+   * Same as above, but for 16-bit images.
+   */
+  PII_CAMERA_EXPORT PiiMatrix<unsigned short> fastBayerToGray(const PiiMatrix<unsigned short>& encoded,
+                                                              ImageFormat format);
+
+  /**
+   * Interpolates a single color channel of a Bayer-encoded image.
+   * Only the values needed for the requested channel are calculated.
+   *
+   * @param channel the color channel to extract. 0 = red, 1 = green, 2
+   * = blue.
+   */
+  PII_CAMERA_EXPORT PiiMatrix<unsigned char> fastBayerChannel(const PiiMatrix<unsigned char>& encoded,
+                                                              ImageFormat format,
+                                                              int channel);
+  /**
+   * Same as above, but for 16-bit images.
+   */
+  PII_CAMERA_EXPORT PiiMatrix<unsigned short> fastBayerChannel(const PiiMatrix<unsigned short>& encoded,
+                                                               ImageFormat format,
+                                                               int channel);
+
+  /**
+   * Decodes a Bayer-encoded image to half resolution. Each 2-by-2
+   * cell of the input is converted to one color pixel that takes its
+   * red and blue channels from the red and blue pixels of the cell.
+   * The green channel is the average of the two green pixels. No
+   * interpolation between cells is done, which makes this function
+   * many times faster than decoding the image to full resolution and
+   * scaling it down. If the size of *encoded* is odd, the last row or
+   * column is ignored.
+   */
+  PII_CAMERA_EXPORT PiiMatrix<PiiColor4<> > bayerToHalfRgb(const PiiMatrix<unsigned char>& encoded,
+                                                           ImageFormat format);
+  /**
+   * Same as above, but for 16-bit images.
+   */
+  PII_CAMERA_EXPORT PiiMatrix<PiiColor<unsigned short> > bayerToHalfRgb(const PiiMatrix<unsigned short>& encoded,
+                                                                        ImageFormat format);
 }
 
 #endif //_PIIBAYERCONVERTER_H
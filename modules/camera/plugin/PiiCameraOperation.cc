@@ -263,11 +263,18 @@ template <class T> void PiiCameraOperation::convert(void *frameBuffer,
 
             break;
           }
+        case PiiCamera::BayerRGGBFormat:
         case PiiCamera::BayerBGGRFormat:
+        case PiiCamera::BayerGBRGFormat:
+        case PiiCamera::BayerGRBGFormat:
           {
             PiiMatrix<T> image(d->iImageHeight, d->iImageWidth, frameBuffer, ownership);
-            emitImage(bayerToRgb(image, PiiCamera::BggrDecoder<T>(), PiiCamera::Rgb4Pixel<>()),
-                      Pii::ReleaseOwnership, frameIndex, elapsedTime);
+            if (d->imageType == GrayScale)
+              emitImage(PiiCamera::fastBayerToGray(image, d->imageFormat),
+                        Pii::ReleaseOwnership, frameIndex, elapsedTime);
+            else
+              emitImage(PiiCamera::fastBayerToRgb(image, d->imageFormat),
+                        Pii::ReleaseOwnership, frameIndex, elapsedTime);
             break;
           }
         default:
@@ -33,4 +33,20 @@ PII_DEFAULT_DISTANCE_MEASURE_DEF(PiiAbsDiffDistance)
   return distance;
 }
 
+/// @internal
+template <class FeatureIterator> struct PiiDistanceKernel<PiiAbsDiffDistance<FeatureIterator> > :
+  PiiDistanceKernelBase<PiiAbsDiffDistance<FeatureIterator>,
+                        PiiDistanceKernel<PiiAbsDiffDistance<FeatureIterator> >,
+                        true>
+{};
+
+/// @internal
+template <> struct PII_CLASSIFICATION_EXPORT PiiDistanceKernel<PiiAbsDiffDistance<const float*> > :
+  PiiDistanceKernelBase<PiiAbsDiffDistance<const float*>,
+                        PiiDistanceKernel<PiiAbsDiffDistance<const float*> >,
+                        true>
+{
+  static double distance(const PiiAbsDiffDistance<const float*>& measure, const float* sample, const float* model, int length);
+};
+
 #endif //_PIIABSDIFFDISTANCE_H
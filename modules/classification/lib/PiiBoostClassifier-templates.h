@@ -129,6 +129,7 @@ void PiiBoostClassifier<SampleSet>::learn(const SampleSet& samples,
         vecWeights.fill(1.0 / iSamples, iSamples);
     }
 
+  LearningGuard guard(d->pFactory, this, samples);
   QVector<double> vecHypotheses(iSamples);
   double dMinError = 1;
   while (d->lstClassifiers.size() < d->iMaxClassifiers)
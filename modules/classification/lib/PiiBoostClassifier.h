@@ -66,6 +66,7 @@ public:
    * PiiBoostClassifier.
    *
    * @see PiiDefaultClassifierFactory
+   * @see PiiDecisionStumpFactory
    */
   class Factory
   {
@@ -88,6 +89,30 @@ public:
                                              const SampleSet& samples,
                                              const QVector<double>& labels,
                                              const QVector<double>& weights) = 0;
+
+    /**
+     * Called by [PiiBoostClassifier::learn()] before the first weak
+     * classifier is created. A factory can use this function to
+     * prepare data that is reused in all calls to [create()] during a
+     * training session. *samples* stays valid and unchanged until
+     * [finishLearning()] is called. The default implementation does
+     * nothing.
+     */
+    virtual void startLearning(PiiBoostClassifier<SampleSet>* classifier,
+                               const SampleSet& samples)
+    {
+      Q_UNUSED(classifier); Q_UNUSED(samples);
+    }
+
+    /**
+     * Called by [PiiBoostClassifier::learn()] when training has
+     * finished, whether successfully or not. The default
+     * implementation does nothing.
+     */
+    virtual void finishLearning(PiiBoostClassifier<SampleSet>* classifier)
+    {
+      Q_UNUSED(classifier);
+    }
   };
 
   /**
@@ -192,6 +217,23 @@ protected:
   static QString tr(const char* s) { return QCoreApplication::translate("PiiBoostClassifier", s); }
 
 private:
+  // Calls Factory::startLearning() and Factory::finishLearning()
+  // even if learn() is interrupted by an exception.
+  class LearningGuard
+  {
+  public:
+    LearningGuard(Factory* factory, PiiBoostClassifier* classifier, const SampleSet& samples) :
+      _pFactory(factory), _pClassifier(classifier)
+    {
+      _pFactory->startLearning(_pClassifier, samples);
+    }
+    ~LearningGuard() { _pFactory->finishLearning(_pClassifier); }
+
+  private:
+    Factory* _pFactory;
+    PiiBoostClassifier* _pClassifier;
+  };
+
   double updateWeights(const SampleSet& samples,
                        const QVector<double>& labels,
                        const QVector<double>& hypotheses,
@@ -36,4 +36,12 @@ PII_DEFAULT_DISTANCE_MEASURE_DEF(PiiChiSquaredDistance)
   return sum;
 }
 
+/// @internal
+template <> struct PII_CLASSIFICATION_EXPORT PiiDistanceKernel<PiiChiSquaredDistance<const float*> > :
+  PiiDistanceKernelBase<PiiChiSquaredDistance<const float*>,
+                        PiiDistanceKernel<PiiChiSquaredDistance<const float*> > >
+{
+  static double distance(const PiiChiSquaredDistance<const float*>& measure, const float* sample, const float* model, int length);
+};
+
 #endif //_PIICHISQUAREDDISTANCE_H
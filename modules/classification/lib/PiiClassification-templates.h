@@ -18,6 +18,7 @@
 #endif
 
 #include <PiiMathDefs.h>
+#include <PiiRandom.h>
 
 namespace PiiClassification
 {
@@ -106,29 +107,89 @@ namespace PiiClassification
   }
 
 
+  /// @internal
+  template <class SampleSet>
+  QVector<typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator> sampleIterators(const SampleSet& samples)
+  {
+    const int iSamples = PiiSampleSet::sampleCount(samples);
+    QVector<typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator> vecIterators(iSamples);
+    for (int i=0; i<iSamples; ++i)
+      vecIterators[i] = PiiSampleSet::sampleAt(samples, i);
+    return vecIterators;
+  }
+
+  template <class SampleSet, class DistanceMeasure>
+  PiiMatrix<double> calculateDistanceMatrix(const SampleSet& samples,
+                                            const SampleSet& models,
+                                            const DistanceMeasure& measure)
+  {
+    const int iSamples = PiiSampleSet::sampleCount(samples),
+      iModels = PiiSampleSet::sampleCount(models);
+    PiiMatrix<double> result(PiiMatrix<double>::uninitialized(iSamples, iModels));
+    if (iSamples == 0 || iModels == 0)
+      return result;
+
+    const QVector<typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator>
+      vecSamples(sampleIterators(samples)), vecModels(sampleIterators(models));
+    // Rows of the result may be padded. Calculate one row at a time if
+    // they are.
+    const bool bContiguous = iSamples == 1 || result[1] == result[0] + iModels;
+    PiiDistanceKernel<DistanceMeasure>::calculateDistances(measure,
+                                                           vecSamples.constData(), bContiguous ? iSamples : 1,
+                                                           vecModels.constData(), iModels,
+                                                           PiiSampleSet::featureCount(models),
+                                                           result[0]);
+    if (!bContiguous)
+      for (int i=1; i<iSamples; ++i)
+        PiiDistanceKernel<DistanceMeasure>::calculateDistances(measure,
+                                                               vecSamples.constData() + i, 1,
+                                                               vecModels.constData(), iModels,
+                                                               PiiSampleSet::featureCount(models),
+                                                               result[i]);
+    return result;
+  }
+
   template <class SampleSet, class DistanceMeasure>
   int findClosestMatch(typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator sample,
                        const SampleSet& modelSet,
                        const DistanceMeasure& measure,
                        double* distance)
   {
-    const int iModels = PiiSampleSet::sampleCount(modelSet),
-      iFeatures = PiiSampleSet::featureCount(modelSet);
+    const QVector<typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator>
+      vecModels(sampleIterators(modelSet));
 
     double dMinDistance = INFINITY;
-    int minIndex = -1;
-    for (int modelIndex = 0; modelIndex < iModels; ++modelIndex)
-      {
-        double d = measure(sample, modelSet[modelIndex], iFeatures);
-        if (d < dMinDistance)
-          {
-            minIndex = modelIndex;
-            dMinDistance = d;
-          }
-      }
+    int iMinIndex = -1;
+    PiiDistanceKernel<DistanceMeasure>::findClosestMatches(measure,
+                                                           &sample, 1,
+                                                           vecModels.constData(), vecModels.size(),
+                                                           PiiSampleSet::featureCount(modelSet),
+                                                           &iMinIndex, &dMinDistance);
     if (distance != 0)
       *distance = dMinDistance;
-    return minIndex;
+    return iMinIndex;
+  }
+
+  template <class SampleSet, class DistanceMeasure>
+  QVector<int> findClosestMatchBatch(const SampleSet& samples,
+                                     const SampleSet& modelSet,
+                                     const DistanceMeasure& measure,
+                                     QVector<double>* distances)
+  {
+    const QVector<typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator>
+      vecSamples(sampleIterators(samples)), vecModels(sampleIterators(modelSet));
+    const int iSamples = vecSamples.size();
+
+    QVector<int> vecIndices(iSamples);
+    QVector<double> vecDistances(iSamples);
+    PiiDistanceKernel<DistanceMeasure>::findClosestMatches(measure,
+                                                           vecSamples.constData(), iSamples,
+                                                           vecModels.constData(), vecModels.size(),
+                                                           PiiSampleSet::featureCount(modelSet),
+                                                           vecIndices.data(), vecDistances.data());
+    if (distances != 0)
+      *distances = vecDistances;
+    return vecIndices;
   }
 
   template <class SampleSet, class DistanceMeasure>
@@ -137,32 +198,80 @@ namespace PiiClassification
                                const DistanceMeasure& measure,
                                int n)
   {
-    const int iModels = PiiSampleSet::sampleCount(modelSet),
-      iFeatures = PiiSampleSet::featureCount(modelSet);
+    const QVector<typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator>
+      vecModels(sampleIterators(modelSet));
+    const int iModels = vecModels.size();
+    QVector<double> vecDistances(iModels);
+    PiiDistanceKernel<DistanceMeasure>::calculateDistances(measure,
+                                                           &sample, 1,
+                                                           vecModels.constData(), iModels,
+                                                           PiiSampleSet::featureCount(modelSet),
+                                                           vecDistances.data());
     MatchList heap;
     heap.fill(qMin(iModels, n), qMakePair(double(INFINITY), -1));
     // Heap ensures that only shortest distances will be preserved
     for (int modelIndex = 0; modelIndex < iModels; ++modelIndex)
-      heap.put(qMakePair(measure(sample, PiiSampleSet::sampleAt(modelSet, modelIndex), iFeatures),
-                         modelIndex));
+      heap.put(qMakePair(vecDistances[modelIndex], modelIndex));
     // Ascending order -> first is the best match
     heap.sort();
     return heap;
   }
 
   template <class SampleSet, class DistanceMeasure>
-  double knnClassify(typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator sample,
-                     const SampleSet& modelSet,
-                     const QVector<double>& labels,
-                     const DistanceMeasure& measure,
-                     int k,
-                     double* distance,
-                     int* closestIndex)
+  QList<MatchList> findClosestMatchesBatch(const SampleSet& samples,
+                                           const SampleSet& modelSet,
+                                           const DistanceMeasure& measure,
+                                           int n)
+  {
+    // Distances are calculated for this many samples and models at a
+    // time.
+    const int iSampleBlockSize = 64, iModelBlockSize = 1024;
+    const QVector<typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator>
+      vecSamples(sampleIterators(samples)), vecModels(sampleIterators(modelSet));
+    const int iSamples = vecSamples.size(), iModels = vecModels.size(),
+      iFeatures = PiiSampleSet::featureCount(modelSet);
+
+    QList<MatchList> lstMatches;
+    MatchList emptyHeap;
+    emptyHeap.fill(qMin(iModels, n), qMakePair(double(INFINITY), -1));
+    for (int i=0; i<iSamples; ++i)
+      lstMatches << emptyHeap;
+
+    QVector<double> vecDistances(qMin(iSampleBlockSize, iSamples) * qMin(iModelBlockSize, iModels));
+    for (int iFirstSample=0; iFirstSample<iSamples; iFirstSample += iSampleBlockSize)
+      {
+        const int iSampleCount = qMin(iSampleBlockSize, iSamples - iFirstSample);
+        for (int iFirstModel=0; iFirstModel<iModels; iFirstModel += iModelBlockSize)
+          {
+            const int iModelCount = qMin(iModelBlockSize, iModels - iFirstModel);
+            PiiDistanceKernel<DistanceMeasure>::calculateDistances(measure,
+                                                                   vecSamples.constData() + iFirstSample, iSampleCount,
+                                                                   vecModels.constData() + iFirstModel, iModelCount,
+                                                                   iFeatures,
+                                                                   vecDistances.data());
+            const double* pDistances = vecDistances.constData();
+            for (int s=0; s<iSampleCount; ++s)
+              {
+                MatchList& heap = lstMatches[iFirstSample + s];
+                for (int m=0; m<iModelCount; ++m, ++pDistances)
+                  heap.put(qMakePair(*pDistances, iFirstModel + m));
+              }
+          }
+      }
+    for (int i=0; i<iSamples; ++i)
+      lstMatches[i].sort();
+    return lstMatches;
+  }
+
+  /// @internal
+  inline double knnVote(const MatchList& closest,
+                        const QVector<double>& labels,
+                        double* distance,
+                        int* closestIndex)
   {
-    MatchList lstClosest = findClosestMatches(sample, modelSet, measure, k);
-    // May be smaller than original if we have less samples in the
+    // May be smaller than original k if we have less samples in the
     // model set.
-    k = lstClosest.size();
+    const int k = closest.size();
 
     if (k == 0) // empty set
       return NAN;
@@ -172,7 +281,7 @@ namespace PiiClassification
 
     // Store class labels corresponding to the closest samples.
     for (int i=0; i<k; ++i)
-      pClosestLabels[i] = labels[lstClosest[i].second];
+      pClosestLabels[i] = labels[closest[i].second];
     // Find the class label with the most occurrences.
     for (int i=0; i<k; ++i)
       {
@@ -189,12 +298,50 @@ namespace PiiClassification
           }
       }
     if (distance != 0)
-      *distance = lstClosest[iBestLabel].first;
+      *distance = closest[iBestLabel].first;
     if (closestIndex != 0)
-      *closestIndex = lstClosest[iBestLabel].second;
+      *closestIndex = closest[iBestLabel].second;
     return pClosestLabels[iBestLabel];
   }
 
+  template <class SampleSet, class DistanceMeasure>
+  double knnClassify(typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator sample,
+                     const SampleSet& modelSet,
+                     const QVector<double>& labels,
+                     const DistanceMeasure& measure,
+                     int k,
+                     double* distance,
+                     int* closestIndex)
+  {
+    return knnVote(findClosestMatches(sample, modelSet, measure, k), labels, distance, closestIndex);
+  }
+
+  template <class SampleSet, class DistanceMeasure>
+  QVector<double> knnClassifyBatch(const SampleSet& samples,
+                                   const SampleSet& modelSet,
+                                   const QVector<double>& labels,
+                                   const DistanceMeasure& measure,
+                                   int k,
+                                   QVector<double>* distances,
+                                   QVector<int>* closestIndices)
+  {
+    const QList<MatchList> lstMatches(findClosestMatchesBatch(samples, modelSet, measure, k));
+    const int iSamples = lstMatches.size();
+    QVector<double> vecLabels(iSamples), vecDistances(iSamples);
+    QVector<int> vecIndices(iSamples);
+    for (int i=0; i<iSamples; ++i)
+      {
+        vecDistances[i] = INFINITY;
+        vecIndices[i] = -1;
+        vecLabels[i] = knnVote(lstMatches[i], labels, &vecDistances[i], &vecIndices[i]);
+      }
+    if (distances != 0)
+      *distances = vecDistances;
+    if (closestIndices != 0)
+      *closestIndices = vecIndices;
+    return vecLabels;
+  }
+
   template <class FeatureIterator, class ConstFeatureIterator>
   void adaptVector(FeatureIterator code,
                    ConstFeatureIterator sample,
@@ -212,6 +359,8 @@ namespace PiiClassification
                    const DistanceMeasure& measure,
                    unsigned int maxIterations)
   {
+    typedef typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator ConstFeatureIterator;
+    typedef typename PiiSampleSet::Traits<SampleSet>::FeatureType FeatureType;
     const int iSamples = PiiSampleSet::sampleCount(samples),
       iFeatures = PiiSampleSet::featureCount(samples);
 
@@ -219,35 +368,71 @@ namespace PiiClassification
     if (int(k) >= iSamples)
       return resultSet;
 
-    // First initialize the centroids by random selection
-    for (int i=k; i--; )
-      // OK, this is a bad thing, but we don't need a really good random
-      // number here.
-      PiiSampleSet::append(resultSet, PiiSampleSet::sampleAt(samples,rand() % iSamples));
-
-    // Allocate storage for temporary mean vectors
-    SampleSet centroidSet(resultSet);
+    // Select initial centroids with k-means++. Each new centroid is
+    // selected with a probability proportional to its distance to the
+    // closest centroid selected so far.
+    const QVector<ConstFeatureIterator> vecSamples(sampleIterators(samples));
+    QVector<double> vecMinDistances(iSamples, INFINITY), vecDistances(iSamples);
+    int iSelected = qMin(int(Pii::uniformRandom() * iSamples), iSamples-1);
+    for (int c=0; c<int(k); ++c)
+      {
+        PiiSampleSet::append(resultSet, vecSamples[iSelected]);
+        ConstFeatureIterator centroid = vecSamples[iSelected];
+        PiiDistanceKernel<DistanceMeasure>::calculateDistances(measure,
+                                                               vecSamples.constData(), iSamples,
+                                                               &centroid, 1,
+                                                               iFeatures,
+                                                               vecDistances.data());
+        double dSum = 0;
+        for (int i=0; i<iSamples; ++i)
+          {
+            vecMinDistances[i] = qMin(vecMinDistances[i], vecDistances[i]);
+            dSum += vecMinDistances[i];
+          }
+        double dLimit = Pii::uniformRandom() * dSum;
+        iSelected = qMin(int(Pii::uniformRandom() * iSamples), iSamples-1);
+        if (dSum > 0)
+          for (int i=0; i<iSamples; ++i)
+            if (vecMinDistances[i] > 0)
+              {
+                iSelected = i;
+                dLimit -= vecMinDistances[i];
+                if (dLimit < 0)
+                  break;
+              }
+      }
 
-    // Stores the number of samples per centroid.
-    QVector<int> hitCounts(k, 0);
+    // Storage for the sums of samples in each cluster
+    QVector<double> vecSums(k * iFeatures);
+    QVector<int> vecCounts(k);
+    QVector<FeatureType> vecCentroid(iFeatures);
 
     unsigned int iterationCount = 0;
     while (maxIterations == 0 ||
            iterationCount < maxIterations)
       {
-        hitCounts.fill(0);
         // Classify all samples to the closest centroid
+        const QVector<int> vecIndices(findClosestMatchBatch(samples, resultSet, measure));
+        vecSums.fill(0);
+        vecCounts.fill(0);
         for (int i=0; i<iSamples; ++i)
           {
-            // This is the closest centroid
-            int centroidIndex = findClosestMatch(PiiSampleSet::sampleAt(samples,i), resultSet, measure);
-
-            // Iteratively update the mean
-            adaptVector(centroidSet[centroidIndex],
-                        PiiSampleSet::sampleAt(samples,i),
-                        iFeatures,
-                        1.0/++hitCounts[centroidIndex]);
+            double* pSum = vecSums.data() + vecIndices[i] * iFeatures;
+            for (int f=0; f<iFeatures; ++f)
+              pSum[f] += vecSamples[i][f];
+            ++vecCounts[vecIndices[i]];
           }
+
+        // Move centroids to the means of their clusters. Empty
+        // clusters stay where they were.
+        SampleSet centroidSet(resultSet);
+        for (int c=0; c<int(k); ++c)
+          if (vecCounts[c] > 0)
+            {
+              for (int f=0; f<iFeatures; ++f)
+                vecCentroid[f] = FeatureType(vecSums[c * iFeatures + f] / vecCounts[c]);
+              PiiSampleSet::setSampleAt(centroidSet, c, vecCentroid.constData());
+            }
         // Now we have the new centers. Let's see if they equal to the
         // previous ones...
         if (PiiSampleSet::equals(centroidSet, resultSet))
@@ -143,6 +143,26 @@ namespace PiiClassification
                                             bool calculateDiagonal = false);
 
 
+  /**
+   * Calculates the distances between all *samples* and all *models*.
+   * The result is a N-by-M matrix, where N is the number of samples
+   * and M the number of models. Element (r,c) stores the distance
+   * between sample r and model c. The distances are calculated in
+   * blocks with the [PiiDistanceKernel] of *measure*, which may use
+   * faster algorithms than comparing the vectors pair by pair.
+   *
+   * ~~~(c++)
+   * PiiMatrix<float> matSamples(100,16), matModels(1000,16);
+   * PiiMatrix<double> matDistances =
+   *   PiiClassification::calculateDistanceMatrix(matSamples, matModels,
+   *                                              PiiSquaredGeometricDistance<const float*>());
+   * ~~~
+   */
+  template <class SampleSet, class DistanceMeasure>
+  PiiMatrix<double> calculateDistanceMatrix(const SampleSet& samples,
+                                            const SampleSet& models,
+                                            const DistanceMeasure& measure);
+
   /**
    * Find the closest match for *sample* in *modelSet*.
    *
@@ -176,6 +196,43 @@ namespace PiiClassification
                        const DistanceMeasure& measure,
                        double* distance = 0);
 
+  /**
+   * Finds the closest match for each sample in *samples*. This is
+   * like calling [findClosestMatch()] for each sample separately, but
+   * faster. Polymorphic distance measures are invoked once for the
+   * whole batch, and measures that are sums over features (e.g.
+   * PiiSquaredGeometricDistance) stop comparing a model as soon as
+   * its partial distance exceeds that of the best match so far. Since
+   * the floating-point operations are not done in the same order,
+   * models at (nearly) equal distances may be chosen differently.
+   *
+   * @param samples the samples to classify
+   *
+   * @param modelSet the model samples to compare *samples* against.
+   *
+   * @param measure the distance measure.
+   *
+   * @param distances an optional output-value parameter that will
+   * store the distance to the closest model for each sample.
+   *
+   * @return the index of the closest model for each sample. -1 means
+   * that no match was found.
+   *
+   * ~~~(c++)
+   * PiiMatrix<float> matObserved(20,2); // 20 observed samples
+   * QVector<double> vecDistances;
+   * QVector<int> vecMatches = PiiClassification::findClosestMatchBatch(matObserved,
+   *                                                                    matSamples,
+   *                                                                    dist,
+   *                                                                    &vecDistances);
+   * ~~~
+   */
+  template <class SampleSet, class DistanceMeasure>
+  QVector<int> findClosestMatchBatch(const SampleSet& samples,
+                                     const SampleSet& modelSet,
+                                     const DistanceMeasure& measure,
+                                     QVector<double>* distances = 0);
+
   /**
    * The data structure used as a priority queue in k-NN searches.
    * Each element in a match list contains a distance to a sample and
@@ -218,6 +275,20 @@ namespace PiiClassification
                                const DistanceMeasure& measure,
                                int n);
 
+  /**
+   * Finds the *n* closest matches for each sample in *samples*. This
+   * is equivalent to calling [findClosestMatches()] for each sample,
+   * but calculates the distances in blocks of samples and models.
+   *
+   * @return a list of matches for each sample. See
+   * [findClosestMatches()].
+   */
+  template <class SampleSet, class DistanceMeasure>
+  QList<MatchList> findClosestMatchesBatch(const SampleSet& samples,
+                                           const SampleSet& modelSet,
+                                           const DistanceMeasure& measure,
+                                           int n);
+
   /**
    * Classify a sample using the *k nearest neighbors* rule.
    * This function compares *sample* to each model in *modelSet*, to
@@ -261,6 +332,32 @@ namespace PiiClassification
                      double* distance = 0,
                      int* closestIndex = 0);
 
+  /**
+   * Classifies each sample in *samples* using the *k nearest
+   * neighbors* rule. This is equivalent to calling [knnClassify()]
+   * for each sample, but uses [findClosestMatchesBatch()] to find
+   * the neighbors.
+   *
+   * @param distances an optional output value that, if non-zero,
+   * will store the distance to the closest sample of the winning
+   * class for each sample.
+   *
+   * @param closestIndices an optional output value that, if
+   * non-zero, will store the index of the closest model sample of the
+   * winning class for each sample.
+   *
+   * @return the class label of each sample. `NaN` if *modelSet* is
+   * empty.
+   */
+  template <class SampleSet, class DistanceMeasure>
+  QVector<double> knnClassifyBatch(const SampleSet& samples,
+                                   const SampleSet& modelSet,
+                                   const QVector<double>& labels,
+                                   const DistanceMeasure& measure,
+                                   int k,
+                                   QVector<double>* distances = 0,
+                                   QVector<int>* closestIndices = 0);
+
   /**
    * Adapt a *code* vector towards *sample* with the given strength
    * *alpha*. The code vector will be modified in place. The function
@@ -301,7 +398,13 @@ namespace PiiClassification
    * and \(\mu_i\) is the centroid or mean point of all the points
    * \(x_j \in S_i\). This implementation uses an iterative
    * refinement heuristic known as Lloyd's algorithm to solve the
-   * optimization problem.
+   * optimization problem. The initial centroids are selected with
+   * k-means++, using *measure* instead of the squared distance.
+   *
+   * This function works with any distance measure. With geometric
+   * distances, PiiKMeans is much faster: it avoids most distance
+   * calculations, runs in parallel, and supports mini-batch
+   * clustering of large sample sets.
    *
    * @param samples a set of feature vectors to run the algorithm on.
    * Each row of this matrix represents a feature vector. The number
@@ -43,13 +43,15 @@ namespace PiiClassification
   Q_GADGET
 
   Q_ENUMS(BoostingAlgorithm
+          SplitSearchMethod
           FullBufferBehavior
           DistanceCombinationMode
           SomTopology
           SomRateFunction
           SomNeighborhood
           SomInitMode
-          SomLearningAlgorithm);
+          SomLearningAlgorithm
+          KMeansSeedingMethod);
   Q_FLAGS(LearnerCapability LearnerCapabilities);
 public:
 #endif
@@ -83,6 +85,26 @@ public:
       SammeBoost
     };
 
+  /**
+   * Ways of finding the optimal threshold for a feature in
+   * PiiDecisionStump.
+   *
+   * - `ExactSplitSearch` - every distinct feature value is tried as a
+   * threshold. The samples are sorted by each feature once, and the
+   * order is reused when the weights change.
+   *
+   * - `HistogramSplitSearch` - the values of each feature are
+   * quantized into a fixed number of bins with (approximately) equal
+   * numbers of samples, and only bin boundaries are tried as
+   * thresholds. Faster and uses less memory than exact search, but
+   * may miss the optimal threshold.
+   */
+  enum SplitSearchMethod
+    {
+      ExactSplitSearch,
+      HistogramSplitSearch
+    };
+
   /**
    * Possible actions when a sample buffer is full.
    *
@@ -210,8 +232,14 @@ public:
    * the first w*h samples will be used (w and h denote SOM width and
    * height). In batch learning, initial code vectors will be randomly
    * selected from the training samples.
+   *
+   * - `SomKMeansInit` - in batch learning, initialize the code book
+   * with the centroids found by k-means clustering of the training
+   * samples (see PiiKMeans). Code vectors are then spread over the
+   * data from the start, and the map only needs to be ordered. In
+   * on-line learning, this mode works like `SomSampleInit`.
    */
-  enum SomInitMode { SomRandomInit, SomSampleInit };
+  enum SomInitMode { SomRandomInit, SomSampleInit, SomKMeansInit };
 
   /**
    * Learning algorithms for training a SOM.
@@ -233,6 +261,21 @@ public:
    * data density.
    */
   enum SomLearningAlgorithm { SomSequentialAlgorithm, SomBalancedAlgorithm, SomQErrAlgorithm };
+
+  /**
+   * Ways of choosing the initial centroids in k-means clustering.
+   *
+   * - `RandomKMeansSeeding` - *k* distinct samples are selected
+   * randomly.
+   *
+   * - `KMeansPlusPlusSeeding` - the first centroid is selected
+   * randomly. Each subsequent one is selected with a probability
+   * proportional to the squared distance to the closest centroid
+   * already selected (k-means++). This spreads the initial centroids
+   * over the data and usually makes convergence faster and the
+   * result better.
+   */
+  enum KMeansSeedingMethod { RandomKMeansSeeding, KMeansPlusPlusSeeding };
 };
 
 #endif //_PIICLASSIFICATIONGLOBAL_H
@@ -21,6 +21,7 @@
 
 #include <PiiSerialization.h>
 #include <PiiVirtualMetaObject.h>
+#include <QVector>
 
 /**
  * An interface for classification and regression algorithms. A
@@ -54,6 +55,29 @@ public:
    * classified.
    */
   virtual double classify(typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator featureVector) throw() = 0;
+
+  /**
+   * Classifies all samples in *samples*. This is equivalent to
+   * calling [classify()] for each sample, which is also what the
+   * default implementation does. Classifiers that can process many
+   * samples faster at once override this function.
+   *
+   * ~~~(c++)
+   * // Each row is the feature vector of a detected object
+   * PiiMatrix<float> matFeatures(objectCount, featureCount);
+   * QVector<double> vecLabels = classifier.classifyBatch(matFeatures);
+   * ~~~
+   *
+   * @return the classification of each sample. See [classify()].
+   */
+  virtual QVector<double> classifyBatch(const SampleSet& samples) throw()
+  {
+    const int iSamples = PiiSampleSet::sampleCount(samples);
+    QVector<double> vecResults(iSamples);
+    for (int i=0; i<iSamples; ++i)
+      vecResults[i] = classify(PiiSampleSet::sampleAt(samples, i));
+    return vecResults;
+  }
 };
 
 PII_SERIALIZATION_ABSTRACT_TEMPLATE(PiiClassifier);
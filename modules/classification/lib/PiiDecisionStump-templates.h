@@ -17,6 +17,218 @@
 # error "Never use <PiiDecisionStump-templates.h> directly; include <PiiDecisionStump.h> instead."
 #endif
 
+#include <PiiParallel.h>
+#include <algorithm>
+
+template <class SampleSet> class PiiDecisionStump<SampleSet>::PresortedSampleSet::SortFunction
+{
+public:
+  SortFunction(const PresortedSampleSet* set, int* order, unsigned char* bins, FeatureType* binLimits) :
+    _pSet(set), _pOrder(order), _pBins(bins), _pBinLimits(binLimits)
+  {}
+
+  void operator() (int first, int last) const
+  {
+    const SampleSet& samples = _pSet->_samples;
+    const int iSamples = _pSet->_iSampleCount;
+    // Features are copied out in blocks. Reading one feature at a
+    // time would make a strided pass over all samples for each
+    // feature.
+    const int iBlockSize = 16;
+    QVector<FeatureType> vecBlock(iSamples * qMin(iBlockSize, last - first));
+    QVector<QPair<FeatureType,int> > vecValues(iSamples);
+    for (int iBlockStart=first; iBlockStart<last; iBlockStart += iBlockSize)
+      {
+        const int iBlockEnd = qMin(iBlockStart + iBlockSize, last);
+        for (int i=0; i<iSamples; ++i)
+          {
+            ConstFeatureIterator sample = PiiSampleSet::sampleAt(samples, i);
+            for (int f=iBlockStart; f<iBlockEnd; ++f)
+              vecBlock[(f-iBlockStart) * iSamples + i] = sample[f];
+          }
+        for (int f=iBlockStart; f<iBlockEnd; ++f)
+          {
+            const FeatureType* pValues = vecBlock.constData() + (f-iBlockStart) * iSamples;
+            for (int i=0; i<iSamples; ++i)
+              vecValues[i] = qMakePair(pValues[i], i);
+            std::sort(vecValues.begin(), vecValues.end());
+            if (_pOrder != 0)
+              storeOrder(vecValues, _pOrder + qint64(f) * iSamples);
+            else
+              storeBins(vecValues,
+                        _pBins + qint64(f) * iSamples,
+                        _pBinLimits + f * _pSet->_iBinCount);
+          }
+      }
+  }
+
+private:
+  void storeOrder(const QVector<QPair<FeatureType,int> >& values, int* order) const
+  {
+    const int iLast = values.size() - 1;
+    for (int i=0; i<iLast; ++i)
+      order[i] = values[i].first != values[i+1].first ? ~values[i].second : values[i].second;
+    order[iLast] = ~values[iLast].second;
+  }
+
+  void storeBins(const QVector<QPair<FeatureType,int> >& values, unsigned char* bins, FeatureType* binLimits) const
+  {
+    const int iSamples = values.size(), iBinCount = _pSet->_iBinCount;
+    const double dSamplesPerBin = double(iSamples) / iBinCount;
+    int iBin = 0;
+    for (int i=0; i<iSamples; ++i)
+      {
+        bins[values[i].second] = (unsigned char)iBin;
+        // Move to the next bin only at the end of a run of equal
+        // values.
+        if (i == iSamples-1 || values[i].first != values[i+1].first)
+          {
+            binLimits[iBin] = values[i].first;
+            if (i+1 >= (iBin+1) * dSamplesPerBin && iBin < iBinCount-1)
+              ++iBin;
+          }
+      }
+    for (int b=iBin+1; b<iBinCount; ++b)
+      binLimits[b] = values[iSamples-1].first;
+  }
+
+  const PresortedSampleSet* _pSet;
+  int* _pOrder;
+  unsigned char* _pBins;
+  FeatureType* _pBinLimits;
+};
+
+template <class SampleSet> class PiiDecisionStump<SampleSet>::SplitFunction
+{
+public:
+  SplitFunction(const PresortedSampleSet* samples,
+                const WeightedLabel* labels,
+                const QVector<double>& weightTotals,
+                double totalWeightSum,
+                Split* splits) :
+    _pSamples(samples), _pLabels(labels), _vecWeightTotals(weightTotals),
+    _dTotalWeightSum(totalWeightSum), _pSplits(splits)
+  {}
+
+  void operator() (int first, int last) const
+  {
+    if (_pSamples->_method == PiiClassification::ExactSplitSearch)
+      searchExact(first, last);
+    else
+      searchHistogram(first, last);
+  }
+
+private:
+  inline void evaluate(const double* leftWeights, Split& split, int sample, int bin) const
+  {
+    int iLeftLabel = 0, iRightLabel = 0;
+    const double dError = optimizeSplit(leftWeights, _vecWeightTotals, _dTotalWeightSum,
+                                        &iLeftLabel, &iRightLabel);
+    if (dError < split.dError)
+      {
+        split.dError = dError;
+        split.iLeftLabel = iLeftLabel;
+        split.iRightLabel = iRightLabel;
+        split.iSample = sample;
+        split.iBin = bin;
+      }
+  }
+
+  void searchExact(int first, int last) const
+  {
+    const int iSamples = _pSamples->_iSampleCount;
+    QVector<double> vecLeftWeights(_vecWeightTotals.size());
+    double* pLeftWeights = vecLeftWeights.data();
+    for (int f=first; f<last; ++f)
+      {
+        const int* pOrder = _pSamples->_vecOrder.constData() + qint64(f) * iSamples;
+        vecLeftWeights.fill(0);
+        for (int i=0; i<iSamples; ++i)
+          {
+            int iSample = pOrder[i];
+            const bool bRunEnd = iSample < 0;
+            if (bRunEnd)
+              iSample = ~iSample;
+            pLeftWeights[_pLabels[iSample].iLabel] += _pLabels[iSample].dWeight;
+            if (bRunEnd)
+              evaluate(pLeftWeights, _pSplits[f], iSample, -1);
+          }
+      }
+  }
+
+  void searchHistogram(int first, int last) const
+  {
+    const int iSamples = _pSamples->_iSampleCount,
+      iLabels = _vecWeightTotals.size(),
+      iBinCount = _pSamples->_iBinCount;
+    QVector<double> vecLeftWeights(iLabels), vecHistogram(iBinCount * iLabels);
+    double* pLeftWeights = vecLeftWeights.data();
+    double* pHistogram = vecHistogram.data();
+    for (int f=first; f<last; ++f)
+      {
+        const unsigned char* pBins = _pSamples->_vecBins.constData() + qint64(f) * iSamples;
+        vecHistogram.fill(0);
+        for (int i=0; i<iSamples; ++i)
+          pHistogram[pBins[i] * iLabels + _pLabels[i].iLabel] += _pLabels[i].dWeight;
+
+        vecLeftWeights.fill(0);
+        for (int b=0; b<iBinCount; ++b)
+          {
+            for (int l=0; l<iLabels; ++l)
+              pLeftWeights[l] += pHistogram[b * iLabels + l];
+            evaluate(pLeftWeights, _pSplits[f], -1, b);
+          }
+      }
+  }
+
+  const PresortedSampleSet* _pSamples;
+  const WeightedLabel* _pLabels;
+  const QVector<double>& _vecWeightTotals;
+  double _dTotalWeightSum;
+  Split* _pSplits;
+};
+
+template <class SampleSet> PiiDecisionStump<SampleSet>::PresortedSampleSet::PresortedSampleSet() :
+  _method(PiiClassification::ExactSplitSearch),
+  _iSampleCount(0),
+  _iFeatureCount(0),
+  _iBinCount(0)
+{
+}
+
+template <class SampleSet>
+PiiDecisionStump<SampleSet>::PresortedSampleSet::PresortedSampleSet(const SampleSet& samples,
+                                                                     PiiClassification::SplitSearchMethod method,
+                                                                     int binCount) :
+  _samples(samples),
+  _method(method),
+  _iSampleCount(PiiSampleSet::sampleCount(samples)),
+  _iFeatureCount(PiiSampleSet::featureCount(samples)),
+  _iBinCount(qBound(2, binCount, 256))
+{
+  if (_iSampleCount == 0 || _iFeatureCount == 0)
+    return;
+
+  int* pOrder = 0;
+  unsigned char* pBins = 0;
+  FeatureType* pBinLimits = 0;
+  if (_method == PiiClassification::ExactSplitSearch)
+    {
+      _vecOrder.resize(_iSampleCount * _iFeatureCount);
+      pOrder = _vecOrder.data();
+    }
+  else
+    {
+      _vecBins.resize(_iSampleCount * _iFeatureCount);
+      _vecBinLimits.resize(_iBinCount * _iFeatureCount);
+      pBins = _vecBins.data();
+      pBinLimits = _vecBinLimits.data();
+    }
+  Pii::parallelFor(_iFeatureCount,
+                   _iSampleCount >= ParallelSortLimit ? qMin(Pii::parallelThreadCount(0), _iFeatureCount) : 1,
+                   SortFunction(this, pOrder, pBins, pBinLimits));
+}
+
 template <class SampleSet> PiiDecisionStump<SampleSet>::Data::Data() :
   iSelectedFeature(0),
   dLeftLabel(NAN),
@@ -30,13 +242,13 @@ template <class SampleSet> PiiDecisionStump<SampleSet>::PiiDecisionStump() :
 {}
 
 template <class SampleSet>
-double PiiDecisionStump<SampleSet>::optimizeSplit(const QVector<double>& leftWeights,
+double PiiDecisionStump<SampleSet>::optimizeSplit(const double* leftWeights,
                                                   const QVector<double>& weightTotals,
                                                   double totalWeightSum,
                                                   int* leftLabel, int* rightLabel)
 {
   double dMinError = INFINITY;
-  int iLabels = leftWeights.size();
+  int iLabels = weightTotals.size();
   // Try all combinations of left-right label pairs (N-N)
   for (int l=0; l<iLabels; ++l)
     for (int r=0; r<iLabels; ++r)
@@ -60,71 +272,69 @@ double PiiDecisionStump<SampleSet>::optimizeSplit(const QVector<double>& leftWei
   return dMinError;
 }
 
-
 template <class SampleSet>
 void PiiDecisionStump<SampleSet>::learn(const SampleSet& samples,
                                         const QVector<double>& labels,
                                         const QVector<double>& weights)
+{
+  learn(PresortedSampleSet(samples), labels, weights);
+}
+
+template <class SampleSet>
+void PiiDecisionStump<SampleSet>::learn(const PresortedSampleSet& samples,
+                                        const QVector<double>& labels,
+                                        const QVector<double>& weights)
 {
   PII_D;
   d->iSelectedFeature = 0;
   d->threshold = 0;
   d->dLeftLabel = d->dRightLabel = NAN;
 
-  const int iSamples = PiiSampleSet::sampleCount(samples),
-    iFeatures = PiiSampleSet::featureCount(samples);
+  const int iSamples = samples.sampleCount(), iFeatures = samples.featureCount();
+  if (iSamples == 0 || iFeatures == 0)
+    return;
 
   const QVector<double> vecWeights(weights.size() == iSamples ?
                                    weights : QVector<double>(iSamples, 1.0/iSamples));
 
-
   double dWeightSum = 0;
   // Calculate the sum of weights for each class separately
   QVector<double> vecWeightTotals;
+  QVector<WeightedLabel> vecLabels(iSamples);
   for (int i=0; i<iSamples; ++i)
     {
       int iLabel = int(labels[i]);
       if (iLabel >= vecWeightTotals.size())
         vecWeightTotals.resize(iLabel+1);
-      vecWeightTotals[iLabel] += weights[i];
-      dWeightSum += weights[i];
+      vecWeightTotals[iLabel] += vecWeights[i];
+      dWeightSum += vecWeights[i];
+      vecLabels[i].iLabel = iLabel;
+      vecLabels[i].dWeight = vecWeights[i];
     }
 
-  QVector<Feature> vecFeatures(iSamples);
-  QVector<double> vecLeftWeights(vecWeightTotals.size());
+  QVector<Split> vecSplits(iFeatures);
+  Pii::parallelFor(iFeatures,
+                   qint64(iSamples) * iFeatures >= ParallelSearchLimit ?
+                   qMin(Pii::parallelThreadCount(0), iFeatures) : 1,
+                   SplitFunction(&samples, vecLabels.constData(), vecWeightTotals,
+                                 dWeightSum, vecSplits.data()));
 
-  double dMinError = INFINITY;
+  // Ties go to the first feature, as in sequential search.
+  int iBestFeature = 0;
+  for (int f=1; f<iFeatures; ++f)
+    if (vecSplits[f].dError < vecSplits[iBestFeature].dError)
+      iBestFeature = f;
 
-  // For each feature
-  for (int f=0; f<iFeatures; ++f)
-    {
-      for (int i=0; i<iSamples; ++i)
-        vecFeatures[i] = Feature(PiiSampleSet::sampleAt(samples,i)[f], int(labels[i]), weights[i]);
-
-      // Sort according to the feature value
-      qSort(vecFeatures);
-      vecLeftWeights.fill(0);
-
-      // Calculate classification error for each threshold.
-      for (int i=0; i<iSamples; i++)
-        {
-          vecLeftWeights[vecFeatures[i].iLabel] += vecFeatures[i].dWeight;
-
-          int iLeftLabel = 0, iRightLabel = 0;
-          double dError = optimizeSplit(vecLeftWeights, vecWeightTotals,
-                                        dWeightSum,
-                                        &iLeftLabel, &iRightLabel);
-
-          if (dError < dMinError)
-            {
-              dMinError = dError;
-              d->dLeftLabel = iLeftLabel;
-              d->dRightLabel = iRightLabel;
-              d->iSelectedFeature = f;
-              d->threshold = vecFeatures[i].value;
-            }
-        }
-    }
+  const Split& best = vecSplits[iBestFeature];
+  if (best.iSample < 0 && best.iBin < 0)
+    return;
+  d->iSelectedFeature = iBestFeature;
+  d->dLeftLabel = best.iLeftLabel;
+  d->dRightLabel = best.iRightLabel;
+  if (best.iSample >= 0)
+    d->threshold = PiiSampleSet::sampleAt(samples._samples, best.iSample)[iBestFeature];
+  else
+    d->threshold = samples._vecBinLimits[iBestFeature * samples._iBinCount + best.iBin];
 
   //piiDebug("Selected feature %d, threshold %lf (%d|%d)", d->iSelectedFeature, double(d->threshold), int(d->dLeftLabel), int(d->dRightLabel));
 }
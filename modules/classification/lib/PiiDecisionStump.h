@@ -20,6 +20,7 @@
 #include "PiiClassifier.h"
 
 #include <PiiSerializationTraits.h>
+#include <QVector>
 
 /**
  * A primitive learner that works by thresholding a single feature. A
@@ -33,6 +34,22 @@
  * stump that selects not only the optimal threshold but also two
  * classes that are optimally separated by the threshold.
  *
+ * Features are evaluated in parallel. Training is dominated by
+ * sorting the samples by each feature. When the same samples are
+ * used many times with different weights, as in boosting, the
+ * samples should be sorted only once into a [PresortedSampleSet]:
+ *
+ * ~~~(c++)
+ * PiiDecisionStump<PiiMatrix<float> >::PresortedSampleSet presorted(matSamples);
+ * PiiDecisionStump<PiiMatrix<float> > stump;
+ * for (int i=0; i<10; ++i)
+ *   {
+ *     stump.learn(presorted, vecLabels, vecWeights);
+ *     updateWeights(stump, vecWeights);
+ *   }
+ * ~~~
+ *
+ * @see PiiDecisionStumpFactory
  */
 template <class SampleSet> class PiiDecisionStump :
   public PiiClassifier<SampleSet>,
@@ -42,16 +59,99 @@ public:
   typedef typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator ConstFeatureIterator;
   typedef typename PiiSampleSet::Traits<SampleSet>::FeatureType FeatureType;
 
+  /**
+   * A sample set that has been prepared for training decision stumps
+   * many times. Depending on the split search method, the
+   * preparation either sorts the samples by each feature or quantizes
+   * the feature values into histogram bins. Both take O(F N log N)
+   * time, where F is the number of features and N the number of
+   * samples, and are done in parallel.
+   *
+   * After preparation, [learn()] takes O(F N) time. Exact search
+   * stores a sample index for each feature value (four bytes per
+   * value), histogram search stores a bin index (one byte per value).
+   * The original samples are implicitly shared, not copied.
+   */
+  class PresortedSampleSet
+  {
+  public:
+    /**
+     * Constructs an empty sample set.
+     */
+    PresortedSampleSet();
+    /**
+     * Prepares *samples* for split search with the given *method*.
+     *
+     * @param binCount the maximum number of histogram bins for each
+     * feature, in the range [2, 256]. Used only with
+     * `HistogramSplitSearch`.
+     */
+    PresortedSampleSet(const SampleSet& samples,
+                       PiiClassification::SplitSearchMethod method = PiiClassification::ExactSplitSearch,
+                       int binCount = 256);
+
+    /**
+     * Returns the number of samples.
+     */
+    int sampleCount() const { return _iSampleCount; }
+    /**
+     * Returns the number of features in each sample.
+     */
+    int featureCount() const { return _iFeatureCount; }
+    /**
+     * Returns the split search method.
+     */
+    PiiClassification::SplitSearchMethod splitSearchMethod() const { return _method; }
+    /**
+     * Returns the original samples.
+     */
+    SampleSet samples() const { return _samples; }
+
+  private:
+    friend class PiiDecisionStump;
+    class SortFunction;
+
+    SampleSet _samples;
+    PiiClassification::SplitSearchMethod _method;
+    int _iSampleCount, _iFeatureCount, _iBinCount;
+    /* Exact search: sample indices sorted by each feature value,
+       _iSampleCount entries for each feature. The last index in each
+       run of equal values is stored as ~index (negative), because a
+       threshold can only be placed there. */
+    QVector<int> _vecOrder;
+    /* Histogram search: the bin of each sample, _iSampleCount entries
+       for each feature. */
+    QVector<unsigned char> _vecBins;
+    /* The largest value in each bin, _iBinCount entries for each
+       feature. Unused bins are never referenced by _vecBins. */
+    QVector<FeatureType> _vecBinLimits;
+  };
+
   PiiDecisionStump();
 
   /**
    * Finds the feature that best separates the two classes present in
-   * *samples* and an optimal threshold for it.
+   * *samples* and an optimal threshold for it. This function sorts
+   * the samples and calls [learn(const PresortedSampleSet&, const
+   * QVector<double>&, const QVector<double>&)].
+   *
+   * @param weights sample weights. If the size of *weights* does not
+   * match the number of samples, all samples will be weighted
+   * equally.
    */
   void learn(const SampleSet& samples,
              const QVector<double>& labels,
              const QVector<double>& weights);
 
+  /**
+   * Finds the best feature and threshold using a presorted sample set.
+   * If the samples are presorted for `HistogramSplitSearch`, the
+   * thresholds are limited to bin boundaries.
+   */
+  void learn(const PresortedSampleSet& samples,
+             const QVector<double>& labels,
+             const QVector<double>& weights);
+
   /**
    * Returns [leftLabel()] if the [selectedFeature()] "selected
    * feature" is less than or equal to [threshold()] and [rightLabel()]
@@ -91,18 +191,34 @@ public:
   double rightLabel() const;
 
 private:
-  /// @internal
-  struct Feature
+  // The label and weight of a sample, stored together for cache
+  // efficiency.
+  struct WeightedLabel
   {
-    Feature() : value(0), iLabel(0), dWeight(0) {}
-    Feature(FeatureType v, int l, double w) : value(v), iLabel(l), dWeight(w) {}
-
-    FeatureType value;
     int iLabel;
     double dWeight;
+  };
+
+  // The best split found for a single feature.
+  struct Split
+  {
+    Split() : dError(INFINITY), iLeftLabel(0), iRightLabel(0), iSample(-1), iBin(-1) {}
+    double dError;
+    int iLeftLabel, iRightLabel;
+    // The threshold is the feature value of this sample (exact
+    // search) or the limit of this bin (histogram search).
+    int iSample, iBin;
+  };
+
+  class SplitFunction;
 
-    bool operator< (const Feature& other) const { return value < other.value; }
-    bool operator> (const Feature& other) const { return value > other.value; }
+  enum
+  {
+    // Presorting runs in one thread below this number of samples.
+    ParallelSortLimit = 4096,
+    // Split search runs in one thread below this number of feature
+    // values.
+    ParallelSearchLimit = 65536
   };
 
   /// @internal
@@ -117,10 +233,10 @@ private:
   };
   PII_D_FUNC;
 
-  double optimizeSplit(const QVector<double>& leftWeights,
-                       const QVector<double>& weightTotals,
-                       double totalWeightSum,
-                       int* leftLabel, int* rightLabel);
+  static double optimizeSplit(const double* leftWeights,
+                              const QVector<double>& weightTotals,
+                              double totalWeightSum,
+                              int* leftLabel, int* rightLabel);
   friend struct PiiSerialization::Accessor;
   PII_DECLARE_VIRTUAL_METAOBJECT_FUNCTION;
   template <class Archive> void serialize(Archive& archive, const unsigned int)
@@ -0,0 +1,133 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIIDECISIONSTUMPFACTORY_H
+#define _PIIDECISIONSTUMPFACTORY_H
+
+#include "PiiBoostClassifier.h"
+#include "PiiDecisionStump.h"
+
+/**
+ * A PiiBoostClassifier::Factory that creates decision stumps. Unlike
+ * PiiDefaultClassifierFactory, this factory prepares the training
+ * samples only once per training session. The samples are presorted
+ * into a PiiDecisionStump::PresortedSampleSet when boosting starts,
+ * and each round only scans the sorted features with new weights.
+ * This removes the O(N log N) sorting step from all but the first
+ * round.
+ *
+ * ~~~(c++)
+ * PiiDecisionStumpFactory<PiiMatrix<float> > factory;
+ * factory.setSplitSearchMethod(PiiClassification::HistogramSplitSearch);
+ * PiiBoostClassifier<PiiMatrix<float> > classifier(&factory);
+ * classifier.learn(matSamples, vecLabels, QVector<double>());
+ * ~~~
+ *
+ * @see PiiDecisionStump
+ */
+template <class SampleSet> class PiiDecisionStumpFactory :
+  public PiiBoostClassifier<SampleSet>::Factory
+{
+public:
+  PiiDecisionStumpFactory() :
+    _splitSearchMethod(PiiClassification::ExactSplitSearch),
+    _iBinCount(256),
+    _bLearning(false)
+  {}
+
+  /**
+   * Sets the split search method used by the created decision
+   * stumps. The default is `ExactSplitSearch`.
+   */
+  void setSplitSearchMethod(PiiClassification::SplitSearchMethod splitSearchMethod) { _splitSearchMethod = splitSearchMethod; }
+  PiiClassification::SplitSearchMethod splitSearchMethod() const { return _splitSearchMethod; }
+
+  /**
+   * Sets the maximum number of histogram bins for each feature with
+   * `HistogramSplitSearch`. The default is 256.
+   */
+  void setBinCount(int binCount) { _iBinCount = binCount; }
+  int binCount() const { return _iBinCount; }
+
+  /**
+   * Presorts *samples*.
+   */
+  void startLearning(PiiBoostClassifier<SampleSet>* classifier,
+                     const SampleSet& samples);
+
+  /**
+   * Creates a new decision stump and trains it with the presorted
+   * samples. If called outside of a training session, or with a
+   * different sample set, *samples* will be sorted for this call
+   * only.
+   */
+  PiiDecisionStump<SampleSet>* create(PiiBoostClassifier<SampleSet>* classifier,
+                                      const SampleSet& samples,
+                                      const QVector<double>& labels,
+                                      const QVector<double>& weights);
+
+  /**
+   * Releases the presorted samples.
+   */
+  void finishLearning(PiiBoostClassifier<SampleSet>* classifier);
+
+private:
+  PiiClassification::SplitSearchMethod _splitSearchMethod;
+  int _iBinCount;
+  bool _bLearning;
+  typename PiiDecisionStump<SampleSet>::PresortedSampleSet _presortedSamples;
+};
+
+template <class SampleSet>
+void PiiDecisionStumpFactory<SampleSet>::startLearning(PiiBoostClassifier<SampleSet>* classifier,
+                                                       const SampleSet& samples)
+{
+  Q_UNUSED(classifier);
+  _presortedSamples = typename PiiDecisionStump<SampleSet>::PresortedSampleSet(samples,
+                                                                               _splitSearchMethod,
+                                                                               _iBinCount);
+  _bLearning = true;
+}
+
+template <class SampleSet>
+PiiDecisionStump<SampleSet>* PiiDecisionStumpFactory<SampleSet>::create(PiiBoostClassifier<SampleSet>* classifier,
+                                                                        const SampleSet& samples,
+                                                                        const QVector<double>& labels,
+                                                                        const QVector<double>& weights)
+{
+  Q_UNUSED(classifier);
+  PiiDecisionStump<SampleSet>* pStump = new PiiDecisionStump<SampleSet>;
+  if (_bLearning &&
+      _presortedSamples.sampleCount() == PiiSampleSet::sampleCount(samples) &&
+      _presortedSamples.featureCount() == PiiSampleSet::featureCount(samples))
+    pStump->learn(_presortedSamples, labels, weights);
+  else
+    pStump->learn(typename PiiDecisionStump<SampleSet>::PresortedSampleSet(samples,
+                                                                          _splitSearchMethod,
+                                                                          _iBinCount),
+                  labels, weights);
+  return pStump;
+}
+
+template <class SampleSet>
+void PiiDecisionStumpFactory<SampleSet>::finishLearning(PiiBoostClassifier<SampleSet>* classifier)
+{
+  Q_UNUSED(classifier);
+  _presortedSamples = typename PiiDecisionStump<SampleSet>::PresortedSampleSet();
+  _bLearning = false;
+}
+
+#endif //_PIIDECISIONSTUMPFACTORY_H
@@ -0,0 +1,345 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiSquaredGeometricDistance.h"
+#include "PiiAbsDiffDistance.h"
+#include "PiiChiSquaredDistance.h"
+#include "PiiHistogramIntersection.h"
+#include <QVector>
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+namespace
+{
+  // The norm form pays off only if the norms of the models can be
+  // reused for many samples.
+  const int iNormFormMinSamples = 8;
+  // A norm-form distance smaller than this fraction of the summed
+  // norms (per feature) has lost too many digits to cancellation and
+  // is recalculated from the differences.
+  const double dCancellationLimit = 1e-10;
+
+#ifdef __SSE2__
+  inline double horizontalSum(__m128d sum)
+  {
+    return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+  }
+
+  inline __m128d addToDouble(__m128d sum, __m128 values)
+  {
+    return _mm_add_pd(sum, _mm_add_pd(_mm_cvtps_pd(values), _mm_cvtps_pd(_mm_movehl_ps(values, values))));
+  }
+
+  // Multiplies four floats in double precision and adds the products
+  // to two partial sums.
+  inline void addProducts(__m128d low, __m128d high, __m128 values, __m128d& sumLow, __m128d& sumHigh)
+  {
+    sumLow = _mm_add_pd(sumLow, _mm_mul_pd(low, _mm_cvtps_pd(values)));
+    sumHigh = _mm_add_pd(sumHigh, _mm_mul_pd(high, _mm_cvtps_pd(_mm_movehl_ps(values, values))));
+  }
+#endif
+
+  // Calculates the dot products between sample and four models. The
+  // products of two floats are exact in double precision, and they
+  // are accumulated in double precision. The arithmetic must match
+  // squaredNorm() exactly so that the distance between two equal
+  // vectors comes out as zero.
+  void dotProducts(const float* sample, const float* const* models, int length, double* result)
+  {
+    const float *pModel0 = models[0], *pModel1 = models[1], *pModel2 = models[2], *pModel3 = models[3];
+    int i = 0;
+#ifdef __SSE2__
+    __m128d sumLow0 = _mm_setzero_pd(), sumLow1 = _mm_setzero_pd(), sumLow2 = _mm_setzero_pd(), sumLow3 = _mm_setzero_pd();
+    __m128d sumHigh0 = _mm_setzero_pd(), sumHigh1 = _mm_setzero_pd(), sumHigh2 = _mm_setzero_pd(), sumHigh3 = _mm_setzero_pd();
+    for (; i<=length-4; i+=4)
+      {
+        const __m128 s = _mm_loadu_ps(sample + i);
+        const __m128d low = _mm_cvtps_pd(s), high = _mm_cvtps_pd(_mm_movehl_ps(s, s));
+        addProducts(low, high, _mm_loadu_ps(pModel0 + i), sumLow0, sumHigh0);
+        addProducts(low, high, _mm_loadu_ps(pModel1 + i), sumLow1, sumHigh1);
+        addProducts(low, high, _mm_loadu_ps(pModel2 + i), sumLow2, sumHigh2);
+        addProducts(low, high, _mm_loadu_ps(pModel3 + i), sumLow3, sumHigh3);
+      }
+    result[0] = horizontalSum(_mm_add_pd(sumLow0, sumHigh0));
+    result[1] = horizontalSum(_mm_add_pd(sumLow1, sumHigh1));
+    result[2] = horizontalSum(_mm_add_pd(sumLow2, sumHigh2));
+    result[3] = horizontalSum(_mm_add_pd(sumLow3, sumHigh3));
+#else
+    result[0] = result[1] = result[2] = result[3] = 0;
+#endif
+    for (; i<length; ++i)
+      {
+        const double dSample = sample[i];
+        result[0] += dSample * pModel0[i];
+        result[1] += dSample * pModel1[i];
+        result[2] += dSample * pModel2[i];
+        result[3] += dSample * pModel3[i];
+      }
+  }
+
+  double squaredNorm(const float* vector, int length)
+  {
+    int i = 0;
+#ifdef __SSE2__
+    __m128d sumLow = _mm_setzero_pd(), sumHigh = _mm_setzero_pd();
+    for (; i<=length-4; i+=4)
+      {
+        const __m128 v = _mm_loadu_ps(vector + i);
+        addProducts(_mm_cvtps_pd(v), _mm_cvtps_pd(_mm_movehl_ps(v, v)), v, sumLow, sumHigh);
+      }
+    double dResult = horizontalSum(_mm_add_pd(sumLow, sumHigh));
+#else
+    double dResult = 0;
+#endif
+    for (; i<length; ++i)
+      {
+        const double dValue = vector[i];
+        dResult += dValue * dValue;
+      }
+    return dResult;
+  }
+
+  // Calculates the squared distance from the differences of the
+  // features.
+  double squaredDistance(const float* sample, const float* model, int length)
+  {
+    int i = 0;
+#ifdef __SSE2__
+    __m128d sum0 = _mm_setzero_pd(), sum1 = _mm_setzero_pd();
+    for (; i<=length-4; i+=4)
+      {
+        const __m128 diff = _mm_sub_ps(_mm_loadu_ps(sample + i), _mm_loadu_ps(model + i));
+        const __m128d low = _mm_cvtps_pd(diff), high = _mm_cvtps_pd(_mm_movehl_ps(diff, diff));
+        sum0 = _mm_add_pd(sum0, _mm_mul_pd(low, low));
+        sum1 = _mm_add_pd(sum1, _mm_mul_pd(high, high));
+      }
+    double dSum = horizontalSum(_mm_add_pd(sum0, sum1));
+#else
+    double dSum = 0;
+#endif
+    for (; i<length; ++i)
+      {
+        const double dDiff = double(sample[i] - model[i]);
+        dSum += dDiff * dDiff;
+      }
+    return dSum;
+  }
+
+  QVector<double> squaredNorms(const float* const* vectors, int count, int length)
+  {
+    QVector<double> vecNorms(count);
+    for (int i=0; i<count; ++i)
+      vecNorms[i] = squaredNorm(vectors[i], length);
+    return vecNorms;
+  }
+
+  // Compares all samples to all models using the norm form. For each
+  // pair of sample and model, calls function(sample, model, distance).
+  // Models are processed in blocks that stay in cache while all
+  // samples are compared to them. Within a block, each sample is
+  // compared to four models at a time.
+  template <class Function> void compareWithNorms(const float* const* samples, int sampleCount,
+                                                  const float* const* models, int modelCount,
+                                                  int length,
+                                                  Function& function)
+  {
+    const int iModelBlockSize = 256;
+    const QVector<double> vecSampleNorms(squaredNorms(samples, sampleCount, length));
+    const QVector<double> vecModelNorms(squaredNorms(models, modelCount, length));
+    const double* pSampleNorms = vecSampleNorms.constData();
+    const double* pModelNorms = vecModelNorms.constData();
+    double aDots[4];
+
+    for (int iFirstModel=0; iFirstModel<modelCount; iFirstModel += iModelBlockSize)
+      {
+        const int iLastModel = qMin(iFirstModel + iModelBlockSize, modelCount);
+        for (int s=0; s<sampleCount; ++s)
+          {
+            for (int m=iFirstModel; m<iLastModel; m+=4)
+              {
+                const int iCount = qMin(4, iLastModel - m);
+                const float* aModels[4];
+                // Missing models at the end are replaced with the last one.
+                for (int i=0; i<4; ++i)
+                  aModels[i] = models[m + qMin(i, iCount-1)];
+                dotProducts(samples[s], aModels, length, aDots);
+                for (int i=0; i<iCount; ++i)
+                  {
+                    const double dNorms = pSampleNorms[s] + pModelNorms[m+i];
+                    double dDistance = dNorms - 2 * aDots[i];
+                    // If the vectors are long compared to their
+                    // difference, few significant digits are left.
+                    // NaNs fail the comparison and stay NaNs.
+                    if (dDistance < dNorms * dCancellationLimit * length)
+                      dDistance = squaredDistance(samples[s], aModels[i], length);
+                    function(s, m+i, dDistance);
+                  }
+              }
+          }
+      }
+  }
+
+  struct StoreDistance
+  {
+    StoreDistance(double* distances, int modelCount) : pDistances(distances), iModelCount(modelCount) {}
+    void operator() (int sample, int model, double distance)
+    {
+      pDistances[qint64(sample) * iModelCount + model] = distance;
+    }
+    double* pDistances;
+    int iModelCount;
+  };
+
+  struct KeepClosest
+  {
+    KeepClosest(int* indices, double* distances) : pIndices(indices), pDistances(distances) {}
+    void operator() (int sample, int model, double distance)
+    {
+      if (distance < pDistances[sample])
+        {
+          pDistances[sample] = distance;
+          pIndices[sample] = model;
+        }
+    }
+    int* pIndices;
+    double* pDistances;
+  };
+}
+
+double PiiDistanceKernel<PiiSquaredGeometricDistance<const float*> >::distance(const Measure& measure,
+                                                                                const float* sample,
+                                                                                const float* model,
+                                                                                int length)
+{
+#ifdef __SSE2__
+  return squaredDistance(sample, model, length);
+#else
+  return measure(sample, model, length);
+#endif
+}
+
+void PiiDistanceKernel<PiiSquaredGeometricDistance<const float*> >::calculateDistances(const Measure& measure,
+                                                                                        const float* const* samples,
+                                                                                        int sampleCount,
+                                                                                        const float* const* models,
+                                                                                        int modelCount,
+                                                                                        int length,
+                                                                                        double* distances)
+{
+  if (sampleCount < iNormFormMinSamples)
+    {
+      PiiDistanceKernelBase<Measure, PiiDistanceKernel, true>::calculateDistances(measure,
+                                                                                 samples, sampleCount,
+                                                                                 models, modelCount,
+                                                                                 length, distances);
+      return;
+    }
+  StoreDistance store(distances, modelCount);
+  compareWithNorms(samples, sampleCount, models, modelCount, length, store);
+}
+
+void PiiDistanceKernel<PiiSquaredGeometricDistance<const float*> >::findClosestMatches(const Measure& measure,
+                                                                                        const float* const* samples,
+                                                                                        int sampleCount,
+                                                                                        const float* const* models,
+                                                                                        int modelCount,
+                                                                                        int length,
+                                                                                        int* indices,
+                                                                                        double* distances)
+{
+  // With few samples, comparing the vectors directly allows early
+  // exits on partial distances.
+  if (sampleCount < iNormFormMinSamples)
+    {
+      PiiDistanceKernelBase<Measure, PiiDistanceKernel, true>::findClosestMatches(measure,
+                                                                                 samples, sampleCount,
+                                                                                 models, modelCount,
+                                                                                 length, indices, distances);
+      return;
+    }
+  for (int s=0; s<sampleCount; ++s)
+    {
+      indices[s] = -1;
+      distances[s] = INFINITY;
+    }
+  KeepClosest keep(indices, distances);
+  compareWithNorms(samples, sampleCount, models, modelCount, length, keep);
+}
+
+double PiiDistanceKernel<PiiAbsDiffDistance<const float*> >::distance(const PiiAbsDiffDistance<const float*>& measure,
+                                                                       const float* sample,
+                                                                       const float* model,
+                                                                       int length)
+{
+#ifdef __SSE2__
+  const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128d sum = _mm_setzero_pd();
+  int i = 0;
+  for (; i<=length-4; i+=4)
+    sum = addToDouble(sum, _mm_and_ps(signMask, _mm_sub_ps(_mm_loadu_ps(sample + i), _mm_loadu_ps(model + i))));
+  double dSum = horizontalSum(sum);
+  for (; i<length; ++i)
+    dSum += Pii::abs(sample[i] - model[i]);
+  return dSum;
+#else
+  return measure(sample, model, length);
+#endif
+}
+
+double PiiDistanceKernel<PiiChiSquaredDistance<const float*> >::distance(const PiiChiSquaredDistance<const float*>& measure,
+                                                                          const float* sample,
+                                                                          const float* model,
+                                                                          int length)
+{
+#ifdef __SSE2__
+  __m128d sum = _mm_setzero_pd();
+  int i = 0;
+  for (; i<=length-4; i+=4)
+    {
+      const __m128 s = _mm_loadu_ps(sample + i), m = _mm_loadu_ps(model + i);
+      const __m128 diff = _mm_sub_ps(s, m), total = _mm_add_ps(s, m);
+      const __m128d diffLow = _mm_cvtps_pd(diff), diffHigh = _mm_cvtps_pd(_mm_movehl_ps(diff, diff));
+      sum = _mm_add_pd(sum, _mm_div_pd(_mm_mul_pd(diffLow, diffLow), _mm_cvtps_pd(total)));
+      sum = _mm_add_pd(sum, _mm_div_pd(_mm_mul_pd(diffHigh, diffHigh), _mm_cvtps_pd(_mm_movehl_ps(total, total))));
+    }
+  double dSum = horizontalSum(sum);
+  if (i < length)
+    dSum += measure(sample + i, model + i, length - i);
+  return dSum;
+#else
+  return measure(sample, model, length);
+#endif
+}
+
+double PiiDistanceKernel<PiiHistogramIntersection<const float*> >::distance(const PiiHistogramIntersection<const float*>& measure,
+                                                                             const float* sample,
+                                                                             const float* model,
+                                                                             int length)
+{
+#ifdef __SSE2__
+  __m128d sum = _mm_setzero_pd();
+  int i = 0;
+  for (; i<=length-4; i+=4)
+    sum = addToDouble(sum, _mm_min_ps(_mm_loadu_ps(sample + i), _mm_loadu_ps(model + i)));
+  double dSum = -horizontalSum(sum);
+  if (i < length)
+    dSum += measure(sample + i, model + i, length - i);
+  return dSum;
+#else
+  return measure(sample, model, length);
+#endif
+}
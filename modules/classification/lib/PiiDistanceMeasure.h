@@ -19,6 +19,7 @@
 #include "PiiClassificationGlobal.h"
 
 #include <PiiMath.h>
+#include <PiiMetaTemplate.h>
 #include <PiiSerializationTraits.h>
 
 
@@ -33,6 +34,165 @@ template <class FeatureIterator> double NAME<FeatureIterator>::operator() (Featu
                                                                            FeatureIterator model, \
                                                                            int length) const throw()
 
+/**
+ * Default implementations of batch distance calculations for
+ * *Measure*. *Kernel* is the class deriving from this one. It must
+ * provide a static `distance()` function with the same signature as
+ * the one here, which makes it possible to replace the calculation
+ * of a single distance (e.g. with SIMD code) and still reuse the
+ * loops. If *partialSums* is `true`, the distance is assumed to be a
+ * sum of non-negative per-feature terms. Nearest neighbor searches
+ * will then accumulate it in blocks of features and stop as soon as
+ * the partial sum reaches the distance of the best match found so
+ * far.
+ *
+ * @see PiiDistanceKernel
+ */
+template <class Measure, class Kernel, bool partialSums = false> struct PiiDistanceKernelBase
+{
+  /**
+   * Returns the distance between *sample* and *model*.
+   */
+  template <class FeatureIterator>
+  static inline double distance(const Measure& measure,
+                                FeatureIterator sample,
+                                FeatureIterator model,
+                                int length)
+  {
+    return measure(sample, model, length);
+  }
+
+  /**
+   * Returns the distance between *sample* and *model*, or a value
+   * larger than or equal to *bound* if the distance cannot be
+   * smaller than *bound*.
+   */
+  template <class FeatureIterator>
+  static double boundedDistance(const Measure& measure,
+                                FeatureIterator sample,
+                                FeatureIterator model,
+                                int length,
+                                double bound)
+  {
+    return boundedDistance(measure, sample, model, length, bound,
+                           typename Pii::If<partialSums, Pii::True, Pii::False>::Type());
+  }
+
+  /**
+   * Calculates the distances between *sampleCount* samples and
+   * *modelCount* models. The distance between `samples[i]` and
+   * `models[j]` will be stored at `distances[i*modelCount + j]`.
+   */
+  template <class FeatureIterator>
+  static void calculateDistances(const Measure& measure,
+                                 const FeatureIterator* samples, int sampleCount,
+                                 const FeatureIterator* models, int modelCount,
+                                 int length,
+                                 double* distances)
+  {
+    // All samples are compared to a block of models at a time so
+    // that the models stay in cache.
+    for (int iFirstModel=0; iFirstModel<modelCount; iFirstModel += ModelBlockSize)
+      {
+        const int iLastModel = qMin(iFirstModel + int(ModelBlockSize), modelCount);
+        for (int s=0; s<sampleCount; ++s)
+          {
+            double* pDistances = distances + qint64(s) * modelCount;
+            for (int m=iFirstModel; m<iLastModel; ++m)
+              pDistances[m] = Kernel::distance(measure, samples[s], models[m], length);
+          }
+      }
+  }
+
+  /**
+   * Finds the closest model for each of *sampleCount* samples. The
+   * index of the closest model to `samples[i]` will be stored at
+   * `indices[i]` and the distance at `distances[i]`. If two models
+   * are equally close, the one with the smaller index wins. If no
+   * model is closer than infinity, the index will be -1.
+   */
+  template <class FeatureIterator>
+  static void findClosestMatches(const Measure& measure,
+                                 const FeatureIterator* samples, int sampleCount,
+                                 const FeatureIterator* models, int modelCount,
+                                 int length,
+                                 int* indices, double* distances)
+  {
+    for (int s=0; s<sampleCount; ++s)
+      {
+        double dMinDistance = INFINITY;
+        int iMinIndex = -1;
+        for (int m=0; m<modelCount; ++m)
+          {
+            double dDistance = Kernel::boundedDistance(measure, samples[s], models[m], length, dMinDistance);
+            if (dDistance < dMinDistance)
+              {
+                iMinIndex = m;
+                dMinDistance = dDistance;
+              }
+          }
+        indices[s] = iMinIndex;
+        distances[s] = dMinDistance;
+      }
+  }
+
+  /// @internal
+  enum { PartialBlockSize = 32, ModelBlockSize = 256 };
+
+private:
+  template <class FeatureIterator>
+  static inline double boundedDistance(const Measure& measure,
+                                       FeatureIterator sample,
+                                       FeatureIterator model,
+                                       int length,
+                                       double,
+                                       Pii::False)
+  {
+    return Kernel::distance(measure, sample, model, length);
+  }
+
+  template <class FeatureIterator>
+  static double boundedDistance(const Measure& measure,
+                                FeatureIterator sample,
+                                FeatureIterator model,
+                                int length,
+                                double bound,
+                                Pii::True)
+  {
+    double dSum = 0;
+    for (int i=0; i<length; i += PartialBlockSize)
+      {
+        dSum += Kernel::distance(measure, sample + i, model + i, qMin(int(PartialBlockSize), length - i));
+        if (dSum >= bound)
+          break;
+      }
+    return dSum;
+  }
+};
+
+/// @internal
+template <class Measure> struct PiiDefaultDistanceKernel :
+  PiiDistanceKernelBase<Measure, PiiDefaultDistanceKernel<Measure> >
+{};
+
+/**
+ * Batch distance calculations for a distance *Measure*. The
+ * functions in PiiClassification calculate distances between many
+ * samples and models through this structure. By default, the
+ * measure's function call operator is invoked for each pair. Measures
+ * that have a faster way of comparing many vectors at once specialize
+ * the structure, usually by deriving from PiiDistanceKernelBase. See
+ * PiiSquaredGeometricDistance for an example.
+ *
+ * With PiiDistanceMeasure, the kernel calls the virtual batch
+ * functions of the polymorphic measure. Those are implemented with
+ * the kernel of the actual measure, so that virtual functions are
+ * called once per batch instead of once per pair of vectors.
+ */
+template <class Measure> struct PiiDistanceKernel :
+  PiiDefaultDistanceKernel<Measure>
+{};
+
 /**
  * Type definition for a polymorphic implementation of the function
  * object *MEASURE*.
@@ -72,6 +232,28 @@ public:
                              int length) const throw() = 0;
 
 
+  /**
+   * Calculates the distances between *sampleCount* samples and
+   * *modelCount* models. See PiiDistanceKernelBase::calculateDistances().
+   * The default implementation calls the function call operator for
+   * each pair. Impl uses the [PiiDistanceKernel] of its measure.
+   */
+  virtual void calculateDistances(const FeatureIterator* samples, int sampleCount,
+                                  const FeatureIterator* models, int modelCount,
+                                  int length,
+                                  double* distances) const throw();
+
+  /**
+   * Finds the closest model for each of *sampleCount* samples. See
+   * PiiDistanceKernelBase::findClosestMatches(). The default
+   * implementation calls the function call operator for each pair.
+   * Impl uses the [PiiDistanceKernel] of its measure.
+   */
+  virtual void findClosestMatches(const FeatureIterator* samples, int sampleCount,
+                                  const FeatureIterator* models, int modelCount,
+                                  int length,
+                                  int* indices, double* distances) const throw();
+
   virtual PiiDistanceMeasure* clone() const = 0;
 
   template <class Measure> class Impl;
@@ -92,6 +274,52 @@ template <class FeatureIterator> PiiDistanceMeasure<FeatureIterator>::~PiiDistan
 {
 }
 
+template <class FeatureIterator>
+void PiiDistanceMeasure<FeatureIterator>::calculateDistances(const FeatureIterator* samples, int sampleCount,
+                                                             const FeatureIterator* models, int modelCount,
+                                                             int length,
+                                                             double* distances) const throw()
+{
+  PiiDefaultDistanceKernel<PiiDistanceMeasure>::calculateDistances(*this,
+                                                                   samples, sampleCount,
+                                                                   models, modelCount,
+                                                                   length, distances);
+}
+
+template <class FeatureIterator>
+void PiiDistanceMeasure<FeatureIterator>::findClosestMatches(const FeatureIterator* samples, int sampleCount,
+                                                             const FeatureIterator* models, int modelCount,
+                                                             int length,
+                                                             int* indices, double* distances) const throw()
+{
+  PiiDefaultDistanceKernel<PiiDistanceMeasure>::findClosestMatches(*this,
+                                                                   samples, sampleCount,
+                                                                   models, modelCount,
+                                                                   length, indices, distances);
+}
+
+/// @internal
+template <class FeatureIterator> struct PiiDistanceKernel<PiiDistanceMeasure<FeatureIterator> >
+{
+  static void calculateDistances(const PiiDistanceMeasure<FeatureIterator>& measure,
+                                 const FeatureIterator* samples, int sampleCount,
+                                 const FeatureIterator* models, int modelCount,
+                                 int length,
+                                 double* distances)
+  {
+    measure.calculateDistances(samples, sampleCount, models, modelCount, length, distances);
+  }
+
+  static void findClosestMatches(const PiiDistanceMeasure<FeatureIterator>& measure,
+                                 const FeatureIterator* samples, int sampleCount,
+                                 const FeatureIterator* models, int modelCount,
+                                 int length,
+                                 int* indices, double* distances)
+  {
+    measure.findClosestMatches(samples, sampleCount, models, modelCount, length, indices, distances);
+  }
+};
+
 /**
  * A template that implements the PiiDistanceMeasure interface by
  * using `Measure` as the distance measure implementation. The
@@ -112,6 +340,28 @@ public:
     return Measure::operator() (sample, model, length);
   }
 
+  void calculateDistances(const FeatureIterator* samples, int sampleCount,
+                          const FeatureIterator* models, int modelCount,
+                          int length,
+                          double* distances) const throw()
+  {
+    PiiDistanceKernel<Measure>::calculateDistances(*this,
+                                                   samples, sampleCount,
+                                                   models, modelCount,
+                                                   length, distances);
+  }
+
+  void findClosestMatches(const FeatureIterator* samples, int sampleCount,
+                          const FeatureIterator* models, int modelCount,
+                          int length,
+                          int* indices, double* distances) const throw()
+  {
+    PiiDistanceKernel<Measure>::findClosestMatches(*this,
+                                                   samples, sampleCount,
+                                                   models, modelCount,
+                                                   length, indices, distances);
+  }
+
   Impl* clone() const
   {
     return new Impl;
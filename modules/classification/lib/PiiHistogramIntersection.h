@@ -41,4 +41,12 @@ PII_DEFAULT_DISTANCE_MEASURE_DEF(PiiHistogramIntersection)
   return -diffSum;
 }
 
+/// @internal
+template <> struct PII_CLASSIFICATION_EXPORT PiiDistanceKernel<PiiHistogramIntersection<const float*> > :
+  PiiDistanceKernelBase<PiiHistogramIntersection<const float*>,
+                        PiiDistanceKernel<PiiHistogramIntersection<const float*> > >
+{
+  static double distance(const PiiHistogramIntersection<const float*>& measure, const float* sample, const float* model, int length);
+};
+
 #endif //_PIIHISTOGRAMINTERSECTION_H
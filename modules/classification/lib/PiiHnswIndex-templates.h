@@ -0,0 +1,457 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIHNSWINDEX_H
+# error "Never use <PiiHnswIndex-templates.h> directly; include <PiiHnswIndex.h> instead."
+#endif
+
+#include <PiiHeap.h>
+#include <algorithm>
+#include <cmath>
+
+extern PII_CLASSIFICATION_EXPORT const char* pHnswIndexTooLargeError;
+
+template <class SampleSet> class PiiHnswIndex<SampleSet>::ExactDistance
+{
+public:
+  ExactDistance(const PiiHnswIndex* index, Sample sample) :
+    _pIndex(index), _sample(sample)
+  {}
+
+  double operator() (int node) const
+  {
+    return Kernel::distance(_pIndex->d->measure, _sample, _pIndex->point(node), _pIndex->d->iFeatureCount);
+  }
+
+private:
+  const PiiHnswIndex* _pIndex;
+  Sample _sample;
+};
+
+template <class SampleSet> class PiiHnswIndex<SampleSet>::CompressedDistance
+{
+public:
+  CompressedDistance(const PiiHnswIndex* index, Sample sample) :
+    _pIndex(index),
+    _vecTable(index->d->quantizer.distanceTableSize()),
+    _iCodeLength(index->d->quantizer.subspaceCount())
+  {
+    _pIndex->d->quantizer.calculateDistanceTable(sample, _vecTable.data());
+  }
+
+  double operator() (int node) const
+  {
+    return _pIndex->d->quantizer.distance(_vecTable.constData(),
+                                          _pIndex->d->vecCodes.constData() + qint64(node) * _iCodeLength);
+  }
+
+private:
+  const PiiHnswIndex* _pIndex;
+  QVector<float> _vecTable;
+  int _iCodeLength;
+};
+
+template <class SampleSet> class PiiHnswIndex<SampleSet>::QueryFunction
+{
+public:
+  QueryFunction(const PiiHnswIndex* index, const Sample* samples, int n,
+                PiiClassification::MatchList* matches) :
+    _pIndex(index), _pSamples(samples), _iN(n), _pMatches(matches)
+  {}
+
+  void operator() (int first, int last) const
+  {
+    DenseVisitedSet visited(_pIndex->modelCount());
+    for (int i=first; i<last; ++i)
+      _pMatches[i] = _pIndex->findClosestMatches(_pSamples[i], _iN, visited);
+  }
+
+private:
+  const PiiHnswIndex* _pIndex;
+  const Sample* _pSamples;
+  int _iN;
+  PiiClassification::MatchList* _pMatches;
+};
+
+template <class SampleSet>
+PiiHnswIndex<SampleSet>::PiiHnswIndex() :
+  d(new Data)
+{
+}
+
+template <class SampleSet>
+PiiHnswIndex<SampleSet>::PiiHnswIndex(const PiiHnswIndex& other) :
+  PiiNearestNeighborIndex<SampleSet>(),
+  d(other.d)
+{
+  d->reserve();
+}
+
+template <class SampleSet>
+PiiHnswIndex<SampleSet>::PiiHnswIndex(const SampleSet& modelSet) :
+  d(new Data)
+{
+  buildIndex(modelSet);
+}
+
+template <class SampleSet>
+PiiHnswIndex<SampleSet>::~PiiHnswIndex()
+{
+  d->release();
+}
+
+template <class SampleSet>
+PiiHnswIndex<SampleSet>& PiiHnswIndex<SampleSet>::operator= (const PiiHnswIndex& other)
+{
+  other.d->assignTo(d);
+  return *this;
+}
+
+template <class SampleSet> void PiiHnswIndex<SampleSet>::setMaxConnections(int maxConnections)
+{
+  if (maxConnections < 2)
+    return;
+  d = d->detach();
+  d->iMaxConnections = maxConnections;
+}
+
+template <class SampleSet> void PiiHnswIndex<SampleSet>::setConstructionSearchWidth(int constructionSearchWidth)
+{
+  if (constructionSearchWidth < 1)
+    return;
+  d = d->detach();
+  d->iConstructionWidth = constructionSearchWidth;
+}
+
+template <class SampleSet> void PiiHnswIndex<SampleSet>::setSearchWidth(int searchWidth)
+{
+  d = d->detach();
+  d->iSearchWidth = searchWidth > 0 ? searchWidth : 64;
+}
+
+template <class SampleSet> void PiiHnswIndex<SampleSet>::setQuantizerSubspaceCount(int subspaceCount)
+{
+  if (subspaceCount < 0)
+    return;
+  d = d->detach();
+  d->iQuantizerSubspaceCount = subspaceCount;
+}
+
+template <class SampleSet>
+void PiiHnswIndex<SampleSet>::buildIndex(const SampleSet& modelSet, PiiProgressController* controller)
+{
+  Data* pData = new Data;
+  pData->iMaxConnections = d->iMaxConnections;
+  pData->iConstructionWidth = d->iConstructionWidth;
+  pData->iSearchWidth = d->iSearchWidth;
+  pData->iQuantizerSubspaceCount = d->iQuantizerSubspaceCount;
+  d->release();
+  d = pData;
+
+  const int iSampleCount = PiiSampleSet::sampleCount(modelSet);
+  const int iFeatureCount = PiiSampleSet::featureCount(modelSet);
+  if (iSampleCount == 0 || iFeatureCount == 0)
+    return;
+
+  // QVector stores its size as an int, and Qt 4 allocates its memory
+  // with an int byte count.
+  const qint64 iMaxBytes = Pii::Numeric<int>::maxValue() - 64;
+  const qint64 iPointBytes = qint64(iSampleCount) * iFeatureCount * sizeof(T),
+    iLinkBytes = qint64(iSampleCount) * (2 * d->iMaxConnections + 1) * sizeof(int);
+  if (iPointBytes > iMaxBytes || iLinkBytes > iMaxBytes)
+    PII_THROW(PiiClassificationException, tr(pHnswIndexTooLargeError).arg(qMax(iPointBytes, iLinkBytes)));
+
+  d->iFeatureCount = iFeatureCount;
+  d->vecPoints.resize(int(iPointBytes / sizeof(T)));
+  for (int i=0; i<iSampleCount; ++i)
+    {
+      Sample sample = PiiSampleSet::sampleAt(modelSet, i);
+      T* pPoint = d->vecPoints.data() + qint64(i) * iFeatureCount;
+      for (int j=0; j<iFeatureCount; ++j)
+        pPoint[j] = sample[j];
+    }
+  d->vecLevels.resize(iSampleCount);
+  d->vecBaseLinks.fill(0, int(iLinkBytes / sizeof(int)));
+  d->vecUpperLinks.resize(iSampleCount);
+
+  DenseVisitedSet visited(iSampleCount);
+  /* The level of each model is drawn from an exponential
+     distribution so that the number of models decreases by a factor
+     of iMaxConnections on each layer. A fixed xorshift generator
+     makes the index reproducible. */
+  const double dLevelScale = 1.0 / std::log(double(d->iMaxConnections));
+  quint32 uiRandom = 2463534242u;
+  for (int i=0; i<iSampleCount; ++i)
+    {
+      uiRandom ^= uiRandom << 13;
+      uiRandom ^= uiRandom >> 17;
+      uiRandom ^= uiRandom << 5;
+      const double dUniform = (double(uiRandom) + 1.0) / 4294967297.0;
+      insert(i, int(-std::log(dUniform) * dLevelScale), visited);
+      if ((i & 1023) == 1023)
+        PII_TRY_CONTINUE(controller, double(i) / iSampleCount);
+    }
+
+  if (d->iQuantizerSubspaceCount > 0)
+    {
+      d->quantizer.setSubspaceCount(d->iQuantizerSubspaceCount);
+      d->quantizer.train(modelSet, controller);
+      d->vecCodes = d->quantizer.encode(modelSet);
+      d->vecPoints.clear();
+    }
+}
+
+template <class SampleSet>
+void PiiHnswIndex<SampleSet>::insert(int node, int level, DenseVisitedSet& visited)
+{
+  d->vecLevels[node] = level;
+  if (level > 0)
+    d->vecUpperLinks[node].fill(0, level * (d->iMaxConnections + 1));
+
+  if (d->iEntryPoint < 0)
+    {
+      d->iEntryPoint = node;
+      d->iMaxLevel = level;
+      return;
+    }
+
+  ExactDistance distance(this, point(node));
+  QVector<Candidate> vecEntries;
+  vecEntries << qMakePair(distance(d->iEntryPoint), d->iEntryPoint);
+  // Greedy descent to the highest layer of the new node
+  for (int l=d->iMaxLevel; l>level; --l)
+    searchLevel(distance, vecEntries, 1, l, visited);
+
+  for (int l=qMin(level, d->iMaxLevel); l>=0; --l)
+    {
+      searchLevel(distance, vecEntries, d->iConstructionWidth, l, visited);
+      const QVector<Candidate> vecNeighbors(selectNeighbors(vecEntries, d->iMaxConnections));
+      int* pLinks = links(node, l);
+      pLinks[0] = vecNeighbors.size();
+      for (int i=0; i<vecNeighbors.size(); ++i)
+        {
+          pLinks[i+1] = vecNeighbors[i].second;
+          connect(vecNeighbors[i].second, node, vecNeighbors[i].first, l);
+        }
+    }
+
+  if (level > d->iMaxLevel)
+    {
+      d->iMaxLevel = level;
+      d->iEntryPoint = node;
+    }
+}
+
+template <class SampleSet>
+void PiiHnswIndex<SampleSet>::connect(int node, int neighbor, double distance, int level)
+{
+  int* pLinks = links(node, level);
+  const int iMaxLinks = maxLinks(level);
+  if (pLinks[0] < iMaxLinks)
+    {
+      pLinks[++pLinks[0]] = neighbor;
+      return;
+    }
+
+  // The list is full. Select the new neighbors among the old ones
+  // and the newcomer.
+  QVector<Candidate> vecCandidates;
+  vecCandidates.reserve(iMaxLinks + 1);
+  vecCandidates << qMakePair(distance, neighbor);
+  for (int i=1; i<=iMaxLinks; ++i)
+    vecCandidates << qMakePair(pointDistance(node, pLinks[i]), pLinks[i]);
+  std::sort(vecCandidates.begin(), vecCandidates.end());
+  const QVector<Candidate> vecSelected(selectNeighbors(vecCandidates, iMaxLinks));
+  pLinks[0] = vecSelected.size();
+  for (int i=0; i<vecSelected.size(); ++i)
+    pLinks[i+1] = vecSelected[i].second;
+}
+
+template <class SampleSet>
+QVector<typename PiiHnswIndex<SampleSet>::Candidate>
+PiiHnswIndex<SampleSet>::selectNeighbors(const QVector<Candidate>& candidates, int count) const
+{
+  /* A candidate is accepted only if it is closer to the base node
+     than to any of the already selected neighbors. This keeps
+     connections to different directions instead of linking a node
+     to a tight cluster only, which is what makes the graph
+     navigable. */
+  QVector<Candidate> vecSelected;
+  vecSelected.reserve(count);
+  for (int i=0; i<candidates.size() && vecSelected.size() < count; ++i)
+    {
+      const Candidate& candidate = candidates[i];
+      bool bAccept = true;
+      for (int j=0; j<vecSelected.size(); ++j)
+        if (pointDistance(candidate.second, vecSelected[j].second) < candidate.first)
+          {
+            bAccept = false;
+            break;
+          }
+      if (bAccept)
+        vecSelected << candidate;
+    }
+  return vecSelected;
+}
+
+template <class SampleSet>
+template <class Distance, class VisitedSet>
+void PiiHnswIndex<SampleSet>::searchLevel(const Distance& distance,
+                                          QVector<Candidate>& entryPoints,
+                                          int width,
+                                          int level,
+                                          VisitedSet& visited) const
+{
+  visited.clear();
+  // Nodes to be expanded, closest one on top
+  PiiHeap<Candidate,64> candidates(0, Pii::InverseHeap);
+  // Best matches found so far, farthest one on top
+  PiiHeap<Candidate,64> results(0);
+  for (int i=0; i<entryPoints.size(); ++i)
+    {
+      visited.visit(entryPoints[i].second);
+      candidates.append(entryPoints[i]);
+      results.append(entryPoints[i]);
+    }
+  while (results.size() > width)
+    results.take(0);
+
+  while (candidates.size() > 0)
+    {
+      const Candidate closest = candidates.take(0);
+      // All remaining candidates are farther than the worst result.
+      if (closest.first > results[0].first)
+        break;
+      const int* pLinks = links(closest.second, level);
+      for (int i=1; i<=pLinks[0]; ++i)
+        {
+          const int iNeighbor = pLinks[i];
+          if (!visited.visit(iNeighbor))
+            continue;
+          const double dDistance = distance(iNeighbor);
+          if (results.size() < width || dDistance < results[0].first)
+            {
+              const Candidate neighbor(dDistance, iNeighbor);
+              candidates.append(neighbor);
+              results.append(neighbor);
+              if (results.size() > width)
+                results.take(0);
+            }
+        }
+    }
+
+  results.sort();
+  entryPoints.resize(results.size());
+  for (int i=0; i<results.size(); ++i)
+    entryPoints[i] = results[i];
+}
+
+template <class SampleSet>
+template <class VisitedSet>
+QVector<typename PiiHnswIndex<SampleSet>::Candidate>
+PiiHnswIndex<SampleSet>::search(Sample sample, int width, VisitedSet& visited) const
+{
+  QVector<Candidate> vecEntries;
+  if (isCompressed())
+    {
+      CompressedDistance distance(this, sample);
+      vecEntries << qMakePair(distance(d->iEntryPoint), d->iEntryPoint);
+      for (int l=d->iMaxLevel; l>0; --l)
+        searchLevel(distance, vecEntries, 1, l, visited);
+      searchLevel(distance, vecEntries, width, 0, visited);
+    }
+  else
+    {
+      ExactDistance distance(this, sample);
+      vecEntries << qMakePair(distance(d->iEntryPoint), d->iEntryPoint);
+      for (int l=d->iMaxLevel; l>0; --l)
+        searchLevel(distance, vecEntries, 1, l, visited);
+      searchLevel(distance, vecEntries, width, 0, visited);
+    }
+  return vecEntries;
+}
+
+template <class SampleSet>
+template <class VisitedSet>
+PiiClassification::MatchList PiiHnswIndex<SampleSet>::findClosestMatches(Sample sample, int n, VisitedSet& visited) const
+{
+  PiiClassification::MatchList lstMatches;
+  n = qMin(n, modelCount());
+  if (n <= 0)
+    return lstMatches;
+  lstMatches.fill(n, qMakePair(double(INFINITY), -1));
+  const QVector<Candidate> vecResults(search(sample, qMax(d->iSearchWidth, n), visited));
+  for (int i=0; i<vecResults.size(); ++i)
+    lstMatches.put(vecResults[i]);
+  lstMatches.sort();
+  return lstMatches;
+}
+
+template <class SampleSet>
+PiiClassification::MatchList PiiHnswIndex<SampleSet>::findClosestMatches(Sample sample, int n) const
+{
+  SparseVisitedSet visited;
+  return findClosestMatches(sample, n, visited);
+}
+
+template <class SampleSet>
+int PiiHnswIndex<SampleSet>::findClosestMatch(Sample sample, double* distance) const
+{
+  PiiClassification::MatchList lstMatches(findClosestMatches(sample, 1));
+  if (lstMatches.size() == 0)
+    {
+      if (distance != 0)
+        *distance = INFINITY;
+      return -1;
+    }
+  if (distance != 0)
+    *distance = lstMatches[0].first;
+  return lstMatches[0].second;
+}
+
+template <class SampleSet>
+QList<PiiClassification::MatchList> PiiHnswIndex<SampleSet>::findClosestMatchesBatch(const SampleSet& samples, int n) const
+{
+  const QVector<Sample> vecSamples(PiiClassification::sampleIterators(samples));
+  const int iSamples = vecSamples.size();
+  QVector<PiiClassification::MatchList> vecMatches(iSamples);
+  if (modelCount() > 0 && n > 0)
+    Pii::parallelFor(iSamples, qMin(Pii::parallelThreadCount(0), iSamples / ParallelQueryLimit + 1),
+                     QueryFunction(this, vecSamples.constData(), n, vecMatches.data()));
+
+  QList<PiiClassification::MatchList> lstMatches;
+  for (int i=0; i<iSamples; ++i)
+    lstMatches << vecMatches[i];
+  return lstMatches;
+}
+
+template <class SampleSet>
+QVector<int> PiiHnswIndex<SampleSet>::findClosestMatchBatch(const SampleSet& samples, QVector<double>* distances) const
+{
+  const QList<PiiClassification::MatchList> lstMatches(findClosestMatchesBatch(samples, 1));
+  const int iSamples = PiiSampleSet::sampleCount(samples);
+  QVector<int> vecIndices(iSamples, -1);
+  if (distances != 0)
+    distances->fill(INFINITY, iSamples);
+  for (int i=0; i<lstMatches.size(); ++i)
+    {
+      if (lstMatches[i].size() == 0)
+        continue;
+      vecIndices[i] = lstMatches[i][0].second;
+      if (distances != 0)
+        (*distances)[i] = lstMatches[i][0].first;
+    }
+  return vecIndices;
+}
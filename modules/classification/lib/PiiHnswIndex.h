@@ -0,0 +1,380 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIHNSWINDEX_H
+#define _PIIHNSWINDEX_H
+
+#include <QCoreApplication>
+#include <QPair>
+#include <QSet>
+#include <QVector>
+#include <QList>
+#include <PiiParallel.h>
+#include <PiiProgressController.h>
+#include "PiiSampleSet.h"
+#include "PiiClassification.h"
+#include "PiiSquaredGeometricDistance.h"
+#include "PiiNearestNeighborIndex.h"
+#include "PiiProductQuantizer.h"
+#include <PiiSerialization.h>
+#include <PiiNameValuePair.h>
+#include <PiiSharedD.h>
+
+/**
+ * Hierarchical navigable small world graph for approximate nearest
+ * neighbor search. The index connects each model sample to a few of
+ * its nearest neighbors, forming a graph in which any model can be
+ * reached from any other in a small number of steps. A search starts
+ * from a fixed entry point and greedily moves towards the query
+ * sample. To make long jumps possible, the graph is organized in
+ * layers. Each model is present on the lowest layer, and the number
+ * of models decreases exponentially on higher layers. The search
+ * first descends through the sparse upper layers to find a good
+ * starting point on the lowest one.
+ *
+ * Unlike PiiKdTree, the graph does not suffer much from the curse of
+ * dimensionality. It finds the nearest neighbors of
+ * high-dimensional feature point descriptors with a high
+ * probability, even if there are millions of models. The accuracy
+ * and speed are controlled by [searchWidth()]: the number of
+ * candidates kept during a search.
+ *
+ * If [quantizerSubspaceCount()] is non-zero, the models are
+ * compressed with PiiProductQuantizer once the graph has been built.
+ * This reduces the size of the index dramatically, but distances
+ * are only estimated. The returned distances are the estimates, and
+ * the order of close matches may be wrong.
+ *
+ * The index uses squared geometric distances.
+ *
+ * ~~~(c++)
+ * PiiHnswIndex<PiiMatrix<float> > index;
+ * index.setQuantizerSubspaceCount(16);
+ * index.buildIndex(matModels);
+ * index.setSearchWidth(100);
+ * QList<PiiClassification::MatchList> lstMatches = index.findClosestMatchesBatch(matQueries, 2);
+ * ~~~
+ *
+ * @see PiiNearestNeighborIndex
+ */
+template <class SampleSet> class PiiHnswIndex : public PiiNearestNeighborIndex<SampleSet>
+{
+  friend struct PiiSerialization::Accessor;
+  template <class Archive> void serialize(Archive& archive, const unsigned int)
+  {
+    if (Archive::InputArchive)
+      d = d->detach();
+    archive & PII_NVP("features", d->iFeatureCount);
+    archive & PII_NVP("connections", d->iMaxConnections);
+    archive & PII_NVP("constructionWidth", d->iConstructionWidth);
+    archive & PII_NVP("searchWidth", d->iSearchWidth);
+    archive & PII_NVP("subspaces", d->iQuantizerSubspaceCount);
+    archive & PII_NVP("entryPoint", d->iEntryPoint);
+    archive & PII_NVP("maxLevel", d->iMaxLevel);
+    archive & PII_NVP("levels", d->vecLevels);
+    archive & PII_NVP("links", d->vecBaseLinks);
+    archive & PII_NVP("upperLinks", d->vecUpperLinks);
+    archive & PII_NVP("points", d->vecPoints);
+    archive & PII_NVP("quantizer", d->quantizer);
+    archive & PII_NVP("codes", d->vecCodes);
+  }
+
+public:
+  typedef typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator Sample;
+
+  /**
+   * Constructs an empty index.
+   */
+  PiiHnswIndex();
+  /**
+   * Constructs a copy of *other*. The data is implicitly shared.
+   */
+  PiiHnswIndex(const PiiHnswIndex& other);
+  /**
+   * Constructs an index out of the given model samples using the
+   * default parameters.
+   */
+  PiiHnswIndex(const SampleSet& modelSet);
+  ~PiiHnswIndex();
+
+  PiiHnswIndex& operator= (const PiiHnswIndex& other);
+
+  /**
+   * Sets the maximum number of neighbors each model is connected to
+   * on the upper layers. On the lowest layer, twice as many
+   * connections are allowed. More connections improve accuracy in
+   * high-dimensional spaces, but make both building and searching
+   * slower and the index larger. Typical values are between 8 and
+   * 48. The change takes effect when the index is rebuilt. The
+   * default is 16.
+   */
+  void setMaxConnections(int maxConnections);
+  /**
+   * Returns the maximum number of connections per model and layer.
+   */
+  int maxConnections() const { return d->iMaxConnections; }
+
+  /**
+   * Sets the number of candidates kept when searching for the
+   * neighbors of a model while building the index. Larger values
+   * make a better graph but slow down building. The change takes
+   * effect when the index is rebuilt. The default is 100.
+   */
+  void setConstructionSearchWidth(int constructionSearchWidth);
+  /**
+   * Returns the search width used while building the index.
+   */
+  int constructionSearchWidth() const { return d->iConstructionWidth; }
+
+  /**
+   * Sets the number of candidates kept while searching. The larger
+   * the width, the more likely it is that the true nearest neighbors
+   * will be found, and the longer it takes. At least *n* candidates
+   * are always kept when looking for *n* closest matches. The change
+   * takes effect immediately. A non-positive value restores the
+   * default, which is 64.
+   */
+  void setSearchWidth(int searchWidth);
+  /**
+   * Returns the number of candidates kept while searching.
+   */
+  int searchWidth() const { return d->iSearchWidth; }
+
+  /**
+   * Sets the number of subspaces used in compressing the models. If
+   * *subspaceCount* is zero, the models are stored uncompressed.
+   * Otherwise, each model takes *subspaceCount* bytes. See
+   * PiiProductQuantizer. The change takes effect when the index is
+   * rebuilt. The default is zero.
+   */
+  void setQuantizerSubspaceCount(int subspaceCount);
+  /**
+   * Returns the number of subspaces used in compressing the models.
+   */
+  int quantizerSubspaceCount() const { return d->iQuantizerSubspaceCount; }
+
+  /**
+   * Returns `true` if the models in the index are compressed, and
+   * `false` otherwise.
+   */
+  bool isCompressed() const { return d->quantizer.isTrained(); }
+
+  /**
+   * Discards the old index and builds a new one out of *modelSet*.
+   * Models are inserted to the graph one at a time, which makes
+   * building much slower than searching. If compression is enabled,
+   * the product quantizer is trained with *modelSet* once the graph
+   * is ready.
+   *
+   * The uncompressed models and the links of the lowest layer are
+   * stored in two QVectors, and neither may exceed 2 GB. With 128
+   * `float` features, this limits the index to about four million
+   * models. Compression is applied only after the graph has been
+   * built, so it does not raise the limit.
+   *
+   * @exception PiiClassificationException& if the algorithm was
+   * interrupted through *controller*, or if *modelSet* is too large.
+   */
+  void buildIndex(const SampleSet& modelSet, PiiProgressController* controller = 0);
+
+  int modelCount() const { return d->vecLevels.size(); }
+
+  /**
+   * Returns the index of the approximate nearest neighbor of
+   * *sample* in the model set, or -1 if the index is empty.
+   *
+   * @param distance an optional output-value argument that will store
+   * the (possibly estimated) *squared* geometric distance to the
+   * returned neighbor.
+   */
+  int findClosestMatch(Sample sample, double* distance = 0) const;
+
+  /**
+   * Returns the approximate *n* closest matches of *sample*. The
+   * returned list is sorted in ascending order according to distance.
+   * If the index is smaller than *n*, less than *n* matches will be
+   * returned.
+   */
+  PiiClassification::MatchList findClosestMatches(Sample sample, int n) const;
+
+  /**
+   * Finds the approximate nearest neighbor for each sample in
+   * *samples*. The samples are divided among all available processor
+   * cores.
+   *
+   * @param distances an optional output-value argument that will
+   * store the distance to the returned neighbor of each sample.
+   *
+   * @return the index of the closest model for each sample, or -1 for
+   * all samples if the index is empty.
+   */
+  QVector<int> findClosestMatchBatch(const SampleSet& samples, QVector<double>* distances = 0) const;
+
+  /**
+   * Finds the approximate *n* closest matches for each sample in
+   * *samples*. The samples are divided among all available processor
+   * cores.
+   */
+  QList<PiiClassification::MatchList> findClosestMatchesBatch(const SampleSet& samples, int n) const;
+
+  PiiHnswIndex* clone() const { return new PiiHnswIndex(*this); }
+
+private:
+  static QString tr(const char* s) { return QCoreApplication::translate("PiiHnswIndex", s); }
+
+  typedef typename PiiSampleSet::Traits<SampleSet>::FeatureType T;
+  typedef PiiSquaredGeometricDistance<Sample> Measure;
+  typedef PiiDistanceKernel<Measure> Kernel;
+  // Distance to a model and its index
+  typedef QPair<double,int> Candidate;
+
+  // Each thread gets at least this many queries in batch look-ups.
+  enum { ParallelQueryLimit = 16 };
+
+  /* Marks models visited during a search. A dense set is used when
+     many searches are performed in a row. Its initialization is
+     O(N), but clearing is O(1). */
+  class DenseVisitedSet
+  {
+  public:
+    DenseVisitedSet(int size) : _vecTags(size, 0), _uiTag(0) {}
+    void clear()
+    {
+      if (++_uiTag == 0)
+        {
+          _vecTags.fill(0);
+          _uiTag = 1;
+        }
+    }
+    bool visit(int index)
+    {
+      if (_vecTags[index] == _uiTag)
+        return false;
+      _vecTags[index] = _uiTag;
+      return true;
+    }
+  private:
+    QVector<unsigned int> _vecTags;
+    unsigned int _uiTag;
+  };
+
+  // A set whose size only depends on the number of visited models.
+  class SparseVisitedSet
+  {
+  public:
+    void clear() { _setVisited.clear(); }
+    bool visit(int index)
+    {
+      if (_setVisited.contains(index))
+        return false;
+      _setVisited.insert(index);
+      return true;
+    }
+  private:
+    QSet<int> _setVisited;
+  };
+
+  class ExactDistance;
+  class CompressedDistance;
+  class QueryFunction;
+
+  class Data : public PiiSharedD<Data>
+  {
+  public:
+    Data() :
+      iFeatureCount(0),
+      iMaxConnections(16),
+      iConstructionWidth(100),
+      iSearchWidth(64),
+      iQuantizerSubspaceCount(0),
+      iEntryPoint(-1),
+      iMaxLevel(-1)
+    {}
+    Data(const Data& other) :
+      PiiSharedD<Data>(),
+      iFeatureCount(other.iFeatureCount),
+      iMaxConnections(other.iMaxConnections),
+      iConstructionWidth(other.iConstructionWidth),
+      iSearchWidth(other.iSearchWidth),
+      iQuantizerSubspaceCount(other.iQuantizerSubspaceCount),
+      iEntryPoint(other.iEntryPoint),
+      iMaxLevel(other.iMaxLevel),
+      vecLevels(other.vecLevels),
+      vecBaseLinks(other.vecBaseLinks),
+      vecUpperLinks(other.vecUpperLinks),
+      vecPoints(other.vecPoints),
+      quantizer(other.quantizer),
+      vecCodes(other.vecCodes)
+    {}
+
+    int iFeatureCount, iMaxConnections, iConstructionWidth, iSearchWidth, iQuantizerSubspaceCount;
+    int iEntryPoint, iMaxLevel;
+    // The highest layer of each model.
+    QVector<int> vecLevels;
+    /* Neighbors on the lowest layer. Each model has a block of
+       2*iMaxConnections+1 elements. The first one is the number of
+       neighbors, followed by their indices. */
+    QVector<int> vecBaseLinks;
+    // Neighbors on layers 1...vecLevels[i], iMaxConnections+1
+    // elements per layer.
+    QVector<QVector<int> > vecUpperLinks;
+    // Uncompressed models, iFeatureCount elements each.
+    QVector<T> vecPoints;
+    PiiProductQuantizer<SampleSet> quantizer;
+    // Compressed models, quantizer.subspaceCount() bytes each.
+    QVector<unsigned char> vecCodes;
+    Measure measure;
+  } *d;
+
+  inline int maxLinks(int level) const { return level == 0 ? 2 * d->iMaxConnections : d->iMaxConnections; }
+  inline const int* links(int node, int level) const
+  {
+    return level == 0 ?
+      d->vecBaseLinks.constData() + qint64(node) * (2 * d->iMaxConnections + 1) :
+      d->vecUpperLinks[node].constData() + (level-1) * (d->iMaxConnections + 1);
+  }
+  inline int* links(int node, int level)
+  {
+    return level == 0 ?
+      d->vecBaseLinks.data() + qint64(node) * (2 * d->iMaxConnections + 1) :
+      d->vecUpperLinks[node].data() + (level-1) * (d->iMaxConnections + 1);
+  }
+  inline const T* point(int node) const { return d->vecPoints.constData() + qint64(node) * d->iFeatureCount; }
+  inline double pointDistance(int node1, int node2) const
+  {
+    return Kernel::distance(d->measure, point(node1), point(node2), d->iFeatureCount);
+  }
+
+  // Index construction
+  void insert(int node, int level, DenseVisitedSet& visited);
+  void connect(int node, int neighbor, double distance, int level);
+  QVector<Candidate> selectNeighbors(const QVector<Candidate>& candidates, int count) const;
+
+  // Search
+  template <class Distance, class VisitedSet>
+  void searchLevel(const Distance& distance,
+                   QVector<Candidate>& entryPoints,
+                   int width,
+                   int level,
+                   VisitedSet& visited) const;
+  template <class VisitedSet>
+  QVector<Candidate> search(Sample sample, int width, VisitedSet& visited) const;
+  template <class VisitedSet>
+  PiiClassification::MatchList findClosestMatches(Sample sample, int n, VisitedSet& visited) const;
+};
+
+#include "PiiHnswIndex-templates.h"
+
+#endif //_PIIHNSWINDEX_H
@@ -0,0 +1,529 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIIKMEANS_H
+# error "Never use <PiiKMeans-templates.h> directly; include <PiiKMeans.h> instead."
+#endif
+
+#include <PiiRandom.h>
+#include <PiiMath.h>
+
+template <class SampleSet> class PiiKMeans<SampleSet>::SeedFunction
+{
+public:
+  SeedFunction(const SampleSet& samples, const int* indices,
+               ConstFeatureIterator centroid, double* distances) :
+    _samples(samples), _pIndices(indices), _centroid(centroid), _pDistances(distances),
+    _iFeatures(PiiSampleSet::featureCount(samples))
+  {}
+
+  void operator() (int first, int last) const
+  {
+    Measure measure;
+    for (int i=first; i<last; ++i)
+      {
+        double dDistance = Kernel::distance(measure, PiiSampleSet::sampleAt(_samples, _pIndices[i]),
+                                            _centroid, _iFeatures);
+        if (dDistance < _pDistances[i])
+          _pDistances[i] = dDistance;
+      }
+  }
+
+private:
+  const SampleSet& _samples;
+  const int* _pIndices;
+  ConstFeatureIterator _centroid;
+  double* _pDistances;
+  int _iFeatures;
+};
+
+template <class SampleSet> class PiiKMeans<SampleSet>::AssignFunction
+{
+public:
+  AssignFunction(const SampleSet& samples, const int* indices,
+                 const ConstFeatureIterator* centroids, int centroidCount,
+                 int* assignments, double* distances) :
+    _samples(samples), _pIndices(indices), _pCentroids(centroids), _iCentroids(centroidCount),
+    _pAssignments(assignments), _pDistances(distances),
+    _iFeatures(PiiSampleSet::featureCount(samples))
+  {}
+
+  void operator() (int first, int last) const
+  {
+    Measure measure;
+    // The kernel compares blocks of samples to all centroids.
+    const int iBlockSize = 64;
+    ConstFeatureIterator aSamples[iBlockSize];
+    for (int iStart=first; iStart<last; iStart += iBlockSize)
+      {
+        const int iCount = qMin(iBlockSize, last - iStart);
+        for (int i=0; i<iCount; ++i)
+          aSamples[i] = PiiSampleSet::sampleAt(_samples, _pIndices != 0 ? _pIndices[iStart + i] : iStart + i);
+        Kernel::findClosestMatches(measure, aSamples, iCount, _pCentroids, _iCentroids, _iFeatures,
+                                   _pAssignments + iStart, _pDistances + iStart);
+      }
+  }
+
+private:
+  const SampleSet& _samples;
+  const int* _pIndices;
+  const ConstFeatureIterator* _pCentroids;
+  int _iCentroids;
+  int* _pAssignments;
+  double* _pDistances;
+  int _iFeatures;
+};
+
+/* One assignment step of Hamerly's algorithm. Bounds are geometric
+   (not squared) distances, because the triangle inequality only holds
+   for them. */
+template <class SampleSet> class PiiKMeans<SampleSet>::BoundedAssignFunction
+{
+public:
+  BoundedAssignFunction(const SampleSet& samples,
+                        const ConstFeatureIterator* centroids, int centroidCount,
+                        const double* halfSeparations,
+                        int* assignments, double* upperBounds, double* lowerBounds,
+                        int* previousAssignments) :
+    _samples(samples), _pCentroids(centroids), _iCentroids(centroidCount),
+    _pHalfSeparations(halfSeparations),
+    _pAssignments(assignments), _pUpperBounds(upperBounds), _pLowerBounds(lowerBounds),
+    _pPreviousAssignments(previousAssignments),
+    _iFeatures(PiiSampleSet::featureCount(samples))
+  {}
+
+  void operator() (int first, int last) const
+  {
+    Measure measure;
+    for (int i=first; i<last; ++i)
+      {
+        ConstFeatureIterator sample = PiiSampleSet::sampleAt(_samples, i);
+        const int iAssignment = _pAssignments[i];
+        _pPreviousAssignments[i] = -1;
+        if (iAssignment >= 0)
+          {
+            // The sample cannot be closer to any other centroid. Ties
+            // go to the full search below, which picks the lowest
+            // centroid index like Lloyd's algorithm does.
+            const double dLimit = qMax(_pHalfSeparations[iAssignment], _pLowerBounds[i]);
+            if (_pUpperBounds[i] < dLimit)
+              continue;
+            // Tighten the upper bound and try again.
+            _pUpperBounds[i] = sqrt(Kernel::distance(measure, sample, _pCentroids[iAssignment], _iFeatures));
+            if (_pUpperBounds[i] < dLimit)
+              continue;
+          }
+
+        double dClosest = INFINITY, dSecondClosest = INFINITY;
+        int iClosest = 0;
+        for (int c=0; c<_iCentroids; ++c)
+          {
+            const double dDistance = Kernel::distance(measure, sample, _pCentroids[c], _iFeatures);
+            if (dDistance < dClosest)
+              {
+                dSecondClosest = dClosest;
+                dClosest = dDistance;
+                iClosest = c;
+              }
+            else if (dDistance < dSecondClosest)
+              dSecondClosest = dDistance;
+          }
+        _pUpperBounds[i] = sqrt(dClosest);
+        _pLowerBounds[i] = sqrt(dSecondClosest);
+        if (iClosest != iAssignment)
+          {
+            _pPreviousAssignments[i] = iAssignment;
+            _pAssignments[i] = iClosest;
+          }
+      }
+  }
+
+private:
+  const SampleSet& _samples;
+  const ConstFeatureIterator* _pCentroids;
+  int _iCentroids;
+  const double* _pHalfSeparations;
+  int* _pAssignments;
+  double* _pUpperBounds, *_pLowerBounds;
+  int* _pPreviousAssignments;
+  int _iFeatures;
+};
+
+template <class SampleSet> PiiKMeans<SampleSet>::Data::Data() :
+  seedingMethod(PiiClassification::KMeansPlusPlusSeeding),
+  iMaxIterations(0),
+  iBatchSize(0),
+  iIterationCount(0),
+  dInertia(0),
+  bAssignmentsPending(false)
+{
+}
+
+template <class SampleSet> PiiKMeans<SampleSet>::PiiKMeans() :
+  d(new Data)
+{
+}
+
+template <class SampleSet> PiiKMeans<SampleSet>::~PiiKMeans()
+{
+  delete d;
+}
+
+template <class SampleSet> int PiiKMeans<SampleSet>::chunkCount(int sampleCount, int centroidCount)
+{
+  return qMin(Pii::parallelThreadCount(0), int(qint64(sampleCount) * centroidCount / ParallelWorkLimit) + 1);
+}
+
+template <class SampleSet> void PiiKMeans<SampleSet>::reset()
+{
+  d->vecAssignments.clear();
+  d->dInertia = 0;
+  d->iIterationCount = 0;
+  d->samples = SampleSet();
+  d->centroids = SampleSet();
+  d->bAssignmentsPending = false;
+}
+
+template <class SampleSet>
+SampleSet PiiKMeans<SampleSet>::cluster(const SampleSet& samples, int k, PiiProgressController* controller)
+{
+  const int iSamples = PiiSampleSet::sampleCount(samples),
+    iFeatures = PiiSampleSet::featureCount(samples);
+  reset();
+  if (k <= 0 || k > iSamples || iFeatures == 0)
+    return PiiSampleSet::create<SampleSet>(0, iFeatures);
+
+  return cluster(samples, seed(samples, k), controller);
+}
+
+template <class SampleSet>
+SampleSet PiiKMeans<SampleSet>::cluster(const SampleSet& samples, const SampleSet& initialCentroids,
+                                        PiiProgressController* controller)
+{
+  const int iSamples = PiiSampleSet::sampleCount(samples),
+    iFeatures = PiiSampleSet::featureCount(samples);
+  reset();
+  if (iSamples == 0 || iFeatures == 0 ||
+      PiiSampleSet::sampleCount(initialCentroids) == 0 ||
+      PiiSampleSet::featureCount(initialCentroids) != iFeatures)
+    return PiiSampleSet::create<SampleSet>(0, iFeatures);
+
+  SampleSet centroids(initialCentroids);
+  if (d->iBatchSize > 0 && d->iBatchSize < iSamples)
+    {
+      runMiniBatch(samples, centroids, controller);
+      // Comparing all samples to all centroids may take longer than
+      // the whole mini-batch run. Postpone it until it is needed.
+      d->samples = samples;
+      d->centroids = centroids;
+      d->bAssignmentsPending = true;
+    }
+  else
+    {
+      // The assignments of the last round are final.
+      runBatch(samples, centroids, controller);
+      Measure measure;
+      const SampleSet& constCentroids = centroids;
+      for (int i=0; i<iSamples; ++i)
+        d->dInertia += Kernel::distance(measure, PiiSampleSet::sampleAt(samples, i),
+                                        PiiSampleSet::sampleAt(constCentroids, d->vecAssignments[i]),
+                                        iFeatures);
+    }
+  return centroids;
+}
+
+template <class SampleSet> void PiiKMeans<SampleSet>::assignPending() const
+{
+  if (!d->bAssignmentsPending)
+    return;
+  const int iSamples = PiiSampleSet::sampleCount(d->samples);
+  d->vecAssignments.resize(iSamples);
+  QVector<double> vecDistances(iSamples);
+  assign(d->samples, QVector<int>(), d->centroids, d->vecAssignments.data(), vecDistances.data());
+  for (int i=0; i<iSamples; ++i)
+    d->dInertia += vecDistances[i];
+  d->samples = SampleSet();
+  d->centroids = SampleSet();
+  d->bAssignmentsPending = false;
+}
+
+template <class SampleSet>
+SampleSet PiiKMeans<SampleSet>::seed(const SampleSet& samples, int k) const
+{
+  const int iSamples = PiiSampleSet::sampleCount(samples);
+  SampleSet result(PiiSampleSet::create<SampleSet>(0, PiiSampleSet::featureCount(samples)));
+  PiiSampleSet::reserve(result, k);
+  const SampleSet& constResult = result;
+
+  // Mini-batch k-means only seeds from a subset.
+  QVector<int> vecCandidates;
+  if (d->iBatchSize > 0 && d->iBatchSize < iSamples)
+    vecCandidates = Pii::selectRandomly(qBound(k, 3 * d->iBatchSize, iSamples), iSamples);
+  else
+    {
+      vecCandidates.resize(iSamples);
+      for (int i=0; i<iSamples; ++i)
+        vecCandidates[i] = i;
+    }
+  const int iCandidates = vecCandidates.size();
+
+  if (d->seedingMethod == PiiClassification::RandomKMeansSeeding)
+    {
+      QVector<int> vecSelected(Pii::selectRandomly(k, iCandidates));
+      for (int i=0; i<k; ++i)
+        PiiSampleSet::append(result, PiiSampleSet::sampleAt(samples, vecCandidates[vecSelected[i]]));
+      return result;
+    }
+
+  // k-means++: distances to the closest centroid selected so far
+  // weight the selection of the next one.
+  QVector<double> vecDistances(iCandidates, INFINITY);
+  const int iChunks = chunkCount(iCandidates, 1);
+  int iSelected = qMin(int(Pii::uniformRandom() * iCandidates), iCandidates-1);
+  for (int c=0; c<k; ++c)
+    {
+      PiiSampleSet::append(result, PiiSampleSet::sampleAt(samples, vecCandidates[iSelected]));
+      if (c == k-1)
+        break;
+      Pii::parallelFor(iCandidates, iChunks,
+                       SeedFunction(samples, vecCandidates.constData(),
+                                    PiiSampleSet::sampleAt(constResult, c),
+                                    vecDistances.data()));
+      double dSum = 0;
+      for (int i=0; i<iCandidates; ++i)
+        dSum += vecDistances[i];
+      // All candidates coincide with a centroid.
+      if (dSum <= 0)
+        {
+          iSelected = qMin(int(Pii::uniformRandom() * iCandidates), iCandidates-1);
+          continue;
+        }
+      double dLimit = Pii::uniformRandom() * dSum;
+      iSelected = -1;
+      for (int i=0; i<iCandidates; ++i)
+        if (vecDistances[i] > 0)
+          {
+            iSelected = i;
+            dLimit -= vecDistances[i];
+            if (dLimit < 0)
+              break;
+          }
+    }
+  return result;
+}
+
+template <class SampleSet>
+void PiiKMeans<SampleSet>::assign(const SampleSet& samples, const QVector<int>& indices,
+                                  const SampleSet& centroids,
+                                  int* assignments, double* distances) const
+{
+  const int iCentroids = PiiSampleSet::sampleCount(centroids),
+    iCount = indices.isEmpty() ? PiiSampleSet::sampleCount(samples) : indices.size();
+  QVector<ConstFeatureIterator> vecCentroids(iCentroids);
+  for (int c=0; c<iCentroids; ++c)
+    vecCentroids[c] = PiiSampleSet::sampleAt(centroids, c);
+  Pii::parallelFor(iCount, chunkCount(iCount, iCentroids),
+                   AssignFunction(samples, indices.isEmpty() ? 0 : indices.constData(),
+                                  vecCentroids.constData(), iCentroids,
+                                  assignments, distances));
+}
+
+template <class SampleSet>
+void PiiKMeans<SampleSet>::runBatch(const SampleSet& samples, SampleSet& centroids, PiiProgressController* controller)
+{
+  const int iSamples = PiiSampleSet::sampleCount(samples),
+    iFeatures = PiiSampleSet::featureCount(samples),
+    iCentroids = PiiSampleSet::sampleCount(centroids),
+    iChunks = chunkCount(iSamples, iCentroids);
+  Measure measure;
+
+  QVector<int> vecAssignments(iSamples, -1), vecPrevious(iSamples);
+  QVector<double> vecUpper(iSamples), vecLower(iSamples);
+  QVector<double> vecHalfSeparations(iCentroids, INFINITY), vecMoves(iCentroids);
+  QVector<double> vecSums(iCentroids * iFeatures);
+  QVector<int> vecCounts(iCentroids);
+  QVector<ConstFeatureIterator> vecCentroids(iCentroids);
+  QVector<FeatureType> vecCentroid(iFeatures);
+  const SampleSet& constCentroids = centroids;
+  for (int c=0; c<iCentroids; ++c)
+    vecCentroids[c] = PiiSampleSet::sampleAt(constCentroids, c);
+
+  // The first assignment compares all samples to all centroids.
+  Pii::parallelFor(iSamples, iChunks,
+                   BoundedAssignFunction(samples, vecCentroids.constData(), iCentroids,
+                                         vecHalfSeparations.constData(),
+                                         vecAssignments.data(), vecUpper.data(), vecLower.data(),
+                                         vecPrevious.data()));
+  for (int i=0; i<iSamples; ++i)
+    {
+      ConstFeatureIterator sample = PiiSampleSet::sampleAt(samples, i);
+      double* pSum = vecSums.data() + vecAssignments[i] * iFeatures;
+      for (int f=0; f<iFeatures; ++f)
+        pSum[f] += sample[f];
+      ++vecCounts[vecAssignments[i]];
+    }
+
+  while (true)
+    {
+      // Move the centroids to the means of their clusters.
+      bool bMoved = false;
+      for (int c=0; c<iCentroids; ++c)
+        {
+          vecMoves[c] = 0;
+          if (vecCounts[c] == 0)
+            continue;
+          const double* pSum = vecSums.constData() + c * iFeatures;
+          for (int f=0; f<iFeatures; ++f)
+            vecCentroid[f] = FeatureType(pSum[f] / vecCounts[c]);
+          vecMoves[c] = sqrt(Kernel::distance(measure, PiiSampleSet::sampleAt(constCentroids, c),
+                                              vecCentroid.constData(), iFeatures));
+          if (vecMoves[c] > 0)
+            {
+              PiiSampleSet::setSampleAt(centroids, c, vecCentroid.constData());
+              bMoved = true;
+            }
+        }
+      for (int c=0; c<iCentroids; ++c)
+        vecCentroids[c] = PiiSampleSet::sampleAt(constCentroids, c);
+
+      ++d->iIterationCount;
+      if (!bMoved)
+        break;
+      // After the last move, the samples are only reassigned to the
+      // final centroids.
+      const bool bLastIteration = d->iMaxIterations > 0 && d->iIterationCount >= d->iMaxIterations;
+      if (!bLastIteration)
+        PII_TRY_CONTINUE(controller, d->iMaxIterations > 0 ? double(d->iIterationCount) / d->iMaxIterations : NAN);
+
+      // Moving centroids loosen the bounds.
+      int iMaxMove = 0;
+      for (int c=1; c<iCentroids; ++c)
+        if (vecMoves[c] > vecMoves[iMaxMove])
+          iMaxMove = c;
+      double dSecondMaxMove = 0;
+      for (int c=0; c<iCentroids; ++c)
+        if (c != iMaxMove && vecMoves[c] > dSecondMaxMove)
+          dSecondMaxMove = vecMoves[c];
+      for (int i=0; i<iSamples; ++i)
+        {
+          vecUpper[i] += vecMoves[vecAssignments[i]];
+          vecLower[i] -= vecAssignments[i] == iMaxMove ? dSecondMaxMove : vecMoves[iMaxMove];
+        }
+
+      // A sample closer to its centroid than half the distance to the
+      // closest other centroid cannot change its cluster.
+      vecHalfSeparations.fill(INFINITY);
+      for (int c1=0; c1<iCentroids; ++c1)
+        for (int c2=c1+1; c2<iCentroids; ++c2)
+          {
+            const double dHalf = 0.5 * sqrt(Kernel::distance(measure, vecCentroids[c1], vecCentroids[c2], iFeatures));
+            if (dHalf < vecHalfSeparations[c1])
+              vecHalfSeparations[c1] = dHalf;
+            if (dHalf < vecHalfSeparations[c2])
+              vecHalfSeparations[c2] = dHalf;
+          }
+
+      Pii::parallelFor(iSamples, iChunks,
+                       BoundedAssignFunction(samples, vecCentroids.constData(), iCentroids,
+                                             vecHalfSeparations.constData(),
+                                             vecAssignments.data(), vecUpper.data(), vecLower.data(),
+                                             vecPrevious.data()));
+      if (bLastIteration)
+        break;
+
+      // Move changed samples between cluster sums.
+      for (int i=0; i<iSamples; ++i)
+        if (vecPrevious[i] >= 0)
+          {
+            ConstFeatureIterator sample = PiiSampleSet::sampleAt(samples, i);
+            double* pOldSum = vecSums.data() + vecPrevious[i] * iFeatures;
+            double* pNewSum = vecSums.data() + vecAssignments[i] * iFeatures;
+            for (int f=0; f<iFeatures; ++f)
+              {
+                pOldSum[f] -= sample[f];
+                pNewSum[f] += sample[f];
+              }
+            --vecCounts[vecPrevious[i]];
+            ++vecCounts[vecAssignments[i]];
+          }
+    }
+  d->vecAssignments = vecAssignments;
+}
+
+template <class SampleSet>
+void PiiKMeans<SampleSet>::runMiniBatch(const SampleSet& samples, SampleSet& centroids, PiiProgressController* controller)
+{
+  const int iSamples = PiiSampleSet::sampleCount(samples),
+    iFeatures = PiiSampleSet::featureCount(samples),
+    iCentroids = PiiSampleSet::sampleCount(centroids),
+    iIterations = d->iMaxIterations > 0 ? d->iMaxIterations : 100;
+
+  // Centroids are updated in double precision and copied to the
+  // sample set after each batch.
+  QVector<double> vecCentroids(iCentroids * iFeatures);
+  const SampleSet& constCentroids = centroids;
+  for (int c=0; c<iCentroids; ++c)
+    {
+      ConstFeatureIterator centroid = PiiSampleSet::sampleAt(constCentroids, c);
+      for (int f=0; f<iFeatures; ++f)
+        vecCentroids[c * iFeatures + f] = centroid[f];
+    }
+  QVector<int> vecCounts(iCentroids), vecBatch(d->iBatchSize), vecAssignments(d->iBatchSize);
+  QVector<double> vecDistances(d->iBatchSize);
+  QVector<bool> vecChanged(iCentroids);
+  QVector<FeatureType> vecCentroid(iFeatures);
+
+  for (d->iIterationCount = 0; d->iIterationCount < iIterations; )
+    {
+      for (int i=0; i<d->iBatchSize; ++i)
+        vecBatch[i] = qMin(int(Pii::uniformRandom() * iSamples), iSamples-1);
+      assign(samples, vecBatch, centroids, vecAssignments.data(), vecDistances.data());
+
+      // Each centroid moves towards its samples with a learning rate
+      // that decreases with the number of samples seen.
+      vecChanged.fill(false);
+      for (int i=0; i<d->iBatchSize; ++i)
+        {
+          const int c = vecAssignments[i];
+          const double dRate = 1.0 / ++vecCounts[c];
+          ConstFeatureIterator sample = PiiSampleSet::sampleAt(samples, vecBatch[i]);
+          double* pCentroid = vecCentroids.data() + c * iFeatures;
+          for (int f=0; f<iFeatures; ++f)
+            pCentroid[f] += dRate * (sample[f] - pCentroid[f]);
+          vecChanged[c] = true;
+        }
+      for (int c=0; c<iCentroids; ++c)
+        if (vecChanged[c])
+          {
+            for (int f=0; f<iFeatures; ++f)
+              vecCentroid[f] = FeatureType(vecCentroids[c * iFeatures + f]);
+            PiiSampleSet::setSampleAt(centroids, c, vecCentroid.constData());
+          }
+
+      ++d->iIterationCount;
+      PII_TRY_CONTINUE(controller, double(d->iIterationCount) / iIterations);
+    }
+}
+
+template <class SampleSet> void PiiKMeans<SampleSet>::setSeedingMethod(PiiClassification::KMeansSeedingMethod seedingMethod) { d->seedingMethod = seedingMethod; }
+template <class SampleSet> PiiClassification::KMeansSeedingMethod PiiKMeans<SampleSet>::seedingMethod() const { return d->seedingMethod; }
+template <class SampleSet> void PiiKMeans<SampleSet>::setMaxIterations(int maxIterations) { d->iMaxIterations = maxIterations; }
+template <class SampleSet> int PiiKMeans<SampleSet>::maxIterations() const { return d->iMaxIterations; }
+template <class SampleSet> void PiiKMeans<SampleSet>::setBatchSize(int batchSize) { d->iBatchSize = qMax(0, batchSize); }
+template <class SampleSet> int PiiKMeans<SampleSet>::batchSize() const { return d->iBatchSize; }
+template <class SampleSet> QVector<int> PiiKMeans<SampleSet>::assignments() const { assignPending(); return d->vecAssignments; }
+template <class SampleSet> double PiiKMeans<SampleSet>::inertia() const { assignPending(); return d->dInertia; }
+template <class SampleSet> int PiiKMeans<SampleSet>::iterationCount() const { return d->iIterationCount; }
@@ -0,0 +1,197 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIIKMEANS_H
+#define _PIIKMEANS_H
+
+#include <QVector>
+#include <PiiParallel.h>
+#include <PiiProgressController.h>
+#include "PiiSampleSet.h"
+#include "PiiClassification.h"
+#include "PiiSquaredGeometricDistance.h"
+
+/**
+ * K-means clustering engine. PiiKMeans partitions a set of samples
+ * into *k* clusters so that the sum of squared geometric distances
+ * from the samples to the centroids of their clusters (the
+ * [inertia()]) is minimized. Compared to PiiClassification::kMeans(),
+ * it adds the following:
+ *
+ * - The initial centroids are selected with k-means++ by default
+ * (see [setSeedingMethod()]). The selection is random, but uses
+ * Pii::uniformRandom() and thus obeys Pii::seedRandom().
+ *
+ * - In batch mode, Hamerly's algorithm avoids most distance
+ * calculations. Each sample keeps an upper bound for the distance to
+ * its own centroid and a lower bound for the distance to any other
+ * centroid. The bounds are updated by the distances the centroids
+ * move, and a sample is compared to all centroids only if the bounds
+ * cannot prove that its assignment stays. The result is that of
+ * Lloyd's algorithm started from the same centroids, including the
+ * rule that ties go to the centroid with the lowest index. Samples
+ * that are almost equally far from two centroids may still end up
+ * in different clusters, because the bounds and the distances are
+ * rounded differently.
+ *
+ * - Samples are assigned to clusters in parallel.
+ *
+ * - If [batchSize()] is non-zero, mini-batch k-means is used instead.
+ * Each iteration draws a random subset of the samples and moves the
+ * centroids towards them with a per-centroid learning rate. This
+ * scales to sample sets much larger than what batch k-means can
+ * handle, at the cost of a slightly worse clustering. The final
+ * [assignments()] and [inertia()] are only calculated when they are
+ * first asked for.
+ *
+ * ~~~(c++)
+ * PiiKMeans<PiiMatrix<float> > kMeans;
+ * PiiMatrix<float> matCentroids(kMeans.cluster(matSamples, 16));
+ * QVector<int> vecClusters(kMeans.assignments());
+ *
+ * // Mini-batch mode for large sample sets
+ * kMeans.setBatchSize(1024);
+ * kMeans.setMaxIterations(200);
+ * matCentroids = kMeans.cluster(matManySamples, 256);
+ * ~~~
+ *
+ * @see PiiProductQuantizer
+ */
+template <class SampleSet> class PiiKMeans
+{
+public:
+  typedef typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator ConstFeatureIterator;
+  typedef typename PiiSampleSet::Traits<SampleSet>::FeatureType FeatureType;
+
+  PiiKMeans();
+  ~PiiKMeans();
+
+  /**
+   * Sets the method of selecting the initial centroids. The default
+   * is `KMeansPlusPlusSeeding`.
+   */
+  void setSeedingMethod(PiiClassification::KMeansSeedingMethod seedingMethod);
+  PiiClassification::KMeansSeedingMethod seedingMethod() const;
+
+  /**
+   * Sets the maximum number of iterations. In batch mode, zero or a
+   * negative value means the algorithm will be run until no sample
+   * changes its cluster. In mini-batch mode, the number of iterations
+   * is always fixed, and zero means 100. The default is zero.
+   */
+  void setMaxIterations(int maxIterations);
+  int maxIterations() const;
+
+  /**
+   * Sets the number of samples used in each iteration of mini-batch
+   * k-means. Zero disables mini-batch mode, which is the default.
+   * Mini-batch mode is also disabled if the batch size is not
+   * smaller than the number of samples.
+   */
+  void setBatchSize(int batchSize);
+  int batchSize() const;
+
+  /**
+   * Clusters *samples* into *k* clusters and returns the centroids,
+   * one per row. If *k* is not positive or greater than the number of
+   * samples, an empty sample set will be returned. If *samples*
+   * contain less than *k* distinct samples, some clusters will be
+   * empty and their centroids duplicates of others.
+   *
+   * @exception PiiClassificationException& if the algorithm was
+   * interrupted through *controller*.
+   */
+  SampleSet cluster(const SampleSet& samples, int k, PiiProgressController* controller = 0);
+
+  /**
+   * Clusters *samples* starting from *initialCentroids* instead of
+   * selecting the initial centroids automatically. This makes it
+   * possible to refine a previous clustering result. The number of
+   * clusters is the number of initial centroids. If there are no
+   * initial centroids or their dimensions don't match those of
+   * *samples*, an empty sample set will be returned.
+   *
+   * @exception PiiClassificationException& if the algorithm was
+   * interrupted through *controller*.
+   */
+  SampleSet cluster(const SampleSet& samples, const SampleSet& initialCentroids,
+                    PiiProgressController* controller = 0);
+
+  /**
+   * Returns the index of the closest centroid for each sample after
+   * [cluster()]. In mini-batch mode, the first call after [cluster()]
+   * compares all samples to all centroids, which may take longer
+   * than the clustering. Until then, PiiKMeans keeps a shallow copy
+   * of the samples.
+   */
+  QVector<int> assignments() const;
+
+  /**
+   * Returns the sum of squared geometric distances from each sample
+   * to its closest centroid after [cluster()]. In mini-batch mode,
+   * the first call calculates the assignments; see [assignments()].
+   */
+  double inertia() const;
+
+  /**
+   * Returns the number of iterations performed by the last call to
+   * [cluster()].
+   */
+  int iterationCount() const;
+
+private:
+  typedef PiiSquaredGeometricDistance<ConstFeatureIterator> Measure;
+  typedef PiiDistanceKernel<Measure> Kernel;
+
+  class SeedFunction;
+  class AssignFunction;
+  class BoundedAssignFunction;
+
+  void reset();
+  void assignPending() const;
+  SampleSet seed(const SampleSet& samples, int k) const;
+  void runBatch(const SampleSet& samples, SampleSet& centroids, PiiProgressController* controller);
+  void runMiniBatch(const SampleSet& samples, SampleSet& centroids, PiiProgressController* controller);
+  void assign(const SampleSet& samples, const QVector<int>& indices, const SampleSet& centroids,
+              int* assignments, double* distances) const;
+  static int chunkCount(int sampleCount, int centroidCount);
+
+  class Data
+  {
+  public:
+    Data();
+
+    PiiClassification::KMeansSeedingMethod seedingMethod;
+    int iMaxIterations, iBatchSize, iIterationCount;
+    QVector<int> vecAssignments;
+    double dInertia;
+    // Mini-batch mode assigns samples on request.
+    SampleSet samples, centroids;
+    bool bAssignmentsPending;
+  } *d;
+
+  enum
+  {
+    // Distance calculations per chunk in parallel loops
+    ParallelWorkLimit = 1 << 16
+  };
+
+  PII_DISABLE_COPY(PiiKMeans);
+};
+
+#include "PiiKMeans-templates.h"
+
+#endif //_PIIKMEANS_H
@@ -17,6 +17,84 @@
 # error "Never use <PiiKdTree-templates.h> directly; include <PiiKdTree.h> instead."
 #endif
 
+#include <algorithm>
+
+
+template <class SampleSet> class PiiKdTree<SampleSet>::BuildFunction
+{
+public:
+  BuildFunction(const PiiKdTree* tree, Node* nodes, int* indices, const BuildTask* tasks) :
+    _pTree(tree), _pNodes(nodes), _pIndices(indices), _pTasks(tasks)
+  {}
+
+  void operator() (int first, int last) const
+  {
+    for (int i=first; i<last; ++i)
+      _pTree->buildNodes(_pNodes, _pTasks[i].node, _pIndices, _pTasks[i].first, _pTasks[i].count, 0);
+  }
+
+private:
+  const PiiKdTree* _pTree;
+  Node* _pNodes;
+  int* _pIndices;
+  const BuildTask* _pTasks;
+};
+
+template <class SampleSet> class PiiKdTree<SampleSet>::CopyFunction
+{
+public:
+  CopyFunction(const SampleSet& modelSet, const int* indices, int featureCount, T* points) :
+    _pModelSet(&modelSet), _pIndices(indices), _iFeatureCount(featureCount), _pPoints(points)
+  {}
+
+  void operator() (int first, int last) const
+  {
+    for (int i=first; i<last; ++i)
+      {
+        Sample pSample = PiiSampleSet::sampleAt(*_pModelSet, _pIndices[i]);
+        T* pPoint = _pPoints + qint64(i) * _iFeatureCount;
+        for (int j=0; j<_iFeatureCount; ++j)
+          pPoint[j] = pSample[j];
+      }
+  }
+
+private:
+  const SampleSet* _pModelSet;
+  const int* _pIndices;
+  int _iFeatureCount;
+  T* _pPoints;
+};
+
+template <class SampleSet> class PiiKdTree<SampleSet>::QueryFunction
+{
+public:
+  QueryFunction(const PiiKdTree* tree, const Sample* samples, int maxEvaluations,
+                QPair<double,int>* closest, PiiClassification::MatchList* matches) :
+    _pTree(tree), _pSamples(samples), _iMaxEvaluations(maxEvaluations),
+    _pClosest(closest), _pMatches(matches)
+  {}
+
+  void operator() (int first, int last) const
+  {
+    for (int i=first; i<last; ++i)
+      {
+        if (_pMatches != 0)
+          {
+            _pTree->search(_pSamples[i], _iMaxEvaluations, _pMatches[i]);
+            _pMatches[i].sort();
+          }
+        else
+          _pTree->search(_pSamples[i], _iMaxEvaluations, _pClosest[i]);
+      }
+  }
+
+private:
+  const PiiKdTree* _pTree;
+  const Sample* _pSamples;
+  int _iMaxEvaluations;
+  QPair<double,int>* _pClosest;
+  PiiClassification::MatchList* _pMatches;
+};
 
 template <class SampleSet>
 PiiKdTree<SampleSet>::PiiKdTree() :
@@ -50,94 +128,202 @@ PiiKdTree<SampleSet>& PiiKdTree<SampleSet>::operator= (const PiiKdTree& other)
   return *this;
 }
 
+template <class SampleSet> template <class Archive>
+void PiiKdTree<SampleSet>::load(Archive& archive, const unsigned int version)
+{
+  if (version == 0)
+    {
+      // Old archives contain a pointer-linked tree. Skip it.
+      LegacyNode* pRoot = 0;
+      archive >> PII_NVP("root", pRoot);
+      delete pRoot;
+    }
+  int iFeatureCount = 0, iBucketSize = DefaultBucketSize;
+  archive >> PII_NVP("features", iFeatureCount);
+  if (version > 0)
+    archive >> PII_NVP("bucketSize", iBucketSize);
+  SampleSet modelSet;
+  archive >> PII_NVP("models", modelSet);
+  setBucketSize(iBucketSize);
+  buildTree(modelSet);
+}
+
+template <class SampleSet> void PiiKdTree<SampleSet>::setBucketSize(int bucketSize)
+{
+  d = d->detach();
+  d->iBucketSize = qMax(1, bucketSize);
+}
+
 template <class SampleSet>
 void PiiKdTree<SampleSet>::buildTree(const SampleSet& modelSet,
                                      PiiProgressController* controller)
 {
+  const int iBucketSize = d->iBucketSize;
   d->release();
-  d = new Data;
+  d = new Data(iBucketSize);
   const int iSampleCount = PiiSampleSet::sampleCount(modelSet);
   d->iFeatureCount = PiiSampleSet::featureCount(modelSet);
   if (d->iFeatureCount == 0 || iSampleCount == 0)
     return;
 
-  QVector<FeatureSorter> vecSorters(iSampleCount);
-  QVector<double> vecMeans(d->iFeatureCount);
-  d->pMeans = vecMeans.data();
-  QVector<double> vecVars(d->iFeatureCount);
-  d->pVars = vecVars.data();
+  d->modelSet = modelSet;
+  QVector<int> vecIndices(iSampleCount);
   for (int i=0; i<iSampleCount; ++i)
-    vecSorters[i].second = i;
+    vecIndices[i] = i;
+  QVector<Node> vecNodes(nodeCount(iSampleCount));
 
-  d->modelSet = modelSet;
-  // May throw a PiiClassificationException
-  d->pRoot = createNode(vecSorters.data(), iSampleCount, 0, controller);
+  const int iThreadCount = iSampleCount >= ParallelBuildLimit ? Pii::parallelThreadCount(0) : 1;
+  if (iThreadCount == 1)
+    buildNodes(vecNodes.data(), 0, vecIndices.data(), 0, iSampleCount, controller); // may throw
+  else
+    {
+      /* Split the top of the tree in this thread until there are
+         enough independent subtrees to keep all threads busy. Since
+         the shape of the tree only depends on the number of samples,
+         the location of each subtree in the node array is known
+         before it has been built.
+      */
+      QList<BuildTask> lstQueue;
+      QVector<BuildTask> vecTasks;
+      lstQueue << BuildTask(0, 0, iSampleCount);
+      while (!lstQueue.isEmpty() && lstQueue.size() + vecTasks.size() < iThreadCount * 4)
+        {
+          BuildTask task = lstQueue.first();
+          lstQueue.removeAt(0);
+          if (task.count <= d->iBucketSize)
+            {
+              vecTasks << task;
+              continue;
+            }
+          Node* pNode = vecNodes.data() + task.node;
+          const int iHalf = splitNode(pNode, vecIndices.data() + task.first, task.count);
+          pNode->index = task.node + 1 + nodeCount(iHalf);
+          lstQueue << BuildTask(task.node + 1, task.first, iHalf)
+                   << BuildTask(pNode->index, task.first + iHalf, task.count - iHalf);
+          PII_TRY_CONTINUE(controller, NAN);
+        }
+      for (int i=0; i<lstQueue.size(); ++i)
+        vecTasks << lstQueue[i];
+      Pii::parallelFor(vecTasks.size(), iThreadCount,
+                       BuildFunction(this, vecNodes.data(), vecIndices.data(), vecTasks.constData()));
+      PII_TRY_CONTINUE(controller, NAN);
+    }
+
+  // Copy the models to leaf buckets.
+  QVector<T> vecPoints(iSampleCount * d->iFeatureCount);
+  Pii::parallelFor(iSampleCount, iThreadCount,
+                   CopyFunction(modelSet, vecIndices.constData(), d->iFeatureCount, vecPoints.data()));
+
+  d->vecNodes = vecNodes;
+  d->vecPoints = vecPoints;
+  d->vecIndices = vecIndices;
+}
+
+template <class SampleSet> int PiiKdTree<SampleSet>::nodeCount(int sampleCount) const
+{
+  if (sampleCount <= d->iBucketSize)
+    return 1;
+  const int iHalf = sampleCount / 2;
+  return 1 + nodeCount(iHalf) + nodeCount(sampleCount - iHalf);
 }
 
 template <class SampleSet>
-int PiiKdTree<SampleSet>::selectDimension(FeatureSorter* sorterArray,
-                                          int sampleCount,
-                                          int /*depth*/)
+int PiiKdTree<SampleSet>::buildNodes(Node* nodes, int node, int* indices, int first, int count,
+                                     PiiProgressController* controller) const
 {
-  Pii::fillN(d->pMeans, d->iFeatureCount, 0.0);
-  Pii::fillN(d->pVars, d->iFeatureCount, 0.0);
-  // Calculate mean for each dimension.
-  for (int i=0; i<sampleCount; ++i)
-    Pii::mapN(d->pMeans, d->iFeatureCount, sampleAt(sorterArray[i].second), std::plus<double>());
-  Pii::mapN(d->pMeans, d->iFeatureCount, std::bind2nd(std::multiplies<double>(), 1.0/sampleCount));
-
-  // Sum of squared differences to mean = variance
-  for (int i=0; i<sampleCount; ++i)
+  Node* pNode = nodes + node;
+  if (count <= d->iBucketSize)
     {
-      Sample sample = sampleAt(sorterArray[i].second);
-      for (int j=0; j<d->iFeatureCount; ++j)
-        d->pVars[j] += Pii::square(sample[j] - d->pMeans[j]);
+      pNode->splitDimension = -1;
+      pNode->index = first;
+      pNode->count = count;
+      pNode->splitValue = 0;
+      return node + 1;
     }
-  Pii::mapN(d->pVars, d->iFeatureCount, std::bind2nd(std::multiplies<double>(), 1.0/sampleCount));
 
-  // Return the index of the dimension with max variance.
-  return Pii::findSpecialValue(d->pVars, d->pVars + d->iFeatureCount,
-                               std::greater<T>(),
-                               Pii::Identity<T>()) - d->pVars;
+  const int iHalf = splitNode(pNode, indices + first, count);
+  PII_TRY_CONTINUE(controller, NAN);
+  pNode->index = buildNodes(nodes, node + 1, indices, first, iHalf, controller);
+  return buildNodes(nodes, pNode->index, indices, first + iHalf, count - iHalf, controller);
 }
 
 template <class SampleSet>
-typename PiiKdTree<SampleSet>::Node* PiiKdTree<SampleSet>::createNode(FeatureSorter* sorterArray,
-                                                                      int sampleCount,
-                                                                      int depth,
-                                                                      PiiProgressController* controller)
+int PiiKdTree<SampleSet>::splitNode(Node* node, int* indices, int sampleCount) const
 {
-  if (sampleCount == 0)
-    return 0;
-  else if (sampleCount == 1)
-    return new Node(sorterArray[0].second);
-
-  // Select the dimension that best splits the remaining samples.
-  int iSplitDimension = selectDimension(sorterArray, sampleCount, depth);
-
-  // Collect the features on the selected dimension.
-  for (int i=0; i<sampleCount; ++i)
-    sorterArray[i].first = sampleAt(sorterArray[i].second)[iSplitDimension];
+  const int iFeatureCount = d->iFeatureCount;
+  const SampleSet& modelSet = d->modelSet;
+  // Select the dimension with the largest variance. A subset of
+  // evenly spaced samples is enough for a good estimate.
+  const int iStep = qMax(1, sampleCount / SplitSampleCount);
+  int iSamples = 0;
+  QVarLengthArray<double,64> vecMeans(iFeatureCount), vecVars(iFeatureCount);
+  Pii::fillN(vecMeans.data(), iFeatureCount, 0.0);
+  Pii::fillN(vecVars.data(), iFeatureCount, 0.0);
+  for (int i=0; i<sampleCount; i += iStep, ++iSamples)
+    Pii::mapN(vecMeans.data(), iFeatureCount, PiiSampleSet::sampleAt(modelSet, indices[i]), std::plus<double>());
+  Pii::mapN(vecMeans.data(), iFeatureCount, std::bind2nd(std::multiplies<double>(), 1.0/iSamples));
+
+  for (int i=0; i<sampleCount; i += iStep)
+    {
+      Sample sample = PiiSampleSet::sampleAt(modelSet, indices[i]);
+      for (int j=0; j<iFeatureCount; ++j)
+        vecVars[j] += Pii::square(sample[j] - vecMeans[j]);
+    }
 
-  // Partial sort. Median is now at the center of the array.
-  Pii::fastMedian(sorterArray, sampleCount);
+  const int iSplitDimension = Pii::findSpecialValue(vecVars.constData(), vecVars.constData() + iFeatureCount,
+                                                    std::greater<double>(),
+                                                    Pii::Identity<double>()) - vecVars.constData();
 
-  int iHalf = (sampleCount-1) / 2;
+  // Partial sort. The smaller half comes first and the median at
+  // the beginning of the larger half.
+  const int iHalf = sampleCount / 2;
+  std::nth_element(indices, indices + iHalf, indices + sampleCount,
+                   FeatureLess(modelSet, iSplitDimension));
 
-  ++depth;
+  node->splitDimension = iSplitDimension;
+  node->count = 0;
+  node->splitValue = PiiSampleSet::sampleAt(modelSet, indices[iHalf])[iSplitDimension];
+  return iHalf;
+}
 
-  // Exception safety
-  PiiSmartPtr<Node> smaller(createNode(sorterArray, iHalf, depth, controller));
-  PiiSmartPtr<Node> larger(createNode(sorterArray + iHalf + 1, sampleCount - iHalf - 1, depth, controller));
+template <class SampleSet> PiiClassification::MatchList PiiKdTree<SampleSet>::createMatchList(int n) const
+{
+  PiiClassification::MatchList heap;
+  if (!d->vecNodes.isEmpty() && n > 0)
+    heap.fill(qMin(d->vecIndices.size(), n), qMakePair(double(INFINITY), -1));
+  return heap;
+}
 
-  PII_TRY_CONTINUE(controller, NAN);
+template <class SampleSet> template <class MatchList>
+void PiiKdTree<SampleSet>::search(Sample sample,
+                                  int maxEvaluations,
+                                  MatchList& matches) const
+{
+  if (maxEvaluations > 0)
+    findClosestMatches(sample, maxEvaluations, matches);
+  else
+    findClosestMatches(0, sample, matches);
+}
 
-  int iSampleIndex = sorterArray[iHalf].second;
-  return new Node(iSampleIndex,
-                  iSplitDimension,
-                  sampleAt(iSampleIndex)[iSplitDimension],
-                  smaller.release(),
-                  larger.release());
+template <class SampleSet> template <class MatchList>
+void PiiKdTree<SampleSet>::searchBucket(const Node& leaf,
+                                        Sample sample,
+                                        MatchList& matches) const
+{
+  const int iFeatureCount = d->iFeatureCount;
+  const T* pPoint = d->vecPoints.constData() + qint64(leaf.index) * iFeatureCount;
+  const int* pIndices = d->vecIndices.constData() + leaf.index;
+  for (int i=0; i<leaf.count; ++i, pPoint += iFeatureCount)
+    {
+      const double dLimit = distanceLimit(matches);
+      double dDistance = Kernel::boundedDistance(d->measure, sample, pPoint, iFeatureCount, dLimit);
+      // A partial sum that reaches the limit may not be the full
+      // distance, which is needed to break ties.
+      if (dDistance == dLimit)
+        dDistance = Kernel::distance(d->measure, sample, pPoint, iFeatureCount);
+      if (dDistance <= dLimit)
+        updateLimit(dDistance, pIndices[i], matches);
+    }
 }
 
 template <class SampleSet>
@@ -145,8 +331,8 @@ int PiiKdTree<SampleSet>::findClosestMatch(Sample sample,
                                            double* distance) const
 {
   QPair<double,int> minimum(INFINITY, -1);
-  if (d->pRoot != 0)
-    findClosestMatches(d->pRoot, sample, minimum);
+  if (!d->vecNodes.isEmpty())
+    findClosestMatches(0, sample, minimum);
   if (distance != 0)
     *distance = minimum.first;
   return minimum.second;
@@ -156,56 +342,42 @@ template <class SampleSet>
 PiiClassification::MatchList PiiKdTree<SampleSet>::findClosestMatches(Sample sample,
                                                                       int n) const
 {
-  PiiClassification::MatchList heap;
-
-  if (d->pRoot == 0)
+  PiiClassification::MatchList heap(createMatchList(n));
+  if (heap.size() == 0)
     return heap;
 
-  heap.fill(qMin(sampleCount(), n), qMakePair(double(INFINITY), -1));
-
-  findClosestMatches(d->pRoot, sample, heap);
+  findClosestMatches(0, sample, heap);
   // Ascending order -> first is the best match
   heap.sort();
   return heap;
 }
 
 template <class SampleSet> template <class MatchList>
-void PiiKdTree<SampleSet>::findClosestMatches(Node* node,
+void PiiKdTree<SampleSet>::findClosestMatches(int node,
                                               Sample sample,
                                               MatchList& matchList) const
 {
-  if (node == 0)
-    return;
-
-  // Measure distance to the sample at this node.
-  double dDistance = d->measure(sample, sampleAt(node->sampleIndex), d->iFeatureCount);
-  /* Update minimum distance if needed. In k-NN search, a priority
-     queue of k best matches are maintained. The first element in the
-     queue is the current estimate of the kth closest match.
-   */
-  if (dDistance < distanceLimit(matchList))
-    updateLimit(dDistance, node->sampleIndex, matchList);
-
-  // Recursive descend
-  T featureValue = sample[node->splitDimension];
-  // Decide search order based on the selected feature value.
-  if (featureValue <= node->featureValue)
-    {
-      this->findClosestMatches(node->smaller, sample, matchList);
-      /* If the closest child could be on the other side of this
-         splitting hyperplane, we need to search the other side too.
-         In the case of a k-NN search take the kth closest node
-         instead of the closest one.
-      */
-      if (Pii::square(node->featureValue - featureValue) <= distanceLimit(matchList))
-        findClosestMatches(node->larger, sample, matchList);
-    }
-  else
+  const Node& current = d->vecNodes.constData()[node];
+  if (current.splitDimension < 0)
     {
-      findClosestMatches(node->larger, sample, matchList);
-      if (Pii::square(node->featureValue - featureValue) <= distanceLimit(matchList))
-        findClosestMatches(node->smaller, sample, matchList);
+      searchBucket(current, sample, matchList);
+      return;
     }
+
+  // Descend first to the side the sample is on.
+  const double dDiff = double(sample[current.splitDimension]) - double(current.splitValue);
+  int iNear = node + 1, iFar = current.index;
+  if (dDiff >= 0)
+    qSwap(iNear, iFar);
+
+  findClosestMatches(iNear, sample, matchList);
+  /* If the closest match could be on the other side of this
+     splitting hyperplane, we need to search the other side too. In
+     the case of a k-NN search take the kth closest match instead of
+     the closest one.
+  */
+  if (dDiff * dDiff <= distanceLimit(matchList))
+    findClosestMatches(iFar, sample, matchList);
 }
 
 template <class SampleSet>
@@ -213,12 +385,9 @@ int PiiKdTree<SampleSet>::findClosestMatch(Sample sample,
                                            int maxEvaluations,
                                            double* distance) const
 {
-  if (d->pRoot == 0)
-    return -1;
-
   QPair<double,int> pair(INFINITY, -1);
-
-  findClosestMatches(sample, maxEvaluations, pair);
+  if (!d->vecNodes.isEmpty())
+    findClosestMatches(sample, maxEvaluations, pair);
 
   if (distance != 0)
     *distance = pair.first;
@@ -230,12 +399,10 @@ PiiClassification::MatchList PiiKdTree<SampleSet>::findClosestMatches(Sample sam
                                                                       int n,
                                                                       int maxEvaluations) const
 {
-  PiiClassification::MatchList heap;
-  if (d->pRoot == 0)
+  PiiClassification::MatchList heap(createMatchList(n));
+  if (heap.size() == 0)
     return heap;
 
-  heap.fill(qMin(sampleCount(), n), qMakePair(double(INFINITY), -1));
-
   findClosestMatches(sample, maxEvaluations, heap);
 
   heap.sort();
@@ -247,79 +414,104 @@ void PiiKdTree<SampleSet>::findClosestMatches(Sample sample,
                                               int maxEvaluations,
                                               MatchList& matches) const
 {
-  Node* pNode = d->pRoot;
-
-  BranchList lstBranches;
-
-  for (;;)
+  /* Best bin first search. Branches not taken on the way down are
+     stored in a priority queue together with a lower bound of their
+     distance to the sample. The closest one is inspected next,
+     until the queue is exhausted or no more evaluations are
+     allowed.
+  */
+  PiiHeap<QPair<double,int>,32> heapBranches(0, Pii::InverseHeap);
+  const Node* pNodes = d->vecNodes.constData();
+  int iNode = 0;
+  double dBound = 0;
+  while (maxEvaluations > 0)
     {
-      // Search recursively to a leaf node. In backtracking,
-      // lstBranches will be filled with nodes that need to be
-      // evaluated to be sure about the NN.
-      findPossibleBranches(pNode, sample, &maxEvaluations, lstBranches, matches);
-      // No more choices found -> found the exact NN
-      // No more evaluations allowed -> don't know the NN for sure,
-      // but who cares?
-      if (lstBranches.isEmpty() || maxEvaluations <= 0)
+      while (pNodes[iNode].splitDimension >= 0)
+        {
+          const Node& current = pNodes[iNode];
+          const double dDiff = double(sample[current.splitDimension]) - double(current.splitValue);
+          int iNear = iNode + 1, iFar = current.index;
+          if (dDiff >= 0)
+            qSwap(iNear, iFar);
+          const double dFarBound = qMax(dBound, dDiff * dDiff);
+          if (dFarBound <= distanceLimit(matches))
+            heapBranches.append(qMakePair(dFarBound, iFar));
+          iNode = iNear;
+        }
+      searchBucket(pNodes[iNode], sample, matches);
+      maxEvaluations -= pNodes[iNode].count;
+
+      // No more choices -> found the exact NN.
+      if (heapBranches.size() == 0)
         break;
-      // Otherwise find the closest node and continue search from there.
-      typename BranchList::iterator i = Pii::findSpecialValue(lstBranches.begin(),
-                                                              lstBranches.end(),
-                                                              std::less<BranchSorter>(),
-                                                              Pii::Identity<BranchSorter>());
-      lstBranches.erase(i);
-      pNode = i->second;
+      QPair<double,int> closest = heapBranches.take(0);
+      // All remaining branches are farther than the current limit.
+      if (closest.first > distanceLimit(matches))
+        break;
+      dBound = closest.first;
+      iNode = closest.second;
     }
 }
 
-
-template <class SampleSet> template <class MatchList>
-void PiiKdTree<SampleSet>::findPossibleBranches(Node* node,
-                                                Sample sample,
-                                                int *maxEvaluations,
-                                                BranchList& branchList,
-                                                MatchList& matches) const
+template <class SampleSet>
+QVector<int> PiiKdTree<SampleSet>::findClosestMatchBatch(const SampleSet& samples,
+                                                         QVector<double>* distances,
+                                                         int maxEvaluations) const
 {
-  if (node == 0 || *maxEvaluations <= 0)
-    return;
+  const QVector<Sample> vecSamples(PiiClassification::sampleIterators(samples));
+  const int iSamples = vecSamples.size();
+  QVector<QPair<double,int> > vecClosest(iSamples, qMakePair(double(INFINITY), -1));
+  if (!d->vecNodes.isEmpty())
+    Pii::parallelFor(iSamples, qMin(Pii::parallelThreadCount(0), iSamples / ParallelQueryLimit + 1),
+                     QueryFunction(this, vecSamples.constData(), maxEvaluations, vecClosest.data(), 0));
+
+  QVector<int> vecIndices(iSamples);
+  if (distances != 0)
+    distances->resize(iSamples);
+  for (int i=0; i<iSamples; ++i)
+    {
+      vecIndices[i] = vecClosest[i].second;
+      if (distances != 0)
+        (*distances)[i] = vecClosest[i].first;
+    }
+  return vecIndices;
+}
 
-  /* This function is equivalent to the normal recursive tree look-up,
-     but instead of inspecting each possible branch when unwinding the
-     stack, all possible branches are collected into a priority queue
-     and inspected in the order of increasing distance from the query
-     sample.
-   */
-  --*maxEvaluations;
-
-  double dDistance = d->measure(sample, sampleAt(node->sampleIndex), d->iFeatureCount);
-
-  if (dDistance < distanceLimit(matches))
-    updateLimit(dDistance, node->sampleIndex, matches);
-  /* Prune branches that are no longer possible.
-     for (typename BranchList::iterator i=branchList.begin(); i != branchList.end(); )
-     {
-     T diff = sample[i->second->splitDimension] - i->second->featureValue;
-     double dSqDiff = Pii::square(diff);
-     if (Pii::square(diff) > distanceLimit(matches))
-     i = branchList.erase(i);
-     else
-     ++i;
-     }
-  */
+template <class SampleSet>
+QList<PiiClassification::MatchList> PiiKdTree<SampleSet>::findClosestMatchesBatch(const SampleSet& samples,
+                                                                                  int n,
+                                                                                  int maxEvaluations) const
+{
+  const QVector<Sample> vecSamples(PiiClassification::sampleIterators(samples));
+  const int iSamples = vecSamples.size();
+  QVector<PiiClassification::MatchList> vecMatches(iSamples, createMatchList(n));
+  if (!vecMatches.isEmpty() && vecMatches[0].size() != 0)
+    Pii::parallelFor(iSamples, qMin(Pii::parallelThreadCount(0), iSamples / ParallelQueryLimit + 1),
+                     QueryFunction(this, vecSamples.constData(), maxEvaluations, 0, vecMatches.data()));
+
+  QList<PiiClassification::MatchList> lstMatches;
+  for (int i=0; i<iSamples; ++i)
+    lstMatches << vecMatches[i];
+  return lstMatches;
+}
 
-  T featureValue = sample[node->splitDimension];
-  if (featureValue <= node->featureValue)
+template <class SampleSet> template <class Stream>
+void PiiKdTree<SampleSet>::print(Stream& stream, int node, int level) const
+{
+  const Node& current = d->vecNodes[node];
+  for (int i=level; i--; )
+    stream << "  ";
+  if (current.splitDimension < 0)
     {
-      findPossibleBranches(node->smaller, sample, maxEvaluations, branchList, matches);
-      // The NN could be on the other branch -> store to possible
-      // branches and let the caller to evaluate it if needed.
-      if (node->larger != 0 && Pii::square(node->featureValue - featureValue) <= distanceLimit(matches))
-        branchList.append(BranchSorter(dDistance, node->larger));
+      stream << "models";
+      for (int i=0; i<current.count; ++i)
+        stream << " " << d->vecIndices[current.index + i];
+      stream << "\n";
     }
   else
     {
-      findPossibleBranches(node->larger, sample, maxEvaluations, branchList, matches);
-      if (node->smaller != 0 && Pii::square(node->featureValue - featureValue) <= distanceLimit(matches))
-        branchList.append(BranchSorter(dDistance, node->smaller));
+      stream << "[" << current.splitDimension << "] < " << current.splitValue << "\n";
+      print(stream, node + 1, level + 1);
+      print(stream, current.index, level + 1);
     }
 }
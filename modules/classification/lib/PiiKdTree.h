@@ -16,22 +16,24 @@
 #ifndef _PIIKDTREE_H
 #define _PIIKDTREE_H
 
-#include <QLinkedList>
 #include <QPair>
+#include <QVector>
+#include <QList>
+#include <PiiParallel.h>
 #include <PiiProgressController.h>
 #include "PiiSampleSet.h"
 #include "PiiClassification.h"
 #include "PiiSquaredGeometricDistance.h"
+#include "PiiNearestNeighborIndex.h"
 #include <PiiSerialization.h>
 #include <PiiNameValuePair.h>
 #include <PiiSharedD.h>
 
 /**
  * K-dimensional tree. The kd-tree is a binary tree in which every
- * node is a k-dimensional point. Each non-leaf node in the tree
- * splits the k-dimensional hyperspace with a hyperplane that is
- * aligned to one of the axes and passes through the point in the
- * node.
+ * internal node splits the k-dimensional hyperspace with a hyperplane
+ * that is aligned to one of the axes. The model samples are stored in
+ * the leaves of the tree.
  *
  * The kd-tree can be used to quickly look up nearest neighbors in
  * large databases. For randomly distributed data, the complexity of
@@ -42,15 +44,27 @@
  * if and only if \(N >> 2^k\), where N is the number of samples and
  * k is the feature space dimensionality.
  *
+ * The tree is stored in flat arrays instead of separately allocated
+ * nodes. Each leaf holds a *bucket* of up to [bucketSize()] model
+ * samples whose features have been copied next to each other in
+ * memory. A look-up descends to a leaf and compares the sample to
+ * all models in the bucket at once, which is much faster than
+ * jumping between nodes scattered around the heap. Large trees are
+ * built in parallel.
+ *
  * PiiKdTree includes a variant of the basic NN look-up algorithm
  * that performs approximate NN search. (k-NN search is also
  * supported.) Instead of recursively checking all possible branches
  * of the tree the approximate algorithm orders the look-ups so that
  * the most likely ones come first. The algorithm stops when the exact
  * nearest neighbor has been found or a predefined maximum number of
- * look-ups have been performed. This makes it possible to set a hard
- * upper bound for the search time while still returning the nearest
- * neighbor(s) with a high probability.
+ * model samples have been compared. This makes it possible to set a
+ * hard upper bound for the search time while still returning the
+ * nearest neighbor(s) with a high probability.
+ *
+ * If many samples need to be looked up at once, use
+ * [findClosestMatchBatch()] or [findClosestMatchesBatch()], which
+ * process the samples in parallel.
  *
  * PiiKdTree only works with geometric distances. Thus, there is no
  * option to use user-defined distance measures. If you need a special
@@ -58,15 +72,18 @@
  * option.
  *
  */
-template <class SampleSet> class PiiKdTree
+template <class SampleSet> class PiiKdTree : public PiiNearestNeighborIndex<SampleSet>
 {
   friend struct PiiSerialization::Accessor;
-  template <class Archive> void serialize(Archive& archive, const unsigned int)
+  PII_SEPARATE_SAVE_LOAD_MEMBERS
+  template <class Archive> void save(Archive& archive, const unsigned int)
   {
-    archive & PII_NVP("root", d->pRoot);
-    archive & PII_NVP("features", d->iFeatureCount);
-    archive & PII_NVP("models", d->modelSet);
+    // The tree is rebuilt from the models when loaded.
+    archive << PII_NVP("features", d->iFeatureCount);
+    archive << PII_NVP("bucketSize", d->iBucketSize);
+    archive << PII_NVP("models", d->modelSet);
   }
+  template <class Archive> void load(Archive& archive, const unsigned int version);
 
 public:
   typedef typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator Sample;
@@ -94,9 +111,23 @@ public:
    */
   PiiKdTree& operator= (const PiiKdTree& other);
 
+  /**
+   * Sets the maximum number of model samples stored in a leaf node.
+   * Large buckets make the tree shallower and let the distances be
+   * calculated in longer runs, but more models need to be compared
+   * in each leaf. The change takes effect when the tree is rebuilt.
+   * The default is 8.
+   */
+  void setBucketSize(int bucketSize);
+  /**
+   * Returns the maximum number of model samples in a leaf node.
+   */
+  int bucketSize() const { return d->iBucketSize; }
+
   /**
    * Deletes the old kd-tree (if any) and rebuilds a new one based on
-   * the given model samples.
+   * the given model samples. If the model set is large, the tree is
+   * built using all available processor cores.
    *
    * @param modelSet model samples
    *
@@ -108,6 +139,18 @@ public:
    */
   void buildTree(const SampleSet& modelSet, PiiProgressController* controller = 0);
 
+  /**
+   * Same as [buildTree()].
+   */
+  void buildIndex(const SampleSet& modelSet, PiiProgressController* controller = 0)
+  {
+    buildTree(modelSet, controller);
+  }
+
+  int modelCount() const { return d->vecIndices.size(); }
+
+  PiiKdTree* clone() const { return new PiiKdTree(*this); }
+
   /**
    * Returns the index of the nearest neighbor in the model set.
    *
@@ -118,7 +161,8 @@ public:
    * *sample*.
    *
    * @return the index of the closest sample in the model set, or -1
-   * if the set is empty.
+   * if the set is empty. If many models are equally close, the one
+   * with the smallest index will be returned.
    */
   int findClosestMatch(Sample sample,
                        double* distance = 0) const;
@@ -132,10 +176,12 @@ public:
    *
    * @param sample input feature vector
    *
-   * @param maxEvaluations the maximum number of node look-ups to be
-   * done. If you set this value to `log`(N), the algorithm will do a
-   * simple best first search to the first leaf node. Usually, it is a
-   * good idea to give the algorithm a bit more time to find a good
+   * @param maxEvaluations the maximum number of model samples to
+   * compare *sample* to. Leaf buckets are always inspected as a
+   * whole, so the limit may be exceeded by at most [bucketSize()] -
+   * 1. If you set this value to [bucketSize()], the algorithm will do
+   * a simple best first search to the first leaf node. Usually, it is
+   * a good idea to give the algorithm a bit more time to find a good
    * match. If you set this value to the size of the model set, the
    * exact nearest neighbor will be returned.
    *
@@ -164,16 +210,17 @@ public:
 
   /**
    * Returns *n* matches that are probably the closest of *sample*.
-   * This function stops after *maxEvaluations* most probable nodes
-   * have been checked and may not return the exact nearest neighbors.
+   * This function stops after the most probable leaves containing
+   * about *maxEvaluations* model samples have been checked and may
+   * not return the exact nearest neighbors.
    *
    * @param sample input feature vector
    *
    * @param n the number of closest matches to return.
    *
-   * @param maxEvaluations the maximum number of node look-ups to be
-   * done. A suitable value is about *n* * `log`(N), where N is the
-   * number of samples in the model set.
+   * @param maxEvaluations the maximum number of model samples to
+   * compare *sample* to. A suitable value is about *n* * `log`(N),
+   * where N is the number of samples in the model set.
    *
    * @return the *n* closest matches. Note that if either the model
    * data set or *maxEvaluations* is smaller than *n*, less than
@@ -182,6 +229,66 @@ public:
   PiiClassification::MatchList findClosestMatches(Sample sample,
                                                   int n,
                                                   int maxEvaluations) const;
+
+  /**
+   * Finds the nearest neighbor for each sample in *samples*. The
+   * samples are divided among all available processor cores.
+   *
+   * @param samples input feature vectors
+   *
+   * @param distances an optional output-value argument that will
+   * store the *squared* geometric distance to the closest neighbor of
+   * each sample.
+   *
+   * @param maxEvaluations the maximum number of model samples to
+   * compare each sample to. If this value is zero or negative, exact
+   * search will be performed. Otherwise, this function is equivalent
+   * to calling findClosestMatch(Sample, int, double*) for each sample.
+   *
+   * @return the index of the closest model for each sample, or -1 for
+   * all samples if the model set is empty.
+   */
+  QVector<int> findClosestMatchBatch(const SampleSet& samples,
+                                     QVector<double>* distances = 0,
+                                     int maxEvaluations = 0) const;
+
+  /**
+   * Finds the *n* closest matches for each sample in *samples*. The
+   * samples are divided among all available processor cores.
+   *
+   * @param samples input feature vectors
+   *
+   * @param n the number of closest matches to return for each sample.
+   *
+   * @param maxEvaluations the maximum number of model samples to
+   * compare each sample to. If this value is zero or negative, exact
+   * search will be performed.
+   *
+   * @return a list of matches for each sample. See
+   * findClosestMatches(Sample, int, int).
+   *
+   * ~~~(c++)
+   * PiiKdTree<PiiMatrix<float> > tree(matModels);
+   * QList<PiiClassification::MatchList> lstMatches =
+   *   tree.findClosestMatchesBatch(matQueries, 2, 200);
+   * for (int i=0; i<lstMatches.size(); ++i)
+   *   qDebug("Closest model to sample %d is %d", i, lstMatches[i][0].second);
+   * ~~~
+   */
+  QList<PiiClassification::MatchList> findClosestMatchesBatch(const SampleSet& samples,
+                                                              int n,
+                                                              int maxEvaluations) const;
+
+  /**
+   * Finds the exact *n* closest matches for each sample in *samples*.
+   * Same as findClosestMatchesBatch(samples, n, 0).
+   */
+  QList<PiiClassification::MatchList> findClosestMatchesBatch(const SampleSet& samples,
+                                                              int n) const
+  {
+    return findClosestMatchesBatch(samples, n, 0);
+  }
+
   /**
    * Returns the model sample set that was used to construct the
    * kd-tree.
@@ -192,12 +299,47 @@ public:
    * Prints the structure of the k-d tree to *stream*. This function
    * is mainly for informational and debugging purposes.
    */
-  template <class Stream> void print(Stream& stream) { d->pRoot->print(stream); }
+  template <class Stream> void print(Stream& stream) const
+  {
+    if (!d->vecNodes.isEmpty())
+      print(stream, 0, 0);
+  }
 
 private:
   typedef typename PiiSampleSet::Traits<SampleSet>::FeatureType T;
+  typedef PiiSquaredGeometricDistance<Sample> Measure;
+  typedef PiiDistanceKernel<Measure> Kernel;
+
+  enum
+  {
+    DefaultBucketSize = 8,
+    // At most this many samples are used in selecting the split
+    // dimension.
+    SplitSampleCount = 128,
+    // Trees with less samples are built in a single thread.
+    ParallelBuildLimit = 8192,
+    // Each thread gets at least this many queries in batch look-ups.
+    ParallelQueryLimit = 32
+  };
 
+  /* Nodes are stored in depth-first order. The smaller child of an
+     internal node always follows its parent immediately. */
   struct Node
+  {
+    // The split dimension, or -1 if this is a leaf.
+    int splitDimension;
+    // Internal node: the index of the larger child. Leaf: the index
+    // of the first model sample in the bucket.
+    int index;
+    // Leaf: the number of model samples in the bucket.
+    int count;
+    // Internal node: samples whose feature on the split dimension is
+    // smaller than this go to the smaller child.
+    T splitValue;
+  };
+
+  // The format of serialized trees up to version 0.
+  struct LegacyNode
   {
     template <class Archive> void serialize(Archive& archive, const unsigned int)
     {
@@ -208,19 +350,8 @@ private:
       archive & PII_NVP("larger", larger);
     }
 
-    Node(int index=0, int dim = 0, T value = 0, Node* s = 0, Node* l = 0) :
-      sampleIndex(index), splitDimension(dim), featureValue(value), smaller(s), larger(l)
-    {}
-
-    Node(const Node& other) :
-      sampleIndex(other.sampleIndex),
-      splitDimension(other.splitDimension),
-      featureValue(other.featureValue),
-      smaller(other.smaller != 0 ? new Node(*other.smaller) : 0),
-      larger(other.larger != 0 ? new Node(*other.larger) : 0)
-    {}
-
-    ~Node()
+    LegacyNode() : sampleIndex(0), splitDimension(0), featureValue(0), smaller(0), larger(0) {}
+    ~LegacyNode()
     {
       delete larger;
       delete smaller;
@@ -228,57 +359,67 @@ private:
 
     int sampleIndex, splitDimension;
     T featureValue;
-    Node* smaller;
-    Node* larger;
+    LegacyNode* smaller;
+    LegacyNode* larger;
+  };
+
+  // A subtree that has not been built yet.
+  struct BuildTask
+  {
+    BuildTask(int n = 0, int f = 0, int c = 0) : node(n), first(f), count(c) {}
+    int node, first, count;
+  };
 
-    template <class Stream> void print(Stream& stream, int level = 0) const
+  // Orders model indices by the value of a feature.
+  struct FeatureLess
+  {
+    FeatureLess(const SampleSet& modelSet, int dimension) : pModelSet(&modelSet), iDimension(dimension) {}
+    bool operator() (int a, int b) const
     {
-      for (int i=level; i--; )
-        stream << "  ";
-      stream << "model[" << sampleIndex << "][" << splitDimension << "] = " << featureValue << "\n";
-      if (smaller)
-        smaller->print(stream, level+1);
-      if (larger)
-        larger->print(stream, level+1);
+      return PiiSampleSet::sampleAt(*pModelSet, a)[iDimension] < PiiSampleSet::sampleAt(*pModelSet, b)[iDimension];
     }
+    const SampleSet* pModelSet;
+    int iDimension;
   };
 
-  // Stores feature value and the index of the sample it belongs to.
-  typedef QPair<T,int> FeatureSorter;
-  // Stores a pointer to a node and the distance to it.
-  typedef QPair<double,Node*> BranchSorter;
-  typedef QLinkedList<BranchSorter> BranchList;
+  class BuildFunction;
+  class CopyFunction;
+  class QueryFunction;
 
   class Data : public PiiSharedD<Data>
   {
   public:
-    Data() : pRoot(0), iFeatureCount(0), pMeans(0), pVars(0) {}
+    Data(int bucketSize = DefaultBucketSize) : iFeatureCount(0), iBucketSize(bucketSize) {}
     Data(const Data& other) :
-      pRoot(new Node(*other.pRoot)),
+      PiiSharedD<Data>(),
+      vecNodes(other.vecNodes),
+      vecPoints(other.vecPoints),
+      vecIndices(other.vecIndices),
       iFeatureCount(other.iFeatureCount),
-      pMeans(0), pVars(0),
+      iBucketSize(other.iBucketSize),
       modelSet(other.modelSet)
     {}
 
-    Node* pRoot;
-    int iFeatureCount;
-    double* pMeans, *pVars;
+    QVector<Node> vecNodes;
+    // Copies of the model samples in the order they appear in the
+    // leaf buckets.
+    QVector<T> vecPoints;
+    // The index of each sample in vecPoints in the model set.
+    QVector<int> vecIndices;
+    int iFeatureCount, iBucketSize;
     SampleSet modelSet;
-    PiiSquaredGeometricDistance<Sample> measure;
+    Measure measure;
   } *d;
 
   // Tree construction
-  Node* createNode(FeatureSorter* sorterArray,
-                   int sampleCount,
-                   int depth,
-                   PiiProgressController* controller);
-  int selectDimension(FeatureSorter* sorterArray,
-                      int sampleCount,
-                      int depth);
+  int nodeCount(int sampleCount) const;
+  int splitNode(Node* node, int* indices, int sampleCount) const;
+  int buildNodes(Node* nodes, int node, int* indices, int first, int count,
+                 PiiProgressController* controller) const;
 
   // Exact (k-)NN search
   template <class MatchList>
-  void findClosestMatches(Node* node,
+  void findClosestMatches(int node,
                           Sample sample,
                           MatchList& matches) const;
   // Approximate (k-)NN search
@@ -286,18 +427,29 @@ private:
   void findClosestMatches(Sample sample,
                           int maxEvaluations,
                           MatchList& matches) const;
+  // Exact search if maxEvaluations <= 0, approximate otherwise.
   template <class MatchList>
-  void findPossibleBranches(Node* node,
-                            Sample sample,
-                            int* maxEvaluations,
-                            BranchList& branchList,
-                            MatchList& matches) const;
+  void search(Sample sample,
+              int maxEvaluations,
+              MatchList& matches) const;
+  template <class MatchList>
+  void searchBucket(const Node& leaf,
+                    Sample sample,
+                    MatchList& matches) const;
+
+  template <class Stream> void print(Stream& stream, int node, int level) const;
 
-  // Match list helper functions. In NN search "list" is actually a pair.
+  PiiClassification::MatchList createMatchList(int n) const;
+
+  // Match list helper functions. In NN search "list" is actually a
+  // pair. Equally distant models are ordered by their index.
   static inline void updateLimit(double distance, int index, QPair<double,int>& pair)
   {
-    pair.first = distance;
-    pair.second = index;
+    if (distance < pair.first || (distance == pair.first && index < pair.second))
+      {
+        pair.first = distance;
+        pair.second = index;
+      }
   }
   static inline void updateLimit(double distance, int index, PiiClassification::MatchList& matches)
   {
@@ -306,11 +458,10 @@ private:
 
   static inline double distanceLimit(const QPair<double,int>& pair) { return pair.first; }
   static inline double distanceLimit(const PiiClassification::MatchList& matches) { return matches[0].first; }
-
-  inline int sampleCount() const { return PiiSampleSet::sampleCount(d->modelSet); }
-  inline Sample sampleAt(int index) const { return PiiSampleSet::sampleAt(const_cast<const SampleSet&>(d->modelSet), index); }
 };
 
+PII_SERIALIZATION_VERSION_TEMPLATE(PiiKdTree, 1);
+
 #include "PiiKdTree-templates.h"
 
 #endif //_PIIKDTREE_H
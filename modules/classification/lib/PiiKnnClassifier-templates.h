@@ -20,12 +20,16 @@
 #include <QtAlgorithms>
 
 template <class SampleSet> PiiKnnClassifier<SampleSet>::Data::Data() :
-  k(5)
+  k(5),
+  pIndex(0),
+  iIndexGeneration(-1)
 {}
 
 template <class SampleSet> PiiKnnClassifier<SampleSet>::Data::Data(PiiDistanceMeasure<SampleSet>* measure) :
   PiiVectorQuantizer<SampleSet>::Data(measure),
-  k(5)
+  k(5),
+  pIndex(0),
+  iIndexGeneration(-1)
 {}
 
 template <class SampleSet> PiiKnnClassifier<SampleSet>::PiiKnnClassifier() :
@@ -37,7 +41,9 @@ template <class SampleSet> PiiKnnClassifier<SampleSet>::PiiKnnClassifier(PiiDist
 {}
 
 template <class SampleSet> PiiKnnClassifier<SampleSet>::~PiiKnnClassifier()
-{}
+{
+  delete _d()->pIndex;
+}
 
 template <class SampleSet> int PiiKnnClassifier<SampleSet>::getK() const { return _d()->k; }
 
@@ -61,6 +67,45 @@ void PiiKnnClassifier<SampleSet>::setClassLabels(const QVector<double>& labels)
   _d()->vecClassLabels = labels;
 }
 
+template <class SampleSet>
+void PiiKnnClassifier<SampleSet>::setIndex(PiiNearestNeighborIndex<SampleSet>* index)
+{
+  PII_D;
+  if (index == d->pIndex)
+    return;
+  delete d->pIndex;
+  d->pIndex = index;
+  d->iIndexGeneration = -1;
+}
+
+template <class SampleSet>
+PiiNearestNeighborIndex<SampleSet>* PiiKnnClassifier<SampleSet>::index() const
+{
+  return _d()->pIndex;
+}
+
+template <class SampleSet>
+void PiiKnnClassifier<SampleSet>::buildIndex(PiiProgressController* controller)
+{
+  PII_D;
+  if (d->pIndex != 0)
+    {
+      d->iIndexGeneration = -1;
+      d->pIndex->buildIndex(d->modelSet, controller);
+      d->iIndexGeneration = d->iModelGeneration;
+    }
+}
+
+template <class SampleSet>
+bool PiiKnnClassifier<SampleSet>::isIndexValid() const
+{
+  const PII_D;
+  return d->pIndex != 0 &&
+    d->iIndexGeneration == d->iModelGeneration &&
+    d->pIndex->modelCount() > 0 &&
+    d->pIndex->modelCount() == this->modelCount();
+}
+
 template <class SampleSet>
 double PiiKnnClassifier<SampleSet>::classify(ConstFeatureIterator featureVector) throw()
 {
@@ -76,8 +121,20 @@ template <class SampleSet> int PiiKnnClassifier<SampleSet>::findClosestMatch(Con
                                                                              double* distance) const throw()
 {
   const PII_D;
-  int iClosestIndex;
-  if (d->k == 1)
+  int iClosestIndex = -1;
+  if (isIndexValid())
+    {
+      const PiiClassification::MatchList lstMatches(d->pIndex->findClosestMatches(featureVector, d->k));
+      if (d->k == 1)
+        {
+          iClosestIndex = lstMatches[0].second;
+          if (distance != 0)
+            *distance = lstMatches[0].first;
+        }
+      else
+        PiiClassification::knnVote(lstMatches, d->vecClassLabels, distance, &iClosestIndex);
+    }
+  else if (d->k == 1)
     iClosestIndex = PiiClassification::findClosestMatch(featureVector,
                                                         d->modelSet,
                                                         *d->pMeasure,
@@ -92,3 +149,61 @@ template <class SampleSet> int PiiKnnClassifier<SampleSet>::findClosestMatch(Con
                                    &iClosestIndex);
   return iClosestIndex;
 }
+
+template <class SampleSet>
+QVector<double> PiiKnnClassifier<SampleSet>::classifyBatch(const SampleSet& samples) throw()
+{
+  PII_D;
+  QVector<double> vecDistances;
+  const QVector<int> vecLabelIndices(findClosestMatchBatch(samples, &vecDistances));
+  QVector<double> vecResults(vecLabelIndices.size());
+  for (int i=0; i<vecLabelIndices.size(); ++i)
+    {
+      const int iLabelIndex = vecLabelIndices[i];
+      vecResults[i] = vecDistances[i] > d->dRejectThreshold || iLabelIndex < 0 || iLabelIndex >= d->vecClassLabels.size() ?
+        NAN : d->vecClassLabels[iLabelIndex];
+    }
+  return vecResults;
+}
+
+template <class SampleSet>
+QVector<int> PiiKnnClassifier<SampleSet>::findClosestMatchBatch(const SampleSet& samples,
+                                                                QVector<double>* distances) const throw()
+{
+  const PII_D;
+  if (isIndexValid())
+    {
+      const QList<PiiClassification::MatchList> lstMatches(d->pIndex->findClosestMatchesBatch(samples, d->k));
+      const int iSamples = lstMatches.size();
+      QVector<int> vecClosestIndices(iSamples, -1);
+      if (distances != 0)
+        distances->fill(INFINITY, iSamples);
+      for (int i=0; i<iSamples; ++i)
+        {
+          if (d->k == 1)
+            {
+              vecClosestIndices[i] = lstMatches[i][0].second;
+              if (distances != 0)
+                (*distances)[i] = lstMatches[i][0].first;
+            }
+          else
+            PiiClassification::knnVote(lstMatches[i], d->vecClassLabels,
+                                       distances != 0 ? &(*distances)[i] : 0,
+                                       &vecClosestIndices[i]);
+        }
+      return vecClosestIndices;
+    }
+
+  if (d->k == 1)
+    return PiiClassification::findClosestMatchBatch(samples, d->modelSet, *d->pMeasure, distances);
+
+  QVector<int> vecClosestIndices;
+  PiiClassification::knnClassifyBatch(samples,
+                                      d->modelSet,
+                                      d->vecClassLabels,
+                                      *d->pMeasure,
+                                      d->k,
+                                      distances,
+                                      &vecClosestIndices);
+  return vecClosestIndices;
+}
@@ -17,6 +17,7 @@
 #define _PIIKNNCLASSIFIER_H
 
 #include "PiiVectorQuantizer.h"
+#include "PiiNearestNeighborIndex.h"
 #include <PiiMatrix.h>
 
 /**
@@ -24,6 +25,19 @@
  * code vectors closest to an unknown sample. The winning class index
  * is chosen by voting among the k closest neighbors.
  *
+ * By default, the neighbors are found by comparing the unknown
+ * sample to all models. With large model sets, an index such as
+ * PiiHnswIndex can be used to find (approximately) the same
+ * neighbors much faster:
+ *
+ * ~~~(c++)
+ * PiiKnnClassifier<PiiMatrix<float> > classifier;
+ * classifier.setModels(matModels);
+ * classifier.setClassLabels(vecLabels);
+ * classifier.setIndex(new PiiHnswIndex<PiiMatrix<float> >);
+ * classifier.buildIndex();
+ * QVector<double> vecResults(classifier.classifyBatch(matSamples));
+ * ~~~
  */
 template <class SampleSet> class PiiKnnClassifier : public PiiVectorQuantizer<SampleSet>
 {
@@ -58,6 +72,22 @@ public:
    */
   int findClosestMatch(ConstFeatureIterator featureVector, double* distance) const throw();
 
+  /**
+   * Classifies all *samples* at once. The results usually equal
+   * those of [classify()], but ties (two or more models at the same
+   * or nearly the same distance) may be resolved differently. With
+   * `float` features, the batch kernel calculates the distances in a
+   * different order, and rounding may differ.
+   */
+  QVector<double> classifyBatch(const SampleSet& samples) throw();
+
+  /**
+   * Returns the index of the closest model sample in the winning
+   * class for each sample. The k nearest neighbors of all samples are
+   * found with PiiClassification::knnClassifyBatch().
+   */
+  QVector<int> findClosestMatchBatch(const SampleSet& samples, QVector<double>* distances = 0) const throw();
+
   /**
    * Returns a modifiable reference to the class labels.
    */
@@ -84,7 +114,38 @@ public:
    */
   int getK() const;
 
+  /**
+   * Sets the index used for finding the nearest neighbors. The
+   * classifier takes the ownership of *index* and deletes the old
+   * one. If *index* is zero, exhaustive search will be used.
+   *
+   * The index will only be used after [buildIndex()] has been
+   * called, and only until [modelGeneration()] changes. Modifying the
+   * models through a reference or an iterator that was obtained
+   * before [buildIndex()] is not noticed; rebuild the index after
+   * such changes. Note that indices always measure distances
+   * with PiiSquaredGeometricDistance, irrespective of
+   * [distanceMeasure()].
+   */
+  void setIndex(PiiNearestNeighborIndex<SampleSet>* index);
+  /**
+   * Returns the nearest neighbor index, or zero if no index has been
+   * set.
+   */
+  PiiNearestNeighborIndex<SampleSet>* index() const;
+
+  /**
+   * Builds the nearest neighbor index out of the current model set.
+   * Does nothing if no index has been set.
+   *
+   * @exception PiiClassificationException& if the operation was
+   * interrupted through *controller*.
+   */
+  void buildIndex(PiiProgressController* controller = 0);
+
 private:
+  bool isIndexValid() const;
+
   class Data : public PiiVectorQuantizer<SampleSet>::Data
   {
   public:
@@ -93,6 +154,9 @@ private:
 
     QVector<double> vecClassLabels;
     int k;
+    PiiNearestNeighborIndex<SampleSet>* pIndex;
+    // The model generation the index was built from.
+    int iIndexGeneration;
   };
   PII_D_FUNC;
   PII_DISABLE_COPY(PiiKnnClassifier);
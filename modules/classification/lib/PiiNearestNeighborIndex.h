@@ -0,0 +1,91 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIINEARESTNEIGHBORINDEX_H
+#define _PIINEARESTNEIGHBORINDEX_H
+
+#include <QList>
+#include <PiiProgressController.h>
+#include "PiiSampleSet.h"
+#include "PiiClassification.h"
+
+/**
+ * An interface for data structures that speed up nearest neighbor
+ * searches in a fixed set of model samples. An index is first built
+ * out of a model set and then queried for the closest matches of
+ * unknown samples. All indices measure distances with the squared
+ * geometric distance (PiiSquaredGeometricDistance).
+ *
+ * Classifiers and matchers that perform nearest neighbor searches
+ * use exhaustive search by default. An index can be plugged in to
+ * replace it, see for example PiiKnnClassifier::setIndex().
+ *
+ * @see PiiKdTree
+ * @see PiiHnswIndex
+ */
+template <class SampleSet> class PiiNearestNeighborIndex
+{
+public:
+  typedef typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator Sample;
+
+  virtual ~PiiNearestNeighborIndex() {}
+
+  /**
+   * Discards the old index (if any) and builds a new one out of
+   * *modelSet*.
+   *
+   * @param modelSet model samples
+   *
+   * @param controller an optional external controller that can be
+   * used to stop building the index on user request.
+   *
+   * @exception PiiClassificationException& if the algorithm was
+   * interrupted.
+   */
+  virtual void buildIndex(const SampleSet& modelSet, PiiProgressController* controller = 0) = 0;
+
+  /**
+   * Returns the number of model samples in the index.
+   */
+  virtual int modelCount() const = 0;
+
+  /**
+   * Returns the *n* closest matches of *sample*. Depending on the
+   * index, the result may be approximate. See
+   * PiiClassification::findClosestMatches().
+   */
+  virtual PiiClassification::MatchList findClosestMatches(Sample sample, int n) const = 0;
+
+  /**
+   * Returns the *n* closest matches for each sample in *samples*. The
+   * default implementation calls [findClosestMatches()] for each
+   * sample in turn.
+   */
+  virtual QList<PiiClassification::MatchList> findClosestMatchesBatch(const SampleSet& samples, int n) const
+  {
+    QList<PiiClassification::MatchList> lstMatches;
+    const int iSamples = PiiSampleSet::sampleCount(samples);
+    for (int i=0; i<iSamples; ++i)
+      lstMatches << findClosestMatches(PiiSampleSet::sampleAt(samples, i), n);
+    return lstMatches;
+  }
+
+  /**
+   * Returns a copy of this index.
+   */
+  virtual PiiNearestNeighborIndex* clone() const = 0;
+};
+
+#endif //_PIINEARESTNEIGHBORINDEX_H
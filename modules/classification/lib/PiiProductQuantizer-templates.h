@@ -0,0 +1,166 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIPRODUCTQUANTIZER_H
+# error "Never use <PiiProductQuantizer-templates.h> directly; include <PiiProductQuantizer.h> instead."
+#endif
+
+#include "PiiKMeans.h"
+
+template <class SampleSet> PiiProductQuantizer<SampleSet>::PiiProductQuantizer() :
+  d(new Data)
+{
+}
+
+template <class SampleSet> PiiProductQuantizer<SampleSet>::PiiProductQuantizer(const PiiProductQuantizer& other) :
+  d(other.d)
+{
+  d->reserve();
+}
+
+template <class SampleSet> PiiProductQuantizer<SampleSet>::~PiiProductQuantizer()
+{
+  d->release();
+}
+
+template <class SampleSet>
+PiiProductQuantizer<SampleSet>& PiiProductQuantizer<SampleSet>::operator= (const PiiProductQuantizer& other)
+{
+  other.d->assignTo(d);
+  return *this;
+}
+
+template <class SampleSet> void PiiProductQuantizer<SampleSet>::setSubspaceCount(int subspaceCount)
+{
+  if (subspaceCount < 1)
+    return;
+  d = d->detach();
+  d->iSubspaceCount = subspaceCount;
+  d->iFeatureCount = 0;
+  d->vecCodebook.clear();
+}
+
+template <class SampleSet> int PiiProductQuantizer<SampleSet>::subspaceCount() const
+{
+  return d->iSubspaceCount;
+}
+
+template <class SampleSet> void PiiProductQuantizer<SampleSet>::setCentroidCount(int centroidCount)
+{
+  if (centroidCount < 1 || centroidCount > 256)
+    return;
+  d = d->detach();
+  d->iCentroidCount = centroidCount;
+  d->iFeatureCount = 0;
+  d->vecCodebook.clear();
+}
+
+template <class SampleSet>
+void PiiProductQuantizer<SampleSet>::train(const SampleSet& samples, PiiProgressController* controller)
+{
+  const int iFeatureCount = PiiSampleSet::featureCount(samples);
+  const int iSampleCount = PiiSampleSet::sampleCount(samples);
+
+  Data* pData = new Data;
+  pData->iSubspaceCount = iFeatureCount > 0 ? qMin(d->iSubspaceCount, iFeatureCount) : d->iSubspaceCount;
+  pData->iCentroidCount = d->iCentroidCount;
+  d->release();
+  d = pData;
+  if (iFeatureCount == 0 || iSampleCount == 0)
+    return;
+  d->iFeatureCount = iFeatureCount;
+  d->vecCodebook.fill(0, iFeatureCount * d->iCentroidCount);
+
+  const int iTrainingCount = qMin(iSampleCount, 20000);
+  PiiKMeans<PiiMatrix<float> > kMeans;
+  kMeans.setMaxIterations(20);
+  for (int s=0; s<d->iSubspaceCount; ++s)
+    {
+      const int iStart = subspaceStart(s), iLength = subspaceStart(s+1) - iStart;
+      PiiMatrix<float> matSubvectors(PiiMatrix<float>::uninitialized(iTrainingCount, iLength));
+      for (int i=0; i<iTrainingCount; ++i)
+        {
+          Sample sample = PiiSampleSet::sampleAt(samples, int(qint64(i) * iSampleCount / iTrainingCount));
+          float* pRow = matSubvectors[i];
+          for (int j=0; j<iLength; ++j)
+            pRow[j] = float(sample[iStart + j]);
+        }
+
+      // Small training sets are used as such.
+      PiiMatrix<float> matCentroids(d->iCentroidCount < iTrainingCount ?
+                                    kMeans.cluster(matSubvectors, d->iCentroidCount) :
+                                    matSubvectors);
+      float* pCodebook = d->vecCodebook.data() + d->iCentroidCount * iStart;
+      // Unused code words repeat the first centroid.
+      for (int c=0; c<d->iCentroidCount; ++c, pCodebook += iLength)
+        {
+          const float* pCentroid = matCentroids[c < matCentroids.rows() ? c : 0];
+          for (int j=0; j<iLength; ++j)
+            pCodebook[j] = pCentroid[j];
+        }
+      PII_TRY_CONTINUE(controller, double(s+1) / d->iSubspaceCount);
+    }
+}
+
+template <class SampleSet>
+void PiiProductQuantizer<SampleSet>::encode(Sample sample, unsigned char* code) const
+{
+  for (int s=0; s<d->iSubspaceCount; ++s)
+    {
+      const int iStart = subspaceStart(s), iLength = subspaceStart(s+1) - iStart;
+      const float* pCentroid = d->vecCodebook.constData() + d->iCentroidCount * iStart;
+      double dMinDistance = INFINITY;
+      int iClosest = 0;
+      for (int c=0; c<d->iCentroidCount; ++c, pCentroid += iLength)
+        {
+          double dDistance = 0;
+          for (int j=0; j<iLength; ++j)
+            dDistance += Pii::square(double(sample[iStart + j]) - pCentroid[j]);
+          if (dDistance < dMinDistance)
+            {
+              dMinDistance = dDistance;
+              iClosest = c;
+            }
+        }
+      code[s] = (unsigned char)iClosest;
+    }
+}
+
+template <class SampleSet>
+QVector<unsigned char> PiiProductQuantizer<SampleSet>::encode(const SampleSet& samples) const
+{
+  const int iSampleCount = PiiSampleSet::sampleCount(samples);
+  QVector<unsigned char> vecCodes(iSampleCount * d->iSubspaceCount);
+  for (int i=0; i<iSampleCount; ++i)
+    encode(PiiSampleSet::sampleAt(samples, i), vecCodes.data() + i * d->iSubspaceCount);
+  return vecCodes;
+}
+
+template <class SampleSet>
+void PiiProductQuantizer<SampleSet>::calculateDistanceTable(Sample sample, float* table) const
+{
+  for (int s=0; s<d->iSubspaceCount; ++s)
+    {
+      const int iStart = subspaceStart(s), iLength = subspaceStart(s+1) - iStart;
+      const float* pCentroid = d->vecCodebook.constData() + d->iCentroidCount * iStart;
+      for (int c=0; c<d->iCentroidCount; ++c, pCentroid += iLength)
+        {
+          double dDistance = 0;
+          for (int j=0; j<iLength; ++j)
+            dDistance += Pii::square(double(sample[iStart + j]) - pCentroid[j]);
+          *table++ = float(dDistance);
+        }
+    }
+}
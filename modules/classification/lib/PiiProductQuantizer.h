@@ -0,0 +1,193 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIPRODUCTQUANTIZER_H
+#define _PIIPRODUCTQUANTIZER_H
+
+#include <QVector>
+#include <PiiProgressController.h>
+#include "PiiSampleSet.h"
+#include "PiiClassification.h"
+#include <PiiSerialization.h>
+#include <PiiNameValuePair.h>
+#include <PiiSharedD.h>
+
+/**
+ * Product quantizer. Product quantization compresses feature vectors
+ * by splitting the feature space into [subspaceCount()] subspaces of
+ * (almost) equal dimensionality and replacing the part of a vector
+ * in each subspace with the index of the closest centroid in a
+ * subspace-specific codebook. Each codebook has at most 256
+ * centroids, which means a vector is represented by one byte per
+ * subspace. A 128-dimensional `float` vector divided into 16
+ * subspaces shrinks from 512 bytes to 16.
+ *
+ * Squared geometric distances between an uncompressed sample and
+ * compressed models can be estimated quickly. Once
+ * [calculateDistanceTable()] has calculated the distances from the
+ * sample to all centroids, the distance to any encoded model is a sum
+ * of [subspaceCount()] table look-ups.
+ *
+ * ~~~(c++)
+ * PiiProductQuantizer<PiiMatrix<float> > quantizer;
+ * quantizer.setSubspaceCount(8);
+ * quantizer.train(matModels);
+ * QVector<unsigned char> vecCodes(quantizer.encode(matModels));
+ *
+ * QVector<float> vecTable(quantizer.distanceTableSize());
+ * quantizer.calculateDistanceTable(matSample[0], vecTable.data());
+ * // Estimated distance to model 5
+ * double dDistance = quantizer.distance(vecTable.constData(),
+ *                                       vecCodes.constData() + 5 * quantizer.subspaceCount());
+ * ~~~
+ *
+ * @see PiiHnswIndex
+ */
+template <class SampleSet> class PiiProductQuantizer
+{
+  friend struct PiiSerialization::Accessor;
+  template <class Archive> void serialize(Archive& archive, const unsigned int)
+  {
+    archive & PII_NVP("subspaces", d->iSubspaceCount);
+    archive & PII_NVP("centroids", d->iCentroidCount);
+    archive & PII_NVP("features", d->iFeatureCount);
+    archive & PII_NVP("codebook", d->vecCodebook);
+  }
+
+public:
+  typedef typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator Sample;
+
+  /**
+   * Constructs an untrained product quantizer with eight subspaces.
+   */
+  PiiProductQuantizer();
+  PiiProductQuantizer(const PiiProductQuantizer& other);
+  ~PiiProductQuantizer();
+  PiiProductQuantizer& operator= (const PiiProductQuantizer& other);
+
+  /**
+   * Sets the number of subspaces. Each subspace takes one byte in an
+   * encoded vector. More subspaces mean better accuracy but slower
+   * distance calculations. Changing the number of subspaces discards
+   * the codebooks, and the quantizer must be trained again. The
+   * default is 8.
+   */
+  void setSubspaceCount(int subspaceCount);
+  /**
+   * Returns the number of subspaces, which is also the length of an
+   * encoded vector in bytes. If the quantizer has been trained with
+   * less features than there are subspaces, the number of features
+   * will be returned.
+   */
+  int subspaceCount() const;
+
+  /**
+   * Sets the maximum number of centroids in each codebook, in the
+   * range [1, 256]. Changing the number of centroids discards the
+   * codebooks. The default is 256.
+   */
+  void setCentroidCount(int centroidCount);
+  /**
+   * Returns the maximum number of centroids in each codebook.
+   */
+  int centroidCount() const { return d->iCentroidCount; }
+
+  /**
+   * Returns the number of features in the vectors the quantizer was
+   * trained with, or zero if the quantizer has not been trained.
+   */
+  int featureCount() const { return d->iFeatureCount; }
+
+  /**
+   * Returns `true` if the quantizer has been trained and can be used
+   * for encoding vectors, `false` otherwise.
+   */
+  bool isTrained() const { return d->iFeatureCount > 0; }
+
+  /**
+   * Trains the codebooks. The subvectors of *samples* in each
+   * subspace are clustered with PiiKMeans. If there are more than
+   * 20000 samples, an evenly spaced subset will be used.
+   *
+   * @exception PiiClassificationException& if the algorithm was
+   * interrupted through *controller*.
+   */
+  void train(const SampleSet& samples, PiiProgressController* controller = 0);
+
+  /**
+   * Encodes *sample* and stores [subspaceCount()] bytes to *code*.
+   */
+  void encode(Sample sample, unsigned char* code) const;
+
+  /**
+   * Encodes all *samples*. The code of sample `i` is stored at
+   * index `i` * [subspaceCount()] in the returned array.
+   */
+  QVector<unsigned char> encode(const SampleSet& samples) const;
+
+  /**
+   * Returns the number of elements needed to store a distance table.
+   */
+  int distanceTableSize() const { return d->iSubspaceCount * d->iCentroidCount; }
+
+  /**
+   * Calculates the squared geometric distances from *sample* to all
+   * centroids in all codebooks and stores them to *table*, which
+   * must be able to hold [distanceTableSize()] elements.
+   */
+  void calculateDistanceTable(Sample sample, float* table) const;
+
+  /**
+   * Returns the estimated squared geometric distance between a
+   * sample and an encoded model *code*. *table* is the distance table
+   * of the sample, as calculated by [calculateDistanceTable()].
+   */
+  inline double distance(const float* table, const unsigned char* code) const
+  {
+    double dSum = 0;
+    for (int s=0; s<d->iSubspaceCount; ++s, table += d->iCentroidCount)
+      dSum += table[code[s]];
+    return dSum;
+  }
+
+private:
+  class Data : public PiiSharedD<Data>
+  {
+  public:
+    Data() : iSubspaceCount(8), iCentroidCount(256), iFeatureCount(0) {}
+    Data(const Data& other) :
+      PiiSharedD<Data>(),
+      iSubspaceCount(other.iSubspaceCount),
+      iCentroidCount(other.iCentroidCount),
+      iFeatureCount(other.iFeatureCount),
+      vecCodebook(other.vecCodebook)
+    {}
+
+    int iSubspaceCount, iCentroidCount, iFeatureCount;
+    /* The centroids of subspace s are stored in a block that starts
+       at iCentroidCount * subspaceStart(s). The length of each
+       centroid is subspaceStart(s+1) - subspaceStart(s). */
+    QVector<float> vecCodebook;
+  } *d;
+
+  inline int subspaceStart(int subspace) const
+  {
+    return int(qint64(subspace) * d->iFeatureCount / d->iSubspaceCount);
+  }
+};
+
+#include "PiiProductQuantizer-templates.h"
+
+#endif //_PIIPRODUCTQUANTIZER_H
@@ -20,6 +20,7 @@
 #include <PiiMath.h>
 #include <PiiRandom.h>
 #include "PiiClassification.h"
+#include "PiiKMeans.h"
 
 
 template <class SampleSet> PiiSom<SampleSet>::Data::Data(int width,
@@ -162,7 +163,12 @@ template <class SampleSet> void PiiSom<SampleSet>::learn(const SampleSet& sample
     return;
   if (this->modelCount() == 0)
     {
-      if (d->initMode == PiiClassification::SomSampleInit)
+      if (d->initMode == PiiClassification::SomKMeansInit && iSamples >= iMapSize)
+        {
+          PiiKMeans<SampleSet> kMeans;
+          this->setModels(kMeans.cluster(samples, iMapSize, this->controller()));
+        }
+      else if (d->initMode != PiiClassification::SomRandomInit)
         {
           SampleSet codeBook(PiiSampleSet::create<SampleSet>(0, iFeatures));
           // If there are less samples than code vectors,
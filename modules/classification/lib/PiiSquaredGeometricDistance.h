@@ -39,4 +39,42 @@ PII_DEFAULT_DISTANCE_MEASURE_DEF(PiiSquaredGeometricDistance)
   return sum;
 }
 
+/// @internal
+template <class FeatureIterator> struct PiiDistanceKernel<PiiSquaredGeometricDistance<FeatureIterator> > :
+  PiiDistanceKernelBase<PiiSquaredGeometricDistance<FeatureIterator>,
+                        PiiDistanceKernel<PiiSquaredGeometricDistance<FeatureIterator> >,
+                        true>
+{};
+
+/**
+ * Batch kernel for `float` features. Single distances are calculated
+ * with SSE2 instructions, if available. If there are many samples,
+ * distances are calculated as \(|S|^2 + |M|^2 - 2SM^T\): the norms
+ * of all vectors are calculated once and each sample is compared to
+ * several models at a time. Products are calculated and accumulated
+ * in double precision. Distances that are small compared to the
+ * norms of the vectors lose digits to cancellation and are
+ * recalculated from the differences of the features. The results may
+ * still differ slightly from those of PiiSquaredGeometricDistance.
+ */
+template <> struct PII_CLASSIFICATION_EXPORT PiiDistanceKernel<PiiSquaredGeometricDistance<const float*> > :
+  PiiDistanceKernelBase<PiiSquaredGeometricDistance<const float*>,
+                        PiiDistanceKernel<PiiSquaredGeometricDistance<const float*> >,
+                        true>
+{
+  typedef PiiSquaredGeometricDistance<const float*> Measure;
+
+  static double distance(const Measure& measure, const float* sample, const float* model, int length);
+  static void calculateDistances(const Measure& measure,
+                                 const float* const* samples, int sampleCount,
+                                 const float* const* models, int modelCount,
+                                 int length,
+                                 double* distances);
+  static void findClosestMatches(const Measure& measure,
+                                 const float* const* samples, int sampleCount,
+                                 const float* const* models, int modelCount,
+                                 int length,
+                                 int* indices, double* distances);
+};
+
 #endif //_PIISQUAREDGEOMETRICDISTANCE_H
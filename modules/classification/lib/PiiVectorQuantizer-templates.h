@@ -24,14 +24,16 @@
 template <class SampleSet>
 PiiVectorQuantizer<SampleSet>::Data::Data() :
   pMeasure(new PII_POLYMORPHIC_MEASURE(PiiSquaredGeometricDistance)),
-  dRejectThreshold(INFINITY)
+  dRejectThreshold(INFINITY),
+  iModelGeneration(0)
 {
 }
 
 template <class SampleSet>
 PiiVectorQuantizer<SampleSet>::Data::Data(PiiDistanceMeasure<ConstFeatureIterator>* measure) :
   dRejectThreshold(INFINITY),
-  pMeasure(measure)
+  pMeasure(measure),
+  iModelGeneration(0)
 {
 }
 
@@ -78,10 +80,12 @@ PiiDistanceMeasure<typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterato
 template <class SampleSet> void PiiVectorQuantizer<SampleSet>::setModels(const SampleSet& models)
 {
   d->modelSet = models;
+  ++d->iModelGeneration;
 }
 
 template <class SampleSet> SampleSet& PiiVectorQuantizer<SampleSet>::models()
 {
+  ++d->iModelGeneration;
   return d->modelSet;
 }
 
@@ -93,6 +97,7 @@ template <class SampleSet> SampleSet PiiVectorQuantizer<SampleSet>::models() con
 template <class SampleSet>
 typename PiiSampleSet::Traits<SampleSet>::FeatureIterator PiiVectorQuantizer<SampleSet>::modelAt(int index)
 {
+  ++d->iModelGeneration;
   return PiiSampleSet::sampleAt(d->modelSet, index);
 }
 
@@ -102,6 +107,11 @@ typename PiiSampleSet::Traits<SampleSet>::ConstFeatureIterator PiiVectorQuantize
   return PiiSampleSet::sampleAt(d->modelSet, index);
 }
 
+template <class SampleSet> int PiiVectorQuantizer<SampleSet>::modelGeneration() const
+{
+  return d->iModelGeneration;
+}
+
 template <class SampleSet> int PiiVectorQuantizer<SampleSet>::modelCount() const
 {
   return PiiSampleSet::sampleCount(d->modelSet);
@@ -126,6 +136,15 @@ template <class SampleSet> double PiiVectorQuantizer<SampleSet>::classify(ConstF
   return iBestMatch >= 0 ? iBestMatch : NAN;
 }
 
+template <class SampleSet> QVector<double> PiiVectorQuantizer<SampleSet>::classifyBatch(const SampleSet& samples) throw()
+{
+  const QVector<int> vecMatches(findClosestMatchBatch(samples));
+  QVector<double> vecResults(vecMatches.size());
+  for (int i=0; i<vecMatches.size(); ++i)
+    vecResults[i] = vecMatches[i] >= 0 ? vecMatches[i] : NAN;
+  return vecResults;
+}
+
 template <class SampleSet> int PiiVectorQuantizer<SampleSet>::findClosestMatch(ConstFeatureIterator features,
                                                                                double* distance) const throw()
 {
@@ -138,3 +157,19 @@ template <class SampleSet> int PiiVectorQuantizer<SampleSet>::findClosestMatch(C
   // is rejected.
   return *distance <= d->dRejectThreshold ? iBestMatch : -1;
 }
+
+template <class SampleSet> QVector<int> PiiVectorQuantizer<SampleSet>::findClosestMatchBatch(const SampleSet& samples,
+                                                                                          QVector<double>* distances) const throw()
+{
+  QVector<double> vecDistances;
+  QVector<int> vecMatches(PiiClassification::findClosestMatchBatch(samples,
+                                                                   const_cast<const SampleSet&>(d->modelSet),
+                                                                   *d->pMeasure,
+                                                                   &vecDistances));
+  for (int i=0; i<vecMatches.size(); ++i)
+    if (!(vecDistances[i] <= d->dRejectThreshold))
+      vecMatches[i] = -1;
+  if (distances != 0)
+    *distances = vecDistances;
+  return vecMatches;
+}
@@ -71,6 +71,32 @@ public:
    */
   virtual int findClosestMatch(ConstFeatureIterator featureVector, double* distance) const throw();
 
+  /**
+   * Classifies all *samples* at once. See [findClosestMatchBatch()].
+   * Rejected samples are classified as `NaN`.
+   */
+  QVector<double> classifyBatch(const SampleSet& samples) throw();
+
+  /**
+   * Returns the index of the closest model vector for each sample in
+   * *samples*. Distances are calculated with
+   * PiiClassification::findClosestMatchBatch(), which invokes the
+   * distance measure only once for the whole batch. The results
+   * usually equal those of [findClosestMatch()], but ties (two or
+   * more models at the same or nearly the same distance) may be
+   * resolved differently, because the distances are calculated in a
+   * different order and rounding may differ.
+   *
+   * @param samples the samples to classify.
+   *
+   * @param distances an optional output-value parameter that will
+   * store the distance to the closest model for each sample.
+   *
+   * @return the index of the closest model for each sample, or -1
+   * for rejected samples.
+   */
+  virtual QVector<int> findClosestMatchBatch(const SampleSet& samples, QVector<double>* distances = 0) const throw();
+
   /**
    * Set a distance threshold for rejecting samples. If the distance to
    * the closest code vector is above this threshold, the sample is
@@ -95,7 +121,9 @@ public:
   void setDistanceMeasure(PiiDistanceMeasure<ConstFeatureIterator>* measure);
 
   /**
-   * Returns a modifiable reference to the model set.
+   * Returns a modifiable reference to the model set. Since the models
+   * may be changed through the reference, this function increases
+   * [modelGeneration()].
    */
   SampleSet& models();
 
@@ -105,10 +133,18 @@ public:
   SampleSet models() const;
 
   /**
-   * Set the model sample set.
+   * Set the model sample set. Increases [modelGeneration()].
    */
   void setModels(const SampleSet& models);
 
+  /**
+   * Returns a number that changes whenever the model set may have
+   * been changed through [setModels()], [models()] or [modelAt()].
+   * Changes made later through a reference or iterator that was
+   * obtained earlier are not noticed.
+   */
+  int modelGeneration() const;
+
   /**
    * Returns the number of model vectors in the model sample set.
    */
@@ -121,7 +157,7 @@ public:
 
   /**
    * Returns a modifiable iterator to the beginning of the model
-   * sample at *index*.
+   * sample at *index*. Increases [modelGeneration()].
    */
   FeatureIterator modelAt(int index);
   /**
@@ -140,6 +176,7 @@ protected:
     SampleSet modelSet;
     PiiDistanceMeasure<ConstFeatureIterator>* pMeasure;
     double dRejectThreshold;
+    int iModelGeneration;
   } *d;
 
   /// @internal
@@ -21,7 +21,9 @@ PiiBoostClassifierOperation::Data::Data() :
   PiiClassifierOperation::Data(PiiClassification::WeightedLearner),
   algorithm(PiiClassification::RealBoost),
   iMaxClassifiers(100),
-  dMinError(0)
+  dMinError(0),
+  splitSearchMethod(PiiClassification::ExactSplitSearch),
+  iBinCount(256)
 {
 }
 
@@ -39,3 +41,7 @@ void PiiBoostClassifierOperation::setMaxClassifiers(int maxClassifiers) { _d()->
 int PiiBoostClassifierOperation::maxClassifiers() const { return _d()->iMaxClassifiers; }
 void PiiBoostClassifierOperation::setMinError(double minError) { _d()->dMinError = minError; }
 double PiiBoostClassifierOperation::minError() const { return _d()->dMinError; }
+void PiiBoostClassifierOperation::setSplitSearchMethod(PiiClassification::SplitSearchMethod splitSearchMethod) { _d()->splitSearchMethod = splitSearchMethod; }
+PiiClassification::SplitSearchMethod PiiBoostClassifierOperation::splitSearchMethod() const { return _d()->splitSearchMethod; }
+void PiiBoostClassifierOperation::setBinCount(int binCount) { _d()->iBinCount = qBound(2, binCount, 256); }
+int PiiBoostClassifierOperation::binCount() const { return _d()->iBinCount; }
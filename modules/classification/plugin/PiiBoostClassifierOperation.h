@@ -18,8 +18,7 @@
 
 #include "PiiClassifierOperation.h"
 #include "PiiBoostClassifier.h"
-#include "PiiDefaultClassifierFactory.h"
-#include "PiiDecisionStump.h"
+#include "PiiDecisionStumpFactory.h"
 #include "PiiSampleSetCollector.h"
 
 /**
@@ -52,6 +51,22 @@ class PiiBoostClassifierOperation : public PiiClassifierOperation
    */
   Q_PROPERTY(double minError READ minError WRITE setMinError);
 
+  /**
+   * The method used for finding the optimal threshold for decision
+   * stumps. `ExactSplitSearch` tries all distinct feature values.
+   * `HistogramSplitSearch` quantizes each feature into at most
+   * [binCount] bins and only tries bin boundaries, which is faster
+   * with large sample sets. The default is `ExactSplitSearch`.
+   */
+  Q_PROPERTY(PiiClassification::SplitSearchMethod splitSearchMethod READ splitSearchMethod WRITE setSplitSearchMethod);
+
+  /**
+   * The maximum number of histogram bins for each feature with
+   * `HistogramSplitSearch`, in the range [2, 256]. The default is
+   * 256.
+   */
+  Q_PROPERTY(int binCount READ binCount WRITE setBinCount);
+
 public:
   template <class SampleSet> class Template;
 
@@ -66,6 +81,8 @@ protected:
     PiiClassification::BoostingAlgorithm algorithm;
     int iMaxClassifiers;
     double dMinError;
+    PiiClassification::SplitSearchMethod splitSearchMethod;
+    int iBinCount;
   };
   PII_D_FUNC;
   /// @internal
@@ -77,6 +94,10 @@ protected:
   int maxClassifiers() const;
   void setMinError(double minError);
   double minError() const;
+  void setSplitSearchMethod(PiiClassification::SplitSearchMethod splitSearchMethod);
+  PiiClassification::SplitSearchMethod splitSearchMethod() const;
+  void setBinCount(int binCount);
+  int binCount() const;
 };
 
 template <class T> struct MsvcHack
@@ -88,7 +109,7 @@ template <class T> struct MsvcHack
 /// @internal
 template <class SampleSet> class PiiBoostClassifierOperation::Template :
   public PiiBoostClassifierOperation,
-  public PiiDefaultClassifierFactory<PiiDecisionStump<SampleSet> >
+  public PiiDecisionStumpFactory<SampleSet>
 {
   friend struct PiiSerialization::Accessor;
   PII_DECLARE_VIRTUAL_METAOBJECT_FUNCTION;
@@ -111,6 +132,7 @@ public:
 protected:
   void check(bool reset);
   double classify();
+  QVector<double> classifyBatch();
   bool learnBatch();
   void collectSample(double label, double weight);
   void replaceClassifier();
@@ -186,6 +208,13 @@ template <class SampleSet> double PiiBoostClassifierOperation::Template<SampleSe
   return dLabel;
 }
 
+template <class SampleSet> QVector<double> PiiBoostClassifierOperation::Template<SampleSet>::classifyBatch()
+{
+  QVector<double> vecLabels(PiiClassifierOperation::classifyBatch(*_d()->pClassifier));
+  classificationOutput()->emitObject(toColumnMatrix(vecLabels));
+  return vecLabels;
+}
+
 template <class SampleSet>
 void PiiBoostClassifierOperation::Template<SampleSet>::collectSample(double label, double weight)
 {
@@ -196,6 +225,8 @@ void PiiBoostClassifierOperation::Template<SampleSet>::collectSample(double labe
 template <class SampleSet> bool PiiBoostClassifierOperation::Template<SampleSet>::learnBatch()
 {
   PII_D;
+  PiiDecisionStumpFactory<SampleSet>::setSplitSearchMethod(d->splitSearchMethod);
+  PiiDecisionStumpFactory<SampleSet>::setBinCount(d->iBinCount);
   d->pNewClassifier = createClassifier();
   bool bSuccess = PiiClassifierOperation::learnBatch(*d->pNewClassifier,
                                                      *d->collector.samples(),
@@ -23,7 +23,8 @@ PiiClassifierOperation::Data::Data(PiiClassification::LearnerCapabilities cap) :
   fullBufferBehavior(PiiClassification::OverwriteRandomSample),
   dProgressStep(0.01),
   dCurrentProgress(0),
-  bThreadRunning(false)
+  bThreadRunning(false),
+  bBatchMode(false)
 {
 }
 
@@ -56,6 +57,7 @@ void PiiClassifierOperation::init()
 
   setProtectionLevel("learningBatchSize", WriteWhenStoppedOrPaused);
   setProtectionLevel("fullBufferBehavior", WriteWhenStoppedOrPaused);
+  setProtectionLevel("batchMode", WriteWhenStoppedOrPaused);
 }
 
 PiiClassifierOperation::~PiiClassifierOperation()
@@ -70,6 +72,8 @@ void PiiClassifierOperation::check(bool reset)
   d->pLabelInput->setOptional(d->iLearningBatchSize == 0 ||
                               d->capabilities & PiiClassification::NonSupervisedLearner);
   PiiDefaultOperation::check(reset);
+  if (d->bBatchMode && d->iLearningBatchSize != 0)
+    PII_THROW(PiiExecutionException, tr("Learning is not possible in batch mode."));
   if (reset)
     {
       stopLearningThread();
@@ -93,6 +97,12 @@ void PiiClassifierOperation::process()
   PII_D;
   QMutexLocker lock(&d->learningMutex);
 
+  if (d->bBatchMode)
+    {
+      classifyBatch();
+      return;
+    }
+
   // Collect samples for training only if requested (by setting batch
   // size to a non-zero value) and if the learning thread is not
   // already running.
@@ -138,6 +148,11 @@ bool PiiClassifierOperation::needsThread() const
   return true;
 }
 
+QVector<double> PiiClassifierOperation::classifyBatch()
+{
+  PII_THROW(PiiExecutionException, tr("%1 does not support batch mode.").arg(metaObject()->className()));
+}
+
 double PiiClassifierOperation::learnOne(double label,double)
 {
   _d()->pClassificationOutput->emitObject(label);
@@ -254,6 +269,9 @@ void PiiClassifierOperation::setFullBufferBehavior(PiiClassification::FullBuffer
 PiiClassification::FullBufferBehavior PiiClassifierOperation::fullBufferBehavior() const
 { return _d()->fullBufferBehavior; }
 
+void PiiClassifierOperation::setBatchMode(bool batchMode) { _d()->bBatchMode = batchMode; }
+bool PiiClassifierOperation::batchMode() const { return _d()->bBatchMode; }
+
 QMutex* PiiClassifierOperation::learningMutex() { return &_d()->learningMutex; }
 PiiInputSocket* PiiClassifierOperation::featureInput() { return _d()->pFeatureInput; }
 PiiInputSocket* PiiClassifierOperation::labelInput() { return _d()->pLabelInput; }
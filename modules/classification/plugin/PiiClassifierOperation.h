@@ -41,6 +41,10 @@ namespace PiiClassification
     ConstFeatureIterator operator() (PiiInputSocket* input, int* featureCount)
     {
     }
+
+    const SampleSet& readSamples(PiiInputSocket* input, int* featureCount)
+    {
+    }
   };
   */
 
@@ -78,6 +82,30 @@ namespace PiiClassification
       *featureCount = matFeatures.columns();
       return matFeatures[0];
     }
+
+    /**
+     * Reads *input* and converts the incoming object to a
+     * PiiMatrix<T> with one feature vector on each row. Used in batch
+     * mode.
+     *
+     * @param input the input socket to read
+     *
+     * @param featureCount the number of features to expect. See
+     * operator().
+     *
+     * @return the feature vectors. Valid until the next call.
+     *
+     * @exception PiiExecutionException& if the input object is not a
+     * PiiMatrix or if it doesn't have *featureCount* columns.
+     */
+    const PiiMatrix<T>& readSamples(PiiInputSocket* input, int* featureCount)
+    {
+      matFeatures = PiiYdin::convertMatrixTo<T>(input);
+      if (*featureCount > 0 && matFeatures.columns() != *featureCount)
+        PII_THROW_WRONG_SIZE(input, matFeatures, matFeatures.rows(), *featureCount);
+      *featureCount = matFeatures.columns();
+      return matFeatures;
+    }
     PiiMatrix<T> matFeatures;
   };
 };
@@ -136,6 +164,13 @@ namespace PiiClassification
  * @out classification - the result of classification (double). Either
  * a class index or a regression. `NaN` indicates failures.
  *
+ * In [batchMode], each object in the `features` input contains many
+ * feature vectors, one on each row. All of them are classified with a
+ * single call, and the outputs emit column matrices with one row for
+ * each feature vector instead of scalars. For example, the
+ * `classification` output emits a N-by-1 PiiMatrix<double> if the
+ * `features` input receives a N-by-M matrix.
+ *
  * The usual way of creating a custom classifier is to first create an
  * operation class that reflects the configuration of the classifier
  * in its properties and uses pure virtual getter and setter functions
@@ -229,6 +264,17 @@ class PII_CLASSIFICATION_EXPORT PiiClassifierOperation :
    */
   Q_PROPERTY(QString learningError READ learningError);
 
+  /**
+   * Enables batch classification. Use batch mode if many feature
+   * vectors must be classified at once, for example the features of
+   * all objects detected in a frame. Classifiers such as the k-NN
+   * process a batch of samples much faster than the same samples one
+   * by one. Learning is not possible in batch mode: [learningBatchSize]
+   * must be zero. Not all classifiers support batch mode. The default
+   * value is `false`.
+   */
+  Q_PROPERTY(bool batchMode READ batchMode WRITE setBatchMode);
+
 public:
   /**
    * Destroys the operation. The operation will not be destructed
@@ -350,6 +396,7 @@ protected:
     QMutex learningMutex;
     bool bThreadRunning;
     QString strLearningError;
+    bool bBatchMode;
   };
   PII_D_FUNC;
 
@@ -485,6 +532,21 @@ protected:
    */
   virtual double classify() = 0;
 
+  /**
+   * Reads a batch of feature vectors from the `features` input and
+   * emits their classifications to the `classification` output as a
+   * column matrix. May also send additional objects through other
+   * output sockets. This function is called by [process()] instead of
+   * [classify()] in [batchMode]. The default implementation throws an
+   * exception.
+   *
+   * @return the classifications
+   *
+   * @exception PiiExecutionException& if the operation doesn't
+   * support batch mode.
+   */
+  virtual QVector<double> classifyBatch();
+
   /**
    * Reads a feature vector from the `features` input, sends it to an
    * on-line learning algorithm, and emits the classification result
@@ -602,12 +664,26 @@ protected:
    */
   template <class SampleSet> double classify(PiiClassifier<SampleSet>& classifier);
 
+  /**
+   * Reads a batch of feature vectors from the `features` input and
+   * calls classifier.classifyBatch() using it as the input.
+   */
+  template <class SampleSet> QVector<double> classifyBatch(PiiClassifier<SampleSet>& classifier);
+
+  /**
+   * Converts *values* to a column matrix. Used for emitting results
+   * in batch mode.
+   */
+  template <class T> static PiiMatrix<T> toColumnMatrix(const QVector<T>& values);
+
   void setProgressStep(double progressStep);
   double progressStep() const;
   void setLearningBatchSize(int learningBatchSize);
   int learningBatchSize() const;
   void setFullBufferBehavior(PiiClassification::FullBufferBehavior fullBufferBehavior);
   PiiClassification::FullBufferBehavior fullBufferBehavior() const;
+  void setBatchMode(bool batchMode);
+  bool batchMode() const;
 
   void aboutToChangeState(State newState);
 
@@ -662,4 +738,20 @@ double PiiClassifierOperation::classify(PiiClassifier<SampleSet>& classifier)
   return classifier.classify(readFeatures(featureInput(), &iFeatures));
 }
 
+template <class SampleSet>
+QVector<double> PiiClassifierOperation::classifyBatch(PiiClassifier<SampleSet>& classifier)
+{
+  PiiClassification::FeatureReader<SampleSet> readFeatures;
+  int iFeatures = featureCount();
+  return classifier.classifyBatch(readFeatures.readSamples(featureInput(), &iFeatures));
+}
+
+template <class T> PiiMatrix<T> PiiClassifierOperation::toColumnMatrix(const QVector<T>& values)
+{
+  PiiMatrix<T> result(PiiMatrix<T>::uninitialized(values.size(), 1));
+  for (int i=0; i<values.size(); ++i)
+    result(i,0) = values[i];
+  return result;
+}
+
 #endif //_PIICLASSIFIEROPERATION_H
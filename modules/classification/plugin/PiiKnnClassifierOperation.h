@@ -75,6 +75,7 @@ public:
 protected:
   void check(bool reset);
   double classify();
+  QVector<double> classifyBatch();
   double learnOne(double label, double weight);
   void collectSample(double label, double weight);
   void replaceClassifier();
@@ -133,6 +134,13 @@ template <class SampleSet> double PiiKnnClassifierOperation::Template<SampleSet>
   return dLabel;
 }
 
+template <class SampleSet> QVector<double> PiiKnnClassifierOperation::Template<SampleSet>::classifyBatch()
+{
+  QVector<double> vecLabels(PiiVectorQuantizerOperation::classifyBatch(_d()->classifier));
+  classificationOutput()->emitObject(toColumnMatrix(vecLabels));
+  return vecLabels;
+}
+
 template <class SampleSet> double PiiKnnClassifierOperation::Template<SampleSet>::learnOne(double label, double /*weight*/)
 {
   PiiVectorQuantizerOperation::learnOne(_d()->onlineCollector, label);
@@ -59,6 +59,7 @@ protected:
   void setLearningAlgorithm(PiiClassification::SomLearningAlgorithm algorithm) { _d()->pClassifier->setLearningAlgorithm(algorithm); }
 
   double classify();
+  QVector<double> classifyBatch();
   double learnOne(double label, double weight);
   void collectSample(double label, double weight);
   bool learnBatch();
@@ -136,6 +137,24 @@ template <class SampleSet> double PiiSomOperation::Template<SampleSet>::classify
   return dLabel;
 }
 
+template <class SampleSet> QVector<double> PiiSomOperation::Template<SampleSet>::classifyBatch()
+{
+  PII_D;
+  QVector<int> vecCodeBookIndices;
+  QVector<double> vecLabels(PiiVectorQuantizerOperation::classifyBatch(*d->pClassifier, &vecCodeBookIndices));
+  const int iWidth = d->pClassifier->width();
+  PiiMatrix<int> matX(PiiMatrix<int>::uninitialized(vecCodeBookIndices.size(), 1)), matY(matX.rows(), 1);
+  for (int i=0; i<vecCodeBookIndices.size(); ++i)
+    {
+      matX(i,0) = vecCodeBookIndices[i] % iWidth;
+      matY(i,0) = vecCodeBookIndices[i] / iWidth;
+    }
+  d->pXOutput->emitObject(matX);
+  d->pYOutput->emitObject(matY);
+  classificationOutput()->emitObject(toColumnMatrix(vecLabels));
+  return vecLabels;
+}
+
 template <class SampleSet> double PiiSomOperation::Template<SampleSet>::learnOne(double label, double /*weight*/)
 {
   PII_D;
@@ -175,6 +194,22 @@ template <class SampleSet> bool PiiSomOperation::Template<SampleSet>::learnBatch
 {
   PII_D;
   d->pNewClassifier = createSom();
+  if (initMode() == PiiClassification::SomKMeansInit)
+    {
+      // Cluster with the operation's k-means settings. If there are
+      // too few samples, PiiSom falls back to sample initialization.
+      try
+        {
+          d->pNewClassifier->setModels(createCodebook(*d->collector.samples(), width() * height()));
+        }
+      catch (PiiClassificationException& ex)
+        {
+          setLearningError(ex.message());
+          delete d->pNewClassifier;
+          d->pNewClassifier = 0;
+          return false;
+        }
+    }
   bool bSuccess = PiiClassifierOperation::learnBatch(*d->pNewClassifier,
                                                      *d->collector.samples(),
                                                      *d->collector.classLabels());
@@ -40,6 +40,8 @@
  *
  * @out y - the y coordinate of the closest node on the SOM map
  *
+ * In [batchMode], `x` and `y` emit column matrices (PiiMatrix<int>).
+ *
  */
 class PII_CLASSIFICATION_EXPORT PiiSomOperation : public PiiVectorQuantizerOperation
 {
@@ -114,7 +116,10 @@ class PII_CLASSIFICATION_EXPORT PiiSomOperation : public PiiVectorQuantizerOpera
 
   /**
    * Initialization mode. The default value is
-   * `PiiClassification::SomSampleInit`.
+   * `PiiClassification::SomSampleInit`. With
+   * `PiiClassification::SomKMeansInit`, batch learning clusters the
+   * training samples according to [codebookBatchSize] and
+   * [codebookIterations].
    */
   Q_PROPERTY(PiiClassification::SomInitMode initMode READ initMode WRITE setInitMode);
 
@@ -130,6 +130,34 @@ double PiiVectorQuantizerOperation::classify(PiiVectorQuantizer<SampleSet>& clas
   return labelForIndex(iVectorIndex);
 }
 
+template <class SampleSet>
+QVector<double> PiiVectorQuantizerOperation::classifyBatch(PiiVectorQuantizer<SampleSet>& classifier,
+                                                           QVector<int>* vectorIndices,
+                                                           QVector<double>* distances)
+{
+  PII_D;
+  setFeatureBoundaries(classifier);
+
+  QVector<double> vecDistances;
+  PiiClassification::FeatureReader<SampleSet> readFeatures;
+  int iFeatures = classifier.featureCount();
+  QVector<int> vecVectorIndices(classifier.findClosestMatchBatch(readFeatures.readSamples(featureInput(), &iFeatures),
+                                                                 &vecDistances));
+  d->pVectorIndexOutput->emitObject(toColumnMatrix(vecVectorIndices));
+  d->pDistanceOutput->emitObject(toColumnMatrix(vecDistances));
+
+  QVector<double> vecLabels(vecVectorIndices.size());
+  for (int i=0; i<vecVectorIndices.size(); ++i)
+    vecLabels[i] = labelForIndex(vecVectorIndices[i]);
+
+  if (distances != 0)
+    *distances = vecDistances;
+  if (vectorIndices != 0)
+    *vectorIndices = vecVectorIndices;
+
+  return vecLabels;
+}
+
 template <class SampleSet>
 void PiiVectorQuantizerOperation::setModels(PiiVectorQuantizer<SampleSet>& classifier)
 {
@@ -146,3 +174,13 @@ void PiiVectorQuantizerOperation::setModels(PiiVectorQuantizer<SampleSet>& class
   else
     classifier.setModels(PiiSampleSet::create<SampleSet>(0, 0));
 }
+
+template <class SampleSet>
+SampleSet PiiVectorQuantizerOperation::createCodebook(const SampleSet& samples, int size)
+{
+  PII_D;
+  PiiKMeans<SampleSet> kMeans;
+  kMeans.setBatchSize(d->iCodebookBatchSize);
+  kMeans.setMaxIterations(d->iCodebookIterations);
+  return kMeans.cluster(samples, size, this);
+}
@@ -21,7 +21,9 @@ PiiVectorQuantizerOperation::Data::Data(PiiClassification::LearnerCapabilities c
   distanceCombinationMode(PiiClassification::DistanceSum),
   dRejectThreshold(INFINITY),
   bMultiFeatureMeasure(false),
-  bMustConfigureBoundaries(false)
+  bMustConfigureBoundaries(false),
+  iCodebookBatchSize(0),
+  iCodebookIterations(0)
 {
 }
 
@@ -117,3 +119,7 @@ void PiiVectorQuantizerOperation::setDistanceCombinationMode(PiiClassification::
 PiiClassification::DistanceCombinationMode PiiVectorQuantizerOperation::distanceCombinationMode() const { return _d()->distanceCombinationMode; }
 void PiiVectorQuantizerOperation::setClassLabels(const QVariantList& labels) { _d()->vecClassLabels = Pii::variantsToVector<double>(labels); }
 QVariantList PiiVectorQuantizerOperation::classLabels() const { return Pii::vectorToVariants(_d()->vecClassLabels); }
+void PiiVectorQuantizerOperation::setCodebookBatchSize(int codebookBatchSize) { _d()->iCodebookBatchSize = qMax(0, codebookBatchSize); }
+int PiiVectorQuantizerOperation::codebookBatchSize() const { return _d()->iCodebookBatchSize; }
+void PiiVectorQuantizerOperation::setCodebookIterations(int codebookIterations) { _d()->iCodebookIterations = qMax(0, codebookIterations); }
+int PiiVectorQuantizerOperation::codebookIterations() const { return _d()->iCodebookIterations; }
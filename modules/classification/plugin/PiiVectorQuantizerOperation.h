@@ -18,6 +18,7 @@
 
 #include "PiiVectorQuantizer.h"
 #include "PiiMultiFeatureDistance.h"
+#include "PiiKMeans.h"
 #include "PiiClassifierOperation.h"
 
 
@@ -43,6 +44,9 @@
  *
  * @out distance - distance to the closest code vector. (double)
  *
+ * In [batchMode], both outputs emit column matrices
+ * (PiiMatrix<int> and PiiMatrix<double>, respectively).
+ *
  */
 class PII_CLASSIFICATION_EXPORT PiiVectorQuantizerOperation : public PiiClassifierOperation
 {
@@ -126,6 +130,24 @@ class PII_CLASSIFICATION_EXPORT PiiVectorQuantizerOperation : public PiiClassifi
    */
   Q_PROPERTY(QVariantList classLabels READ classLabels WRITE setClassLabels);
 
+  /**
+   * The number of samples in each iteration of mini-batch k-means
+   * when a code book is created by clustering the training samples
+   * (see PiiKMeans). Zero means that all samples are used in every
+   * iteration. Mini-batch clustering is much faster with large
+   * training sets, but the code book will be slightly worse. The
+   * default is zero.
+   */
+  Q_PROPERTY(int codebookBatchSize READ codebookBatchSize WRITE setCodebookBatchSize);
+
+  /**
+   * The maximum number of k-means iterations when a code book is
+   * created by clustering. Zero means that clustering will be run
+   * until convergence, or 100 iterations in mini-batch mode. The
+   * default is zero.
+   */
+  Q_PROPERTY(int codebookIterations READ codebookIterations WRITE setCodebookIterations);
+
 public:
   ~PiiVectorQuantizerOperation();
 
@@ -146,6 +168,8 @@ protected:
     bool bMultiFeatureMeasure;
     bool bMustConfigureBoundaries;
     PiiVariant varModels;
+    int iCodebookBatchSize;
+    int iCodebookIterations;
   };
   PII_D_FUNC;
 
@@ -175,6 +199,12 @@ protected:
   void setClassLabels(const QVariantList& labels);
   QVariantList classLabels() const;
 
+  void setCodebookBatchSize(int codebookBatchSize);
+  int codebookBatchSize() const;
+
+  void setCodebookIterations(int codebookIterations);
+  int codebookIterations() const;
+
   /**
    * Returns a pointer to the `boundary` input.
    */
@@ -242,6 +272,20 @@ protected:
   template <class SampleSet> double classify(PiiVectorQuantizer<SampleSet>& classifier,
                                              int* vectorIndex = 0, double* distance = 0);
 
+  /**
+   * The batch mode version of [classify()]. Reads a batch of features
+   * from the `features` input and finds the closest match for each
+   * with PiiVectorQuantizer::findClosestMatchBatch(). Sends the
+   * indices of and the distances to the closest vectors as column
+   * matrices.
+   *
+   * @exception PiiExecutionException& if the features are of
+   * incorrect type or size.
+   */
+  template <class SampleSet> QVector<double> classifyBatch(PiiVectorQuantizer<SampleSet>& classifier,
+                                                           QVector<int>* vectorIndices = 0,
+                                                           QVector<double>* distances = 0);
+
   /**
    * Returns the class label corresponding to the sample at *index*.
    * If the label list is empty, returns *index* (or `NaN` if
@@ -257,6 +301,18 @@ protected:
    */
   template <class SampleSet> void setModels(PiiVectorQuantizer<SampleSet>& classifier);
 
+  /**
+   * Creates a code book of *size* vectors by clustering *samples*
+   * with PiiKMeans, configured with [codebookBatchSize] and
+   * [codebookIterations]. The operation itself acts as the progress
+   * controller. Returns an empty sample set if there are less than
+   * *size* samples.
+   *
+   * @exception PiiClassificationException& if clustering was
+   * interrupted.
+   */
+  template <class SampleSet> SampleSet createCodebook(const SampleSet& samples, int size);
+
 private:
   void init();
 };
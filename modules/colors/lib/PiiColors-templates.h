@@ -330,8 +330,94 @@ namespace PiiColors
 #undef PII_LAB_F
 
     return Clr(116*yPerYn - 16,
-               500*xPerXn - yPerYn,
-               200*yPerYn - zPerZn);
+               500*(xPerXn - yPerYn),
+               200*(yPerYn - zPerZn));
+  }
+
+  /// @hide
+  inline float labFunction(float t)
+  {
+    return t > 0.008856451679035631f ? Pii::pow(t, 1.0f/3) : 7.787037037037036f*t + 16.0f/116;
+  }
+
+  // Tabulates labFunction() in [0, maximum] and interpolates
+  // linearly between the entries. Values outside of the range are
+  // calculated exactly.
+  class LabFunctionTable
+  {
+  public:
+    LabFunctionTable(int size, float maximum) :
+      _matTable(PiiMatrix<float>::uninitialized(1, size + 2)),
+      _fMaximum(maximum),
+      _fScale(size / maximum)
+    {
+      float* pTable = _matTable[0];
+      for (int i=0; i<=size; ++i)
+        pTable[i] = labFunction(i / _fScale);
+      // Guards against rounding at the upper end.
+      pTable[size+1] = pTable[size];
+    }
+
+    float operator() (float t) const
+    {
+      if (t < 0 || t >= _fMaximum)
+        return labFunction(t);
+      const float fPosition = t * _fScale;
+      const int i = int(fPosition);
+      const float* pTable = _matTable[0] + i;
+      return pTable[0] + (fPosition - i) * (pTable[1] - pTable[0]);
+    }
+
+  private:
+    PiiMatrix<float> _matTable;
+    float _fMaximum, _fScale;
+  };
+
+  template <class Clr, class Function>
+  PiiMatrix<PiiColor<float> > rgbToLab(const PiiMatrix<Clr>& image, const float* conversion, Function f)
+  {
+    const int iRows = image.rows(), iCols = image.columns();
+    PiiMatrix<PiiColor<float> > matResult(PiiMatrix<PiiColor<float> >::uninitialized(iRows, iCols));
+    for (int r=0; r<iRows; ++r)
+      {
+        const Clr* pSource = image[r];
+        PiiColor<float>* pTarget = matResult[r];
+        for (int c=0; c<iCols; ++c)
+          {
+            const float f0 = pSource[c].c0, f1 = pSource[c].c1, f2 = pSource[c].c2;
+            const float fx = f(conversion[0] * f0 + conversion[1] * f1 + conversion[2] * f2);
+            const float fy = f(conversion[3] * f0 + conversion[4] * f1 + conversion[5] * f2);
+            const float fz = f(conversion[6] * f0 + conversion[7] * f1 + conversion[8] * f2);
+            pTarget[c] = PiiColor<float>(116*fy - 16, 500*(fx - fy), 200*(fy - fz));
+          }
+      }
+    return matResult;
+  }
+  /// @endhide
+
+  template <class Clr> PiiMatrix<PiiColor<float> > rgbToLab(const PiiMatrix<Clr>& image,
+                                                            const PiiMatrix<float>& conversion,
+                                                            const PiiColor<float>& whitePoint,
+                                                            int tableSize)
+  {
+    // Divide by the white point already in the conversion matrix.
+    float aConversion[9];
+    const float aWhite[3] = { whitePoint.c0, whitePoint.c1, whitePoint.c2 };
+    float fMaximum = 0;
+    for (int r=0; r<3; ++r)
+      {
+        float fRowMaximum = 0;
+        for (int c=0; c<3; ++c)
+          {
+            aConversion[r*3+c] = conversion(r,c) / aWhite[r];
+            fRowMaximum += qMax(0.0f, aConversion[r*3+c]);
+          }
+        fMaximum = qMax(fMaximum, fRowMaximum * float(PiiImage::Traits<typename Clr::Type>::max()));
+      }
+
+    if (tableSize <= 0 || fMaximum <= 0)
+      return rgbToLab(image, aConversion, labFunction);
+    return rgbToLab(image, aConversion, LabFunctionTable(tableSize, fMaximum));
   }
 
   template <class Clr> Clr labToXyz(const Clr& labColor,
@@ -15,6 +15,332 @@
 
 #include "PiiColors.h"
 
+#include <cstring>
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+namespace
+{
+  // The 8-bit conversions process images in chunks of this many
+  // pixels. The channels of a chunk are first split into planar
+  // buffers, converted with vector instructions and then assembled
+  // back to colors.
+  const int iChunkSize = 256;
+
+  template <class Color> void splitChannels(const Color* colors, int count,
+                                            short* red, short* green, short* blue)
+  {
+    for (int i=0; i<count; ++i)
+      {
+        red[i] = colors[i].c0;
+        green[i] = colors[i].c1;
+        blue[i] = colors[i].c2;
+      }
+    // Pad to full vectors
+    for (int i=count; i<((count + 15) & ~15); ++i)
+      red[i] = green[i] = blue[i] = 0;
+  }
+
+  void splitChannels(const PiiColor4<unsigned char>* colors, int count,
+                     short* red, short* green, short* blue)
+  {
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i mask = _mm_set1_epi32(0xff);
+    for (; i<=count-8; i+=8)
+      {
+        const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(colors + i));
+        const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(colors + i + 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(blue + i),
+                         _mm_packs_epi32(_mm_and_si128(low, mask), _mm_and_si128(high, mask)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(green + i),
+                         _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(low, 8), mask),
+                                         _mm_and_si128(_mm_srli_epi32(high, 8), mask)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(red + i),
+                         _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(low, 16), mask),
+                                         _mm_and_si128(_mm_srli_epi32(high, 16), mask)));
+      }
+#endif
+    splitChannels<PiiColor4<unsigned char> >(colors + i, count - i, red + i, green + i, blue + i);
+  }
+
+  template <class Color> void joinChannels(const unsigned char* c0, const unsigned char* c1,
+                                           const unsigned char* c2, int count, Color* colors)
+  {
+    for (int i=0; i<count; ++i)
+      colors[i] = Color(c0[i], c1[i], c2[i]);
+  }
+
+  void joinChannels(const unsigned char* c0, const unsigned char* c1, const unsigned char* c2,
+                    int count, PiiColor4<unsigned char>* colors)
+  {
+    int i = 0;
+#ifdef __SSE2__
+    // PiiColor4 is stored as c2,c1,c0,c3 in memory.
+    const __m128i zero = _mm_setzero_si128();
+    for (; i<=count-16; i+=16)
+      {
+        const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c0 + i));
+        const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c1 + i));
+        const __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c2 + i));
+        const __m128i low21 = _mm_unpacklo_epi8(v2, v1), high21 = _mm_unpackhi_epi8(v2, v1);
+        const __m128i low03 = _mm_unpacklo_epi8(v0, zero), high03 = _mm_unpackhi_epi8(v0, zero);
+        __m128i* pTarget = reinterpret_cast<__m128i*>(colors + i);
+        _mm_storeu_si128(pTarget, _mm_unpacklo_epi16(low21, low03));
+        _mm_storeu_si128(pTarget + 1, _mm_unpackhi_epi16(low21, low03));
+        _mm_storeu_si128(pTarget + 2, _mm_unpacklo_epi16(high21, high03));
+        _mm_storeu_si128(pTarget + 3, _mm_unpackhi_epi16(high21, high03));
+      }
+#endif
+    for (; i<count; ++i)
+      colors[i] = PiiColor4<unsigned char>(c0[i], c1[i], c2[i]);
+  }
+
+#ifdef __SSE2__
+#  define PII_LOAD(PTR) _mm_loadu_si128(reinterpret_cast<const __m128i*>(PTR))
+#  define PII_STORE(PTR, VALUE) _mm_storeu_si128(reinterpret_cast<__m128i*>(PTR), VALUE)
+
+  // Rounds half away from zero like Pii::round(). The input must be
+  // small enough not to lose the fraction when 0.5 is added.
+  inline __m128i roundToInt(__m128 value)
+  {
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128i sign = _mm_srai_epi32(_mm_castps_si128(value), 31);
+    const __m128i magnitude = _mm_cvttps_epi32(_mm_add_ps(_mm_andnot_ps(signMask, value), _mm_set1_ps(0.5f)));
+    return _mm_sub_epi32(_mm_xor_si128(magnitude, sign), sign);
+  }
+
+  inline __m128i packToBytes(__m128i a, __m128i b)
+  {
+    return _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_setzero_si128());
+  }
+
+  // Converts 8 colors stored as 16-bit integers to HSV exactly like
+  // PiiColors::rgbToHsv(). The float operations are the same as in
+  // the scalar version, in the same order.
+  void rgbToHsv8(const short* red, const short* green, const short* blue,
+                 unsigned char* h, unsigned char* s, unsigned char* v)
+  {
+    const __m128i r = PII_LOAD(red), g = PII_LOAD(green), b = PII_LOAD(blue), zero = _mm_setzero_si128();
+    const __m128i max = _mm_max_epi16(r, _mm_max_epi16(g, b));
+    const __m128i delta = _mm_sub_epi16(max, _mm_min_epi16(r, _mm_min_epi16(g, b)));
+    const __m128i redMax = _mm_cmpeq_epi16(r, max);
+    const __m128i greenMax = _mm_andnot_si128(redMax, _mm_cmpeq_epi16(g, max));
+    const __m128i blueMax = _mm_andnot_si128(_mm_or_si128(redMax, greenMax), _mm_cmpeq_epi16(max, max));
+    const __m128i diff = _mm_or_si128(_mm_or_si128(_mm_and_si128(redMax, _mm_sub_epi16(g, b)),
+                                                   _mm_and_si128(greenMax, _mm_sub_epi16(b, r))),
+                                      _mm_and_si128(blueMax, _mm_sub_epi16(r, g)));
+    const __m128i gray = _mm_cmpeq_epi16(delta, zero);
+
+    __m128i aiHue[2], aiSaturation[2];
+    for (int i=0; i<2; ++i)
+      {
+        // Sign-extend to 32 bits
+        __m128i iDiff = i == 0 ? _mm_unpacklo_epi16(diff, diff) : _mm_unpackhi_epi16(diff, diff);
+        iDiff = _mm_srai_epi32(iDiff, 16);
+        const __m128i iDelta = i == 0 ? _mm_unpacklo_epi16(delta, zero) : _mm_unpackhi_epi16(delta, zero);
+        const __m128i iMax = i == 0 ? _mm_unpacklo_epi16(max, zero) : _mm_unpackhi_epi16(max, zero);
+        const __m128i iGreenMax = i == 0 ? _mm_unpacklo_epi16(greenMax, greenMax) : _mm_unpackhi_epi16(greenMax, greenMax);
+        const __m128i iBlueMax = i == 0 ? _mm_unpacklo_epi16(blueMax, blueMax) : _mm_unpackhi_epi16(blueMax, blueMax);
+        const __m128 offset = _mm_or_ps(_mm_and_ps(_mm_castsi128_ps(iGreenMax), _mm_set1_ps(256.0f/3)),
+                                        _mm_and_ps(_mm_castsi128_ps(iBlueMax), _mm_set1_ps(2*256.0f/3)));
+        const __m128 fDelta = _mm_cvtepi32_ps(iDelta);
+        aiHue[i] = roundToInt(_mm_add_ps(offset, _mm_div_ps(_mm_mul_ps(_mm_set1_ps(256.0f/6),
+                                                                       _mm_cvtepi32_ps(iDiff)),
+                                                            fDelta)));
+        aiSaturation[i] = roundToInt(_mm_div_ps(_mm_mul_ps(_mm_set1_ps(255.0f), fDelta),
+                                                _mm_cvtepi32_ps(iMax)));
+      }
+    // Negative hues wrap around like in a cast to unsigned char. Gray
+    // colors (including black) have zero hue and saturation.
+    const __m128i byteMask = _mm_set1_epi16(0xff);
+    __m128i hue = _mm_and_si128(_mm_packs_epi32(_mm_and_si128(aiHue[0], _mm_set1_epi32(0xff)),
+                                                _mm_and_si128(aiHue[1], _mm_set1_epi32(0xff))), byteMask);
+    __m128i saturation = _mm_packs_epi32(aiSaturation[0], aiSaturation[1]);
+    hue = _mm_andnot_si128(gray, hue);
+    saturation = _mm_andnot_si128(gray, saturation);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(h), _mm_packus_epi16(hue, zero));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(s), _mm_packus_epi16(saturation, zero));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(v), _mm_packus_epi16(max, zero));
+  }
+
+  // Rounds and bounds a Y'CbCr channel like PiiColors::roundYcbcr()
+  // with 255 as the maximum.
+  inline __m128i roundYcbcr(__m128d low, __m128d high)
+  {
+    const __m128d half = _mm_set1_pd(0.5);
+    return _mm_unpacklo_epi64(_mm_cvttpd_epi32(_mm_add_pd(low, half)),
+                              _mm_cvttpd_epi32(_mm_add_pd(high, half)));
+  }
+
+  // Converts 8 colors to Y'CbCr. Calculations are done in double
+  // precision to reproduce PiiColors::rgbToYcbcr() exactly.
+  void rgbToYcbcr8(const short* red, const short* green, const short* blue,
+                   unsigned char* y, unsigned char* cb, unsigned char* cr)
+  {
+    const __m128i r = PII_LOAD(red), g = PII_LOAD(green), b = PII_LOAD(blue), zero = _mm_setzero_si128();
+    __m128i aiResults[3][2];
+    for (int i=0; i<2; ++i)
+      {
+        const __m128i ir = i == 0 ? _mm_unpacklo_epi16(r, zero) : _mm_unpackhi_epi16(r, zero);
+        const __m128i ig = i == 0 ? _mm_unpacklo_epi16(g, zero) : _mm_unpackhi_epi16(g, zero);
+        const __m128i ib = i == 0 ? _mm_unpacklo_epi16(b, zero) : _mm_unpackhi_epi16(b, zero);
+        __m128d adY[2], adPb[2], adPr[2];
+        for (int j=0; j<2; ++j)
+          {
+            const __m128d dr = _mm_cvtepi32_pd(j == 0 ? ir : _mm_srli_si128(ir, 8));
+            const __m128d dg = _mm_cvtepi32_pd(j == 0 ? ig : _mm_srli_si128(ig, 8));
+            const __m128d db = _mm_cvtepi32_pd(j == 0 ? ib : _mm_srli_si128(ib, 8));
+            // rgbToY709() returns a float
+            adY[j] = _mm_cvtps_pd(_mm_cvtpd_ps(_mm_add_pd(_mm_add_pd(_mm_mul_pd(dr, _mm_set1_pd(0.2126)),
+                                                                    _mm_mul_pd(dg, _mm_set1_pd(0.7152))),
+                                                         _mm_mul_pd(db, _mm_set1_pd(0.0722)))));
+            adPb[j] = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(0.53890924768269023496), _mm_sub_pd(db, adY[j])),
+                                 _mm_set1_pd(127.5));
+            adPr[j] = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(0.63500127000254000508), _mm_sub_pd(dr, adY[j])),
+                                 _mm_set1_pd(127.5));
+          }
+        aiResults[0][i] = roundYcbcr(adY[0], adY[1]);
+        aiResults[1][i] = roundYcbcr(adPb[0], adPb[1]);
+        aiResults[2][i] = roundYcbcr(adPr[0], adPr[1]);
+      }
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(y), packToBytes(aiResults[0][0], aiResults[0][1]));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(cb), packToBytes(aiResults[1][0], aiResults[1][1]));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(cr), packToBytes(aiResults[2][0], aiResults[2][1]));
+  }
+
+  // Converts 8 pixels (16 bytes) of YUV 4:2:2 data to RGB. The
+  // results match PiiColors::yuvToRgb().
+  void yuv422ToRgb8(const unsigned char* yuv, unsigned char* red, unsigned char* green, unsigned char* blue)
+  {
+    const __m128i data = PII_LOAD(yuv), zero = _mm_setzero_si128();
+    const __m128i y = _mm_and_si128(data, _mm_set1_epi16(0xff));
+    // u0 v0 u1 v1 ... as 16-bit integers
+    const __m128i uv = _mm_sub_epi16(_mm_srli_epi16(data, 8), _mm_set1_epi16(128));
+    __m128i aiResults[3][2];
+    for (int i=0; i<2; ++i)
+      {
+        // Each u,v pair is shared by two pixels.
+        const __m128i iuv = i == 0 ? _mm_unpacklo_epi32(uv, uv) : _mm_unpackhi_epi32(uv, uv);
+        const __m128 u = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(iuv, 16), 16));
+        const __m128 v = _mm_cvtepi32_ps(_mm_srai_epi32(iuv, 16));
+        const __m128 fy = _mm_cvtepi32_ps(i == 0 ? _mm_unpacklo_epi16(y, zero) : _mm_unpackhi_epi16(y, zero));
+        aiResults[0][i] = _mm_cvttps_epi32(_mm_add_ps(fy, _mm_mul_ps(_mm_set1_ps(1.370705f), v)));
+        aiResults[1][i] = _mm_cvttps_epi32(_mm_sub_ps(_mm_sub_ps(fy, _mm_mul_ps(_mm_set1_ps(0.698001f), v)),
+                                                      _mm_mul_ps(_mm_set1_ps(0.337633f), u)));
+        aiResults[2][i] = _mm_cvttps_epi32(_mm_add_ps(fy, _mm_mul_ps(_mm_set1_ps(1.732446f), u)));
+      }
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(red), packToBytes(aiResults[0][0], aiResults[0][1]));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(green), packToBytes(aiResults[1][0], aiResults[1][1]));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(blue), packToBytes(aiResults[2][0], aiResults[2][1]));
+  }
+
+  // Calculates the mean of the color channels of 8 pixels. x/3
+  // equals (x * 0xaaab) >> 17 for all sums of three bytes.
+  void grayMean8(const PiiColor4<unsigned char>* colors, unsigned char* gray)
+  {
+    const __m128i mask = _mm_set1_epi32(0xff);
+    __m128i aiSums[2];
+    for (int i=0; i<2; ++i)
+      {
+        const __m128i data = PII_LOAD(colors + 4*i);
+        aiSums[i] = _mm_add_epi32(_mm_add_epi32(_mm_and_si128(data, mask),
+                                                _mm_and_si128(_mm_srli_epi32(data, 8), mask)),
+                                  _mm_and_si128(_mm_srli_epi32(data, 16), mask));
+      }
+    const __m128i mean = _mm_srli_epi16(_mm_mulhi_epu16(_mm_packs_epi32(aiSums[0], aiSums[1]),
+                                                        _mm_set1_epi16(short(0xaaab))), 1);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(gray), _mm_packus_epi16(mean, mean));
+  }
+
+#  undef PII_LOAD
+#  undef PII_STORE
+
+  template <class Color> PiiMatrix<Color> rgbToHsvFast(const PiiMatrix<Color>& image)
+  {
+    const int iRows = image.rows(), iCols = image.columns();
+    PiiMatrix<Color> matResult(PiiMatrix<Color>::uninitialized(iRows, iCols));
+    short aRed[iChunkSize+16], aGreen[iChunkSize+16], aBlue[iChunkSize+16];
+    unsigned char aH[iChunkSize], aS[iChunkSize], aV[iChunkSize];
+    for (int r=0; r<iRows; ++r)
+      for (int c=0; c<iCols; c+=iChunkSize)
+        {
+          const int iCount = qMin(iChunkSize, iCols - c);
+          splitChannels(image[r] + c, iCount, aRed, aGreen, aBlue);
+          for (int i=0; i<iCount; i+=8)
+            rgbToHsv8(aRed + i, aGreen + i, aBlue + i, aH + i, aS + i, aV + i);
+          joinChannels(aH, aS, aV, iCount, matResult[r] + c);
+        }
+    return matResult;
+  }
+
+  template <class Color> PiiMatrix<Color> rgbToYcbcrFast(const PiiMatrix<Color>& image)
+  {
+    const int iRows = image.rows(), iCols = image.columns();
+    PiiMatrix<Color> matResult(PiiMatrix<Color>::uninitialized(iRows, iCols));
+    short aRed[iChunkSize+16], aGreen[iChunkSize+16], aBlue[iChunkSize+16];
+    unsigned char aY[iChunkSize], aCb[iChunkSize], aCr[iChunkSize];
+    for (int r=0; r<iRows; ++r)
+      for (int c=0; c<iCols; c+=iChunkSize)
+        {
+          const int iCount = qMin(iChunkSize, iCols - c);
+          splitChannels(image[r] + c, iCount, aRed, aGreen, aBlue);
+          for (int i=0; i<iCount; i+=8)
+            rgbToYcbcr8(aRed + i, aGreen + i, aBlue + i, aY + i, aCb + i, aCr + i);
+          joinChannels(aY, aCb, aCr, iCount, matResult[r] + c);
+        }
+    return matResult;
+  }
+
+  PiiMatrix<unsigned char> rgbToGrayMeanFast(const PiiMatrix<PiiColor4<unsigned char> >& image)
+  {
+    const int iRows = image.rows(), iCols = image.columns();
+    PiiMatrix<unsigned char> matResult(PiiMatrix<unsigned char>::uninitialized(iRows, iCols));
+    for (int r=0; r<iRows; ++r)
+      {
+        const PiiColor4<unsigned char>* pSource = image[r];
+        unsigned char* pTarget = matResult[r];
+        int c = 0;
+        for (; c<=iCols-8; c+=8)
+          grayMean8(pSource + c, pTarget + c);
+        for (; c<iCols; ++c)
+          pTarget[c] = (unsigned char)((int(pSource[c].c0) + pSource[c].c1 + pSource[c].c2) / 3);
+      }
+    return matResult;
+  }
+
+  template <class Color> void yuv422toRgbFast(const unsigned char* yuvData, Color* rgbData, int width, int height)
+  {
+    const int iPixels = width * height;
+    unsigned char aRed[iChunkSize], aGreen[iChunkSize], aBlue[iChunkSize];
+    int i = 0;
+    for (; i<=iPixels-iChunkSize; i+=iChunkSize)
+      {
+        for (int j=0; j<iChunkSize; j+=8)
+          yuv422ToRgb8(yuvData + 2*(i+j), aRed + j, aGreen + j, aBlue + j);
+        joinChannels(aRed, aGreen, aBlue, iChunkSize, rgbData + i);
+      }
+    // Leftover pixel pairs
+    for (; i<iPixels-1; i+=2)
+      {
+        const int iU = yuvData[2*i+1] - 128, iV = yuvData[2*i+3] - 128;
+        rgbData[i] = rgbData[i+1] = Color();
+        PiiColors::yuvToRgb(rgbData[i], yuvData[2*i], iU, iV);
+        PiiColors::yuvToRgb(rgbData[i+1], yuvData[2*i+2], iU, iV);
+      }
+    // An odd pixel at the end has no V component.
+    if (i < iPixels)
+      {
+        rgbData[i] = Color();
+        PiiColors::yuvToRgb(rgbData[i], yuvData[2*i], yuvData[2*i+1] - 128, 0);
+      }
+  }
+#endif
+}
+
+
 namespace PiiColors
 {
   PiiMatrix<float> ohtaKanadeMatrix(3,3,
@@ -235,4 +561,67 @@ namespace PiiColors
       }
     return matCorrelogram;
   }
+
+  PiiMatrix<PiiColor<unsigned char> > rgbToHsv(const PiiMatrix<PiiColor<unsigned char> >& rgbColorImage)
+  {
+#ifdef __SSE2__
+    return rgbToHsvFast(rgbColorImage);
+#else
+    return Pii::matrix(rgbColorImage.mapped(RgbToHsv<PiiColor<unsigned char> >()));
+#endif
+  }
+
+  PiiMatrix<PiiColor4<unsigned char> > rgbToHsv(const PiiMatrix<PiiColor4<unsigned char> >& rgbColorImage)
+  {
+#ifdef __SSE2__
+    return rgbToHsvFast(rgbColorImage);
+#else
+    return Pii::matrix(rgbColorImage.mapped(RgbToHsv<PiiColor4<unsigned char> >()));
+#endif
+  }
+
+  PiiMatrix<PiiColor<unsigned char> > rgbToYcbcr(const PiiMatrix<PiiColor<unsigned char> >& image, double maximum)
+  {
+#ifdef __SSE2__
+    if (maximum == 255)
+      return rgbToYcbcrFast(image);
+#endif
+    return Pii::matrix(image.mapped(RgbToYcbcr<PiiColor<unsigned char> >(maximum)));
+  }
+
+  PiiMatrix<PiiColor4<unsigned char> > rgbToYcbcr(const PiiMatrix<PiiColor4<unsigned char> >& image, double maximum)
+  {
+#ifdef __SSE2__
+    if (maximum == 255)
+      return rgbToYcbcrFast(image);
+#endif
+    return Pii::matrix(image.mapped(RgbToYcbcr<PiiColor4<unsigned char> >(maximum)));
+  }
+
+  PiiMatrix<unsigned char> rgbToGrayMean(const PiiMatrix<PiiColor4<unsigned char> >& image)
+  {
+#ifdef __SSE2__
+    return rgbToGrayMeanFast(image);
+#else
+    return Pii::matrix(image.mapped(RgbToGrayMean<PiiColor4<unsigned char> >()));
+#endif
+  }
+
+  void yuv422toRgb(const unsigned char* yuvData, PiiColor<unsigned char>* rgbData, int width, int height)
+  {
+#ifdef __SSE2__
+    yuv422toRgbFast(yuvData, rgbData, width, height);
+#else
+    yuv422toRgb<PiiColor<unsigned char> >(yuvData, rgbData, width, height);
+#endif
+  }
+
+  void yuv422toRgb(const unsigned char* yuvData, PiiColor4<unsigned char>* rgbData, int width, int height)
+  {
+#ifdef __SSE2__
+    yuv422toRgbFast(yuvData, rgbData, width, height);
+#else
+    yuv422toRgb<PiiColor4<unsigned char> >(yuvData, rgbData, width, height);
+#endif
+  }
 }
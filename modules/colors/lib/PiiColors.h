@@ -524,6 +524,18 @@ namespace PiiColors
     return Pii::matrix(rgbColorImage.mapped(RgbToHsv<Clr>()));
   }
 
+  /**
+   * Same as above, but specialized for 8-bit colors. If SSE2 is
+   * available, eight pixels are converted at a time. The result is
+   * identical to that of the generic version.
+   */
+  PII_COLORS_EXPORT PiiMatrix<PiiColor<unsigned char> > rgbToHsv(const PiiMatrix<PiiColor<unsigned char> >& rgbColorImage);
+  /**
+   * Same as above, but for four-channel colors. The fourth channel
+   * of the result will be zero.
+   */
+  PII_COLORS_EXPORT PiiMatrix<PiiColor4<unsigned char> > rgbToHsv(const PiiMatrix<PiiColor4<unsigned char> >& rgbColorImage);
+
   /**
    * Convert an HSV color image into an RGB color image.
    *
@@ -635,6 +647,44 @@ namespace PiiColors
     return Pii::matrix(labColorImage.mapped(LabToXyz<Clr>(), whitePoint));
   }
 
+  /**
+   * Convert an RGB image to CIE L*a*b*. The colors are first
+   * converted to XYZ by multiplying them with *conversion* (see
+   * [genericConversion()]) and then to L*a*b* as in
+   * [xyzToLab()].
+   *
+   * Most of the time in the L*a*b* transform goes to calculating cube
+   * roots. If *tableSize* is positive, the non-linear part of the
+   * transform is tabulated in *tableSize* steps between zero and the
+   * largest value the input type can produce, and linearly
+   * interpolated between the steps. The table is built once per call,
+   * which makes the approximation worthwhile for anything larger than
+   * a thumbnail. With the default table size, the error in L*, a*
+   * and b* is typically below 0.01 for 8-bit input. If *tableSize* is
+   * zero, the exact transform is used.
+   *
+   * @param image an RGB image
+   *
+   * @param conversion a 3-by-3 matrix that converts RGB to XYZ, for
+   * example [d65_709_XyzMatrix].
+   *
+   * @param whitePoint the XYZ coordinates of the white point. Must
+   * not have zero channels.
+   *
+   * @param tableSize the number of steps in the lookup table.
+   *
+   * ~~~(c++)
+   * PiiMatrix<PiiColor<> > rgbImage;
+   * PiiMatrix<PiiColor<float> > labImage =
+   *   PiiColors::rgbToLab(rgbImage, PiiColors::d65_709_XyzMatrix,
+   *                       PiiColor<float>(95.05, 100, 108.88));
+   * ~~~
+   */
+  template <class Clr> PiiMatrix<PiiColor<float> > rgbToLab(const PiiMatrix<Clr>& image,
+                                                            const PiiMatrix<float>& conversion,
+                                                            const PiiColor<float>& whitePoint,
+                                                            int tableSize = 4096);
+
   /**
    * Convert a color in a *non*-linear RGB color space to luminance
    * as defined in ITU-R BT.709: \(Y_{709} = 0.2126R' + 0.7152G' +
@@ -665,6 +715,33 @@ namespace PiiColors
     return Pii::matrix(clrImage.mapped(RgbToY709<Clr>()));
   }
 
+  /**
+   * An adaptable unary function that calculates the mean of the
+   * three color channels. Integer means are rounded down.
+   */
+  template <class Clr> struct RgbToGrayMean : Pii::UnaryFunction<Clr, typename Clr::Type>
+  {
+    typedef typename Clr::Type T;
+    typedef typename Pii::IfClass<Pii::IsFloatingPoint<T>, T, int>::Type SumType;
+    T operator() (const Clr& clr) const { return T((SumType(clr.c0) + SumType(clr.c1) + SumType(clr.c2)) / 3); }
+  };
+
+  /**
+   * Convert a color image to a gray-level image by taking the mean of
+   * the three color channels. The type of the result equals the type
+   * of the color channels.
+   */
+  template <class Clr> inline PiiMatrix<typename Clr::Type> rgbToGrayMean(const PiiMatrix<Clr>& clrImage)
+  {
+    return Pii::matrix(clrImage.mapped(RgbToGrayMean<Clr>()));
+  }
+
+  /**
+   * Same as above, but specialized for 8-bit four-channel colors,
+   * which are processed eight pixels at a time if SSE2 is available.
+   */
+  PII_COLORS_EXPORT PiiMatrix<unsigned char> rgbToGrayMean(const PiiMatrix<PiiColor4<unsigned char> >& clrImage);
+
   /**
    * Convert a *non*-linear (gamma-adjusted) RGB color into Y'PbPr.
    * Y'PbPr is the analog counterpart of Y'CbCr. The color channels in
@@ -833,6 +910,21 @@ namespace PiiColors
     return Pii::matrix(image.mapped(RgbToYcbcr<T>(maximum)));
   }
 
+  /**
+   * Same as above, but specialized for 8-bit colors. If SSE2 is
+   * available and *maximum* is 255, the conversion is performed
+   * eight pixels at a time in double precision, which makes the
+   * result identical to that of the generic version.
+   */
+  PII_COLORS_EXPORT PiiMatrix<PiiColor<unsigned char> > rgbToYcbcr(const PiiMatrix<PiiColor<unsigned char> >& image,
+                                                                   double maximum = 255);
+  /**
+   * Same as above, but for four-channel colors. The fourth channel
+   * of the result will be zero.
+   */
+  PII_COLORS_EXPORT PiiMatrix<PiiColor4<unsigned char> > rgbToYcbcr(const PiiMatrix<PiiColor4<unsigned char> >& image,
+                                                                    double maximum = 255);
+
   /**
    * An adaptable unary function for converting from Y'CbCr to
    * non-linear RGB.
@@ -896,6 +988,20 @@ namespace PiiColors
   template <class Color>
   void yuv422toRgb(const typename Color::value_type *yuvData, Color* rgbData, int width, int height);
 
+  /**
+   * Convert 8-bit YUV 4:2:2 data to RGB. This function produces the
+   * same result as the generic version, but converts eight pixels at
+   * a time if SSE2 is available. The fourth channel of PiiColor4 is
+   * set to zero.
+   */
+  PII_COLORS_EXPORT void yuv422toRgb(const unsigned char* yuvData, PiiColor<unsigned char>* rgbData,
+                                     int width, int height);
+  /**
+   * Same as above, but for four-channel colors.
+   */
+  PII_COLORS_EXPORT void yuv422toRgb(const unsigned char* yuvData, PiiColor4<unsigned char>* rgbData,
+                                     int width, int height);
+
   template <class Color>
   PiiMatrix<Color> yuv411toRgb(const typename Color::value_type *yuvData, int width, int height)
   {
@@ -19,10 +19,111 @@
 
 #include <PiiYdinTypes.h>
 #include <PiiMath.h>
+#include <PiiImage.h>
+
+namespace
+{
+  // Adapters that let PiiImage::processInBands() call conversion
+  // functions with one band of an image at a time.
+  template <class U, class T> class ConversionBand
+  {
+  public:
+    typedef U result_type;
+    typedef PiiMatrix<U> (*Function)(const PiiMatrix<T>&);
+    ConversionBand(Function function) : _function(function) {}
+    PiiMatrix<U> operator() (const PiiMatrix<T>& band) const { return _function(band); }
+  private:
+    Function _function;
+  };
+
+  template <class U, class T, class Arg> class BoundConversionBand
+  {
+  public:
+    typedef U result_type;
+    typedef PiiMatrix<U> (*Function)(const PiiMatrix<T>&, Arg);
+    BoundConversionBand(Function function, Arg arg) : _function(function), _arg(arg) {}
+    PiiMatrix<U> operator() (const PiiMatrix<T>& band) const { return _function(band, _arg); }
+  private:
+    Function _function;
+    Arg _arg;
+  };
+
+  template <class U, class T> class GammaBand
+  {
+  public:
+    typedef U result_type;
+    GammaBand(double gamma, double maximum) : _dGamma(gamma), _dMaximum(maximum) {}
+    PiiMatrix<U> operator() (const PiiMatrix<T>& band) const { return PiiColors::correctGamma(band, _dGamma, _dMaximum); }
+  private:
+    double _dGamma, _dMaximum;
+  };
+
+  template <class T> class RgbToLabBand
+  {
+  public:
+    typedef PiiColor<float> result_type;
+    RgbToLabBand(const PiiMatrix<float>& conversion, const PiiColor<float>& whitePoint, int tableSize) :
+      _matConversion(conversion), _clrWhitePoint(whitePoint), _iTableSize(tableSize)
+    {}
+    PiiMatrix<result_type> operator() (const PiiMatrix<T>& band) const
+    {
+      return PiiColors::rgbToLab(band, _matConversion, _clrWhitePoint, _iTableSize);
+    }
+  private:
+    PiiMatrix<float> _matConversion;
+    PiiColor<float> _clrWhitePoint;
+    int _iTableSize;
+  };
+
+  template <class T, class UnaryFunction> class SumColorsBand
+  {
+  public:
+    typedef typename UnaryFunction::result_type result_type;
+    SumColorsBand(UnaryFunction func) : _func(func) {}
+    PiiMatrix<result_type> operator() (const PiiMatrix<T>& image) const
+    {
+      typedef result_type U;
+      PiiMatrix<U> matResult(PiiMatrix<U>::uninitialized(image.rows(), image.columns()));
+
+      const int iCols = image.columns(), iRows = image.rows();
+      for (int r=0; r<iRows; ++r)
+        {
+          const T* pInputRow = image[r];
+          U* pOutputRow = matResult[r];
+          for (int c=0; c<iCols; ++c)
+            pOutputRow[c] = _func(U(pInputRow[c].channels[0]) +
+                                  U(pInputRow[c].channels[1]) +
+                                  U(pInputRow[c].channels[2]));
+        }
+      return matResult;
+    }
+  private:
+    UnaryFunction _func;
+  };
+
+  template <class U, class T> inline ConversionBand<U,T> conversionBand(PiiMatrix<U> (*function)(const PiiMatrix<T>&))
+  {
+    return ConversionBand<U,T>(function);
+  }
+
+  template <class U, class T, class Arg>
+  inline BoundConversionBand<U,T,Arg> conversionBand(PiiMatrix<U> (*function)(const PiiMatrix<T>&, Arg), Arg arg)
+  {
+    return BoundConversionBand<U,T,Arg>(function, arg);
+  }
+
+  template <class T, class UnaryFunction> inline SumColorsBand<T,UnaryFunction> sumColorsBand(const PiiMatrix<T>&,
+                                                                                                 UnaryFunction func)
+  {
+    return SumColorsBand<T,UnaryFunction>(func);
+  }
+}
 
 PiiColorConverter::Data::Data() :
   colorConversion(GenericConversion),
-  dGamma(1.0/2.2)
+  dGamma(1.0/2.2),
+  iTileThreads(1),
+  iLabTableSize(4096)
 {
 }
 
@@ -87,8 +188,7 @@ void PiiColorConverter::process()
 
 template <class T> void PiiColorConverter::correctGamma(const PiiVariant& obj)
 {
-  emitObject(PiiColors::correctGamma(obj.valueAs<PiiMatrix<T> >(), _d()->dGamma,
-                                     PiiImage::Traits<T>::max()));
+  emitInBands(obj.valueAs<PiiMatrix<T> >(), GammaBand<T,T>(_d()->dGamma, PiiImage::Traits<T>::max()));
 }
 
 template <class Clr> void PiiColorConverter::convertImage(const PiiVariant& obj)
@@ -96,81 +196,76 @@ template <class Clr> void PiiColorConverter::convertImage(const PiiVariant& obj)
   PII_D;
   const PiiMatrix<Clr> image = obj.valueAs<PiiMatrix<Clr> >();
   typedef typename SumTraits<typename Clr::Type>::Type SumType;
+  typedef typename Clr::Type T;
+  typedef PiiColor<float> FloatColor;
+
+  // Conversions without explicit template arguments pick vectorized
+  // overloads for 8-bit colors where available.
 
   switch (d->colorConversion)
     {
     case GenericConversion:
-      emitObject(PiiColors::genericConversion(image, d->matGenericConversion));
+      emitInBands(image, conversionBand<FloatColor,Clr,const PiiMatrix<float>&>(PiiColors::genericConversion<Clr>,
+                                                                               d->matGenericConversion));
       break;
     case RgbToGrayMean:
-      sumColors(image, std::bind2nd(std::divides<SumType>(), 3));
+      emitInBands(image, conversionBand<T,Clr>(PiiColors::rgbToGrayMean));
       break;
     case RgbToGrayMeanFloat:
-      sumColors(image, std::bind2nd(std::divides<float>(), 3.0f));
+      emitInBands(image, sumColorsBand(image, std::bind2nd(std::divides<float>(), 3.0f)));
       break;
     case RgbToGraySum:
-      sumColors(image, Pii::Identity<SumType>());
+      emitInBands(image, sumColorsBand(image, Pii::Identity<SumType>()));
       break;
     case RgbToHsv:
-      emitObject(PiiColors::rgbToHsv(image));
+      emitInBands(image, conversionBand<Clr,Clr>(PiiColors::rgbToHsv));
       break;
     case HsvToRgb:
-      emitObject(PiiColors::hsvToRgb(image));
+      emitInBands(image, conversionBand<Clr,Clr>(PiiColors::hsvToRgb<Clr>));
       break;
     case BgrToRgb:
-      emitObject(PiiColors::reverseColors(image));
+      emitInBands(image, conversionBand<Clr,Clr>(PiiColors::reverseColors<Clr>));
       break;
     case XyzToLab:
-      emitObject(PiiColors::xyzToLab(PiiMatrix<PiiColor<float> >(image), d->clrWhitePoint));
+      emitInBands(PiiMatrix<FloatColor>(image),
+                  conversionBand<FloatColor,FloatColor,const FloatColor&>(PiiColors::xyzToLab<FloatColor>,
+                                                                          d->clrWhitePoint));
       break;
     case LabToXyz:
-      emitObject(PiiColors::labToXyz(PiiMatrix<PiiColor<float> >(image), d->clrWhitePoint));
+      emitInBands(PiiMatrix<FloatColor>(image),
+                  conversionBand<FloatColor,FloatColor,const FloatColor&>(PiiColors::labToXyz<FloatColor>,
+                                                                          d->clrWhitePoint));
       break;
     case RgbToLab:
-      emitObject(PiiColors::xyzToLab(PiiColors::genericConversion(image, d->matGenericConversion),
-                                                     d->clrWhitePoint));
+      emitInBands(image, RgbToLabBand<Clr>(d->matGenericConversion, d->clrWhitePoint, d->iLabTableSize));
       break;
     case RgbToOhtaKanade:
-      emitObject(PiiColors::genericConversion(image, PiiColors::ohtaKanadeMatrix));
+      emitInBands(image, conversionBand<FloatColor,Clr,const PiiMatrix<float>&>(PiiColors::genericConversion<Clr>,
+                                                                               PiiColors::ohtaKanadeMatrix));
       break;
     case RgbToY719:
-      emitObject(PiiColors::rgbToY709(image));
+      emitInBands(image, conversionBand<float,Clr>(PiiColors::rgbToY709<Clr>));
       break;
     case RgbToYpbpr:
-      emitObject(PiiColors::rgbToYpbpr(image));
+      emitInBands(image, conversionBand<Clr,Clr>(PiiColors::rgbToYpbpr<Clr>));
       break;
     case YpbprToRgb:
-      emitObject(PiiColors::ypbprToRgb(image));
+      emitInBands(image, conversionBand<Clr,Clr>(PiiColors::ypbprToRgb<Clr>));
       break;
     case RgbToYcbcr:
-      emitObject(PiiColors::rgbToYcbcr(image));
+      emitInBands(image, conversionBand<Clr,Clr,double>(PiiColors::rgbToYcbcr, PiiImage::Traits<Clr>::max()));
       break;
     case YcbcrToRgb:
-      emitObject(PiiColors::ycbcrToRgb(image));
+      emitInBands(image, conversionBand<Clr,Clr,double>(PiiColors::ycbcrToRgb<Clr>, PiiImage::Traits<Clr>::max()));
       break;
     case GammaCorrection:
-      emitObject(PiiColors::correctGamma(image, d->dGamma, PiiImage::Traits<typename Clr::Type>::max()));
+      emitInBands(image, GammaBand<Clr,Clr>(d->dGamma, PiiImage::Traits<typename Clr::Type>::max()));
     }
 }
 
-template <class T, class UnaryFunction>
-void PiiColorConverter::sumColors(const PiiMatrix<T>& image, UnaryFunction func)
-
+template <class T, class Function> void PiiColorConverter::emitInBands(const PiiMatrix<T>& image, Function function)
 {
-  typedef typename UnaryFunction::result_type U;
-  PiiMatrix<U> matResult(PiiMatrix<U>::uninitialized(image.rows(), image.columns()));
-
-  const int iCols = image.columns(), iRows = image.rows();
-  for (int r=0; r<iRows; ++r)
-    {
-      const T* pInputRow = image[r];
-      U* pOutputRow = matResult[r];
-      for (int c=0; c<iCols; ++c)
-        pOutputRow[c] = func(U(pInputRow[c].channels[0]) +
-                             U(pInputRow[c].channels[1]) +
-                             U(pInputRow[c].channels[2]));
-    }
-  emitObject(matResult);
+  emitObject(PiiImage::processInBands<typename Function::result_type>(image, 0, _d()->iTileThreads, function));
 }
 
 void PiiColorConverter::setColorConversion(ColorConversion colorConversion) { _d()->colorConversion = colorConversion; }
@@ -181,3 +276,7 @@ void PiiColorConverter::setWhitePoint(const PiiVariant& whitePoint) { _d()->pWhi
 PiiVariant PiiColorConverter::whitePoint() const { return _d()->pWhitePoint; }
 void PiiColorConverter::setGamma(double gamma) { _d()->dGamma = gamma; }
 double PiiColorConverter::gamma() const { return _d()->dGamma; }
+void PiiColorConverter::setTileThreads(int tileThreads) { _d()->iTileThreads = tileThreads; }
+int PiiColorConverter::tileThreads() const { return _d()->iTileThreads; }
+void PiiColorConverter::setLabTableSize(int labTableSize) { _d()->iLabTableSize = labTableSize; }
+int PiiColorConverter::labTableSize() const { return _d()->iLabTableSize; }
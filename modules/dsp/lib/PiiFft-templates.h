@@ -20,438 +20,787 @@
 # error "Never use <PiiFft-templates.h> directly; include <PiiFft.h> instead."
 #endif
 
+#include <QVarLengthArray>
+#include <QVector>
 #include <cmath>
 
-template <class T> PiiFft<T>::PiiFft() : _trig(new std::complex<T>[37]), _twiddle(new std::complex<T>[37]), _z(new std::complex<T>[37]),
-                                         _count(0), _factorCount(0), _prevPrimeRadix(37)
-{
-  _pi  = T(4*std::atan(1.0));
-  c3_1 = T(std::cos(2*_pi/3)-1);
-  c3_2 = T(std::sin(2*_pi/3));
-  u5   = T(2*_pi/5);
-  c5_1 = T((std::cos(u5)+std::cos(2*u5))/2-1);
-  c5_2 = T((std::cos(u5)-std::cos(2*u5))/2);
-  c5_3 = T(-std::sin(u5));
-  c5_4 = T(-(std::sin(u5)+std::sin(2*u5)));
-  c5_5 = T((std::sin(u5)-std::sin(2*u5)));
-  c8   = T(1/std::sqrt(2.0));
+#ifndef PII_NO_QT
+#  include <QThread>
+#endif
 
-  for ( int i=0; i<20; i++ )
-    {
-      _actualRadix[i] = 0;
-      _sofarRadix[i] = 0;
-      _remainRadix[i] = 0;
-    }
-}
+/**
+ * @internal
+ *
+ * Everything that depends on the transform length only: the
+ * factorization, the order in which the input is read, and the
+ * twiddle factors of each stage.
+ */
+template <class T> class PiiFft<T>::Plan
+{
+public:
+  Plan(int count);
+
+  int iCount, iFactorCount, iMaxRadix;
+  int aActualRadix[20], aSofarRadix[20], aRemainRadix[20];
+  int aTwiddleOffset[20], aTrigOffset[20];
+  // Index of the input sample that goes to each position before
+  // synthesis.
+  QVector<int> vecPermutation;
+  // Twiddles of all stages. Stage i uses sofar*radix values starting
+  // at aTwiddleOffset[i].
+  QVector<std::complex<T> > vecTwiddles;
+  // Trigonometric tables of prime radices.
+  QVector<std::complex<T> > vecTrig;
+  // exp(-2 pi i k/N), k = 0, ..., N/2 for splitting the transform of
+  // a real signal packed into complex numbers. Only for even N.
+  QVector<std::complex<T> > vecRealTwiddles;
+
+private:
+  void factorize(int count);
+};
 
-template <class T> PiiFft<T>::~PiiFft()
+/**
+ * @internal
+ *
+ * Parameters of a row or column pass over a matrix. Passes are
+ * divided among threads by row or by block of columns.
+ */
+template <class T> template <class S> struct PiiFft<T>::Pass
 {
-  delete[] _trig;
-  delete[] _twiddle;
-  delete[] _z;
-}
+  Pass() :
+    pPlan(0), pHalfPlan(0),
+    pSource(0), iSourceStride(0),
+    pTarget(0), pRealTarget(0), iTargetStride(0),
+    iColumns(0), bInverse(false)
+  {}
+
+  const Plan* pPlan;
+  // The plan of N/2-length transforms for real input.
+  const Plan* pHalfPlan;
+  const S* pSource;
+  std::size_t iSourceStride;
+  std::complex<T>* pTarget;
+  T* pRealTarget;
+  std::size_t iTargetStride;
+  // The number of columns transformed in a column pass.
+  int iColumns;
+  bool bInverse;
+};
+
+#ifndef PII_NO_QT
+template <class T> template <class S> class PiiFft<T>::PassThread : public QThread
+{
+public:
+  PassThread(const PiiFft* fft, void (PiiFft::*function)(const Pass<S>&, int, int) const,
+             const Pass<S>& pass, int first, int last) :
+    _pFft(fft), _function(function), _pass(pass), _iFirst(first), _iLast(last)
+  {}
+
+protected:
+  void run()
+  {
+    (_pFft->*_function)(_pass, _iFirst, _iLast);
+  }
+
+private:
+  const PiiFft* _pFft;
+  void (PiiFft::*_function)(const Pass<S>&, int, int) const;
+  Pass<S> _pass;
+  int _iFirst, _iLast;
+};
+#endif
 
-template <class T>
-template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::forwardFft(const PiiMatrix<S>& source)
+template <class T> PiiFft<T>::Plan::Plan(int count) :
+  iCount(count), iFactorCount(0), iMaxRadix(0),
+  vecPermutation(count)
 {
-  int cols = source.columns();
-  int rows = source.rows();
+  for (int i=0; i<20; ++i)
+    {
+      aActualRadix[i] = 0;
+      aSofarRadix[i] = 0;
+      aRemainRadix[i] = 0;
+      aTwiddleOffset[i] = 0;
+      aTrigOffset[i] = 0;
+    }
+
+  factorize(count);
 
-  PiiMatrix<std::complex<T> > result(rows, cols);
+  aRemainRadix[0] = count;
+  aSofarRadix[1] = 1;
+  aRemainRadix[1] = count / aActualRadix[1];
+  for (int i=2; i<=iFactorCount; ++i)
+    {
+      aSofarRadix[i]  = aSofarRadix[i-1] * aActualRadix[i-1];
+      aRemainRadix[i] = aRemainRadix[i-1] / aActualRadix[i];
+    }
 
-  if ( cols > 1 )
+  // Reorder the input so that the synthesis can be done in place and
+  // the final result is in correct order.
+  int* pCounts = new int[iFactorCount+2];
+  for (int i=0; i<=iFactorCount+1; ++i)
+    pCounts[i] = 0;
+  int k = 0;
+  for (int i=0; i<=count-2; ++i)
     {
-      for ( int r=0; r<rows; r++ )
+      vecPermutation[i] = k;
+      int j = 1;
+      k += aRemainRadix[j];
+      ++pCounts[1];
+      while (pCounts[j] >= aActualRadix[j])
         {
-          if (!forward1d<S>(source.row(r), result.row(r), cols) )
-            return PiiMatrix<std::complex<T> >(1,1);
+          pCounts[j] = 0;
+          k = k - aRemainRadix[j-1] + aRemainRadix[j+1];
+          ++j;
+          ++pCounts[j];
         }
     }
-  else
-    result = source;
-
-  if ( rows > 1 )
+  vecPermutation[count-1] = count-1;
+  delete[] pCounts;
+
+  // Calculate all trigonometric values directly instead of by
+  // repeated multiplication to avoid accumulating errors.
+  const double dTwoPi = 8 * std::atan(1.0);
+  int iTwiddleCount = 0, iTrigCount = 0;
+  for (int i=1; i<=iFactorCount; ++i)
     {
-      if (_tempSource.columns() != rows)
-        reallocateBuffers(rows);
-      std::complex<T> *src = _tempSource.row(0), *res = _tempResult.row(0);
+      iMaxRadix = qMax(iMaxRadix, aActualRadix[i]);
+      aTwiddleOffset[i] = iTwiddleCount;
+      if (aSofarRadix[i] > 1)
+        iTwiddleCount += aSofarRadix[i] * aActualRadix[i];
+      aTrigOffset[i] = iTrigCount;
+      if (isPrimeFactor(aActualRadix[i]))
+        iTrigCount += aActualRadix[i];
+    }
 
-      for ( int c=0; c<cols; c++ )
+  vecTwiddles.resize(iTwiddleCount);
+  vecTrig.resize(iTrigCount);
+  for (int i=1; i<=iFactorCount; ++i)
+    {
+      const int iRadix = aActualRadix[i], iSofar = aSofarRadix[i];
+      if (iSofar > 1)
+        {
+          std::complex<T>* pTwiddles = vecTwiddles.data() + aTwiddleOffset[i];
+          for (int iData=0; iData<iSofar; ++iData)
+            for (int iBlock=0; iBlock<iRadix; ++iBlock)
+              {
+                double dAngle = dTwoPi * ((iData * iBlock) % (iSofar * iRadix)) / (iSofar * iRadix);
+                pTwiddles[iData * iRadix + iBlock] = std::complex<T>(T(std::cos(dAngle)), T(-std::sin(dAngle)));
+              }
+        }
+      if (isPrimeFactor(iRadix))
         {
-          for ( int r=0; r<rows; r++ )
-            src[r] = result(r,c);
+          std::complex<T>* pTrig = vecTrig.data() + aTrigOffset[i];
+          for (int j=0; j<iRadix; ++j)
+            {
+              double dAngle = dTwoPi * j / iRadix;
+              pTrig[j] = std::complex<T>(T(std::cos(dAngle)), T(-std::sin(dAngle)));
+            }
+        }
+    }
 
-          if ( !forward1d<std::complex<T> >(src, res, rows) )
-            return PiiMatrix<std::complex<T> >(1,1);
-          for ( int r=0; r<rows; r++ )
-            result(r,c) = res[r];
+  if (count % 2 == 0)
+    {
+      vecRealTwiddles.resize(count/2 + 1);
+      for (int i=0; i<=count/2; ++i)
+        {
+          double dAngle = dTwoPi * i / count;
+          vecRealTwiddles[i] = std::complex<T>(T(std::cos(dAngle)), T(-std::sin(dAngle)));
         }
     }
-  return result;
 }
 
-template <class T> void PiiFft<T>::reallocateBuffers(int len)
+template <class T> void PiiFft<T>::Plan::factorize(int count)
 {
-  _tempSource.resize(1,len);
-  _tempResult.resize(1,len);
-}
+  int i = 0, k;
+  int factors[20];
+  const int iRadixCount = 6;
+  const int iRadices[7] = {0,2,3,4,5,8,10};
 
-template <class T>
-template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::inverseFft(const PiiMatrix<std::complex<S> >& source)
-{
-  int cols = source.columns();
-  int rows = source.rows();
+  if ( count == 1 )
+    {
+      iFactorCount = 1;
+      factors[1] = 1;
+    }
+  else
+    iFactorCount = 0;
 
-  PiiMatrix<std::complex<T> > result(rows, cols);
 
-  if ( cols > 1 )
+  // Factorise the original series length Count into known factors and rest value
+  i = iRadixCount;
+  while(count > 1 && i > 0)
     {
-      for ( int r=0; r<rows; r++ )
+      if ( count % iRadices[i] == 0 )
         {
-          if (!inverse1d<S>(source.row(r), result.row(r), cols))
-            return PiiMatrix<std::complex<T> >(1,1);
+          count = count / iRadices[i];
+          iFactorCount++;
+          factors[iFactorCount] = iRadices[i];
         }
+      else
+        i--;
     }
-  else
-    result = source;
 
-  if ( rows > 1 )
+  // substitute factors 2*8 with more optimal 4*4
+  if ( factors[iFactorCount] == 2 )
     {
-      if (_tempSource.columns() != rows)
-        reallocateBuffers(rows);
-      std::complex<T> *src = _tempSource.row(0), *res = _tempResult.row(0);
+      i = iFactorCount - 1;
+      while( i > 0 && factors[i] != 8 )
+        i--;
 
-      for ( int c=0; c<cols; c++ )
+      if ( i > 0 )
         {
-          for ( int r=0; r<rows; r++ )
-            src[r] = result(r,c);
+          factors[iFactorCount] = 4;
+          factors[i] = 4;
+        }
+    }
 
-          if ( !inverse1d<T>(src, res, rows) )
-            return PiiMatrix<std::complex<T> >(1,1);
-          for ( int r=0; r<rows; r++ )
-            result(r,c) = res[r];
+  // Analyse the rest value and see if it can be factored in primes
+  if ( count > 1 )
+    {
+      for ( k = 2; k<std::sqrt((double)count)+1; k++ )
+        {
+          while (count % k == 0)
+            {
+              count = count / k;
+              iFactorCount++;
+              factors[iFactorCount] = k;
+            }
+        }
+
+      if ( count > 1)
+        {
+          iFactorCount++;
+          factors[iFactorCount] = count;
         }
     }
 
-  return result;
+  aActualRadix[0] = 0;
+  for ( i=1; i<=iFactorCount; i++ )
+    aActualRadix[i] = factors[iFactorCount - i + 1];
 }
 
+template <class T> PiiFft<T>::PiiFft() :
+  _iThreadCount(1)
+{
+  _pi  = T(4*std::atan(1.0));
+  c3_1 = T(std::cos(2*_pi/3)-1);
+  c3_2 = T(std::sin(2*_pi/3));
+  u5   = T(2*_pi/5);
+  c5_1 = T((std::cos(u5)+std::cos(2*u5))/2-1);
+  c5_2 = T((std::cos(u5)-std::cos(2*u5))/2);
+  c5_3 = T(-std::sin(u5));
+  c5_4 = T(-(std::sin(u5)+std::sin(2*u5)));
+  c5_5 = T((std::sin(u5)-std::sin(2*u5)));
+  c8   = T(1/std::sqrt(2.0));
+}
 
-template <class T>
-template <class S> bool PiiFft<T>::forward1d(const S* source, std::complex<T>* destination, int count)
+template <class T> PiiFft<T>::~PiiFft()
 {
-  if (count == 0)
-    return false;
+  for (int i=0; i<_lstPlans.size(); ++i)
+    delete _lstPlans[i];
+}
 
-  if (_count != count)
+template <class T> void PiiFft<T>::setThreadCount(int threadCount) { _iThreadCount = qMax(0, threadCount); }
+template <class T> int PiiFft<T>::threadCount() const { return _iThreadCount; }
+
+template <class T> const typename PiiFft<T>::Plan* PiiFft<T>::plan(int count)
+{
+  Plan* pPlan = _mapPlans.value(count);
+  if (pPlan == 0)
     {
-      factorize(count);
-      _count = count;
+      pPlan = new Plan(count);
+      _mapPlans.insert(count, pPlan);
+      _lstPlans.append(pPlan);
     }
+  return pPlan;
+}
 
-  _remainRadix[0] = _count;
-  _sofarRadix[1] = 1;
-  _remainRadix[1] = _count / _actualRadix[1];
-  for ( int i = 2; i<=_factorCount; i++ )
+template <class T>
+template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::forwardFft(const PiiMatrix<S>& source)
+{
+  return forward2d(source, Pii::IsComplex<S>());
+}
+
+template <class T>
+template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::forward2d(const PiiMatrix<S>& source, Pii::True)
+{
+  const int iRows = source.rows(), iCols = source.columns();
+  PiiMatrix<std::complex<T> > result(PiiMatrix<std::complex<T> >::uninitialized(iRows, iCols));
+  if (iRows == 0 || iCols == 0)
+    return result;
+
+  Pass<S> rowPass;
+  rowPass.pPlan = plan(iCols);
+  rowPass.pSource = source.row(0);
+  rowPass.iSourceStride = source.stride();
+  rowPass.pTarget = result.row(0);
+  rowPass.iTargetStride = result.stride();
+  runPass(&PiiFft::transformRows<S>, rowPass, iRows, qMax(1, 16384 / iCols));
+
+  if (iRows > 1)
     {
-      _sofarRadix[i]  = _sofarRadix[i-1] * _actualRadix[i-1];
-      _remainRadix[i] = _remainRadix[i-1] / _actualRadix[i];
+      Pass<std::complex<T> > columnPass;
+      columnPass.pPlan = plan(iRows);
+      columnPass.pSource = columnPass.pTarget = result.row(0);
+      columnPass.iSourceStride = columnPass.iTargetStride = result.stride();
+      columnPass.iColumns = iCols;
+      const int iBlocks = (iCols + iColumnBlockSize - 1) / iColumnBlockSize;
+      runPass(&PiiFft::transformColumns, columnPass, iBlocks, qMax(1, 16384 / (iRows * iColumnBlockSize)));
     }
+  return result;
+}
 
-  reorderSeries(source, destination);
-
-  for ( int i=1; i<=_factorCount; i++)
-    synthesizeFft(_sofarRadix[i], _actualRadix[i], _remainRadix[i], destination);
+template <class T>
+template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::forward2d(const PiiMatrix<S>& source, Pii::False)
+{
+  const int iRows = source.rows(), iCols = source.columns();
+  PiiMatrix<std::complex<T> > result(PiiMatrix<std::complex<T> >::uninitialized(iRows, iCols));
+  if (iRows == 0 || iCols == 0)
+    return result;
 
-  return true;
+  realForward2d(source, result);
 
+  // Fill in the redundant half: X(r,c) = X(-r mod R, C-c)*
+  const int iHalfCols = iCols/2 + 1;
+  for (int r=0; r<iRows; ++r)
+    {
+      std::complex<T>* pRow = result.row(r);
+      const std::complex<T>* pMirror = result.row(r == 0 ? 0 : iRows - r);
+      for (int c=iHalfCols; c<iCols; ++c)
+        pRow[c] = std::conj(pMirror[iCols - c]);
+    }
+  return result;
 }
 
 template <class T>
-template <class S> bool PiiFft<T>::inverse1d(const std::complex<S>* source, std::complex<T>* destination, int count)
+template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::forwardRealFft(const PiiMatrix<S>& source)
 {
-  S s;
+  const int iRows = source.rows(), iCols = source.columns();
+  PiiMatrix<std::complex<T> > result(PiiMatrix<std::complex<T> >::uninitialized(iRows, iCols == 0 ? 0 : iCols/2 + 1));
+  if (iRows == 0 || iCols == 0)
+    return result;
+  realForward2d(source, result);
+  return result;
+}
 
-  if ( count == 0 )
-    return false;
+template <class T>
+template <class S> void PiiFft<T>::realForward2d(const PiiMatrix<S>& source, PiiMatrix<std::complex<T> >& result)
+{
+  const int iRows = source.rows(), iCols = source.columns();
+
+  // Real rows to the first N/2+1 columns of the result.
+  Pass<S> rowPass;
+  rowPass.pPlan = plan(iCols);
+  rowPass.pHalfPlan = iCols % 2 == 0 ? plan(iCols/2) : 0;
+  rowPass.pSource = source.row(0);
+  rowPass.iSourceStride = source.stride();
+  rowPass.pTarget = result.row(0);
+  rowPass.iTargetStride = result.stride();
+  runPass(&PiiFft::transformRealRows<S>, rowPass, iRows, qMax(1, 32768 / iCols));
+
+  // Only the non-redundant columns need to be transformed.
+  if (iRows > 1)
+    {
+      Pass<std::complex<T> > columnPass;
+      columnPass.pPlan = plan(iRows);
+      columnPass.pSource = columnPass.pTarget = result.row(0);
+      columnPass.iSourceStride = columnPass.iTargetStride = result.stride();
+      columnPass.iColumns = iCols/2 + 1;
+      const int iBlocks = (columnPass.iColumns + iColumnBlockSize - 1) / iColumnBlockSize;
+      runPass(&PiiFft::transformColumns, columnPass, iBlocks, qMax(1, 16384 / (iRows * iColumnBlockSize)));
+    }
+}
 
-  std::complex<S> *tmpPtr = new std::complex<S>[count];
+template <class T>
+template <class S> PiiMatrix<std::complex<T> > PiiFft<T>::inverseFft(const PiiMatrix<std::complex<S> >& source)
+{
+  const int iRows = source.rows(), iCols = source.columns();
+  PiiMatrix<std::complex<T> > result(PiiMatrix<std::complex<T> >::uninitialized(iRows, iCols));
+  if (iRows == 0 || iCols == 0)
+    return result;
+
+  Pass<std::complex<S> > rowPass;
+  rowPass.pPlan = plan(iCols);
+  rowPass.pSource = source.row(0);
+  rowPass.iSourceStride = source.stride();
+  rowPass.pTarget = result.row(0);
+  rowPass.iTargetStride = result.stride();
+  rowPass.bInverse = true;
+  runPass(&PiiFft::transformRows<std::complex<S> >, rowPass, iRows, qMax(1, 16384 / iCols));
+
+  if (iRows > 1)
+    {
+      Pass<std::complex<T> > columnPass;
+      columnPass.pPlan = plan(iRows);
+      columnPass.pSource = columnPass.pTarget = result.row(0);
+      columnPass.iSourceStride = columnPass.iTargetStride = result.stride();
+      columnPass.iColumns = iCols;
+      columnPass.bInverse = true;
+      const int iBlocks = (iCols + iColumnBlockSize - 1) / iColumnBlockSize;
+      runPass(&PiiFft::transformColumns, columnPass, iBlocks, qMax(1, 16384 / (iRows * iColumnBlockSize)));
+    }
+  return result;
+}
 
-  for ( int i=count; i--; )
-    tmpPtr[i] = std::complex<S>(source[i].real(), -source[i].imag());
+template <class T>
+template <class S> PiiMatrix<T> PiiFft<T>::inverseRealFft(const PiiMatrix<std::complex<S> >& source, int columns)
+{
+  const int iRows = source.rows();
+  if (columns <= 0 || source.columns() != columns/2 + 1)
+    PII_THROW(PiiMathException, QCoreApplication::translate("PiiFft", "The number of columns in a half spectrum must be columns/2 + 1."));
 
-  forward1d(tmpPtr, destination, count);
+  PiiMatrix<T> result(PiiMatrix<T>::uninitialized(iRows, columns));
+  if (iRows == 0)
+    return result;
 
-  s = 1.0 / count;
-  for ( int i=count; i--; )
+  // The column pass needs a copy anyway.
+  PiiMatrix<std::complex<T> > matHalf(source);
+  if (iRows > 1)
     {
-      destination[i] = (T)s * std::conj(destination[i]);
-      //destination[i].real() =  s * destination[i].real();
-      //destination[i].imag() = -s * destination[i].imag();
+      Pass<std::complex<T> > columnPass;
+      columnPass.pPlan = plan(iRows);
+      columnPass.pSource = columnPass.pTarget = matHalf.row(0);
+      columnPass.iSourceStride = columnPass.iTargetStride = matHalf.stride();
+      columnPass.iColumns = matHalf.columns();
+      columnPass.bInverse = true;
+      const int iBlocks = (columnPass.iColumns + iColumnBlockSize - 1) / iColumnBlockSize;
+      runPass(&PiiFft::transformColumns, columnPass, iBlocks, qMax(1, 16384 / (iRows * iColumnBlockSize)));
     }
 
-  delete[] tmpPtr;
+  Pass<std::complex<T> > rowPass;
+  rowPass.pPlan = plan(columns);
+  rowPass.pHalfPlan = columns % 2 == 0 ? plan(columns/2) : 0;
+  rowPass.pSource = matHalf.row(0);
+  rowPass.iSourceStride = matHalf.stride();
+  rowPass.pRealTarget = result.row(0);
+  rowPass.iTargetStride = result.stride();
+  runPass(&PiiFft::inverseRealRows<std::complex<T> >, rowPass, iRows, qMax(1, 32768 / columns));
 
-  return true;
+  return result;
 }
 
-
-/********** PRIVATE FUNCTIONS **********/
-
-/**
- * Reorder the series in X to a permuted sequence in Y so that the later step can
- * be done in place, and the final Fft result is in correct order.
- * The series X and Y must be different series!
- */
 template <class T>
-template <class S> void PiiFft<T>::reorderSeries(const S* source, std::complex<T>* dest)
+template <class S> void PiiFft<T>::runPass(void (PiiFft::*function)(const Pass<S>&, int, int) const,
+                                           const Pass<S>& pass, int count, int minCountPerThread) const
 {
-  int i,j,k;
-  int *counts = new int[_factorCount+1];
-
-  for (i=1; i<=_factorCount; i++)
-    counts[i]=0;
-
-  k=0;
-
-  for (i=0; i<=_count-2; i++)
+#ifndef PII_NO_QT
+  int iThreads = qMin(_iThreadCount > 0 ? _iThreadCount : QThread::idealThreadCount(),
+                      count / minCountPerThread);
+  if (iThreads > 1)
     {
-      dest[i] = source[k];
-      j = 1;
-      k = k + _remainRadix[j];
-      counts[1]++;
-      while (counts[j] >= _actualRadix[j])
+      const int iCountPerThread = (count + iThreads - 1) / iThreads;
+      QList<QThread*> lstThreads;
+      for (int iFirst = iCountPerThread; iFirst < count; iFirst += iCountPerThread)
         {
-          counts[j] = 0;
-          k = k - _remainRadix[j-1] + _remainRadix[j+1];
-          j = j + 1;
-          counts[j] = counts[j] + 1;
+          QThread* pThread = new PassThread<S>(this, function, pass, iFirst, qMin(count, iFirst + iCountPerThread));
+          pThread->start();
+          lstThreads << pThread;
         }
+      (this->*function)(pass, 0, iCountPerThread);
+      for (int i=0; i<lstThreads.size(); ++i)
+        {
+          lstThreads[i]->wait();
+          delete lstThreads[i];
+        }
+      return;
     }
-
-  dest[_count-1] = source[_count-1];
-  delete[] counts;
+#else
+  Q_UNUSED(minCountPerThread);
+#endif
+  (this->*function)(pass, 0, count);
 }
 
-
-template <class T> void PiiFft<T>::factorize(int count)
+template <class T>
+template <class S> void PiiFft<T>::transformRows(const Pass<S>& pass, int firstRow, int lastRow) const
 {
-  int i = 0, k;
-  int factors[20];
-  const int iRadixCount = 6;
-  const int iRadices[7] = {0,2,3,4,5,8,10};
-
-  if ( count == 1 )
+  const Plan* pPlan = pass.pPlan;
+  QVarLengthArray<std::complex<T>, 64> work(2 * pPlan->iMaxRadix + 2);
+  for (int r=firstRow; r<lastRow; ++r)
     {
-      _factorCount = 1;
-      factors[1] = 1;
+      std::complex<T>* pTarget = rowAt(pass.pTarget, pass.iTargetStride, r);
+      permute(pPlan, rowAt(pass.pSource, pass.iSourceStride, r), pTarget);
+      if (pass.bInverse)
+        for (int i=0; i<pPlan->iCount; ++i)
+          pTarget[i] = std::conj(pTarget[i]);
+      synthesize(pPlan, pTarget, &work[0]);
+      if (pass.bInverse)
+        finishInverse(pPlan->iCount, pTarget);
     }
-  else
-    _factorCount = 0;
+}
 
+template <class T>
+template <class S> void PiiFft<T>::transformRealRows(const Pass<S>& pass, int firstRow, int lastRow) const
+{
+  const Plan* pPlan = pass.pPlan;
+  const int iCount = pPlan->iCount;
+  const int iMaxRadix = qMax(pPlan->iMaxRadix, pass.pHalfPlan != 0 ? pass.pHalfPlan->iMaxRadix : 0);
+  QVarLengthArray<std::complex<T>, 64> work(2 * iMaxRadix + 2);
 
-  // Factorise the original series length Count into known factors and rest value
-  i = iRadixCount;
-  while(count > 1 && i > 0)
+  if (pass.pHalfPlan == 0)
     {
-      if ( count % iRadices[i] == 0 )
+      // Odd length: transform as complex, store the first half.
+      QVarLengthArray<std::complex<T>, 256> buffer(iCount);
+      for (int r=firstRow; r<lastRow; ++r)
         {
-          count = count / iRadices[i];
-          _factorCount++;
-          factors[_factorCount] = iRadices[i];
+          permute(pPlan, rowAt(pass.pSource, pass.iSourceStride, r), &buffer[0]);
+          synthesize(pPlan, &buffer[0], &work[0]);
+          std::complex<T>* pTarget = rowAt(pass.pTarget, pass.iTargetStride, r);
+          for (int i=0; i<=iCount/2; ++i)
+            pTarget[i] = buffer[i];
         }
-      else
-        i--;
+      return;
     }
 
-  // substitute factors 2*8 with more optimal 4*4
-  if ( factors[_factorCount] == 2 )
+  // Even length: transform x(2n) + i x(2n+1) with an N/2-point FFT
+  // and split the result into the spectra of even and odd samples.
+  const Plan* pHalfPlan = pass.pHalfPlan;
+  const int iHalf = pHalfPlan->iCount;
+  const int* pPermutation = pHalfPlan->vecPermutation.constData();
+  const std::complex<T>* pTwiddles = pPlan->vecRealTwiddles.constData();
+  QVarLengthArray<std::complex<T>, 256> buffer(iHalf);
+  std::complex<T>* z = &buffer[0];
+  const T half(0.5);
+  for (int r=firstRow; r<lastRow; ++r)
     {
-      i = _factorCount - 1;
-      while( i > 0 && factors[i] != 8 )
-        i--;
+      const S* pSource = rowAt(pass.pSource, pass.iSourceStride, r);
+      for (int i=0; i<iHalf; ++i)
+        {
+          const int j = pPermutation[i] << 1;
+          z[i] = std::complex<T>(T(pSource[j]), T(pSource[j+1]));
+        }
+      synthesize(pHalfPlan, z, &work[0]);
 
-      if ( i > 0 )
+      std::complex<T>* pTarget = rowAt(pass.pTarget, pass.iTargetStride, r);
+      pTarget[0] = std::complex<T>(z[0].real() + z[0].imag(), 0);
+      pTarget[iHalf] = std::complex<T>(z[0].real() - z[0].imag(), 0);
+      for (int k=1; k<iHalf; ++k)
         {
-          factors[_factorCount] = 4;
-          factors[i] = 4;
+          const std::complex<T> zk(z[k]), zc(std::conj(z[iHalf-k]));
+          const std::complex<T> even(half * (zk + zc)), diff(half * (zk - zc));
+          // odd = -i * diff
+          pTarget[k] = even + multiply(pTwiddles[k], std::complex<T>(diff.imag(), -diff.real()));
         }
     }
+}
 
-  // Analyse the rest value and see if it can be factored in primes
-  if ( count > 1 )
+template <class T>
+template <class S> void PiiFft<T>::inverseRealRows(const Pass<S>& pass, int firstRow, int lastRow) const
+{
+  const Plan* pPlan = pass.pPlan;
+  const int iCount = pPlan->iCount;
+  const int iMaxRadix = qMax(pPlan->iMaxRadix, pass.pHalfPlan != 0 ? pass.pHalfPlan->iMaxRadix : 0);
+  QVarLengthArray<std::complex<T>, 64> work(2 * iMaxRadix + 2);
+
+  if (pass.pHalfPlan == 0)
     {
-      for ( k = 2; k<std::sqrt((double)count)+1; k++ )
+      // Odd length: rebuild the full spectrum.
+      QVarLengthArray<std::complex<T>, 256> spectrum(iCount), buffer(iCount);
+      for (int r=firstRow; r<lastRow; ++r)
         {
-          while (count % k == 0)
+          const S* pSource = rowAt(pass.pSource, pass.iSourceStride, r);
+          spectrum[0] = std::complex<T>(pSource[0].real(), 0);
+          for (int k=1; k<=iCount/2; ++k)
             {
-              count = count / k;
-              _factorCount++;
-              factors[_factorCount] = k;
+              spectrum[k] = std::conj(pSource[k]);
+              spectrum[iCount-k] = pSource[k];
             }
+          permute(pPlan, &spectrum[0], &buffer[0]);
+          synthesize(pPlan, &buffer[0], &work[0]);
+          T* pTarget = rowAt(pass.pRealTarget, pass.iTargetStride, r);
+          const T scale = T(1) / iCount;
+          for (int i=0; i<iCount; ++i)
+            pTarget[i] = scale * buffer[i].real();
         }
+      return;
+    }
 
-      if ( count > 1)
+  // Even length: combine the spectra of even and odd samples into
+  // Z(k) = E(k) + i O(k) and invert it with an N/2-point FFT.
+  const Plan* pHalfPlan = pass.pHalfPlan;
+  const int iHalf = pHalfPlan->iCount;
+  const std::complex<T>* pTwiddles = pPlan->vecRealTwiddles.constData();
+  QVarLengthArray<std::complex<T>, 256> spectrum(iHalf), buffer(iHalf);
+  const T half(0.5), scale(T(1) / iHalf);
+  for (int r=firstRow; r<lastRow; ++r)
+    {
+      const S* pSource = rowAt(pass.pSource, pass.iSourceStride, r);
+      const T dc(pSource[0].real()), nyquist(pSource[iHalf].real());
+      // The conjugate of Z is transformed to get the inverse.
+      spectrum[0] = std::complex<T>(half * (dc + nyquist), -half * (dc - nyquist));
+      for (int k=1; k<iHalf; ++k)
+        {
+          const std::complex<T> xk(pSource[k]), xc(std::conj(pSource[iHalf-k]));
+          const std::complex<T> even(half * (xk + xc));
+          const std::complex<T> odd(multiply(half * (xk - xc), std::conj(pTwiddles[k])));
+          spectrum[k] = std::complex<T>(even.real() - odd.imag(), -(even.imag() + odd.real()));
+        }
+      permute(pHalfPlan, &spectrum[0], &buffer[0]);
+      synthesize(pHalfPlan, &buffer[0], &work[0]);
+      T* pTarget = rowAt(pass.pRealTarget, pass.iTargetStride, r);
+      for (int i=0; i<iHalf; ++i)
         {
-          _factorCount++;
-          factors[_factorCount] = count;
+          pTarget[2*i] = scale * buffer[i].real();
+          pTarget[2*i+1] = -scale * buffer[i].imag();
         }
     }
-
-  _actualRadix[0] = 0;
-  for ( i=1; i<=_factorCount; i++ )
-    _actualRadix[i] = factors[_factorCount - i + 1];
-
 }
 
-template <class T> void PiiFft<T>::synthesizeFft(int sofarRadix, int radix, int remainRadix, std::complex<T>* dest)
+template <class T> void PiiFft<T>::transformColumns(const Pass<std::complex<T> >& pass, int firstBlock, int lastBlock) const
 {
-  T omega = 2 * _pi/(T)(sofarRadix*radix);
-  std::complex<T> cosSin(std::cos(omega), -std::sin(omega));
-  std::complex<T> S(1,0);
-
-  int groupOffset, dataOffset, adr;
-  int groupNo, dataNo, blockNo, twNo;
-
-  if ( isPrimeFactor(radix) )
-    initializeTrigonomials(radix);
-
-  dataOffset = 0;
-  groupOffset = dataOffset;
-  adr = groupOffset;
-
-  for (dataNo=0; dataNo<sofarRadix; dataNo++)
+  const Plan* pPlan = pass.pPlan;
+  const int iRows = pPlan->iCount;
+  const int* pPermutation = pPlan->vecPermutation.constData();
+  QVarLengthArray<std::complex<T>, 64> work(2 * pPlan->iMaxRadix + 2);
+  // Adjacent columns are copied to consecutive rows of a buffer so
+  // that each matrix row is read and written a cache line at a time.
+  QVarLengthArray<std::complex<T>, 256> buffer(iRows * iColumnBlockSize);
+  std::complex<T>* pBuffer = &buffer[0];
+
+  for (int iBlock=firstBlock; iBlock<lastBlock; ++iBlock)
     {
-      if (sofarRadix>1)
+      const int iFirstColumn = iBlock * iColumnBlockSize;
+      const int iBlockSize = qMin(int(iColumnBlockSize), pass.iColumns - iFirstColumn);
+
+      // Read rows in permuted order.
+      for (int i=0; i<iRows; ++i)
         {
-          _twiddle[0] = std::complex<T>(1.0,0.0);
-          _twiddle[1] = S;
+          const std::complex<T>* pRow = rowAt(pass.pSource, pass.iSourceStride, pPermutation[i]) + iFirstColumn;
+          if (pass.bInverse)
+            for (int c=0; c<iBlockSize; ++c)
+              pBuffer[c * iRows + i] = std::conj(pRow[c]);
+          else
+            for (int c=0; c<iBlockSize; ++c)
+              pBuffer[c * iRows + i] = pRow[c];
+        }
 
-          for (twNo=2; twNo<radix; twNo++)
-            _twiddle[twNo] = S * _twiddle[twNo-1];
+      for (int c=0; c<iBlockSize; ++c)
+        {
+          synthesize(pPlan, pBuffer + c * iRows, &work[0]);
+          if (pass.bInverse)
+            finishInverse(iRows, pBuffer + c * iRows);
+        }
 
-          S = cosSin * S;
+      for (int r=0; r<iRows; ++r)
+        {
+          std::complex<T>* pRow = rowAt(pass.pTarget, pass.iTargetStride, r) + iFirstColumn;
+          for (int c=0; c<iBlockSize; ++c)
+            pRow[c] = pBuffer[c * iRows + r];
         }
+    }
+}
 
-        for (groupNo=0; groupNo<remainRadix; groupNo++)
-          {
-            if ((sofarRadix>1) && (dataNo > 0))
-              {
-                _z[0] = dest[adr];
-                blockNo=1;
-
-                do {
-                  adr = adr + sofarRadix;
-                  _z[blockNo] = _twiddle[blockNo] * dest[adr];
-                  blockNo++;
-                } while (blockNo < radix);
-              }
-            else
-              {
-                for (blockNo=0; blockNo<radix; blockNo++)
-                  {
-                    _z[blockNo] = dest[adr];
-                    adr = adr + sofarRadix;
-                  }
-              }
+/********** PRIVATE FUNCTIONS **********/
 
-            switch(radix)
-              {
-              case  2  : fft2(_z); break;
-              case  3  : fft3(_z); break;
-              case  4  : fft4(_z); break;
-              case  5  : fft5(_z); break;
-              case  8  : fft8(_z); break;
-              case 10  : fft10(_z); break;
-              default  : fftPrime(radix); break;
-              }
+template <class T>
+template <class S> void PiiFft<T>::permute(const Plan* plan, const S* source, std::complex<T>* dest)
+{
+  const int* pPermutation = plan->vecPermutation.constData();
+  for (int i=0; i<plan->iCount; ++i)
+    dest[i] = source[pPermutation[i]];
+}
 
-            adr = groupOffset;
-            for (blockNo=0; blockNo<radix; blockNo++)
-              {
-                dest[adr] = _z[blockNo];
-                adr = adr + sofarRadix;
-              }
-            groupOffset = groupOffset + sofarRadix * radix;
-            adr = groupOffset;
-          }
-        dataOffset++;
-        groupOffset = dataOffset;
-        adr = dataOffset;
-    }
+template <class T> void PiiFft<T>::finishInverse(int count, std::complex<T>* data)
+{
+  const T scale = T(1) / count;
+  for (int i=0; i<count; ++i)
+    data[i] = std::complex<T>(scale * data[i].real(), -scale * data[i].imag());
+}
 
+template <class T> void PiiFft<T>::synthesize(const Plan* plan, std::complex<T>* data, std::complex<T>* work) const
+{
+  for (int i=1; i<=plan->iFactorCount; ++i)
+    synthesizeFft(plan->aSofarRadix[i], plan->aActualRadix[i], plan->aRemainRadix[i],
+                  plan->vecTwiddles.constData() + plan->aTwiddleOffset[i],
+                  plan->vecTrig.constData() + plan->aTrigOffset[i],
+                  data, work);
 }
 
-template <class T> void PiiFft<T>::initializeTrigonomials( int radix )
+template <class T> void PiiFft<T>::synthesizeFft(int sofarRadix, int radix, int remainRadix,
+                                                const std::complex<T>* twiddles, const std::complex<T>* trig,
+                                                std::complex<T>* dest, std::complex<T>* z) const
 {
-  if ( radix > _prevPrimeRadix )
-    {
-      delete[] _trig;
-      delete[] _twiddle;
-      delete[] _z;
-      _trig = new std::complex<T>[radix];
-      _twiddle = new std::complex<T>[radix];
-      _z = new std::complex<T>[radix];
-      _prevPrimeRadix = radix;
-    }
+  const int iGroupStep = sofarRadix * radix;
 
-  int i;
-  T w;
-  std::complex<T> x;
+  for (int dataNo=0; dataNo<sofarRadix; ++dataNo)
+    {
+      const std::complex<T>* pTwiddle = twiddles + dataNo * radix;
+      const bool bTwiddle = sofarRadix > 1 && dataNo > 0;
+      std::complex<T>* pData = dest + dataNo;
 
+      for (int groupNo=0; groupNo<remainRadix; ++groupNo, pData += iGroupStep)
+        {
+          z[0] = pData[0];
+          if (bTwiddle)
+            for (int blockNo=1; blockNo<radix; ++blockNo)
+              z[blockNo] = multiply(pTwiddle[blockNo], pData[blockNo * sofarRadix]);
+          else
+            for (int blockNo=1; blockNo<radix; ++blockNo)
+              z[blockNo] = pData[blockNo * sofarRadix];
+
+          switch(radix)
+            {
+            case  2  : fft2(z); break;
+            case  3  : fft3(z); break;
+            case  4  : fft4(z); break;
+            case  5  : fft5(z); break;
+            case  8  : fft8(z); break;
+            case 10  : fft10(z); break;
+            default  : fftPrime(z, radix, trig, z + radix); break;
+            }
 
-  w = 2 * _pi / radix;
-  _trig[0] = std::complex<T>(1,0);
-  x = std::complex<T>(std::cos(w), -std::sin(w));
-  _trig[1] = x;
+          for (int blockNo=0; blockNo<radix; ++blockNo)
+            pData[blockNo * sofarRadix] = z[blockNo];
+        }
+    }
+}
 
-  for (i=2; i<radix; i++)
-    _trig[i] = x * _trig[i-1];
+template <class T>
+template <class U> inline U* PiiFft<T>::rowAt(U* data, std::size_t stride, int row)
+{
+  return reinterpret_cast<U*>(reinterpret_cast<char*>(data) + stride * row);
+}
 
+template <class T>
+template <class U> inline const U* PiiFft<T>::rowAt(const U* data, std::size_t stride, int row)
+{
+  return reinterpret_cast<const U*>(reinterpret_cast<const char*>(data) + stride * row);
+}
 
+// Plain complex multiplication without the inf/nan checks of
+// std::complex.
+template <class T> inline std::complex<T> PiiFft<T>::multiply(const std::complex<T>& a, const std::complex<T>& b)
+{
+  return std::complex<T>(a.real() * b.real() - a.imag() * b.imag(),
+                         a.real() * b.imag() + a.imag() * b.real());
 }
 
-template <class T> inline void PiiFft<T>::fftPrime(int radix)
+template <class T> inline void PiiFft<T>::fftPrime(std::complex<T>* z, int radix, const std::complex<T>* trig,
+                                                   std::complex<T>* work) const
 {
   int i,j,k,n,max;
   std::complex<T> re, im;
-  int cols = ((radix+1) / 2);
-  std::complex<T> *v = new std::complex<T>[cols];
-  std::complex<T> *w = new std::complex<T>[cols];
+  std::complex<T> *v = work;
+  std::complex<T> *w = work + (radix+1) / 2;
 
   n = radix;
   max = (n + 1)/2;
   for (j = 1; j < max; j++)
     {
-      v[j] = std::complex<T>(_z[j].real() + _z[n-j].real(), _z[j].imag() - _z[n-j].imag());
-      w[j] = std::complex<T>(_z[j].real() - _z[n-j].real(), _z[j].imag() + _z[n-j].imag());
-      //v[j].real() = _z[j].real() + _z[n-j].real();
-      //v[j].imag() = _z[j].imag() - _z[n-j].imag();
-      //w[j].real() = _z[j].real() - _z[n-j].real();
-      //w[j].imag() = _z[j].imag() + _z[n-j].imag();
+      v[j] = std::complex<T>(z[j].real() + z[n-j].real(), z[j].imag() - z[n-j].imag());
+      w[j] = std::complex<T>(z[j].real() - z[n-j].real(), z[j].imag() + z[n-j].imag());
     }
 
   for (j = 1; j < max; j++)
     {
-      _z[j] = _z[0];
-      _z[n-j] = _z[0];
+      z[j] = z[0];
+      z[n-j] = z[0];
       k = j;
       for (i = 1; i < max; i++)
         {
-          re = std::complex<T>(_trig[k].real() * v[i].real(), _trig[k].real() * w[i].imag());
-          im = std::complex<T>(_trig[k].imag() * w[i].real(), _trig[k].imag() * v[i].imag());
-          //re.real() = _trig[k].real() * v[i].real();
-          //im.imag() = _trig[k].imag() * v[i].imag();
-          //re.imag() = _trig[k].real() * w[i].imag();
-          //im.real() = _trig[k].imag() * w[i].real();
+          re = std::complex<T>(trig[k].real() * v[i].real(), trig[k].real() * w[i].imag());
+          im = std::complex<T>(trig[k].imag() * w[i].real(), trig[k].imag() * v[i].imag());
 
-          _z[n-j] = std::complex<T>(_z[n-j].real() + re.real() + im.imag(), _z[n-j].imag() + re.imag() - im.real());
-          _z[j] = std::complex<T>(_z[j].real() + re.real() - im.imag(), _z[j].imag() + re.imag() + im.real());
-
-          //_z[n-j].real() += (re.real() + im.imag());
-          //_z[n-j].imag() += (re.imag() - im.real());
-          //_z[j].real()   += (re.real() - im.imag());
-          //_z[j].imag()   += (re.imag() + im.real());
+          z[n-j] = std::complex<T>(z[n-j].real() + re.real() + im.imag(), z[n-j].imag() + re.imag() - im.real());
+          z[j] = std::complex<T>(z[j].real() + re.real() - im.imag(), z[j].imag() + re.imag() + im.real());
 
           k = k + j;
           if (k >= n)
@@ -460,17 +809,10 @@ template <class T> inline void PiiFft<T>::fftPrime(int radix)
     }
 
   for ( j = 1; j < max; j++)
-    {
-      _z[0] = std::complex<T>(_z[0].real() + v[j].real(), _z[0].imag() + w[j].imag() );
-      //_z[0].real() += v[j].real();
-      //_z[0].imag() += w[j].imag();
-    }
-  delete[] w;
-  delete[] v;
-
+    z[0] = std::complex<T>(z[0].real() + v[j].real(), z[0].imag() + w[j].imag() );
 }
 
-template <class T> inline void PiiFft<T>::fft2(std::complex<T>* z)
+template <class T> inline void PiiFft<T>::fft2(std::complex<T>* z) const
 {
   std::complex<T> t1;
 
@@ -479,7 +821,7 @@ template <class T> inline void PiiFft<T>::fft2(std::complex<T>* z)
   z[0] = t1;
 }
 
-template <class T> inline void PiiFft<T>::fft3(std::complex<T>* z)
+template <class T> inline void PiiFft<T>::fft3(std::complex<T>* z) const
 {
   std::complex<T> t1, m1, m2, s1;
 
@@ -495,7 +837,7 @@ template <class T> inline void PiiFft<T>::fft3(std::complex<T>* z)
 
 }
 
-template <class T> inline void PiiFft<T>::fft4(std::complex<T>* z)
+template <class T> inline void PiiFft<T>::fft4(std::complex<T>* z) const
 {
   std::complex<T> t1, t2, m2, m3;
 
@@ -513,7 +855,7 @@ template <class T> inline void PiiFft<T>::fft4(std::complex<T>* z)
   z[3] = m2 - m3;
 }
 
-template <class T> inline void PiiFft<T>::fft5(std::complex<T>* z)
+template <class T> inline void PiiFft<T>::fft5(std::complex<T>* z) const
 {
   std::complex<T> t1, t2, t3, t4, t5;
   std::complex<T> m1, m2, m3, m4, m5;
@@ -551,78 +893,80 @@ template <class T> inline void PiiFft<T>::fft5(std::complex<T>* z)
   z[4] = s2 - s3;
 }
 
-template <class T> inline void PiiFft<T>::fft8(std::complex<T>* z)
+template <class T> inline void PiiFft<T>::fft8(std::complex<T>* z) const
 {
+  std::complex<T> a[4], b[4];
   T gem;
 
-  _a[0] = z[0];
-  _a[1] = z[2];
-  _a[2] = z[4];
-  _a[3] = z[6];
+  a[0] = z[0];
+  a[1] = z[2];
+  a[2] = z[4];
+  a[3] = z[6];
 
-  _b[0] = z[1];
-  _b[1] = z[3];
-  _b[2] = z[5];
-  _b[3] = z[7];
+  b[0] = z[1];
+  b[1] = z[3];
+  b[2] = z[5];
+  b[3] = z[7];
 
-  fft4(_a);
-  fft4(_b);
+  fft4(a);
+  fft4(b);
 
-  gem = c8 * (_b[1].real() + _b[1].imag());
-  _b[1] = std::complex<T>(gem, c8 * (_b[1].imag() - _b[1].real()));
-  //_b[1].imag() = c8 * (_b[1].imag() - _b[1].real());
-  //_b[1].real() = gem;
+  gem = c8 * (b[1].real() + b[1].imag());
+  b[1] = std::complex<T>(gem, c8 * (b[1].imag() - b[1].real()));
+  //b[1].imag() = c8 * (b[1].imag() - b[1].real());
+  //b[1].real() = gem;
 
-  gem = _b[2].imag();
-  _b[2] = std::complex<T>(gem, -_b[2].real());
-  //_b[2].imag() = -_b[2].real();
-  //_b[2].real() = gem;
+  gem = b[2].imag();
+  b[2] = std::complex<T>(gem, -b[2].real());
+  //b[2].imag() = -b[2].real();
+  //b[2].real() = gem;
 
-  gem = c8 * (_b[3].imag() - _b[3].real());
-  _b[3] = std::complex<T>(gem, -c8 * (_b[3].real() + _b[3].imag()));
-  //_b[3].imag() = -c8 * (_b[3].real() + _b[3].imag());
-  //_b[3].real() = gem;
+  gem = c8 * (b[3].imag() - b[3].real());
+  b[3] = std::complex<T>(gem, -c8 * (b[3].real() + b[3].imag()));
+  //b[3].imag() = -c8 * (b[3].real() + b[3].imag());
+  //b[3].real() = gem;
 
-  z[0] = _a[0] + _b[0];
-  z[1] = _a[1] + _b[1];
-  z[2] = _a[2] + _b[2];
-  z[3] = _a[3] + _b[3];
+  z[0] = a[0] + b[0];
+  z[1] = a[1] + b[1];
+  z[2] = a[2] + b[2];
+  z[3] = a[3] + b[3];
 
-  z[4] = _a[0] - _b[0];
-  z[5] = _a[1] - _b[1];
-  z[6] = _a[2] - _b[2];
-  z[7] = _a[3] - _b[3];
+  z[4] = a[0] - b[0];
+  z[5] = a[1] - b[1];
+  z[6] = a[2] - b[2];
+  z[7] = a[3] - b[3];
 
 }
 
-template <class T> inline void PiiFft<T>::fft10(std::complex<T>* z)
+template <class T> inline void PiiFft<T>::fft10(std::complex<T>* z) const
 {
-
-  _a[0] = z[0];
-  _a[1] = z[2];
-  _a[2] = z[4];
-  _a[3] = z[6];
-  _a[4] = z[8];
-
-  _b[0] = z[5];
-  _b[1] = z[7];
-  _b[2] = z[9];
-  _b[3] = z[1];
-  _b[4] = z[3];
-
-  fft5(_a);
-  fft5(_b);
-
-  z[0] = _a[0] + _b[0];
-  z[6] = _a[1] + _b[1];
-  z[2] = _a[2] + _b[2];
-  z[8] = _a[3] + _b[3];
-  z[4] = _a[4] + _b[4];
-  z[5] = _a[0] - _b[0];
-  z[1] = _a[1] - _b[1];
-  z[7] = _a[2] - _b[2];
-  z[3] = _a[3] - _b[3];
-  z[9] = _a[4] - _b[4];
+  std::complex<T> a[5], b[5];
+
+  a[0] = z[0];
+  a[1] = z[2];
+  a[2] = z[4];
+  a[3] = z[6];
+  a[4] = z[8];
+
+  b[0] = z[5];
+  b[1] = z[7];
+  b[2] = z[9];
+  b[3] = z[1];
+  b[4] = z[3];
+
+  fft5(a);
+  fft5(b);
+
+  z[0] = a[0] + b[0];
+  z[6] = a[1] + b[1];
+  z[2] = a[2] + b[2];
+  z[8] = a[3] + b[3];
+  z[4] = a[4] + b[4];
+  z[5] = a[0] - b[0];
+  z[1] = a[1] - b[1];
+  z[7] = a[2] - b[2];
+  z[3] = a[3] - b[3];
+  z[9] = a[4] - b[4];
 
 }
 
@@ -643,5 +987,4 @@ template <class T> bool PiiFft<T>::isPrimeFactor( int radix )
     }
 }
 
-
 #endif //_PIIFFT_TEMPLATES_H
@@ -19,6 +19,10 @@
 #include <PiiMatrix.h>
 #include <PiiFunctional.h>
 #include <PiiMatrixValue.h>
+#include <PiiMathException.h>
+#include <QCoreApplication>
+#include <QMap>
+#include <QList>
 #include <complex>
 
 /**
@@ -27,6 +31,32 @@
  * pieces for which an optimized radix-N implementation exists. The
  * class has implementations for radix 2, 3, 4, 5, 8, and 10.
  *
+ * The factorization, the permutation of the input and the twiddle
+ * factors of each transform length are calculated once and cached
+ * in the PiiFft object. Reusing the same object for many
+ * transforms of the same size is therefore faster than creating a
+ * new one each time.
+ *
+ * Real-valued input is transformed by packing pairs of samples into
+ * complex numbers of half the length, which halves the work in the
+ * row pass. Since the spectrum of a real signal is conjugate
+ * symmetric, only the non-redundant half of the columns is
+ * transformed in the column pass. [forwardRealFft()] and
+ * [inverseRealFft()] work with the non-redundant half of the
+ * spectrum only, which also halves memory usage.
+ *
+ * The column pass transforms blocks of adjacent columns at once so
+ * that each memory access reads a full cache line instead of a
+ * single element.
+ *
+ * ~~~(c++)
+ * PiiFft<float> fft;
+ * PiiMatrix<std::complex<float> > matSpectrum(fft.forwardFft(image));
+ * PiiMatrix<float> matImage(Pii::real(fft.inverseFft(matSpectrum)));
+ * ~~~
+ *
+ * PiiFft is not thread-safe; use a separate instance in each
+ * thread.
  */
 template <class T> class PiiFft
 {
@@ -35,7 +65,10 @@ public:
   ~PiiFft();
 
   /**
-   * Perform a forward Fourier transform.
+   * Perform a forward Fourier transform. If `S` is not a complex
+   * type, the transform uses the faster real-input algorithm and
+   * fills the redundant half of the spectrum using conjugate
+   * symmetry.
    */
   template <class S> PiiMatrix<std::complex<T> > forwardFft(const PiiMatrix<S>& source);
   /**
@@ -43,32 +76,104 @@ public:
    */
   template <class S> PiiMatrix<std::complex<T> > inverseFft(const PiiMatrix<std::complex<S> >& source);
 
+  /**
+   * Perform a forward Fourier transform on real-valued input. Since
+   * the spectrum of a real signal is conjugate symmetric, only the
+   * first `N/2 + 1` columns of the spectrum are calculated and
+   * returned. Here, `N` stands for the number of columns in
+   * `source`. The rest of the spectrum is obtained by conjugate
+   * symmetry: `X(r,c) = X(-r mod R, N-c)*`.
+   *
+   * ~~~(c++)
+   * PiiFft<double> fft;
+   * PiiMatrix<double> matInput(480, 640);
+   * // 480 x 321
+   * PiiMatrix<std::complex<double> > matHalf(fft.forwardRealFft(matInput));
+   * ~~~
+   */
+  template <class S> PiiMatrix<std::complex<T> > forwardRealFft(const PiiMatrix<S>& source);
+
+  /**
+   * Perform an inverse Fourier transform on a conjugate symmetric
+   * spectrum whose non-redundant half is stored in `source`. This
+   * is the inverse of [forwardRealFft()].
+   *
+   * @param source the first `columns/2 + 1` columns of the spectrum.
+   * The imaginary parts of the zero and Nyquist frequencies are
+   * ignored.
+   *
+   * @param columns the number of columns in the real-valued result.
+   * Needed because both `2n` and `2n+1` columns produce `n+1`
+   * non-redundant columns.
+   *
+   * @exception PiiMathException& if `source` does not have
+   * `columns/2 + 1` columns.
+   */
+  template <class S> PiiMatrix<T> inverseRealFft(const PiiMatrix<std::complex<S> >& source, int columns);
+
+  /**
+   * Set the maximum number of threads used in calculating 2D
+   * transforms. Rows and blocks of columns are divided among the
+   * threads. Zero means the number of processor cores. The default
+   * is one. Small transforms are always calculated in the calling
+   * thread.
+   */
+  void setThreadCount(int threadCount);
+  /**
+   * Get the maximum number of threads.
+   */
+  int threadCount() const;
+
 private:
-  template <class S> bool forward1d(const S* source, std::complex<T>* destination, int count);
-  template <class S> bool inverse1d(const std::complex<S>* source, std::complex<T>* destination, int count);
-
-  void factorize(int count);
-  template <class S> void reorderSeries(const S* source, std::complex<T>* dest);
-  void initializeTrigonomials(int radix);
-
-  inline void fftPrime(int radix);
-  inline void fft2(std::complex<T>* z);
-  inline void fft3(std::complex<T>* z);
-  inline void fft4(std::complex<T>* z);
-  inline void fft5(std::complex<T>* z);
-  inline void fft8(std::complex<T>* z);
-  inline void fft10(std::complex<T>* z);
-  void synthesizeFft(int sofar, int radix, int remain, std::complex<T>* dest);
-  bool isPrimeFactor(int radix);
-  void reallocateBuffers(int len);
-
-  std::complex<T> _a[5], _b[5];
-  std::complex<T> *_trig, *_twiddle, *_z;
-  int _sofarRadix[20], _actualRadix[20], _remainRadix[20];
-  int _count, _factorCount, _prevPrimeRadix;
+  class Plan;
+  template <class S> struct Pass;
+#ifndef PII_NO_QT
+  template <class S> class PassThread;
+#endif
+
+  enum { iColumnBlockSize = 8 };
+
+  template <class S> PiiMatrix<std::complex<T> > forward2d(const PiiMatrix<S>& source, Pii::True);
+  template <class S> PiiMatrix<std::complex<T> > forward2d(const PiiMatrix<S>& source, Pii::False);
+  template <class S> void realForward2d(const PiiMatrix<S>& source, PiiMatrix<std::complex<T> >& result);
+
+  const Plan* plan(int count);
+  template <class S> void runPass(void (PiiFft::*function)(const Pass<S>&, int, int) const,
+                                  const Pass<S>& pass, int count, int minCountPerThread) const;
+  template <class S> void transformRows(const Pass<S>& pass, int firstRow, int lastRow) const;
+  template <class S> void transformRealRows(const Pass<S>& pass, int firstRow, int lastRow) const;
+  template <class S> void inverseRealRows(const Pass<S>& pass, int firstRow, int lastRow) const;
+  void transformColumns(const Pass<std::complex<T> >& pass, int firstBlock, int lastBlock) const;
+
+  template <class S> static void permute(const Plan* plan, const S* source, std::complex<T>* dest);
+  static void finishInverse(int count, std::complex<T>* data);
+  void synthesize(const Plan* plan, std::complex<T>* data, std::complex<T>* work) const;
+  void synthesizeFft(int sofarRadix, int radix, int remainRadix,
+                     const std::complex<T>* twiddles, const std::complex<T>* trig,
+                     std::complex<T>* dest, std::complex<T>* z) const;
+
+  template <class U> static inline U* rowAt(U* data, std::size_t stride, int row);
+  template <class U> static inline const U* rowAt(const U* data, std::size_t stride, int row);
+  static inline std::complex<T> multiply(const std::complex<T>& a, const std::complex<T>& b);
+  static bool isPrimeFactor(int radix);
+
+  inline void fftPrime(std::complex<T>* z, int radix, const std::complex<T>* trig, std::complex<T>* work) const;
+  inline void fft2(std::complex<T>* z) const;
+  inline void fft3(std::complex<T>* z) const;
+  inline void fft4(std::complex<T>* z) const;
+  inline void fft5(std::complex<T>* z) const;
+  inline void fft8(std::complex<T>* z) const;
+  inline void fft10(std::complex<T>* z) const;
+
+  QMap<int, Plan*> _mapPlans;
+  // Owns the plans. QMap iterators differ from those of the no-Qt
+  // wrapper, so the plans are deleted through this list.
+  QList<Plan*> _lstPlans;
+  int _iThreadCount;
 
   T _pi, c3_1, c3_2, u5, c5_1, c5_2, c5_3, c5_4, c5_5, c8;
-  PiiMatrix<std::complex<T> > _tempSource, _tempResult;
+
+  PII_DISABLE_COPY(PiiFft);
 };
 
 #include "PiiFft-templates.h"
@@ -76,17 +181,52 @@ private:
 
 namespace PiiDsp
 {
-  /// @internal Takes the real part of a complex number
-  template <class T> struct FastCorrelationConverter
+  /// @internal Correlates real signals using half spectra.
+  template <class T> struct FastCorrelation
   {
-    static PiiMatrix<T> apply(const PiiMatrix<std::complex<T> >& matrix) { return Pii::matrix(Pii::real(matrix)); }
+    static PiiMatrix<T> apply(const PiiMatrix<T>& a, const PiiMatrix<T>& b)
+    {
+      PiiFft<T> fft;
+      return fft.inverseRealFft(Pii::matrix(Pii::multiplied(fft.forwardRealFft(a),
+                                                            Pii::conj(fft.forwardRealFft(b)))),
+                                a.columns());
+    }
   };
-  /// @internal Returns the complex number itself
-  template <class T> struct FastCorrelationConverter<std::complex<T> >
+  /// @internal Correlates complex signals.
+  template <class T> struct FastCorrelation<std::complex<T> >
   {
-    static PiiMatrix<std::complex<T> > apply(const PiiMatrix<std::complex<T> >& matrix) { return matrix; }
+    static PiiMatrix<std::complex<T> > apply(const PiiMatrix<std::complex<T> >& a,
+                                             const PiiMatrix<std::complex<T> >& b)
+    {
+      PiiFft<T> fft;
+      return fft.inverseFft(Pii::matrix(Pii::multiplied(fft.forwardFft(a), Pii::conj(fft.forwardFft(b)))));
+    }
   };
 
+  /**
+   * Returns the smallest transform length that is at least *minimum*
+   * and has no prime factors other than 2, 3 and 5. PiiFft has
+   * optimized butterflies for these radices. Zero-padding a signal
+   * to such a length is therefore usually faster than transforming
+   * it as such, if the original length has large prime factors.
+   *
+   * ~~~(c++)
+   * int iLength = PiiDsp::fastFftLength(1031); // 1080 = 2^3 * 3^3 * 5
+   * ~~~
+   */
+  inline int fastFftLength(int minimum)
+  {
+    for (int n = qMax(minimum, 1); ; ++n)
+      {
+        int m = n;
+        while (m % 2 == 0) m /= 2;
+        while (m % 3 == 0) m /= 3;
+        while (m % 5 == 0) m /= 5;
+        if (m == 1)
+          return n;
+      }
+  }
+
   /**
    * Calculates the correlation of two signals using the Fourier
    * transform. The fast correlation is defined as
@@ -107,9 +247,7 @@ namespace PiiDsp
                                                          const PiiMatrix<T>& b)
 
   {
-    PiiFft<T> fft;
-    return FastCorrelationConverter<T>::apply(fft.inverseFft(Pii::matrix(Pii::multiplied(fft.forwardFft(a),
-                                                                                         Pii::conj(fft.forwardFft(b))))));
+    return FastCorrelation<T>::apply(a, b);
   }
 
   template <class T> PiiMatrixValue<T> findTranslation(const PiiMatrix<T>& correlation)
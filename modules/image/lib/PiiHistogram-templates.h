@@ -19,39 +19,207 @@
 
 #include <PiiAlgorithm.h>
 #include <PiiFunctional.h>
+#include <QVector>
 
 namespace PiiImage
 {
-  template <class T, class U, class Roi> PiiMatrix<T> histogram(const PiiMatrix<U>& image, const Roi& roi, unsigned int levels)
+  /// @internal
+  template <class Roi> class RoiRow
   {
-    if (levels < 1)
-      levels = unsigned(Pii::max(image)) + 1;
-    PiiMatrix<T> result(1, int(levels));
-    T* vector = result.row(0);
+  public:
+    RoiRow(const Roi& roi, int row) : _roi(roi), _iRow(row) {}
+    inline bool operator() (int column) const { return _roi(_iRow, column); }
+    enum { alwaysTrue = false };
+  private:
+    const Roi& _roi;
+    int _iRow;
+  };
 
-    const int iRows = image.rows(), iCols = image.columns();
-    for (int r=0; r<iRows; ++r)
+  /// @internal
+  template <> class RoiRow<DefaultRoi>
+  {
+  public:
+    RoiRow(const DefaultRoi&, int) {}
+    inline bool operator() (int) const { return true; }
+    enum { alwaysTrue = true };
+  };
+
+  /// @internal
+  template <> class RoiRow<PiiMatrix<bool> >
+  {
+  public:
+    RoiRow(const PiiMatrix<bool>& roi, int row) : _pRow(roi[row]) {}
+    inline bool operator() (int column) const { return _pRow[column]; }
+    enum { alwaysTrue = false };
+  private:
+    const bool* _pRow;
+  };
+
+  /// @internal
+  template <class U> struct DirectBin
+  {
+    inline unsigned operator() (U value) const { return unsigned(value); }
+  };
+
+  /// @internal
+  template <class U> struct QuantizedBin
+  {
+    QuantizedBin(const PiiQuantizer<U>& quantizer) : _pQuantizer(&quantizer) {}
+    inline unsigned operator() (U value) const { return unsigned(_pQuantizer->quantize(value)); }
+    const PiiQuantizer<U>* _pQuantizer;
+  };
+
+  /**
+   * @internal
+   *
+   * The number of histogram copies used for counting. With four
+   * banks, four consecutive pixels never increment the same memory
+   * location even if they have the same value, and the increments
+   * can proceed in parallel. With many levels, the copies would
+   * no longer fit into the L1 cache, and a single bank is used.
+   */
+  inline int histogramBankCount(unsigned levels) { return levels <= 4096 ? 4 : 1; }
+
+  /**
+   * @internal
+   *
+   * Adds the histogram of rows [firstRow, lastRow) of *image* to
+   * *counts*. *banks* must be a zero-initialized buffer of
+   * `bankCount * levels` ints.
+   */
+  template <class U, class Roi, class Bin>
+  void accumulateHistogram(const PiiMatrix<U>& image, const Roi& roi, Bin bin,
+                           unsigned levels, int firstRow, int lastRow,
+                           int* banks, int bankCount, int* counts)
+  {
+    const int iCols = image.columns();
+    int* pBank0 = banks, *pBank1 = banks, *pBank2 = banks, *pBank3 = banks;
+    if (bankCount == 4)
       {
-        const U* row = image.row(r);
-        for (int c=0; c<iCols; ++c)
-          if (unsigned(row[c]) < levels && roi(r,c)) ++vector[unsigned(row[c])];
+        pBank1 += levels;
+        pBank2 += 2*levels;
+        pBank3 += 3*levels;
       }
-    return result;
+
+    for (int r=firstRow; r<lastRow; ++r)
+      {
+        const U* pRow = image.row(r);
+        RoiRow<Roi> rowRoi(roi, r);
+        int c = 0;
+        if (RoiRow<Roi>::alwaysTrue)
+          {
+            for (; c<iCols-3; c+=4)
+              {
+                const unsigned uiBin0 = bin(pRow[c]), uiBin1 = bin(pRow[c+1]),
+                  uiBin2 = bin(pRow[c+2]), uiBin3 = bin(pRow[c+3]);
+                if (uiBin0 < levels) ++pBank0[uiBin0];
+                if (uiBin1 < levels) ++pBank1[uiBin1];
+                if (uiBin2 < levels) ++pBank2[uiBin2];
+                if (uiBin3 < levels) ++pBank3[uiBin3];
+              }
+          }
+        else
+          {
+            for (; c<iCols-3; c+=4)
+              {
+                const unsigned uiBin0 = bin(pRow[c]), uiBin1 = bin(pRow[c+1]),
+                  uiBin2 = bin(pRow[c+2]), uiBin3 = bin(pRow[c+3]);
+                if (uiBin0 < levels && rowRoi(c)) ++pBank0[uiBin0];
+                if (uiBin1 < levels && rowRoi(c+1)) ++pBank1[uiBin1];
+                if (uiBin2 < levels && rowRoi(c+2)) ++pBank2[uiBin2];
+                if (uiBin3 < levels && rowRoi(c+3)) ++pBank3[uiBin3];
+              }
+          }
+        for (; c<iCols; ++c)
+          {
+            const unsigned uiBin = bin(pRow[c]);
+            if (uiBin < levels && rowRoi(c)) ++pBank0[uiBin];
+          }
+      }
+
+    for (int b=0; b<bankCount; ++b, banks += levels)
+      for (unsigned i=0; i<levels; ++i)
+        counts[i] += banks[i];
   }
 
-  template <class T, class U, class Roi> PiiMatrix<T> histogram(const PiiMatrix<U>& image, const Roi& roi, const PiiQuantizer<U>& quantizer)
+  /// @internal
+  template <class U, class Roi, class Bin> class HistogramBandFunction
   {
-    PiiMatrix<T> result(1, quantizer.levels());
-    T* vector = result.row(0);
+  public:
+    HistogramBandFunction(const PiiMatrix<U>& image, const Roi& roi, Bin bin,
+                          unsigned levels, int bandCount, PiiMatrix<int>& bandCounts) :
+      _image(image), _roi(roi), _bin(bin), _uiLevels(levels), _iBandCount(bandCount), _pBandCounts(&bandCounts)
+    {}
 
-    const int iRows = image.rows(), iCols = image.columns();
-    for (int r=0; r<iRows; ++r)
+    void operator() (int firstBand, int lastBand) const
+    {
+      const int iBankCount = histogramBankCount(_uiLevels);
+      QVector<int> vecBanks(iBankCount * _uiLevels);
+      const int iRows = _image.rows();
+      for (int i=firstBand; i<lastBand; ++i)
+        {
+          vecBanks.fill(0);
+          accumulateHistogram(_image, _roi, _bin, _uiLevels,
+                              int(qint64(iRows) * i / _iBandCount),
+                              int(qint64(iRows) * (i+1) / _iBandCount),
+                              vecBanks.data(), iBankCount, (*_pBandCounts)[i]);
+        }
+    }
+
+  private:
+    const PiiMatrix<U>& _image;
+    const Roi& _roi;
+    Bin _bin;
+    unsigned _uiLevels;
+    int _iBandCount;
+    PiiMatrix<int>* _pBandCounts;
+  };
+
+  /// @internal
+  template <class T, class U, class Roi, class Bin>
+  PiiMatrix<T> binnedHistogram(const PiiMatrix<U>& image, const Roi& roi, Bin bin, unsigned levels, int threadCount)
+  {
+    PiiMatrix<int> matCounts(1, int(levels));
+    if (levels == 0)
+      return PiiMatrix<T>(matCounts);
+
+    const int iBands = bandCount(image.rows(), image.columns(), 0, threadCount);
+    if (iBands <= 1)
       {
-        const U* row = image.row(r);
-        for (int c=0; c<iCols; ++c)
-          if (roi(r,c)) ++vector[quantizer.quantize(row[c])];
+        const int iBankCount = histogramBankCount(levels);
+        QVector<int> vecBanks(iBankCount * levels);
+        vecBanks.fill(0);
+        accumulateHistogram(image, roi, bin, levels, 0, image.rows(),
+                            vecBanks.data(), iBankCount, matCounts[0]);
       }
-    return result;
+    else
+      {
+        PiiMatrix<int> matBandCounts(iBands, int(levels));
+        Pii::parallelFor(iBands, iBands,
+                         HistogramBandFunction<U,Roi,Bin>(image, roi, bin, levels, iBands, matBandCounts));
+        int* pCounts = matCounts[0];
+        for (int i=0; i<iBands; ++i)
+          {
+            const int* pBand = matBandCounts[i];
+            for (unsigned j=0; j<levels; ++j)
+              pCounts[j] += pBand[j];
+          }
+      }
+    return PiiMatrix<T>(matCounts);
+  }
+
+  template <class T, class U, class Roi> PiiMatrix<T> histogram(const PiiMatrix<U>& image, const Roi& roi, unsigned int levels,
+                                                                int threadCount)
+  {
+    if (levels < 1)
+      levels = unsigned(Pii::max(image)) + 1;
+    return binnedHistogram<T>(image, roi, DirectBin<U>(), levels, threadCount);
+  }
+
+  template <class T, class U, class Roi> PiiMatrix<T> histogram(const PiiMatrix<U>& image, const Roi& roi, const PiiQuantizer<U>& quantizer,
+                                                                int threadCount)
+  {
+    return binnedHistogram<T>(image, roi, QuantizedBin<U>(quantizer), unsigned(quantizer.levels()), threadCount);
   }
 
   template <class T, class U> PiiMatrix<T> normalize(const PiiMatrix<U>& histogram)
@@ -142,4 +310,145 @@ namespace PiiImage
       }
     return backProject(img, newDist);
   }
+
+  /// @internal
+  struct AdaptiveNeighbors
+  {
+    int first, second;
+    float weight;
+  };
+
+  /**
+   * @internal
+   *
+   * Finds the two tiles whose centers are closest to each pixel along
+   * one dimension. *starts* contains the first pixel of each tile and
+   * the total size as the last element.
+   */
+  inline QVector<AdaptiveNeighbors> adaptiveNeighbors(const QVector<int>& starts)
+  {
+    const int iTiles = starts.size() - 1, iSize = starts[iTiles];
+    QVector<AdaptiveNeighbors> vecResult(iSize);
+    AdaptiveNeighbors* pResult = vecResult.data();
+    int iTile = 0;
+    for (int i=0; i<iSize; ++i)
+      {
+        while (iTile < iTiles-1 && i >= 0.5 * (starts[iTile+1] + starts[iTile+2] - 1))
+          ++iTile;
+        const double dCenter = 0.5 * (starts[iTile] + starts[iTile+1] - 1);
+        if (i < dCenter || iTile == iTiles-1)
+          {
+            // Before the first center or after the last one
+            pResult[i].first = pResult[i].second = iTile;
+            pResult[i].weight = 0;
+          }
+        else
+          {
+            const double dNextCenter = 0.5 * (starts[iTile+1] + starts[iTile+2] - 1);
+            pResult[i].first = iTile;
+            pResult[i].second = iTile + 1;
+            pResult[i].weight = float((i - dCenter) / (dNextCenter - dCenter));
+          }
+      }
+    return vecResult;
+  }
+
+  /**
+   * @internal
+   *
+   * Clips *histogram* to *clipLimit* times the average bin height,
+   * redistributes the excess evenly to all bins and stores the
+   * resulting gray level mapping to *mapping*.
+   */
+  inline void adaptiveMapping(int* histogram, unsigned levels, int pixelCount, double clipLimit, float* mapping)
+  {
+    int iExcess = 0;
+    if (clipLimit > 0)
+      {
+        const int iLimit = qMax(1, int(clipLimit * pixelCount / levels));
+        for (unsigned i=0; i<levels; ++i)
+          if (histogram[i] > iLimit)
+            {
+              iExcess += histogram[i] - iLimit;
+              histogram[i] = iLimit;
+            }
+      }
+
+    // The mapping is fractional anyway, so the excess can be
+    // redistributed exactly.
+    const float fScale = pixelCount > 0 ? float(levels - 1) / pixelCount : 0.0f;
+    const float fIncrement = float(iExcess) / levels;
+    int iSum = 0;
+    for (unsigned i=0; i<levels; ++i)
+      {
+        iSum += histogram[i];
+        mapping[i] = (float(iSum) + fIncrement * (i+1)) * fScale;
+      }
+  }
+
+  template <class T> PiiMatrix<T> equalizeAdaptive(const PiiMatrix<T>& img,
+                                                   int gridRows, int gridColumns,
+                                                   double clipLimit,
+                                                   unsigned int levels)
+  {
+    const int iRows = img.rows(), iCols = img.columns();
+    if (iRows == 0 || iCols == 0)
+      return img;
+
+    unsigned int maxValue = (unsigned int)Pii::max(img);
+    if (levels <= maxValue)
+      levels = maxValue + 1;
+    gridRows = qBound(1, gridRows, iRows);
+    gridColumns = qBound(1, gridColumns, iCols);
+
+    QVector<int> vecRowStarts(gridRows + 1), vecColumnStarts(gridColumns + 1);
+    for (int i=0; i<=gridRows; ++i)
+      vecRowStarts[i] = iRows * i / gridRows;
+    for (int i=0; i<=gridColumns; ++i)
+      vecColumnStarts[i] = iCols * i / gridColumns;
+
+    // Calculate the histogram of each tile and convert it to a gray
+    // level mapping.
+    const int iStride = int(levels);
+    QVector<float> vecMappings(gridRows * gridColumns * iStride);
+    for (int tr=0; tr<gridRows; ++tr)
+      for (int tc=0; tc<gridColumns; ++tc)
+        {
+          const int iTileRows = vecRowStarts[tr+1] - vecRowStarts[tr],
+            iTileColumns = vecColumnStarts[tc+1] - vecColumnStarts[tc];
+          PiiMatrix<int> matHistogram(histogram<int,T,DefaultRoi>(img(vecRowStarts[tr], vecColumnStarts[tc],
+                                                                      iTileRows, iTileColumns),
+                                                                  DefaultRoi(), levels));
+          adaptiveMapping(matHistogram[0], levels, iTileRows * iTileColumns,
+                          clipLimit, vecMappings.data() + (tr * gridColumns + tc) * iStride);
+        }
+
+    // Interpolate between the mappings of the four nearest tiles.
+    const QVector<AdaptiveNeighbors> vecRowNeighbors(adaptiveNeighbors(vecRowStarts)),
+      vecColumnNeighbors(adaptiveNeighbors(vecColumnStarts));
+    const AdaptiveNeighbors* pColumnNeighbors = vecColumnNeighbors.constData();
+    PiiMatrix<T> result(PiiMatrix<T>::uninitialized(iRows, iCols));
+    for (int r=0; r<iRows; ++r)
+      {
+        const AdaptiveNeighbors& rowNeighbors = vecRowNeighbors[r];
+        const float fWeightY = rowNeighbors.weight;
+        // The mappings of all tiles on a tile row are stored
+        // consecutively.
+        const float* const pTopRow = vecMappings.constData() + rowNeighbors.first * gridColumns * iStride;
+        const float* const pBottomRow = vecMappings.constData() + rowNeighbors.second * gridColumns * iStride;
+        const T* pSource = img[r];
+        T* pTarget = result[r];
+        for (int c=0; c<iCols; ++c)
+          {
+            const unsigned uiValue = unsigned(pSource[c]);
+            const int iLeft = pColumnNeighbors[c].first * iStride + uiValue,
+              iRight = pColumnNeighbors[c].second * iStride + uiValue;
+            const float fWeightX = pColumnNeighbors[c].weight;
+            const float fTop = pTopRow[iLeft] + fWeightX * (pTopRow[iRight] - pTopRow[iLeft]);
+            const float fBottom = pBottomRow[iLeft] + fWeightX * (pBottomRow[iRight] - pBottomRow[iLeft]);
+            pTarget[c] = T(fTop + fWeightY * (fBottom - fTop) + 0.5f);
+          }
+      }
+    return result;
+  }
 }
@@ -38,17 +38,39 @@ namespace PiiImage
    * is given, the maximum value of the image will be found. For 8 bit
    * gray-scale images, use 256.
    *
+   * @param threadCount the maximum number of threads. Large images
+   * are divided into horizontal bands whose histograms are calculated
+   * in parallel and summed up at the end. 0 means one thread per
+   * processor core.
+   *
    * @return the histogram as a PiiMatrix<T>
+   *
+   * Consecutive pixels are counted into separate copies of the
+   * histogram (banks) that are merged at the end. This keeps
+   * successive increments of the same bin independent of each other
+   * and makes the speed of the function insensitive to the contents
+   * of the image. *roi* can be any function object, but
+   * [DefaultRoi] and `PiiMatrix<bool>` masks are recognized and
+   * handled row by row without calling the function for each pixel.
+   *
+   * ~~~(c++)
+   * PiiMatrix<unsigned char> image(480, 640);
+   * PiiMatrix<bool> matMask(480, 640);
+   * // Count masked pixels only, use all processor cores
+   * PiiMatrix<int> matHistogram(PiiImage::histogram<int>(image, matMask, 256, 0));
+   * ~~~
    */
-  template <class T, class U, class Roi> PiiMatrix<T> histogram(const PiiMatrix<U>& image, const Roi& roi, unsigned int levels);
+  template <class T, class U, class Roi> PiiMatrix<T> histogram(const PiiMatrix<U>& image, const Roi& roi, unsigned int levels,
+                                                                int threadCount = 1);
 
   /**
    * Calculate the histogram of a one-channel image. This is a
-   * shorthand for `histogram<int>(image, roi, levels)`.
+   * shorthand for `histogram<int>(image, roi, levels, threadCount)`.
    */
-  template <class T, class Roi> inline PiiMatrix<int> histogram(const PiiMatrix<T>& image, const Roi& roi, unsigned int levels)
+  template <class T, class Roi> inline PiiMatrix<int> histogram(const PiiMatrix<T>& image, const Roi& roi, unsigned int levels,
+                                                                int threadCount = 1)
   {
-    return histogram<int,T,Roi>(image, roi, levels);
+    return histogram<int,T,Roi>(image, roi, levels, threadCount);
   }
 
   /**
@@ -76,8 +98,11 @@ namespace PiiImage
    *
    * @param quantizer a quantizer that converts image pixels into
    * quantized values.
+   *
+   * @param threadCount the maximum number of threads, see above.
    */
-  template <class T, class U, class Roi> PiiMatrix<T> histogram(const PiiMatrix<U>& image, const Roi& roi, const PiiQuantizer<U>& quantizer);
+  template <class T, class U, class Roi> PiiMatrix<T> histogram(const PiiMatrix<U>& image, const Roi& roi, const PiiQuantizer<U>& quantizer,
+                                                                int threadCount = 1);
 
   /**
    * Calculate the histogram of a one-channel image. This is a
@@ -229,6 +254,46 @@ namespace PiiImage
    * @return an image with enhanced contrast
    */
   template <class T> PiiMatrix<T> equalize(const PiiMatrix<T>& img, unsigned int levels = 0);
+
+  /**
+   * Contrast-limited adaptive histogram equalization (CLAHE). Divides
+   * *img* into a grid of *gridRows* -by- *gridColumns* tiles and
+   * equalizes each tile separately. To avoid boundaries between the
+   * tiles, the value of each pixel is bilinearly interpolated from the
+   * gray level mappings of the four tiles whose centers are closest
+   * to the pixel. Each tile histogram is calculated only once, so the
+   * cost of the function is roughly that of two passes over the
+   * image, independent of the tile size.
+   *
+   * Plain adaptive equalization amplifies noise in homogeneous
+   * regions. Therefore, the height of each tile histogram is limited
+   * to *clipLimit* times the average bin height before the mapping is
+   * calculated. The clipped counts are redistributed uniformly over
+   * all bins. Typical values for *clipLimit* are in the range 2-4.
+   * Zero or a negative value disables clipping.
+   *
+   * @param img the input image. Any integer type.
+   *
+   * @param gridRows the number of tile rows. Limited to the number of
+   * rows in *img*.
+   *
+   * @param gridColumns the number of tile columns. Limited to the
+   * number of columns in *img*.
+   *
+   * @param clipLimit the maximum height of a histogram bin relative
+   * to the average.
+   *
+   * @param levels the number of quantization levels, see
+   * [equalize()].
+   *
+   * ~~~(c++)
+   * PiiMatrix<unsigned char> matEnhanced(PiiImage::equalizeAdaptive(image, 8, 8, 3.0, 256));
+   * ~~~
+   */
+  template <class T> PiiMatrix<T> equalizeAdaptive(const PiiMatrix<T>& img,
+                                                   int gridRows = 8, int gridColumns = 8,
+                                                   double clipLimit = 3.0,
+                                                   unsigned int levels = 0);
 };
 
 #include "PiiHistogram-templates.h"
@@ -20,6 +20,9 @@
 #include <PiiGeometricObjects.h>
 #include "PiiThresholding.h"
 #include <fast.h>
+#include <PiiFft.h>
+#include <cstring>
+#include <cmath>
 
 #include <PiiMatrixUtil.h>
 #include <PiiMath.h>
@@ -465,7 +468,76 @@ namespace PiiImage
     return matResult;
   }
 
-  // PENDING use histogram-based filtering for large neighborhoods
+  template <class T> inline void sortPair(T& a, T& b)
+  {
+    const T tmp(qMin(a, b));
+    b = qMax(a, b);
+    a = tmp;
+  }
+
+  /* 3x3 median. Each column of three pixels is sorted once and
+   * shared by three adjacent windows. The median of the window is
+   * the median of the largest column minimum, the median of column
+   * medians and the smallest column maximum.
+   */
+  template <class T> void median3x3(const PiiMatrix<T>& image, PiiMatrix<T>& result)
+  {
+    const int iCols = image.columns();
+    QVarLengthArray<T,1024> sorted(3 * iCols);
+    T* pMin = &sorted[0], *pMid = pMin + iCols, *pMax = pMid + iCols;
+    for (int r=0; r<result.rows(); ++r)
+      {
+        const T* pRow0 = image[r], *pRow1 = image[r+1], *pRow2 = image[r+2];
+        for (int c=0; c<iCols; ++c)
+          {
+            T a = pRow0[c], b = pRow1[c], d = pRow2[c];
+            sortPair(a, b); sortPair(b, d); sortPair(a, b);
+            pMin[c] = a; pMid[c] = b; pMax[c] = d;
+          }
+        T* pTarget = result[r];
+        for (int c=0; c<result.columns(); ++c)
+          {
+            T lo = qMax(qMax(pMin[c], pMin[c+1]), pMin[c+2]);
+            T hi = qMin(qMin(pMax[c], pMax[c+1]), pMax[c+2]);
+            T m0 = pMid[c], m1 = pMid[c+1], m2 = pMid[c+2];
+            sortPair(m0, m1); sortPair(m1, m2); sortPair(m0, m1);
+            sortPair(lo, m1); sortPair(m1, hi); sortPair(lo, m1);
+            pTarget[c] = m1;
+          }
+      }
+  }
+
+  template <class T> PiiMatrix<T> paddedMedianFilter(const PiiMatrix<T>& image,
+                                                     int windowRows, int windowColumns)
+  {
+    PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(image.rows() - windowRows + 1,
+                                                       image.columns() - windowColumns + 1));
+    if (windowRows == 3 && windowColumns == 3)
+      {
+        median3x3(image, matResult);
+        return matResult;
+      }
+
+    const int iNeighborhoodSize = windowRows * windowColumns;
+    const bool b5x5 = windowRows == 5 && windowColumns == 5;
+    QVarLengthArray<T,256> neighborhood(iNeighborhoodSize);
+    T* pBuffer = &neighborhood[0];
+    for (int r=0; r<matResult.rows(); ++r)
+      {
+        T* pTarget = matResult[r];
+        for (int c=0; c<matResult.columns(); ++c)
+          {
+            T* pNeighborhood = pBuffer;
+            for (int fr=0; fr<windowRows; ++fr, pNeighborhood += windowColumns)
+              std::copy(image[r+fr] + c, image[r+fr] + c + windowColumns, pNeighborhood);
+            pTarget[c] = b5x5 ?
+              Pii::median25(pBuffer) :
+              Pii::medianN(pBuffer, iNeighborhoodSize);
+          }
+      }
+    return matResult;
+  }
+
   template <class T> PiiMatrix<T> medianFilter(const PiiMatrix<T>& image,
                                                int windowRows, int windowColumns,
                                                Pii::ExtendMode mode)
@@ -474,41 +546,15 @@ namespace PiiImage
     if (windowColumns <= 0) windowColumns = windowRows;
     if (windowRows > iRows) windowRows = iRows;
     if (windowColumns > iCols) windowColumns = iCols;
+    if (windowRows <= 0 || windowColumns <= 0)
+      return image;
     int rows = windowRows / 2, cols = windowColumns / 2;
-    PiiMatrix<T> result(Pii::extend(image, rows, rows, cols, cols, mode));
-
-    // Allocate an array to which the entire neigbhborhood will be
-    // stored.
-    int neighborhoodSize = windowRows * windowColumns;
-    T* neighborhood = new T[neighborhoodSize];
-    int filterRowBytes = windowColumns * sizeof(T);
-
-    T** rowPtrs = new T*[windowRows];
-    // Modify the result matrix in place
-    for (int r=0; r<=result.rows()-windowRows; ++r)
-      {
-        // Initialize the rows that will be affected when filtering a
-        // single row of image.
-        for (int fr=0; fr<windowRows; ++fr)
-          rowPtrs[fr] = result.row(r+fr);
-
-        for (int c=0; c<=result.columns()-windowColumns; ++c)
-          {
-            // fill in the neighborhood array
-            T* ptr = neighborhood;
-            for (int fr=windowRows; fr--; ptr+=windowColumns)
-              std::memcpy(ptr, rowPtrs[fr]+c, filterRowBytes);
-            // It is safe to store the result here because this pixel
-            // won't be used again.
-            rowPtrs[0][c] = Pii::medianN(neighborhood, neighborhoodSize);
-          }
-      }
-    delete[] neighborhood;
-    delete[] rowPtrs;
+    PiiMatrix<T> matResult(paddedMedianFilter(Pii::extend(image, rows, rows, cols, cols, mode),
+                                              windowRows, windowColumns));
     if (mode != Pii::ExtendNot)
-      return result(0, 0, image.rows(), image.columns());
+      return matResult(0, 0, image.rows(), image.columns());
     else
-      return result(0, 0, -windowRows, -windowColumns);
+      return matResult;
   }
 
 
@@ -754,8 +800,45 @@ namespace PiiImage
                   padded);
   }
 
-  template <class GreaterThan, class T, class U>
-  inline void takeExtremum(GreaterThan greater, T& a, U b) { if (greater(b, a)) a = b; }
+  template <class GreaterThan, class T>
+  inline T extremum(GreaterThan greater, T a, T b) { return greater(b, a) ? b : a; }
+
+  /* Van Herk/Gil-Werman running extremum. Stores the extremum of
+   * input[i-before, i-before+window) to output[i] for each i in [0,
+   * length). Values outside of the input are ignored. The padded
+   * input is split into blocks of *window* elements. Within each
+   * block, *buffer* holds cumulative extrema from the start and from
+   * the end of the block. Any window covers the end of one block and
+   * the start of the next one, and each output takes three
+   * comparisons irrespective of window size. *buffer* must be able to
+   * hold 3 * (length + window - 1) elements.
+   */
+  template <class T, class GreaterThan>
+  void runningExtremum(const T* input, T* output, int length, int window, int before,
+                       GreaterThan greater, T identity, T* buffer)
+  {
+    const int iPadded = length + window - 1;
+    T* pPadded = buffer;
+    T* pForward = buffer + iPadded;
+    T* pBackward = pForward + iPadded;
+    const int iHead = qMin(before, iPadded);
+    std::fill(pPadded, pPadded + iHead, identity);
+    std::copy(input, input + qMin(length, iPadded - iHead), pPadded + iHead);
+    std::fill(pPadded + qMin(iHead + length, iPadded), pPadded + iPadded, identity);
+
+    for (int iStart=0; iStart<iPadded; iStart+=window)
+      {
+        const int iEnd = qMin(iStart + window, iPadded);
+        pForward[iStart] = pPadded[iStart];
+        for (int i=iStart+1; i<iEnd; ++i)
+          pForward[i] = extremum(greater, pForward[i-1], pPadded[i]);
+        pBackward[iEnd-1] = pPadded[iEnd-1];
+        for (int i=iEnd-1; i-- > iStart; )
+          pBackward[i] = extremum(greater, pBackward[i+1], pPadded[i]);
+      }
+    for (int i=0; i<length; ++i)
+      output[i] = extremum(greater, pBackward[i], pForward[i + window - 1]);
+  }
 
   template <class T, class GreaterThan>
   PiiMatrix<T> extremumFilter(const PiiMatrix<T>& image,
@@ -764,68 +847,73 @@ namespace PiiImage
                               T initialValue)
   {
     const int iRows = image.rows(), iCols = image.columns();
-    PiiMatrix<T> matResult(PiiMatrix<T>::constant(iRows, iCols, initialValue));
     if (windowColumns <= 0) windowColumns = windowRows;
-    if (windowRows > iRows) windowRows = iRows;
-    if (windowColumns > iCols) windowColumns = iCols;
+    windowRows = qBound(1, windowRows, iRows);
+    windowColumns = qBound(1, windowColumns, iCols);
+    if (iRows == 0 || iCols == 0)
+      return PiiMatrix<T>(iRows, iCols);
 
-    const int iLeftCols = windowColumns / 2, iRightCols = windowColumns - iLeftCols;
+    PiiMatrix<T> matHorizontal(PiiMatrix<T>::uninitialized(iRows, iCols));
+    QVarLengthArray<T,1024> rowBuffer(3 * (iCols + windowColumns - 1));
     for (int r=0; r<iRows; ++r)
+      runningExtremum(image[r], matHorizontal[r], iCols, windowColumns, windowColumns / 2,
+                      greater, initialValue, &rowBuffer[0]);
+
+    // The vertical pass processes full rows at a time to keep memory
+    // accesses sequential.
+    const int iTopRows = windowRows / 2, iPadded = iRows + windowRows - 1;
+    PiiMatrix<T> matForward(PiiMatrix<T>::uninitialized(iPadded, iCols));
+    PiiMatrix<T> matBackward(PiiMatrix<T>::uninitialized(iPadded, iCols));
+    for (int r=0; r<iPadded; ++r)
       {
-        typename PiiMatrix<T>::const_row_iterator pSourceRow = image[r];
-        typename PiiMatrix<T>::row_iterator pTargetRow = matResult[r];
-        // We handle both edges separately to avoid boundary checks in
-        // the middle.
-        for (int c=0; c<iLeftCols; ++c)
-          for (int c2=0; c2<c+iRightCols; ++c2)
-            takeExtremum(greater, pTargetRow[c], pSourceRow[c2]);
-        for (int c=iLeftCols; c<iCols-iRightCols; ++c)
-          for (int c2=c-iLeftCols; c2<c+iRightCols; ++c2)
-            takeExtremum(greater, pTargetRow[c], pSourceRow[c2]);
-        for (int c=iCols-iRightCols; c<iCols; ++c)
-          for (int c2=c-iLeftCols; c2<iCols; ++c2)
-            takeExtremum(greater, pTargetRow[c], pSourceRow[c2]);
-      }
-
-    const int iTopRows = windowRows / 2, iBottomRows = windowRows - iTopRows;
-    // Cyclic temporary buffer for data that cannot be written to the
-    // result matrix yet.
-    QVarLengthArray<T,8> tmpBfr(iTopRows);
-
-    for (int c=0; c<iCols; ++c)
-      {
-        typename PiiMatrix<T>::column_iterator pTargetCol = matResult.columnBegin(c);
-
-        // Initialize the buffer with values that cannot be written yet.
-        for (int r=0; r<iTopRows; ++r)
+        const int iSource = r - iTopRows;
+        const T* pSource = iSource >= 0 && iSource < iRows ? matHorizontal[iSource] : 0;
+        T* pForward = matForward[r];
+        if (r % windowRows == 0)
           {
-            tmpBfr[r] = initialValue;
-            for (int r2=0; r2<r+iBottomRows; ++r2)
-              takeExtremum(greater, tmpBfr[r], pTargetCol[r2]);
+            if (pSource != 0)
+              std::copy(pSource, pSource + iCols, pForward);
+            else
+              std::fill(pForward, pForward + iCols, initialValue);
           }
-
-        for (int r=iTopRows; r<iRows-iBottomRows; ++r)
+        else if (pSource != 0)
+          {
+            const T* pPrevious = matForward[r-1];
+            for (int c=0; c<iCols; ++c)
+              pForward[c] = extremum(greater, pPrevious[c], pSource[c]);
+          }
+        else
+          std::copy(matForward[r-1], matForward[r-1] + iCols, pForward);
+      }
+    for (int r=iPadded; r--; )
+      {
+        const int iSource = r - iTopRows;
+        const T* pSource = iSource >= 0 && iSource < iRows ? matHorizontal[iSource] : 0;
+        T* pBackward = matBackward[r];
+        if (r == iPadded-1 || (r+1) % windowRows == 0)
           {
-            // Write the oldest value from the buffer and update.
-            int iBfrIndex = r % iTopRows;
-            T oldMax = tmpBfr[iBfrIndex];
-            tmpBfr[iBfrIndex] = initialValue;
-            for (int r2=r-iTopRows; r2<r+iBottomRows; ++r2)
-              takeExtremum(greater, tmpBfr[iBfrIndex], pTargetCol[r2]);
-            pTargetCol[r-iTopRows] = oldMax;
+            if (pSource != 0)
+              std::copy(pSource, pSource + iCols, pBackward);
+            else
+              std::fill(pBackward, pBackward + iCols, initialValue);
           }
-        for (int r=iRows-iBottomRows; r<iRows; ++r)
+        else if (pSource != 0)
           {
-            int iBfrIndex = r % iTopRows;
-            T oldMax = tmpBfr[iBfrIndex];
-            tmpBfr[iBfrIndex] = initialValue;
-            for (int r2=r-iTopRows; r2<iRows; ++r2)
-              takeExtremum(greater, tmpBfr[iBfrIndex], pTargetCol[r2]);
-            pTargetCol[r-iTopRows] = oldMax;
+            const T* pNext = matBackward[r+1];
+            for (int c=0; c<iCols; ++c)
+              pBackward[c] = extremum(greater, pNext[c], pSource[c]);
           }
-        // Write the remaining values from the buffer.
-        for (int r=iRows-iTopRows; r<iRows; ++r)
-          pTargetCol[r] = tmpBfr[r % iTopRows];
+        else
+          std::copy(matBackward[r+1], matBackward[r+1] + iCols, pBackward);
+      }
+
+    PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(iRows, iCols));
+    for (int r=0; r<iRows; ++r)
+      {
+        const T* pBackward = matBackward[r], *pForward = matForward[r + windowRows - 1];
+        T* pTarget = matResult[r];
+        for (int c=0; c<iCols; ++c)
+          pTarget[c] = extremum(greater, pBackward[c], pForward[c]);
       }
 
     return matResult;
@@ -931,6 +1019,164 @@ namespace PiiImage
     return true;
   }
 
+  /// @internal
+  inline int extendedIndex(int index, int size, Pii::ExtendMode mode)
+  {
+    if (uint(index) < uint(size))
+      return index;
+    switch (mode)
+      {
+      case Pii::ExtendReplicate:
+        return index < 0 ? 0 : size-1;
+      case Pii::ExtendSymmetric:
+        return index < 0 ? qMin(-index-1, size-1) : qMax(2*size-1-index, 0);
+      case Pii::ExtendPeriodic:
+        index %= size;
+        return index < 0 ? index + size : index;
+      default:
+        return -1;
+      }
+  }
+
+  /* The position of the filter's origin, and the number of output
+     rows/columns in the given extension mode. These match what
+     PiiDsp::filter() used to produce from a Pii::extend()ed image.
+   */
+  /// @internal
+  inline int filterOrigin(int filterSize, Pii::ExtendMode mode)
+  {
+    return mode == Pii::ExtendZeros ? (filterSize - 1) >> 1 : filterSize >> 1;
+  }
+
+  /// @internal
+  inline int filteredSize(int size, int filterSize, Pii::ExtendMode mode)
+  {
+    return size + filterOrigin(filterSize, mode) + (filterSize >> 1) - filterSize + 1;
+  }
+
+  /* Adds the correlation of a source row and a filter row to an
+     output row. The interior is processed one filter tap at a time
+     over the whole row, which lets the compiler vectorize the inner
+     loop. Only the columns close to the borders need index mapping.
+   */
+  /// @internal
+  template <class ResultType, class T, class U>
+  void filterRow(const T* source, int columns,
+                 const U* filter, int filterColumns, int left,
+                 Pii::ExtendMode mode,
+                 ResultType* output, int outputColumns)
+  {
+    const int iInteriorStart = qMin(left, outputColumns),
+      iInteriorEnd = qMax(iInteriorStart, qMin(outputColumns, columns - filterColumns + 1 + left));
+
+    for (int j=0; j<filterColumns; ++j)
+      {
+        const ResultType weight(filter[j]);
+        const T* pSource = source + j - left;
+        for (int c=iInteriorStart; c<iInteriorEnd; ++c)
+          output[c] += ResultType(pSource[c]) * weight;
+      }
+
+    for (int c=0; c<outputColumns; ++c)
+      {
+        if (c == iInteriorStart)
+          c = iInteriorEnd;
+        if (c >= outputColumns)
+          break;
+        for (int j=0; j<filterColumns; ++j)
+          {
+            const int x = extendedIndex(c - left + j, columns, mode);
+            if (x >= 0)
+              output[c] += ResultType(source[x]) * ResultType(filter[j]);
+          }
+      }
+  }
+
+  /// @internal
+  template <class ResultType, class T, class U>
+  bool fftFilter(const PiiMatrix<T>&, const PiiMatrix<U>&, Pii::ExtendMode, PiiMatrix<ResultType>&, Pii::False)
+  {
+    return false;
+  }
+
+  /* Correlation in the frequency domain. The extended image is
+     written directly into the zero-padded transform buffer.
+   */
+  /// @internal
+  template <class ResultType, class T, class U>
+  bool fftFilter(const PiiMatrix<T>& image, const PiiMatrix<U>& filter, Pii::ExtendMode mode,
+                 PiiMatrix<ResultType>& result, Pii::True)
+  {
+    const int iRows = image.rows(), iCols = image.columns(),
+      iFiltRows = filter.rows(), iFiltCols = filter.columns(),
+      iTop = filterOrigin(iFiltRows, mode), iLeft = filterOrigin(iFiltCols, mode),
+      iOutRows = filteredSize(iRows, iFiltRows, mode), iOutCols = filteredSize(iCols, iFiltCols, mode),
+      iExtRows = iOutRows + iFiltRows - 1, iExtCols = iOutCols + iFiltCols - 1,
+      iFftRows = PiiDsp::fastFftLength(iExtRows), iFftCols = PiiDsp::fastFftLength(iExtCols);
+
+    // The cost of a direct correlation grows with filter area, that
+    // of three real transforms with log(N). The constant was
+    // measured on x86-64.
+    const double dFftPixels = double(iFftRows) * iFftCols;
+    if (double(iFiltRows) * iFiltCols * iOutRows * iOutCols <
+        8.0 * dFftPixels * std::log(dFftPixels) / M_LN2)
+      return false;
+
+    PiiMatrix<ResultType> matExtended(iFftRows, iFftCols);
+    for (int r=0; r<iExtRows; ++r)
+      {
+        const int y = extendedIndex(r - iTop, iRows, mode);
+        if (y < 0)
+          continue;
+        const T* pSource = image[y];
+        ResultType* pTarget = matExtended[r];
+        for (int c=0; c<iExtCols; ++c)
+          {
+            const int x = c - iLeft;
+            if (uint(x) < uint(iCols))
+              pTarget[c] = ResultType(pSource[x]);
+            else
+              {
+                const int iMapped = extendedIndex(x, iCols, mode);
+                if (iMapped >= 0)
+                  pTarget[c] = ResultType(pSource[iMapped]);
+              }
+          }
+      }
+    PiiMatrix<ResultType> matFilter(iFftRows, iFftCols);
+    matFilter(0, 0, iFiltRows, iFiltCols) << PiiMatrix<ResultType>(filter);
+
+    result = PiiMatrix<ResultType>(PiiDsp::fastCorrelation(matExtended, matFilter)(0, 0, iOutRows, iOutCols));
+    return true;
+  }
+
+  template <class ResultType, class T, class U>
+  PiiMatrix<ResultType> filter(const PiiMatrix<T>& image,
+                               const PiiMatrix<U>& filter,
+                               Pii::ExtendMode mode)
+  {
+    const int iRows = image.rows(), iCols = image.columns(),
+      iFiltRows = filter.rows(), iFiltCols = filter.columns();
+    if (mode == Pii::ExtendNot || iRows == 0 || iCols == 0 || iFiltRows == 0 || iFiltCols == 0)
+      return PiiDsp::filter<ResultType>(image, filter, PiiDsp::FilterValidPart);
+
+    PiiMatrix<ResultType> matResult;
+    if (fftFilter(image, filter, mode, matResult, Pii::IsFloatingPoint<ResultType>()))
+      return matResult;
+
+    const int iTop = filterOrigin(iFiltRows, mode), iLeft = filterOrigin(iFiltCols, mode),
+      iOutRows = filteredSize(iRows, iFiltRows, mode), iOutCols = filteredSize(iCols, iFiltCols, mode);
+    matResult = PiiMatrix<ResultType>(iOutRows, iOutCols);
+    for (int r=0; r<iOutRows; ++r)
+      for (int i=0; i<iFiltRows; ++i)
+        {
+          const int y = extendedIndex(r - iTop + i, iRows, mode);
+          if (y >= 0)
+            filterRow(image[y], iCols, filter[i], iFiltCols, iLeft, mode, matResult[r], iOutCols);
+        }
+    return matResult;
+  }
+
   template <class ResultType, class T, class U>
   PiiMatrix<ResultType> filter(const PiiMatrix<T>& image,
                                const PiiMatrix<U>& horizontalFilter,
@@ -940,14 +1186,37 @@ namespace PiiImage
     if (horizontalFilter.rows() != 1 || verticalFilter.columns() != 1)
       return PiiMatrix<ResultType>(image);
 
-    if (mode == Pii::ExtendZeros)
-      return PiiDsp::filter<ResultType>(PiiDsp::filter<ResultType>(image, horizontalFilter, PiiDsp::FilterOriginalSize),
-                                        verticalFilter, PiiDsp::FilterOriginalSize);
+    const int iRows = image.rows(), iCols = image.columns(),
+      iFiltRows = verticalFilter.rows(), iFiltCols = horizontalFilter.columns();
+    if (mode == Pii::ExtendNot || iRows == 0 || iCols == 0 || iFiltRows == 0 || iFiltCols == 0)
+      return PiiDsp::filter<ResultType>(PiiDsp::filter<ResultType>(image, horizontalFilter, PiiDsp::FilterValidPart),
+                                        verticalFilter, PiiDsp::FilterValidPart);
 
-    const int rows = verticalFilter.rows() >> 1, cols = horizontalFilter.columns() >> 1;
-    return PiiDsp::filter<ResultType>(PiiDsp::filter<ResultType>(Pii::extend(image, rows, rows, cols, cols, mode),
-                                                                 horizontalFilter, PiiDsp::FilterValidPart),
-                                      verticalFilter, PiiDsp::FilterValidPart);
+    const int iTop = filterOrigin(iFiltRows, mode), iLeft = filterOrigin(iFiltCols, mode),
+      iOutRows = filteredSize(iRows, iFiltRows, mode), iOutCols = filteredSize(iCols, iFiltCols, mode);
+
+    // Horizontal pass over the rows of the original image only. The
+    // vertical pass maps extended rows to these.
+    PiiMatrix<ResultType> matRows(iRows, iOutCols);
+    for (int r=0; r<iRows; ++r)
+      filterRow(image[r], iCols, horizontalFilter[0], iFiltCols, iLeft, mode, matRows[r], iOutCols);
+
+    PiiMatrix<ResultType> matResult(iOutRows, iOutCols);
+    for (int r=0; r<iOutRows; ++r)
+      {
+        ResultType* pTarget = matResult[r];
+        for (int i=0; i<iFiltRows; ++i)
+          {
+            const int y = extendedIndex(r - iTop + i, iRows, mode);
+            if (y < 0)
+              continue;
+            const ResultType weight(verticalFilter(i,0));
+            const ResultType* pSource = matRows[y];
+            for (int c=0; c<iOutCols; ++c)
+              pTarget[c] += pSource[c] * weight;
+          }
+      }
+    return matResult;
   }
 
   template <class ResultType, class ImageType>
@@ -1188,6 +1457,7 @@ namespace PiiImage
                                                  const PiiMatrix<PiiPoint<U> >& map)
   {
     const int iRows = map.rows(), iCols = map.columns();
+    const int iLastRow = image.rows()-1, iLastCol = image.columns()-1;
     PiiMatrix<T> matResult(iRows, iCols);
     for (int r=0; r<iRows; ++r)
       {
@@ -1196,8 +1466,10 @@ namespace PiiImage
         for (int c=0; c<iCols; ++c)
           {
             PiiPoint<U> pt = pMapRow[c];
-            if (pt.x >= 0 && pt.x < iCols &&
-                pt.y >= 0 && pt.y < iRows)
+            // Interpolation reads the next row and column unless the
+            // coordinate is integral.
+            if (pt.x >= 0 && pt.x <= iLastCol &&
+                pt.y >= 0 && pt.y <= iLastRow)
               pResultRow[c] = T(Pii::valueAt(image, pt.y, pt.x));
           }
       }
@@ -1396,4 +1668,80 @@ namespace PiiImage
         r1 = r2;
       }
   }
+
+  /// @internal
+  template <class T, class U, class Function> class BandFunction
+  {
+  public:
+    BandFunction(const PiiMatrix<T>& image, PiiMatrix<U>& result, int halo, Function function) :
+      _pImage(image.row(0)), _iImageStride(image.stride()),
+      _pResult(result.row(0)), _iResultStride(result.stride()),
+      _iRows(image.rows()), _iColumns(image.columns()), _iHalo(halo),
+      _function(function)
+    {}
+
+    void operator() (int firstRow, int lastRow) const
+    {
+      const int iTop = qMin(_iHalo, firstRow), iBottom = qMin(_iHalo, _iRows - lastRow);
+      const PiiMatrix<T> matBand(lastRow - firstRow + iTop + iBottom, _iColumns,
+                                 const_cast<T*>(rowAt(_pImage, _iImageStride, firstRow - iTop)),
+                                 Pii::RetainOwnership, _iImageStride);
+      const PiiMatrix<U> matResult(_function(matBand));
+      Q_ASSERT(matResult.rows() == matBand.rows() && matResult.columns() == _iColumns);
+      for (int r=firstRow; r<lastRow; ++r)
+        memcpy(rowAt(_pResult, _iResultStride, r), matResult.row(r - firstRow + iTop), sizeof(U) * _iColumns);
+    }
+
+  private:
+    template <class V> static V* rowAt(V* data, std::size_t stride, int row)
+    {
+      return reinterpret_cast<V*>(reinterpret_cast<char*>(data) + stride * row);
+    }
+    template <class V> static const V* rowAt(const V* data, std::size_t stride, int row)
+    {
+      return reinterpret_cast<const V*>(reinterpret_cast<const char*>(data) + stride * row);
+    }
+
+    const T* _pImage;
+    std::size_t _iImageStride;
+    U* _pResult;
+    std::size_t _iResultStride;
+    int _iRows, _iColumns, _iHalo;
+    Function _function;
+  };
+
+  /// @internal
+  template <class U, class T, class Object> class MemberBandFunction
+  {
+  public:
+    MemberBandFunction(const Object* object, PiiMatrix<U> (Object::*function)(const PiiMatrix<T>&) const) :
+      _pObject(object), _function(function)
+    {}
+
+    PiiMatrix<U> operator() (const PiiMatrix<T>& band) const { return (_pObject->*_function)(band); }
+
+  private:
+    const Object* _pObject;
+    PiiMatrix<U> (Object::*_function)(const PiiMatrix<T>&) const;
+  };
+
+  template <class U, class T, class Function>
+  PiiMatrix<U> processInBands(const PiiMatrix<T>& image, int halo, int threadCount, Function function)
+  {
+    const int iRows = image.rows();
+    const int iBands = bandCount(iRows, image.columns(), halo, threadCount);
+    if (iBands <= 1)
+      return function(image);
+
+    PiiMatrix<U> result(PiiMatrix<U>::uninitialized(iRows, image.columns()));
+    Pii::parallelFor(iRows, iBands, BandFunction<T,U,Function>(image, result, halo, function));
+    return result;
+  }
+
+  template <class U, class T, class Object>
+  PiiMatrix<U> processInBands(const PiiMatrix<T>& image, int halo, int threadCount,
+                              const Object* object, PiiMatrix<U> (Object::*function)(const PiiMatrix<T>&) const)
+  {
+    return processInBands<U>(image, halo, threadCount, MemberBandFunction<U,T,Object>(object, function));
+  }
 }
@@ -150,27 +150,9 @@ namespace PiiImage
     if (nonZeroSums(iVSum, dVSum))
       dVScale = double(iVSum) / dVSum;
 
-    if (mode == Pii::ExtendZeros)
-      {
-        PiiMatrix<int> filtered = PiiDsp::filter<int>(PiiDsp::filter<int>(image,
-                                                                          horizontalIntegerFilter,
-                                                                          PiiDsp::FilterOriginalSize),
-                                                      verticalIntegerFilter,
-                                                      PiiDsp::FilterOriginalSize);
-        // Readable? Not. Scales each element as doubles and rounds
-        // the result to an int.
-        filtered.map(Pii::unaryCompose(Pii::Round<double,int>(),
-                                       std::bind2nd(std::multiplies<double>(),
-                                                    1.0/(dVScale*dHScale))));
-        return filtered;
-      }
-
-    const int rows = verticalFilter.rows() >> 1, cols = horizontalFilter.columns() >> 1;
-    PiiMatrix<int> filtered = PiiDsp::filter<int>(PiiDsp::filter<int>(Pii::extend(image, rows, rows, cols, cols, mode),
-                                                                      horizontalIntegerFilter,
-                                                                      PiiDsp::FilterValidPart),
-                                                  verticalIntegerFilter, PiiDsp::FilterValidPart);
-    // Scale back, see above
+    PiiMatrix<int> filtered = filter<int>(image, horizontalIntegerFilter, verticalIntegerFilter, mode);
+    // Readable? Not. Scales each element as doubles and rounds the
+    // result to an int.
     filtered.map(Pii::unaryCompose(Pii::Round<double,int>(),
                                    std::bind2nd(std::multiplies<double>(),
                                                 1.0/(dVScale*dHScale))));
@@ -264,4 +246,13 @@ namespace PiiImage
       }
     return matMask;
   }
+
+  int bandCount(int rows, int columns, int halo, int threadCount)
+  {
+    // Duplicated halo rows and thread switches must not eat up the
+    // gain.
+    const int iMinBandRows = qMax(8, 4 * halo), iMinBandPixels = 1 << 15;
+    return qMax(1, qMin(qMin(Pii::parallelThreadCount(threadCount), rows / iMinBandRows),
+                        int(qint64(rows) * columns / iMinBandPixels)));
+  }
 }
@@ -22,6 +22,7 @@
 #include <PiiDsp.h>
 #include <PiiColor.h>
 #include <PiiPoint.h>
+#include <PiiParallel.h>
 
 /**
  * Definitions and functions for image processing.
@@ -494,6 +495,13 @@ namespace PiiImage
    *                                                     Pii::ExtendZeros);
    * ~~~
    *
+   * The image is not copied to a padded buffer. Pixels outside of
+   * the image are mapped back to the image (or replaced with zeros)
+   * only for the output pixels close to the borders. If the result
+   * type is `float` or `double` and the filter is large, the
+   * filtering is done in the frequency domain with PiiFft, which
+   * makes the processing time almost independent of filter size.
+   *
    * ! It is not a good idea to use `unsigned char` as the
    * result type. If the filters are `double`, use `double` as the
    * output type.
@@ -501,13 +509,7 @@ namespace PiiImage
   template <class ResultType, class T, class U>
   PiiMatrix<ResultType> filter(const PiiMatrix<T>& image,
                                const PiiMatrix<U>& filter,
-                               Pii::ExtendMode mode = Pii::ExtendReplicate)
-  {
-    if (mode == Pii::ExtendZeros)
-      return PiiDsp::filter<ResultType>(image, filter, PiiDsp::FilterOriginalSize);
-    const int rows = filter.rows() >> 1, cols = filter.columns() >> 1;
-    return PiiDsp::filter<ResultType>(Pii::extend(image, rows, rows, cols, cols, mode), filter, PiiDsp::FilterValidPart);
-  }
+                               Pii::ExtendMode mode = Pii::ExtendReplicate);
 
   template <class Input, class Filter, class UnaryFunction, class Output>
   void filter(const Input& input,
@@ -804,11 +806,41 @@ namespace PiiImage
    * value is less than one, `windowRows` will be used instead.
    *
    * @param mode the method of handling image borders
+   *
+   * The implementation is selected based on window size and pixel
+   * type. 3x3 windows use a sorting network that shares sorted
+   * columns between adjacent windows. Windows with 25 or more pixels
+   * on 8-bit (`unsigned char`) images use the constant-time
+   * algorithm by Perreault and Hébert, which maintains a histogram
+   * for each image column. With 16-bit (`unsigned short`) images, a
+   * multi-level histogram slides horizontally, and the time per
+   * pixel grows linearly with window height. Other types use a
+   * sorting network for 5x5 windows and find the median of each
+   * window separately otherwise.
    */
   template <class T> PiiMatrix<T> medianFilter(const PiiMatrix<T>& image,
                                                int windowRows = 3, int windowColumns = 0,
                                                Pii::ExtendMode mode = Pii::ExtendZeros);
 
+  /// @hide
+  /**
+   * Calculates the median of each *windowRows* by *windowColumns*
+   * neighborhood in *image*, which has already been padded by the
+   * caller. The value at (r, c) in the result is the median of the
+   * window whose upper left corner is at (r, c). If the number of
+   * pixels in the window is even, the lower one of the two middle
+   * values is used.
+   *
+   * @internal
+   */
+  template <class T> PiiMatrix<T> paddedMedianFilter(const PiiMatrix<T>& image,
+                                                     int windowRows, int windowColumns);
+  PII_IMAGE_EXPORT PiiMatrix<unsigned char> paddedMedianFilter(const PiiMatrix<unsigned char>& image,
+                                                               int windowRows, int windowColumns);
+  PII_IMAGE_EXPORT PiiMatrix<unsigned short> paddedMedianFilter(const PiiMatrix<unsigned short>& image,
+                                                                int windowRows, int windowColumns);
+  /// @endhide
+
   template <class Input, class Output, class BinaryFunction>
   void medianFilter(const Input& image,
                     int windowRows,
@@ -843,7 +875,12 @@ namespace PiiImage
   template <class T> PiiMatrix<T> minFilter(const PiiMatrix<T>& image,
                                             int windowRows, int windowColumns = -1);
   /**
-   * Scales image to a specified size.
+   * Scales image to a specified size. Each output pixel is
+   * interpolated from at most four source pixels, which causes
+   * aliasing when an image is reduced to less than half of its size.
+   * Use PiiResampler for antialiased reduction, higher-order
+   * interpolation, or when many images of the same size need to be
+   * scaled.
    *
    * @param image input image
    *
@@ -1017,6 +1054,10 @@ namespace PiiImage
    * transformation matrices. Assume *R* is a rotation transform and
    * *S* is a shear transform. Shear after rotate transform is
    * obtained with \(T = SR\).
+   *
+   * Each call evaluates the transformation for every pixel. Use
+   * PiiRemap::transform() to compile the transformation once and
+   * apply it to a sequence of equally sized images.
    */
   template <class T> PiiMatrix<T> transform(const PiiMatrix<T>& image,
                                             const PiiMatrix<float>& transform,
@@ -1146,6 +1187,10 @@ namespace PiiImage
    * boundaries, the corresponding pixel in the result image will be
    * left black. If the map coordinates are given as `doubles`, this
    * function samples *image* using bilinear interpolation.
+   *
+   * If the same map is applied to many images, compile it into a
+   * PiiRemap instead. It trades a small amount of accuracy for a
+   * considerably faster fixed-point implementation.
    */
   template <class T, class U> PiiMatrix<T> remap(const PiiMatrix<T>& image, const PiiMatrix<PiiPoint<U> >& map);
 
@@ -1250,6 +1295,79 @@ namespace PiiImage
    */
   template <class Matrix, class GradientFunction>
   void fastGradient(const Matrix& input, GradientFunction function);
+
+  /**
+   * Returns the number of horizontal bands a *rows*-by-*columns*
+   * image should be split into for parallel processing with at most
+   * *threadCount* threads. Each band is kept large enough for the
+   * threading overhead and the *halo* rows it needs from its
+   * neighbors to stay insignificant. The return value is always at
+   * least one. Used by [processInBands()], and by operations that
+   * split images in a different way.
+   */
+  PII_IMAGE_EXPORT int bandCount(int rows, int columns, int halo, int threadCount);
+
+  /**
+   * Processes *image* in horizontal bands in parallel. The image is
+   * split into at most *threadCount* bands of consecutive rows, and
+   * *function* is called for each band from a thread of a shared
+   * thread pool. The results are combined into a matrix of the same
+   * size as *image*. The call returns once all bands are done.
+   *
+   * Each band passed to *function* is extended by *halo* rows from
+   * the neighboring bands above and below it, but not beyond the
+   * borders of the image. The halo rows of the result are discarded.
+   * Therefore, any neighborhood operation whose output at a pixel
+   * depends on input rows at most *halo* rows away gives the same
+   * result as `function(image)`, up to rounding if *function*
+   * computes in floating point and its rounding depends on the size
+   * of its input (e.g. FFT-based filtering). The bands share the
+   * pixels of *image* without copying.
+   *
+   * Parallel processing cuts the latency of processing a single
+   * large image, as opposed to processing many images in parallel.
+   * Small images are processed in the calling thread in one piece.
+   *
+   * @param image the input image
+   *
+   * @param halo the number of extra rows needed above and below each
+   * band.
+   *
+   * @param threadCount the maximum number of threads. One disables
+   * parallel processing, zero uses one thread per processor core.
+   *
+   * @param function a function object that takes a `const
+   * PiiMatrix<T>&` and returns a `PiiMatrix<U>` of the same size.
+   * It is called concurrently from many threads and must not throw
+   * exceptions.
+   *
+   * ~~~(c++)
+   * struct Smooth
+   * {
+   *   PiiMatrix<float> operator() (const PiiMatrix<float>& band) const
+   *   {
+   *     return PiiImage::filter<float>(band, PiiImage::makeGaussian(7), Pii::ExtendReplicate);
+   *   }
+   * };
+   *
+   * PiiMatrix<float> matSmoothed = PiiImage::processInBands<float>(image, 3, 0, Smooth());
+   * ~~~
+   */
+  template <class U, class T, class Function>
+  PiiMatrix<U> processInBands(const PiiMatrix<T>& image, int halo, int threadCount, Function function);
+
+  /**
+   * Same as above, but calls a const member *function* of *object*
+   * for each band. Useful in operations that need their own state
+   * for processing.
+   *
+   * ~~~(c++)
+   * emitObject(PiiImage::processInBands(image, iHalo, iThreads, this, &MyOperation::filterBand<T>));
+   * ~~~
+   */
+  template <class U, class T, class Object>
+  PiiMatrix<U> processInBands(const PiiMatrix<T>& image, int halo, int threadCount,
+                              const Object* object, PiiMatrix<U> (Object::*function)(const PiiMatrix<T>&) const);
 }
 
 #include "PiiImage-templates.h"
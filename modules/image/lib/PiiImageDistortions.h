@@ -17,6 +17,8 @@
 #define _PIIIMAGEDISTORTIONS_H
 
 #include <PiiMatrix.h>
+#include <PiiMathDefs.h>
+#include "PiiImageGlobal.h"
 
 namespace PiiImage
 {
@@ -81,6 +83,37 @@ namespace PiiImage
                                                  double *radius = 0,
                                                  double *sectorAngle = 0,
                                                  double *startAngle = 0);
+
+  /**
+   * Calculates the geometry of [unwarpCylinder()] without touching
+   * pixel data. The parameters have the same meaning as in
+   * [unwarpCylinder()], but *columns* gives the width of the warped
+   * image instead of the image itself.
+   *
+   * @return a 1-by-N matrix in which element *i* tells the horizontal
+   * coordinate of the warped image column that is mapped to column
+   * *i* of the straightened image. The coordinates are clamped to
+   * [0, columns-1]. If the straightened image would be narrower than
+   * two pixels, an empty matrix is returned and the output parameters
+   * are left untouched.
+   *
+   * ~~~(c++)
+   * // Build a reusable map for 480-by-640 images
+   * PiiMatrix<double> matX(PiiImage::unwarpCylinderMap(640, 2000));
+   * PiiMatrix<PiiPoint<double> > matMap(480, matX.columns());
+   * for (int r=0; r<480; ++r)
+   *   for (int c=0; c<matX.columns(); ++c)
+   *     matMap(r,c) = PiiPoint<double>(matX(0,c), r);
+   * PiiRemap unwarp(matMap, 480, 640);
+   * ~~~
+   */
+  PII_IMAGE_EXPORT PiiMatrix<double> unwarpCylinderMap(int columns,
+                                                       double focalLength = 1e100,
+                                                       double center = NAN,
+                                                       double *cameraDistance = 0,
+                                                       double *radius = 0,
+                                                       double *sectorAngle = 0,
+                                                       double *startAngle = 0);
 }
 
 #include "PiiImageDistortions-templates.h"
@@ -18,10 +18,12 @@
 
 #include "PiiImageGlobal.h"
 #include <PiiMatrix.h>
+#include <PiiParallel.h>
 #include <QVector>
 #include <QPair>
 #include <QStack>
 #include <functional>
+#include <algorithm>
 #include <climits>
 
 namespace PiiImage
@@ -791,6 +793,427 @@ namespace PiiImage
     if (labelCount != 0)
       *labelCount = thresholdOnly ? 1 : iLabelIndex;
   }
+
+  /**
+   * Geometric properties of labeled objects, collected by
+   * [labelObjects()] while labeling. Row *i* of each matrix
+   * describes the object labeled with *i*+1. The first three
+   * matrices are in the same format as those produced by
+   * [calculateProperties()].
+   */
+  struct ObjectProperties
+  {
+    /**
+     * The number of pixels in each object. N-by-1.
+     */
+    PiiMatrix<int> areas;
+    /**
+     * The center of mass of each object, rounded to the nearest
+     * pixel. Each row stores (x, y). N-by-2.
+     */
+    PiiMatrix<int> centroids;
+    /**
+     * The bounding box of each object. Each row stores (x, y, width,
+     * height). N-by-4.
+     */
+    PiiMatrix<int> boundingBoxes;
+    /**
+     * The second central moments of each object, divided by its area.
+     * Each row stores the variance of x, the variance of y and the
+     * covariance of x and y, in this order. N-by-3.
+     */
+    PiiMatrix<double> moments;
+  };
+
+  /// @hide
+
+  // A run of consecutive object pixels on one row. *end* is the last
+  // column of the run.
+  struct LabelRun
+  {
+    int row, start, end, label;
+  };
+
+  // Statistics of the pixels marked with one provisional label.
+  struct LabelStatistics
+  {
+    LabelStatistics() :
+      area(0), minX(INT_MAX), minY(INT_MAX), maxX(-1), maxY(-1),
+      sumX(0), sumY(0), sumXX(0), sumYY(0), sumXY(0), firstSeed(-1)
+    {}
+
+    void addRun(int row, int start, int end, qint64 seed)
+    {
+      const double dLength = end - start + 1, dStart = start, dRow = row;
+      const double dSumX = dLength * (dStart + end) / 2;
+      area += end - start + 1;
+      minX = qMin(minX, start);
+      maxX = qMax(maxX, end);
+      minY = qMin(minY, row);
+      maxY = qMax(maxY, row);
+      sumX += dSumX;
+      sumY += dLength * dRow;
+      // Sum of (start+i)^2 for i = 0...length-1
+      sumXX += dLength * dStart * dStart + dStart * dLength * (dLength-1) +
+        (dLength-1) * dLength * (2*dLength-1) / 6;
+      sumYY += dLength * dRow * dRow;
+      sumXY += dRow * dSumX;
+      addSeed(seed);
+    }
+
+    void add(const LabelStatistics& other)
+    {
+      area += other.area;
+      minX = qMin(minX, other.minX);
+      maxX = qMax(maxX, other.maxX);
+      minY = qMin(minY, other.minY);
+      maxY = qMax(maxY, other.maxY);
+      sumX += other.sumX;
+      sumY += other.sumY;
+      sumXX += other.sumXX;
+      sumYY += other.sumYY;
+      sumXY += other.sumXY;
+      addSeed(other.firstSeed);
+    }
+
+    void addSeed(qint64 seed)
+    {
+      if (seed >= 0 && (firstSeed < 0 || seed < firstSeed))
+        firstSeed = seed;
+    }
+
+    int area, minX, minY, maxX, maxY;
+    double sumX, sumY, sumXX, sumYY, sumXY;
+    // Raster-order position of the first seed pixel, -1 if none.
+    qint64 firstSeed;
+  };
+
+  // Union-find with the smallest label as the root of each set.
+  inline int findLabelRoot(int* parents, int label)
+  {
+    while (parents[label] != label)
+      {
+        parents[label] = parents[parents[label]];
+        label = parents[label];
+      }
+    return label;
+  }
+
+  inline int joinLabels(int* parents, int label1, int label2)
+  {
+    label1 = findLabelRoot(parents, label1);
+    label2 = findLabelRoot(parents, label2);
+    if (label1 < label2)
+      return parents[label2] = label1;
+    return parents[label1] = label2;
+  }
+
+  // Calls callback(above, run) for each pair of overlapping runs.
+  // *runs2* are on the row below *runs1*, and both are sorted by
+  // column. *reach* is one for 8-connectivity and zero for
+  // 4-connectivity.
+  template <class Callback>
+  void connectRunRows(const LabelRun* runs1, int count1,
+                      LabelRun* runs2, int count2,
+                      int reach, Callback callback)
+  {
+    for (int i=0, j=0; i<count2; ++i)
+      {
+        while (j < count1 && runs1[j].end + reach < runs2[i].start)
+          ++j;
+        for (int k=j; k<count1 && runs1[k].start <= runs2[i].end + reach; ++k)
+          callback(runs1[k], runs2[i]);
+      }
+  }
+
+  // Provisional labeling of one horizontal strip. Labels are local to
+  // the strip.
+  struct LabelStrip
+  {
+    LabelStrip() : firstRow(0), lastRow(0), firstLabel(0), lastRowRuns(0) {}
+
+    QVector<LabelRun> runs;
+    QVector<int> parents;
+    QVector<LabelStatistics> statistics;
+    int firstRow, lastRow, firstLabel, lastRowRuns;
+  };
+
+  struct LocalRunJoiner
+  {
+    LocalRunJoiner(LabelStrip* strip) : pStrip(strip) {}
+    void operator() (const LabelRun& above, LabelRun& run) const
+    {
+      if (run.label < 0)
+        run.label = findLabelRoot(pStrip->parents.data(), above.label);
+      else
+        run.label = joinLabels(pStrip->parents.data(), above.label, run.label);
+    }
+    LabelStrip* pStrip;
+  };
+
+  template <class Matrix, class UnaryOp1, class UnaryOp2>
+  class StripLabeler
+  {
+  public:
+    StripLabeler(const Matrix& mat, UnaryOp1 rule1, UnaryOp2 rule2, int reach, LabelStrip* strips) :
+      _mat(mat), _rule1(rule1), _rule2(rule2), _iReach(reach), _pStrips(strips)
+    {}
+
+    void operator() (int first, int last) const
+    {
+      for (int i=first; i<last; ++i)
+        label(_pStrips[i]);
+    }
+
+  private:
+    void label(LabelStrip& strip) const
+    {
+      const int iCols = _mat.columns();
+      int iPreviousStart = 0, iPreviousEnd = 0;
+      for (int r=strip.firstRow; r<strip.lastRow; ++r)
+        {
+          typename Matrix::const_row_iterator sourceRow = _mat.rowBegin(r);
+          const int iRowStart = strip.runs.size();
+          for (int c=0; c<iCols; ++c)
+            {
+              if (!_rule1(sourceRow[c]))
+                continue;
+              LabelRun run = { r, c, c, -1 };
+              qint64 lSeed = -1;
+              for (; c<iCols && _rule1(sourceRow[c]); ++c)
+                if (lSeed < 0 && _rule2(sourceRow[c]))
+                  lSeed = qint64(r) * iCols + c;
+              run.end = c-1;
+              connectRunRows(strip.runs.constData() + iPreviousStart, iPreviousEnd - iPreviousStart,
+                             &run, 1, _iReach, LocalRunJoiner(&strip));
+              if (run.label < 0)
+                {
+                  run.label = strip.parents.size();
+                  strip.parents.append(run.label);
+                  strip.statistics.append(LabelStatistics());
+                }
+              strip.statistics[run.label].addRun(r, run.start, run.end, lSeed);
+              strip.runs.append(run);
+            }
+          iPreviousStart = iRowStart;
+          iPreviousEnd = strip.runs.size();
+        }
+      strip.lastRowRuns = iPreviousEnd - iPreviousStart;
+    }
+
+    const Matrix& _mat;
+    UnaryOp1 _rule1;
+    UnaryOp2 _rule2;
+    int _iReach;
+    LabelStrip* _pStrips;
+  };
+
+  struct GlobalRunJoiner
+  {
+    GlobalRunJoiner(int* parents, int firstLabel1, int firstLabel2) :
+      pParents(parents), iFirstLabel1(firstLabel1), iFirstLabel2(firstLabel2)
+    {}
+    void operator() (const LabelRun& above, const LabelRun& run) const
+    {
+      joinLabels(pParents, above.label + iFirstLabel1, run.label + iFirstLabel2);
+    }
+    int* pParents;
+    int iFirstLabel1, iFirstLabel2;
+  };
+
+  struct RunWriter
+  {
+    RunWriter(PiiMatrix<int>& labels, const LabelStrip* strips, const int* finalLabels) :
+      pLabels(&labels), pStrips(strips), pFinalLabels(finalLabels)
+    {}
+    void operator() (int first, int last) const
+    {
+      for (int i=first; i<last; ++i)
+        {
+          const LabelStrip& strip = pStrips[i];
+          const int* pStripLabels = pFinalLabels + strip.firstLabel;
+          for (int j=0; j<strip.runs.size(); ++j)
+            {
+              const LabelRun& run = strip.runs[j];
+              const int iLabel = pStripLabels[run.label];
+              if (iLabel != 0)
+                std::fill(pLabels->row(run.row) + run.start, pLabels->row(run.row) + run.end + 1, iLabel);
+            }
+        }
+    }
+    PiiMatrix<int>* pLabels;
+    const LabelStrip* pStrips;
+    const int* pFinalLabels;
+  };
+
+  inline bool compareSeeds(const LabelStatistics* s1, const LabelStatistics* s2)
+  {
+    return s1->firstSeed < s2->firstSeed;
+  }
+  /// @endhide
+
+  /**
+   * Labels connected components and calculates their geometric
+   * properties in a single pass. The image is divided into
+   * *stripCount* horizontal strips that are labeled in parallel.
+   * Each strip is scanned for runs of object pixels that are joined
+   * to overlapping runs on the previous row with a union-find
+   * structure. The strips are then merged by joining overlapping runs
+   * over strip boundaries, and the objects are numbered. Areas,
+   * bounding boxes, centroids and second moments are accumulated per
+   * run during the scan, so that the label image need not be scanned
+   * again to find them.
+   *
+   * Objects are numbered in raster order of their first seed pixel.
+   * If *rule1* and *rule2* are the same, the result is identical to
+   * that of the other labelImage() functions, independent of the
+   * number of strips.
+   *
+   * @param mat the matrix to be labeled
+   *
+   * @param rule1 a unary predicate that determines if a pixel in
+   * `mat` is an object pixel candidate.
+   *
+   * @param rule2 a unary predicate that at least one pixel in each
+   * object must meet. Objects with no such pixels are not labeled.
+   * Use the same predicate as *rule1* to label all objects.
+   *
+   * @param connectivity the connectivity type
+   *
+   * @param stripCount the number of strips to divide the image into.
+   * Use [bandCount()] to find a suitable value.
+   *
+   * @param properties an optional output-value parameter that stores
+   * the properties of the labeled objects.
+   *
+   * @param labelCount an optional output-value parameter that stores
+   * the number of labels found
+   *
+   * @return a labeled image, whose maximum value equals to
+   * `labelCount`
+   *
+   * ~~~(c++)
+   * PiiMatrix<unsigned char> img;
+   * PiiImage::ObjectProperties properties;
+   * int iLabelCount = 0;
+   * std::binder2nd<std::greater<unsigned char> > rule(std::greater<unsigned char>(), 127);
+   * PiiMatrix<int> matLabels = PiiImage::labelObjects(img, rule, rule,
+   *                                                   PiiImage::Connect8,
+   *                                                   PiiImage::bandCount(img.rows(), img.columns(), 1, 0),
+   *                                                   &properties, &iLabelCount);
+   * ~~~
+   */
+  template <class Matrix, class UnaryOp1, class UnaryOp2>
+  PiiMatrix<int> labelObjects(const Matrix& mat,
+                              UnaryOp1 rule1, UnaryOp2 rule2,
+                              Connectivity connectivity,
+                              int stripCount = 1,
+                              ObjectProperties* properties = 0,
+                              int* labelCount = 0)
+  {
+    const int iRows = mat.rows(), iCols = mat.columns();
+    const int iReach = connectivity == Connect8 ? 1 : 0;
+    PiiMatrix<int> matLabels(iRows, iCols);
+    stripCount = qBound(1, stripCount, qMax(iRows, 1));
+
+    QVector<LabelStrip> vecStrips(stripCount);
+    LabelStrip* pStrips = vecStrips.data();
+    for (int i=0; i<stripCount; ++i)
+      {
+        pStrips[i].firstRow = int(qint64(iRows) * i / stripCount);
+        pStrips[i].lastRow = int(qint64(iRows) * (i+1) / stripCount);
+      }
+    Pii::parallelFor(stripCount, stripCount,
+                     StripLabeler<Matrix,UnaryOp1,UnaryOp2>(mat, rule1, rule2, iReach, pStrips));
+
+    // Collect the provisional labels of all strips into a single
+    // union-find structure.
+    int iLabelCount = 0;
+    for (int i=0; i<stripCount; ++i)
+      {
+        pStrips[i].firstLabel = iLabelCount;
+        iLabelCount += pStrips[i].parents.size();
+      }
+    QVector<int> vecParents(iLabelCount);
+    QVector<LabelStatistics> vecStatistics(iLabelCount);
+    int* pParents = vecParents.data();
+    for (int i=0; i<stripCount; ++i)
+      {
+        const LabelStrip& strip = pStrips[i];
+        for (int j=0; j<strip.parents.size(); ++j)
+          {
+            pParents[strip.firstLabel + j] = strip.firstLabel + strip.parents[j];
+            vecStatistics[strip.firstLabel + j] = strip.statistics[j];
+          }
+      }
+
+    // Join objects over strip boundaries
+    for (int i=1; i<stripCount; ++i)
+      {
+        const LabelStrip& above = pStrips[i-1];
+        LabelStrip& below = pStrips[i];
+        if (above.lastRow != below.firstRow)
+          continue;
+        int iFirstRowRuns = 0;
+        while (iFirstRowRuns < below.runs.size() && below.runs[iFirstRowRuns].row == below.firstRow)
+          ++iFirstRowRuns;
+        connectRunRows(above.runs.constData() + above.runs.size() - above.lastRowRuns, above.lastRowRuns,
+                       below.runs.data(), iFirstRowRuns, iReach,
+                       GlobalRunJoiner(pParents, above.firstLabel, below.firstLabel));
+      }
+
+    // Roots are smaller than the other labels in their sets. Sum up
+    // statistics to the roots and number the ones with a seed.
+    QVector<const LabelStatistics*> vecObjects;
+    for (int i=0; i<iLabelCount; ++i)
+      {
+        const int iRoot = findLabelRoot(pParents, i);
+        if (iRoot != i)
+          vecStatistics[iRoot].add(vecStatistics[i]);
+      }
+    for (int i=0; i<iLabelCount; ++i)
+      if (pParents[i] == i && vecStatistics[i].firstSeed >= 0)
+        vecObjects.append(&vecStatistics[i]);
+    std::sort(vecObjects.begin(), vecObjects.end(), compareSeeds);
+
+    QVector<int> vecFinalLabels(iLabelCount);
+    for (int i=0; i<vecObjects.size(); ++i)
+      vecFinalLabels[int(vecObjects[i] - vecStatistics.constData())] = i+1;
+    for (int i=0; i<iLabelCount; ++i)
+      vecFinalLabels[i] = vecFinalLabels[pParents[i]];
+
+    Pii::parallelFor(stripCount, stripCount, RunWriter(matLabels, pStrips, vecFinalLabels.constData()));
+
+    if (properties != 0)
+      {
+        const int iObjects = vecObjects.size();
+        properties->areas = PiiMatrix<int>(iObjects, 1);
+        properties->centroids = PiiMatrix<int>(iObjects, 2);
+        properties->boundingBoxes = PiiMatrix<int>(iObjects, 4);
+        properties->moments = PiiMatrix<double>(iObjects, 3);
+        for (int i=0; i<iObjects; ++i)
+          {
+            const LabelStatistics& stats = *vecObjects[i];
+            const double dArea = stats.area, dX = stats.sumX / dArea, dY = stats.sumY / dArea;
+            properties->areas(i,0) = stats.area;
+            properties->centroids(i,0) = int(dX + 0.5);
+            properties->centroids(i,1) = int(dY + 0.5);
+            int* pBox = properties->boundingBoxes[i];
+            pBox[0] = stats.minX;
+            pBox[1] = stats.minY;
+            pBox[2] = stats.maxX - stats.minX + 1;
+            pBox[3] = stats.maxY - stats.minY + 1;
+            double* pMoments = properties->moments[i];
+            pMoments[0] = stats.sumXX / dArea - dX * dX;
+            pMoments[1] = stats.sumYY / dArea - dY * dY;
+            pMoments[2] = stats.sumXY / dArea - dX * dY;
+          }
+      }
+
+    if (labelCount != 0)
+      *labelCount = vecObjects.size();
+    return matLabels;
+  }
 }
 
 #endif //_PIILABELING_H
@@ -0,0 +1,246 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "PiiImage.h"
+#include <QVector>
+#include <cstring>
+
+namespace PiiImage
+{
+  namespace
+  {
+    // Windows smaller than this are faster to sort directly.
+    const int iMinHistogramWindow = 25;
+
+    /* Perreault & Hébert: "Median Filtering in Constant Time", IEEE
+     * Transactions on Image Processing 16(9), 2007.
+     *
+     * Each image column has a histogram of the windowRows pixels
+     * currently in the window. Moving to the next row takes one
+     * addition and one removal per column. The kernel histogram is
+     * the sum of windowColumns column histograms. Both the column
+     * and kernel histograms have a coarse level with 16 bins and a
+     * fine level with 256 bins. The coarse kernel histogram is
+     * updated at each pixel, but each 16-bin segment of the fine
+     * kernel histogram only when the median falls into it.
+     */
+    PiiMatrix<unsigned char> constantTimeMedian(const PiiMatrix<unsigned char>& image,
+                                                int windowRows, int windowColumns)
+    {
+      const int iCols = image.columns();
+      const int iResultRows = image.rows() - windowRows + 1, iResultCols = iCols - windowColumns + 1;
+      const int iRank = (windowRows * windowColumns - 1) / 2;
+      PiiMatrix<unsigned char> matResult(PiiMatrix<unsigned char>::uninitialized(iResultRows, iResultCols));
+
+      QVector<quint16> vecFine(iCols * 256), vecCoarse(iCols * 16);
+      quint16* pFine = vecFine.data(), *pCoarse = vecCoarse.data();
+      for (int r=0; r<windowRows-1; ++r)
+        {
+          const unsigned char* pRow = image[r];
+          for (int c=0; c<iCols; ++c)
+            {
+              ++pFine[c*256 + pRow[c]];
+              ++pCoarse[c*16 + (pRow[c] >> 4)];
+            }
+        }
+
+      int aKernelCoarse[16], aKernelFine[256], aUpdatedColumn[16];
+      for (int r=0; r<iResultRows; ++r)
+        {
+          // Slide column histograms one row down.
+          const unsigned char* pAdd = image[r + windowRows - 1];
+          for (int c=0; c<iCols; ++c)
+            {
+              ++pFine[c*256 + pAdd[c]];
+              ++pCoarse[c*16 + (pAdd[c] >> 4)];
+            }
+          if (r > 0)
+            {
+              const unsigned char* pRemove = image[r-1];
+              for (int c=0; c<iCols; ++c)
+                {
+                  --pFine[c*256 + pRemove[c]];
+                  --pCoarse[c*16 + (pRemove[c] >> 4)];
+                }
+            }
+
+          std::memset(aKernelCoarse, 0, sizeof(aKernelCoarse));
+          for (int c=0; c<windowColumns; ++c)
+            for (int b=0; b<16; ++b)
+              aKernelCoarse[b] += pCoarse[c*16 + b];
+          for (int b=0; b<16; ++b)
+            aUpdatedColumn[b] = -windowColumns;
+
+          unsigned char* pTarget = matResult[r];
+          for (int c=0; c<iResultCols; ++c)
+            {
+              if (c > 0)
+                {
+                  const quint16* pAddCoarse = pCoarse + (c + windowColumns - 1) * 16;
+                  const quint16* pRemoveCoarse = pCoarse + (c - 1) * 16;
+                  for (int b=0; b<16; ++b)
+                    aKernelCoarse[b] += int(pAddCoarse[b]) - int(pRemoveCoarse[b]);
+                }
+
+              int iCount = 0, iBin = 0;
+              while (iCount + aKernelCoarse[iBin] <= iRank)
+                iCount += aKernelCoarse[iBin++];
+
+              // Bring the fine segment up to date either by moving it
+              // column by column or by summing it from scratch,
+              // whichever is cheaper.
+              int* pSegment = aKernelFine + iBin * 16;
+              const int iLastColumn = aUpdatedColumn[iBin];
+              if (2 * (c - iLastColumn) >= windowColumns)
+                {
+                  std::memset(pSegment, 0, 16 * sizeof(int));
+                  for (int cc=c; cc<c+windowColumns; ++cc)
+                    {
+                      const quint16* pColumn = pFine + cc*256 + iBin*16;
+                      for (int i=0; i<16; ++i)
+                        pSegment[i] += pColumn[i];
+                    }
+                }
+              else
+                {
+                  for (int cc=iLastColumn; cc<c; ++cc)
+                    {
+                      const quint16* pRemoveFine = pFine + cc*256 + iBin*16;
+                      const quint16* pAddFine = pRemoveFine + windowColumns*256;
+                      for (int i=0; i<16; ++i)
+                        pSegment[i] += int(pAddFine[i]) - int(pRemoveFine[i]);
+                    }
+                }
+              aUpdatedColumn[iBin] = c;
+
+              int i = 0;
+              while (iCount + pSegment[i] <= iRank)
+                iCount += pSegment[i++];
+              pTarget[c] = (unsigned char)(iBin * 16 + i);
+            }
+        }
+      return matResult;
+    }
+
+    /* A kernel histogram that slides horizontally (Huang's
+     * algorithm). The histogram has three levels: 256, 4096 and
+     * 65536 bins. The coarsest bin containing the median is tracked
+     * incrementally, and the two finer levels take at most 16 steps
+     * each to search.
+     */
+    class SlidingHistogram16
+    {
+    public:
+      SlidingHistogram16(int rank) :
+        _vecCoarse(256), _vecMiddle(4096), _vecFine(65536),
+        _iRank(rank), _iBin(0), _iBelow(0)
+      {}
+
+      void add(unsigned short value)
+      {
+        ++_vecFine[value];
+        ++_vecMiddle[value >> 4];
+        ++_vecCoarse[value >> 8];
+        if ((value >> 8) < _iBin)
+          ++_iBelow;
+      }
+
+      void remove(unsigned short value)
+      {
+        --_vecFine[value];
+        --_vecMiddle[value >> 4];
+        --_vecCoarse[value >> 8];
+        if ((value >> 8) < _iBin)
+          --_iBelow;
+      }
+
+      unsigned short median()
+      {
+        const int* pCoarse = _vecCoarse.constData();
+        while (_iBelow > _iRank)
+          _iBelow -= pCoarse[--_iBin];
+        while (_iBelow + pCoarse[_iBin] <= _iRank)
+          _iBelow += pCoarse[_iBin++];
+
+        int iCount = _iBelow, iMiddle = _iBin * 16;
+        const int* pMiddle = _vecMiddle.constData();
+        while (iCount + pMiddle[iMiddle] <= _iRank)
+          iCount += pMiddle[iMiddle++];
+
+        int iFine = iMiddle * 16;
+        const int* pFine = _vecFine.constData();
+        while (iCount + pFine[iFine] <= _iRank)
+          iCount += pFine[iFine++];
+        return (unsigned short)iFine;
+      }
+
+    private:
+      QVector<int> _vecCoarse, _vecMiddle, _vecFine;
+      int _iRank, _iBin, _iBelow;
+    };
+
+    PiiMatrix<unsigned short> slidingMedian(const PiiMatrix<unsigned short>& image,
+                                            int windowRows, int windowColumns)
+    {
+      const int iResultRows = image.rows() - windowRows + 1;
+      const int iResultCols = image.columns() - windowColumns + 1;
+      PiiMatrix<unsigned short> matResult(PiiMatrix<unsigned short>::uninitialized(iResultRows, iResultCols));
+      SlidingHistogram16 histogram((windowRows * windowColumns - 1) / 2);
+
+      for (int r=0; r<iResultRows; ++r)
+        {
+          for (int fr=r; fr<r+windowRows; ++fr)
+            for (int c=0; c<windowColumns; ++c)
+              histogram.add(image(fr,c));
+
+          unsigned short* pTarget = matResult[r];
+          pTarget[0] = histogram.median();
+          for (int c=1; c<iResultCols; ++c)
+            {
+              for (int fr=r; fr<r+windowRows; ++fr)
+                {
+                  const unsigned short* pRow = image[fr];
+                  histogram.remove(pRow[c-1]);
+                  histogram.add(pRow[c+windowColumns-1]);
+                }
+              pTarget[c] = histogram.median();
+            }
+
+          // Empty the histogram for the next row.
+          for (int fr=r; fr<r+windowRows; ++fr)
+            for (int c=iResultCols-1; c<iResultCols-1+windowColumns; ++c)
+              histogram.remove(image(fr,c));
+        }
+      return matResult;
+    }
+  }
+
+  PiiMatrix<unsigned char> paddedMedianFilter(const PiiMatrix<unsigned char>& image,
+                                              int windowRows, int windowColumns)
+  {
+    if (windowRows * windowColumns < iMinHistogramWindow || windowRows > 65535)
+      return paddedMedianFilter<unsigned char>(image, windowRows, windowColumns);
+    return constantTimeMedian(image, windowRows, windowColumns);
+  }
+
+  PiiMatrix<unsigned short> paddedMedianFilter(const PiiMatrix<unsigned short>& image,
+                                               int windowRows, int windowColumns)
+  {
+    if (windowRows * windowColumns < iMinHistogramWindow)
+      return paddedMedianFilter<unsigned short>(image, windowRows, windowColumns);
+    return slidingMedian(image, windowRows, windowColumns);
+  }
+}
@@ -33,6 +33,67 @@ namespace PiiImage
   };
 
 
+  template <class T> struct IsOdd : public Pii::UnaryFunction<T,bool>
+  {
+    bool operator() (T value) const { return (int(value) & 1) != 0; }
+  };
+
+  template <class T> struct IsNonZero : public Pii::UnaryFunction<T,bool>
+  {
+    bool operator() (T value) const { return !!value; }
+  };
+
+  template <class U> bool toBinaryMask(const PiiMatrix<U>& mask, PiiMatrix<unsigned char>& binaryMask)
+  {
+    binaryMask = PiiMatrix<unsigned char>(mask.rows(), mask.columns());
+    for (int r=0; r<mask.rows(); ++r)
+      {
+        const U* pMaskRow = mask[r];
+        unsigned char* pBinaryRow = binaryMask[r];
+        for (int c=0; c<mask.columns(); ++c)
+          {
+            const int iValue = int(pMaskRow[c]);
+            if (iValue != 0 && iValue != 1)
+              return false;
+            pBinaryRow[c] = (unsigned char)iValue;
+          }
+      }
+    return true;
+  }
+
+  template <class Matrix, class UnaryPredicate>
+  PiiMatrix<quint64> packBinary(const Matrix& image, UnaryPredicate isSet)
+  {
+    const int iRows = image.rows(), iColumns = image.columns(), iWords = (iColumns + 63) / 64;
+    PiiMatrix<quint64> matPacked(iRows, iWords);
+    for (int r=0; r<iRows; ++r)
+      {
+        typename Matrix::const_row_iterator pImageRow = image.rowBegin(r);
+        quint64* pPackedRow = matPacked[r];
+        for (int c=0; c<iColumns; ++c)
+          if (isSet(pImageRow[c]))
+            pPackedRow[c >> 6] |= quint64(1) << (c & 63);
+      }
+    return matPacked;
+  }
+
+  template <class T>
+  PiiMatrix<T> unpackBinary(const PiiMatrix<quint64>& packed, int row, int column, int rows, int columns)
+  {
+    PiiMatrix<T> matResult(PiiMatrix<T>::uninitialized(rows, columns));
+    for (int r=0; r<rows; ++r)
+      {
+        const quint64* pPackedRow = packed[row + r];
+        T* pResultRow = matResult[r];
+        for (int c=0; c<columns; ++c)
+          {
+            const int iBit = column + c;
+            pResultRow[c] = T((pPackedRow[iBit >> 6] >> (iBit & 63)) & 1);
+          }
+      }
+    return matResult;
+  }
+
   template <class Matrix, class U>
   PiiMatrix<typename Matrix::value_type> morphology(const Matrix& image,
                                                     const PiiMatrix<U>& mask,
@@ -109,6 +170,17 @@ namespace PiiImage
         return img;
       }
 
+    PiiMatrix<unsigned char> matBinaryMask;
+    if (toBinaryMask(mask, matBinaryMask))
+      {
+        // The pixel is set if the lowest bit is set, as in the
+        // generic version below.
+        PiiMatrix<quint64> matEroded(erodePacked(packBinary(img, IsOdd<T>()), cols, matBinaryMask));
+        if (handleBorders)
+          return unpackBinary<T>(matEroded, rOrig, cOrig, image.rows(), image.columns());
+        return unpackBinary<T>(matEroded, 0, 0, rows, cols);
+      }
+
     PiiMatrix<T> result(rows,cols);
     int rDiff = rows-maskRows;
     int cDiff = cols-maskCols;
@@ -147,6 +219,13 @@ namespace PiiImage
 
     if (maskRows > rows || maskCols > cols)
       piiWarning("BinaryMorphology::dilate(image, mask): Mask cannot be larger than image.");
+    else
+      {
+        PiiMatrix<unsigned char> matBinaryMask;
+        if (toBinaryMask(mask, matBinaryMask))
+          return unpackBinary<T>(dilatePacked(packBinary(image, IsNonZero<T>()), cols, matBinaryMask),
+                                 0, 0, rows, cols);
+      }
 
     PiiMatrix<T> result(rows,cols);
     typename Matrix::row_iterator ptr;
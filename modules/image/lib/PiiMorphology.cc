@@ -15,6 +15,9 @@
 
 #include "PiiMorphology.h"
 #include <cmath>
+#include <algorithm>
+#include <QList>
+#include <QVector>
 
 namespace PiiImage
 {
@@ -118,6 +121,301 @@ namespace PiiImage
       }
     };
 
+  namespace
+  {
+    // A horizontal run of ones in a structuring element.
+    struct MaskRun
+    {
+      MaskRun(int shift = 0, int length = 0) : iShift(shift), iLength(length) {}
+      bool operator== (const MaskRun& other) const { return iShift == other.iShift && iLength == other.iLength; }
+
+      // Offset of the first pixel of the run relative to the output pixel
+      int iShift;
+      int iLength;
+    };
+
+    struct BitAnd { quint64 operator() (quint64 a, quint64 b) const { return a & b; } };
+    struct BitOr { quint64 operator() (quint64 a, quint64 b) const { return a | b; } };
+
+    // Sets bit p of target to bit p + shift of source. Bits outside
+    // of the source row are zeros.
+    void shiftBits(const quint64* source, int sourceWords, quint64* target, int targetWords, int shift)
+    {
+      const int iWordShift = shift >= 0 ? shift / 64 : -((63 - shift) / 64);
+      const int iBitShift = shift - iWordShift * 64;
+      for (int w=0; w<targetWords; ++w)
+        {
+          const int iLow = w + iWordShift, iHigh = iLow + 1;
+          const quint64 lLow = iLow >= 0 && iLow < sourceWords ? source[iLow] : 0;
+          if (iBitShift == 0)
+            target[w] = lLow;
+          else
+            {
+              const quint64 lHigh = iHigh >= 0 && iHigh < sourceWords ? source[iHigh] : 0;
+              target[w] = (lLow >> iBitShift) | (lHigh << (64 - iBitShift));
+            }
+        }
+    }
+
+    // The number of zero words needed in front of a row so that
+    // runBits() can read bits to the left of the row.
+    inline int paddingWords(const MaskRun& run)
+    {
+      return run.iShift < 0 ? (63 - run.iShift) / 64 : 0;
+    }
+
+    /* Sets bit p of target to op(source[p + run.iShift], ...,
+     * source[p + run.iShift + run.iLength - 1]). Bits outside of the
+     * row are zeros. The operation is idempotent, so two overlapping
+     * windows whose length is a power of two cover any length, and
+     * log2(length) + 2 shifts suffice. Both buffers must be able to
+     * hold words + paddingWords(run) elements.
+     */
+    template <class Operation>
+    void runBits(const quint64* source, quint64* target, int words, const MaskRun& run,
+                 quint64* buffer1, quint64* buffer2, Operation op)
+    {
+      const int iPadding = paddingWords(run), iBufferWords = words + iPadding;
+      std::fill(buffer1, buffer1 + iPadding, quint64(0));
+      std::copy(source, source + words, buffer1 + iPadding);
+      int iSpan = 1;
+      for (; iSpan * 2 <= run.iLength; iSpan *= 2)
+        {
+          shiftBits(buffer1, iBufferWords, buffer2, iBufferWords, iSpan);
+          for (int w=0; w<iBufferWords; ++w)
+            buffer1[w] = op(buffer1[w], buffer2[w]);
+        }
+      const int iShift = run.iShift + iPadding * 64;
+      shiftBits(buffer1, iBufferWords, target, words, iShift);
+      if (iSpan < run.iLength)
+        {
+          shiftBits(buffer1, iBufferWords, buffer2, words, iShift + run.iLength - iSpan);
+          for (int w=0; w<words; ++w)
+            target[w] = op(target[w], buffer2[w]);
+        }
+    }
+
+    /* Calculates the running op over `window` rows of source, starting
+     * `before` rows above each row (van Herk/Gil-Werman). Rows outside
+     * of the image are equal to `identity`.
+     */
+    template <class Operation>
+    PiiMatrix<quint64> runRows(const PiiMatrix<quint64>& source, int window, int before,
+                               quint64 identity, Operation op)
+    {
+      const int iRows = source.rows(), iWords = source.columns(), iPadded = iRows + window - 1;
+      PiiMatrix<quint64> matForward(PiiMatrix<quint64>::uninitialized(iPadded, iWords));
+      PiiMatrix<quint64> matBackward(PiiMatrix<quint64>::uninitialized(iPadded, iWords));
+      QVector<quint64> vecIdentity(iWords, identity);
+      for (int iStart=0; iStart<iPadded; iStart+=window)
+        {
+          const int iEnd = qMin(iStart + window, iPadded);
+          for (int r=iStart; r<iEnd; ++r)
+            {
+              const int iSource = r - before;
+              const quint64* pSource = iSource >= 0 && iSource < iRows ? source[iSource] : vecIdentity.constData();
+              quint64* pForward = matForward[r];
+              if (r == iStart)
+                std::copy(pSource, pSource + iWords, pForward);
+              else
+                {
+                  const quint64* pPrevious = matForward[r-1];
+                  for (int w=0; w<iWords; ++w)
+                    pForward[w] = op(pPrevious[w], pSource[w]);
+                }
+            }
+          for (int r=iEnd; r-- > iStart; )
+            {
+              const int iSource = r - before;
+              const quint64* pSource = iSource >= 0 && iSource < iRows ? source[iSource] : vecIdentity.constData();
+              quint64* pBackward = matBackward[r];
+              if (r == iEnd-1)
+                std::copy(pSource, pSource + iWords, pBackward);
+              else
+                {
+                  const quint64* pNext = matBackward[r+1];
+                  for (int w=0; w<iWords; ++w)
+                    pBackward[w] = op(pNext[w], pSource[w]);
+                }
+            }
+        }
+
+      PiiMatrix<quint64> matResult(PiiMatrix<quint64>::uninitialized(iRows, iWords));
+      for (int r=0; r<iRows; ++r)
+        {
+          const quint64* pBackward = matBackward[r], *pForward = matForward[r + window - 1];
+          quint64* pTarget = matResult[r];
+          for (int w=0; w<iWords; ++w)
+            pTarget[w] = op(pBackward[w], pForward[w]);
+        }
+      return matResult;
+    }
+
+    /* Decomposes mask into horizontal runs. lstRuns will contain the
+     * distinct runs and vecRowRuns the indices of the runs on each
+     * mask row. If mirror is true, shifts are calculated for a
+     * mirrored mask (dilation). Returns true if all rows are equal.
+     */
+    bool decomposeMask(const PiiMatrix<unsigned char>& mask, bool mirror,
+                       QList<MaskRun>& lstRuns, QVector<QList<int> >& vecRowRuns)
+    {
+      const int iRows = mask.rows(), iColumns = mask.columns(), iCenter = iColumns / 2;
+      vecRowRuns.resize(iRows);
+      bool bAllEqual = true;
+      for (int r=0; r<iRows; ++r)
+        {
+          const unsigned char* pRow = mask[r];
+          for (int c=0; c<iColumns; )
+            {
+              if (pRow[c] == 0)
+                {
+                  ++c;
+                  continue;
+                }
+              int iLength = 1;
+              while (c + iLength < iColumns && pRow[c + iLength] != 0)
+                ++iLength;
+              MaskRun run(mirror ? iCenter - c - iLength + 1 : c - iCenter, iLength);
+              int iIndex = lstRuns.indexOf(run);
+              if (iIndex < 0)
+                {
+                  iIndex = lstRuns.size();
+                  lstRuns << run;
+                }
+              vecRowRuns[r] << iIndex;
+              c += iLength;
+            }
+          if (r > 0 && vecRowRuns[r] != vecRowRuns[0])
+            bAllEqual = false;
+        }
+      return bAllEqual;
+    }
+
+    template <class Operation>
+    void runHorizontally(const PiiMatrix<quint64>& image, const MaskRun& run,
+                         PiiMatrix<quint64>& result, Operation op)
+    {
+      const int iWords = image.columns();
+      const int iBufferWords = iWords + paddingWords(run);
+      QVector<quint64> vecBuffer(2 * iBufferWords);
+      result = PiiMatrix<quint64>(PiiMatrix<quint64>::uninitialized(image.rows(), iWords));
+      for (int r=0; r<image.rows(); ++r)
+        runBits(image[r], result[r], iWords, run,
+                vecBuffer.data(), vecBuffer.data() + iBufferWords, op);
+    }
+
+    // Clears all bits outside of [firstColumn, lastColumn].
+    void clearColumns(PiiMatrix<quint64>& image, int firstColumn, int lastColumn)
+    {
+      const int iWords = image.columns();
+      for (int r=0; r<image.rows(); ++r)
+        {
+          quint64* pRow = image[r];
+          for (int w=0; w<iWords; ++w)
+            {
+              const int iFirst = w * 64;
+              if (iFirst + 63 < firstColumn || iFirst > lastColumn)
+                pRow[w] = 0;
+              else
+                {
+                  if (firstColumn > iFirst)
+                    pRow[w] &= ~quint64(0) << (firstColumn - iFirst);
+                  if (lastColumn < iFirst + 63)
+                    pRow[w] &= ~quint64(0) >> (iFirst + 63 - lastColumn);
+                }
+            }
+        }
+    }
+
+    template <class Operation>
+    PiiMatrix<quint64> packedMorphology(const PiiMatrix<quint64>& image,
+                                        const PiiMatrix<unsigned char>& mask,
+                                        bool erosion, Operation op)
+    {
+      const int iRows = image.rows(), iWords = image.columns();
+      const int iMaskRows = mask.rows(), iOrigin = iMaskRows / 2;
+      const quint64 lIdentity = erosion ? ~quint64(0) : 0;
+
+      QList<MaskRun> lstRuns;
+      QVector<QList<int> > vecRowRuns;
+      const bool bAllRowsEqual = decomposeMask(mask, !erosion, lstRuns, vecRowRuns);
+
+      QList<PiiMatrix<quint64> > lstHorizontal;
+      for (int i=0; i<lstRuns.size(); ++i)
+        {
+          lstHorizontal << PiiMatrix<quint64>();
+          runHorizontally(image, lstRuns[i], lstHorizontal.last(), op);
+        }
+
+      // Erosion takes mask row mr from image row r - origin + mr,
+      // dilation from r + origin - mr.
+      const int iBefore = erosion ? iOrigin : iMaskRows - 1 - iOrigin;
+      PiiMatrix<quint64> matResult(PiiMatrix<quint64>::constant(iRows, iWords, lIdentity));
+      if (bAllRowsEqual && iMaskRows > 1)
+        {
+          for (int i=0; i<lstHorizontal.size(); ++i)
+            {
+              PiiMatrix<quint64> matVertical(runRows(lstHorizontal[i], iMaskRows, iBefore, lIdentity, op));
+              for (int r=0; r<iRows; ++r)
+                {
+                  const quint64* pSource = matVertical[r];
+                  quint64* pTarget = matResult[r];
+                  for (int w=0; w<iWords; ++w)
+                    pTarget[w] = op(pTarget[w], pSource[w]);
+                }
+            }
+        }
+      else
+        {
+          for (int r=0; r<iRows; ++r)
+            {
+              quint64* pTarget = matResult[r];
+              for (int mr=0; mr<iMaskRows; ++mr)
+                {
+                  const int iSourceRow = erosion ? r - iOrigin + mr : r + iOrigin - mr;
+                  if (iSourceRow < 0 || iSourceRow >= iRows)
+                    continue;
+                  const QList<int>& lstRowRuns = vecRowRuns[mr];
+                  for (int i=0; i<lstRowRuns.size(); ++i)
+                    {
+                      const quint64* pSource = lstHorizontal[lstRowRuns[i]][iSourceRow];
+                      for (int w=0; w<iWords; ++w)
+                        pTarget[w] = op(pTarget[w], pSource[w]);
+                    }
+                }
+            }
+        }
+      return matResult;
+    }
+  }
+
+  PiiMatrix<quint64> erodePacked(const PiiMatrix<quint64>& image, int columns,
+                                 const PiiMatrix<unsigned char>& mask)
+  {
+    const int iRows = image.rows(), iMaskRows = mask.rows(), iMaskColumns = mask.columns();
+    if (iMaskRows > iRows || iMaskColumns > columns)
+      return PiiMatrix<quint64>(iRows, image.columns());
+
+    PiiMatrix<quint64> matResult(packedMorphology(image, mask, true, BitAnd()));
+
+    // Only pixels for which the whole mask fits into the image are
+    // retained.
+    const int iFirstRow = iMaskRows / 2, iLastRow = iRows - iMaskRows + iFirstRow;
+    for (int r=0; r<iRows; ++r)
+      if (r < iFirstRow || r > iLastRow)
+        std::fill(matResult[r], matResult[r] + matResult.columns(), quint64(0));
+    clearColumns(matResult, iMaskColumns / 2, columns - iMaskColumns + iMaskColumns / 2);
+    return matResult;
+  }
+
+  PiiMatrix<quint64> dilatePacked(const PiiMatrix<quint64>& image, int columns,
+                                  const PiiMatrix<unsigned char>& mask)
+  {
+    PiiMatrix<quint64> matResult(packedMorphology(image, mask, false, BitOr()));
+    clearColumns(matResult, 0, columns - 1);
+    return matResult;
+  }
+
   PiiMatrix<int> createMask(MaskType type, int rows, int columns)
   {
     return createMask<int>(type,rows,columns);
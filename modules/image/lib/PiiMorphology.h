@@ -110,6 +110,12 @@ namespace PiiImage
    *
    * @return the binary image which is result of erosion
    *
+   * If *mask* consists of zeros and ones only (see [createMask()]),
+   * the erosion is calculated on a bit-packed copy of the image. The
+   * cost per pixel then depends on the number of distinct horizontal
+   * runs of ones in the mask, not on its area. Rectangular masks and
+   * lines of any size take a constant time per pixel.
+   *
    * ~~~(c++)
    *
    * PiiMatrix<int> source(8,8,
@@ -182,6 +188,9 @@ namespace PiiImage
    *
    * @return the binary image which is result of dilation.
    *
+   * The fast path described in [erode()] applies to dilation as
+   * well.
+   *
    * ~~~(c++)
    *
    * PiiMatrix<int> source(8,8,
@@ -370,6 +379,65 @@ namespace PiiImage
    */
   template <class Matrix>
   PiiMatrix<typename Matrix::value_type> shrink(const Matrix& image, int amount = 1);
+
+  /// @hide
+  /**
+   * Converts *mask* into a binary structuring element for the fast
+   * morphology engine. Returns `false` if the mask contains other
+   * values than zeros and ones.
+   *
+   * @internal
+   */
+  template <class U> bool toBinaryMask(const PiiMatrix<U>& mask, PiiMatrix<unsigned char>& binaryMask);
+
+  /**
+   * Packs a binary image into 64-bit words, 64 pixels per word. The
+   * least significant bit of the first word on each row is the
+   * leftmost pixel. A pixel is set if *isSet* returns `true` for its
+   * value. Unused bits at the end of each row are zeros.
+   *
+   * @internal
+   */
+  template <class Matrix, class UnaryPredicate>
+  PiiMatrix<quint64> packBinary(const Matrix& image, UnaryPredicate isSet);
+
+  /**
+   * Unpacks *rows* by *columns* pixels starting at (*row*, *column*)
+   * in *packed* into a matrix of zeros and ones.
+   *
+   * @internal
+   */
+  template <class T>
+  PiiMatrix<T> unpackBinary(const PiiMatrix<quint64>& packed, int row, int column, int rows, int columns);
+
+  /**
+   * Erodes a packed binary image with *columns* pixels on each row.
+   * As in [erode()], only pixels for which the whole mask fits into
+   * the image will be set.
+   *
+   * The mask is decomposed into horizontal runs of ones. The
+   * erosion by each distinct run is calculated once per image row
+   * with bitwise operations, 64 pixels at a time, in log2(run length)
+   * steps. The results of the rows of the mask are combined with a
+   * running AND over image rows. If all rows of the mask are equal
+   * (rectangles, lines), the running AND uses the van Herk/Gil-Werman
+   * algorithm, and the cost per pixel is independent of mask height.
+   *
+   * @internal
+   */
+  PII_IMAGE_EXPORT PiiMatrix<quint64> erodePacked(const PiiMatrix<quint64>& image, int columns,
+                                                  const PiiMatrix<unsigned char>& mask);
+
+  /**
+   * Dilates a packed binary image with *columns* pixels on each row.
+   * Pixels outside of the image are zeros. See [erodePacked()] for
+   * the algorithm.
+   *
+   * @internal
+   */
+  PII_IMAGE_EXPORT PiiMatrix<quint64> dilatePacked(const PiiMatrix<quint64>& image, int columns,
+                                                   const PiiMatrix<unsigned char>& mask);
+  /// @endhide
 }
 
 #include <PiiMorphology-templates.h>
@@ -0,0 +1,124 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIREMAP_H
+# error "Never use <PiiRemap-templates.h> directly; include <PiiRemap.h> instead."
+#endif
+
+#include <QVector>
+
+template <class U> PiiRemap::PiiRemap(const PiiMatrix<PiiPoint<U> >& map, int sourceRows, int sourceColumns) :
+  d(new Data(map.rows(), map.columns(), sourceRows, sourceColumns))
+{
+  const int iColumns = map.columns();
+  QVector<double> vecX(iColumns), vecY(iColumns);
+  for (int r=0; r<map.rows(); ++r)
+    {
+      const PiiPoint<U>* pRow = map[r];
+      for (int c=0; c<iColumns; ++c)
+        {
+          vecX[c] = double(pRow[c].x);
+          vecY[c] = double(pRow[c].y);
+        }
+      setRow(r, vecX.constData(), vecY.constData());
+    }
+}
+
+template <class T> class PiiRemap::BandFunction
+{
+public:
+  BandFunction(const PiiRemap* remap, const T* const* sourceRows, T background, PiiMatrix<T>& result) :
+    _pRemap(remap), _pSourceRows(sourceRows), _background(background), _pResult(&result)
+  {}
+
+  void operator() (int firstRow, int lastRow) const
+  {
+    _pRemap->remapRows(_pSourceRows, _background, firstRow, lastRow, *_pResult);
+  }
+
+private:
+  const PiiRemap* _pRemap;
+  const T* const* _pSourceRows;
+  T _background;
+  PiiMatrix<T>* _pResult;
+};
+
+template <class T> PiiMatrix<T> PiiRemap::apply(const PiiMatrix<T>& image, T background, int threadCount) const
+{
+  if (image.rows() != d->iSourceRows || image.columns() != d->iSourceColumns || isEmpty())
+    return PiiMatrix<T>();
+
+  // Row pointers make the map independent of the row stride of
+  // the source image.
+  QVector<const T*> vecSourceRows(image.rows());
+  for (int r=0; r<image.rows(); ++r)
+    vecSourceRows[r] = image[r];
+
+  const int iRows = rows();
+  PiiMatrix<T> result(PiiMatrix<T>::uninitialized(iRows, columns()));
+  const int iBands = PiiImage::bandCount(iRows, columns(), 0, threadCount);
+  if (iBands <= 1)
+    remapRows(vecSourceRows.constData(), background, 0, iRows, result);
+  else
+    Pii::parallelFor(iRows, iBands, BandFunction<T>(this, vecSourceRows.constData(), background, result));
+  return result;
+}
+
+template <class T> void PiiRemap::remapRows(const T* const* sourceRows, T background,
+                                            int firstRow, int lastRow,
+                                            PiiMatrix<T>& result) const
+{
+  for (int r=firstRow; r<lastRow; ++r)
+    remapRow(d->matPositions[r],
+                 d->matFractionsX[r],
+                 d->matFractionsY[r],
+                 columns(),
+                 sourceRows,
+                 background,
+                 result[r]);
+}
+
+template <class T> void PiiRemap::remapRow(const quint32* positions,
+                                               const unsigned char* fractionsX,
+                                               const unsigned char* fractionsY,
+                                               int count,
+                                               const T* const* sourceRows,
+                                               T background,
+                                               T* target)
+{
+  typedef typename Pii::ToFloatingPoint<T>::Type Real;
+  typedef typename Pii::ToFloatingPoint<T>::PrimitiveType RealScalar;
+  const RealScalar scale(1.0 / 256);
+
+  for (int i=0; i<count; ++i)
+    {
+      const quint32 uiPosition = positions[i];
+      if (uiPosition == OutsidePixel)
+        {
+          target[i] = background;
+          continue;
+        }
+      const int iRow = int(uiPosition >> 16), iColumn = int(uiPosition & 0xffff);
+      const int iFractionX = fractionsX[i], iFractionY = fractionsY[i];
+      // Zero weights never read beyond the last row/column.
+      const T* pTop = sourceRows[iRow] + iColumn;
+      const T* pBottom = sourceRows[iRow + (iFractionY != 0)] + iColumn;
+      const int iDx = iFractionX != 0;
+      const RealScalar fx(iFractionX * scale), fy(iFractionY * scale);
+      const Real top(Real(pTop[0]) * (RealScalar(1) - fx) + Real(pTop[iDx]) * fx);
+      const Real bottom(Real(pBottom[0]) * (RealScalar(1) - fx) + Real(pBottom[iDx]) * fx);
+      target[i] = PiiImage::Rounder<T>::round(top * (RealScalar(1) - fy) + bottom * fy);
+    }
+}
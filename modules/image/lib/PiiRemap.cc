@@ -0,0 +1,318 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiRemap.h"
+#include <PiiMatrixUtil.h>
+#include <PiiInvalidArgumentException.h>
+#include <QCoreApplication>
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+namespace
+{
+  // Source positions are packed into 16-bit row and column indices.
+  int checkSourceSize(int sourceRows, int sourceColumns)
+  {
+    if (!PiiRemap::supportsSourceSize(sourceRows, sourceColumns))
+      PII_THROW(PiiInvalidArgumentException,
+                QCoreApplication::translate("PiiRemap", "Source images must be at most %1 pixels in both directions. Got %2-by-%3.")
+                .arg(int(PiiRemap::MaxSourceSize)).arg(sourceRows).arg(sourceColumns));
+    return sourceRows;
+  }
+
+  // Interpolates four 8-bit pixels with 8-bit weights. The horizontal
+  // sums are scaled down by four bits to fit the vertical pass into
+  // 16-bit multipliers. The SSE2 code below uses the same arithmetic.
+  inline unsigned char bilinear8(int topLeft, int topRight, int bottomLeft, int bottomRight,
+                                 int fractionX, int fractionY)
+  {
+    const int iTop = (topLeft * (256 - fractionX) + topRight * fractionX + 8) >> 4;
+    const int iBottom = (bottomLeft * (256 - fractionX) + bottomRight * fractionX + 8) >> 4;
+    return (unsigned char)((iTop * (256 - fractionY) + iBottom * fractionY + 2048) >> 12);
+  }
+
+  // Interpolates a gray-level pixel at a compiled source position.
+  inline unsigned char remapPixel(quint32 position, int fractionX, int fractionY,
+                                  const unsigned char* const* sourceRows)
+  {
+    const int iRow = int(position >> 16), iColumn = int(position & 0xffff);
+    const unsigned char* pTop = sourceRows[iRow] + iColumn;
+    const unsigned char* pBottom = sourceRows[iRow + (fractionY != 0)] + iColumn;
+    const int iDx = fractionX != 0;
+    return bilinear8(pTop[0], pTop[iDx], pBottom[0], pBottom[iDx], fractionX, fractionY);
+  }
+
+#ifdef __SSE2__
+  // Converts four 8-bit fractions to (256-f, f) pairs of 16-bit
+  // weights in each 32-bit lane.
+  inline __m128i weightPairs(const unsigned char* fractions)
+  {
+    int iFractions;
+    memcpy(&iFractions, fractions, 4);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i f = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(iFractions), zero), zero);
+    return _mm_or_si128(_mm_sub_epi32(_mm_set1_epi32(256), f), _mm_slli_epi32(f, 16));
+  }
+
+  // Interpolates four lanes. The low and high 16 bits of each lane in
+  // *top* and *bottom* hold the left and right pixel, respectively.
+  inline __m128i bilinear8(__m128i top, __m128i bottom, __m128i weightsX, __m128i weightsY)
+  {
+    const __m128i round4 = _mm_set1_epi32(8), round12 = _mm_set1_epi32(2048);
+    top = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(top, weightsX), round4), 4);
+    bottom = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(bottom, weightsX), round4), 4);
+    return _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_or_si128(top, _mm_slli_epi32(bottom, 16)),
+                                                       weightsY),
+                                        round12), 12);
+  }
+#endif
+}
+
+PiiRemap::Data::Data() :
+  iSourceRows(0), iSourceColumns(0)
+{
+}
+
+PiiRemap::Data::Data(int rows, int columns, int sourceRows, int sourceColumns) :
+  iSourceRows(checkSourceSize(sourceRows, sourceColumns)), iSourceColumns(sourceColumns),
+  matPositions(PiiMatrix<quint32>::uninitialized(rows, columns)),
+  matFractionsX(PiiMatrix<unsigned char>::uninitialized(rows, columns)),
+  matFractionsY(PiiMatrix<unsigned char>::uninitialized(rows, columns))
+{
+}
+
+PiiRemap::PiiRemap() :
+  d(new Data)
+{
+}
+
+PiiRemap::PiiRemap(const PiiRemap& other) :
+  d(new Data(*other.d))
+{
+}
+
+PiiRemap::~PiiRemap()
+{
+  delete d;
+}
+
+PiiRemap& PiiRemap::operator= (const PiiRemap& other)
+{
+  if (&other != this)
+    *d = *other.d;
+  return *this;
+}
+
+bool PiiRemap::isEmpty() const { return d->matPositions.isEmpty(); }
+int PiiRemap::rows() const { return d->matPositions.rows(); }
+int PiiRemap::columns() const { return d->matPositions.columns(); }
+int PiiRemap::sourceRows() const { return d->iSourceRows; }
+int PiiRemap::sourceColumns() const { return d->iSourceColumns; }
+
+bool PiiRemap::supportsSourceSize(int sourceRows, int sourceColumns)
+{
+  return sourceRows >= 0 && sourceRows <= MaxSourceSize &&
+    sourceColumns >= 0 && sourceColumns <= MaxSourceSize;
+}
+
+void PiiRemap::setRow(int row, const double* x, const double* y)
+{
+  quint32* pPositions = d->matPositions[row];
+  unsigned char* pFractionsX = d->matFractionsX[row], *pFractionsY = d->matFractionsY[row];
+  const double dLastX = d->iSourceColumns - 1, dLastY = d->iSourceRows - 1;
+  for (int c=0; c<d->matPositions.columns(); ++c)
+    {
+      // NaNs fail both comparisons.
+      if (!(x[c] >= 0 && x[c] <= dLastX &&
+            y[c] >= 0 && y[c] <= dLastY))
+        {
+          pPositions[c] = OutsidePixel;
+          pFractionsX[c] = pFractionsY[c] = 0;
+          continue;
+        }
+      int iX = int(x[c]), iY = int(y[c]);
+      int iFractionX = Pii::round<int>((x[c] - iX) * 256);
+      int iFractionY = Pii::round<int>((y[c] - iY) * 256);
+      if (iFractionX == 256)
+        {
+          ++iX;
+          iFractionX = 0;
+        }
+      if (iFractionY == 256)
+        {
+          ++iY;
+          iFractionY = 0;
+        }
+      pPositions[c] = (quint32(iY) << 16) | quint32(iX);
+      pFractionsX[c] = (unsigned char)iFractionX;
+      pFractionsY[c] = (unsigned char)iFractionY;
+    }
+}
+
+PiiRemap PiiRemap::transform(const PiiMatrix<float>& transform,
+                             int sourceRows, int sourceColumns,
+                             PiiImage::TransformedSize handling)
+{
+  int iMinX = 0, iMinY = 0, iMaxX = sourceColumns-1, iMaxY = sourceRows-1;
+  if (handling == PiiImage::ExpandAsNecessary)
+    {
+      // Find the bounding box of the transformed corners.
+      iMinX = iMinY = Pii::Numeric<int>::maxValue();
+      iMaxX = iMaxY = Pii::Numeric<int>::minValue();
+      const int aCorners[4][2] = { { 0, 0 }, { sourceColumns, 0 },
+                                   { sourceColumns, sourceRows }, { 0, sourceRows } };
+      for (int i=0; i<4; ++i)
+        {
+          float fX, fY;
+          PiiImage::transformHomogeneousPoint(transform, float(aCorners[i][0]), float(aCorners[i][1]), &fX, &fY);
+          if (fX < iMinX) iMinX = int(std::floor(fX));
+          if (fX > iMaxX) iMaxX = int(std::ceil(fX));
+          if (fY < iMinY) iMinY = int(std::floor(fY));
+          if (fY > iMaxY) iMaxY = int(std::ceil(fY));
+        }
+    }
+
+  const int iRows = iMaxY - iMinY + 1, iColumns = iMaxX - iMinX + 1;
+  PiiRemap result;
+  *result.d = Data(iRows, iColumns, sourceRows, sourceColumns);
+
+  // Maps coordinates in the transformed domain back to the source.
+  const PiiMatrix<float> matInverse(Pii::inverse(transform));
+  QVector<double> vecX(iColumns), vecY(iColumns);
+  for (int r=0; r<iRows; ++r)
+    {
+      for (int c=0; c<iColumns; ++c)
+        {
+          float fX, fY;
+          PiiImage::transformHomogeneousPoint(matInverse, float(c + iMinX), float(r + iMinY), &fX, &fY);
+          vecX[c] = fX;
+          vecY[c] = fY;
+        }
+      result.setRow(r, vecX.constData(), vecY.constData());
+    }
+  return result;
+}
+
+void PiiRemap::remapRow(const quint32* positions,
+                            const unsigned char* fractionsX,
+                            const unsigned char* fractionsY,
+                            int count,
+                            const unsigned char* const* sourceRows,
+                            unsigned char background,
+                            unsigned char* target)
+{
+  int i = 0;
+#ifdef __SSE2__
+  for (; i <= count - 4; i += 4)
+    {
+      // Background pixels are rare; handle such blocks in scalar code.
+      if (positions[i] == OutsidePixel || positions[i+1] == OutsidePixel ||
+          positions[i+2] == OutsidePixel || positions[i+3] == OutsidePixel)
+        {
+          for (int j=i; j<i+4; ++j)
+            target[j] = positions[j] == OutsidePixel ? background :
+              remapPixel(positions[j], fractionsX[j], fractionsY[j], sourceRows);
+          continue;
+        }
+      int aTop[4], aBottom[4];
+      for (int j=0; j<4; ++j)
+        {
+          const quint32 uiPosition = positions[i+j];
+          const int iRow = int(uiPosition >> 16), iColumn = int(uiPosition & 0xffff);
+          const unsigned char* pTop = sourceRows[iRow] + iColumn;
+          const unsigned char* pBottom = sourceRows[iRow + (fractionsY[i+j] != 0)] + iColumn;
+          const int iDx = fractionsX[i+j] != 0;
+          aTop[j] = pTop[0] | (pTop[iDx] << 16);
+          aBottom[j] = pBottom[0] | (pBottom[iDx] << 16);
+        }
+      const __m128i result = bilinear8(_mm_set_epi32(aTop[3], aTop[2], aTop[1], aTop[0]),
+                                       _mm_set_epi32(aBottom[3], aBottom[2], aBottom[1], aBottom[0]),
+                                       weightPairs(fractionsX + i),
+                                       weightPairs(fractionsY + i));
+      const __m128i packed = _mm_packs_epi32(result, result);
+      const int iPacked = _mm_cvtsi128_si32(_mm_packus_epi16(packed, packed));
+      memcpy(target + i, &iPacked, 4);
+    }
+#endif
+  for (; i < count; ++i)
+    target[i] = positions[i] == OutsidePixel ? background :
+      remapPixel(positions[i], fractionsX[i], fractionsY[i], sourceRows);
+}
+
+void PiiRemap::remapRow(const quint32* positions,
+                            const unsigned char* fractionsX,
+                            const unsigned char* fractionsY,
+                            int count,
+                            const PiiColor4<unsigned char>* const* sourceRows,
+                            PiiColor4<unsigned char> background,
+                            PiiColor4<unsigned char>* target)
+{
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  for (int i=0; i<count; ++i)
+    {
+      const quint32 uiPosition = positions[i];
+      if (uiPosition == OutsidePixel)
+        {
+          target[i] = background;
+          continue;
+        }
+      const int iRow = int(uiPosition >> 16), iColumn = int(uiPosition & 0xffff);
+      const int iFractionX = fractionsX[i], iFractionY = fractionsY[i];
+      const PiiColor4<unsigned char>* pTop = sourceRows[iRow] + iColumn;
+      const PiiColor4<unsigned char>* pBottom = sourceRows[iRow + (iFractionY != 0)] + iColumn;
+      const int iDx = iFractionX != 0;
+      int aPixels[4];
+      memcpy(aPixels, pTop, 4);
+      memcpy(aPixels + 1, pTop + iDx, 4);
+      memcpy(aPixels + 2, pBottom, 4);
+      memcpy(aPixels + 3, pBottom + iDx, 4);
+      // Interleave left and right pixels channel by channel and
+      // widen to 16 bits: each 32-bit lane holds one channel.
+      const __m128i top = _mm_unpacklo_epi8(_mm_unpacklo_epi8(_mm_cvtsi32_si128(aPixels[0]),
+                                                              _mm_cvtsi32_si128(aPixels[1])), zero);
+      const __m128i bottom = _mm_unpacklo_epi8(_mm_unpacklo_epi8(_mm_cvtsi32_si128(aPixels[2]),
+                                                                 _mm_cvtsi32_si128(aPixels[3])), zero);
+      const __m128i result = bilinear8(top, bottom,
+                                       _mm_set1_epi32((iFractionX << 16) | (256 - iFractionX)),
+                                       _mm_set1_epi32((iFractionY << 16) | (256 - iFractionY)));
+      const __m128i packed = _mm_packs_epi32(result, result);
+      const int iPacked = _mm_cvtsi128_si32(_mm_packus_epi16(packed, packed));
+      memcpy(static_cast<void*>(target + i), &iPacked, 4);
+    }
+#else
+  for (int i=0; i<count; ++i)
+    {
+      const quint32 uiPosition = positions[i];
+      if (uiPosition == OutsidePixel)
+        {
+          target[i] = background;
+          continue;
+        }
+      const int iRow = int(uiPosition >> 16), iColumn = int(uiPosition & 0xffff);
+      const int iFractionX = fractionsX[i], iFractionY = fractionsY[i];
+      const unsigned char* pTop = sourceRows[iRow][iColumn].channels;
+      const unsigned char* pBottom = sourceRows[iRow + (iFractionY != 0)][iColumn].channels;
+      const int iDx = iFractionX != 0 ? 4 : 0;
+      for (int c=0; c<4; ++c)
+        target[i].channels[c] = bilinear8(pTop[c], pTop[c + iDx], pBottom[c], pBottom[c + iDx],
+                                          iFractionX, iFractionY);
+    }
+#endif
+}
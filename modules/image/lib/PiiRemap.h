@@ -0,0 +1,204 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiImage.h"
+
+#ifndef _PIIREMAP_H
+#define _PIIREMAP_H
+
+/**
+ * A precompiled geometric mapping between two images. PiiRemap
+ * stores, for each output pixel, the position of the upper left
+ * corner of the 2-by-2 source neighborhood it is interpolated from
+ * and the horizontal and vertical interpolation weights as 8-bit
+ * fixed-point fractions. Once compiled, the same mapping can be
+ * applied to any number of images without evaluating the geometry
+ * again. Use it whenever the same lens correction, rotation or
+ * other warp is applied to a stream of images of the same size.
+ *
+ * The compiled map takes six bytes per output pixel. Pixel positions
+ * are quantized to 1/256 pixels. 8-bit gray-level and four-channel
+ * color images are interpolated with integer SSE2 arithmetic; other
+ * types are interpolated in floating point using the same quantized
+ * weights. Output pixels that map outside of the source image are
+ * set to a background value. Source images can be at most
+ * [MaxSourceSize] pixels in both directions; use
+ * PiiImage::remap() for larger ones.
+ *
+ * ~~~(c++)
+ * PiiRemap remap(PiiCalibration::undistortMap(480, 640, intrinsic), 480, 640);
+ * // For each frame
+ * PiiMatrix<unsigned char> matCorrected = remap.apply(matFrame);
+ * ~~~
+ */
+class PII_IMAGE_EXPORT PiiRemap
+{
+public:
+  /**
+   * The maximum number of rows and columns in a source image.
+   */
+  enum { MaxSourceSize = 65535 };
+
+  /**
+   * Creates an empty map.
+   */
+  PiiRemap();
+
+  /**
+   * Compiles a coordinate map. The size of the output will be equal
+   * to the size of *map*. Each element of *map* stores the (x,y)
+   * coordinates of the source pixel the corresponding output pixel
+   * is sampled from. Coordinates are measured so that the center of
+   * the upper left pixel is at (0,0). Integer coordinates result in
+   * pure copying, fractional coordinates in bilinear interpolation.
+   * Coordinates that are outside of the source image (or NaNs) mark
+   * background pixels.
+   *
+   * @param map the coordinate map, e.g. from
+   * PiiCalibration::undistortMap().
+   *
+   * @param sourceRows the number of rows in the images the map will
+   * be applied to.
+   *
+   * @param sourceColumns the number of columns in the images the map
+   * will be applied to.
+   *
+   * @exception PiiInvalidArgumentException& if the source size is
+   * not supported. See [supportsSourceSize()].
+   */
+  template <class U> PiiRemap(const PiiMatrix<PiiPoint<U> >& map, int sourceRows, int sourceColumns);
+
+  PiiRemap(const PiiRemap& other);
+  ~PiiRemap();
+  PiiRemap& operator= (const PiiRemap& other);
+
+  /**
+   * Compiles a projective *transform* for *sourceRows*-by-
+   * *sourceColumns* images. The size of the output and the treatment
+   * of the transformed image's boundaries are determined in the same
+   * way as in PiiImage::transform().
+   *
+   * ~~~(c++)
+   * // Rotate 640x480 images 10 degrees around their center
+   * PiiRemap rotation(PiiRemap::transform(PiiImage::createRotationTransform(Pii::degToRad(10.0f), 320, 240),
+   *                                       480, 640));
+   * ~~~
+   *
+   * @exception PiiMathException& if the transform matrix is singular.
+   *
+   * @exception PiiInvalidArgumentException& if the source size is
+   * not supported. See [supportsSourceSize()].
+   */
+  static PiiRemap transform(const PiiMatrix<float>& transform,
+                            int sourceRows, int sourceColumns,
+                            PiiImage::TransformedSize handling = PiiImage::ExpandAsNecessary);
+
+  /**
+   * Returns `true` if the map is empty, and `false` otherwise.
+   */
+  bool isEmpty() const;
+  /**
+   * Returns the number of rows in the output.
+   */
+  int rows() const;
+  /**
+   * Returns the number of columns in the output.
+   */
+  int columns() const;
+  /**
+   * Returns the number of rows the source image must have.
+   */
+  int sourceRows() const;
+  /**
+   * Returns the number of columns the source image must have.
+   */
+  int sourceColumns() const;
+
+  /**
+   * Returns `true` if images of the given size can be remapped, and
+   * `false` otherwise. Both dimensions must be at most
+   * [MaxSourceSize] pixels.
+   */
+  static bool supportsSourceSize(int sourceRows, int sourceColumns);
+
+  /**
+   * Applies the map to *image*.
+   *
+   * @param image the source image. Its size must match the source
+   * size the map was compiled for. Otherwise, an empty matrix will be
+   * returned.
+   *
+   * @param background the value of output pixels that map outside of
+   * *image*.
+   *
+   * @param threadCount the maximum number of threads used. The output
+   * is split into horizontal bands that are filled in parallel. Zero
+   * means one thread per processor core.
+   */
+  template <class T> PiiMatrix<T> apply(const PiiMatrix<T>& image,
+                                        T background = T(0),
+                                        int threadCount = 1) const;
+
+private:
+  enum { OutsidePixel = 0xffffffffu };
+
+  template <class T> class BandFunction;
+  template <class T> friend class BandFunction;
+
+  void setRow(int row, const double* x, const double* y);
+  template <class T> void remapRows(const T* const* sourceRows, T background,
+                                    int firstRow, int lastRow,
+                                    PiiMatrix<T>& result) const;
+
+  template <class T> static void remapRow(const quint32* positions,
+                                              const unsigned char* fractionsX,
+                                              const unsigned char* fractionsY,
+                                              int count,
+                                              const T* const* sourceRows,
+                                              T background,
+                                              T* target);
+  static void remapRow(const quint32* positions,
+                           const unsigned char* fractionsX,
+                           const unsigned char* fractionsY,
+                           int count,
+                           const unsigned char* const* sourceRows,
+                           unsigned char background,
+                           unsigned char* target);
+  static void remapRow(const quint32* positions,
+                           const unsigned char* fractionsX,
+                           const unsigned char* fractionsY,
+                           int count,
+                           const PiiColor4<unsigned char>* const* sourceRows,
+                           PiiColor4<unsigned char> background,
+                           PiiColor4<unsigned char>* target);
+
+  /// @internal
+  class Data
+  {
+  public:
+    Data();
+    Data(int rows, int columns, int sourceRows, int sourceColumns);
+    int iSourceRows, iSourceColumns;
+    // Source position of each output pixel: row index in the high
+    // 16 bits, column index in the low 16 bits.
+    PiiMatrix<quint32> matPositions;
+    // Interpolation weights in 1/256 pixels.
+    PiiMatrix<unsigned char> matFractionsX, matFractionsY;
+  } *d;
+};
+
+#include "PiiRemap-templates.h"
+
+#endif //_PIIREMAP_H
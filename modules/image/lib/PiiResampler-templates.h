@@ -0,0 +1,205 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIRESAMPLER_H
+# error "Never use <PiiResampler-templates.h> directly; include <PiiResampler.h> instead."
+#endif
+
+#include <PiiMath.h>
+#include <limits>
+
+template <class T> PiiMatrix<T> PiiResampler::resample(const PiiMatrix<T>& image, int rows, int columns)
+{
+  if (image.isEmpty() || rows <= 0 || columns <= 0)
+    return PiiMatrix<T>(qMax(rows, 0), qMax(columns, 0));
+
+  PiiMatrix<T> result(PiiMatrix<T>::uninitialized(rows, columns));
+  resample(image,
+           table(image.rows(), rows, d->kernel),
+           table(image.columns(), columns, d->kernel),
+           result);
+  return result;
+}
+
+template <class T> PiiMatrix<T> PiiResampler::resample(const PiiMatrix<T>& image, double ratio)
+{
+  return resample(image,
+                  Pii::round<int>(image.rows() * ratio),
+                  Pii::round<int>(image.columns() * ratio));
+}
+
+template <class T> PiiMatrix<T> PiiResampler::pyramidDown(const PiiMatrix<T>& image)
+{
+  if (image.isEmpty())
+    return PiiMatrix<T>();
+
+  const int iRows = (image.rows() + 1) / 2, iColumns = (image.columns() + 1) / 2;
+  PiiMatrix<T> result(PiiMatrix<T>::uninitialized(iRows, iColumns));
+  resample(image,
+           table(image.rows(), iRows, ReduceTable),
+           table(image.columns(), iColumns, ReduceTable),
+           result);
+  return result;
+}
+
+template <class T> PiiMatrix<T> PiiResampler::pyramidUp(const PiiMatrix<T>& image, int rows, int columns)
+{
+  if (image.isEmpty() || rows <= 0 || columns <= 0)
+    return PiiMatrix<T>(qMax(rows, 0), qMax(columns, 0));
+
+  PiiMatrix<T> result(PiiMatrix<T>::uninitialized(rows, columns));
+  resample(image,
+           table(image.rows(), rows, ExpandTable),
+           table(image.columns(), columns, ExpandTable),
+           result);
+  return result;
+}
+
+template <class T> QList<PiiMatrix<T> > PiiResampler::gaussianPyramid(const PiiMatrix<T>& image, int levels)
+{
+  QList<PiiMatrix<T> > lstResult;
+  if (levels <= 0 || image.isEmpty())
+    return lstResult;
+
+  lstResult << image;
+  while (lstResult.size() < levels &&
+         (lstResult.last().rows() > 1 || lstResult.last().columns() > 1))
+    lstResult << pyramidDown(lstResult.last());
+  return lstResult;
+}
+
+template <class T>
+QList<PiiMatrix<typename Pii::ToFloatingPoint<T>::Type> > PiiResampler::laplacianPyramid(const PiiMatrix<T>& image, int levels)
+{
+  typedef typename Pii::ToFloatingPoint<T>::Type FloatType;
+  typedef typename Channels<T>::Type SourceType;
+  typedef typename Channels<FloatType>::Type Real;
+  const int iChannels = Channels<T>::count;
+
+  QList<PiiMatrix<T> > lstGaussian(gaussianPyramid(image, levels));
+  QList<PiiMatrix<FloatType> > lstResult;
+  for (int i=0; i<lstGaussian.size()-1; ++i)
+    {
+      const PiiMatrix<T>& matLevel = lstGaussian[i];
+      const PiiMatrix<T>& matNext = lstGaussian[i+1];
+      // Expand the next level directly to floating point and
+      // subtract it from the current level.
+      PiiMatrix<FloatType> matDifference(PiiMatrix<FloatType>::uninitialized(matLevel.rows(),
+                                                                              matLevel.columns()));
+      resample(matNext,
+               table(matNext.rows(), matLevel.rows(), ExpandTable),
+               table(matNext.columns(), matLevel.columns(), ExpandTable),
+               matDifference);
+      const int iWidth = matLevel.columns() * iChannels;
+      for (int r=0; r<matLevel.rows(); ++r)
+        {
+          const SourceType* pLevel = reinterpret_cast<const SourceType*>(matLevel[r]);
+          Real* pDifference = reinterpret_cast<Real*>(matDifference[r]);
+          for (int c=0; c<iWidth; ++c)
+            pDifference[c] = Real(pLevel[c]) - pDifference[c];
+        }
+      lstResult << matDifference;
+    }
+  if (!lstGaussian.isEmpty())
+    lstResult << PiiMatrix<FloatType>(lstGaussian.last());
+  return lstResult;
+}
+
+template <class T> PiiMatrix<T> PiiResampler::collapseLaplacianPyramid(const QList<PiiMatrix<T> >& pyramid)
+{
+  if (pyramid.isEmpty())
+    return PiiMatrix<T>();
+
+  PiiMatrix<T> result(pyramid.last());
+  for (int i=pyramid.size()-2; i>=0; --i)
+    {
+      result = pyramidUp(result, pyramid[i].rows(), pyramid[i].columns());
+      result += pyramid[i];
+    }
+  return result;
+}
+
+template <class T, class U> void PiiResampler::resample(const PiiMatrix<T>& image,
+                                                        const Table& vertical,
+                                                        const Table& horizontal,
+                                                        PiiMatrix<U>& result)
+{
+  typedef typename Channels<T>::Type SourceType;
+  typedef typename Channels<U>::Type TargetType;
+  typedef typename Pii::ToFloatingPoint<SourceType>::PrimitiveType Real;
+  const int iChannels = Channels<T>::count;
+  const int iSourceWidth = image.columns() * iChannels,
+    iTargetWidth = result.columns() * iChannels;
+
+  // Row 0 holds the vertically filtered source row, row 1 the
+  // horizontally filtered result before conversion to the target
+  // type.
+  PiiMatrix<Real> matBuffer(2, qMax(iSourceWidth, iTargetWidth));
+  Real* pSum = matBuffer[0];
+  Real* pFiltered = matBuffer[1];
+
+  for (int r=0; r<result.rows(); ++r)
+    {
+      const int iFirst = vertical.vecFirst[r];
+      const float* pWeights = vertical.matWeights[r];
+      for (int c=0; c<iSourceWidth; ++c)
+        pSum[c] = 0;
+      for (int k=0; k<vertical.iTaps; ++k)
+        if (pWeights[k] != 0)
+          accumulateRow(reinterpret_cast<const SourceType*>(image[iFirst + k]),
+                        Real(pWeights[k]), pSum, iSourceWidth);
+      filterRow(pSum, horizontal, iChannels, pFiltered);
+      storeRow(pFiltered, reinterpret_cast<TargetType*>(result[r]), iTargetWidth);
+    }
+}
+
+template <class T, class Real> void PiiResampler::accumulateRow(const T* source, Real weight, Real* sum, int count)
+{
+  for (int i=0; i<count; ++i)
+    sum[i] += weight * Real(source[i]);
+}
+
+template <class Real> void PiiResampler::filterRow(const Real* source, const Table& table, int channels, Real* target)
+{
+  const int iCount = table.vecFirst.size(), iTaps = table.iTaps;
+  for (int i=0; i<iCount; ++i)
+    {
+      const float* pWeights = table.matWeights[i];
+      const Real* pSource = source + table.vecFirst[i] * channels;
+      for (int c=0; c<channels; ++c, ++target)
+        {
+          Real sum = 0;
+          for (int k=0; k<iTaps; ++k)
+            sum += pWeights[k] * pSource[k*channels + c];
+          *target = sum;
+        }
+    }
+}
+
+template <class Real, class T> void PiiResampler::storeRow(const Real* source, T* target, int count)
+{
+  if (Pii::IsInteger<T>::boolValue)
+    {
+      // Kernels with negative lobes may overshoot.
+      const double dMin = double(std::numeric_limits<T>::min()), dMax = double(std::numeric_limits<T>::max());
+      for (int i=0; i<count; ++i)
+        target[i] = T(Pii::round(qBound(dMin, double(source[i]), dMax)));
+    }
+  else
+    {
+      for (int i=0; i<count; ++i)
+        target[i] = T(source[i]);
+    }
+}
@@ -0,0 +1,368 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiResampler.h"
+#include <PiiMath.h>
+#include <QMutexLocker>
+#include <cmath>
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+namespace
+{
+  const int iMaxCacheSize = 64;
+
+  // Keys' cubic convolution kernel, a = -0.5
+  double cubic(double x)
+  {
+    x = Pii::abs(x);
+    if (x < 1)
+      return (1.5*x - 2.5)*x*x + 1;
+    if (x < 2)
+      return ((-0.5*x + 2.5)*x - 4)*x + 2;
+    return 0;
+  }
+
+  double lanczos(double x)
+  {
+    x = Pii::abs(x);
+    if (x < 1e-8)
+      return 1;
+    if (x >= 3)
+      return 0;
+    const double dPiX = M_PI * x;
+    return 3 * std::sin(dPiX) * std::sin(dPiX / 3) / (dPiX * dPiX);
+  }
+
+  double triangle(double x)
+  {
+    x = Pii::abs(x);
+    return x < 1 ? 1 - x : 0;
+  }
+
+  // Collects the weights of a single output pixel. Source indices are
+  // clamped to the valid range, which replicates border pixels.
+  class WeightAccumulator
+  {
+  public:
+    WeightAccumulator(int sourceSize) :
+      _vecWeights(sourceSize, 0.0), _iFirst(sourceSize), _iLast(-1)
+    {}
+
+    void add(int index, double weight)
+    {
+      index = qBound(0, index, _vecWeights.size()-1);
+      _vecWeights[index] += weight;
+      _iFirst = qMin(_iFirst, index);
+      _iLast = qMax(_iLast, index);
+    }
+
+    int first() const { return _iLast < 0 ? 0 : _iFirst; }
+
+    // Returns the collected weights, starting at first(), normalized
+    // to sum up to one. Resets the accumulator.
+    QVector<double> take()
+    {
+      if (_iLast < 0)
+        return QVector<double>(1, 1.0);
+      double dSum = 0;
+      for (int i=_iFirst; i<=_iLast; ++i)
+        dSum += _vecWeights[i];
+      if (dSum == 0)
+        dSum = 1;
+      QVector<double> vecResult(_iLast - _iFirst + 1);
+      for (int i=_iFirst; i<=_iLast; ++i)
+        {
+          vecResult[i - _iFirst] = _vecWeights[i] / dSum;
+          _vecWeights[i] = 0;
+        }
+      _iFirst = _vecWeights.size();
+      _iLast = -1;
+      return vecResult;
+    }
+
+  private:
+    QVector<double> _vecWeights;
+    int _iFirst, _iLast;
+  };
+}
+
+PiiResampler::Data::Data(Kernel k) :
+  kernel(k)
+{
+}
+
+PiiResampler::PiiResampler(Kernel kernel) :
+  d(new Data(kernel))
+{
+}
+
+PiiResampler::~PiiResampler()
+{
+  delete d;
+}
+
+void PiiResampler::setKernel(Kernel kernel)
+{
+  if (kernel != d->kernel)
+    {
+      d->kernel = kernel;
+      clearCache();
+    }
+}
+
+PiiResampler::Kernel PiiResampler::kernel() const { return d->kernel; }
+
+void PiiResampler::clearCache()
+{
+  QMutexLocker lock(&d->cacheMutex);
+  d->mapTables.clear();
+}
+
+int PiiResampler::cacheSize() const
+{
+  QMutexLocker lock(&d->cacheMutex);
+  return d->mapTables.size();
+}
+
+PiiResampler::Table PiiResampler::table(int sourceSize, int targetSize, int type)
+{
+  const qint64 iKey = (qint64(type + 8) << 56) | (qint64(sourceSize) << 28) | qint64(targetSize);
+  {
+    QMutexLocker lock(&d->cacheMutex);
+    Table cachedTable(d->mapTables.value(iKey));
+    if (cachedTable.iTaps != 0)
+      return cachedTable;
+  }
+
+  // The table is built outside of the lock. If two threads miss the
+  // cache at the same time, both build the same table.
+  Table newTable(createTable(sourceSize, targetSize, type));
+  QMutexLocker lock(&d->cacheMutex);
+  if (d->mapTables.size() >= iMaxCacheSize)
+    d->mapTables.clear();
+  d->mapTables.insert(iKey, newTable);
+  return newTable;
+}
+
+PiiResampler::Table PiiResampler::createTable(int sourceSize, int targetSize, int type)
+{
+  WeightAccumulator weights(sourceSize);
+  QVector<int> vecFirst(targetSize);
+  QList<QVector<double> > lstWeights;
+  const double dScale = double(sourceSize) / targetSize;
+
+  if (type == AutomaticKernel)
+    type = sourceSize > targetSize ? AreaKernel : CubicKernel;
+
+  for (int i=0; i<targetSize; ++i)
+    {
+      switch (type)
+        {
+        case ReduceTable:
+          {
+            static const double aBinomial[] = { 1.0/16, 4.0/16, 6.0/16, 4.0/16, 1.0/16 };
+            for (int j=0; j<5; ++j)
+              weights.add(2*i + j - 2, aBinomial[j]);
+          }
+          break;
+        case ExpandTable:
+          if (i & 1)
+            {
+              weights.add(i/2, 0.5);
+              weights.add(i/2 + 1, 0.5);
+            }
+          else
+            {
+              weights.add(i/2 - 1, 1.0/8);
+              weights.add(i/2, 6.0/8);
+              weights.add(i/2 + 1, 1.0/8);
+            }
+          break;
+        case NearestNeighborKernel:
+          weights.add(int((i + 0.5) * dScale), 1);
+          break;
+        case AreaKernel:
+          {
+            // The output pixel covers [dStart, dEnd) in source
+            // coordinates. Each source pixel is weighted by the
+            // length of its overlap with this interval.
+            const double dStart = i * dScale, dEnd = (i+1) * dScale;
+            for (int j=int(dStart); j<dEnd && j<sourceSize; ++j)
+              {
+                const double dOverlap = qMin(dEnd, double(j+1)) - qMax(dStart, double(j));
+                if (dOverlap > 1e-9)
+                  weights.add(j, dOverlap);
+              }
+          }
+          break;
+        default:
+          {
+            double (*kernelFunction)(double) = type == LinearKernel ? triangle :
+              type == CubicKernel ? cubic : lanczos;
+            const double dRadius = type == LinearKernel ? 1 : type == CubicKernel ? 2 : 3;
+            // When shrinking, the kernel is stretched to cover all
+            // source pixels (antialiasing).
+            const double dStretch = qMax(dScale, 1.0);
+            const double dCenter = (i + 0.5) * dScale - 0.5;
+            const int iStart = int(std::ceil(dCenter - dRadius * dStretch)),
+              iEnd = int(std::floor(dCenter + dRadius * dStretch));
+            for (int j=iStart; j<=iEnd; ++j)
+              {
+                const double dWeight = kernelFunction((j - dCenter) / dStretch);
+                if (dWeight != 0)
+                  weights.add(j, dWeight);
+              }
+          }
+        }
+      vecFirst[i] = weights.first();
+      lstWeights << weights.take();
+    }
+
+  Table result;
+  finishTable(result, vecFirst, lstWeights, sourceSize);
+  return result;
+}
+
+void PiiResampler::finishTable(Table& table,
+                               const QVector<int>& vecFirst,
+                               const QList<QVector<double> >& lstWeights,
+                               int sourceSize)
+{
+  const int iTargetSize = lstWeights.size();
+  int iTaps = 1;
+  for (int i=0; i<iTargetSize; ++i)
+    iTaps = qMax(iTaps, lstWeights[i].size());
+
+  table.iTaps = iTaps;
+  table.vecFirst.resize(iTargetSize);
+  table.matWeights.resize(iTargetSize, iTaps);
+  table.matBlockWeights.resize((iTargetSize + 3) / 4, iTaps * 4);
+
+  for (int i=0; i<iTargetSize; ++i)
+    {
+      const QVector<double>& vecWeights = lstWeights[i];
+      // All rows are iTaps wide. Windows that would extend beyond the
+      // end of the source are shifted left and padded with zeros.
+      const int iFirst = qMin(vecFirst[i], sourceSize - iTaps);
+      const int iOffset = vecFirst[i] - iFirst;
+      table.vecFirst[i] = iFirst;
+      float* pWeights = table.matWeights[i];
+      float* pBlockWeights = table.matBlockWeights[i/4] + (i & 3);
+      for (int j=0; j<vecWeights.size(); ++j)
+        {
+          pWeights[j + iOffset] = float(vecWeights[j]);
+          pBlockWeights[(j + iOffset)*4] = float(vecWeights[j]);
+        }
+    }
+}
+
+void PiiResampler::accumulateRow(const unsigned char* source, float weight, float* sum, int count)
+{
+  int i = 0;
+#ifdef __SSE2__
+  const __m128 weight4 = _mm_set1_ps(weight);
+  const __m128i zero = _mm_setzero_si128();
+#  define PII_ACCUMULATE(PIXELS, INDEX) \
+  _mm_storeu_ps(sum + i + INDEX, _mm_add_ps(_mm_loadu_ps(sum + i + INDEX), \
+                                            _mm_mul_ps(_mm_cvtepi32_ps(PIXELS), weight4)))
+  for (; i <= count - 16; i += 16)
+    {
+      const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+      const __m128i low = _mm_unpacklo_epi8(pixels, zero), high = _mm_unpackhi_epi8(pixels, zero);
+      PII_ACCUMULATE(_mm_unpacklo_epi16(low, zero), 0);
+      PII_ACCUMULATE(_mm_unpackhi_epi16(low, zero), 4);
+      PII_ACCUMULATE(_mm_unpacklo_epi16(high, zero), 8);
+      PII_ACCUMULATE(_mm_unpackhi_epi16(high, zero), 12);
+    }
+#  undef PII_ACCUMULATE
+#endif
+  for (; i < count; ++i)
+    sum[i] += weight * float(source[i]);
+}
+
+void PiiResampler::accumulateRow(const float* source, float weight, float* sum, int count)
+{
+  int i = 0;
+#ifdef __SSE2__
+  const __m128 weight4 = _mm_set1_ps(weight);
+  for (; i <= count - 4; i += 4)
+    _mm_storeu_ps(sum + i, _mm_add_ps(_mm_loadu_ps(sum + i),
+                                      _mm_mul_ps(_mm_loadu_ps(source + i), weight4)));
+#endif
+  for (; i < count; ++i)
+    sum[i] += weight * source[i];
+}
+
+void PiiResampler::filterRow(const float* source, const Table& table, int channels, float* target)
+{
+#ifdef __SSE2__
+  if (channels != 1)
+    {
+      filterRow<float>(source, table, channels, target);
+      return;
+    }
+  // Four adjacent output pixels are calculated in parallel. Their
+  // weights are interleaved in matBlockWeights.
+  const int iCount = table.vecFirst.size(), iTaps = table.iTaps;
+  const int* pFirst = table.vecFirst.constData();
+  int i = 0;
+  for (; i <= iCount - 4; i += 4)
+    {
+      const float* pWeights = table.matBlockWeights[i >> 2];
+      const float* p0 = source + pFirst[i], *p1 = source + pFirst[i+1],
+        *p2 = source + pFirst[i+2], *p3 = source + pFirst[i+3];
+      __m128 sum = _mm_setzero_ps();
+      for (int k=0; k<iTaps; ++k, pWeights += 4)
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(pWeights),
+                                         _mm_set_ps(p3[k], p2[k], p1[k], p0[k])));
+      _mm_storeu_ps(target + i, sum);
+    }
+  for (; i < iCount; ++i)
+    {
+      const float* pWeights = table.matWeights[i];
+      const float* pSource = source + pFirst[i];
+      float fSum = 0;
+      for (int k=0; k<iTaps; ++k)
+        fSum += pWeights[k] * pSource[k];
+      target[i] = fSum;
+    }
+#else
+  filterRow<float>(source, table, channels, target);
+#endif
+}
+
+void PiiResampler::storeRow(const float* source, unsigned char* target, int count)
+{
+  int i = 0;
+#ifdef __SSE2__
+  // Clamping to [0, 255] first makes truncation after adding 0.5
+  // equal to rounding to the nearest integer.
+  const __m128 zero = _mm_setzero_ps(), max = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+#  define PII_ROUND(INDEX) \
+  _mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(source + i + INDEX), zero), max), half))
+  for (; i <= count - 16; i += 16)
+    {
+      const __m128i low = _mm_packs_epi32(PII_ROUND(0), PII_ROUND(4)),
+        high = _mm_packs_epi32(PII_ROUND(8), PII_ROUND(12));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(target + i), _mm_packus_epi16(low, high));
+    }
+#  undef PII_ROUND
+#endif
+  for (; i < count; ++i)
+    target[i] = (unsigned char)(qBound(0.0f, source[i], 255.0f) + 0.5f);
+}
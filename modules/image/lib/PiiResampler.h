@@ -0,0 +1,269 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiImageGlobal.h"
+#include <PiiMatrix.h>
+#include <PiiColor.h>
+#include <PiiTypeTraits.h>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QVector>
+
+#ifndef _PIIRESAMPLER_H
+#define _PIIRESAMPLER_H
+
+/**
+ * A separable image resampler with precomputed filter coefficients.
+ *
+ * PiiResampler changes the size of an image in two passes. The
+ * vertical pass combines a few input rows into a floating-point row
+ * buffer, and the horizontal pass filters the buffer into an output
+ * row. The source pixels and weights used for each output row and
+ * column depend only on the source size, the target size and the
+ * kernel. They are therefore calculated once and stored in a cache
+ * inside the resampler. Resampling many images of the same size
+ * (e.g. frames from a camera) with the same resampler only pays the
+ * cost of the filtering itself.
+ *
+ * Unlike PiiImage::scale(), the resampler takes the size change into
+ * account: when an image is shrunk, the kernel is stretched so that
+ * every source pixel contributes to the result. This removes the
+ * aliasing artifacts that point sampling produces with large
+ * reduction ratios.
+ *
+ * Gray-level and color images of all primitive types are supported.
+ * Color channels are filtered independently. Integer results are
+ * rounded and saturated to the range of the type. 8-bit and `float`
+ * images are processed with SSE2 instructions when available.
+ *
+ * ~~~(c++)
+ * PiiResampler resampler(PiiResampler::LanczosKernel);
+ * PiiMatrix<PiiColor<> > thumbnail = resampler.resample(image, 120, 160);
+ *
+ * // Five levels, the first one is the original image
+ * QList<PiiMatrix<unsigned char> > lstLevels = resampler.gaussianPyramid(grayImage, 5);
+ * ~~~
+ *
+ * The coefficient cache is protected by a mutex, so the same
+ * resampler can be used for resampling in many threads at once.
+ * Changing the kernel while another thread is resampling is not
+ * safe.
+ */
+class PII_IMAGE_EXPORT PiiResampler
+{
+public:
+  /**
+   * Interpolation kernels.
+   *
+   * - `AutomaticKernel` - use `AreaKernel` when shrinking and
+   * `CubicKernel` when enlarging. The choice is made separately for
+   * the horizontal and vertical directions.
+   *
+   * - `NearestNeighborKernel` - take the source pixel closest to the
+   * center of each output pixel. Fast, but aliases when shrinking.
+   *
+   * - `AreaKernel` - average all source pixels covered by an output
+   * pixel, weighted by the covered area. The best choice for
+   * shrinking.
+   *
+   * - `LinearKernel` - a triangle kernel. Bilinear interpolation when
+   * enlarging.
+   *
+   * - `CubicKernel` - Keys' cubic convolution kernel with \(a =
+   * -0.5\). Bicubic interpolation when enlarging.
+   *
+   * - `LanczosKernel` - a three-lobed Lanczos (windowed sinc) kernel.
+   * The sharpest of the kernels, but slightly overshoots at edges.
+   */
+  enum Kernel
+  {
+    AutomaticKernel,
+    NearestNeighborKernel,
+    AreaKernel,
+    LinearKernel,
+    CubicKernel,
+    LanczosKernel
+  };
+
+  /**
+   * Creates a new resampler that uses the given interpolation
+   * *kernel*.
+   */
+  PiiResampler(Kernel kernel = AutomaticKernel);
+
+  ~PiiResampler();
+
+  /**
+   * Sets the interpolation kernel and clears the coefficient cache if
+   * the kernel changes.
+   */
+  void setKernel(Kernel kernel);
+  /**
+   * Returns the interpolation kernel.
+   */
+  Kernel kernel() const;
+
+  /**
+   * Removes all precomputed coefficient tables. The cache is also
+   * cleared automatically once it holds more than 64 tables.
+   */
+  void clearCache();
+
+  /**
+   * Returns the number of precomputed coefficient tables. Each
+   * distinct pair of source and target sizes (rows and columns
+   * counted separately) needs one table.
+   */
+  int cacheSize() const;
+
+  /**
+   * Resamples *image* to *rows*-by-*columns* pixels. If either of the
+   * dimensions of *image* or the target size is zero, an empty
+   * matrix with the requested size will be returned.
+   *
+   * ~~~(c++)
+   * PiiResampler resampler;
+   * // Shrinks with area averaging
+   * PiiMatrix<unsigned char> matSmall = resampler.resample(image, 240, 320);
+   * // Enlarges with bicubic interpolation
+   * PiiMatrix<unsigned char> matLarge = resampler.resample(image, 960, 1280);
+   * ~~~
+   */
+  template <class T> PiiMatrix<T> resample(const PiiMatrix<T>& image, int rows, int columns);
+
+  /**
+   * Same as above, but scales both dimensions of *image* by *ratio*.
+   * The size of the result is rounded to the nearest integer.
+   */
+  template <class T> PiiMatrix<T> resample(const PiiMatrix<T>& image, double ratio);
+
+  /**
+   * Builds a Gaussian pyramid with at most *levels* levels. The first
+   * level is *image* itself. Each subsequent level is obtained by
+   * smoothing the previous one with the 5-tap binomial kernel [1 4 6
+   * 4 1]/16 in both directions and dropping every second row and
+   * column. A level with *n* rows has \(\lceil n/2 \rceil\) rows on
+   * the next level. Smoothing and decimation are performed in a
+   * single pass. The pyramid stops early if a level shrinks to a
+   * single pixel.
+   */
+  template <class T> QList<PiiMatrix<T> > gaussianPyramid(const PiiMatrix<T>& image, int levels);
+
+  /**
+   * Builds a Laplacian pyramid with at most *levels* levels. Level
+   * *i* is the difference between level *i* of the Gaussian pyramid
+   * and an expanded (upsampled and smoothed) version of level *i+1*.
+   * The last level stores the coarsest level of the Gaussian pyramid
+   * as such. The original image can be reconstructed with
+   * [collapseLaplacianPyramid()].
+   */
+  template <class T>
+  QList<PiiMatrix<typename Pii::ToFloatingPoint<T>::Type> > laplacianPyramid(const PiiMatrix<T>& image, int levels);
+
+  /**
+   * Reconstructs an image from a Laplacian pyramid created with
+   * [laplacianPyramid()]. Levels are expanded and summed starting
+   * from the coarsest one.
+   */
+  template <class T> PiiMatrix<T> collapseLaplacianPyramid(const QList<PiiMatrix<T> >& pyramid);
+
+  /**
+   * Same as [gaussianPyramid()], but only calculates the next level
+   * of a pyramid.
+   */
+  template <class T> PiiMatrix<T> pyramidDown(const PiiMatrix<T>& image);
+
+  /**
+   * Upsamples *image* to *rows*-by-*columns* pixels using the
+   * expansion filter of the Laplacian pyramid. The target size must be
+   * either \(2n\) or \(2n-1\), where *n* is the size of *image*.
+   */
+  template <class T> PiiMatrix<T> pyramidUp(const PiiMatrix<T>& image, int rows, int columns);
+
+private:
+  /// @internal
+  enum TableType { ReduceTable = -1, ExpandTable = -2 };
+
+  /// @internal
+  struct Table
+  {
+    Table() : iTaps(0) {}
+    // The number of source pixels used for each output pixel.
+    int iTaps;
+    // The index of the first source pixel for each output pixel.
+    QVector<int> vecFirst;
+    // iTaps weights for each output pixel.
+    PiiMatrix<float> matWeights;
+    // The same weights grouped for four adjacent output pixels:
+    // row i stores the weights of outputs 4i...4i+3, interleaved.
+    PiiMatrix<float> matBlockWeights;
+  };
+
+  /// @internal
+  template <class T> struct Channels
+  {
+    typedef T Type;
+    enum { count = 1 };
+  };
+  template <class T> struct Channels<PiiColor<T> >
+  {
+    typedef T Type;
+    enum { count = 3 };
+  };
+  template <class T> struct Channels<PiiColor4<T> >
+  {
+    typedef T Type;
+    enum { count = 4 };
+  };
+
+  Table table(int sourceSize, int targetSize, int type);
+  static Table createTable(int sourceSize, int targetSize, int type);
+  static void finishTable(Table& table,
+                          const QVector<int>& vecFirst,
+                          const QList<QVector<double> >& lstWeights,
+                          int sourceSize);
+
+  template <class T, class U> void resample(const PiiMatrix<T>& image,
+                                            const Table& vertical,
+                                            const Table& horizontal,
+                                            PiiMatrix<U>& result);
+
+  template <class T, class Real> static void accumulateRow(const T* source, Real weight, Real* sum, int count);
+  static void accumulateRow(const unsigned char* source, float weight, float* sum, int count);
+  static void accumulateRow(const float* source, float weight, float* sum, int count);
+
+  template <class Real> static void filterRow(const Real* source, const Table& table, int channels, Real* target);
+  static void filterRow(const float* source, const Table& table, int channels, float* target);
+
+  template <class Real, class T> static void storeRow(const Real* source, T* target, int count);
+  static void storeRow(const float* source, unsigned char* target, int count);
+
+  /// @internal
+  class Data
+  {
+  public:
+    Data(Kernel kernel);
+    Kernel kernel;
+    QMap<qint64,Table> mapTables;
+    QMutex cacheMutex;
+  } *d;
+
+  PII_DISABLE_COPY(PiiResampler);
+};
+
+#include "PiiResampler-templates.h"
+
+#endif //_PIIRESAMPLER_H
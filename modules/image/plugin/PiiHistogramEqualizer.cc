@@ -18,7 +18,10 @@
 #include "PiiHistogram.h"
 
 PiiHistogramEqualizer::Data::Data() :
-  iLevels(256)
+  iLevels(256),
+  mode(GlobalEqualization),
+  gridSize(8,8),
+  dClipLimit(3.0)
 {
 }
 
@@ -50,11 +53,29 @@ void PiiHistogramEqualizer::process()
 
 template <class T> void PiiHistogramEqualizer::equalize(const PiiVariant& obj)
 {
+  PII_D;
   const PiiMatrix<T> img = obj.valueAs<PiiMatrix<T> >();
-  emitObject(PiiImage::equalize(img, (unsigned)_d()->iLevels));
+  if (d->mode == AdaptiveEqualization)
+    emitObject(PiiImage::equalizeAdaptive(img,
+                                          d->gridSize.height(), d->gridSize.width(),
+                                          d->dClipLimit,
+                                          (unsigned)d->iLevels));
+  else
+    emitObject(PiiImage::equalize(img, (unsigned)d->iLevels));
 }
 
 int PiiHistogramEqualizer::levels() const
 {
   return _d()->iLevels;
 }
+
+void PiiHistogramEqualizer::setMode(EqualizationMode mode) { _d()->mode = mode; }
+PiiHistogramEqualizer::EqualizationMode PiiHistogramEqualizer::mode() const { return _d()->mode; }
+void PiiHistogramEqualizer::setGridSize(const QSize& gridSize)
+{
+  if (gridSize.width() > 0 && gridSize.height() > 0)
+    _d()->gridSize = gridSize;
+}
+QSize PiiHistogramEqualizer::gridSize() const { return _d()->gridSize; }
+void PiiHistogramEqualizer::setClipLimit(double clipLimit) { _d()->dClipLimit = clipLimit; }
+double PiiHistogramEqualizer::clipLimit() const { return _d()->dClipLimit; }
@@ -20,7 +20,9 @@
 
 /**
  * Histogram equalizer. Enhances the contrast of input images by
- * making their gray-level distributions as uniform as possible.
+ * making their gray-level distributions as uniform as possible. The
+ * distribution can be equalized either globally or locally in tiles
+ * (CLAHE). See [mode].
  *
  * Inputs
  * ------
@@ -44,12 +46,50 @@ class PiiHistogramEqualizer : public PiiDefaultOperation
    */
   Q_PROPERTY(int levels READ levels WRITE setLevels);
 
+  /**
+   * Equalization mode. The default is `GlobalEqualization`.
+   */
+  Q_PROPERTY(EqualizationMode mode READ mode WRITE setMode);
+  Q_ENUMS(EqualizationMode);
+
+  /**
+   * The number of tiles in horizontal (width) and vertical (height)
+   * direction in `AdaptiveEqualization` mode. The default is 8-by-8.
+   */
+  Q_PROPERTY(QSize gridSize READ gridSize WRITE setGridSize);
+
+  /**
+   * The maximum height of a tile histogram relative to the average
+   * height in `AdaptiveEqualization` mode. Lower values produce
+   * less contrast, but also amplify less noise. Zero disables
+   * clipping. The default value is 3.
+   */
+  Q_PROPERTY(double clipLimit READ clipLimit WRITE setClipLimit);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
+  /**
+   * Equalization modes.
+   *
+   * - `GlobalEqualization` - use the histogram of the whole image.
+   * See PiiImage::equalize().
+   *
+   * - `AdaptiveEqualization` - contrast-limited adaptive histogram
+   * equalization. Each pixel is equalized based on the histograms of
+   * the tiles closest to it. See PiiImage::equalizeAdaptive().
+   */
+  enum EqualizationMode { GlobalEqualization, AdaptiveEqualization };
+
   PiiHistogramEqualizer();
 
   void setLevels(int levels);
   int levels() const;
+  void setMode(EqualizationMode mode);
+  EqualizationMode mode() const;
+  void setGridSize(const QSize& gridSize);
+  QSize gridSize() const;
+  void setClipLimit(double clipLimit);
+  double clipLimit() const;
 
 protected:
   void process();
@@ -62,7 +102,11 @@ private:
   {
   public:
     Data();
-    int iLevels;};
+    int iLevels;
+    EqualizationMode mode;
+    QSize gridSize;
+    double dClipLimit;
+  };
   PII_D_FUNC;
 
 };
@@ -23,7 +23,10 @@ PiiImageFilterOperation::Data::Data() :
   filterType(Prebuilt), iFilterSize(3),
   borderHandling(Pii::ExtendZeros),
   matPrebuiltFilter(3, 3),
-  bSeparableFilter(false)
+  bSeparableFilter(false),
+  iTileThreads(1),
+  iHalo(0),
+  iBandThreads(1)
 {
 }
 
@@ -117,6 +120,13 @@ void PiiImageFilterOperation::check(bool reset)
          d->matHorzFilter.rows(), d->matHorzFilter.columns(),
          d->matVertFilter.rows(), d->matVertFilter.columns());
   */
+
+  d->iHalo = (d->filterType == Median ? d->iFilterSize : d->matActiveFilter.rows()) / 2;
+  // Periodic extension needs rows from the opposite border, and
+  // ExtendNot changes the size of the output. Neither can be done
+  // in independent bands.
+  d->iBandThreads = d->borderHandling == Pii::ExtendPeriodic || d->borderHandling == Pii::ExtendNot ?
+    1 : d->iTileThreads;
 }
 
 void PiiImageFilterOperation::process()
@@ -142,111 +152,117 @@ template <class T> void PiiImageFilterOperation::intGrayFilter(const PiiVariant&
 {
   PII_D;
   const PiiMatrix<T> img = obj.valueAs<PiiMatrix<T> >();
-  switch (d->filterType)
-    {
-    case Prebuilt:
-    case Custom:
-      if (d->bSeparableFilter)
-        emitObject(PiiImage::intFilter(img, d->matHorzFilter, d->matVertFilter, d->borderHandling));
-      else
-        emitObject(PiiImage::intFilter(img, d->matActiveFilter, d->borderHandling));
-      break;
-    case Median:
-      emitObject(PiiImage::medianFilter(img, d->iFilterSize, d->iFilterSize, d->borderHandling));
-      break;
-    }
+  if (d->filterType == Median)
+    emitObject(PiiImage::processInBands(img, d->iHalo, d->iBandThreads,
+                                        this, &PiiImageFilterOperation::grayMedianBand<T>));
+  else
+    emitObject(PiiImage::processInBands(img, d->iHalo, d->iBandThreads,
+                                        this, &PiiImageFilterOperation::intGrayBand<T>));
 }
 
 template <class T> void PiiImageFilterOperation::floatGrayFilter(const PiiVariant& obj)
 {
   PII_D;
   const PiiMatrix<T> img = obj.valueAs<PiiMatrix<T> >();
-  switch (d->filterType)
-    {
-    case Prebuilt:
-    case Custom:
-      if (d->bSeparableFilter)
-        emitObject(PiiImage::filter<T>(img, d->matHorzFilter, d->matVertFilter, d->borderHandling));
-      else
-        emitObject(PiiImage::filter<T>(img, d->matActiveFilter, d->borderHandling));
-      break;
-    case Median:
-      emitObject(PiiImage::medianFilter(img, d->iFilterSize, d->iFilterSize, d->borderHandling));
-      break;
-    }
+  emitObject(PiiImage::processInBands(img, d->iHalo, d->iBandThreads, this,
+                                      d->filterType == Median ?
+                                      &PiiImageFilterOperation::grayMedianBand<T> :
+                                      &PiiImageFilterOperation::floatGrayBand<T>));
 }
 
 template <class T> void PiiImageFilterOperation::intColorFilter(const PiiVariant& obj)
 {
   PII_D;
   const PiiMatrix<T> img = obj.valueAs<PiiMatrix<T> >();
-  typedef typename T::Type PrimitiveType;
-  switch (d->filterType)
-    {
-    case Custom:
-    case Prebuilt:
-      {
-        PiiMatrix<PrimitiveType> ch2 = d->bSeparableFilter ?
-          PiiImage::intFilter(PiiImage::colorChannel(img,2),
-                              d->matHorzFilter, d->matVertFilter, d->borderHandling) :
-          PiiImage::intFilter(PiiImage::colorChannel(img,2),
-                              d->matActiveFilter, d->borderHandling);
-
-        PiiMatrix<T> matResult(ch2.rows(), ch2.columns());
-        PiiImage::setColorChannel(matResult, 2, ch2);
-        for (int i=0; i <= 1; ++i)
-          PiiImage::setColorChannel(matResult, i, d->bSeparableFilter ?
-                                    PiiImage::intFilter(PiiImage::colorChannel(img,i),
-                                                        d->matHorzFilter, d->matVertFilter, d->borderHandling) :
-                                    PiiImage::intFilter(PiiImage::colorChannel(img,i),
-                                                        d->matActiveFilter, d->borderHandling));
-        emitObject(matResult);
-      }
-      break;
-    case Median:
-      {
-        PiiMatrix<PrimitiveType> ch2 = PiiImage::medianFilter(PiiImage::colorChannel(img,2),
-                                                               d->iFilterSize, d->iFilterSize, d->borderHandling);
-        PiiMatrix<T> matResult(ch2.rows(), ch2.columns());
-        PiiImage::setColorChannel(matResult, 2, ch2);
-        PiiImage::setColorChannel(matResult, 1, PiiImage::medianFilter(PiiImage::colorChannel(img,1),
-                                                                     d->iFilterSize, d->iFilterSize, d->borderHandling));
-        PiiImage::setColorChannel(matResult, 0, PiiImage::medianFilter(PiiImage::colorChannel(img,0),
-                                                                     d->iFilterSize, d->iFilterSize, d->borderHandling));
-        emitObject(matResult);
-      }
-      break;
-    }
+  emitObject(PiiImage::processInBands(img, d->iHalo, d->iBandThreads, this,
+                                      d->filterType == Median ?
+                                      &PiiImageFilterOperation::colorMedianBand<T> :
+                                      &PiiImageFilterOperation::intColorBand<T>));
 }
 
 template <class T> void PiiImageFilterOperation::floatColorFilter(const PiiVariant& obj)
 {
   PII_D;
   const PiiMatrix<T> img = obj.valueAs<PiiMatrix<T> >();
+  emitObject(PiiImage::processInBands(img, d->iHalo, d->iBandThreads, this,
+                                      d->filterType == Median ?
+                                      &PiiImageFilterOperation::colorMedianBand<T> :
+                                      &PiiImageFilterOperation::floatColorBand<T>));
+}
+
+template <class T> PiiMatrix<int> PiiImageFilterOperation::intGrayBand(const PiiMatrix<T>& img) const
+{
+  const PII_D;
+  if (d->bSeparableFilter)
+    return PiiImage::intFilter(img, d->matHorzFilter, d->matVertFilter, d->borderHandling);
+  else
+    return PiiImage::intFilter(img, d->matActiveFilter, d->borderHandling);
+}
+
+template <class T> PiiMatrix<T> PiiImageFilterOperation::floatGrayBand(const PiiMatrix<T>& img) const
+{
+  const PII_D;
+  if (d->bSeparableFilter)
+    return PiiImage::filter<T>(img, d->matHorzFilter, d->matVertFilter, d->borderHandling);
+  else
+    return PiiImage::filter<T>(img, d->matActiveFilter, d->borderHandling);
+}
+
+template <class T> PiiMatrix<T> PiiImageFilterOperation::intColorBand(const PiiMatrix<T>& img) const
+{
+  const PII_D;
   typedef typename T::Type PrimitiveType;
-  switch (d->filterType)
-    {
-    case Prebuilt:
-    case Custom:
-      if (d->bSeparableFilter)
-        emitObject(PiiImage::filter<T>(img,
-                                       PiiMatrix<PrimitiveType>(d->matHorzFilter),
-                                       PiiMatrix<PrimitiveType>(d->matVertFilter),
-                                       d->borderHandling));
-      else
-        emitObject(PiiImage::filter<T>(img,
-                                       PiiMatrix<PrimitiveType>(d->matActiveFilter),
-                                       d->borderHandling));
-      break;
-    case Median:
-      PiiMatrix<PrimitiveType> ch2 = PiiImage::medianFilter(PiiImage::colorChannel(img,2), d->iFilterSize, d->iFilterSize, d->borderHandling);
-      PiiMatrix<T> result(ch2.rows(), ch2.columns());
-      PiiImage::setColorChannel(result, 2, ch2);
-      PiiImage::setColorChannel(result, 1, PiiImage::medianFilter(PiiImage::colorChannel(img,1), d->iFilterSize, d->iFilterSize, d->borderHandling));
-      PiiImage::setColorChannel(result, 0, PiiImage::medianFilter(PiiImage::colorChannel(img,0), d->iFilterSize, d->iFilterSize, d->borderHandling));
-      emitObject(result);
-      break;
-    }
+  PiiMatrix<PrimitiveType> ch2 = d->bSeparableFilter ?
+    PiiImage::intFilter(PiiImage::colorChannel(img,2),
+                        d->matHorzFilter, d->matVertFilter, d->borderHandling) :
+    PiiImage::intFilter(PiiImage::colorChannel(img,2),
+                        d->matActiveFilter, d->borderHandling);
+
+  PiiMatrix<T> matResult(ch2.rows(), ch2.columns());
+  PiiImage::setColorChannel(matResult, 2, ch2);
+  for (int i=0; i <= 1; ++i)
+    PiiImage::setColorChannel(matResult, i, d->bSeparableFilter ?
+                              PiiImage::intFilter(PiiImage::colorChannel(img,i),
+                                                  d->matHorzFilter, d->matVertFilter, d->borderHandling) :
+                              PiiImage::intFilter(PiiImage::colorChannel(img,i),
+                                                  d->matActiveFilter, d->borderHandling));
+  return matResult;
+}
+
+template <class T> PiiMatrix<T> PiiImageFilterOperation::floatColorBand(const PiiMatrix<T>& img) const
+{
+  const PII_D;
+  typedef typename T::Type PrimitiveType;
+  if (d->bSeparableFilter)
+    return PiiImage::filter<T>(img,
+                               PiiMatrix<PrimitiveType>(d->matHorzFilter),
+                               PiiMatrix<PrimitiveType>(d->matVertFilter),
+                               d->borderHandling);
+  else
+    return PiiImage::filter<T>(img,
+                               PiiMatrix<PrimitiveType>(d->matActiveFilter),
+                               d->borderHandling);
+}
+
+template <class T> PiiMatrix<T> PiiImageFilterOperation::grayMedianBand(const PiiMatrix<T>& img) const
+{
+  const PII_D;
+  return PiiImage::medianFilter(img, d->iFilterSize, d->iFilterSize, d->borderHandling);
+}
+
+template <class T> PiiMatrix<T> PiiImageFilterOperation::colorMedianBand(const PiiMatrix<T>& img) const
+{
+  const PII_D;
+  typedef typename T::Type PrimitiveType;
+  PiiMatrix<PrimitiveType> ch2 = PiiImage::medianFilter(PiiImage::colorChannel(img,2),
+                                                         d->iFilterSize, d->iFilterSize, d->borderHandling);
+  PiiMatrix<T> matResult(ch2.rows(), ch2.columns());
+  PiiImage::setColorChannel(matResult, 2, ch2);
+  for (int i=0; i <= 1; ++i)
+    PiiImage::setColorChannel(matResult, i, PiiImage::medianFilter(PiiImage::colorChannel(img,i),
+                                                                   d->iFilterSize, d->iFilterSize,
+                                                                   d->borderHandling));
+  return matResult;
 }
 
 QString PiiImageFilterOperation::filterName() const { return _d()->strFilterName; }
@@ -254,3 +270,5 @@ PiiVariant PiiImageFilterOperation::filter() const { return _d()->pCustomFilter;
 int PiiImageFilterOperation::filterSize() const { return _d()->iFilterSize; }
 void PiiImageFilterOperation::setBorderHandling(ExtendMode borderHandling) { _d()->borderHandling = static_cast<Pii::ExtendMode>(borderHandling); }
 PiiImageFilterOperation::ExtendMode PiiImageFilterOperation::borderHandling() const { return static_cast<ExtendMode>(_d()->borderHandling); }
+void PiiImageFilterOperation::setTileThreads(int tileThreads) { _d()->iTileThreads = tileThreads; }
+int PiiImageFilterOperation::tileThreads() const { return _d()->iTileThreads; }
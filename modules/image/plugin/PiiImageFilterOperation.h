@@ -48,7 +48,10 @@ class PiiImageFilterOperation : public PiiDefaultOperation
    * etc. There are two special values not supported by makeFilter():
    *
    * - `median` - a median filter. Median filter is non-linear and
-   * cannot be implemented with ordinary correlation masks.
+   * cannot be implemented with ordinary correlation masks. The
+   * fastest algorithm for the filter size and image type is selected
+   * automatically (see PiiImage::medianFilter()). With 8-bit images,
+   * the processing time does not depend on filter size.
    *
    * - `custom` - [filter] will be used as the filter mask.
    *
@@ -86,6 +89,23 @@ class PiiImageFilterOperation : public PiiDefaultOperation
   Q_PROPERTY(ExtendMode borderHandling READ borderHandling WRITE setBorderHandling);
   Q_ENUMS(ExtendMode);
 
+  /**
+   * The number of threads used for filtering a single image. If this
+   * value is greater than one, large images are split into horizontal
+   * bands that are filtered in parallel. Each band is extended with
+   * enough neighboring rows to cover the filter mask, so the result
+   * equals that of a single-threaded run. With floating-point types
+   * the equality holds up to rounding because large masks are
+   * applied through the FFT, whose rounding depends on the size of
+   * the band. Zero means one thread per processor core. The default
+   * value is 1. `ExtendPeriodic`
+   * and `ExtendNot` border handling modes are always single-threaded.
+   *
+   * Unlike [threadCount], this property reduces the processing time
+   * of an individual frame, not only the overall throughput.
+   */
+  Q_PROPERTY(int tileThreads READ tileThreads WRITE setTileThreads);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 
 public:
@@ -111,6 +131,8 @@ public:
   int filterSize() const;
   void setBorderHandling(ExtendMode borderHandling);
   ExtendMode borderHandling() const;
+  void setTileThreads(int tileThreads);
+  int tileThreads() const;
 
   void check(bool reset);
 
@@ -126,6 +148,13 @@ private:
   template <class T> void floatColorFilter(const PiiVariant& obj);
   template <class T> void setCustomFilter(const PiiVariant& obj);
 
+  template <class T> PiiMatrix<int> intGrayBand(const PiiMatrix<T>& img) const;
+  template <class T> PiiMatrix<T> floatGrayBand(const PiiMatrix<T>& img) const;
+  template <class T> PiiMatrix<T> intColorBand(const PiiMatrix<T>& img) const;
+  template <class T> PiiMatrix<T> floatColorBand(const PiiMatrix<T>& img) const;
+  template <class T> PiiMatrix<T> grayMedianBand(const PiiMatrix<T>& img) const;
+  template <class T> PiiMatrix<T> colorMedianBand(const PiiMatrix<T>& img) const;
+
   /// @internal
   class Data : public PiiDefaultOperation::Data
   {
@@ -142,6 +171,10 @@ private:
     // Active filter and its decomposition (is available)
     bool bSeparableFilter;
     PiiMatrix<double> matActiveFilter, matHorzFilter, matVertFilter;
+    int iTileThreads;
+    // Rows needed above and below each band, and the number of
+    // threads actually used. Both are set in check().
+    int iHalo, iBandThreads;
   };
   PII_D_FUNC;
 
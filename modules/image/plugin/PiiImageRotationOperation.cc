@@ -19,7 +19,10 @@
 
 PiiImageRotationOperation::Data::Data() :
   dAngle(0.0),
-  transformedSize(PiiImage::ExpandAsNecessary)
+  transformedSize(PiiImage::ExpandAsNecessary),
+  iTileThreads(1),
+  dRemapAngle(0.0),
+  remapSize(PiiImage::ExpandAsNecessary)
 {
 }
 
@@ -92,13 +95,44 @@ template <class T> void PiiImageRotationOperation::rotate(const PiiVariant& obj)
 
   //qDebug("Rotating image %d degrees.", int(angle / M_PI * 180));
   // Rotate if needed
-  if (angle == 0.0 || obj.valueAs<PiiMatrix<T> >().isEmpty())
-    emitObject(obj);
-  else
-    emitObject(PiiImage::rotate(obj.valueAs<PiiMatrix<T> >(),
-                                angle,
-                                d->transformedSize,
-                                Background<T>::get(d->backgroundColor)));
+  const PiiMatrix<T> matImage(obj.valueAs<PiiMatrix<T> >());
+  if (angle == 0.0 || matImage.isEmpty())
+    {
+      emitObject(obj);
+      return;
+    }
+
+  // Multiples of 90 degrees are just pixel shuffling. PiiRemap
+  // cannot address very large images.
+  const double dQuarters = angle / M_PI_2;
+  if (Pii::almostEqualRel(dQuarters, Pii::round(dQuarters)) ||
+      !PiiRemap::supportsSourceSize(matImage.rows(), matImage.columns()))
+    {
+      emitObject(PiiImage::rotate(matImage,
+                                  angle,
+                                  d->transformedSize,
+                                  Background<T>::get(d->backgroundColor)));
+      return;
+    }
+
+  updateRemap(angle, matImage.rows(), matImage.columns());
+  emitObject(d->remap.apply(matImage, Background<T>::get(d->backgroundColor), d->iTileThreads));
+}
+
+void PiiImageRotationOperation::updateRemap(double angle, int rows, int columns)
+{
+  PII_D;
+  if (angle == d->dRemapAngle &&
+      d->transformedSize == d->remapSize &&
+      rows == d->remap.sourceRows() &&
+      columns == d->remap.sourceColumns())
+    return;
+
+  d->remap = PiiRemap::transform(PiiImage::createRotationTransform(float(angle), columns/2.0, rows/2.0),
+                                 rows, columns,
+                                 d->transformedSize);
+  d->dRemapAngle = angle;
+  d->remapSize = d->transformedSize;
 }
 
 void PiiImageRotationOperation::setAngle(double angle) { _d()->dAngle = angle; }
@@ -109,3 +143,5 @@ void PiiImageRotationOperation::setTransformedSize(PiiImage::TransformedSize tra
 PiiImage::TransformedSize PiiImageRotationOperation::transformedSize() const { return _d()->transformedSize; }
 void PiiImageRotationOperation::setBackgroundColor(const QColor& backgroundColor) { _d()->backgroundColor = backgroundColor; }
 QColor PiiImageRotationOperation::backgroundColor() const { return _d()->backgroundColor; }
+void PiiImageRotationOperation::setTileThreads(int tileThreads) { _d()->iTileThreads = tileThreads; }
+int PiiImageRotationOperation::tileThreads() const { return _d()->iTileThreads; }
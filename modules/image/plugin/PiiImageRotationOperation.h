@@ -19,6 +19,7 @@
 #include <PiiDefaultOperation.h>
 #include <PiiMath.h>
 #include "PiiImageGlobal.h"
+#include "PiiRemap.h"
 
 /**
  * Rotate images to arbitrary angles in two dimension.
@@ -66,6 +67,14 @@ class PiiImageRotationOperation : public PiiDefaultOperation
    */
   Q_PROPERTY(QColor backgroundColor READ backgroundColor WRITE setBackgroundColor);
 
+  /**
+   * The number of threads used for rotating a single image. The rows
+   * of the output image are divided into bands that are processed in
+   * parallel. 0 means one thread per processor core. The default
+   * value is 1.
+   */
+  Q_PROPERTY(int tileThreads READ tileThreads WRITE setTileThreads);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   PiiImageRotationOperation();
@@ -78,6 +87,8 @@ public:
   PiiImage::TransformedSize transformedSize() const;
   void setBackgroundColor(const QColor& backgroundColor);
   QColor backgroundColor() const;
+  void setTileThreads(int tileThreads);
+  int tileThreads() const;
 
 protected:
   void process();
@@ -91,10 +102,16 @@ private:
     double dAngle;
     PiiImage::TransformedSize transformedSize;
     QColor backgroundColor;
+    int iTileThreads;
+    // The compiled rotation and the angle it was compiled for.
+    PiiRemap remap;
+    double dRemapAngle;
+    PiiImage::TransformedSize remapSize;
   };
   PII_D_FUNC;
 
   template <class T> void rotate(const PiiVariant& obj);
+  void updateRemap(double angle, int rows, int columns);
   template <class T> struct Background;
 };
 
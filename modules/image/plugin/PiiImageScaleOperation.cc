@@ -97,7 +97,12 @@ template <class T> void PiiImageScaleOperation::scaleImage(const PiiVariant& obj
   // Do we actually need to scale the image?
   if ((rows != image.rows() || cols != image.columns()) &&
       rows > 0 && cols > 0)
-    emitObject(PiiImage::scale(image, rows, cols, (Pii::Interpolation)d->interpolation));
+    {
+      if (d->interpolation <= LinearInterpolation)
+        emitObject(PiiImage::scale(image, rows, cols, (Pii::Interpolation)d->interpolation));
+      else
+        emitObject(d->resampler.resample(image, rows, cols));
+    }
   else // Pass the image without modification
     emitObject(obj);
 }
@@ -114,4 +119,15 @@ void PiiImageScaleOperation::setScaledSize(QSize scaledSize)
   _d()->scaledSize = scaledSize;
 }
 PiiImageScaleOperation::Interpolation PiiImageScaleOperation::interpolation() const { return _d()->interpolation; }
-void PiiImageScaleOperation::setInterpolation(Interpolation interpolation) { _d()->interpolation = interpolation; }
+void PiiImageScaleOperation::setInterpolation(Interpolation interpolation)
+{
+  PII_D;
+  d->interpolation = interpolation;
+  switch (interpolation)
+    {
+    case AreaInterpolation: d->resampler.setKernel(PiiResampler::AreaKernel); break;
+    case CubicInterpolation: d->resampler.setKernel(PiiResampler::CubicKernel); break;
+    case LanczosInterpolation: d->resampler.setKernel(PiiResampler::LanczosKernel); break;
+    default: d->resampler.setKernel(PiiResampler::AutomaticKernel); break;
+    }
+}
@@ -17,10 +17,12 @@
 #define _PIIIMAGESCALEOPERATION_H
 
 #include <PiiDefaultOperation.h>
+#include "PiiResampler.h"
 
 /**
- * Scale images to arbitrary sizes. The operation supports linear and
- * nearest neighbor interpolation.
+ * Scale images to arbitrary sizes. The operation supports nearest
+ * neighbor, linear, area-averaging, bicubic and Lanczos
+ * interpolation.
  *
  * Inputs
  * ------
@@ -58,6 +60,13 @@ class PiiImageScaleOperation : public PiiDefaultOperation
   /**
    * Interpolation mode. The default is `LinearInterpolation`.
    * `NearestNeighborInterpolation` is faster, but less accurate.
+   * `AreaInterpolation`, `CubicInterpolation`,
+   * `LanczosInterpolation` and `AutomaticInterpolation` use
+   * PiiResampler, which reuses its filter coefficients as long as the
+   * input and output sizes stay the same, and does not alias when
+   * shrinking. `AutomaticInterpolation` averages pixels when
+   * shrinking and uses bicubic interpolation when enlarging, which
+   * gives the best quality in both directions.
    */
   Q_PROPERTY(Interpolation interpolation READ interpolation WRITE setInterpolation);
   Q_ENUMS(Interpolation);
@@ -65,9 +74,19 @@ class PiiImageScaleOperation : public PiiDefaultOperation
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   /**
-   * A copy of Pii::Interpolation. (Stupid moc.)
+   * Interpolation modes. The first two are copies of
+   * Pii::Interpolation (stupid moc), and the rest correspond to the
+   * kernels in PiiResampler::Kernel.
    */
-  enum Interpolation { NearestNeighborInterpolation, LinearInterpolation };
+  enum Interpolation
+    {
+      NearestNeighborInterpolation,
+      LinearInterpolation,
+      AreaInterpolation,
+      CubicInterpolation,
+      LanczosInterpolation,
+      AutomaticInterpolation
+    };
 
   /**
    * Scaling modes:
@@ -148,6 +167,7 @@ private:
     double dScaleRatio;
     QSize scaledSize;
     Interpolation interpolation;
+    PiiResampler resampler;
   };
   PII_D_FUNC;
 };
@@ -24,12 +24,35 @@ PiiImageUnwarpOperation::Data::Data() :
   dRadius(0),
   dMaxSectorAngle(0),
   dCenter(NAN),
+  iTileThreads(1),
+  dStartAngle(0),
   bRadiusConnected(false),
   bDistanceConnected(false),
   bCenterConnected(false)
 {
 }
 
+PiiImageUnwarpOperation::Geometry::Geometry() :
+  iRows(-1), iColumns(-1),
+  dCenter(NAN), dCameraDistance(0), dRadius(0), dSectorAngle(0)
+{
+}
+
+static inline bool equalOrNan(double a, double b)
+{
+  return a == b || (Pii::isNan(a) && Pii::isNan(b));
+}
+
+bool PiiImageUnwarpOperation::Geometry::operator== (const Geometry& other) const
+{
+  return iRows == other.iRows &&
+    iColumns == other.iColumns &&
+    equalOrNan(dCenter, other.dCenter) &&
+    dCameraDistance == other.dCameraDistance &&
+    dRadius == other.dRadius &&
+    dSectorAngle == other.dSectorAngle;
+}
+
 PiiImageUnwarpOperation::PiiImageUnwarpOperation() :
   PiiDefaultOperation(new Data)
 {
@@ -92,13 +115,31 @@ template <class T> void PiiImageUnwarpOperation::unwarp(const PiiVariant& obj)
   if (d->bDistanceConnected)
     dDistance = PiiYdin::primitiveAs<double>(d->pDistanceInput);
 
-  PiiMatrix<T> matResult(PiiImage::unwarpCylinder(image,
-                                                  d->dFocalLength,
-                                                  dCenter,
-                                                  &dDistance,
-                                                  &dRadius,
-                                                  &dSector,
-                                                  &dStartAngle));
+  Geometry geometry;
+  geometry.iRows = image.rows();
+  geometry.iColumns = image.columns();
+  geometry.dCenter = dCenter;
+  geometry.dCameraDistance = dDistance;
+  geometry.dRadius = dRadius;
+  geometry.dSectorAngle = dSector;
+  updateRemap(geometry);
+
+  // The map is empty if the visible sector is too narrow. Then the
+  // geometry was not solved, and the parameters are passed as such.
+  PiiMatrix<T> matResult;
+  if (d->remap.isEmpty() && d->matMap.isEmpty())
+    matResult = PiiMatrix<T>(image.rows(), 1);
+  else
+    {
+      if (d->remap.isEmpty())
+        matResult = PiiImage::remap(image, d->matMap);
+      else
+        matResult = d->remap.apply(image, T(0), d->iTileThreads);
+      dDistance = d->solvedGeometry.dCameraDistance;
+      dRadius = d->solvedGeometry.dRadius;
+      dSector = d->solvedGeometry.dSectorAngle;
+      dStartAngle = d->dStartAngle;
+    }
   d->pImageOutput->emitObject(matResult);
 
   d->pScaleOutput->emitObject(PiiMatrix<double>(1,2,
@@ -110,7 +151,48 @@ template <class T> void PiiImageUnwarpOperation::unwarp(const PiiVariant& obj)
   d->pSectorOutput->emitObject(dSector);
 }
 
-void PiiImageUnwarpOperation::setFocalLength(double focalLength) { _d()->dFocalLength = focalLength; }
+void PiiImageUnwarpOperation::updateRemap(const Geometry& geometry)
+{
+  PII_D;
+  if (geometry == d->remapGeometry)
+    return;
+
+  d->remapGeometry = d->solvedGeometry = geometry;
+  d->dStartAngle = 0;
+  PiiMatrix<double> matX(PiiImage::unwarpCylinderMap(geometry.iColumns,
+                                                     d->dFocalLength,
+                                                     geometry.dCenter,
+                                                     &d->solvedGeometry.dCameraDistance,
+                                                     &d->solvedGeometry.dRadius,
+                                                     &d->solvedGeometry.dSectorAngle,
+                                                     &d->dStartAngle));
+  d->remap = PiiRemap();
+  d->matMap.resize(0,0);
+  if (matX.isEmpty())
+    return;
+
+  // Each row of the straightened image samples the same columns of
+  // the corresponding row in the warped image.
+  const int iColumns = matX.columns();
+  PiiMatrix<PiiPoint<double> > matMap(PiiMatrix<PiiPoint<double> >::uninitialized(geometry.iRows, iColumns));
+  for (int r=0; r<geometry.iRows; ++r)
+    {
+      PiiPoint<double>* pMap = matMap[r];
+      for (int c=0; c<iColumns; ++c)
+        pMap[c] = PiiPoint<double>(matX(0,c), r);
+    }
+  if (PiiRemap::supportsSourceSize(geometry.iRows, geometry.iColumns))
+    d->remap = PiiRemap(matMap, geometry.iRows, geometry.iColumns);
+  else
+    d->matMap = matMap;
+}
+
+void PiiImageUnwarpOperation::setFocalLength(double focalLength)
+{
+  PII_D;
+  d->dFocalLength = focalLength;
+  d->remapGeometry = Geometry();
+}
 double PiiImageUnwarpOperation::focalLength() const { return _d()->dFocalLength; }
 void PiiImageUnwarpOperation::setCameraDistance(double cameraDistance) { _d()->dCameraDistance = cameraDistance; }
 double PiiImageUnwarpOperation::cameraDistance() const { return _d()->dCameraDistance; }
@@ -120,3 +202,5 @@ void PiiImageUnwarpOperation::setMaxSectorAngle(double maxSectorAngle) { _d()->d
 double PiiImageUnwarpOperation::maxSectorAngle() const { return _d()->dMaxSectorAngle; }
 void PiiImageUnwarpOperation::setCenter(double center) { _d()->dCenter = center; }
 double PiiImageUnwarpOperation::center() const { return _d()->dCenter; }
+void PiiImageUnwarpOperation::setTileThreads(int tileThreads) { _d()->iTileThreads = tileThreads; }
+int PiiImageUnwarpOperation::tileThreads() const { return _d()->iTileThreads; }
@@ -17,6 +17,7 @@
 #define _PIIIMAGEUNWARPOPERATION_H
 
 #include <PiiDefaultOperation.h>
+#include "PiiRemap.h"
 
 /**
  * An operation that straightens cylindrically warped images. See
@@ -98,6 +99,12 @@ class PiiImageUnwarpOperation : public PiiDefaultOperation
    */
   Q_PROPERTY(double maxSectorAngle READ maxSectorAngle WRITE setMaxSectorAngle);
 
+  /**
+   * The number of threads used for unwarping a single image. 0 means
+   * one thread per processor core. The default value is 1.
+   */
+  Q_PROPERTY(int tileThreads READ tileThreads WRITE setTileThreads);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   PiiImageUnwarpOperation();
@@ -112,6 +119,8 @@ public:
   double maxSectorAngle() const;
   void setCenter(double center);
   double center() const;
+  void setTileThreads(int tileThreads);
+  int tileThreads() const;
 
   void check(bool reset);
 
@@ -121,6 +130,16 @@ protected:
 private:
   template <class T> void unwarp(const PiiVariant& obj);
 
+  /// @internal
+  struct Geometry
+  {
+    Geometry();
+    bool operator== (const Geometry& other) const;
+    int iRows, iColumns;
+    double dCenter, dCameraDistance, dRadius, dSectorAngle;
+  };
+  void updateRemap(const Geometry& geometry);
+
   /// @internal
   class Data : public PiiDefaultOperation::Data
   {
@@ -131,6 +150,15 @@ private:
     double dRadius;
     double dMaxSectorAngle;
     double dCenter;
+    int iTileThreads;
+
+    // The geometry the map was compiled for and the parameters
+    // unwarpCylinderMap() solved for it.
+    Geometry remapGeometry, solvedGeometry;
+    double dStartAngle;
+    PiiRemap remap;
+    // The uncompiled map for images PiiRemap cannot handle.
+    PiiImage::DoubleCoordinateMap matMap;
 
     PiiInputSocket *pImageInput, *pDistanceInput, *pRadiusInput, *pCenterInput, *pSkewInput;
     bool bRadiusConnected, bDistanceConnected, bCenterConnected, bSkewConnected;
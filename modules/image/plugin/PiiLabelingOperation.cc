@@ -16,6 +16,7 @@
 #include "PiiLabelingOperation.h"
 #include <PiiMatrix.h>
 #include "PiiLabeling.h"
+#include "PiiImage.h"
 #include "PiiImageTraits.h"
 #include <PiiYdinTypes.h>
 
@@ -23,7 +24,8 @@ PiiLabelingOperation::Data::Data() :
   connectivity(PiiImage::Connect4),
   dThreshold(0),
   dHysteresis(0),
-  bInverse(false)
+  bInverse(false),
+  iTileThreads(1)
 {
 }
 
@@ -35,10 +37,18 @@ PiiLabelingOperation::PiiLabelingOperation() :
   d->pBinaryImageInput = new PiiInputSocket("image");
   d->pLabeledImageOutput = new PiiOutputSocket("image");
   d->pLabelsOutput = new PiiOutputSocket("labels");
+  d->pAreasOutput = new PiiOutputSocket("areas");
+  d->pCentroidsOutput = new PiiOutputSocket("centroids");
+  d->pBoundingBoxOutput = new PiiOutputSocket("boundingboxes");
+  d->pMomentsOutput = new PiiOutputSocket("moments");
 
   addSocket(d->pBinaryImageInput);
   addSocket(d->pLabeledImageOutput);
   addSocket(d->pLabelsOutput);
+  addSocket(d->pAreasOutput);
+  addSocket(d->pCentroidsOutput);
+  addSocket(d->pBoundingBoxOutput);
+  addSocket(d->pMomentsOutput);
 }
 
 
@@ -61,47 +71,57 @@ template <class T> void PiiLabelingOperation::operate(const PiiVariant& obj)
 {
   PII_D;
   const PiiMatrix<T> image = obj.valueAs<PiiMatrix<T> >();
-  int iLabels = 0;
-  if (d->connectivity == PiiImage::Connect4 && d->dHysteresis == 0)
+  if (d->dHysteresis == 0)
     {
       if (!d->bInverse)
-        d->pLabeledImageOutput->emitObject(PiiImage::labelImage(image,
-                                                                std::bind2nd(std::greater<T>(),
-                                                                             T(d->dThreshold)),
-                                                                PiiImage::DefaultLabelingLimiter(),
-                                                                &iLabels));
+        {
+          std::binder2nd<std::greater<T> > rule(std::greater<T>(), T(d->dThreshold));
+          label(image, rule, rule);
+        }
       else
-        d->pLabeledImageOutput->emitObject(PiiImage::labelImage(image,
-                                                                std::bind2nd(std::less_equal<T>(),
-                                                                             T(d->dThreshold)),
-                                                                PiiImage::DefaultLabelingLimiter(),
-                                                                &iLabels));
+        {
+          std::binder2nd<std::less_equal<T> > rule(std::less_equal<T>(), T(d->dThreshold));
+          label(image, rule, rule);
+        }
     }
   else if (!d->bInverse)
-    d->pLabeledImageOutput->emitObject(PiiImage::labelImage(image,
-                                                            std::bind2nd(std::greater<T>(),
-                                                                         T(qMax(0.0,
-                                                                                d->dThreshold - d->dHysteresis))),
-                                                            std::bind2nd(std::greater<T>(),
-                                                                         T(d->dThreshold)),
-                                                            d->connectivity,
-                                                            false,
-                                                            0,
-                                                            INT_MAX,
-                                                            &iLabels));
+    label(image,
+          std::bind2nd(std::greater<T>(), T(qMax(0.0, d->dThreshold - d->dHysteresis))),
+          std::bind2nd(std::greater<T>(), T(d->dThreshold)));
   else
-    d->pLabeledImageOutput->emitObject(PiiImage::labelImage(image,
-                                                            std::bind2nd(std::less_equal<T>(),
-                                                                         T(qMin(double(PiiImage::Traits<T>::max()),
-                                                                                d->dThreshold + d->dHysteresis))),
-                                                            std::bind2nd(std::less_equal<T>(),
-                                                                         T(d->dThreshold)),
+    label(image,
+          std::bind2nd(std::less_equal<T>(),
+                       T(qMin(double(PiiImage::Traits<T>::max()), d->dThreshold + d->dHysteresis))),
+          std::bind2nd(std::less_equal<T>(), T(d->dThreshold)));
+}
+
+template <class T, class UnaryOp1, class UnaryOp2>
+void PiiLabelingOperation::label(const PiiMatrix<T>& image, UnaryOp1 rule1, UnaryOp2 rule2)
+{
+  PII_D;
+  int iLabels = 0;
+  PiiImage::ObjectProperties properties;
+  const bool bPropertiesConnected = d->pAreasOutput->isConnected() ||
+    d->pCentroidsOutput->isConnected() ||
+    d->pBoundingBoxOutput->isConnected() ||
+    d->pMomentsOutput->isConnected();
+
+  d->pLabeledImageOutput->emitObject(PiiImage::labelObjects(image, rule1, rule2,
                                                             d->connectivity,
-                                                            false,
-                                                            0,
-                                                            INT_MAX,
+                                                            PiiImage::bandCount(image.rows(), image.columns(),
+                                                                                1, d->iTileThreads),
+                                                            bPropertiesConnected ? &properties : 0,
                                                             &iLabels));
   d->pLabelsOutput->emitObject(iLabels);
+
+  if (d->pAreasOutput->isConnected())
+    d->pAreasOutput->emitObject(properties.areas);
+  if (d->pCentroidsOutput->isConnected())
+    d->pCentroidsOutput->emitObject(properties.centroids);
+  if (d->pBoundingBoxOutput->isConnected())
+    d->pBoundingBoxOutput->emitObject(properties.boundingBoxes);
+  if (d->pMomentsOutput->isConnected())
+    d->pMomentsOutput->emitObject(properties.moments);
 }
 
 void PiiLabelingOperation::setConnectivity(PiiImage::Connectivity connectivity) { _d()->connectivity = connectivity; }
@@ -113,3 +133,5 @@ void PiiLabelingOperation::setHysteresis(double hysteresis) { _d()->dHysteresis
 double PiiLabelingOperation::hysteresis() const { return _d()->dHysteresis; }
 void PiiLabelingOperation::setInverse(bool inverse) { _d()->bInverse = inverse; }
 bool PiiLabelingOperation::inverse() const { return _d()->bInverse; }
+void PiiLabelingOperation::setTileThreads(int tileThreads) { _d()->iTileThreads = tileThreads; }
+int PiiLabelingOperation::tileThreads() const { return _d()->iTileThreads; }
@@ -40,6 +40,21 @@
  * @out labels - the number of distinct objects in the input image.
  * (int)
  *
+ * @out areas - the number of pixels on each object.
+ * PiiMatrix<int>(N,1).
+ *
+ * @out centroids - the center-of-mass point (x,y) for each object.
+ * PiiMatrix<int>(N,2).
+ *
+ * @out boundingboxes - the bounding boxes of each object
+ * (x,y,width,height). PiiMatrix<int>(N,4).
+ *
+ * @out moments - the second central moments of each object divided
+ * by its area (xx,yy,xy). PiiMatrix<double>(N,3).
+ *
+ * The object properties are calculated while labeling. Connecting
+ * the property outputs is therefore cheaper than sending the labeled
+ * image to a [PiiObjectPropertyExtractor].
  */
 class PiiLabelingOperation : public PiiDefaultOperation
 {
@@ -73,6 +88,16 @@ class PiiLabelingOperation : public PiiDefaultOperation
    */
   Q_PROPERTY(bool inverse READ inverse WRITE setInverse);
 
+  /**
+   * The number of threads used for labeling a single image. If this
+   * value is greater than one, large images are labeled in horizontal
+   * strips in parallel, and the objects are joined over strip
+   * boundaries afterwards. The result is the same as with a single
+   * thread. 0 means one thread per processor core. The default value
+   * is 1.
+   */
+  Q_PROPERTY(int tileThreads READ tileThreads WRITE setTileThreads);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   PiiLabelingOperation();
@@ -85,12 +110,16 @@ public:
   double hysteresis() const;
   void setInverse(bool inverse);
   bool inverse() const;
+  void setTileThreads(int tileThreads);
+  int tileThreads() const;
 
 protected:
   void process();
 
 private:
   template <class T> void operate(const PiiVariant& obj);
+  template <class T, class UnaryOp1, class UnaryOp2>
+  void label(const PiiMatrix<T>& image, UnaryOp1 rule1, UnaryOp2 rule2);
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -102,9 +131,14 @@ private:
     PiiInputSocket* pBinaryImageInput;
     PiiOutputSocket* pLabeledImageOutput;
     PiiOutputSocket* pLabelsOutput;
+    PiiOutputSocket* pAreasOutput;
+    PiiOutputSocket* pCentroidsOutput;
+    PiiOutputSocket* pBoundingBoxOutput;
+    PiiOutputSocket* pMomentsOutput;
     double dThreshold;
     double dHysteresis;
     bool bInverse;
+    int iTileThreads;
   };
   PII_D_FUNC;
 };
@@ -15,6 +15,7 @@
 
 #include "PiiMorphologyOperation.h"
 #include "PiiMorphology.h"
+#include "PiiImage.h"
 #include <PiiYdinTypes.h>
 #include <cmath>
 
@@ -22,7 +23,8 @@ PiiMorphologyOperation::Data::Data() :
   operation(PiiImage::Erode),
   maskType(PiiImage::RectangularMask),
   bHandleBorders(false),
-  maskSize(QSize(3,3))
+  maskSize(QSize(3,3)),
+  iTileThreads(1)
 {
 }
 
@@ -70,10 +72,16 @@ template <class T> void PiiMorphologyOperation::morphologyOperation(const PiiVar
       return;
     }
 
-  d->pBinaryImageOutput->emitObject(PiiImage::morphology(image,
-                                                         d->matMask,
-                                                         d->operation,
-                                                         d->bHandleBorders));
+  // Opening and closing apply the mask twice. A halo as high as the
+  // mask covers both passes.
+  d->pBinaryImageOutput->emitObject(PiiImage::processInBands(image, d->matMask.rows(), d->iTileThreads,
+                                                             this, &PiiMorphologyOperation::morphologyBand<T>));
+}
+
+template <class T> PiiMatrix<T> PiiMorphologyOperation::morphologyBand(const PiiMatrix<T>& image) const
+{
+  const PII_D;
+  return PiiImage::morphology(image, d->matMask, d->operation, d->bHandleBorders);
 }
 
 void PiiMorphologyOperation::prepareMask()
@@ -92,3 +100,5 @@ QSize PiiMorphologyOperation::maskSize() const { return _d()->maskSize; }
 void PiiMorphologyOperation::setMaskSize(QSize maskSize) { _d()->maskSize = maskSize; prepareMask(); }
 PiiMatrix<int> PiiMorphologyOperation::mask() const { return _d()->matMask; }
 template <class T> void PiiMorphologyOperation::setMask(PiiMatrix<T> mask) { _d()->matMask = mask != 0; }
+void PiiMorphologyOperation::setTileThreads(int tileThreads) { _d()->iTileThreads = tileThreads; }
+int PiiMorphologyOperation::tileThreads() const { return _d()->iTileThreads; }
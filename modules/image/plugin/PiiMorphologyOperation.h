@@ -24,6 +24,11 @@
 /**
  * Basic binary morphology operations.
  *
+ * The structuring element always consists of zeros and ones, and the
+ * operations use the bit-packed implementation described in
+ * PiiImage::erode(). The processing time of rectangular masks does
+ * not depend on mask size.
+ *
  * Inputs
  * ------
  *
@@ -65,6 +70,15 @@ class PiiMorphologyOperation : public PiiDefaultOperation
    */
   Q_PROPERTY(QSize maskSize READ maskSize WRITE setMaskSize);
 
+  /**
+   * The number of threads used for processing a single image. If this
+   * value is greater than one, large images are processed in
+   * overlapping horizontal bands in parallel. The result is the same
+   * as with a single thread. 0 means one thread per processor core.
+   * The default value is 1.
+   */
+  Q_PROPERTY(int tileThreads READ tileThreads WRITE setTileThreads);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
   PiiMorphologyOperation();
@@ -84,11 +98,15 @@ public:
   PiiMatrix<int> mask() const;
   template <class T> void setMask(PiiMatrix<T> mask);
 
+  void setTileThreads(int tileThreads);
+  int tileThreads() const;
+
 protected:
   void process();
 
 private:
   template <class T> void morphologyOperation(const PiiVariant& obj);
+  template <class T> PiiMatrix<T> morphologyBand(const PiiMatrix<T>& image) const;
 
   void prepareMask();
 
@@ -103,6 +121,7 @@ private:
     QSize maskSize;
 
     PiiMatrix<int> matMask;
+    int iTileThreads;
 
     PiiInputSocket* pImageInput;
     PiiOutputSocket* pBinaryImageOutput;
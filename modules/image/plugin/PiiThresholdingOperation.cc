@@ -18,6 +18,67 @@
 #include <PiiMatrix.h>
 #include <PiiHistogram.h>
 #include <PiiYdinTypes.h>
+#include <PiiImage.h>
+
+namespace
+{
+  // Wrappers that let PiiImage::processInBands() apply the
+  // thresholding functions to one band of an image at a time.
+  template <class Function> struct MapBand
+  {
+    typedef typename Function::result_type result_type;
+    MapBand(Function f) : function(f) {}
+    template <class T> PiiMatrix<result_type> operator() (const PiiMatrix<T>& band) const
+    {
+      return Pii::matrix(band.mapped(function));
+    }
+    Function function;
+  };
+
+  template <class Function> struct AdaptiveBand
+  {
+    typedef typename Function::result_type result_type;
+    AdaptiveBand(Function f, float relative, float absolute, const QSize& window) :
+      function(f), fRelative(relative), fAbsolute(absolute), windowSize(window)
+    {}
+    template <class T> PiiMatrix<result_type> operator() (const PiiMatrix<T>& band) const
+    {
+      return PiiImage::adaptiveThreshold(band, function, fRelative, fAbsolute,
+                                         windowSize.height(), windowSize.width());
+    }
+    Function function;
+    float fRelative, fAbsolute;
+    QSize windowSize;
+  };
+
+  template <class Function> struct AdaptiveVarBand
+  {
+    typedef typename Function::result_type result_type;
+    AdaptiveVarBand(Function f, const QSize& window) : function(f), windowSize(window) {}
+    template <class T> PiiMatrix<result_type> operator() (const PiiMatrix<T>& band) const
+    {
+      return PiiImage::adaptiveThresholdVar(band, function, windowSize.height(), windowSize.width());
+    }
+    Function function;
+    QSize windowSize;
+  };
+
+  template <class Function> inline MapBand<Function> mapBand(Function f)
+  {
+    return MapBand<Function>(f);
+  }
+
+  template <class Function> inline AdaptiveBand<Function> adaptiveBand(Function f, double relative,
+                                                                       double absolute, const QSize& window)
+  {
+    return AdaptiveBand<Function>(f, float(relative), float(absolute), window);
+  }
+
+  template <class Function> inline AdaptiveVarBand<Function> adaptiveVarBand(Function f, const QSize& window)
+  {
+    return AdaptiveVarBand<Function>(f, window);
+  }
+}
 
 
 PiiThresholdingOperation::Data::Data() :
@@ -26,7 +87,8 @@ PiiThresholdingOperation::Data::Data() :
   thresholdType(StaticThreshold),
   bThresholdConnected(false),
   bInverse(false),
-  windowSize(15,15)
+  windowSize(15,15),
+  iTileThreads(1)
 {
 }
 
@@ -87,6 +149,15 @@ template <class T> void PiiThresholdingOperation::thresholdGray(const PiiVariant
 
 
 
+template <class T, class Function>
+void PiiThresholdingOperation::emitInBands(const PiiMatrix<T>& image, int halo, Function function)
+{
+  PII_D;
+  d->pBinaryImageOutput->emitObject(PiiImage::processInBands<typename Function::result_type>(image, halo,
+                                                                                             d->iTileThreads,
+                                                                                             function));
+}
+
 template <class T> void PiiThresholdingOperation::threshold(const PiiMatrix<T>& image)
 {
   PII_D;
@@ -152,18 +223,18 @@ template <class T> void PiiThresholdingOperation::threshold(const PiiMatrix<T>&
         case TwoLevelThreshold:
           {
             double otherThreshold = d->dAbsoluteThreshold + d->dRelativeThreshold;
+            T lowThreshold = T(qMin(d->dAbsoluteThreshold, otherThreshold)),
+              highThreshold = T(qMax(d->dAbsoluteThreshold, otherThreshold));
             if (!d->bInverse)
-              d->pBinaryImageOutput->emitObject(Pii::matrix(image.mapped(
-                PiiImage::TwoLevelThresholdFunction<T>(T(qMin(d->dAbsoluteThreshold, otherThreshold)),
-                                                       T(qMax(d->dAbsoluteThreshold, otherThreshold))))));
+              emitInBands(image, 0, mapBand(PiiImage::TwoLevelThresholdFunction<T>(lowThreshold, highThreshold)));
             else
-              d->pBinaryImageOutput->emitObject(Pii::matrix(image.mapped(
-                PiiImage::InverseTwoLevelThresholdFunction<T>(T(qMin(d->dAbsoluteThreshold, otherThreshold)),
-                                                              T(qMax(d->dAbsoluteThreshold, otherThreshold))))));
+              emitInBands(image, 0, mapBand(PiiImage::InverseTwoLevelThresholdFunction<T>(lowThreshold, highThreshold)));
           }
           d->pThresholdOutput->emitObject(d->dAbsoluteThreshold);
           return;
         case HysteresisThreshold:
+          // Connected components may span the whole image. This
+          // one cannot be split into bands.
           if (!d->bInverse)
             d->pBinaryImageOutput->emitObject(PiiImage::hysteresisThreshold(image,
                                                                             T(d->dAbsoluteThreshold - d->dRelativeThreshold),
@@ -176,51 +247,47 @@ template <class T> void PiiThresholdingOperation::threshold(const PiiMatrix<T>&
           return;
         case RelativeToMeanAdaptiveThreshold:
           if (!d->bInverse)
-            d->pBinaryImageOutput->emitObject(PiiImage::adaptiveThreshold(image,
-                                                                          PiiImage::ThresholdFunction<T>(),
-                                                                          float(d->dRelativeThreshold),
-                                                                          float(d->dAbsoluteThreshold),
-                                                                          d->windowSize.height(), d->windowSize.width()));
+            emitInBands(image, d->windowSize.height()/2,
+                        adaptiveBand(PiiImage::ThresholdFunction<T>(),
+                                     d->dRelativeThreshold, d->dAbsoluteThreshold, d->windowSize));
           else
-            d->pBinaryImageOutput->emitObject(PiiImage::adaptiveThreshold(image,
-                                                                          PiiImage::InverseThresholdFunction<T>(),
-                                                                          float(d->dRelativeThreshold),
-                                                                          float(d->dAbsoluteThreshold),
-                                                                          d->windowSize.height(), d->windowSize.width()));
+            emitInBands(image, d->windowSize.height()/2,
+                        adaptiveBand(PiiImage::InverseThresholdFunction<T>(),
+                                     d->dRelativeThreshold, d->dAbsoluteThreshold, d->windowSize));
           d->pThresholdOutput->emitObject(d->dAbsoluteThreshold);
           return;
         case MeanStdAdaptiveThreshold:
           if (!d->bInverse)
-            d->pBinaryImageOutput->emitObject(PiiImage::adaptiveThresholdVar(image,
-                                                                             PiiImage::meanStdThresholdFunction(PiiImage::ThresholdFunction<double,T>(),
-                                                                                                                std::bind2nd(std::minus<double>(),
-                                                                                                                             d->dAbsoluteThreshold),
-                                                                                                                d->dRelativeThreshold),
-                                                                             d->windowSize.height(), d->windowSize.width()));
+            emitInBands(image, d->windowSize.height()/2,
+                        adaptiveVarBand(PiiImage::meanStdThresholdFunction(PiiImage::ThresholdFunction<double,T>(),
+                                                                           std::bind2nd(std::minus<double>(),
+                                                                                        d->dAbsoluteThreshold),
+                                                                           d->dRelativeThreshold),
+                                        d->windowSize));
           else
-            d->pBinaryImageOutput->emitObject(PiiImage::adaptiveThresholdVar(image,
-                                                                             PiiImage::meanStdThresholdFunction(PiiImage::InverseThresholdFunction<double,T>(),
-                                                                                                                std::bind2nd(std::minus<double>(),
-                                                                                                                             d->dAbsoluteThreshold),
-                                                                                                                d->dRelativeThreshold),
-                                                                             d->windowSize.height(), d->windowSize.width()));
+            emitInBands(image, d->windowSize.height()/2,
+                        adaptiveVarBand(PiiImage::meanStdThresholdFunction(PiiImage::InverseThresholdFunction<double,T>(),
+                                                                           std::bind2nd(std::minus<double>(),
+                                                                                        d->dAbsoluteThreshold),
+                                                                           d->dRelativeThreshold),
+                                        d->windowSize));
           d->pThresholdOutput->emitObject(d->dAbsoluteThreshold);
           return;
         case SauvolaAdaptiveThreshold:
           if (!d->bInverse)
-            d->pBinaryImageOutput->emitObject(PiiImage::adaptiveThresholdVar(image,
-                                                                             PiiImage::sauvolaThresholdFunction(PiiImage::ThresholdFunction<double,T>(),
-                                                                                                                std::bind2nd(std::minus<double>(),
-                                                                                                                             d->dAbsoluteThreshold),
-                                                                                                                d->dRelativeThreshold),
-                                                                             d->windowSize.height(), d->windowSize.width()));
+            emitInBands(image, d->windowSize.height()/2,
+                        adaptiveVarBand(PiiImage::sauvolaThresholdFunction(PiiImage::ThresholdFunction<double,T>(),
+                                                                           std::bind2nd(std::minus<double>(),
+                                                                                        d->dAbsoluteThreshold),
+                                                                           d->dRelativeThreshold),
+                                        d->windowSize));
           else
-            d->pBinaryImageOutput->emitObject(PiiImage::adaptiveThresholdVar(image,
-                                                                             PiiImage::sauvolaThresholdFunction(PiiImage::InverseThresholdFunction<double,T>(),
-                                                                                                                std::bind2nd(std::minus<double>(),
-                                                                                                                             d->dAbsoluteThreshold),
-                                                                                                                d->dRelativeThreshold),
-                                                                             d->windowSize.height(), d->windowSize.width()));
+            emitInBands(image, d->windowSize.height()/2,
+                        adaptiveVarBand(PiiImage::sauvolaThresholdFunction(PiiImage::InverseThresholdFunction<double,T>(),
+                                                                           std::bind2nd(std::minus<double>(),
+                                                                                        d->dAbsoluteThreshold),
+                                                                           d->dRelativeThreshold),
+                                        d->windowSize));
           d->pThresholdOutput->emitObject(d->dAbsoluteThreshold);
           return;
         }
@@ -228,9 +295,9 @@ template <class T> void PiiThresholdingOperation::threshold(const PiiMatrix<T>&
     }
 
   if (!d->bInverse)
-    d->pBinaryImageOutput->emitObject(PiiImage::threshold(image, T(threshold)));
+    emitInBands(image, 0, mapBand(std::bind2nd(PiiImage::ThresholdFunction<T>(), T(threshold))));
   else
-    d->pBinaryImageOutput->emitObject(PiiImage::inverseThreshold(image, T(threshold)));
+    emitInBands(image, 0, mapBand(std::bind2nd(PiiImage::InverseThresholdFunction<T>(), T(threshold))));
 
   d->pThresholdOutput->emitObject(threshold);
 }
@@ -245,3 +312,5 @@ void PiiThresholdingOperation::setInverse(bool inverse) { _d()->bInverse = inver
 bool PiiThresholdingOperation::isInverse() const { return _d()->bInverse; }
 void PiiThresholdingOperation::setWindowSize(const QSize& windowSize) { _d()->windowSize = windowSize; }
 QSize PiiThresholdingOperation::windowSize() const { return _d()->windowSize; }
+void PiiThresholdingOperation::setTileThreads(int tileThreads) { _d()->iTileThreads = tileThreads; }
+int PiiThresholdingOperation::tileThreads() const { return _d()->iTileThreads; }
@@ -89,6 +89,17 @@ class PiiThresholdingOperation : public PiiDefaultOperation
    */
   Q_PROPERTY(QSize windowSize READ windowSize WRITE setWindowSize);
 
+  /**
+   * The number of threads used for thresholding a single image. Large
+   * images are divided into horizontal bands that are thresholded in
+   * parallel. Global statistics such as the Otsu threshold are still
+   * calculated over the whole image, and `HysteresisThreshold` is
+   * always single-threaded because its connected components cannot be
+   * split. 0 means one thread per processor core. The default value
+   * is 1.
+   */
+  Q_PROPERTY(int tileThreads READ tileThreads WRITE setTileThreads);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 
 public:
@@ -203,6 +214,8 @@ public:
   bool isInverse() const;
   void setWindowSize(const QSize& windowSize);
   QSize windowSize() const;
+  void setTileThreads(int tileThreads);
+  int tileThreads() const;
 
 protected:
   void process();
@@ -211,6 +224,7 @@ private:
   template <class T> void thresholdColor(const PiiVariant& obj);
   template <class T> void thresholdGray(const PiiVariant& obj);
   template <class T> void threshold(const PiiMatrix<T>& image);
+  template <class T, class Function> void emitInBands(const PiiMatrix<T>& image, int halo, Function function);
 
   /// @internal
   class Data : public PiiDefaultOperation::Data
@@ -226,6 +240,7 @@ private:
     PiiOutputSocket* pBinaryImageOutput, *pThresholdOutput;
     bool bInverse;
     QSize windowSize;
+    int iTileThreads;
   };
   PII_D_FUNC;
 };
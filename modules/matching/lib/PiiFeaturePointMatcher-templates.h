@@ -61,16 +61,30 @@ void PiiFeaturePointMatcher<T, SampleSet>::buildDatabase(const PiiMatrix<T>& poi
 
   d = d->createCleanCopy();
 
+  PiiMatching::NearestNeighborIndexType indexType = d->indexType;
+  // Indices don't work in non-Euclidean spaces.
+  if (measure != 0)
+    indexType = PiiMatching::ExhaustiveSearch;
   // We are going to use the K-d tree only if the number of points is
   // much larger than the number of features. This limit would be way
   // too low if we performed exact search, but we won't.
-  if (measure == 0 && // K-d tree doesn't work in non-Euclidean spaces.
-      points.rows() > 2 * iFeatures)
+  else if (indexType == PiiMatching::AutomaticIndex)
+    indexType = points.rows() > 2 * iFeatures ? PiiMatching::KdTreeIndex : PiiMatching::ExhaustiveSearch;
+
+  if (indexType == PiiMatching::KdTreeIndex)
     {
       PiiSmartPtr<PiiKdTree<SampleSet> > pKdTree(new PiiKdTree<SampleSet>);
       pKdTree->buildTree(features, controller); // may throw
       d->pKdTree = pKdTree.release();
     }
+  else if (indexType == PiiMatching::HnswIndex)
+    {
+      PiiSmartPtr<PiiHnswIndex<SampleSet> > pHnswIndex(new PiiHnswIndex<SampleSet>);
+      pHnswIndex->setQuantizerSubspaceCount(d->iQuantizerSubspaceCount);
+      pHnswIndex->setSearchWidth(d->iSearchWidth);
+      pHnswIndex->buildIndex(features, controller); // may throw
+      d->pHnswIndex = pHnswIndex.release();
+    }
   else
     {
       d->modelFeatures = features;
@@ -98,30 +112,28 @@ PiiMatching::MatchList PiiFeaturePointMatcher<T,SampleSet>::findMatchingModels(c
   typedef QHash<int, QList<QPair<int,int> > > MatchHash;
   MatchHash hashMatchIndices;
 
-  // Find N closest matches for each point
-  for (int i=0; i<iPoints; ++i)
-    {
-      PiiClassification::MatchList lstMatches;
-      if (d->pKdTree != 0)
-        {
-          if (d->iMaxEvaluations > 0)
-            lstMatches = d->pKdTree->findClosestMatches(sampleAt(features, i),
+  // Find N closest matches for all points at once
+  QList<PiiClassification::MatchList> lstAllMatches;
+  if (d->pKdTree != 0)
+    lstAllMatches = d->pKdTree->findClosestMatchesBatch(features,
                                                         d->iClosestMatchCount,
                                                         d->iMaxEvaluations);
-          else
-            lstMatches = d->pKdTree->findClosestMatches(sampleAt(features, i),
-                                                        d->iClosestMatchCount);
-        }
-      else if (d->pDistanceMeasure != 0)
-        lstMatches = PiiClassification::findClosestMatches(sampleAt(features, i),
-                                                           d->modelFeatures,
-                                                           *d->pDistanceMeasure,
-                                                           d->iClosestMatchCount);
-      else
-        lstMatches = PiiClassification::findClosestMatches(sampleAt(features, i),
-                                                           d->modelFeatures,
-                                                           d->squaredGeometricDistance,
-                                                           d->iClosestMatchCount);
+  else if (d->pHnswIndex != 0)
+    lstAllMatches = d->pHnswIndex->findClosestMatchesBatch(features, d->iClosestMatchCount);
+  else if (d->pDistanceMeasure != 0)
+    lstAllMatches = PiiClassification::findClosestMatchesBatch(features,
+                                                               d->modelFeatures,
+                                                               *d->pDistanceMeasure,
+                                                               d->iClosestMatchCount);
+  else
+    lstAllMatches = PiiClassification::findClosestMatchesBatch(features,
+                                                               d->modelFeatures,
+                                                               d->squaredGeometricDistance,
+                                                               d->iClosestMatchCount);
+
+  for (int i=0; i<iPoints; ++i)
+    {
+      const PiiClassification::MatchList& lstMatches = lstAllMatches[i];
 
       // All matches that are good enough compared to the best one
       // will be accepted as candidates.
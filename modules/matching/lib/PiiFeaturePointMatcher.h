@@ -20,6 +20,7 @@
 #include <PiiMatrix.h>
 #include <PiiDistanceMeasure.h>
 #include <PiiKdTree.h>
+#include <PiiHnswIndex.h>
 #include <PiiClassification.h>
 #include <PiiSharedD.h>
 
@@ -178,10 +179,17 @@ namespace PiiMatching
 template <class T, class SampleSet> class PiiFeaturePointMatcher
 {
   friend struct PiiSerialization::Accessor;
-  template <class Archive> void serialize(Archive& archive, const unsigned int /*version*/)
+  template <class Archive> void serialize(Archive& archive, const unsigned int version)
   {
     archive & PII_NVP("points", d->matModelPoints);
     archive & PII_NVP("kdTree", d->pKdTree);
+    if (version > 0)
+      {
+        archive & PII_NVP("hnswIndex", d->pHnswIndex);
+        archive & PII_NVP("indexType", PII_ENUM(d->indexType));
+        archive & PII_NVP("subspaces", d->iQuantizerSubspaceCount);
+        archive & PII_NVP("searchWidth", d->iSearchWidth);
+      }
     archive & PII_NVP("features", d->modelFeatures);
     archive & PII_NVP("indices", d->vecModelIndices);
     //archive & PII_NVP("distanceMeasure", d->pDistanceMeasure);
@@ -201,10 +209,10 @@ public:
 
   /**
    * Builds the model database. This function either stores the
-   * *features* for linear search or builds a [K-d tree](PiiKdtree),
-   * which will be later used for quick queries. The most suitable
-   * search technique is determined by the number of points and
-   * features.
+   * *features* for linear search or builds an index, which will be
+   * later used for quick queries. The search technique is determined
+   * by [indexType()]. By default, the most suitable one is selected
+   * based on the number of points and features.
    *
    * @param points the locations of feature points with respect to the
    * model the point belongs to.
@@ -224,10 +232,9 @@ public:
    * cancel the process if needed.
    *
    * @param measure an optional distance measure that can be used if
-   * the feature space is non-Euclidean. Note that the K-d tree will
-   * not be used for queries if a custom distance measure is
-   * provided. PiiFeaturePointMatcher takes the ownership of the
-   * measure.
+   * the feature space is non-Euclidean. Note that no index will be
+   * used for queries if a custom distance measure is provided.
+   * PiiFeaturePointMatcher takes the ownership of the measure.
    *
    * @exception PiiClassificationException& if the tree building
    * process was interrupted or if there is a non-equal number of
@@ -337,10 +344,13 @@ public:
 
   /**
    * Sets the maximum number of evaluations when searching a k-d tree.
-   * This makes it possible to return correct matches for the majority
-   * of feature points while making the search much faster. Setting
+   * Each comparison of a query feature to a model feature counts as
+   * one evaluation. See PiiKdTree::findClosestMatches(). This makes
+   * it possible to return correct matches for the majority of feature
+   * points while making the search much faster. Setting
    * *maxEvaluations* value to a non-positive value disables the
-   * approximate nearest neighbor search optimization.
+   * approximate nearest neighbor search optimization. This value is
+   * not used with `HnswIndex`; see [setSearchWidth()].
    */
   void setMaxEvaluations(int maxEvaluations)
   {
@@ -355,6 +365,64 @@ public:
    */
   int maxEvaluations() const { return d->iMaxEvaluations; }
 
+  /**
+   * Sets the number of candidates kept when searching an
+   * `HnswIndex`. See PiiHnswIndex::setSearchWidth(). A non-positive
+   * value uses the default width of the index. The change takes
+   * effect immediately.
+   */
+  void setSearchWidth(int searchWidth)
+  {
+    if (searchWidth != d->iSearchWidth)
+      {
+        detach();
+        d->iSearchWidth = searchWidth;
+        if (d->pHnswIndex != 0)
+          d->pHnswIndex->setSearchWidth(searchWidth);
+      }
+  }
+  /**
+   * Returns the search width. The default is 0.
+   */
+  int searchWidth() const { return d->iSearchWidth; }
+
+  /**
+   * Sets the type of the index used for finding the closest matches
+   * of query points. The change takes effect when the database is
+   * built the next time.
+   */
+  void setIndexType(PiiMatching::NearestNeighborIndexType indexType)
+  {
+    if (indexType != d->indexType)
+      {
+        detach();
+        d->indexType = indexType;
+      }
+  }
+  /**
+   * Returns the index type. The default is `AutomaticIndex`.
+   */
+  PiiMatching::NearestNeighborIndexType indexType() const { return d->indexType; }
+
+  /**
+   * Sets the number of bytes each model feature vector is compressed
+   * to when `HnswIndex` is used. Zero disables compression. See
+   * PiiHnswIndex::setQuantizerSubspaceCount(). The change takes
+   * effect when the database is built the next time.
+   */
+  void setQuantizerSubspaceCount(int quantizerSubspaceCount)
+  {
+    if (quantizerSubspaceCount != d->iQuantizerSubspaceCount)
+      {
+        detach();
+        d->iQuantizerSubspaceCount = qMax(0, quantizerSubspaceCount);
+      }
+  }
+  /**
+   * Returns the number of quantizer subspaces. The default is 0.
+   */
+  int quantizerSubspaceCount() const { return d->iQuantizerSubspaceCount; }
+
   /**
    * Returns the stored model points.
    */
@@ -374,24 +442,33 @@ private:
   public:
     Data() :
       pKdTree(0),
+      pHnswIndex(0),
       pDistanceMeasure(0),
       matchingMode(PiiMatching::MatchAllModels),
+      indexType(PiiMatching::AutomaticIndex),
       iClosestMatchCount(1),
-      iMaxEvaluations(0)
+      iMaxEvaluations(0),
+      iSearchWidth(0),
+      iQuantizerSubspaceCount(0)
     {}
     Data(const Data& other) :
       matModelPoints(other.matModelPoints),
       pKdTree(other.pKdTree ? new PiiKdTree<SampleSet>(*other.pKdTree) : 0),
+      pHnswIndex(other.pHnswIndex ? new PiiHnswIndex<SampleSet>(*other.pHnswIndex) : 0),
       modelFeatures(other.modelFeatures),
       vecModelIndices(other.vecModelIndices),
       pDistanceMeasure(other.pDistanceMeasure ? other.pDistanceMeasure->clone() : 0),
       matchingMode(other.matchingMode),
+      indexType(other.indexType),
       iClosestMatchCount(other.iClosestMatchCount),
-      iMaxEvaluations(other.iMaxEvaluations)
+      iMaxEvaluations(other.iMaxEvaluations),
+      iSearchWidth(other.iSearchWidth),
+      iQuantizerSubspaceCount(other.iQuantizerSubspaceCount)
     {}
     ~Data()
     {
       delete pKdTree;
+      delete pHnswIndex;
       delete pDistanceMeasure;
     }
 
@@ -399,20 +476,27 @@ private:
     {
       Data* d = new Data;
       d->matchingMode = matchingMode;
+      d->indexType = indexType;
       d->iClosestMatchCount = iClosestMatchCount;
       d->iMaxEvaluations = iMaxEvaluations;
+      d->iSearchWidth = iSearchWidth;
+      d->iQuantizerSubspaceCount = iQuantizerSubspaceCount;
       this->release();
       return d;
     }
 
     PiiMatrix<T> matModelPoints;
     PiiKdTree<SampleSet>* pKdTree;
+    PiiHnswIndex<SampleSet>* pHnswIndex;
     SampleSet modelFeatures;
     QVector<int> vecModelIndices;
     PiiDistanceMeasure<ConstFeatureIterator>* pDistanceMeasure;
     PiiMatching::ModelMatchingMode matchingMode;
+    PiiMatching::NearestNeighborIndexType indexType;
     int iClosestMatchCount;
     int iMaxEvaluations;
+    int iSearchWidth;
+    int iQuantizerSubspaceCount;
     PiiSquaredGeometricDistance<ConstFeatureIterator> squaredGeometricDistance;
   } *d;
 
@@ -430,6 +514,14 @@ private:
                                              const QList<QPair<int,int> >& matches);
 };
 
+namespace PiiSerializationTraits
+{
+  template <class T, class SampleSet> struct Version<PiiFeaturePointMatcher<T,SampleSet> >
+  {
+    enum { intValue = 1 };
+  };
+}
+
 #include "PiiFeaturePointMatcher-templates.h"
 
 #endif //_PIIFEATUREPOINTMATCHER_H
@@ -31,7 +31,7 @@ namespace PiiMatching
 #ifdef Q_MOC_RUN
   Q_GADGET
 
-  Q_ENUMS(ModelMatchingMode);
+  Q_ENUMS(ModelMatchingMode NearestNeighborIndexType);
   Q_FLAGS(InvarianceFlag InvarianceFlags);
 public:
 #endif
@@ -56,6 +56,25 @@ public:
    */
   enum ModelMatchingMode { MatchOneModel, MatchAllModels, MatchDifferentModels };
 
+  /**
+   * Ways of finding the closest model points for query points.
+   *
+   * - `AutomaticIndex` - use a k-d tree if the number of model points
+   * is large compared to the number of features, and exhaustive
+   * search otherwise.
+   *
+   * - `ExhaustiveSearch` - compare each query point to all model
+   * points. Always finds the true closest matches.
+   *
+   * - `KdTreeIndex` - use PiiKdTree. Efficient with low-dimensional
+   * features.
+   *
+   * - `HnswIndex` - use PiiHnswIndex. Scales to millions of model
+   * points and high-dimensional descriptors, but the results are
+   * approximate.
+   */
+  enum NearestNeighborIndexType { AutomaticIndex, ExhaustiveSearch, KdTreeIndex, HnswIndex };
+
   /**
    * Invariance levels. Some feature point descriptors and matching
    * algorithms have controllable invariance properties. The values in
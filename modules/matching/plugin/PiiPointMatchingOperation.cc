@@ -32,7 +32,11 @@ PiiPointMatchingOperation::Data::Data(int pointDimensions) :
   iPointDimensions(pointDimensions),
   matchingMode(PiiMatching::MatchAllModels),
   bMustSendPoints(false),
-  iClosestMatchCount(pMatcher->closestMatchCount())
+  iClosestMatchCount(pMatcher->closestMatchCount()),
+  indexType(pMatcher->indexType()),
+  iMaxEvaluations(pMatcher->maxEvaluations()),
+  iSearchWidth(pMatcher->searchWidth()),
+  iQuantizerSubspaceCount(pMatcher->quantizerSubspaceCount())
 {
 }
 
@@ -94,8 +98,13 @@ void PiiPointMatchingOperation::check(bool reset)
 
 PiiPointMatchingOperation::Matcher* PiiPointMatchingOperation::createMatcher()
 {
+  PII_D;
   Matcher* pMatcher = new Matcher;
-  pMatcher->setClosestMatchCount(_d()->iClosestMatchCount);
+  pMatcher->setClosestMatchCount(d->iClosestMatchCount);
+  pMatcher->setIndexType(d->indexType);
+  pMatcher->setMaxEvaluations(d->iMaxEvaluations);
+  pMatcher->setSearchWidth(d->iSearchWidth);
+  pMatcher->setQuantizerSubspaceCount(d->iQuantizerSubspaceCount);
   return pMatcher;
 }
 
@@ -463,6 +472,10 @@ PiiPointMatchingOperation* PiiPointMatchingOperation::clone() const
   pNewData->iModelCount = d->iModelCount;
   pNewData->matchingMode = d->matchingMode;
   pNewData->iClosestMatchCount = d->iClosestMatchCount;
+  pNewData->indexType = d->indexType;
+  pNewData->iMaxEvaluations = d->iMaxEvaluations;
+  pNewData->iSearchWidth = d->iSearchWidth;
+  pNewData->iQuantizerSubspaceCount = d->iQuantizerSubspaceCount;
 
   return pNewOperation;
 }
@@ -480,3 +493,38 @@ int PiiPointMatchingOperation::closestMatchCount() const
 {
   return _d()->iClosestMatchCount;
 }
+
+void PiiPointMatchingOperation::setIndexType(PiiMatching::NearestNeighborIndexType indexType) { _d()->indexType = indexType; }
+PiiMatching::NearestNeighborIndexType PiiPointMatchingOperation::indexType() const { return _d()->indexType; }
+
+void PiiPointMatchingOperation::setMaxEvaluations(int maxEvaluations)
+{
+  PII_D;
+  d->pMatcher->setMaxEvaluations(d->iMaxEvaluations = maxEvaluations);
+}
+
+int PiiPointMatchingOperation::maxEvaluations() const
+{
+  return _d()->iMaxEvaluations;
+}
+
+void PiiPointMatchingOperation::setSearchWidth(int searchWidth)
+{
+  PII_D;
+  d->pMatcher->setSearchWidth(d->iSearchWidth = searchWidth);
+}
+
+int PiiPointMatchingOperation::searchWidth() const
+{
+  return _d()->iSearchWidth;
+}
+
+void PiiPointMatchingOperation::setQuantizerSubspaceCount(int quantizerSubspaceCount)
+{
+  _d()->iQuantizerSubspaceCount = qMax(0, quantizerSubspaceCount);
+}
+
+int PiiPointMatchingOperation::quantizerSubspaceCount() const
+{
+  return _d()->iQuantizerSubspaceCount;
+}
@@ -152,6 +152,40 @@ class PII_MATCHING_EXPORT PiiPointMatchingOperation : public PiiClassifierOperat
    */
   Q_PROPERTY(int closestMatchCount READ closestMatchCount WRITE setClosestMatchCount);
 
+  /**
+   * The way of finding the closest model points for query points.
+   * The default is `AutomaticIndex`, which uses a k-d tree if there
+   * are many more model points than features. With large databases
+   * of high-dimensional descriptors, `HnswIndex` is the fastest
+   * choice. Changes take effect when the model database is rebuilt.
+   */
+  Q_PROPERTY(PiiMatching::NearestNeighborIndexType indexType READ indexType WRITE setIndexType);
+
+  /**
+   * Controls the accuracy of approximate nearest neighbor search with
+   * a k-d tree. This value limits the number of model points compared
+   * to each query point. Zero means exact search, which is the
+   * default.
+   */
+  Q_PROPERTY(int maxEvaluations READ maxEvaluations WRITE setMaxEvaluations);
+
+  /**
+   * The number of candidates kept when searching an `HnswIndex`.
+   * Larger values find the true closest matches more often but make
+   * the search slower. Zero uses the default of the index, which is
+   * also the default of this property.
+   */
+  Q_PROPERTY(int searchWidth READ searchWidth WRITE setSearchWidth);
+
+  /**
+   * The number of bytes each model descriptor is compressed to when
+   * [indexType] is `HnswIndex`. Compression reduces memory usage
+   * but makes the search less accurate. Zero disables compression,
+   * which is the default. Changes take effect when the model database
+   * is rebuilt.
+   */
+  Q_PROPERTY(int quantizerSubspaceCount READ quantizerSubspaceCount WRITE setQuantizerSubspaceCount);
+
   friend struct PiiSerialization::Accessor;
   template <class Archive> void serialize(Archive& archive, const unsigned int)
   {
@@ -226,6 +260,10 @@ protected:
     PiiMatching::ModelMatchingMode matchingMode;
     bool bMustSendPoints;
     int iClosestMatchCount;
+    PiiMatching::NearestNeighborIndexType indexType;
+    int iMaxEvaluations;
+    int iSearchWidth;
+    int iQuantizerSubspaceCount;
   };
   PII_D_FUNC;
 
@@ -244,6 +282,14 @@ protected:
   PiiMatching::ModelMatchingMode matchingMode() const;
   void setClosestMatchCount(int closestMatchCount);
   int closestMatchCount() const;
+  void setIndexType(PiiMatching::NearestNeighborIndexType indexType);
+  PiiMatching::NearestNeighborIndexType indexType() const;
+  void setMaxEvaluations(int maxEvaluations);
+  int maxEvaluations() const;
+  void setSearchWidth(int searchWidth);
+  int searchWidth() const;
+  void setQuantizerSubspaceCount(int quantizerSubspaceCount);
+  int quantizerSubspaceCount() const;
 
   bool learnBatch();
   void replaceClassifier();
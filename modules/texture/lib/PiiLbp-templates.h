@@ -18,7 +18,9 @@
 #endif
 
 #include <PiiBits.h>
+#include <QVarLengthArray>
 #include <climits>
+#include <cstring>
 
 #define INTERPOLATE_NEIGHBOR(neighbor,i) coeffs = d->pPoints[i].coeffs; \
   neighbor = coeffs[0] * (float)*neighborPtr1[i];                       \
@@ -37,11 +39,17 @@ PiiMatrix<int> PiiLbp::genericLbp(const PiiMatrix<T>& image, Roi roi, UnaryFunct
   if (d->mode == Symmetric)
     return genericSymmetricLbp<MatrixClass>(image, roi);
 
-  if (d->mode == Standard &&
-      d->interpolation == Pii::NearestNeighborInterpolation &&
+  if (d->interpolation == Pii::NearestNeighborInterpolation &&
       d->iSamples == 8 &&
       d->dRadius == 1)
-    return basicLbp<MatrixClass>(image, roi, centerFunc);
+    {
+      if (d->mode == Standard)
+        return basicLbp<MatrixClass>(image, roi, centerFunc);
+      PiiMatrix<int> matResult;
+      if (fastBasicLbp(static_cast<MatrixClass*>(0), image, roi, centerFunc,
+                       d->pLookup, featureCount(8, d->mode), matResult))
+        return matResult;
+    }
 
   // This much free space must be ensured on all sides.
   const int iMargin = (int)std::ceil(d->dRadius);
@@ -301,11 +309,83 @@ template <class MatrixClass, class T, class Roi> PiiMatrix<int> PiiLbp::genericS
     }
 }
 
+template <class Roi>
+bool PiiLbp::fastBasicLbp(Histogram*, const PiiMatrix<unsigned char>& image, Roi roi,
+                          Pii::Identity<unsigned char>,
+                          const unsigned short* lookup, int features, PiiMatrix<int>& result)
+{
+  const int iRows = image.rows(), iColumns = image.columns();
+  if (iRows < 3 || iColumns < 3)
+    return false;
+
+  // Successive pixels are counted to different banks. This breaks
+  // the dependency between increments of the same bin, which is
+  // common in textured images.
+  int aBanks[4][256];
+  std::memset(aBanks, 0, sizeof(aBanks));
+  QVarLengthArray<unsigned char,2048> codes(iColumns);
+  unsigned char* pCodes = &codes[0];
+  const int iCodes = iColumns - 2;
+  for (int r=1; r<iRows-1; ++r)
+    {
+      basicLbpRow(image[r-1], image[r], image[r+1], iColumns, pCodes);
+      int i = 0;
+      for (; i<=iCodes-4; i+=4)
+        {
+          if (roi(r,i+1)) ++aBanks[0][pCodes[i]];
+          if (roi(r,i+2)) ++aBanks[1][pCodes[i+1]];
+          if (roi(r,i+3)) ++aBanks[2][pCodes[i+2]];
+          if (roi(r,i+4)) ++aBanks[3][pCodes[i+3]];
+        }
+      for (; i<iCodes; ++i)
+        if (roi(r,i+1)) ++aBanks[0][pCodes[i]];
+    }
+
+  // The look-up table is applied once per code, not once per pixel.
+  result = PiiMatrix<int>(1, features);
+  int* pHistogram = result[0];
+  for (int i=0; i<256; ++i)
+    pHistogram[lookup != 0 ? lookup[i] : i] += aBanks[0][i] + aBanks[1][i] + aBanks[2][i] + aBanks[3][i];
+  return true;
+}
+
+template <class Roi>
+bool PiiLbp::fastBasicLbp(Image*, const PiiMatrix<unsigned char>& image, Roi roi,
+                          Pii::Identity<unsigned char>,
+                          const unsigned short* lookup, int, PiiMatrix<int>& result)
+{
+  const int iRows = image.rows(), iColumns = image.columns();
+  if (iRows < 3 || iColumns < 3)
+    return false;
+
+  // Pixels outside of the ROI are set to zero. With
+  // PiiImage::DefaultRoi, the check compiles away.
+  result = PiiMatrix<int>(PiiMatrix<int>::uninitialized(iRows-2, iColumns-2));
+  QVarLengthArray<unsigned char,2048> codes(iColumns);
+  unsigned char* pCodes = &codes[0];
+  for (int r=1; r<iRows-1; ++r)
+    {
+      basicLbpRow(image[r-1], image[r], image[r+1], iColumns, pCodes);
+      int* pTarget = result[r-1];
+      if (lookup != 0)
+        for (int i=0; i<iColumns-2; ++i)
+          pTarget[i] = roi(r,i+1) ? int(lookup[pCodes[i]]) : 0;
+      else
+        for (int i=0; i<iColumns-2; ++i)
+          pTarget[i] = roi(r,i+1) ? int(pCodes[i]) : 0;
+    }
+  return true;
+}
+
 template <class MatrixClass, class T, class Roi, class UnaryFunction>
 PiiMatrix<int> PiiLbp::basicLbp(const PiiMatrix<T>& image, Roi roi, UnaryFunction centerFunc)
 {
   typedef typename UnaryFunction::result_type C;
 
+  PiiMatrix<int> matFast;
+  if (fastBasicLbp(static_cast<MatrixClass*>(0), image, roi, centerFunc, 0, 256, matFast))
+    return matFast;
+
   const T *r0, *r1, *r2;
   register unsigned int value;
   int r, c;
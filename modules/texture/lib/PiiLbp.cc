@@ -17,6 +17,10 @@
 #include "PiiLbp.h"
 
 #include <iostream>
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
 using namespace Pii;
 
 PiiLbp::Data::Data(int samples, double radius,
@@ -225,3 +229,47 @@ Pii::Interpolation PiiLbp::interpolation() const
 {
   return d->interpolation;
 }
+
+void PiiLbp::basicLbpRow(const unsigned char* row0, const unsigned char* row1, const unsigned char* row2,
+                         int columns, unsigned char* codes)
+{
+  const int iCodes = columns - 2;
+  int i = 0;
+#ifdef __SSE2__
+  // SSE2 has no unsigned byte comparison. Flipping the sign bit maps
+  // unsigned order to signed order.
+  const __m128i sign = _mm_set1_epi8(char(0x80));
+#  define PII_LBP_LOAD(ROW, OFFSET) _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ROW + i + OFFSET)), sign)
+#  define PII_LBP_BIT(ROW, OFFSET, BIT) \
+  _mm_and_si128(_mm_cmpgt_epi8(PII_LBP_LOAD(ROW, OFFSET), center), _mm_set1_epi8(char(1 << BIT)))
+  for (; i<=iCodes-16; i+=16)
+    {
+      // Sixteen codes at a time, neighbors counter-clockwise as in
+      // basicLbp().
+      const __m128i center = PII_LBP_LOAD(row1, 1);
+      __m128i code = PII_LBP_BIT(row1, 2, 0);
+      code = _mm_or_si128(code, PII_LBP_BIT(row0, 2, 1));
+      code = _mm_or_si128(code, PII_LBP_BIT(row0, 1, 2));
+      code = _mm_or_si128(code, PII_LBP_BIT(row0, 0, 3));
+      code = _mm_or_si128(code, PII_LBP_BIT(row1, 0, 4));
+      code = _mm_or_si128(code, PII_LBP_BIT(row2, 0, 5));
+      code = _mm_or_si128(code, PII_LBP_BIT(row2, 1, 6));
+      code = _mm_or_si128(code, PII_LBP_BIT(row2, 2, 7));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(codes + i), code);
+    }
+#  undef PII_LBP_BIT
+#  undef PII_LBP_LOAD
+#endif
+  for (; i<iCodes; ++i)
+    {
+      const unsigned char center = row1[i+1];
+      codes[i] = (unsigned char)((row1[i+2] > center) |
+                                 (row0[i+2] > center) << 1 |
+                                 (row0[i+1] > center) << 2 |
+                                 (row0[i] > center) << 3 |
+                                 (row1[i] > center) << 4 |
+                                 (row2[i] > center) << 5 |
+                                 (row2[i+1] > center) << 6 |
+                                 (row2[i+2] > center) << 7);
+    }
+}
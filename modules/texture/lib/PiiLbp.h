@@ -230,6 +230,13 @@ public:
    * Please ensure that the result type of `centerFunc` can store the
    * calculation result without overflows or underflows. For example,
    * using `unsigned` `char` is not a good idea because 255 + 4 = 3.
+   *
+   * If *image* is an 8-bit gray-level image and *centerFunc* is
+   * Pii::Identity, a vectorized kernel calculates the codes of a
+   * whole row at once. With PiiLbp::Histogram, the codes are
+   * accumulated directly to the histogram without storing an LBP
+   * image. The same kernel is used by [genericLbp()] for the 8,1
+   * operator in all modes but `Symmetric`.
    */
   template <class MatrixClass, class T, class Roi, class UnaryFunction>
   static PiiMatrix<int> basicLbp(const PiiMatrix<T>& image, Roi roi, UnaryFunction centerFunc);
@@ -308,6 +315,34 @@ public:
   static unsigned short* createLookupTable(int samples, Mode mode);
 
 private:
+  /* Fast paths for the LBP 8,1 operator. The generic version is a
+   * no-op. The overloads for 8-bit images are more specialized and
+   * will be selected whenever their argument types match exactly.
+   * *lookup* converts standard codes to *features* features, or is
+   * zero in standard mode.
+   */
+  template <class MatrixClass, class T, class Roi, class UnaryFunction>
+  static inline bool fastBasicLbp(MatrixClass*, const PiiMatrix<T>&, Roi, UnaryFunction,
+                                  const unsigned short*, int, PiiMatrix<int>&)
+  {
+    return false;
+  }
+  template <class Roi>
+  static bool fastBasicLbp(Histogram*, const PiiMatrix<unsigned char>& image, Roi roi,
+                           Pii::Identity<unsigned char>,
+                           const unsigned short* lookup, int features, PiiMatrix<int>& result);
+  template <class Roi>
+  static bool fastBasicLbp(Image*, const PiiMatrix<unsigned char>& image, Roi roi,
+                           Pii::Identity<unsigned char>,
+                           const unsigned short* lookup, int features, PiiMatrix<int>& result);
+
+  /* Calculates standard LBP 8,1 codes for pixels 1, ..., columns-2
+   * on row1. row0 and row2 are the rows above and below. Codes are
+   * stored to codes[0], ..., codes[columns-3].
+   */
+  static void basicLbpRow(const unsigned char* row0, const unsigned char* row1, const unsigned char* row2,
+                          int columns, unsigned char* codes);
+
   struct InterpolationPoint
   {
     int x,y;
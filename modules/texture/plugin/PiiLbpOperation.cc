@@ -19,6 +19,75 @@
 #include <PiiMath.h>
 #include <PiiTypeTraits.h>
 #include <PiiRoi.h>
+#include <PiiImage.h>
+#include <cmath>
+
+namespace
+{
+  // Calculates an LBP for horizontal bands of an image. Each band is
+  // extended by the margin of the operator so that the output rows
+  // of consecutive bands follow each other without gaps or overlap.
+  template <class LbpType, class T, class CenterFunction> class LbpBands
+  {
+  public:
+    LbpBands(PiiLbp* lbp, const PiiMatrix<T>& image, int margin, int bands,
+             CenterFunction centerFunc, PiiMatrix<int>* results) :
+      _pLbp(lbp), _image(image), _iMargin(margin), _iBands(bands),
+      _centerFunc(centerFunc), _pResults(results)
+    {}
+
+    void operator() (int firstBand, int lastBand) const
+    {
+      const int iOutputRows = _image.rows() - 2*_iMargin;
+      for (int i=firstBand; i<lastBand; ++i)
+        {
+          const int iFirstRow = iOutputRows * i / _iBands, iLastRow = iOutputRows * (i+1) / _iBands;
+          const PiiMatrix<T> matBand(iLastRow - iFirstRow + 2*_iMargin, _image.columns(),
+                                     const_cast<T*>(_image.row(iFirstRow)),
+                                     Pii::RetainOwnership, _image.stride());
+          _pResults[i] = _pLbp->genericLbp<LbpType>(matBand, PiiImage::DefaultRoi(), _centerFunc);
+        }
+    }
+
+  private:
+    PiiLbp* _pLbp;
+    const PiiMatrix<T>& _image;
+    int _iMargin, _iBands;
+    CenterFunction _centerFunc;
+    PiiMatrix<int>* _pResults;
+  };
+
+  PiiMatrix<int> combineBands(const QVector<PiiMatrix<int> >& bands, PiiLbp::Histogram*)
+  {
+    PiiMatrix<int> matResult(bands[0]);
+    for (int i=1; i<bands.size(); ++i)
+      matResult += bands[i];
+    return matResult;
+  }
+
+  PiiMatrix<int> combineBands(const QVector<PiiMatrix<int> >& bands, PiiLbp::Image*)
+  {
+    PiiMatrix<int> matResult(bands[0]);
+    for (int i=1; i<bands.size(); ++i)
+      matResult.appendRows(bands[i]);
+    return matResult;
+  }
+
+  template <class LbpType, class T, class CenterFunction>
+  PiiMatrix<int> bandedLbp(PiiLbp* lbp, const PiiMatrix<T>& image, CenterFunction centerFunc, int threadCount)
+  {
+    const int iMargin = int(std::ceil(lbp->neighborhoodRadius()));
+    const int iBands = PiiImage::bandCount(image.rows() - 2*iMargin, image.columns(), iMargin, threadCount);
+    if (iBands <= 1)
+      return lbp->genericLbp<LbpType>(image, PiiImage::DefaultRoi(), centerFunc);
+
+    QVector<PiiMatrix<int> > vecResults(iBands);
+    Pii::parallelFor(iBands, iBands,
+                     LbpBands<LbpType,T,CenterFunction>(lbp, image, iMargin, iBands,
+                                                        centerFunc, vecResults.data()));
+    return combineBands(vecResults, static_cast<LbpType*>(0));
+  }
+}
 
 class PiiLbpOperation::AnyLbp
 {
@@ -66,6 +135,20 @@ public:
 
 private:
   template <class Roi> void calculate(const PiiMatrix<GrayType>& image, const Roi& roi);
+
+  // ROIs are given in the coordinates of the full image. Only the
+  // default ROI allows splitting the image into bands.
+  template <class Roi, class CenterFunction>
+  PiiMatrix<int> lbp(int index, const PiiMatrix<GrayType>& image, const Roi& roi, CenterFunction centerFunc)
+  {
+    return d->lstOperators[index]->genericLbp<LbpType>(image, roi, centerFunc);
+  }
+  template <class CenterFunction>
+  PiiMatrix<int> lbp(int index, const PiiMatrix<GrayType>& image, const PiiImage::DefaultRoi&, CenterFunction centerFunc)
+  {
+    return bandedLbp<LbpType>(d->lstOperators[index], image, centerFunc, d->iTileThreads);
+  }
+
   // Use at least int for the cumulative sum
   typedef typename Pii::Combine<GrayType,int>::Type SumType;
   PiiMatrix<SumType> matSum;
@@ -77,7 +160,8 @@ PiiLbpOperation::Data::Data() :
   iStaticOutputCount(0),
   roiType(PiiImage::AutoRoi),
   pLbp(0),
-  uiPreviousType(PiiVariant::InvalidType)
+  uiPreviousType(PiiVariant::InvalidType),
+  iTileThreads(1)
 {
 }
 
@@ -239,6 +323,8 @@ void PiiLbpOperation::createOutput(int samples, double radius,
 
 void PiiLbpOperation::setRoiType(PiiImage::RoiType roiType) { _d()->roiType = roiType; }
 PiiImage::RoiType PiiLbpOperation::roiType() const { return _d()->roiType; }
+void PiiLbpOperation::setTileThreads(int tileThreads) { _d()->iTileThreads = tileThreads; }
+int PiiLbpOperation::tileThreads() const { return _d()->iTileThreads; }
 
 void PiiLbpOperation::check(bool reset)
 {
@@ -345,12 +431,11 @@ void PiiLbpOperation::Lbp<T,LbpType>::calculate(const PiiMatrix<GrayType>& image
         {
           if (d->lstThresholds[i] == 0)
             addToVariant(vecResults[i],
-                         d->lstOperators[i]->genericLbp<LbpType>(PII_LBP_SMOOTH(image), roi));
+                         lbp(i, PII_LBP_SMOOTH(image), roi, Pii::Identity<GrayType>()));
           else
             addToVariant(vecResults[i],
-                         d->lstOperators[i]->genericLbp<LbpType>(PII_LBP_SMOOTH(image), roi,
-                                                                 std::bind2nd(std::plus<TT>(),
-                                                                              TT(d->lstThresholds[i]))));
+                         lbp(i, PII_LBP_SMOOTH(image), roi,
+                             std::bind2nd(std::plus<TT>(), TT(d->lstThresholds[i]))));
         }
     }
 #undef PII_LBP_SMOOTH
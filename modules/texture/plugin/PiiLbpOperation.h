@@ -48,6 +48,12 @@
  * created and named features0. It outputs the 256-bin feature vector
  * for LBP 8,1 in Standard mode with nearest neighbor interpolation.
  *
+ * LBP 8,1 with nearest neighbor interpolation and no threshold is
+ * calculated with a vectorized kernel if the input image is an 8-bit
+ * gray-level image. The kernel is about an order of magnitude faster
+ * than the generic implementation. It works in all modes but
+ * `Symmetric`, with or without a region-of-interest.
+ *
  */
 class PiiLbpOperation : public PiiDefaultOperation
 {
@@ -128,6 +134,16 @@ class PiiLbpOperation : public PiiDefaultOperation
    */
   Q_PROPERTY(PiiImage::RoiType roiType READ roiType WRITE setRoiType);
 
+  /**
+   * The number of threads used for calculating the LBP of a single
+   * image. Large images are split into horizontal bands whose
+   * histograms are summed up, or whose feature images are stacked
+   * together. The result does not depend on the number of threads.
+   * Bands are used only if the `roi` input is not connected. 0 means
+   * one thread per processor core. The default value is 1.
+   */
+  Q_PROPERTY(int tileThreads READ tileThreads WRITE setTileThreads);
+
   PII_OPERATION_SERIALIZATION_FUNCTION
 public:
 
@@ -162,6 +178,9 @@ public:
   void setRoiType(PiiImage::RoiType roiType);
   PiiImage::RoiType roiType() const;
 
+  void setTileThreads(int tileThreads);
+  int tileThreads() const;
+
   void check(bool reset);
 
 protected:
@@ -202,6 +221,7 @@ private:
     PiiImage::RoiType roiType;
     AnyLbp* pLbp;
     unsigned int uiPreviousType;
+    int iTileThreads;
   };
   PII_D_FUNC;
 };
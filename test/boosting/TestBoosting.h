@@ -24,8 +24,12 @@ class TestBoosting : public QObject
 
 private slots:
   void decisionStump();
+  void presortedDecisionStump();
+  void histogramSplitSearch();
+  void decisionStumpFactory();
   void adaBoost();
   void adaBoost_data();
+  void decisionStumpBenchmark();
 };
 
 #endif //_TESTBOOSTING_H
@@ -18,6 +18,9 @@
 #include <PiiBoostClassifier.h>
 #include <PiiDecisionStump.h>
 #include <PiiDefaultClassifierFactory.h>
+#include <PiiDecisionStumpFactory.h>
+#include <PiiParallel.h>
+#include <PiiTimer.h>
 
 void TestBoosting::decisionStump()
 {
@@ -73,6 +76,129 @@ void TestBoosting::decisionStump()
   QCOMPARE(stumps.classify(PiiMatrix<int>(1,1, 2).row(0)), 1.0);
 }
 
+void TestBoosting::presortedDecisionStump()
+{
+  // Runs of equal values in both features
+  PiiMatrix<int> features(8, 2,
+                          3, 1,
+                          1, 1,
+                          3, 2,
+                          2, 7,
+                          1, 2,
+                          5, 7,
+                          2, 1,
+                          5, 0);
+  QVector<double> labels;
+  labels << 0 << 1 << 0 << 1 << 1 << 0 << 0 << 0;
+
+  PiiDecisionStump<PiiMatrix<int> >::PresortedSampleSet presorted(features);
+  QCOMPARE(presorted.sampleCount(), 8);
+  QCOMPARE(presorted.featureCount(), 2);
+
+  PiiDecisionStump<PiiMatrix<int> > stump1, stump2;
+  QVector<double> weights(8, 1.0/8);
+  for (int i=0; i<3; ++i)
+    {
+      stump1.learn(features, labels, weights);
+      stump2.learn(presorted, labels, weights);
+      QCOMPARE(stump2.selectedFeature(), stump1.selectedFeature());
+      QCOMPARE(stump2.threshold(), stump1.threshold());
+      QCOMPARE(stump2.leftLabel(), stump1.leftLabel());
+      QCOMPARE(stump2.rightLabel(), stump1.rightLabel());
+      weights[i] *= 4;
+    }
+
+  // Thresholds 1 and 2 are equally good. The first one wins.
+  stump2.learn(presorted, labels, QVector<double>(8, 1.0/8));
+  QCOMPARE(stump2.selectedFeature(), 0);
+  QCOMPARE(stump2.threshold(), 1);
+  QCOMPARE(stump2.leftLabel(), 1.0);
+  QCOMPARE(stump2.rightLabel(), 0.0);
+
+  // Missing weights means equal weights.
+  stump1.learn(presorted, labels, QVector<double>());
+  QCOMPARE(stump1.selectedFeature(), 0);
+  QCOMPARE(stump1.threshold(), 1);
+  QCOMPARE(stump1.leftLabel(), 1.0);
+}
+
+void TestBoosting::histogramSplitSearch()
+{
+  PiiMatrix<int> features(6,1, 0, 1, 2, 3, 4, 5);
+  QVector<double> labels;
+  labels << 1 << 1 << 0 << 1 << 0 << 0;
+  QVector<double> weights(6, 2.0/11);
+  weights[2] = 1.0/11;
+
+  PiiDecisionStump<PiiMatrix<int> > stump;
+  // With enough bins, histogram search is exact.
+  stump.learn(PiiDecisionStump<PiiMatrix<int> >::PresortedSampleSet(features,
+                                                                      PiiClassification::HistogramSplitSearch),
+              labels, weights);
+  QCOMPARE(stump.threshold(), 3);
+  QCOMPARE(stump.leftLabel(), 1.0);
+
+  // Two bins: {0, 1, 2} and {3, 4, 5}
+  stump.learn(PiiDecisionStump<PiiMatrix<int> >::PresortedSampleSet(features,
+                                                                      PiiClassification::HistogramSplitSearch,
+                                                                      2),
+              labels, weights);
+  QCOMPARE(stump.threshold(), 2);
+  QCOMPARE(stump.leftLabel(), 1.0);
+  QCOMPARE(stump.rightLabel(), 0.0);
+
+  // Equal values must not be split into different bins.
+  PiiMatrix<int> features2(6,1, 1, 1, 1, 1, 2, 3);
+  stump.learn(PiiDecisionStump<PiiMatrix<int> >::PresortedSampleSet(features2,
+                                                                      PiiClassification::HistogramSplitSearch,
+                                                                      3),
+              labels, weights);
+  QCOMPARE(stump.threshold(), 1);
+}
+
+void TestBoosting::decisionStumpFactory()
+{
+  PiiMatrix<int> features(8, 2,
+                          1, 1,
+                          5, 4,
+                          -5, 5,
+                          -4, 3,
+                          3, -3,
+                          7, -4,
+                          -2, -6,
+                          -3, -2);
+  QVector<double> labels;
+  labels << 0 << 0 << 1 << 1 << 0 << 0 << 1 << 0;
+
+  PiiDefaultClassifierFactory<PiiDecisionStump<PiiMatrix<int> > > defaultFactory;
+  PiiBoostClassifier<PiiMatrix<int> > classifier1(&defaultFactory);
+  classifier1.setMaxClassifiers(3);
+  classifier1.learn(features, labels);
+
+  for (int i=0; i<2; ++i)
+    {
+      PiiDecisionStumpFactory<PiiMatrix<int> > factory;
+      if (i == 1)
+        factory.setSplitSearchMethod(PiiClassification::HistogramSplitSearch);
+      PiiBoostClassifier<PiiMatrix<int> > classifier2(&factory);
+      classifier2.setMaxClassifiers(3);
+      classifier2.learn(features, labels);
+
+      QList<PiiClassifier<PiiMatrix<int> >*> learners1 = classifier1.classifiers();
+      QList<PiiClassifier<PiiMatrix<int> >*> learners2 = classifier2.classifiers();
+      QCOMPARE(learners2.size(), learners1.size());
+      for (int j=0; j<learners1.size(); ++j)
+        {
+          PiiDecisionStump<PiiMatrix<int> >* pStump1 = static_cast<PiiDecisionStump<PiiMatrix<int> >*>(learners1[j]);
+          PiiDecisionStump<PiiMatrix<int> >* pStump2 = static_cast<PiiDecisionStump<PiiMatrix<int> >*>(learners2[j]);
+          QCOMPARE(pStump2->selectedFeature(), pStump1->selectedFeature());
+          QCOMPARE(pStump2->threshold(), pStump1->threshold());
+        }
+      for (int j=0; j<features.rows(); ++j)
+        QCOMPARE(classifier2.classify(features[j]), labels[j]);
+    }
+}
+
 void TestBoosting::adaBoost()
 {
   QFETCH(int, algorithm);
@@ -117,4 +243,57 @@ void TestBoosting::adaBoost_data()
   //QTest::newRow("FloatBoost") << int(PiiClassification::FloatBoost);
 }
 
+
+void TestBoosting::decisionStumpBenchmark()
+{
+  // Labels depend on the first two features only.
+  const int iSamples = 20000, iFeatures = 100, iRounds = 10;
+  srand(0);
+  PiiMatrix<float> features(PiiClassification::createRandomSampleSet<PiiMatrix<float> >(iSamples, iFeatures, 0, 1));
+  QVector<double> labels(iSamples);
+  for (int i=0; i<iSamples; ++i)
+    labels[i] = features(i,0) + features(i,1) + 0.2 * rand() / RAND_MAX > 1.1 ? 1 : 0;
+
+  // The default factory presorts the samples in every round.
+  PiiDefaultClassifierFactory<PiiDecisionStump<PiiMatrix<float> > > defaultFactory;
+  PiiBoostClassifier<PiiMatrix<float> > classifier1(&defaultFactory);
+  classifier1.setMaxClassifiers(iRounds);
+  PiiTimer timer;
+  classifier1.learn(features, labels);
+  const qint64 iDefaultTime = timer.restart();
+
+  PiiDecisionStumpFactory<PiiMatrix<float> > exactFactory;
+  PiiBoostClassifier<PiiMatrix<float> > classifier2(&exactFactory);
+  classifier2.setMaxClassifiers(iRounds);
+  timer.restart();
+  classifier2.learn(features, labels);
+  const qint64 iExactTime = timer.restart();
+
+  PiiDecisionStumpFactory<PiiMatrix<float> > histogramFactory;
+  histogramFactory.setSplitSearchMethod(PiiClassification::HistogramSplitSearch);
+  PiiBoostClassifier<PiiMatrix<float> > classifier3(&histogramFactory);
+  classifier3.setMaxClassifiers(iRounds);
+  timer.restart();
+  classifier3.learn(features, labels);
+  const qint64 iHistogramTime = timer.restart();
+
+  // Presorting once must not change the selected stumps.
+  QList<PiiClassifier<PiiMatrix<float> >*> learners1 = classifier1.classifiers();
+  QList<PiiClassifier<PiiMatrix<float> >*> learners2 = classifier2.classifiers();
+  QCOMPARE(learners2.size(), learners1.size());
+  for (int i=0; i<learners1.size(); ++i)
+    {
+      PiiDecisionStump<PiiMatrix<float> >* pStump1 = static_cast<PiiDecisionStump<PiiMatrix<float> >*>(learners1[i]);
+      PiiDecisionStump<PiiMatrix<float> >* pStump2 = static_cast<PiiDecisionStump<PiiMatrix<float> >*>(learners2[i]);
+      QCOMPARE(pStump2->selectedFeature(), pStump1->selectedFeature());
+      QCOMPARE(pStump2->threshold(), pStump1->threshold());
+    }
+  QVERIFY(classifier3.classifiers().size() > 0);
+
+  qDebug("AdaBoost, %d rounds, %d x %d floats, %d threads: presort every round %.1f ms, "
+         "exact %.1f ms, histogram %.1f ms",
+         iRounds, iSamples, iFeatures, Pii::parallelThreadCount(0),
+         iDefaultTime / 1000.0, iExactTime / 1000.0, iHistogramTime / 1000.0);
+}
+
 QTEST_MAIN(TestBoosting)
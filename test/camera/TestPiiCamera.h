@@ -17,6 +17,8 @@
 #define _TESTPIICAMERA_H
 
 #include <QObject>
+#include <PiiMatrix.h>
+#include <PiiCamera.h>
 
 class TestPiiCamera : public QObject
 {
@@ -24,7 +26,15 @@ class TestPiiCamera : public QObject
 
 private slots:
   void bayerToRgb();
+  void fastBayerToRgb();
+  void bayerToHalfRgb();
+  void bayerBottomRow();
   //void bayerToRgbSpeed();
+
+private:
+  template <class Decoder> void fastBayerToRgb(const PiiMatrix<unsigned char>& test,
+                                               PiiCamera::ImageFormat format,
+                                               Decoder decoder);
 };
 
 
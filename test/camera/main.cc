@@ -89,6 +89,93 @@ void TestPiiCamera::bayerToRgb()
   QVERIFY(Pii::equals(gray, (red + green + blue)/3));
 }
 
+template <class Decoder> void TestPiiCamera::fastBayerToRgb(const PiiMatrix<unsigned char>& test,
+                                                              PiiCamera::ImageFormat format,
+                                                              Decoder decoder)
+{
+  QVERIFY(Pii::equals(PiiCamera::fastBayerToRgb(test, format),
+                      PiiCamera::bayerToRgb(test, decoder, PiiCamera::Rgb4Pixel<>())));
+  QVERIFY(Pii::equals(PiiCamera::fastBayerToGray(test, format),
+                      PiiCamera::bayerToRgb(test, decoder, PiiCamera::GrayPixel<unsigned char>())));
+  QVERIFY(Pii::equals(PiiCamera::fastBayerChannel(test, format, 0),
+                      PiiCamera::bayerToRgb(test, decoder, PiiCamera::RedPixel<unsigned char>())));
+  QVERIFY(Pii::equals(PiiCamera::fastBayerChannel(test, format, 1),
+                      PiiCamera::bayerToRgb(test, decoder, PiiCamera::GreenPixel<unsigned char>())));
+  QVERIFY(Pii::equals(PiiCamera::fastBayerChannel(test, format, 2),
+                      PiiCamera::bayerToRgb(test, decoder, PiiCamera::BluePixel<unsigned char>())));
+}
+
+void TestPiiCamera::fastBayerToRgb()
+{
+  // Odd and even dimensions exercise the borders on all sides.
+  const int aSizes[][2] = { {37,29}, {36,28}, {36,29}, {37,28}, {2,2}, {3,40} };
+  for (unsigned i=0; i<sizeof(aSizes)/sizeof(aSizes[0]); ++i)
+    {
+      PiiMatrix<unsigned char> test(aSizes[i][0], aSizes[i][1]);
+      for (int r=0; r<test.rows(); ++r)
+        for (int c=0; c<test.columns(); ++c)
+          test(r,c) = (unsigned char)((r * 71 + c * 37 + r * c) % 256);
+
+      fastBayerToRgb(test, PiiCamera::BayerRGGBFormat, PiiCamera::RggbDecoder<>());
+      fastBayerToRgb(test, PiiCamera::BayerBGGRFormat, PiiCamera::BggrDecoder<>());
+      fastBayerToRgb(test, PiiCamera::BayerGBRGFormat, PiiCamera::GbrgDecoder<>());
+      fastBayerToRgb(test, PiiCamera::BayerGRBGFormat, PiiCamera::GrbgDecoder<>());
+
+      PiiMatrix<unsigned short> test16(PiiMatrix<unsigned short>(test) * 257);
+      QVERIFY(Pii::equals(PiiCamera::fastBayerToRgb(test16, PiiCamera::BayerBGGRFormat),
+                          PiiCamera::bayerToRgb(test16,
+                                                PiiCamera::BggrDecoder<unsigned short>(),
+                                                PiiCamera::RgbPixel<unsigned short>())));
+      QVERIFY(Pii::equals(PiiCamera::fastBayerToRgb(test16, PiiCamera::BayerGBRGFormat),
+                          PiiCamera::bayerToRgb(test16,
+                                                PiiCamera::GbrgDecoder<unsigned short>(),
+                                                PiiCamera::RgbPixel<unsigned short>())));
+
+      QVERIFY(Pii::equals(PiiCamera::fastBayerToGray(test, PiiCamera::MonoFormat),
+                          PiiMatrix<unsigned char>(test.rows(), test.columns())));
+    }
+}
+
+void TestPiiCamera::bayerBottomRow()
+{
+  // If only columns change, bilinear interpolation reproduces the
+  // input in all channels away from the left and right edges. The
+  // bottom row of an even-height image used to be shifted by one
+  // column in the generic decoder.
+  for (int iRows=4; iRows<=7; ++iRows)
+    {
+      PiiMatrix<unsigned char> test(iRows, 6);
+      for (int r=0; r<test.rows(); ++r)
+        for (int c=0; c<test.columns(); ++c)
+          test(r,c) = (unsigned char)(16 * c);
+
+      PiiMatrix<PiiColor4<> > rgb(PiiCamera::bayerToRgb(test, PiiCamera::RggbDecoder<>(),
+                                                        PiiCamera::Rgb4Pixel<>()));
+      for (int r=0; r<rgb.rows(); ++r)
+        for (int c=1; c<rgb.columns()-1; ++c)
+          QVERIFY(rgb(r,c) == PiiColor4<>(16*c, 16*c, 16*c));
+      QVERIFY(Pii::equals(PiiCamera::fastBayerToRgb(test, PiiCamera::BayerRGGBFormat), rgb));
+    }
+}
+
+void TestPiiCamera::bayerToHalfRgb()
+{
+  PiiMatrix<unsigned char> test(3,5,
+                                2,4,6,8,1,
+                                8,6,4,2,1,
+                                1,2,3,4,1);
+
+  PiiMatrix<PiiColor4<> > rgb(PiiCamera::bayerToHalfRgb(test, PiiCamera::BayerRGGBFormat));
+  QCOMPARE(rgb.rows(), 1);
+  QCOMPARE(rgb.columns(), 2);
+  QVERIFY(rgb(0,0) == PiiColor4<>(2,6,6));
+  QVERIFY(rgb(0,1) == PiiColor4<>(6,6,2));
+
+  rgb = PiiCamera::bayerToHalfRgb(test, PiiCamera::BayerGBRGFormat);
+  QVERIFY(rgb(0,0) == PiiColor4<>(8,4,4));
+  QVERIFY(rgb(0,1) == PiiColor4<>(4,4,8));
+}
+
 #if 0
 void TestPiiCamera::bayerToRgbSpeed()
 {
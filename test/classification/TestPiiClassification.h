@@ -26,6 +26,9 @@ private slots:
   void kMeans();
   void calculateDistanceMatrix();
   void countLabels();
+  void findClosestMatchBatch();
+  void offsetFeatures();
+  void knnClassifyBatch();
 };
 
 
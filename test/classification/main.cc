@@ -18,6 +18,10 @@
 #include <PiiClassification.h>
 #include <PiiSquaredGeometricDistance.h>
 #include <PiiGeometricDistance.h>
+#include <PiiAbsDiffDistance.h>
+#include <PiiChiSquaredDistance.h>
+#include <PiiHistogramIntersection.h>
+#include <PiiKnnClassifier.h>
 #include <QtTest>
 
 #include <PiiMatrixUtil.h>
@@ -102,4 +106,158 @@ void TestPiiClassification::countLabels()
   QCOMPARE(counts[3].second, 1);
 }
 
+template <class T, class Measure> static bool matchesExhaustiveSearch(const PiiMatrix<T>& samples,
+                                                                      const PiiMatrix<T>& models,
+                                                                      const Measure& measure)
+{
+  const int iFeatures = models.columns();
+  QVector<double> vecDistances;
+  QVector<int> vecMatches = PiiClassification::findClosestMatchBatch(samples, models, measure, &vecDistances);
+  if (vecMatches.size() != samples.rows())
+    return false;
+  PiiMatrix<double> matDistances(PiiClassification::calculateDistanceMatrix(samples, models, measure));
+  for (int s=0; s<samples.rows(); ++s)
+    {
+      double dMin = INFINITY;
+      for (int m=0; m<models.rows(); ++m)
+        {
+          const double dDistance = measure(samples[s], models[m], iFeatures);
+          dMin = qMin(dMin, dDistance);
+          if (Pii::abs(matDistances(s,m) - dDistance) > 1e-4 * (1 + Pii::abs(dDistance)))
+            return false;
+        }
+      // Batch kernels may add the features up in a different order.
+      // The best match must still be as close as the closest one.
+      const double dBest = measure(samples[s], models[vecMatches[s]], iFeatures);
+      if (Pii::abs(dBest - dMin) > 1e-4 * (1 + Pii::abs(dMin)) ||
+          Pii::abs(vecDistances[s] - dMin) > 1e-4 * (1 + Pii::abs(dMin)))
+        return false;
+    }
+  return true;
+}
+
+void TestPiiClassification::findClosestMatchBatch()
+{
+  // Odd feature count and more than one block of models
+  PiiMatrix<float> matSamples(PiiClassification::createRandomSampleSet<PiiMatrix<float> >(40, 37, 0, 1));
+  PiiMatrix<float> matModels(PiiClassification::createRandomSampleSet<PiiMatrix<float> >(300, 37, 0, 1));
+  PiiMatrix<double> matDoubleSamples(matSamples), matDoubleModels(matModels);
+
+  QVERIFY(matchesExhaustiveSearch(matSamples, matModels, PiiSquaredGeometricDistance<const float*>()));
+  QVERIFY(matchesExhaustiveSearch(matDoubleSamples, matDoubleModels, PiiSquaredGeometricDistance<const double*>()));
+  QVERIFY(matchesExhaustiveSearch(matSamples, matModels, PiiAbsDiffDistance<const float*>()));
+  QVERIFY(matchesExhaustiveSearch(matSamples, matModels, PiiChiSquaredDistance<const float*>()));
+  QVERIFY(matchesExhaustiveSearch(matSamples, matModels, PiiHistogramIntersection<const float*>()));
+  QVERIFY(matchesExhaustiveSearch(matSamples, matModels, PiiGeometricDistance<const float*>()));
+  // Fewer samples than needed for the norm form
+  QVERIFY(matchesExhaustiveSearch(PiiMatrix<float>(matSamples(0,0,3,-1)), matModels,
+                                  PiiSquaredGeometricDistance<const float*>()));
+  {
+    typedef const float* ConstFeatureIterator;
+    PII_POLYMORPHIC_MEASURE(PiiSquaredGeometricDistance) measure;
+    QVERIFY(matchesExhaustiveSearch(matSamples, matModels, static_cast<const PiiDistanceMeasure<const float*>&>(measure)));
+  }
+
+  // Equal vectors must be at zero distance and ties must go to the
+  // first model.
+  PiiMatrix<float> matFirstModels(matModels(0,0,10,-1));
+  PiiMatrix<float> matDuplicates(matFirstModels);
+  matDuplicates.appendRows(matFirstModels);
+  QVector<double> vecDistances;
+  QVector<int> vecMatches = PiiClassification::findClosestMatchBatch(matFirstModels, matDuplicates,
+                                                                     PiiSquaredGeometricDistance<const float*>(),
+                                                                     &vecDistances);
+  for (int i=0; i<10; ++i)
+    {
+      QCOMPARE(vecMatches[i], i);
+      QCOMPARE(vecDistances[i], 0.0);
+    }
+
+  // Empty model set
+  vecMatches = PiiClassification::findClosestMatchBatch(matSamples, PiiMatrix<float>(0, 37),
+                                                        PiiSquaredGeometricDistance<const float*>(),
+                                                        &vecDistances);
+  QCOMPARE(vecMatches.size(), 40);
+  QCOMPARE(vecMatches[0], -1);
+  QVERIFY(Pii::isInf(vecDistances[0]));
+}
+
+void TestPiiClassification::offsetFeatures()
+{
+  // Features far from the origin but close to each other. The norm
+  // form of the float kernel must not cancel the differences away.
+  PiiMatrix<float> matSamples(PiiClassification::createRandomSampleSet<PiiMatrix<float> >(10, 16, 999, 1001));
+  // The first ten models differ from the samples in one feature only,
+  // the rest in all features.
+  PiiMatrix<float> matModels(matSamples);
+  matModels.appendRows(matSamples);
+  for (int i=0; i<10; ++i)
+    {
+      matModels(i,i) += 0.001f * (i+1);
+      for (int c=0; c<16; ++c)
+        matModels(i+10,c) += 0.01f;
+    }
+
+  PiiSquaredGeometricDistance<const float*> measure;
+  PiiMatrix<double> matDistances(PiiClassification::calculateDistanceMatrix(matSamples, matModels, measure));
+  for (int s=0; s<matSamples.rows(); ++s)
+    for (int m=0; m<matModels.rows(); ++m)
+      {
+        double dDistance = 0;
+        for (int c=0; c<16; ++c)
+          dDistance += Pii::square(double(matSamples(s,c)) - double(matModels(m,c)));
+        QVERIFY(Pii::abs(matDistances(s,m) - dDistance) <= 1e-6 * dDistance);
+      }
+
+  QVector<double> vecDistances;
+  QVector<int> vecMatches = PiiClassification::findClosestMatchBatch(matSamples, matModels, measure, &vecDistances);
+  for (int i=0; i<10; ++i)
+    {
+      QCOMPARE(vecMatches[i], i);
+      QVERIFY(vecDistances[i] > 0);
+      QVERIFY(Pii::abs(vecDistances[i] - matDistances(i,i)) <= 1e-6 * matDistances(i,i));
+    }
+}
+
+void TestPiiClassification::knnClassifyBatch()
+{
+  PiiMatrix<double> matSamples(PiiClassification::createRandomSampleSet<PiiMatrix<double> >(30, 5, 0, 1));
+  PiiMatrix<double> matModels(PiiClassification::createRandomSampleSet<PiiMatrix<double> >(1200, 5, 0, 1));
+  QVector<double> vecLabels(matModels.rows());
+  for (int i=0; i<vecLabels.size(); ++i)
+    vecLabels[i] = i % 3;
+
+  PiiSquaredGeometricDistance<const double*> measure;
+  QVector<double> vecDistances;
+  QVector<int> vecIndices;
+  QVector<double> vecResults = PiiClassification::knnClassifyBatch(matSamples, matModels, vecLabels, measure, 5,
+                                                                   &vecDistances, &vecIndices);
+  QCOMPARE(vecResults.size(), matSamples.rows());
+  for (int i=0; i<matSamples.rows(); ++i)
+    {
+      double dDistance;
+      int iIndex;
+      QCOMPARE(vecResults[i], PiiClassification::knnClassify(matSamples[i], matModels, vecLabels, measure, 5,
+                                                             &dDistance, &iIndex));
+      QCOMPARE(vecDistances[i], dDistance);
+      QCOMPARE(vecIndices[i], iIndex);
+    }
+
+  PiiKnnClassifier<PiiMatrix<double> > classifier;
+  classifier.setModels(matModels);
+  classifier.setClassLabels(vecLabels);
+  for (int k=1; k<=3; k+=2)
+    {
+      classifier.setK(k);
+      vecResults = classifier.classifyBatch(matSamples);
+      for (int i=0; i<matSamples.rows(); ++i)
+        QCOMPARE(vecResults[i], classifier.classify(matSamples[i]));
+    }
+
+  // Rejected samples
+  classifier.setRejectThreshold(0);
+  vecResults = classifier.classifyBatch(matSamples);
+  QVERIFY(Pii::isNan(vecResults[0]));
+}
+
 QTEST_MAIN(TestPiiClassification)
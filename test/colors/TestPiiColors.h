@@ -33,6 +33,9 @@ private slots:
   void rgbToFromYpbpr();
   void rgbToFromYcbcr();
   void autocorrelogram();
+  void fastConversions();
+  void rgbToLab();
+  void conversionBenchmark();
 };
 
 
@@ -19,6 +19,7 @@
 #include <PiiColor.h>
 #include <QDebug>
 #include <PiiMatrixUtil.h>
+#include <PiiTimer.h>
 
 void TestPiiColors::sizeOf()
 {
@@ -309,4 +310,108 @@ void TestPiiColors::autocorrelogram()
   QVERIFY(Pii::almostEqual(PiiColors::autocorrelogram(Pii::matrix(Pii::transpose(input2)), 4), r2, 1e-6));
 }
 
+template <class Clr> static PiiMatrix<Clr> randomColors(int rows, int columns)
+{
+  PiiMatrix<Clr> matResult(rows, columns);
+  for (int r=0; r<rows; ++r)
+    for (int c=0; c<columns; ++c)
+      matResult(r,c) = Clr(rand() % 256, rand() % 256, rand() % 256);
+  // Gray, black and white need special care in HSV.
+  matResult(0,0) = Clr(0,0,0);
+  matResult(0,1) = Clr(255,255,255);
+  matResult(0,2) = Clr(17,17,17);
+  return matResult;
+}
+
+template <class Clr> static void compareFastConversions()
+{
+  // Widths that are not multiples of vector or chunk sizes
+  const int aWidths[] = { 1, 7, 37, 263 };
+  for (unsigned i=0; i<sizeof(aWidths)/sizeof(aWidths[0]); ++i)
+    {
+      PiiMatrix<Clr> image(randomColors<Clr>(3, aWidths[i] + 2));
+      QVERIFY(Pii::equals(PiiColors::rgbToHsv(image),
+                          PiiMatrix<Clr>(image.mapped(PiiColors::RgbToHsv<Clr>()))));
+      QVERIFY(Pii::equals(PiiColors::rgbToYcbcr(image),
+                          PiiMatrix<Clr>(image.mapped(PiiColors::RgbToYcbcr<Clr>()))));
+      QVERIFY(Pii::equals(PiiColors::rgbToGrayMean(image),
+                          PiiMatrix<unsigned char>(image.mapped(PiiColors::RgbToGrayMean<Clr>()))));
+
+      // YUV 4:2:2 needs an even number of pixels.
+      PiiMatrix<unsigned char> yuv(1, 4 * image.columns());
+      for (int j=0; j<yuv.columns(); ++j)
+        yuv(0,j) = rand() % 256;
+      PiiMatrix<Clr> matExpected(2, image.columns()), matResult(2, image.columns());
+      PiiColors::yuv422toRgb<Clr>(yuv[0], matExpected[0], image.columns(), 2);
+      PiiColors::yuv422toRgb(yuv[0], matResult[0], image.columns(), 2);
+      QVERIFY(Pii::equals(matResult, matExpected));
+    }
+}
+
+void TestPiiColors::fastConversions()
+{
+  compareFastConversions<PiiColor<> >();
+  compareFastConversions<PiiColor4<> >();
+
+  // Fourth channel must be cleared
+  PiiMatrix<PiiColor4<> > image(1,16);
+  for (int i=0; i<16; ++i)
+    image(0,i) = PiiColor4<>(1,2,3,4);
+  QCOMPARE(int(PiiColors::rgbToHsv(image)(0,15).c3), 0);
+  QCOMPARE(int(PiiColors::rgbToYcbcr(image)(0,15).c3), 0);
+}
+
+static float maxDifference(const PiiMatrix<PiiColor<float> >& a, const PiiMatrix<PiiColor<float> >& b)
+{
+  float fMax = 0;
+  for (int r=0; r<a.rows(); ++r)
+    for (int c=0; c<a.columns(); ++c)
+      for (int i=0; i<3; ++i)
+        fMax = qMax(fMax, Pii::abs(a(r,c).channels[i] - b(r,c).channels[i]));
+  return fMax;
+}
+
+void TestPiiColors::rgbToLab()
+{
+  PiiColor<float> white(95.05, 100, 108.88);
+  PiiColor<float> xyz(PiiColors::labToXyz(PiiColors::xyzToLab(PiiColor<float>(40, 50, 60), white), white));
+  QVERIFY(Pii::abs(xyz.xyzX - 40.0f) < 1e-3f);
+  QVERIFY(Pii::abs(xyz.xyzY - 50.0f) < 1e-3f);
+  QVERIFY(Pii::abs(xyz.xyzZ - 60.0f) < 1e-3f);
+
+  PiiMatrix<PiiColor<> > image(randomColors<PiiColor<> >(31, 57));
+  PiiMatrix<PiiColor<float> > matExact(PiiColors::xyzToLab(PiiColors::genericConversion(image, PiiColors::d65_709_XyzMatrix),
+                                                           white));
+  QVERIFY(maxDifference(PiiColors::rgbToLab(image, PiiColors::d65_709_XyzMatrix, white, 0), matExact) < 1e-3f);
+  QVERIFY(maxDifference(PiiColors::rgbToLab(image, PiiColors::d65_709_XyzMatrix, white), matExact) < 1e-2f);
+  QVERIFY(maxDifference(PiiColors::rgbToLab(image, PiiColors::d65_709_XyzMatrix, white, 256), matExact) < 0.5f);
+}
+
+void TestPiiColors::conversionBenchmark()
+{
+  PiiMatrix<PiiColor4<> > image(randomColors<PiiColor4<> >(1024, 1024));
+  PiiMatrix<unsigned char> yuv(1, 2 * 1024 * 1024);
+  PiiMatrix<PiiColor4<> > matRgb(1024, 1024);
+  PiiTimer timer;
+  Pii::matrix(image.mapped(PiiColors::RgbToHsv<PiiColor4<> >()));
+  qint64 iGenericHsv = timer.restart();
+  PiiColors::rgbToHsv(image);
+  qint64 iHsv = timer.restart();
+  Pii::matrix(image.mapped(PiiColors::RgbToYcbcr<PiiColor4<> >()));
+  qint64 iGenericYcbcr = timer.restart();
+  PiiColors::rgbToYcbcr(image);
+  qint64 iYcbcr = timer.restart();
+  PiiColors::yuv422toRgb<PiiColor4<> >(yuv[0], matRgb[0], 1024, 1024);
+  qint64 iGenericYuv = timer.restart();
+  PiiColors::yuv422toRgb(yuv[0], matRgb[0], 1024, 1024);
+  qint64 iYuv = timer.restart();
+  PiiColors::rgbToLab(image, PiiColors::d65_709_XyzMatrix, PiiColor<float>(95.05, 100, 108.88), 0);
+  qint64 iExactLab = timer.restart();
+  PiiColors::rgbToLab(image, PiiColors::d65_709_XyzMatrix, PiiColor<float>(95.05, 100, 108.88));
+  qint64 iLab = timer.restart();
+  qDebug("1024x1024 generic/fast: HSV %.2f/%.2f ms, Y'CbCr %.2f/%.2f ms, YUV 4:2:2 %.2f/%.2f ms, L*a*b* %.2f/%.2f ms",
+         iGenericHsv / 1000.0, iHsv / 1000.0, iGenericYcbcr / 1000.0, iYcbcr / 1000.0,
+         iGenericYuv / 1000.0, iYuv / 1000.0, iExactLab / 1000.0, iLab / 1000.0);
+}
+
 QTEST_MAIN(TestPiiColors)
@@ -33,6 +33,9 @@ private slots:
   void metaProperties();
   void process();
   void process_data();
+  void statisticsCounters();
+  void statistics();
+  void trace();
 
 private:
   enum { sequenceLength = 2048 };
@@ -18,6 +18,7 @@
 #include <QtTest>
 
 #include <PiiYdinUtil.h>
+#include <PiiTraceRecorder.h>
 
 CounterOperation::CounterOperation() :
   _iProp1(0),
@@ -207,4 +208,93 @@ void TestPiiDefaultOperation::process_data()
     QTest::newRow(qPrintable(QString::number(i))) << i;
 }
 
+void TestPiiDefaultOperation::statisticsCounters()
+{
+  PiiOperationStatistics::Counter counter;
+  counter.add(1);
+  counter.add(Q_INT64_C(5000000000));
+  for (int i=0; i<1000; ++i)
+    counter.add(1000000);
+  QCOMPARE(counter.value(), Q_INT64_C(5000000001) + Q_INT64_C(1000000000));
+
+  PiiOperationStatistics::TimeHistogram histogram;
+  histogram.add(0);
+  histogram.add(1);
+  histogram.add(3);
+  histogram.add(4);
+  histogram.add(7);
+  QCOMPARE(histogram.count(), qint64(5));
+  QCOMPARE(histogram.totalTime(), qint64(15));
+  QCOMPARE(histogram.bucket(0), 1);
+  QCOMPARE(histogram.bucket(1), 1);
+  QCOMPARE(histogram.bucket(2), 1);
+  QCOMPARE(histogram.bucket(3), 2);
+  QCOMPARE(histogram.toVariantMap()["histogram"].toList().size(), 4);
+}
+
+void TestPiiDefaultOperation::statistics()
+{
+  _pCounter->setProperty("threadCount", 1);
+  QVERIFY(_engine.statistics().isEmpty());
+  _engine.setProperty("statisticsEnabled", true);
+  try
+    {
+      _engine.execute();
+    }
+  catch (PiiException& ex)
+    {
+      QFAIL(qPrintable(ex.message()));
+    }
+  QVERIFY(_engine.wait(PiiOperation::Stopped, 500));
+
+  QVariantMap mapStatistics(_engine.statistics());
+  QVariantMap mapCounter(mapStatistics["counter"].toMap());
+  QCOMPARE(mapCounter["processTime"].toMap()["count"].toInt(), int(sequenceLength));
+
+  // Received objects include the stop tag.
+  QVariantMap mapInput(mapCounter["inputs"].toMap()["input"].toMap());
+  QVERIFY(mapInput["received"].toInt() > int(sequenceLength));
+  QVERIFY(mapInput["maxQueueLength"].toInt() <= _pCounter->inputAt(0)->queueCapacity());
+
+  QVariantMap mapOutput(mapCounter["outputs"].toMap()["output0"].toMap());
+  QVERIFY(mapOutput["emitted"].toInt() > int(sequenceLength));
+  QVERIFY(mapOutput["objectsPerSecond"].toDouble() > 0);
+
+  QVariantMap mapBuffer(mapStatistics["buffer"].toMap());
+  QCOMPARE(mapBuffer["processTime"].toMap()["count"].toInt(), int(sequenceLength));
+
+  _engine.setProperty("statisticsEnabled", false);
+  _engine.check(true);
+  QVERIFY(_engine.statistics().isEmpty());
+}
+
+void TestPiiDefaultOperation::trace()
+{
+  _pCounter->setProperty("threadCount", 1);
+  PiiTraceRecorder::start(16);
+  QVERIFY(PiiTraceRecorder::isEnabled());
+  try
+    {
+      _engine.execute();
+    }
+  catch (PiiException& ex)
+    {
+      QFAIL(qPrintable(ex.message()));
+    }
+  QVERIFY(_engine.wait(PiiOperation::Stopped, 500));
+  PiiTraceRecorder::stop();
+  QVERIFY(!PiiTraceRecorder::isEnabled());
+
+  QByteArray aTrace(PiiTraceRecorder::toChromeTrace());
+  QVERIFY(aTrace.startsWith("{\"traceEvents\":["));
+  QVERIFY(aTrace.contains("\"name\":\"counter\",\"cat\":\"process\",\"ph\":\"X\""));
+  // Only the last 16 events of each thread are retained.
+  QVERIFY(aTrace.count("\"ph\":\"X\"") <= 16 * aTrace.count("\"ph\":\"M\""));
+
+  // Nothing is recorded after stop().
+  PiiTraceRecorder::start();
+  PiiTraceRecorder::stop();
+  QVERIFY(!PiiTraceRecorder::toChromeTrace().contains("\"ph\":\"X\""));
+}
+
 QTEST_MAIN(TestPiiDefaultOperation)
@@ -25,6 +25,8 @@ class TestPiiDsp : public QObject
 private slots:
   void fftShift();
   void fft();
+  void realFft();
+  void fftBenchmark();
   void correlation();
   void normalizedCorrelation();
   void convolution();
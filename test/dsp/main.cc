@@ -18,6 +18,7 @@
 #include <PiiDsp.h>
 #include <PiiFft.h>
 #include <PiiMatrixUtil.h>
+#include <PiiTimer.h>
 #include <QtTest>
 #include <iostream>
 
@@ -130,6 +131,91 @@ void TestPiiDsp::fft()
   }
 }
 
+template <class T> static bool almostEqualComplex(const PiiMatrix<std::complex<T> >& a,
+                                                   const PiiMatrix<std::complex<T> >& b,
+                                                   T tolerance)
+{
+  return Pii::almostEqual(Pii::real(a), Pii::real(b), tolerance) &&
+    Pii::almostEqual(Pii::imag(a), Pii::imag(b), tolerance);
+}
+
+void TestPiiDsp::realFft()
+{
+  // Even, odd, prime and mixed-radix sizes
+  const int aSizes[][2] = { {1,1}, {1,8}, {8,1}, {6,6}, {11,17}, {24,20}, {13,26}, {37,74}, {64,128} };
+  for (unsigned i=0; i<sizeof(aSizes)/sizeof(aSizes[0]); ++i)
+    {
+      const int iRows = aSizes[i][0], iCols = aSizes[i][1];
+      PiiMatrix<double> input(iRows, iCols);
+      PiiMatrix<std::complex<double> > complexInput(iRows, iCols);
+      for (int r=0; r<iRows; ++r)
+        for (int c=0; c<iCols; ++c)
+          complexInput(r,c) = input(r,c) = rand() % 200 - 100;
+
+      for (int iThreads=1; iThreads<=4; iThreads += 3)
+        {
+          PiiFft<double> fft;
+          fft.setThreadCount(iThreads);
+          // The real-input algorithm must produce the same full spectrum.
+          PiiMatrix<std::complex<double> > matSpectrum(fft.forwardFft(complexInput));
+          QVERIFY(almostEqualComplex(fft.forwardFft(input), matSpectrum, 1e-8));
+          PiiMatrix<std::complex<double> > matHalf(fft.forwardRealFft(input));
+          QCOMPARE(matHalf.columns(), iCols/2 + 1);
+          QVERIFY(almostEqualComplex(matHalf, PiiMatrix<std::complex<double> >(matSpectrum(0,0,iRows,iCols/2+1)), 1e-8));
+          QVERIFY(Pii::almostEqual(fft.inverseRealFft(matHalf, iCols), input, 1e-10));
+          QVERIFY(almostEqualComplex(fft.inverseFft(matSpectrum), complexInput, 1e-10));
+        }
+    }
+
+  // Submatrix input
+  PiiMatrix<double> matLarge(10, 12);
+  for (int r=0; r<matLarge.rows(); ++r)
+    for (int c=0; c<matLarge.columns(); ++c)
+      matLarge(r,c) = rand() % 10;
+  PiiFft<float> fft;
+  PiiMatrix<double> matSub(matLarge(1,2,6,8)), matCopy(6,8);
+  for (int r=0; r<6; ++r)
+    for (int c=0; c<8; ++c)
+      matCopy(r,c) = matSub(r,c);
+  QVERIFY(almostEqualComplex(fft.forwardFft(matSub), fft.forwardFft(matCopy), 1e-5f));
+
+  try
+    {
+      fft.inverseRealFft(PiiMatrix<std::complex<double> >(3,4), 8);
+      QFAIL("A half spectrum of an 8-column matrix must have 5 columns.");
+    }
+  catch (PiiMathException&)
+    {}
+}
+
+void TestPiiDsp::fftBenchmark()
+{
+  const int aSizes[][2] = { {512,512}, {1024,1024}, {480,640}, {1000,1000}, {243,625} };
+  for (unsigned i=0; i<sizeof(aSizes)/sizeof(aSizes[0]); ++i)
+    {
+      PiiMatrix<float> image(aSizes[i][0], aSizes[i][1]);
+      for (int r=0; r<image.rows(); ++r)
+        for (int c=0; c<image.columns(); ++c)
+          image(r,c) = rand() % 256;
+
+      PiiFft<float> fft;
+      fft.setThreadCount(1);
+      PiiTimer timer;
+      PiiMatrix<std::complex<float> > matSpectrum(fft.forwardFft(image));
+      qint64 iFirst = timer.restart();
+      fft.forwardFft(image);
+      qint64 iForward = timer.restart();
+      fft.forwardRealFft(image);
+      qint64 iReal = timer.restart();
+      PiiMatrix<std::complex<float> > matInverse(fft.inverseFft(matSpectrum));
+      qint64 iInverse = timer.restart();
+      qDebug("FFT %dx%d: first %.2f ms, planned %.2f ms, half spectrum %.2f ms, inverse %.2f ms",
+             image.columns(), image.rows(),
+             iFirst / 1000.0, iForward / 1000.0, iReal / 1000.0, iInverse / 1000.0);
+      QVERIFY(Pii::almostEqual(Pii::real(matInverse), image, 1e-2f));
+    }
+}
+
 void TestPiiDsp::findPeaks()
 {
   try
@@ -0,0 +1,385 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "TestPiiHnswIndex.h"
+
+#include <QtTest>
+#include <PiiHnswIndex.h>
+#include <PiiProductQuantizer.h>
+#include <PiiKnnClassifier.h>
+#include <PiiSquaredGeometricDistance.h>
+#include <PiiSerializationUtil.h>
+#include <PiiTextOutputArchive.h>
+#include <PiiTextInputArchive.h>
+#include <PiiTimer.h>
+
+void TestPiiHnswIndex::findClosestMatches()
+{
+  PiiMatrix<int> matModels(8, 2,
+                           -3, -1,
+                           -1, -2,
+                           -2, 1,
+                           -1, 2,
+                           1, -1,
+                           3, -2,
+                           2, 1,
+                           2, 3);
+  PiiMatrix<int> matSamples(3, 2,
+                            0, -2,
+                            -1, 5,
+                            1, 1);
+  int aMatches[3][3] = { { 1, 4, 5 },
+                         { 3, 7, 2 },
+                         { 6, 4, 3 } };
+
+  PiiHnswIndex<PiiMatrix<int> > index;
+  QCOMPARE(index.modelCount(), 0);
+  QCOMPARE(index.findClosestMatch(matSamples[0]), -1);
+  QCOMPARE(index.findClosestMatches(matSamples[0], 3).size(), 0);
+
+  // The search is exhaustive if the search width covers all models.
+  index.buildIndex(matModels);
+  QCOMPARE(index.modelCount(), 8);
+  QVERIFY(!index.isCompressed());
+  for (int i=0; i<matSamples.rows(); ++i)
+    {
+      PiiClassification::MatchList lstMatches = index.findClosestMatches(matSamples[i], 3);
+      QCOMPARE(lstMatches.size(), 3);
+      for (int j=0; j<3; ++j)
+        QCOMPARE(lstMatches[j].second, aMatches[i][j]);
+      double dDistance = -1;
+      QCOMPARE(index.findClosestMatch(matSamples[i], &dDistance), aMatches[i][0]);
+      QCOMPARE(dDistance, lstMatches[0].first);
+    }
+  QCOMPARE(index.findClosestMatches(matSamples[0], 10).size(), 8);
+}
+
+void TestPiiHnswIndex::recall()
+{
+  PiiMatrix<float> matModels(PiiClassification::createRandomSampleSet<PiiMatrix<float> >(5000, 16, 0, 1));
+  PiiMatrix<float> matSamples(PiiClassification::createRandomSampleSet<PiiMatrix<float> >(200, 16, 0, 1));
+  PiiSquaredGeometricDistance<const float*> measure;
+
+  PiiHnswIndex<PiiMatrix<float> > index;
+  index.setMaxConnections(12);
+  QCOMPARE(index.maxConnections(), 12);
+  index.buildIndex(matModels);
+  index.setSearchWidth(100);
+  QCOMPARE(index.searchWidth(), 100);
+
+  int iHits = 0;
+  for (int i=0; i<matSamples.rows(); ++i)
+    {
+      PiiClassification::MatchList lstExact = PiiClassification::findClosestMatches(matSamples[i], matModels, measure, 5);
+      PiiClassification::MatchList lstMatches = index.findClosestMatches(matSamples[i], 5);
+      QCOMPARE(lstMatches.size(), 5);
+      for (int j=0; j<5; ++j)
+        {
+          // Distances must be exact even if the neighbors are not.
+          QVERIFY(qAbs(lstMatches[j].first - measure(matSamples[i], matModels[lstMatches[j].second], 16)) < 1e-5);
+          if (j > 0)
+            QVERIFY(lstMatches[j-1].first <= lstMatches[j].first);
+          for (int k=0; k<5; ++k)
+            if (lstMatches[j].second == lstExact[k].second)
+              {
+                ++iHits;
+                break;
+              }
+        }
+    }
+  QVERIFY(iHits >= 0.95 * 5 * matSamples.rows());
+
+  index.setSearchWidth(0);
+  QCOMPARE(index.searchWidth(), 64);
+}
+
+// Returns the fraction of the exact k nearest neighbors found.
+static double recallAt(const QList<PiiClassification::MatchList>& exact,
+                       const QList<PiiClassification::MatchList>& matches)
+{
+  int iHits = 0, iTotal = 0;
+  for (int i=0; i<exact.size(); ++i)
+    {
+      iTotal += exact[i].size();
+      for (int j=0; j<matches[i].size(); ++j)
+        for (int k=0; k<exact[i].size(); ++k)
+          if (matches[i][j].second == exact[i][k].second)
+            {
+              ++iHits;
+              break;
+            }
+    }
+  return double(iHits) / iTotal;
+}
+
+void TestPiiHnswIndex::benchmark()
+{
+  const int iModels = 20000, iSamples = 500, iFeatures = 32, iK = 10;
+  PiiMatrix<float> matModels(PiiClassification::createRandomSampleSet<PiiMatrix<float> >(iModels, iFeatures, 0, 1));
+  PiiMatrix<float> matSamples(PiiClassification::createRandomSampleSet<PiiMatrix<float> >(iSamples, iFeatures, 0, 1));
+
+  PiiTimer timer;
+  QList<PiiClassification::MatchList> lstExact =
+    PiiClassification::findClosestMatchesBatch(matSamples, matModels, PiiSquaredGeometricDistance<const float*>(), iK);
+  const qint64 iExactTime = timer.restart();
+  qDebug("%d models, %d features, k = %d", iModels, iFeatures, iK);
+  qDebug("Exhaustive search: %.1f us/query", double(iExactTime) / iSamples);
+
+  PiiHnswIndex<PiiMatrix<float> > index;
+  timer.restart();
+  index.buildIndex(matModels);
+  qDebug("HNSW index built in %.1f ms", timer.restart() / 1000.0);
+  const int aWidths[] = { 16, 64, 256 };
+  for (int i=0; i<3; ++i)
+    {
+      index.setSearchWidth(aWidths[i]);
+      timer.restart();
+      QList<PiiClassification::MatchList> lstMatches = index.findClosestMatchesBatch(matSamples, iK);
+      const qint64 iTime = timer.restart();
+      const double dRecall = recallAt(lstExact, lstMatches);
+      qDebug("HNSW, search width %d: recall@%d %.3f, %.1f us/query",
+             aWidths[i], iK, dRecall, double(iTime) / iSamples);
+      if (aWidths[i] >= 64)
+        QVERIFY(dRecall > 0.9);
+    }
+
+  PiiHnswIndex<PiiMatrix<float> > compressedIndex;
+  compressedIndex.setQuantizerSubspaceCount(8);
+  timer.restart();
+  compressedIndex.buildIndex(matModels);
+  qDebug("Compressed HNSW index built in %.1f ms", timer.restart() / 1000.0);
+  QVERIFY(compressedIndex.isCompressed());
+  compressedIndex.setSearchWidth(64);
+  timer.restart();
+  QList<PiiClassification::MatchList> lstMatches = compressedIndex.findClosestMatchesBatch(matSamples, iK);
+  const qint64 iTime = timer.restart();
+  qDebug("Compressed HNSW, search width 64: recall@%d %.3f, %.1f us/query",
+         iK, recallAt(lstExact, lstMatches), double(iTime) / iSamples);
+}
+
+void TestPiiHnswIndex::findClosestMatchesBatch()
+{
+  PiiMatrix<float> matModels(PiiClassification::createRandomSampleSet<PiiMatrix<float> >(3000, 8, 0, 1));
+  PiiMatrix<float> matSamples(PiiClassification::createRandomSampleSet<PiiMatrix<float> >(300, 8, 0, 1));
+  PiiHnswIndex<PiiMatrix<float> > index(matModels);
+
+  QList<PiiClassification::MatchList> lstMatches = index.findClosestMatchesBatch(matSamples, 3);
+  QVector<double> vecDistances;
+  QVector<int> vecIndices = index.findClosestMatchBatch(matSamples, &vecDistances);
+  QCOMPARE(lstMatches.size(), matSamples.rows());
+  QCOMPARE(vecIndices.size(), matSamples.rows());
+  QCOMPARE(vecDistances.size(), matSamples.rows());
+  for (int i=0; i<matSamples.rows(); ++i)
+    {
+      PiiClassification::MatchList lstSingle = index.findClosestMatches(matSamples[i], 3);
+      QCOMPARE(lstMatches[i].size(), 3);
+      for (int j=0; j<3; ++j)
+        QCOMPARE(lstMatches[i][j], lstSingle[j]);
+      QCOMPARE(vecIndices[i], lstSingle[0].second);
+      QCOMPARE(vecDistances[i], lstSingle[0].first);
+    }
+
+  // Copies share the index but not the parameters.
+  PiiHnswIndex<PiiMatrix<float> > copy(index);
+  copy.setSearchWidth(1);
+  QCOMPARE(index.searchWidth(), 64);
+  QCOMPARE(copy.modelCount(), index.modelCount());
+}
+
+void TestPiiHnswIndex::productQuantizer()
+{
+  PiiMatrix<float> matModels(PiiClassification::createRandomSampleSet<PiiMatrix<float> >(1000, 12, 0, 1));
+  PiiProductQuantizer<PiiMatrix<float> > quantizer;
+  quantizer.setSubspaceCount(5);
+  quantizer.setCentroidCount(16);
+  QVERIFY(!quantizer.isTrained());
+  quantizer.train(matModels);
+  QVERIFY(quantizer.isTrained());
+  QCOMPARE(quantizer.subspaceCount(), 5);
+  QCOMPARE(quantizer.featureCount(), 12);
+  QCOMPARE(quantizer.distanceTableSize(), 5 * 16);
+
+  QVector<unsigned char> vecCodes(quantizer.encode(matModels));
+  QCOMPARE(vecCodes.size(), 1000 * 5);
+  QVector<float> vecTable(quantizer.distanceTableSize());
+  PiiSquaredGeometricDistance<const float*> measure;
+  double dError = 0, dTotal = 0;
+  for (int i=0; i<20; ++i)
+    {
+      quantizer.calculateDistanceTable(matModels[i], vecTable.data());
+      for (int j=0; j<1000; j += 10)
+        {
+          QVERIFY(vecCodes[j*5] < 16);
+          const double dExact = measure(matModels[i], matModels[j], 12);
+          dError += qAbs(quantizer.distance(vecTable.constData(), vecCodes.constData() + j*5) - dExact);
+          dTotal += dExact;
+        }
+    }
+  QVERIFY(dError < 0.3 * dTotal);
+
+  // Training with less samples than centroids stores the samples as such.
+  PiiMatrix<float> matFew(matModels(0,0,3,-1));
+  quantizer.train(matFew);
+  QVector<unsigned char> vecFewCodes(quantizer.encode(matFew));
+  for (int i=0; i<3; ++i)
+    {
+      quantizer.calculateDistanceTable(matFew[i], vecTable.data());
+      QCOMPARE(quantizer.distance(vecTable.constData(), vecFewCodes.constData() + i*5), 0.0);
+    }
+
+  // More subspaces than features
+  quantizer.setSubspaceCount(20);
+  quantizer.train(matModels);
+  QCOMPARE(quantizer.subspaceCount(), 12);
+}
+
+void TestPiiHnswIndex::compression()
+{
+  // Well separated clusters survive compression.
+  PiiMatrix<float> matModels(PiiClassification::createRandomSampleSet<PiiMatrix<float> >(2000, 16, 0, 0.1));
+  for (int i=0; i<matModels.rows(); ++i)
+    for (int j=0; j<16; ++j)
+      matModels(i,j) += float((i / 100 + j) % 4);
+  PiiMatrix<float> matSamples(matModels(0,0,100,-1));
+
+  PiiHnswIndex<PiiMatrix<float> > index;
+  index.setQuantizerSubspaceCount(8);
+  QCOMPARE(index.quantizerSubspaceCount(), 8);
+  index.buildIndex(matModels);
+  QVERIFY(index.isCompressed());
+  QCOMPARE(index.modelCount(), 2000);
+
+  QList<PiiClassification::MatchList> lstMatches = index.findClosestMatchesBatch(matSamples, 5);
+  for (int i=0; i<matSamples.rows(); ++i)
+    {
+      QCOMPARE(lstMatches[i].size(), 5);
+      // The closest matches must be in the same cluster.
+      for (int j=0; j<5; ++j)
+        QCOMPARE(lstMatches[i][j].second / 100 % 4, i / 100 % 4);
+    }
+}
+
+void TestPiiHnswIndex::knnClassifier()
+{
+  PiiMatrix<float> matModels(PiiClassification::createRandomSampleSet<PiiMatrix<float> >(2000, 4, 0, 1));
+  PiiMatrix<float> matSamples(PiiClassification::createRandomSampleSet<PiiMatrix<float> >(200, 4, 0, 1));
+  QVector<double> vecLabels(matModels.rows());
+  for (int i=0; i<matModels.rows(); ++i)
+    vecLabels[i] = matModels(i,0) < 0.5 ? 0 : 1;
+
+  PiiKnnClassifier<PiiMatrix<float> > classifier;
+  classifier.setModels(matModels);
+  classifier.setClassLabels(vecLabels);
+  classifier.setK(3);
+  QVector<double> vecExact = classifier.classifyBatch(matSamples);
+
+  PiiHnswIndex<PiiMatrix<float> >* pIndex = new PiiHnswIndex<PiiMatrix<float> >;
+  pIndex->setSearchWidth(200);
+  classifier.setIndex(pIndex);
+  QVERIFY(classifier.index() == pIndex);
+  // The index is ignored until it has been built.
+  QCOMPARE(classifier.classifyBatch(matSamples), vecExact);
+  classifier.buildIndex();
+  QCOMPARE(pIndex->modelCount(), 2000);
+
+  QVector<double> vecResults = classifier.classifyBatch(matSamples);
+  int iSame = 0;
+  for (int i=0; i<matSamples.rows(); ++i)
+    {
+      QCOMPARE(classifier.classify(matSamples[i]), vecResults[i]);
+      if (vecResults[i] == vecExact[i])
+        ++iSame;
+    }
+  QVERIFY(iSame >= 195);
+
+  // Changing the models invalidates the index, and exhaustive search
+  // is used until the index has been rebuilt.
+  PiiMatrix<float> matNewModels(PiiClassification::createRandomSampleSet<PiiMatrix<float> >(2000, 4, 0, 1));
+  PiiKnnClassifier<PiiMatrix<float> > exactClassifier;
+  exactClassifier.setModels(matNewModels);
+  exactClassifier.setClassLabels(vecLabels);
+  exactClassifier.setK(3);
+  QVector<double> vecNewExact = exactClassifier.classifyBatch(matSamples);
+  classifier.setModels(matNewModels);
+  QCOMPARE(classifier.classifyBatch(matSamples), vecNewExact);
+  classifier.buildIndex();
+  classifier.modelAt(0);
+  QCOMPARE(classifier.classifyBatch(matSamples), vecNewExact);
+
+  classifier.setIndex(0);
+  QVERIFY(classifier.index() == 0);
+}
+
+void TestPiiHnswIndex::serialization()
+{
+  PiiMatrix<float> matModels(PiiClassification::createRandomSampleSet<PiiMatrix<float> >(500, 16, 0, 1));
+  PiiMatrix<float> matSamples(PiiClassification::createRandomSampleSet<PiiMatrix<float> >(20, 16, 0, 1));
+
+  for (int iSubspaces=0; iSubspaces<=4; iSubspaces += 4)
+    {
+      PiiHnswIndex<PiiMatrix<float> > index;
+      index.setQuantizerSubspaceCount(iSubspaces);
+      index.setSearchWidth(40);
+      index.buildIndex(matModels);
+      QCOMPARE(index.isCompressed(), iSubspaces != 0);
+
+      PiiHnswIndex<PiiMatrix<float> > restored;
+      try
+        {
+          QByteArray array(PiiSerialization::toByteArray<PiiTextOutputArchive>(index));
+          PiiSerialization::fromByteArray<PiiTextInputArchive>(array, restored);
+        }
+      catch (PiiSerializationException& ex)
+        {
+          QFAIL(qPrintable("Serialization error: " + ex.message() + ". Additional info: " + ex.info()));
+        }
+
+      QCOMPARE(restored.modelCount(), 500);
+      QCOMPARE(restored.searchWidth(), 40);
+      QCOMPARE(restored.quantizerSubspaceCount(), iSubspaces);
+      QCOMPARE(restored.isCompressed(), index.isCompressed());
+      for (int i=0; i<matSamples.rows(); ++i)
+        {
+          PiiClassification::MatchList lstOriginal = index.findClosestMatches(matSamples[i], 5),
+            lstRestored = restored.findClosestMatches(matSamples[i], 5);
+          QCOMPARE(lstRestored.size(), lstOriginal.size());
+          for (int j=0; j<lstOriginal.size(); ++j)
+            {
+              QCOMPARE(lstRestored[j].second, lstOriginal[j].second);
+              QCOMPARE(lstRestored[j].first, lstOriginal[j].first);
+            }
+        }
+    }
+
+  PiiProductQuantizer<PiiMatrix<float> > quantizer, restoredQuantizer;
+  quantizer.setSubspaceCount(4);
+  quantizer.train(matModels);
+  try
+    {
+      QByteArray array(PiiSerialization::toByteArray<PiiTextOutputArchive>(quantizer));
+      PiiSerialization::fromByteArray<PiiTextInputArchive>(array, restoredQuantizer);
+    }
+  catch (PiiSerializationException& ex)
+    {
+      QFAIL(qPrintable("Serialization error: " + ex.message() + ". Additional info: " + ex.info()));
+    }
+  QVERIFY(restoredQuantizer.isTrained());
+  QCOMPARE(restoredQuantizer.subspaceCount(), 4);
+  QCOMPARE(restoredQuantizer.featureCount(), 16);
+  QCOMPARE(restoredQuantizer.encode(matSamples), quantizer.encode(matSamples));
+}
+
+QTEST_MAIN(TestPiiHnswIndex)
@@ -32,6 +32,9 @@ private slots:
   void scaleNearestNeighborInterpolation();
   void scaleLinearInterpolation();
   void scaleColor();
+  void resample();
+  void pyramids();
+  void remap();
   void rotate();
   void colorChannel();
   void setColorChannel();
@@ -40,6 +43,7 @@ private slots:
   void medianFilter();
   void separateFilter();
   void filter();
+  void largeFilter();
   void intFilter();
   void maxFilter();
   void minFilter();
@@ -67,11 +71,15 @@ private slots:
   void border();
   void thin();
   void bottomHat();
+  void fastMorphology_data();
+  void fastMorphology();
   void labelImage();
   void labelLargerThan();
+  void labelObjects();
 
   // Histogram
   void equalize();
+  void equalizeAdaptive();
   void histogram();
   void cumulative();
   void normalize();
@@ -93,6 +101,9 @@ private slots:
   void crop();
   void xorMatch();
   void fastGradient();
+  void allocatorChain_data();
+  void allocatorChain();
+  void processInBands();
 
 private:
   template <class TernaryFunction, class T>
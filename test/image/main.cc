@@ -25,11 +25,16 @@
 #include <PiiMorphology.h>
 #include <PiiBoundaryFinder.h>
 #include <PiiLabeling.h>
+#include <PiiResampler.h>
+#include <PiiRemap.h>
 #include <PiiFunctional.h>
 #include <PiiObjectProperty.h>
 #include <PiiMaskGenerator.h>
 #include <PiiColor.h>
 #include <PiiImageDistortions.h>
+#include <PiiMatrixAllocator.h>
+#include <PiiInvalidArgumentException.h>
+#include <PiiTimer.h>
 
 #include <functional>
 
@@ -818,6 +823,268 @@ void TestPiiImage::scaleColor()
   QVERIFY(Pii::equals(PiiImage::scale(*pInput2, 0.5),*pResult2));
 }
 
+void TestPiiImage::resample()
+{
+  PiiMatrix<unsigned char> matImage(36,52);
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matImage(r,c) = (unsigned char)((r*17 + c*31 + r*c) & 0xff);
+
+  {
+    // Same size must not change anything with any kernel
+    for (int k=PiiResampler::AutomaticKernel; k<=PiiResampler::LanczosKernel; ++k)
+      {
+        PiiResampler resampler((PiiResampler::Kernel)k);
+        QVERIFY(Pii::equals(resampler.resample(matImage, 36, 52), matImage));
+      }
+  }
+  {
+    // Constant images stay constant in both directions
+    PiiMatrix<unsigned char> matConstant(40, 41);
+    matConstant = 77;
+    for (int k=PiiResampler::AutomaticKernel; k<=PiiResampler::LanczosKernel; ++k)
+      {
+        PiiResampler resampler((PiiResampler::Kernel)k);
+        PiiMatrix<unsigned char> matSmall(resampler.resample(matConstant, 13, 7));
+        PiiMatrix<unsigned char> matLarge(resampler.resample(matConstant, 80, 200));
+        QCOMPARE(matSmall.rows(), 13);
+        QCOMPARE(matLarge.columns(), 200);
+        unsigned char ucMin, ucMax;
+        Pii::minMax(matSmall, &ucMin, &ucMax);
+        QVERIFY(ucMin == 77 && ucMax == 77);
+        Pii::minMax(matLarge, &ucMin, &ucMax);
+        QVERIFY(ucMin == 77 && ucMax == 77);
+      }
+  }
+  {
+    // Halving with area averaging equals the mean of 2-by-2 blocks
+    PiiResampler resampler(PiiResampler::AreaKernel);
+    PiiMatrix<float> matFloat(matImage);
+    PiiMatrix<float> matHalf(resampler.resample(matFloat, 0.5));
+    QCOMPARE(matHalf.rows(), 18);
+    QCOMPARE(matHalf.columns(), 26);
+    for (int r=0; r<matHalf.rows(); ++r)
+      for (int c=0; c<matHalf.columns(); ++c)
+        QVERIFY(Pii::almostEqualRel(matHalf(r,c),
+                                    (matFloat(2*r,2*c) + matFloat(2*r,2*c+1) +
+                                     matFloat(2*r+1,2*c) + matFloat(2*r+1,2*c+1)) / 4,
+                                    1e-5f));
+    // The 8-bit version rounds to the nearest integer
+    PiiMatrix<unsigned char> matHalf8(resampler.resample(matImage, 18, 26));
+    for (int r=0; r<matHalf.rows(); ++r)
+      for (int c=0; c<matHalf.columns(); ++c)
+        QCOMPARE(int(matHalf8(r,c)), int(matHalf(r,c) + 0.5f));
+    // Tables are shared between the two calls
+    QCOMPARE(resampler.cacheSize(), 2);
+  }
+  {
+    // Colors are resampled channel by channel
+    PiiMatrix<PiiColor4<> > matColor(30,30);
+    PiiMatrix<PiiColor<> > matColor3(30,30);
+    for (int r=0; r<30; ++r)
+      for (int c=0; c<30; ++c)
+        {
+          matColor(r,c) = PiiColor4<>(r*8, c*8, 100);
+          matColor3(r,c) = PiiColor<>(r*8, c*8, 100);
+        }
+    PiiResampler resampler;
+    PiiMatrix<PiiColor4<> > matSmall(resampler.resample(matColor, 15, 15));
+    QCOMPARE(int(matSmall(3,4).c0), 52);
+    QCOMPARE(int(matSmall(3,4).c1), 68);
+    QCOMPARE(int(matSmall(3,4).c2), 100);
+    // Bicubic interpolation of a linear ramp is exact
+    PiiMatrix<PiiColor<> > matLarge(resampler.resample(matColor3, 60, 45));
+    QCOMPARE(int(matLarge(6,9).c0), 22);
+    QCOMPARE(int(matLarge(6,9).c1), 47);
+    QCOMPARE(int(matLarge(6,9).c2), 100);
+  }
+  {
+    // Lanczos overshoots; integer results must saturate.
+    PiiMatrix<unsigned char> matStep(1, 8, 0, 0, 0, 0, 255, 255, 255, 255);
+    PiiResampler resampler(PiiResampler::LanczosKernel);
+    PiiMatrix<unsigned char> matLarge(resampler.resample(matStep, 1, 32));
+    PiiMatrix<int> matLargeInt(resampler.resample(PiiMatrix<int>(matStep), 1, 32));
+    for (int c=0; c<32; ++c)
+      QCOMPARE(int(matLarge(0,c)), qBound(0, matLargeInt(0,c), 255));
+    QVERIFY(Pii::min(matLargeInt, 0, 0) < 0);
+  }
+  QVERIFY(PiiResampler().resample(PiiMatrix<float>(), 5, 4).rows() == 5);
+}
+
+void TestPiiImage::pyramids()
+{
+  PiiMatrix<unsigned char> matImage(37,53);
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matImage(r,c) = (unsigned char)((r*r + c*7) & 0xff);
+
+  PiiResampler resampler;
+  QList<PiiMatrix<unsigned char> > lstGaussian(resampler.gaussianPyramid(matImage, 10));
+  int aSizes[][2] = { {37,53}, {19,27}, {10,14}, {5,7}, {3,4}, {2,2}, {1,1} };
+  QCOMPARE(lstGaussian.size(), 7);
+  for (int i=0; i<lstGaussian.size(); ++i)
+    {
+      QCOMPARE(lstGaussian[i].rows(), aSizes[i][0]);
+      QCOMPARE(lstGaussian[i].columns(), aSizes[i][1]);
+    }
+  QVERIFY(Pii::equals(lstGaussian[0], matImage));
+  QCOMPARE(resampler.gaussianPyramid(matImage, 3).size(), 3);
+
+  // The binomial kernel preserves constant images
+  PiiMatrix<unsigned char> matConstant(16, 16);
+  matConstant = 9;
+  PiiMatrix<unsigned char> matDown(resampler.pyramidDown(matConstant));
+  PiiMatrix<unsigned char> matUp(resampler.pyramidUp(matConstant, 31, 32));
+  QCOMPARE(matDown.rows(), 8);
+  QCOMPARE(matUp.rows(), 31);
+  QCOMPARE(matUp.columns(), 32);
+  unsigned char ucMin, ucMax;
+  Pii::minMax(matDown, &ucMin, &ucMax);
+  QVERIFY(ucMin == 9 && ucMax == 9);
+  Pii::minMax(matUp, &ucMin, &ucMax);
+  QVERIFY(ucMin == 9 && ucMax == 9);
+
+  QList<PiiMatrix<float> > lstLaplacian(resampler.laplacianPyramid(matImage, 4));
+  QCOMPARE(lstLaplacian.size(), 4);
+  QCOMPARE(lstLaplacian[3].rows(), 5);
+  QVERIFY(Pii::equals(PiiMatrix<unsigned char>(lstLaplacian[3]), lstGaussian[3]));
+  PiiMatrix<float> matReconstructed(resampler.collapseLaplacianPyramid(lstLaplacian));
+  QCOMPARE(matReconstructed.rows(), matImage.rows());
+  QCOMPARE(matReconstructed.columns(), matImage.columns());
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      QVERIFY(Pii::abs(matReconstructed(r,c) - float(matImage(r,c))) < 1e-3f);
+}
+
+void TestPiiImage::remap()
+{
+  PiiMatrix<unsigned char> matImage(41,67);
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matImage(r,c) = (unsigned char)((r*r*3 + c*11) & 0xff);
+
+  // Integer coordinates copy pixels as such
+  PiiMatrix<PiiPoint<int> > matIdentity(matImage.rows(), matImage.columns());
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matIdentity(r,c) = PiiPoint<int>(c,r);
+  PiiRemap identity(matIdentity, matImage.rows(), matImage.columns());
+  QCOMPARE(identity.rows(), matImage.rows());
+  QCOMPARE(identity.columns(), matImage.columns());
+  QVERIFY(Pii::equals(identity.apply(matImage), matImage));
+
+  // Fractional shift. Points outside of the image are background.
+  PiiMatrix<PiiPoint<double> > matShift(30,70);
+  for (int r=0; r<matShift.rows(); ++r)
+    for (int c=0; c<matShift.columns(); ++c)
+      matShift(r,c) = PiiPoint<double>(c + 0.3, r * 1.25 + 0.6);
+  PiiRemap shift(matShift, matImage.rows(), matImage.columns());
+  PiiMatrix<unsigned char> matShifted(shift.apply(matImage, (unsigned char)7));
+  PiiMatrix<float> matFloatShifted(shift.apply(PiiMatrix<float>(matImage), 7.0f));
+  PiiMatrix<unsigned char> matReference(PiiImage::remap(matImage, matShift));
+  for (int r=0; r<matShift.rows(); ++r)
+    for (int c=0; c<matShift.columns(); ++c)
+      {
+        if (c >= matImage.columns() - 1)
+          {
+            QCOMPARE(int(matShifted(r,c)), 7);
+            QCOMPARE(matFloatShifted(r,c), 7.0f);
+          }
+        else
+          {
+            QVERIFY(Pii::abs(int(matShifted(r,c)) - int(matReference(r,c))) <= 1);
+            QVERIFY(Pii::abs(matFloatShifted(r,c) - float(matShifted(r,c))) <= 1);
+          }
+      }
+
+  // The last row and column can be sampled, but nothing beyond them.
+  PiiMatrix<float> matOnes(4,5);
+  for (int r=0; r<matOnes.rows(); ++r)
+    for (int c=0; c<matOnes.columns(); ++c)
+      matOnes(r,c) = 1.0f;
+  PiiMatrix<PiiPoint<double> > matEdges(1,5);
+  matEdges(0,0) = PiiPoint<double>(4, 3);
+  matEdges(0,1) = PiiPoint<double>(4, 1.5);
+  matEdges(0,2) = PiiPoint<double>(2.5, 3);
+  matEdges(0,3) = PiiPoint<double>(4.5, 3.5);
+  matEdges(0,4) = PiiPoint<double>(4.5, 1);
+  PiiMatrix<float> matEdgeValues(PiiImage::remap(matOnes, matEdges));
+  QCOMPARE(matEdgeValues(0,0), 1.0f);
+  QCOMPARE(matEdgeValues(0,1), 1.0f);
+  QCOMPARE(matEdgeValues(0,2), 1.0f);
+  QCOMPARE(matEdgeValues(0,3), 0.0f);
+  QCOMPARE(matEdgeValues(0,4), 0.0f);
+
+  // Background pixels scattered along rows
+  PiiMatrix<PiiPoint<double> > matHoles(matShift);
+  for (int r=0; r<matHoles.rows(); ++r)
+    for (int c=r % 5; c<matHoles.columns(); c += 9)
+      matHoles(r,c) = PiiPoint<double>(-5, -5);
+  PiiRemap holes(matHoles, matImage.rows(), matImage.columns());
+  PiiMatrix<unsigned char> matHoled(holes.apply(matImage, (unsigned char)7));
+  for (int r=0; r<matHoles.rows(); ++r)
+    for (int c=0; c<matHoles.columns(); ++c)
+      {
+        if (matHoles(r,c).x < 0)
+          QCOMPARE(int(matHoled(r,c)), 7);
+        else
+          QCOMPARE(matHoled(r,c), matShifted(r,c));
+      }
+
+  // Four-channel colors are interpolated channel by channel
+  PiiMatrix<PiiColor4<> > matColor(matImage.rows(), matImage.columns());
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matColor(r,c) = PiiColor4<>(matImage(r,c), 255 - matImage(r,c), 40, 0);
+  PiiMatrix<PiiColor4<> > matColorShifted(shift.apply(matColor));
+  for (int r=0; r<matShift.rows(); ++r)
+    for (int c=0; c<matImage.columns() - 1; ++c)
+      {
+        QCOMPARE(matColorShifted(r,c).c0, matShifted(r,c));
+        QVERIFY(Pii::abs(int(matColorShifted(r,c).c1) - (255 - int(matShifted(r,c)))) <= 1);
+        QCOMPARE(int(matColorShifted(r,c).c2), 40);
+      }
+
+  // A compiled rotation is close to the exact one
+  PiiMatrix<float> matRotation(PiiImage::createRotationTransform(0.3f,
+                                                                 matImage.columns()/2.0,
+                                                                 matImage.rows()/2.0));
+  PiiRemap rotation(PiiRemap::transform(matRotation, matImage.rows(), matImage.columns()));
+  PiiMatrix<unsigned char> matRotated(rotation.apply(matImage));
+  PiiMatrix<unsigned char> matExact(PiiImage::transform(matImage, matRotation));
+  QCOMPARE(matRotated.rows(), matExact.rows());
+  QCOMPARE(matRotated.columns(), matExact.columns());
+  double dError = 0;
+  for (int r=0; r<matExact.rows(); ++r)
+    for (int c=0; c<matExact.columns(); ++c)
+      dError += Pii::abs(int(matRotated(r,c)) - int(matExact(r,c)));
+  QVERIFY(dError / (matExact.rows() * matExact.columns()) < 1);
+
+  // Parallel bands produce the same result
+  QVERIFY(Pii::equals(rotation.apply(matImage, (unsigned char)0, 3), matRotated));
+
+  // Size mismatch
+  QVERIFY(rotation.apply(PiiMatrix<unsigned char>(10,10)).isEmpty());
+  QVERIFY(PiiRemap().isEmpty());
+
+  // Source positions are packed into 16 bits
+  QVERIFY(PiiRemap::supportsSourceSize(65535, 65535));
+  QVERIFY(!PiiRemap::supportsSourceSize(65536, 10));
+  QVERIFY(!PiiRemap::supportsSourceSize(10, 65536));
+  try
+    {
+      PiiRemap tooLarge(PiiMatrix<PiiPoint<double> >(1, 1), 10, 70000);
+      QFAIL("Compiling a map for a too large source should fail.");
+    }
+  catch (PiiInvalidArgumentException&) {}
+  try
+    {
+      PiiRemap::transform(matRotation, 70000, 10);
+      QFAIL("Compiling a transform for a too large source should fail.");
+    }
+  catch (PiiInvalidArgumentException&) {}
+}
+
 void TestPiiImage::rotate()
 {
   PiiMatrix<int> mat(3,3,
@@ -1176,6 +1443,26 @@ void TestPiiImage::medianFilter()
   QCOMPARE(matClrOut(1, 0), PiiColor<>(3, 4, 5));
   QCOMPARE(matClrOut(1, 1), PiiColor<>(4, 5, 6));
   QCOMPARE(matClrOut(1, 2), PiiColor<>(5, 6, 7));
+
+  // The histogram-based versions for 8-bit and 16-bit images must
+  // match the generic one.
+  PiiMatrix<int> matNoise(37, 45);
+  for (int r=0; r<matNoise.rows(); ++r)
+    for (int c=0; c<matNoise.columns(); ++c)
+      matNoise(r,c) = ((r * 131 + c * 71) ^ (r * c * 13)) & 0xff;
+  PiiMatrix<unsigned char> matNoise8(matNoise);
+  PiiMatrix<unsigned short> matNoise16(matNoise * 200);
+  const int aWindows[][2] = { { 5, 5 }, { 7, 7 }, { 4, 9 }, { 15, 15 } };
+  for (int i=0; i<4; ++i)
+    {
+      const int iRows = aWindows[i][0], iColumns = aWindows[i][1];
+      PiiMatrix<int> matExpected(PiiImage::medianFilter(matNoise, iRows, iColumns));
+      QVERIFY(Pii::equals(PiiMatrix<int>(PiiImage::medianFilter(matNoise8, iRows, iColumns)),
+                          matExpected));
+      QVERIFY(Pii::equals(PiiMatrix<int>(PiiImage::medianFilter(matNoise16, iRows, iColumns,
+                                                                Pii::ExtendReplicate)),
+                          PiiImage::medianFilter(matNoise, iRows, iColumns, Pii::ExtendReplicate) * 200));
+    }
 }
 
 void TestPiiImage::backProject()
@@ -1240,6 +1527,48 @@ void TestPiiImage::equalize()
                                                                 24,24,24,24,
                                                                 31,31,31,31)));
 }
+void TestPiiImage::equalizeAdaptive()
+{
+  // A constant image maps to a constant
+  PiiMatrix<unsigned char> matConstant(50, 50);
+  matConstant = 100;
+  unsigned char ucMin, ucMax;
+  Pii::minMax(PiiImage::equalizeAdaptive(matConstant, 4, 4, 2.0, 256), &ucMin, &ucMax);
+  QCOMPARE(ucMin, ucMax);
+  Pii::minMax(PiiImage::equalizeAdaptive(matConstant, 4, 4, 0.0, 256), &ucMin, &ucMax);
+  QCOMPARE(int(ucMin), 255);
+  QCOMPARE(int(ucMax), 255);
+
+  // A single tile without clipping equals global equalization
+  PiiMatrix<int> img(4,4,
+                     0,0,0,0,
+                     1,1,1,1,
+                     2,2,2,2,
+                     3,3,3,3);
+  QVERIFY(Pii::equals(PiiImage::equalizeAdaptive(img, 1, 1, 0.0, 4), PiiMatrix<int>(4,4,
+                                                                                   1,1,1,1,
+                                                                                   2,2,2,2,
+                                                                                   2,2,2,2,
+                                                                                   3,3,3,3)));
+
+  // Clipping limits the contrast gain of a low-contrast image
+  PiiMatrix<unsigned char> matRamp(60, 90);
+  for (int r=0; r<matRamp.rows(); ++r)
+    for (int c=0; c<matRamp.columns(); ++c)
+      matRamp(r,c) = (unsigned char)(60 + c/6 + r/20);
+  PiiMatrix<unsigned char> matEqualized(PiiImage::equalizeAdaptive(matRamp, 3, 3, 0.0, 256));
+  QCOMPARE(matEqualized.rows(), matRamp.rows());
+  QCOMPARE(matEqualized.columns(), matRamp.columns());
+  Pii::minMax(matEqualized, &ucMin, &ucMax);
+  const int iFullRange = ucMax - ucMin;
+  QVERIFY(iFullRange > 10 * (matRamp(59,89) - matRamp(0,0)));
+  Pii::minMax(PiiImage::equalizeAdaptive(matRamp, 3, 3, 3.0, 256), &ucMin, &ucMax);
+  QVERIFY(ucMax - ucMin < iFullRange / 2);
+
+  // Too many tiles
+  QCOMPARE(PiiImage::equalizeAdaptive(matRamp, 1000, 1000).columns(), 90);
+}
+
 void TestPiiImage::histogram()
 {
   //Testing basic functionality of PiiHistogram-class
@@ -1260,6 +1589,24 @@ void TestPiiImage::histogram()
         }
     }
 
+  // Banked and parallel counting with a mask
+  PiiMatrix<unsigned char> matNoise(123, 457);
+  PiiMatrix<bool> matMask(123, 457);
+  PiiMatrix<int> matExpected(1, 256), matExpectedMasked(1, 256);
+  for (int r=0; r<matNoise.rows(); ++r)
+    for (int c=0; c<matNoise.columns(); ++c)
+      {
+        matNoise(r,c) = (unsigned char)((r * 31 + c * c) % 251);
+        matMask(r,c) = (r + c) % 3 == 0;
+        ++matExpected(0, matNoise(r,c));
+        if (matMask(r,c))
+          ++matExpectedMasked(0, matNoise(r,c));
+      }
+  QVERIFY(Pii::equals(PiiImage::histogram(matNoise, 256), matExpected));
+  QVERIFY(Pii::equals(PiiImage::histogram(matNoise, matMask, 256), matExpectedMasked));
+  QVERIFY(Pii::equals(PiiImage::histogram(matNoise, matMask, 256, 3), matExpectedMasked));
+  QVERIFY(Pii::equals(PiiImage::histogram(matNoise, PiiImage::DefaultRoi(), 256, 4), matExpected));
+  QVERIFY(Pii::equals(PiiImage::histogram(matNoise, 100), matExpected(0,0,1,100)));
 
 }
 void TestPiiImage::cumulative()
@@ -1354,6 +1701,93 @@ void TestPiiImage::hitAndMiss()
 
 }
 
+// Brute-force references for erode() and dilate(). Pixels outside
+// of the image are zeros.
+static PiiMatrix<int> referenceErode(const PiiMatrix<int>& image, const PiiMatrix<int>& mask)
+{
+  const int iRows = image.rows(), iCols = image.columns();
+  const int iMaskRows = mask.rows(), iMaskCols = mask.columns();
+  PiiMatrix<int> matResult(iRows, iCols);
+  for (int r=0; r<=iRows-iMaskRows; ++r)
+    for (int c=0; c<=iCols-iMaskCols; ++c)
+      {
+        bool bFits = true;
+        for (int mr=0; mr<iMaskRows && bFits; ++mr)
+          for (int mc=0; mc<iMaskCols; ++mc)
+            if (mask(mr,mc) && !image(r+mr,c+mc))
+              {
+                bFits = false;
+                break;
+              }
+        matResult(r + iMaskRows/2, c + iMaskCols/2) = bFits ? 1 : 0;
+      }
+  return matResult;
+}
+
+static PiiMatrix<int> referenceDilate(const PiiMatrix<int>& image, const PiiMatrix<int>& mask)
+{
+  const int iRows = image.rows(), iCols = image.columns();
+  const int iMaskRows = mask.rows(), iMaskCols = mask.columns();
+  PiiMatrix<int> matResult(iRows, iCols);
+  for (int r=0; r<iRows; ++r)
+    for (int c=0; c<iCols; ++c)
+      if (image(r,c))
+        for (int mr=0; mr<iMaskRows; ++mr)
+          for (int mc=0; mc<iMaskCols; ++mc)
+            {
+              const int iRow = r - iMaskRows/2 + mr, iCol = c - iMaskCols/2 + mc;
+              if (mask(mr,mc) && iRow >= 0 && iRow < iRows && iCol >= 0 && iCol < iCols)
+                matResult(iRow, iCol) = 1;
+            }
+  return matResult;
+}
+
+void TestPiiImage::fastMorphology_data()
+{
+  QTest::addColumn<int>("maskType");
+  QTest::addColumn<int>("maskRows");
+  QTest::addColumn<int>("maskColumns");
+
+  QTest::newRow("rectangle 3x3") << int(PiiImage::RectangularMask) << 3 << 3;
+  QTest::newRow("rectangle 4x6") << int(PiiImage::RectangularMask) << 4 << 6;
+  QTest::newRow("horizontal line") << int(PiiImage::RectangularMask) << 1 << 70;
+  QTest::newRow("vertical line") << int(PiiImage::RectangularMask) << 9 << 1;
+  QTest::newRow("disk 15x15") << int(PiiImage::EllipticalMask) << 15 << 15;
+  QTest::newRow("ellipse 6x11") << int(PiiImage::EllipticalMask) << 6 << 11;
+  QTest::newRow("diamond 7x7") << int(PiiImage::DiamondMask) << 7 << 7;
+}
+
+void TestPiiImage::fastMorphology()
+{
+  QFETCH(int, maskType);
+  QFETCH(int, maskRows);
+  QFETCH(int, maskColumns);
+
+  PiiMatrix<int> matMask(PiiImage::createMask(PiiImage::MaskType(maskType), maskRows, maskColumns));
+  // Widths below, at and above word boundaries of the packed image.
+  const int aWidths[] = { 75, 128, 131 };
+  for (int i=0; i<3; ++i)
+    {
+      PiiMatrix<int> matImage(40, aWidths[i]);
+      for (int r=0; r<matImage.rows(); ++r)
+        for (int c=0; c<matImage.columns(); ++c)
+          matImage(r,c) = ((r * 7 + c * 13) ^ (r * c)) % 5 != 0 ? 1 : 0;
+
+      QVERIFY(Pii::equals(PiiImage::erode(matImage, matMask), referenceErode(matImage, matMask)));
+      QVERIFY(Pii::equals(PiiImage::dilate(matImage, matMask), referenceDilate(matImage, matMask)));
+    }
+
+  PiiMatrix<unsigned char> matLarge(1024, 1280);
+  for (int r=0; r<matLarge.rows(); ++r)
+    for (int c=0; c<matLarge.columns(); ++c)
+      matLarge(r,c) = uchar(((r * 7 + c * 13) ^ (r * c)) % 5 != 0);
+  PiiTimer timer;
+  PiiMatrix<unsigned char> matOpened(PiiImage::open(matLarge, matMask));
+  qDebug("%s: opening a 1280x1024 image takes %.2f ms",
+         QTest::currentDataTag(), timer.milliseconds());
+  QCOMPARE(matOpened.rows(), matLarge.rows());
+}
+
 void TestPiiImage::labelImage()
 {
   PiiMatrix<int> mat(8,8,
@@ -1595,6 +2029,58 @@ void TestPiiImage::labelLargerThan()
                                      1,1,0,0,0)));
 }
 
+void TestPiiImage::labelObjects()
+{
+  PiiMatrix<int> mat(8,8,
+                     1,1,1,0,0,0,0,0,
+                     0,1,0,1,1,1,0,1,
+                     0,1,0,1,0,1,0,1,
+                     0,0,1,1,0,1,1,1,
+                     0,1,1,0,1,0,0,1,
+                     0,0,1,0,0,0,1,1,
+                     0,0,1,1,1,1,0,0,
+                     1,0,0,0,0,5,5,5);
+  std::binder2nd<std::greater<int> > rule(std::greater<int>(), 0);
+
+  // The result must not depend on the number of strips
+  for (int iStrips=1; iStrips<=8; ++iStrips)
+    {
+      int iCount = 0;
+      PiiImage::ObjectProperties properties;
+      PiiMatrix<int> matLabels(PiiImage::labelObjects(mat, rule, rule, PiiImage::Connect4,
+                                                      iStrips, &properties, &iCount));
+      QVERIFY(Pii::equals(matLabels, PiiImage::labelImage(mat)));
+      QCOMPARE(iCount, 4);
+
+      PiiMatrix<int> matAreas, matCentroids, matBoxes;
+      PiiImage::calculateProperties(matLabels, iCount, matAreas, matCentroids, matBoxes);
+      QVERIFY(Pii::equals(properties.areas, matAreas));
+      QVERIFY(Pii::equals(properties.centroids, matCentroids));
+      QVERIFY(Pii::equals(properties.boundingBoxes, matBoxes));
+      // Object 4 is a single pixel, object 3 as well.
+      QCOMPARE(properties.moments(3,0), 0.0);
+      QCOMPARE(properties.moments(2,2), 0.0);
+
+      // With 8-connectivity, everything but the lone pixel at the
+      // bottom-left corner is one object.
+      matLabels = PiiImage::labelObjects(mat, rule, rule, PiiImage::Connect8,
+                                         iStrips, &properties, &iCount);
+      QCOMPARE(iCount, 2);
+      QCOMPARE(properties.areas(0,0), 31);
+      QCOMPARE(properties.areas(1,0), 1);
+      QCOMPARE(matLabels(7,0), 2);
+
+      // Hysteresis: only the object with a pixel brighter than 4 is
+      // retained.
+      matLabels = PiiImage::labelObjects(mat, rule, std::bind2nd(std::greater<int>(), 4),
+                                         PiiImage::Connect4, iStrips, &properties, &iCount);
+      QCOMPARE(iCount, 1);
+      QCOMPARE(properties.areas(0,0), 25);
+      QCOMPARE(matLabels(0,0), 0);
+      QCOMPARE(matLabels(1,3), 1);
+    }
+}
+
 void TestPiiImage::thin()
 {
   PiiMatrix<int> source(6,6,
@@ -2177,6 +2663,31 @@ void TestPiiImage::filter()
   }
 }
 
+void TestPiiImage::largeFilter()
+{
+  // Large floating-point filters are applied in the frequency
+  // domain. The result must not differ from direct integer filtering
+  // on any border handling mode.
+  PiiMatrix<int> input(40,37);
+  for (int r=0; r<input.rows(); ++r)
+    for (int c=0; c<input.columns(); ++c)
+      input(r,c) = (r*7 + c*13) % 23;
+  PiiMatrix<int> filter(21,20);
+  for (int r=0; r<filter.rows(); ++r)
+    for (int c=0; c<filter.columns(); ++c)
+      filter(r,c) = (r + 2*c) % 5 - 2;
+
+  Pii::ExtendMode modes[] = { Pii::ExtendZeros, Pii::ExtendReplicate, Pii::ExtendSymmetric, Pii::ExtendPeriodic };
+  for (int i=0; i<4; ++i)
+    {
+      PiiMatrix<int> matDirect(PiiImage::filter<int>(input, filter, modes[i]));
+      PiiMatrix<double> matFft(PiiImage::filter<double>(input, PiiMatrix<double>(filter), modes[i]));
+      QCOMPARE(matFft.rows(), matDirect.rows());
+      QCOMPARE(matFft.columns(), matDirect.columns());
+      QVERIFY(Pii::equals(Pii::round<int>(matFft), matDirect));
+    }
+}
+
 void TestPiiImage::intFilter()
 {
   PiiMatrix<double> filter(PiiImage::makeFilter<double>(PiiImage::GaussianFilter, 3));
@@ -2359,4 +2870,95 @@ void TestPiiImage::fastGradient()
   }
 }
 
+void TestPiiImage::allocatorChain_data()
+{
+  QTest::addColumn<bool>("pooling");
+  QTest::newRow("malloc") << false;
+  QTest::newRow("pooled") << true;
+}
+
+/* Emulates a camera -> filter -> threshold -> labeling pipeline and
+ * reports the time per frame and the number of allocations the
+ * matrix allocator had to pass to the system.
+ */
+void TestPiiImage::allocatorChain()
+{
+  QFETCH(bool, pooling);
+  const int iFrameCount = 50;
+
+  PiiMatrix<unsigned char> matSource(1024, 1280);
+  for (int r=0; r<matSource.rows(); ++r)
+    for (int c=0; c<matSource.columns(); ++c)
+      matSource(r,c) = uchar((r ^ c) * 37);
+
+  PiiMatrixAllocator::setPoolingEnabled(pooling);
+  PiiMatrixAllocator::resetStatistics();
+  PiiTimer timer;
+  for (int i=0; i<iFrameCount; ++i)
+    {
+      // Detaching allocates a new frame, like a camera would.
+      PiiMatrix<unsigned char> matFrame(matSource);
+      matFrame(0,0) = uchar(i);
+      PiiMatrix<int> matFiltered(PiiImage::filter<int>(matFrame, PiiImage::SobelXFilter));
+      PiiMatrix<int> matBinary(PiiImage::threshold(matFiltered, 0));
+      int iLabelCount = 0;
+      PiiMatrix<int> matLabels(PiiImage::labelImage(matBinary, &iLabelCount));
+      QVERIFY(iLabelCount > 0);
+    }
+  const double dMsPerFrame = timer.milliseconds() / double(iFrameCount);
+  PiiMatrixAllocator::Statistics stats = PiiMatrixAllocator::statistics();
+  PiiMatrixAllocator::setPoolingEnabled(true);
+
+  qDebug("%s: %.2f ms/frame, %d allocations, %d from system",
+         QTest::currentDataTag(), dMsPerFrame,
+         stats.iAllocations, stats.iSystemAllocations);
+  if (pooling)
+    QVERIFY(stats.iSystemAllocations < stats.iAllocations / 2);
+  else
+    QCOMPARE(stats.iSystemAllocations, stats.iAllocations);
+}
+
+namespace
+{
+  struct BandFilter
+  {
+    PiiMatrix<int> operator() (const PiiMatrix<uchar>& band) const
+    {
+      return PiiImage::filter<int>(band, PiiImage::makeFilter<int>(PiiImage::UniformFilter, 7),
+                                   Pii::ExtendSymmetric);
+    }
+  };
+
+  struct BandOpen
+  {
+    PiiMatrix<uchar> operator() (const PiiMatrix<uchar>& band) const
+    {
+      return PiiImage::open(band, PiiImage::createMask(PiiImage::EllipticalMask, 5, 5));
+    }
+  };
+}
+
+void TestPiiImage::processInBands()
+{
+  PiiMatrix<uchar> matImage(PiiMatrix<uchar>::uninitialized(517, 300));
+  for (int r=0; r<matImage.rows(); ++r)
+    for (int c=0; c<matImage.columns(); ++c)
+      matImage(r,c) = uchar((r * 7 + c * 13 + r * c) % 251);
+
+  // Bands must give the same result as processing the whole image,
+  // no matter how many of them there are.
+  PiiMatrix<int> matFiltered(BandFilter()(matImage));
+  for (int iThreads=0; iThreads<=5; ++iThreads)
+    QVERIFY(Pii::equals(PiiImage::processInBands<int>(matImage, 3, iThreads, BandFilter()), matFiltered));
+
+  PiiMatrix<uchar> matBinary(PiiImage::threshold(matImage, uchar(128)));
+  PiiMatrix<uchar> matOpened(BandOpen()(matBinary));
+  QVERIFY(Pii::equals(PiiImage::processInBands<uchar>(matBinary, 5, 4, BandOpen()), matOpened));
+
+  // Too small to split
+  PiiMatrix<uchar> matSmall(matImage(0,0,20,20));
+  QVERIFY(Pii::equals(PiiImage::processInBands<int>(matSmall, 3, 4, BandFilter()),
+                      BandFilter()(matSmall)));
+}
+
 QTEST_MAIN(TestPiiImage)
@@ -27,6 +27,9 @@ private slots:
   void initTestCase();
   void findClosestMatch();
   void findClosestMatches();
+  void bucketSize();
+  void findClosestMatchBatch();
+  void findClosestMatchesBatch();
   void cleanupTestCase();
 
 private:
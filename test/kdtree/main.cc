@@ -17,6 +17,7 @@
 #include "TestPiiKdTree.h"
 
 #include <QtTest>
+#include <PiiSquaredGeometricDistance.h>
 
 void TestPiiKdTree::initTestCase()
 {
@@ -74,6 +75,101 @@ void TestPiiKdTree::findClosestMatches()
     }
 }
 
+void TestPiiKdTree::bucketSize()
+{
+  PiiMatrix<int> matModels(20, 1);
+  for (int i=0; i<20; ++i)
+    matModels(i,0) = i % 5;
+
+  // Equally close models must be found in the order of their indices
+  // regardless of the structure of the tree.
+  for (int iBucketSize=1; iBucketSize<=20; iBucketSize += 3)
+    {
+      PiiKdTree<PiiMatrix<int> > tree;
+      tree.setBucketSize(iBucketSize);
+      tree.buildTree(matModels);
+      QCOMPARE(tree.bucketSize(), iBucketSize);
+
+      int aSample[] = { 2 };
+      double dDistance = -1;
+      QCOMPARE(tree.findClosestMatch(aSample, &dDistance), 2);
+      QCOMPARE(dDistance, 0.0);
+      PiiClassification::MatchList lstMatches = tree.findClosestMatches(aSample, 6);
+      QCOMPARE(lstMatches.size(), 6);
+      int aExpected[] = { 2, 7, 12, 17, 1, 3 };
+      for (int i=0; i<6; ++i)
+        QCOMPARE(lstMatches[i].second, aExpected[i]);
+    }
+}
+
+void TestPiiKdTree::findClosestMatchBatch()
+{
+  PiiMatrix<float> matModels(PiiClassification::createRandomSampleSet<PiiMatrix<float> >(2000, 4, 0, 1));
+  PiiMatrix<float> matSamples(PiiClassification::createRandomSampleSet<PiiMatrix<float> >(300, 4, 0, 1));
+  PiiKdTree<PiiMatrix<float> > tree(matModels);
+  PiiSquaredGeometricDistance<const float*> measure;
+
+  QVector<double> vecDistances;
+  QVector<int> vecIndices(tree.findClosestMatchBatch(matSamples, &vecDistances));
+  QCOMPARE(vecIndices.size(), matSamples.rows());
+  QCOMPARE(vecDistances.size(), matSamples.rows());
+  for (int i=0; i<matSamples.rows(); ++i)
+    {
+      double dDistance;
+      int iIndex = PiiClassification::findClosestMatch(matSamples[i], matModels, measure, &dDistance);
+      QCOMPARE(vecIndices[i], iIndex);
+      QCOMPARE(vecDistances[i], dDistance);
+      QCOMPARE(tree.findClosestMatch(matSamples[i]), iIndex);
+    }
+
+  // Unlimited approximate search is exact.
+  QCOMPARE(tree.findClosestMatchBatch(matSamples, 0, matModels.rows()), vecIndices);
+
+  // Limited search compares at most a bucket more than requested.
+  vecIndices = tree.findClosestMatchBatch(matSamples, &vecDistances, 20);
+  for (int i=0; i<matSamples.rows(); ++i)
+    {
+      QCOMPARE(vecIndices[i], tree.findClosestMatch(matSamples[i], 20));
+      QVERIFY(vecIndices[i] >= 0);
+      QCOMPARE(vecDistances[i], measure(matSamples[i], matModels[vecIndices[i]], 4));
+    }
+
+  PiiKdTree<PiiMatrix<float> > emptyTree;
+  vecIndices = emptyTree.findClosestMatchBatch(matSamples, &vecDistances);
+  QCOMPARE(vecIndices, QVector<int>(matSamples.rows(), -1));
+}
+
+void TestPiiKdTree::findClosestMatchesBatch()
+{
+  PiiMatrix<double> matModels(PiiClassification::createRandomSampleSet<PiiMatrix<double> >(1500, 3, 0, 1));
+  PiiMatrix<double> matSamples(PiiClassification::createRandomSampleSet<PiiMatrix<double> >(200, 3, 0, 1));
+  PiiSquaredGeometricDistance<const double*> measure;
+
+  for (int iBucketSize=1; iBucketSize<=32; iBucketSize *= 4)
+    {
+      PiiKdTree<PiiMatrix<double> > tree;
+      tree.setBucketSize(iBucketSize);
+      tree.buildTree(matModels);
+
+      QList<PiiClassification::MatchList> lstMatches = tree.findClosestMatchesBatch(matSamples, 5);
+      QList<PiiClassification::MatchList> lstApproximate = tree.findClosestMatchesBatch(matSamples, 5, 40);
+      QCOMPARE(lstMatches.size(), matSamples.rows());
+      QCOMPARE(lstApproximate.size(), matSamples.rows());
+      for (int i=0; i<matSamples.rows(); ++i)
+        {
+          PiiClassification::MatchList lstExpected =
+            PiiClassification::findClosestMatches(matSamples[i], matModels, measure, 5);
+          PiiClassification::MatchList lstApproximateSingle = tree.findClosestMatches(matSamples[i], 5, 40);
+          QCOMPARE(lstMatches[i].size(), 5);
+          for (int j=0; j<5; ++j)
+            {
+              QCOMPARE(lstMatches[i][j].second, lstExpected[j].second);
+              QCOMPARE(lstApproximate[i][j], lstApproximateSingle[j]);
+            }
+        }
+    }
+}
+
 void TestPiiKdTree::cleanupTestCase()
 {
   delete _pTree;
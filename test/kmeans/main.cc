@@ -0,0 +1,244 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "TestPiiKMeans.h"
+
+#include <QtTest>
+#include <PiiKMeans.h>
+#include <PiiRandom.h>
+#include <PiiSquaredGeometricDistance.h>
+
+// Four blobs centered at (+-10, +-10)
+static PiiMatrix<double> createBlobs(int samplesPerBlob)
+{
+  PiiMatrix<double> matSamples(4 * samplesPerBlob, 2);
+  for (int i=0; i<matSamples.rows(); ++i)
+    {
+      const int iBlob = i % 4;
+      matSamples(i,0) = (iBlob & 1 ? 10 : -10) + Pii::normalRandom();
+      matSamples(i,1) = (iBlob & 2 ? 10 : -10) + Pii::normalRandom();
+    }
+  return matSamples;
+}
+
+static bool isCloseToBlob(const double* centroid, double maxDistance)
+{
+  return qAbs(qAbs(centroid[0]) - 10) < maxDistance && qAbs(qAbs(centroid[1]) - 10) < maxDistance;
+}
+
+void TestPiiKMeans::cluster()
+{
+  Pii::seedRandom(1);
+  PiiMatrix<double> matSamples(createBlobs(50));
+  PiiKMeans<PiiMatrix<double> > kMeans;
+  QCOMPARE(kMeans.seedingMethod(), PiiClassification::KMeansPlusPlusSeeding);
+
+  PiiMatrix<double> matCentroids(kMeans.cluster(matSamples, 4));
+  QCOMPARE(matCentroids.rows(), 4);
+  QCOMPARE(matCentroids.columns(), 2);
+  QVERIFY(kMeans.iterationCount() > 0);
+
+  QVector<int> vecAssignments(kMeans.assignments());
+  QCOMPARE(vecAssignments.size(), matSamples.rows());
+  double dInertia = 0;
+  for (int i=0; i<matSamples.rows(); ++i)
+    {
+      // All samples in a blob belong to the same cluster.
+      QCOMPARE(vecAssignments[i], vecAssignments[i % 4]);
+      dInertia += PiiSquaredGeometricDistance<const double*>()(matSamples[i], matCentroids[vecAssignments[i]], 2);
+    }
+  QVERIFY(qAbs(kMeans.inertia() - dInertia) < 1e-6);
+  for (int c=0; c<4; ++c)
+    {
+      QVERIFY(isCloseToBlob(matCentroids[c], 0.5));
+      for (int c2=0; c2<c; ++c2)
+        QVERIFY(vecAssignments[c] != vecAssignments[c2]);
+    }
+}
+
+void TestPiiKMeans::lloydEquivalence()
+{
+  Pii::seedRandom(2);
+  PiiMatrix<double> matSamples(Pii::uniformRandomMatrix(500, 3));
+  PiiMatrix<double> matInitial(8, 3);
+  for (int i=0; i<8; ++i)
+    for (int f=0; f<3; ++f)
+      matInitial(i,f) = matSamples(i,f);
+
+  // Plain Lloyd's algorithm
+  PiiMatrix<double> matCentroids(matInitial);
+  QVector<int> vecAssignments(matSamples.rows(), -1);
+  for (bool bChanged = true; bChanged; )
+    {
+      bChanged = false;
+      for (int i=0; i<matSamples.rows(); ++i)
+        {
+          int iClosest = PiiClassification::findClosestMatch(matSamples[i], matCentroids,
+                                                             PiiSquaredGeometricDistance<const double*>());
+          if (iClosest != vecAssignments[i])
+            {
+              vecAssignments[i] = iClosest;
+              bChanged = true;
+            }
+        }
+      PiiMatrix<double> matSums(8, 3);
+      QVector<int> vecCounts(8);
+      for (int i=0; i<matSamples.rows(); ++i)
+        {
+          for (int f=0; f<3; ++f)
+            matSums(vecAssignments[i], f) += matSamples(i,f);
+          ++vecCounts[vecAssignments[i]];
+        }
+      for (int c=0; c<8; ++c)
+        if (vecCounts[c] > 0)
+          for (int f=0; f<3; ++f)
+            matCentroids(c,f) = matSums(c,f) / vecCounts[c];
+    }
+
+  // Hamerly's bounds must not change the result.
+  PiiKMeans<PiiMatrix<double> > kMeans;
+  PiiMatrix<double> matResult(kMeans.cluster(matSamples, matInitial));
+  QVERIFY(kMeans.assignments() == vecAssignments);
+  QCOMPARE(matResult.rows(), 8);
+  for (int c=0; c<8; ++c)
+    for (int f=0; f<3; ++f)
+      QVERIFY(qAbs(matResult(c,f) - matCentroids(c,f)) < 1e-9);
+}
+
+void TestPiiKMeans::ties()
+{
+  // In the second round, sample 1 is equally far from both
+  // centroids. It must go to the first one, as in Lloyd's algorithm.
+  PiiMatrix<double> matSamples(4,1, 0.0, 1.0, 2.0, 3.0);
+  PiiKMeans<PiiMatrix<double> > kMeans;
+  PiiMatrix<double> matCentroids(kMeans.cluster(matSamples, PiiMatrix<double>(2,1, 0.0, 1.0)));
+  QCOMPARE(matCentroids(0,0), 0.5);
+  QCOMPARE(matCentroids(1,0), 2.5);
+  QVERIFY(kMeans.assignments() == QVector<int>() << 0 << 0 << 1 << 1);
+  QCOMPARE(kMeans.inertia(), 1.0);
+}
+
+void TestPiiKMeans::finalAssignments()
+{
+  Pii::seedRandom(6);
+  PiiMatrix<double> matSamples(Pii::uniformRandomMatrix(2000, 2));
+  PiiKMeans<PiiMatrix<double> > kMeans;
+  for (int iMode=0; iMode<2; ++iMode)
+    {
+      // Batch mode stopped before convergence and mini-batch mode
+      if (iMode == 0)
+        kMeans.setMaxIterations(2);
+      else
+        {
+          kMeans.setBatchSize(100);
+          kMeans.setMaxIterations(10);
+        }
+      PiiMatrix<double> matCentroids(kMeans.cluster(matSamples, 10));
+      QVector<int> vecAssignments(kMeans.assignments());
+      QCOMPARE(vecAssignments.size(), matSamples.rows());
+      double dInertia = 0;
+      for (int i=0; i<matSamples.rows(); ++i)
+        {
+          double dDistance = 0;
+          QCOMPARE(vecAssignments[i],
+                   PiiClassification::findClosestMatch(matSamples[i], matCentroids,
+                                                       PiiSquaredGeometricDistance<const double*>(),
+                                                       &dDistance));
+          dInertia += dDistance;
+        }
+      QVERIFY(qAbs(kMeans.inertia() - dInertia) < 1e-9);
+      // Lazily calculated values don't accumulate.
+      QVERIFY(qAbs(kMeans.inertia() - dInertia) < 1e-9);
+    }
+}
+
+void TestPiiKMeans::miniBatch()
+{
+  Pii::seedRandom(3);
+  PiiMatrix<double> matSamples(createBlobs(1000));
+
+  PiiKMeans<PiiMatrix<double> > kMeans;
+  kMeans.cluster(matSamples, 4);
+  const double dBatchInertia = kMeans.inertia();
+
+  kMeans.setBatchSize(64);
+  kMeans.setMaxIterations(50);
+  PiiMatrix<double> matCentroids(kMeans.cluster(matSamples, 4));
+  QCOMPARE(kMeans.iterationCount(), 50);
+  QCOMPARE(kMeans.assignments().size(), matSamples.rows());
+  for (int c=0; c<4; ++c)
+    QVERIFY(isCloseToBlob(matCentroids[c], 1.0));
+  QVERIFY(kMeans.inertia() < dBatchInertia * 1.1);
+}
+
+void TestPiiKMeans::specialCases()
+{
+  Pii::seedRandom(4);
+  PiiMatrix<int> matSamples(4, 2,
+                            0, 0,
+                            0, 1,
+                            5, 5,
+                            5, 6);
+  PiiKMeans<PiiMatrix<int> > kMeans;
+  QVERIFY(kMeans.cluster(matSamples, 5).isEmpty());
+  QVERIFY(kMeans.cluster(matSamples, 0).isEmpty());
+  QVERIFY(kMeans.assignments().isEmpty());
+  QVERIFY(kMeans.cluster(matSamples, PiiMatrix<int>(2, 3)).isEmpty());
+
+  // Every sample is a centroid.
+  kMeans.cluster(matSamples, 4);
+  QCOMPARE(kMeans.inertia(), 0.0);
+
+  for (int i=0; i<2; ++i)
+    {
+      kMeans.setSeedingMethod(i == 0 ?
+                              PiiClassification::RandomKMeansSeeding :
+                              PiiClassification::KMeansPlusPlusSeeding);
+      PiiMatrix<int> matCentroids(kMeans.cluster(matSamples, 1));
+      QCOMPARE(matCentroids.rows(), 1);
+      // Integer centroids are truncated.
+      QCOMPARE(matCentroids(0,0), 2);
+      QCOMPARE(matCentroids(0,1), 3);
+      QVERIFY(kMeans.assignments() == QVector<int>(4, 0));
+    }
+
+  // Duplicates only: some clusters remain empty.
+  PiiMatrix<int> matDuplicates(3, 2, 1, 1, 1, 1, 1, 1);
+  PiiMatrix<int> matCentroids(kMeans.cluster(matDuplicates, 2));
+  QCOMPARE(matCentroids.rows(), 2);
+  QCOMPARE(kMeans.inertia(), 0.0);
+}
+
+void TestPiiKMeans::classificationKMeans()
+{
+  Pii::seedRandom(5);
+  PiiMatrix<double> matSamples(6,2,
+                               -1.0,-0.5,
+                               -1.0,0.0,
+                               -1.0,0.5,
+                               1.0,-0.5,
+                               1.0,0.0,
+                               1.0,0.5);
+  PiiMatrix<double> matCentroids(PiiClassification::kMeans(matSamples, 2,
+                                                           PiiSquaredGeometricDistance<const double*>()));
+  QCOMPARE(matCentroids.rows(), 2);
+  QCOMPARE(qAbs(matCentroids(0,0)), 1.0);
+  QCOMPARE(matCentroids(0,1), 0.0);
+  QCOMPARE(matCentroids(0,0), -matCentroids(1,0));
+  QCOMPARE(matCentroids(1,1), 0.0);
+}
+
+QTEST_MAIN(TestPiiKMeans)
@@ -18,6 +18,7 @@
 #include <PiiLbp.h>
 #include <PiiMath.h>
 #include <PiiTypeTraits.h>
+#include <PiiTimer.h>
 #include <QtTest>
 
 void TestPiiLbp::basicLbp()
@@ -172,4 +173,62 @@ template <class T> void TestPiiLbp::thresholdedLbp()
     }
 }
 
+struct CheckerboardRoi
+{
+  bool operator() (int r, int c) const { return ((r ^ c) & 4) != 0; }
+};
+
+void TestPiiLbp::fastLbp()
+{
+  // The vectorized kernel for 8-bit images must produce the same
+  // results as the generic one, which is used for ints.
+  const PiiLbp::Mode aModes[] = { PiiLbp::Standard, PiiLbp::Uniform,
+                                  PiiLbp::RotationInvariant, PiiLbp::UniformRotationInvariant };
+  for (int iColumns=3; iColumns<60; iColumns+=7)
+    {
+      PiiMatrix<unsigned char> image(23, iColumns);
+      for (int r=0; r<image.rows(); ++r)
+        for (int c=0; c<image.columns(); ++c)
+          image(r,c) = (unsigned char)(rand() % 5 * 60);
+      PiiMatrix<int> intImage(image);
+
+      for (int m=0; m<4; ++m)
+        {
+          PiiLbp lbp(8, 1, aModes[m]);
+          QVERIFY(Pii::equals(lbp.genericLbp<PiiLbp::Histogram>(image),
+                              lbp.genericLbp<PiiLbp::Histogram>(intImage)));
+          QVERIFY(Pii::equals(lbp.genericLbp<PiiLbp::Histogram>(image, CheckerboardRoi()),
+                              lbp.genericLbp<PiiLbp::Histogram>(intImage, CheckerboardRoi())));
+          QVERIFY(Pii::equals(lbp.genericLbp<PiiLbp::Image>(image),
+                              lbp.genericLbp<PiiLbp::Image>(intImage)));
+
+          // The generic code leaves pixels outside of the ROI
+          // undefined. The fast path must not write codes there.
+          PiiMatrix<int> matFast(lbp.genericLbp<PiiLbp::Image>(image, CheckerboardRoi()));
+          PiiMatrix<int> matGeneric(lbp.genericLbp<PiiLbp::Image>(intImage, CheckerboardRoi()));
+          QCOMPARE(matFast.rows(), matGeneric.rows());
+          QCOMPARE(matFast.columns(), matGeneric.columns());
+          CheckerboardRoi roi;
+          for (int r=0; r<matFast.rows(); ++r)
+            for (int c=0; c<matFast.columns(); ++c)
+              {
+                if (roi(r+1,c+1))
+                  QCOMPARE(matFast(r,c), matGeneric(r,c));
+                else
+                  QCOMPARE(matFast(r,c), 0);
+              }
+        }
+    }
+
+  PiiMatrix<unsigned char> large(1024, 1280);
+  for (int r=0; r<large.rows(); ++r)
+    for (int c=0; c<large.columns(); ++c)
+      large(r,c) = (unsigned char)rand();
+  PiiLbp lbp(8, 1, PiiLbp::UniformRotationInvariant);
+  PiiTimer timer;
+  PiiMatrix<int> histogram(lbp.genericLbp<PiiLbp::Histogram>(large));
+  qDebug("LBP histogram of a 1280x1024 image: %.2f ms", timer.milliseconds());
+  QCOMPARE(Pii::sum<int>(histogram), 1022 * 1278);
+}
+
 QTEST_MAIN(TestPiiLbp)
@@ -25,6 +25,8 @@ class TestPiiMatching : public QObject
 private slots:
   void boundaryDirections();
   void shapeContextDescriptor();
+  void hnswMatcher();
+  void matcherSerialization();
 };
 
 
@@ -18,10 +18,80 @@
 #include <PiiMatching.h>
 #include <PiiMath.h>
 #include <PiiMatrixUtil.h>
+#include <PiiFeaturePointMatcher.h>
+#include <PiiSerializationUtil.h>
+#include <PiiTextOutputArchive.h>
+#include <PiiTextInputArchive.h>
 
 #include <iostream>
 #include <QtTest>
 #include <QDebug>
+#include <QBuffer>
+
+namespace
+{
+  typedef PiiFeaturePointMatcher<float, PiiMatrix<float> > Matcher;
+
+  // Finds a pure translation. The first pair of points is used as the
+  // hypothesis, which is enough if all correspondences are exact.
+  struct TranslationMatcher
+  {
+    bool findBestModel(const PiiMatrix<float>& modelPoints, const PiiMatrix<float>& queryPoints)
+    {
+      vecInliers.clear();
+      if (modelPoints.rows() == 0)
+        return false;
+      const float fDx = queryPoints(0,0) - modelPoints(0,0),
+        fDy = queryPoints(0,1) - modelPoints(0,1);
+      for (int i=0; i<modelPoints.rows(); ++i)
+        if (Pii::abs(queryPoints(i,0) - modelPoints(i,0) - fDx) < 0.01 &&
+            Pii::abs(queryPoints(i,1) - modelPoints(i,1) - fDy) < 0.01)
+          vecInliers << i;
+      matModel = PiiMatrix<double>(1,2, double(fDx), double(fDy));
+      return vecInliers.size() * 2 >= modelPoints.rows();
+    }
+    QVector<int> inlyingPoints() const { return vecInliers; }
+    PiiMatrix<double> bestModel() const { return matModel; }
+
+    QVector<int> vecInliers;
+    PiiMatrix<double> matModel;
+  };
+
+  // Two models with 40 points each.
+  struct MatcherData
+  {
+    MatcherData() :
+      matModelPoints(PiiClassification::createRandomSampleSet<PiiMatrix<float> >(80, 2, 0, 100)),
+      matModelFeatures(PiiClassification::createRandomSampleSet<PiiMatrix<float> >(80, 8, 0, 1)),
+      matQueryPoints(matModelPoints(40,0,40,-1)),
+      matQueryFeatures(matModelFeatures(40,0,40,-1))
+    {
+      for (int i=0; i<80; ++i)
+        vecModelIndices << i/40;
+      // The query is model 1 moved by (5,-3).
+      for (int i=0; i<40; ++i)
+        {
+          matQueryPoints(i,0) += 5;
+          matQueryPoints(i,1) -= 3;
+        }
+    }
+
+    // Verifies that the query matches model 1 at the right place.
+    bool matches(const Matcher& matcher) const
+    {
+      TranslationMatcher translation;
+      PiiMatching::MatchList lstMatches = matcher.findMatchingModels(matQueryPoints, matQueryFeatures, translation);
+      return lstMatches.size() == 1 &&
+        lstMatches[0].modelIndex() == 1 &&
+        lstMatches[0].matchedPointCount() == 40 &&
+        Pii::abs(lstMatches[0].transformParams()(0,0) - 5) < 0.01 &&
+        Pii::abs(lstMatches[0].transformParams()(0,1) + 3) < 0.01;
+    }
+
+    PiiMatrix<float> matModelPoints, matModelFeatures, matQueryPoints, matQueryFeatures;
+    QVector<int> vecModelIndices;
+  };
+}
 
 void TestPiiMatching::boundaryDirections()
 {
@@ -85,4 +155,90 @@ void TestPiiMatching::shapeContextDescriptor()
   }
 }
 
+void TestPiiMatching::hnswMatcher()
+{
+  MatcherData data;
+  Matcher matcher;
+  matcher.setMatchingMode(PiiMatching::MatchOneModel);
+  matcher.setIndexType(PiiMatching::HnswIndex);
+  matcher.setMaxEvaluations(10);
+  matcher.setSearchWidth(100);
+  QCOMPARE(matcher.searchWidth(), 100);
+  QCOMPARE(matcher.maxEvaluations(), 10);
+  matcher.buildDatabase(data.matModelPoints, data.matModelFeatures, data.vecModelIndices);
+  QVERIFY(data.matches(matcher));
+
+  // The search width can be changed without rebuilding, and copies
+  // are independent.
+  Matcher copy(matcher);
+  copy.setSearchWidth(80);
+  QCOMPARE(copy.searchWidth(), 80);
+  QCOMPARE(matcher.searchWidth(), 100);
+  QVERIFY(data.matches(copy));
+  QVERIFY(data.matches(matcher));
+
+  // Exhaustive search gives the same result.
+  matcher.setIndexType(PiiMatching::ExhaustiveSearch);
+  matcher.buildDatabase(data.matModelPoints, data.matModelFeatures, data.vecModelIndices);
+  QVERIFY(data.matches(matcher));
+}
+
+void TestPiiMatching::matcherSerialization()
+{
+  MatcherData data;
+  Matcher matcher;
+  matcher.setMatchingMode(PiiMatching::MatchOneModel);
+  matcher.setIndexType(PiiMatching::HnswIndex);
+  matcher.setSearchWidth(100);
+  matcher.setClosestMatchCount(2);
+  matcher.buildDatabase(data.matModelPoints, data.matModelFeatures, data.vecModelIndices);
+
+  Matcher restored;
+  try
+    {
+      QByteArray array(PiiSerialization::toByteArray<PiiTextOutputArchive>(matcher));
+      PiiSerialization::fromByteArray<PiiTextInputArchive>(array, restored);
+    }
+  catch (PiiSerializationException& ex)
+    {
+      QFAIL(qPrintable("Serialization error: " + ex.message() + ". Additional info: " + ex.info()));
+    }
+  QCOMPARE(restored.indexType(), PiiMatching::HnswIndex);
+  QCOMPARE(restored.searchWidth(), 100);
+  QCOMPARE(restored.closestMatchCount(), 2);
+  QCOMPARE(restored.matchingMode(), PiiMatching::MatchOneModel);
+  QVERIFY(data.matches(restored));
+
+  // Version 0 stored no index settings and no HNSW index.
+  QByteArray array;
+  QBuffer buffer(&array);
+  try
+    {
+      buffer.open(QIODevice::WriteOnly);
+      PiiTextOutputArchive oa(&buffer);
+      PiiKdTree<PiiMatrix<float> >* pKdTree = 0;
+      oa << (unsigned char)0; // class version
+      oa << data.matModelPoints;
+      oa << pKdTree;
+      oa << data.matModelFeatures;
+      oa << data.vecModelIndices;
+      oa << int(PiiMatching::MatchOneModel);
+      oa << 2; // closest matches
+      oa << 0; // max evaluations
+      buffer.close();
+
+      Matcher oldMatcher;
+      PiiSerialization::fromByteArray<PiiTextInputArchive>(array, oldMatcher);
+      QCOMPARE(oldMatcher.indexType(), PiiMatching::AutomaticIndex);
+      QCOMPARE(oldMatcher.searchWidth(), 0);
+      QCOMPARE(oldMatcher.closestMatchCount(), 2);
+      QCOMPARE(oldMatcher.matchingMode(), PiiMatching::MatchOneModel);
+      QVERIFY(data.matches(oldMatcher));
+    }
+  catch (PiiSerializationException& ex)
+    {
+      QFAIL(qPrintable("Serialization error: " + ex.message() + ". Additional info: " + ex.info()));
+    }
+}
+
 QTEST_MAIN(TestPiiMatching)
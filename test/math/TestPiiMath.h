@@ -54,6 +54,9 @@ private slots:
   void square();
   void pseudoInverse();
   void multiplyTransposed();
+  void multiplyBlocked_data();
+  void multiplyBlocked();
+  void multiplyBenchmark();
   void pivot();
   void norm();
   void multiply();
@@ -32,6 +32,7 @@ using std::endl;
 #include <PiiVector.h>
 #include <cstdlib>
 #include <ctime>
+#include <PiiTimer.h>
 
 
 const double tol = 1e-10;
@@ -789,6 +790,81 @@ void TestPiiMath::multiplyTransposed()
     }
 }
 
+// The product of two matrices computed with the naive algorithm.
+template <class T, class Matrix1, class Matrix2>
+static PiiMatrix<T> naiveProduct(const Matrix1& m1, const Matrix2& m2)
+{
+  PiiMatrix<T> result(m1.rows(), m2.columns());
+  for (int r=0; r<m1.rows(); ++r)
+    for (int c=0; c<m2.columns(); ++c)
+      result(r,c) = Pii::innerProductN(m1.rowBegin(r), m1.columns(), m2.columnBegin(c), T(0));
+  return result;
+}
+
+void TestPiiMath::multiplyBlocked_data()
+{
+  QTest::addColumn<int>("rows");
+  QTest::addColumn<int>("inner");
+  QTest::addColumn<int>("columns");
+  QTest::newRow("tiny") << 3 << 3 << 3;
+  QTest::newRow("threshold") << 32 << 32 << 32;
+  QTest::newRow("odd") << 37 << 43 << 41;
+  QTest::newRow("tall") << 300 << 5 << 130;
+  QTest::newRow("deep") << 5 << 700 << 600;
+  QTest::newRow("wide") << 129 << 40 << 2049;
+  QTest::newRow("large") << 300 << 263 << 257;
+}
+
+void TestPiiMath::multiplyBlocked()
+{
+  QFETCH(int, rows);
+  QFETCH(int, inner);
+  QFETCH(int, columns);
+
+  PiiMatrix<double> a(rows, inner), b(inner, columns);
+  for (int r=0; r<rows; ++r)
+    for (int c=0; c<inner; ++c)
+      a(r,c) = double((r*31 + c*17) % 13 - 6) / 7;
+  for (int r=0; r<inner; ++r)
+    for (int c=0; c<columns; ++c)
+      b(r,c) = double((r*7 + c*3) % 11 - 5) / 3;
+
+  PiiMatrix<double> expected(naiveProduct<double>(a, b));
+  QVERIFY(Pii::almostEqual(a * b, expected, 1e-10));
+  // Transposed and type-converted operands are evaluated first.
+  PiiMatrix<double> bT(Pii::transpose(b));
+  QVERIFY(Pii::almostEqual(a * Pii::transpose(bT), expected, 1e-10));
+  QVERIFY(Pii::almostEqual(PiiMatrix<double>(a * PiiMatrix<float>(b)), expected, 1e-4));
+  QVERIFY(Pii::almostEqual(PiiMatrix<double>(PiiMatrix<float>(a) * PiiMatrix<float>(b)), expected, 1e-3));
+
+  // Submatrices have a stride larger than their width.
+  if (rows > 2 && columns > 2)
+    QVERIFY(Pii::almostEqual(a(1,0,rows-2,inner) * b(0,1,inner,columns-2),
+                             expected(1,1,rows-2,columns-2), 1e-10));
+}
+
+void TestPiiMath::multiplyBenchmark()
+{
+  const int iSize = 500;
+  PiiMatrix<double> a(iSize, iSize), b(iSize, iSize);
+  for (int r=0; r<iSize; ++r)
+    for (int c=0; c<iSize; ++c)
+      {
+        a(r,c) = r + c;
+        b(r,c) = r - c;
+      }
+
+  PiiTimer timer;
+  PiiMatrix<double> matBlocked(a * b);
+  const qint64 iBlockedTime = timer.restart();
+  PiiMatrix<double> matNaive(naiveProduct<double>(a, b));
+  const qint64 iNaiveTime = timer.restart();
+
+  QVERIFY(Pii::equals(matBlocked, matNaive));
+  qDebug("%dx%d doubles: blocked %.1f ms, naive %.1f ms",
+         iSize, iSize, iBlockedTime / 1000.0, iNaiveTime / 1000.0);
+}
+
 void TestPiiMath::multiply()
 {
   {
@@ -43,6 +43,10 @@ private slots:
   void reserve();
   void mapped();
   void map();
+  void allocator();
+  void expressions();
+  void normalizationBenchmark_data();
+  void normalizationBenchmark();
 
 private:
   template <class Matrix> void setTo(Matrix& matrix, typename Matrix::value_type value);
@@ -17,6 +17,8 @@
 #include <PiiMath.h>
 #include "TestPiiMatrix.h"
 #include <PiiMatrixUtil.h>
+#include <PiiMatrixAllocator.h>
+#include <PiiTimer.h>
 #include <QtDebug>
 #include <typeinfo>
 #include <iostream>
@@ -992,4 +994,241 @@ void TestPiiMatrix::map()
   QVERIFY(Pii::equals(mat, PiiMatrix<int>::constant(3,3, 1)));
 }
 
+void TestPiiMatrix::allocator()
+{
+  QCOMPARE(PiiMatrixAllocator::alignment(), std::size_t(64));
+  {
+    // Wide rows are aligned to SIMD width, narrow ones aren't.
+    PiiMatrix<unsigned char> wide(10, 100);
+    QCOMPARE(int(std::size_t(wide.row(0)) & 63), 0);
+    QCOMPARE(int(wide.stride()), 128);
+    PiiMatrix<double> narrow(10, 3);
+    QCOMPARE(int(std::size_t(narrow.row(0)) & 63), 0);
+    QCOMPARE(int(narrow.stride()), 24);
+
+    PiiMatrixAllocator::setAlignment(20);
+    QCOMPARE(PiiMatrixAllocator::alignment(), std::size_t(32));
+    PiiMatrix<unsigned char> mat32(10, 100);
+    QCOMPARE(int(std::size_t(mat32.row(0)) & 31), 0);
+    QCOMPARE(int(mat32.stride()), 128);
+    PiiMatrixAllocator::setAlignment(64);
+
+    // The old layout: only the first row is aligned.
+    PiiMatrixAllocator::setRowAlignmentEnabled(false);
+    PiiMatrix<unsigned char> unaligned(10, 100);
+    QCOMPARE(int(std::size_t(unaligned.row(0)) & 63), 0);
+    QCOMPARE(int(unaligned.stride()), 100);
+    PiiMatrixAllocator::setRowAlignmentEnabled(true);
+  }
+
+  // A released block is reused for the next matrix of the same size.
+  PiiMatrixAllocator::clear();
+  PiiMatrixAllocator::resetStatistics();
+  for (int i=0; i<10; ++i)
+    {
+      PiiMatrix<float> mat(480, 640);
+      mat(479, 639) = i;
+    }
+  PiiMatrixAllocator::Statistics stats = PiiMatrixAllocator::statistics();
+  QCOMPARE(stats.iAllocations, 10);
+  QCOMPARE(stats.iReleases, 10);
+  QCOMPARE(stats.iSystemAllocations, 1);
+  QCOMPARE(stats.iPoolHits, 9);
+
+  // Growing within a block retains contents.
+  PiiMatrix<int> mat(0, 5);
+  for (int i=0; i<200; ++i)
+    {
+      int aRow[] = { i, i, i, i, i };
+      mat.appendRow(aRow);
+    }
+  for (int i=0; i<200; ++i)
+    QCOMPARE(mat(i,4), i);
+
+  PiiMatrixAllocator::setPoolingEnabled(false);
+  PiiMatrixAllocator::resetStatistics();
+  for (int i=0; i<3; ++i)
+    PiiMatrix<float> mat2(480, 640);
+  stats = PiiMatrixAllocator::statistics();
+  QCOMPARE(stats.iSystemAllocations, 3);
+  QCOMPARE(stats.iPooledBlocks, 0);
+  PiiMatrixAllocator::setPoolingEnabled(true);
+}
+
+void TestPiiMatrix::expressions()
+{
+  const PiiMatrix<unsigned char> image(2, 3,
+                                       200, 100, 0,
+                                       1, 2, 255);
+  // Scalars are converted to the element type of the matrix.
+  QVERIFY(Pii::equals(PiiMatrix<int>(image + 100),
+                      PiiMatrix<int>(2, 3,
+                                     44, 200, 100,
+                                     101, 102, 99)));
+  QVERIFY(typeid((image - 1)(0,0)) == typeid(unsigned char));
+  QVERIFY(typeid((image * 0.5)(0,0)) == typeid(unsigned char));
+  PiiMatrix<float> matFloat(image);
+  QVERIFY(typeid((matFloat * 0.5)(0,0)) == typeid(float));
+
+  // Wider types must be asked for.
+  QVERIFY(Pii::equals(PiiMatrix<int>(image.cast<int>() + 100),
+                      PiiMatrix<int>(2, 3,
+                                     300, 200, 100,
+                                     101, 102, 355)));
+  QCOMPARE(Pii::sum<int>(PiiMatrix<int>(image.cast<int>() > 300)), 0);
+  QCOMPARE(Pii::sum<int>(PiiMatrix<int>(image >= 255)), 1);
+  QVERIFY(Pii::equals(PiiMatrix<double>(image.cast<double>() * 0.5),
+                      PiiMatrix<double>(2, 3,
+                                        100.0, 50.0, 0.0,
+                                        0.5, 1.0, 127.5)));
+  // Scalar on the left
+  QVERIFY(Pii::equals(PiiMatrix<int>(10 - image.cast<int>()),
+                      PiiMatrix<int>(2, 3,
+                                     -190, -90, 10,
+                                     9, 8, -245)));
+  QVERIFY(Pii::equals(PiiMatrix<int>(10 - image),
+                      PiiMatrix<int>(2, 3,
+                                     66, 166, 10,
+                                     9, 8, 11)));
+  QVERIFY(Pii::equals(PiiMatrix<float>(1.0f / (image(1,0,1,2).cast<float>() + 1)),
+                      PiiMatrix<float>(1, 2, 0.5f, 1.0f/3)));
+
+  // A chain of operations allocates memory only for the result.
+  {
+    PiiMatrix<float> matA(20, 30), matB(20, 30);
+    PiiMatrixAllocator::resetStatistics();
+    PiiMatrix<float> matC((matA - 1.0f) * 2.0f + matB);
+    QCOMPARE(PiiMatrixAllocator::statistics().iAllocations, 1);
+    QCOMPARE(matC(19,29), -2.0f);
+  }
+
+  // Chains of element-wise operations with submatrix and transposed operands
+  PiiMatrix<int> a(3, 3,
+                   1, 2, 3,
+                   4, 5, 6,
+                   7, 8, 9);
+  PiiMatrix<int> b(((a - 1) * 2 + Pii::transpose(a)) / 2);
+  QVERIFY(Pii::equals(b, PiiMatrix<int>(3, 3,
+                                        0, 3, 5,
+                                        4, 6, 9,
+                                        7, 10, 12)));
+  PiiMatrix<int> c(a(1,1,2,2) - a(0,0,2,2) + 1);
+  QVERIFY(Pii::equals(c, PiiMatrix<int>::constant(2, 2, 5)));
+
+  // In-place evaluation may refer to the target itself.
+  a = a * 2 - a;
+  QVERIFY(Pii::equals(a, PiiMatrix<int>(3, 3,
+                                        1, 2, 3,
+                                        4, 5, 6,
+                                        7, 8, 9)));
+  a(0,0,2,2) += a(1,1,2,2);
+  QVERIFY(Pii::equals(a, PiiMatrix<int>(3, 3,
+                                        6, 8, 3,
+                                        12, 14, 6,
+                                        7, 8, 9)));
+  PiiMatrix<int> shared(a);
+  shared -= a;
+  QCOMPARE(a(0,0), 6);
+  QVERIFY(Pii::equals(shared, PiiMatrix<int>(3,3)));
+}
+
+template <class T, class Matrix> PiiMatrix<T> evaluateElementwise(const Matrix& mat)
+{
+  PiiMatrix<T> result(PiiMatrix<T>::uninitialized(mat.rows(), mat.columns()));
+  Pii::transform(mat.begin(), mat.end(), result.begin(), Pii::Cast<typename Matrix::value_type,T>());
+  return result;
+}
+
+void TestPiiMatrix::normalizationBenchmark_data()
+{
+  QTest::addColumn<int>("expression");
+  QTest::newRow("(a - mean) * scale + b") << 0;
+  QTest::newRow("(float(image) - 128) / 128") << 1;
+  QTest::newRow("(float(image) - min) * 255 / (max - min)") << 2;
+}
+
+/* Compares a fused single-pass evaluation of common image
+ * normalization expressions to the old element-wise iteration and to
+ * a version that stores intermediate results in temporary matrices.
+ */
+void TestPiiMatrix::normalizationBenchmark()
+{
+  QFETCH(int, expression);
+
+  const int iRows = 480, iColumns = 640, iRounds = 100;
+  PiiMatrix<unsigned char> image(iRows, iColumns);
+  PiiMatrix<float> a(iRows, iColumns), b(iRows, iColumns);
+  for (int r=0; r<iRows; ++r)
+    for (int c=0; c<iColumns; ++c)
+      {
+        image(r,c) = (unsigned char)(r*c);
+        a(r,c) = r * 0.5f + c;
+        b(r,c) = c - r;
+      }
+  const float fMean = 3.5f, fScale = 0.25f, fMin = 10.0f, fMax = 200.0f;
+
+  PiiMatrix<float> matFused(iRows, iColumns), matElementwise, matTemporaries;
+  PiiTimer timer;
+  switch (expression)
+    {
+    case 0:
+      for (int i=0; i<iRounds; ++i)
+        matFused = (a - fMean) * fScale + b;
+      break;
+    case 1:
+      for (int i=0; i<iRounds; ++i)
+        matFused = (image.cast<float>() - 128) / 128.0f;
+      break;
+    case 2:
+      for (int i=0; i<iRounds; ++i)
+        matFused = (image.cast<float>() - fMin) * (255.0f / (fMax - fMin));
+      break;
+    }
+  const qint64 iFusedTime = timer.restart();
+
+  switch (expression)
+    {
+    case 0:
+      for (int i=0; i<iRounds; ++i)
+        matElementwise = evaluateElementwise<float>((a - fMean) * fScale + b);
+      break;
+    case 1:
+      for (int i=0; i<iRounds; ++i)
+        matElementwise = evaluateElementwise<float>((image.cast<float>() - 128) / 128.0f);
+      break;
+    case 2:
+      for (int i=0; i<iRounds; ++i)
+        matElementwise = evaluateElementwise<float>((image.cast<float>() - fMin) * (255.0f / (fMax - fMin)));
+      break;
+    }
+  const qint64 iElementwiseTime = timer.restart();
+
+  for (int i=0; i<iRounds; ++i)
+    {
+      PiiMatrix<float> matTmp;
+      if (expression == 0)
+        {
+          matTmp = PiiMatrix<float>(a - fMean);
+          matTmp = PiiMatrix<float>(matTmp * fScale);
+          matTmp = PiiMatrix<float>(matTmp + b);
+        }
+      else
+        {
+          matTmp = PiiMatrix<float>(image);
+          matTmp = PiiMatrix<float>(matTmp - (expression == 1 ? 128.0f : fMin));
+          matTmp = PiiMatrix<float>(matTmp * (expression == 1 ? 1.0f / 128 : 255.0f / (fMax - fMin)));
+        }
+      matTemporaries = matTmp;
+    }
+  const qint64 iTemporariesTime = timer.restart();
+
+  QVERIFY(Pii::equals(matFused, matElementwise));
+  QVERIFY(Pii::almostEqual(matFused, matTemporaries, 1e-4f));
+  qDebug("%s: fused %.3f ms, element-wise %.3f ms, temporaries %.3f ms per frame",
+         QTest::currentDataTag(),
+         iFusedTime / 1000.0 / iRounds,
+         iElementwiseTime / 1000.0 / iRounds,
+         iTemporariesTime / 1000.0 / iRounds);
+}
+
 QTEST_MAIN(TestPiiMatrix)
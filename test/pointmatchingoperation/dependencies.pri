@@ -0,0 +1 @@
+DEPENDENCIES = Matching
@@ -0,0 +1,83 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "TestPiiPointMatchingOperation.h"
+
+#include <QtTest>
+#include <PiiDelay.h>
+#include <PiiClassification.h>
+#include <PiiMatching.h>
+
+void TestPiiPointMatchingOperation::initTestCase()
+{
+  QVERIFY(createOperation("piimatching", "PiiRigidPlaneMatcher"));
+}
+
+void TestPiiPointMatchingOperation::hnswIndex()
+{
+  QVERIFY(operation()->setProperty("indexType", "HnswIndex"));
+  QVERIFY(operation()->setProperty("searchWidth", 100));
+  QVERIFY(operation()->setProperty("matchingMode", "MatchOneModel"));
+  QCOMPARE(operation()->property("indexType").toInt(), int(PiiMatching::HnswIndex));
+  QCOMPARE(operation()->property("searchWidth").toInt(), 100);
+
+  // Two models with 40 points each.
+  PiiMatrix<float> matPoints(PiiClassification::createRandomSampleSet<PiiMatrix<float> >(80, 2, 0, 100));
+  PiiMatrix<float> matFeatures(PiiClassification::createRandomSampleSet<PiiMatrix<float> >(80, 8, 0, 1));
+  QVariantList lstModelIndices;
+  for (int i=0; i<80; ++i)
+    lstModelIndices << i/40;
+
+  QVERIFY(QMetaObject::invokeMethod(operation(), "startLearningThread", Qt::DirectConnection,
+                                    Q_ARG(PiiVariant, PiiVariant(matFeatures)),
+                                    Q_ARG(PiiVariant, PiiVariant(matPoints)),
+                                    Q_ARG(QVariantList, lstModelIndices)));
+  QTime time;
+  time.start();
+  while (operation()->property("learningThreadRunning").toBool())
+    {
+      PiiDelay::msleep(10);
+      QCoreApplication::processEvents();
+      if (time.elapsed() > 3000)
+        QFAIL("Building the index took way too long.");
+    }
+  QCOMPARE(operation()->property("learningError").toString(), QString());
+
+  // Clones keep the search width.
+  PiiOperation* pClone = operation()->clone();
+  QCOMPARE(pClone->property("searchWidth").toInt(), 100);
+  delete pClone;
+
+  QVERIFY(connectInput("features"));
+  QVERIFY(connectInput("points"));
+  QVERIFY(start());
+
+  // Model 1 moved by (5,-3).
+  PiiMatrix<float> matQueryPoints(matPoints(40,0,40,-1));
+  for (int i=0; i<40; ++i)
+    {
+      matQueryPoints(i,0) += 5;
+      matQueryPoints(i,1) -= 3;
+    }
+  QVERIFY(sendObject("points", matQueryPoints));
+  QVERIFY(sendObject("features", PiiMatrix<float>(matFeatures(40,0,40,-1))));
+  QCOMPARE(outputValue("model index", -2), 1);
+  QCOMPARE(outputValue("query points", PiiMatrix<float>()).rows(), 40);
+
+  QVERIFY(stop());
+}
+
+QTEST_MAIN(TestPiiPointMatchingOperation)
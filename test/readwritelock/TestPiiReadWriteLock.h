@@ -27,16 +27,22 @@ public:
   TestPiiReadWriteLock();
 
 private slots:
+  void threaded_data();
   void threaded();
+  void recursive_data();
   void recursive();
+  void readOverhead_data();
+  void readOverhead();
 
 private:
   void writer(int count);
   void reader();
+  void lockReadRepeatedly(int count);
+
+  PiiReadWriteLock* _pLock;
 
   int _iCounter;
   bool _bFailure;
-  PiiReadWriteLock _lock;
 };
 
 
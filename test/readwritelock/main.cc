@@ -18,18 +18,21 @@
 #include <QtTest>
 #include <PiiAsyncCall.h>
 #include <PiiDelay.h>
+#include <PiiTimer.h>
 
 TestPiiReadWriteLock::TestPiiReadWriteLock() :
-  _iCounter(0), _bFailure(false)
+  _pLock(0), _iCounter(0), _bFailure(false)
 {}
 
 void TestPiiReadWriteLock::writer(int count)
 {
   for (int i=0; i<count; ++i)
     {
-      PiiWriteLocker lock(&_lock);
+      PiiWriteLocker lock(_pLock);
+      // Readers must never see an odd value.
       ++_iCounter;
       PiiDelay::msleep(1);
+      ++_iCounter;
     }
 }
 
@@ -38,15 +41,26 @@ void TestPiiReadWriteLock::reader()
   int iPreviousValue = 0;
   for (int i=0; i<200; ++i)
     {
-      PiiReadLocker lock(&_lock);
-      if (iPreviousValue > _iCounter)
+      PiiReadLocker lock(_pLock);
+      if (iPreviousValue > _iCounter || (_iCounter & 1))
         _bFailure = true;
       iPreviousValue = _iCounter;
     }
 }
 
+void TestPiiReadWriteLock::threaded_data()
+{
+  recursive_data();
+}
+
 void TestPiiReadWriteLock::threaded()
 {
+  QFETCH(int, readerMode);
+  PiiReadWriteLock lock(PiiReadWriteLock::NonRecursive, PiiReadWriteLock::ReaderMode(readerMode));
+  _pLock = &lock;
+  _iCounter = 0;
+  _bFailure = false;
+
   QThread* pWriter1 = Pii::asyncCall(this, &TestPiiReadWriteLock::writer, 100);
   QThread* pWriter2 = Pii::asyncCall(this, &TestPiiReadWriteLock::writer, 200);
   QThread* pReader1 = Pii::asyncCall(this, &TestPiiReadWriteLock::reader);
@@ -61,12 +75,20 @@ void TestPiiReadWriteLock::threaded()
 
   if (_bFailure)
     QFAIL("Numbers were read in wrong order.");
-  QCOMPARE(_iCounter, 300);
+  QCOMPARE(_iCounter, 600);
+}
+
+void TestPiiReadWriteLock::recursive_data()
+{
+  QTest::addColumn<int>("readerMode");
+  QTest::newRow("centralized") << int(PiiReadWriteLock::CentralizedReaders);
+  QTest::newRow("distributed") << int(PiiReadWriteLock::DistributedReaders);
 }
 
 void TestPiiReadWriteLock::recursive()
 {
-  PiiReadWriteLock lock(PiiReadWriteLock::Recursive);
+  QFETCH(int, readerMode);
+  PiiReadWriteLock lock(PiiReadWriteLock::Recursive, PiiReadWriteLock::ReaderMode(readerMode));
   lock.lockForRead();
   lock.lockForWrite();
   lock.lockForRead();
@@ -82,4 +104,50 @@ void TestPiiReadWriteLock::recursive()
   lock.unlockWrite();
 }
 
+void TestPiiReadWriteLock::lockReadRepeatedly(int count)
+{
+  for (int i=0; i<count; ++i)
+    {
+      PiiReadLocker lock(_pLock);
+    }
+}
+
+void TestPiiReadWriteLock::readOverhead_data()
+{
+  QTest::addColumn<int>("readerMode");
+  QTest::addColumn<int>("threadCount");
+  for (int iThreads=1; iThreads<=16; iThreads *= 4)
+    {
+      QTest::newRow(qPrintable(QString("centralized, %1 threads").arg(iThreads)))
+        << int(PiiReadWriteLock::CentralizedReaders) << iThreads;
+      QTest::newRow(qPrintable(QString("distributed, %1 threads").arg(iThreads)))
+        << int(PiiReadWriteLock::DistributedReaders) << iThreads;
+    }
+}
+
+/* Measures the cost of the read lock PiiDefaultOperation acquires
+ * around each process() call when many threads process
+ * simultaneously.
+ */
+void TestPiiReadWriteLock::readOverhead()
+{
+  QFETCH(int, readerMode);
+  QFETCH(int, threadCount);
+  const int iLocksPerThread = 200000;
+
+  PiiReadWriteLock lock(PiiReadWriteLock::Recursive, PiiReadWriteLock::ReaderMode(readerMode));
+  _pLock = &lock;
+
+  PiiTimer timer;
+  QList<QThread*> lstThreads;
+  for (int i=0; i<threadCount; ++i)
+    lstThreads << Pii::asyncCall(this, &TestPiiReadWriteLock::lockReadRepeatedly, iLocksPerThread);
+  for (int i=0; i<threadCount; ++i)
+    lstThreads[i]->wait();
+
+  qDebug("%s: %.1f ns wall-clock time per read lock in each thread",
+         QTest::currentDataTag(),
+         timer.microseconds() * 1000.0 / iLocksPerThread);
+}
+
 QTEST_MAIN(TestPiiReadWriteLock)
@@ -0,0 +1,77 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _TESTPIIOPERATIONSCHEDULER_H
+#define _TESTPIIOPERATIONSCHEDULER_H
+
+#include <PiiDefaultOperation.h>
+#include <PiiOperationScheduler.h>
+#include <QVector>
+
+// Emits a time stamp (in microseconds) *count* times and stops.
+class SourceOperation : public PiiDefaultOperation
+{
+  Q_OBJECT
+public:
+  SourceOperation(int count);
+
+  void check(bool reset);
+
+protected:
+  void process();
+
+private:
+  int _iCount, _iIndex;
+};
+
+// Burns some CPU and passes the incoming object.
+class StageOperation : public PiiDefaultOperation
+{
+  Q_OBJECT
+public:
+  StageOperation(int work);
+
+protected:
+  void process();
+
+private:
+  int _iWork;
+};
+
+// Records the latency of each received time stamp.
+class SinkOperation : public PiiDefaultOperation
+{
+  Q_OBJECT
+public:
+  SinkOperation();
+
+  QVector<qint64> vecLatencies;
+  QVector<qint64> vecStamps;
+
+protected:
+  void process();
+};
+
+class TestPiiOperationScheduler : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void tasks();
+  void pipeline_data();
+  void pipeline();
+};
+
+#endif //_TESTPIIOPERATIONSCHEDULER_H
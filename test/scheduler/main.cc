@@ -0,0 +1,190 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "TestPiiOperationScheduler.h"
+
+#include <QtTest>
+#include <PiiEngine.h>
+#include <PiiAtomicInt.h>
+#include <PiiDelay.h>
+#include <PiiTimer.h>
+
+#include <algorithm>
+
+static PiiTimer globalTimer;
+
+SourceOperation::SourceOperation(int count) :
+  _iCount(count), _iIndex(0)
+{
+  addSocket(new PiiOutputSocket("output"));
+}
+
+void SourceOperation::check(bool reset)
+{
+  PiiDefaultOperation::check(reset);
+  if (reset)
+    _iIndex = 0;
+}
+
+void SourceOperation::process()
+{
+  if (_iIndex++ >= _iCount)
+    operationStopped();
+  emitObject(globalTimer.microseconds());
+}
+
+StageOperation::StageOperation(int work) :
+  _iWork(work)
+{
+  addSocket(new PiiInputSocket("input"));
+  addSocket(new PiiOutputSocket("output"));
+}
+
+void StageOperation::process()
+{
+  volatile double dSum = 0;
+  for (int i=0; i<_iWork; ++i)
+    dSum += i * 0.5;
+  emitObject(readInput());
+}
+
+SinkOperation::SinkOperation()
+{
+  addSocket(new PiiInputSocket("input"));
+}
+
+void SinkOperation::process()
+{
+  qint64 lStamp = readInput().valueAs<qint64>();
+  vecStamps << lStamp;
+  vecLatencies << globalTimer.microseconds() - lStamp;
+}
+
+class CountingTask : public PiiOperationScheduler::Task
+{
+public:
+  CountingTask() : pScheduler(0), pCounter(0), bResubmit(true) {}
+
+  void execute()
+  {
+    ++*pCounter;
+    // The second submission comes from a worker thread.
+    if (bResubmit)
+      {
+        bResubmit = false;
+        pScheduler->submit(this);
+      }
+  }
+
+  PiiOperationScheduler* pScheduler;
+  PiiAtomicInt* pCounter;
+  bool bResubmit;
+};
+
+void TestPiiOperationScheduler::tasks()
+{
+  const int iTaskCount = 1000;
+  PiiOperationScheduler scheduler(4);
+  QCOMPARE(scheduler.threadCount(), 4);
+  QVERIFY(!scheduler.isWorkerThread());
+  scheduler.start();
+  QVERIFY(scheduler.isRunning());
+
+  PiiAtomicInt iCounter;
+  QVector<CountingTask> vecTasks(iTaskCount);
+  for (int i=0; i<iTaskCount; ++i)
+    {
+      vecTasks[i].pScheduler = &scheduler;
+      vecTasks[i].pCounter = &iCounter;
+      scheduler.submit(&vecTasks[i]);
+    }
+
+  for (int i=0; i<500 && iCounter.load() < 2*iTaskCount; ++i)
+    PiiDelay::msleep(10);
+  QCOMPARE(iCounter.load(), 2*iTaskCount);
+
+  scheduler.stop();
+  QVERIFY(!scheduler.isRunning());
+}
+
+void TestPiiOperationScheduler::pipeline_data()
+{
+  QTest::addColumn<int>("schedulingMode");
+  QTest::newRow("thread per operation") << int(PiiEngine::ThreadPerOperation);
+  QTest::newRow("shared scheduler") << int(PiiEngine::SharedScheduler);
+}
+
+/* Runs a synthetic pipeline of 50 single-threaded stages with both
+ * scheduling modes and prints throughput and latency figures.
+ */
+void TestPiiOperationScheduler::pipeline()
+{
+  QFETCH(int, schedulingMode);
+
+  const int iStageCount = 50, iFrameCount = 5000, iWork = 2000;
+
+  PiiEngine engine;
+  engine.setProperty("schedulingMode", schedulingMode);
+
+  SourceOperation* pSource = new SourceOperation(iFrameCount);
+  pSource->setObjectName("source");
+  pSource->setProperty("threadCount", 1);
+  engine.addOperation(pSource);
+
+  PiiOperation* pPrevious = pSource;
+  for (int i=0; i<iStageCount; ++i)
+    {
+      StageOperation* pStage = new StageOperation(iWork);
+      pStage->setObjectName(QString("stage%1").arg(i));
+      pStage->setProperty("threadCount", 1);
+      engine.addOperation(pStage);
+      QVERIFY(pPrevious->connectOutput("output", pStage, "input"));
+      pPrevious = pStage;
+    }
+
+  SinkOperation* pSink = new SinkOperation;
+  pSink->setObjectName("sink");
+  pSink->setProperty("threadCount", 1);
+  engine.addOperation(pSink);
+  QVERIFY(pPrevious->connectOutput("output", pSink, "input"));
+
+  globalTimer.restart();
+  try
+    {
+      engine.execute();
+    }
+  catch (PiiException& ex)
+    {
+      QFAIL(qPrintable(ex.message()));
+    }
+
+  QVERIFY(engine.wait(PiiOperation::Stopped, 60000));
+  double dSeconds = globalTimer.seconds();
+
+  // Everything must arrive, in order.
+  QCOMPARE(pSink->vecStamps.size(), iFrameCount);
+  for (int i=1; i<iFrameCount; ++i)
+    QVERIFY(pSink->vecStamps[i] >= pSink->vecStamps[i-1]);
+
+  QVector<qint64> vecLatencies(pSink->vecLatencies);
+  std::sort(vecLatencies.begin(), vecLatencies.end());
+  qDebug("%s: %.1f frames/s, median latency %.2f ms, p99 latency %.2f ms",
+         QTest::currentDataTag(),
+         iFrameCount / dSeconds,
+         vecLatencies[iFrameCount / 2] / 1000.0,
+         vecLatencies[iFrameCount * 99 / 100] / 1000.0);
+}
+
+QTEST_MAIN(TestPiiOperationScheduler)
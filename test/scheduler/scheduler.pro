@@ -0,0 +1,2 @@
+LIBS += -lpiiydin$$INTO_LIBV -lpiicore$$INTO_LIBV
+include(../unit_test.pri)
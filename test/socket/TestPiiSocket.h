@@ -33,8 +33,12 @@ private slots:
   void proxyLoop();
   void connectedInputs();
   void root();
+  void inputQueue();
+  void multipleProducers();
 
 private:
+  void produce(PiiInputSocket* input, int first, int count);
+
   PiiOutputSocket a;
   PiiInputSocket b, e, h;
   PiiProxySocket c, d, f, g;
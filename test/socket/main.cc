@@ -15,6 +15,7 @@
 
 #include "TestPiiSocket.h"
 #include <QtTest>
+#include <PiiAsyncCall.h>
 
 TestPiiSocket::TestPiiSocket() :
   a(""), b(""), e(""), h("")
@@ -98,4 +99,85 @@ void TestPiiSocket::root()
   QCOMPARE(PiiProxySocket::root(&a), &a);
 }
 
+void TestPiiSocket::inputQueue()
+{
+  PiiInputSocket input("input");
+  input.setQueueCapacity(3);
+  QCOMPARE(input.queueCapacity(), 3);
+  QCOMPARE(input.queueLength(), 0);
+  QVERIFY(!input.queuedObject(0).isValid());
+  QCOMPARE(input.queuedType(0), (unsigned int)PiiVariant::InvalidType);
+
+  // Wrap around the ring a few times.
+  for (int i=0; i<10; ++i)
+    {
+      QVERIFY(input.tryReceive(PiiVariant(3*i)));
+      QVERIFY(input.tryReceive(PiiVariant(3*i+1)));
+      QVERIFY(input.tryReceive(PiiVariant(3*i+2)));
+      QVERIFY(!input.canReceive());
+      QVERIFY(!input.tryReceive(PiiVariant(-1)));
+      QCOMPARE(input.queueLength(), 3);
+      QCOMPARE(input.queuedObject(2).valueAs<int>(), 3*i+2);
+      QVERIFY(!input.queuedObject(3).isValid());
+
+      input.jump(2, 0);
+      QCOMPARE(input.queuedObject(0).valueAs<int>(), 3*i+2);
+      QCOMPARE(input.queuedObject(1).valueAs<int>(), 3*i);
+      QCOMPARE(input.indexOf(PiiVariant::IntType, 1), 1);
+
+      input.shift();
+      QVERIFY(input.canReceive());
+      QCOMPARE(input.firstObject().valueAs<int>(), 3*i+2);
+      input.shift();
+      input.shift();
+      QCOMPARE(input.firstObject().valueAs<int>(), 3*i+1);
+      QCOMPARE(input.queueLength(), 0);
+    }
+
+  input.receive(PiiVariant(1));
+  input.reset();
+  QCOMPARE(input.queueLength(), 0);
+  QVERIFY(input.canReceive());
+}
+
+void TestPiiSocket::produce(PiiInputSocket* input, int first, int count)
+{
+  for (int i=first; i<first+count; ++i)
+    while (!input->tryReceive(PiiVariant(i)))
+      QThread::yieldCurrentThread();
+}
+
+void TestPiiSocket::multipleProducers()
+{
+  const int iProducerCount = 4, iObjectCount = 10000;
+  PiiInputSocket input("input");
+  input.setQueueCapacity(5);
+  input.setProducerMode(PiiInputSocket::MultipleProducers);
+
+  QList<QThread*> lstThreads;
+  for (int i=0; i<iProducerCount; ++i)
+    lstThreads << Pii::asyncCall(this, &TestPiiSocket::produce, &input, i*iObjectCount, iObjectCount);
+
+  // Objects from each producer must arrive in order.
+  QVector<int> vecLast(iProducerCount, -1);
+  for (int iReceived=0; iReceived<iProducerCount*iObjectCount; )
+    {
+      if (input.queueLength() == 0)
+        {
+          QThread::yieldCurrentThread();
+          continue;
+        }
+      input.shift();
+      int iValue = input.firstObject().valueAs<int>();
+      int iProducer = iValue / iObjectCount;
+      QCOMPARE(iValue % iObjectCount, vecLast[iProducer] + 1);
+      vecLast[iProducer] = iValue % iObjectCount;
+      ++iReceived;
+    }
+
+  for (int i=0; i<lstThreads.size(); ++i)
+    lstThreads[i]->wait();
+  QCOMPARE(input.queueLength(), 0);
+}
+
 QTEST_MAIN(TestPiiSocket)
@@ -24,6 +24,7 @@ SUBDIRS = algorithm \
           genericfunction \
           geometry \
           heap \
+          hnswindex \
           houghtransformoperation \
           httpserver \
           image \
@@ -31,6 +32,7 @@ SUBDIRS = algorithm \
           kdtree \
           kerneladatron \
           kernelperceptron \
+          kmeans \
           lbp \
           lbpoperation \
           matching \
@@ -45,6 +47,7 @@ SUBDIRS = algorithm \
           perceptron \
           pisooperation \
           planerotation \
+          pointmatchingoperation \
           probeinput \
           qimage \
           quantizer \
@@ -52,6 +55,7 @@ SUBDIRS = algorithm \
           readwritelock \
           remoteobject \
           resourcedatabase \
+          scheduler \
           serialization \
           simplememorymanager \
           socket \
@@ -16,6 +16,7 @@
 #include "PiiBasicOperation.h"
 #include "PiiYdinTypes.h"
 #include "PiiNullInputController.h"
+#include "PiiTraceRecorder.h"
 
 PiiBasicOperation::Data::Data() :
   state(PiiOperation::Stopped)
@@ -364,6 +365,7 @@ void PiiBasicOperation::endMany(int firstOutput, int lastOutput)
 
 void PiiBasicOperation::applyPropertySet(const QString& name)
 {
+  PiiTraceRecorder::Scope trace(PiiTraceRecorder::Reconfigure, this);
   PiiOperation::applyPropertySet(name);
   sendTag(PiiYdin::createReconfigurationTag(name));
 }
@@ -17,6 +17,7 @@
 #include "PiiInputSocket.h"
 #include "PiiOutputSocket.h"
 #include "PiiSocketState.h"
+#include "PiiTraceRecorder.h"
 #include <PiiYdinTypes.h>
 
 PiiDefaultFlowController::SyncGroup::SyncGroup(int groupId) :
@@ -491,6 +492,10 @@ PiiDefaultFlowController::Relation PiiDefaultFlowController::looseRelation(int p
 void PiiDefaultFlowController::sendSyncEvents(SyncListener* listener)
 {
   PII_D;
+  if (d->vecSyncEvents.isEmpty())
+    return;
+  PiiTraceRecorder::Scope trace(PiiTraceRecorder::Sync,
+                                PiiTraceRecorder::isEnabled() ? dynamic_cast<QObject*>(listener) : 0);
   for (int i=0; i<d->vecSyncEvents.size(); ++i)
     listener->sendEvent(&d->vecSyncEvents[i]);
 }
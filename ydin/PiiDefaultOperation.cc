@@ -18,15 +18,16 @@
 #include "PiiSimpleProcessor.h"
 #include "PiiThreadedProcessor.h"
 #include "PiiMultiThreadedProcessor.h"
+#include "PiiScheduledProcessor.h"
 #include "PiiDefaultFlowController.h"
 #include "PiiOneInputFlowController.h"
 #include "PiiOneGroupFlowController.h"
 #include "PiiNullInputController.h"
 
 PiiDefaultOperation::Data::Data() :
-  pFlowController(0), pProcessor(0),
+  pFlowController(0), pProcessor(0), pScheduler(0), pStatistics(0),
   bChecked(false),
-  processLock(PiiReadWriteLock::Recursive),
+  processLock(PiiReadWriteLock::Recursive, PiiReadWriteLock::DistributedReaders),
   iThreadCount(0),
   threadingCapabilities(NonThreaded | SingleThreaded)
 {
@@ -36,6 +37,7 @@ PiiDefaultOperation::Data::~Data()
 {
   delete pFlowController;
   delete pProcessor;
+  delete pStatistics;
 }
 
 PiiDefaultOperation::PiiDefaultOperation() :
@@ -70,7 +72,10 @@ void PiiDefaultOperation::createProcessor()
       d->pProcessor = new PiiSimpleProcessor(this);
       break;
     case 1:
-      d->pProcessor = new PiiThreadedProcessor(this);
+      if (d->pScheduler != 0)
+        d->pProcessor = new PiiScheduledProcessor(this, d->pScheduler);
+      else
+        d->pProcessor = new PiiThreadedProcessor(this);
       break;
     default:
       d->pProcessor = new PiiMultiThreadedProcessor(this);
@@ -98,6 +103,68 @@ void PiiDefaultOperation::setThreadCount(int threadCount)
     }
 }
 
+void PiiDefaultOperation::setScheduler(PiiOperationScheduler* scheduler)
+{
+  PII_D;
+  // Producers usually block in process() while waiting for external
+  // data. They would reserve a shared worker for good.
+  if (scheduler != 0)
+    {
+      bool bHasConnectedInputs = false;
+      for (int i=0; i<d->lstInputs.size() && !bHasConnectedInputs; ++i)
+        bHasConnectedInputs = d->lstInputs[i]->isConnected();
+      if (!bHasConnectedInputs)
+        scheduler = 0;
+    }
+
+  if (d->pScheduler == scheduler || state() != Stopped)
+    return;
+
+  d->pScheduler = scheduler;
+  // Only single-threaded operations use the shared threads.
+  if (d->iThreadCount == 1)
+    {
+      QThread::Priority priority = d->pProcessor->processingPriority();
+      createProcessor();
+      d->pProcessor->setProcessingPriority(priority);
+    }
+}
+
+void PiiDefaultOperation::setStatisticsEnabled(bool statisticsEnabled)
+{
+  PII_D;
+  for (int i=0; i<d->lstInputs.size(); ++i)
+    d->lstInputs[i]->setStatisticsEnabled(statisticsEnabled);
+  for (int i=0; i<d->lstOutputs.size(); ++i)
+    d->lstOutputs[i]->setStatisticsEnabled(statisticsEnabled);
+
+  if (statisticsEnabled == (d->pStatistics != 0))
+    return;
+  if (statisticsEnabled)
+    d->pStatistics = new PiiOperationStatistics;
+  else
+    {
+      delete d->pStatistics;
+      d->pStatistics = 0;
+    }
+}
+
+void PiiDefaultOperation::resetStatistics()
+{
+  PII_D;
+  for (int i=0; i<d->lstInputs.size(); ++i)
+    d->lstInputs[i]->resetStatistics();
+  for (int i=0; i<d->lstOutputs.size(); ++i)
+    d->lstOutputs[i]->resetStatistics();
+  if (d->pStatistics != 0)
+    d->pStatistics->reset();
+}
+
+const PiiOperationStatistics* PiiDefaultOperation::statistics() const
+{
+  return _d()->pStatistics;
+}
+
 bool PiiDefaultOperation::isAcceptableThreadCount(int threadCount) const
 {
   const PII_D;
@@ -21,8 +21,11 @@
 #include <PiiReadWriteLock.h>
 #include "PiiBasicOperation.h"
 #include "PiiFlowController.h"
+#include "PiiOperationStatistics.h"
+#include "PiiTraceRecorder.h"
 
 class PiiOperationProcessor;
+class PiiOperationScheduler;
 
 /**
  * An easy-to-use implementation of the PiiOperation interface. This
@@ -62,6 +65,13 @@ class PII_YDIN_EXPORT PiiDefaultOperation :
    * [process()], [syncEvent()] is always the same, and no concurrent
    * calls will be made.
    *
+   * If the operation is run by a PiiEngine whose
+   * [schedulingMode](PiiEngine::schedulingMode) is `SharedScheduler`
+   * and the operation has at least one connected input, the thread
+   * is taken from a pool shared by all operations of the engine
+   * whenever there is something to process. The guarantees stay the
+   * same.
+   *
    * if `threadCount` is greater than one, a pool of threads will be
    * created. The system ensures that [syncEvent()] and setProperty()
    * are always called in isolation, but calls to [process()] may
@@ -213,6 +223,12 @@ public:
    */
   bool wait(unsigned long time = ULONG_MAX);
 
+  /**
+   * Returns the run-time statistics of this operation, or zero if
+   * statistics are not enabled. See PiiEngine::statisticsEnabled.
+   */
+  const PiiOperationStatistics* statistics() const;
+
 protected:
   /// @internal
   class PII_YDIN_EXPORT Data : public PiiBasicOperation::Data
@@ -226,6 +242,7 @@ protected:
     friend class PiiSimpleProcessor;
     friend class PiiThreadedProcessor;
     friend class PiiMultiThreadedProcessor;
+    friend class PiiScheduledProcessor;
 
     // Handles object flow. Synchronizes inputs etc.
     PiiFlowController* pFlowController;
@@ -233,6 +250,12 @@ protected:
     // Executes process() when needed.
     PiiOperationProcessor* pProcessor;
 
+    // Shared worker threads, if assigned by an engine.
+    PiiOperationScheduler* pScheduler;
+
+    // Run-time statistics, if enabled by an engine.
+    PiiOperationStatistics* pStatistics;
+
     // The group id of the input group being processed.
     int iActiveInputGroup;
 
@@ -376,21 +399,39 @@ protected:
    * functions. Acquiring the lock for reading blocks only
    * [setProperty()] and allows simultaneous execution of the other
    * (read-locked) functions.
+   *
+   * The lock is in `DistributedReaders` mode: read locking does not
+   * modify any state shared between processing threads, so
+   * multi-threaded operations do not contend on it unless a property
+   * is being set. Write locking is correspondingly more expensive.
    */
   PiiReadWriteLock* processLock();
 
 private:
   void init();
   void createProcessor();
+  void setScheduler(PiiOperationScheduler* scheduler);
+  void setStatisticsEnabled(bool statisticsEnabled);
+  void resetStatistics();
 
+  friend class PiiEngine;
   friend class PiiSimpleProcessor;
   friend class PiiThreadedProcessor;
   friend class PiiMultiThreadedProcessor;
+  friend class PiiScheduledProcessor;
 
   inline void processLocked()
   {
     PiiReadLocker lock(&_d()->processLock);
-    process();
+    PiiTraceRecorder::Scope trace(PiiTraceRecorder::Process, this);
+    if (_d()->pStatistics == 0)
+      process();
+    else
+      {
+        qint64 lStart = PiiOperationStatistics::clock();
+        process();
+        _d()->pStatistics->processed(PiiOperationStatistics::clock() - lStart);
+      }
   }
 
   inline void sendSyncEvents(PiiFlowController* controller)
@@ -19,6 +19,9 @@
 #include <PiiUtil.h>
 #include <PiiFileUtil.h>
 #include "PiiPlugin.h"
+#include "PiiDefaultOperation.h"
+#include "PiiOperationScheduler.h"
+#include "PiiOperationStatistics.h"
 #include <PiiGenericTextOutputArchive.h>
 #include <PiiGenericBinaryOutputArchive.h>
 #include <PiiGenericTextInputArchive.h>
@@ -51,8 +54,26 @@ public:
 } *d;
 
 
-PiiEngine::PiiEngine()
+PiiEngine::Data::Data() :
+  schedulingMode(ThreadPerOperation),
+  iSchedulerThreadCount(0),
+  pScheduler(0),
+  bStatisticsEnabled(false)
 {
+}
+
+PiiEngine::Data::~Data()
+{
+  delete pScheduler;
+}
+
+PiiEngine::PiiEngine() :
+  PiiOperationCompound(new Data)
+{
+  setProtectionLevel("schedulingMode", WriteWhenStopped);
+  setProtectionLevel("schedulerThreadCount", WriteWhenStopped);
+  setProtectionLevel("statisticsEnabled", WriteWhenStopped);
+
   Q_UNUSED(iEngineMetaType); // suppresses compiler warning
   Q_UNUSED(iPluginMetaType);
 #ifdef __MINGW32__
@@ -67,10 +88,81 @@ PiiEngine::PiiEngine()
 }
 
 PiiEngine::PiiEngine(Data* data) : PiiOperationCompound(data)
-{}
+{
+  setProtectionLevel("schedulingMode", WriteWhenStopped);
+  setProtectionLevel("schedulerThreadCount", WriteWhenStopped);
+  setProtectionLevel("statisticsEnabled", WriteWhenStopped);
+}
 
 PiiEngine::~PiiEngine()
-{}
+{
+  // Child operations will be deleted after the scheduler.
+  if (_d()->pScheduler != 0)
+    installScheduler(0);
+}
+
+void PiiEngine::check(bool reset)
+{
+  PII_D;
+  const int iThreadCount = d->iSchedulerThreadCount > 0 ?
+    d->iSchedulerThreadCount :
+    qMax(QThread::idealThreadCount(), 1);
+
+  // Get rid of an outdated scheduler.
+  if (d->pScheduler != 0 &&
+      (d->schedulingMode != SharedScheduler ||
+       d->pScheduler->threadCount() != iThreadCount))
+    {
+      installScheduler(0);
+      delete d->pScheduler;
+      d->pScheduler = 0;
+    }
+
+  if (d->schedulingMode == SharedScheduler)
+    {
+      if (d->pScheduler == 0)
+        d->pScheduler = new PiiOperationScheduler(iThreadCount);
+      d->pScheduler->start();
+      installScheduler(d->pScheduler);
+    }
+
+  QList<PiiDefaultOperation*> lstOperations = findChildren<PiiDefaultOperation*>();
+  for (int i=0; i<lstOperations.size(); ++i)
+    {
+      lstOperations[i]->setStatisticsEnabled(d->bStatisticsEnabled);
+      if (reset)
+        lstOperations[i]->resetStatistics();
+    }
+
+  PiiOperationCompound::check(reset);
+}
+
+QVariantMap PiiEngine::statistics() const
+{
+  return PiiOperationStatistics::collect(const_cast<PiiEngine*>(this));
+}
+
+void PiiEngine::resetStatistics()
+{
+  QList<PiiDefaultOperation*> lstOperations = findChildren<PiiDefaultOperation*>();
+  for (int i=0; i<lstOperations.size(); ++i)
+    lstOperations[i]->resetStatistics();
+}
+
+void PiiEngine::installScheduler(PiiOperationScheduler* scheduler)
+{
+  // Operations in nested compounds are QObject children, too.
+  QList<PiiDefaultOperation*> lstOperations = findChildren<PiiDefaultOperation*>();
+  for (int i=0; i<lstOperations.size(); ++i)
+    lstOperations[i]->setScheduler(scheduler);
+}
+
+void PiiEngine::setSchedulingMode(SchedulingMode schedulingMode) { _d()->schedulingMode = schedulingMode; }
+PiiEngine::SchedulingMode PiiEngine::schedulingMode() const { return _d()->schedulingMode; }
+void PiiEngine::setSchedulerThreadCount(int schedulerThreadCount) { _d()->iSchedulerThreadCount = qMax(schedulerThreadCount, 0); }
+int PiiEngine::schedulerThreadCount() const { return _d()->iSchedulerThreadCount; }
+void PiiEngine::setStatisticsEnabled(bool statisticsEnabled) { _d()->bStatisticsEnabled = statisticsEnabled; }
+bool PiiEngine::statisticsEnabled() const { return _d()->bStatisticsEnabled; }
 
 void PiiEngine::execute(ErrorHandling errorHandling)
 {
@@ -25,6 +25,7 @@
 #include "PiiOperationCompound.h"
 
 class QLibrary;
+class PiiOperationScheduler;
 
 /**
  * An execution engine. The task of PiiEngine is to handle the
@@ -73,7 +74,34 @@ class PII_YDIN_EXPORT PiiEngine : public PiiOperationCompound
 {
   Q_OBJECT
 
-  Q_ENUMS(FileFormat ErrorHandling)
+  /**
+   * The way threaded operations are executed. The default value is
+   * `ThreadPerOperation`. This property can only be changed when the
+   * engine is stopped.
+   */
+  Q_PROPERTY(SchedulingMode schedulingMode READ schedulingMode WRITE setSchedulingMode);
+
+  /**
+   * The number of worker threads used in `SharedScheduler` mode.
+   * Zero means the number of processor cores in the system. The
+   * default is zero. This property can only be changed when the
+   * engine is stopped.
+   */
+  Q_PROPERTY(int schedulerThreadCount READ schedulerThreadCount WRITE setSchedulerThreadCount);
+
+  /**
+   * Enables run-time statistics. If this flag is `true`, every
+   * PiiDefaultOperation in the engine records the time spent in
+   * process(), each input socket records its queue occupancy, and
+   * each output socket records the number of emitted objects and the
+   * time spent waiting for receivers. The statistics can be
+   * retrieved with [statistics()]. They are reset whenever the engine
+   * is started from `Stopped` state. The default value is `false`.
+   * This property can only be changed when the engine is stopped.
+   */
+  Q_PROPERTY(bool statisticsEnabled READ statisticsEnabled WRITE setStatisticsEnabled);
+
+  Q_ENUMS(FileFormat ErrorHandling SchedulingMode)
 
   friend struct PiiSerialization::Accessor;
   PII_SEPARATE_SAVE_LOAD_MEMBERS
@@ -103,6 +131,26 @@ public:
    */
   enum ErrorHandling { ThrowOnError, DisableFailingOperations };
 
+  /**
+   * Scheduling modes.
+   *
+   * - `ThreadPerOperation` - each operation whose
+   *   [threadCount](PiiDefaultOperation::threadCount) is non-zero
+   *   creates threads of its own.
+   *
+   * - `SharedScheduler` - operations whose `threadCount` is one and
+   *   that have at least one connected input are executed by a fixed
+   *   set of worker threads shared by the whole engine (see
+   *   [schedulerThreadCount]). Whenever such an operation has
+   *   objects to process, it is queued for execution in the worker
+   *   pool. Processing order and synchronization are not affected,
+   *   but the number of threads and context switches in large
+   *   configurations is greatly reduced. Producers (operations
+   *   without connected inputs) and operations with more than one
+   *   thread still create threads of their own.
+   */
+  enum SchedulingMode { ThreadPerOperation, SharedScheduler };
+
   class Plugin;
 
   /// Constructs a new PiiEngine.
@@ -277,6 +325,58 @@ public:
    */
   void execute(ErrorHandling erroHandling = ThrowOnError);
 
+  /**
+   * Installs the shared scheduler to child operations if
+   * [schedulingMode] is `SharedScheduler`, and checks all children.
+   */
+  void check(bool reset);
+
+  /**
+   * Returns a snapshot of the run-time statistics of all operations
+   * in the engine. The returned map uses the full names of operations
+   * as keys. Each value is a map with the following keys:
+   *
+   * - `processTime` - a map that contains the number of process()
+   *   calls (`count`), the total time spent in process()
+   *   (`totalTime`, in microseconds) and a histogram of durations
+   *   (`histogram`). The *i*th element of the histogram is the number
+   *   of calls that lasted less than 2<sup>i</sup> microseconds but
+   *   at least half of that.
+   *
+   * - `inputs` - a map from input names to maps with the keys
+   *   `received`, `rejected` (number of times the queue was full),
+   *   `averageQueueLength` and `maxQueueLength`.
+   *
+   * - `outputs` - a map from output names to maps with the keys
+   *   `emitted`, `objectsPerSecond` and `blockedTime` (a histogram of
+   *   the time spent waiting for full input queues, in the same
+   *   format as `processTime`).
+   *
+   * If [statisticsEnabled] is `false`, an empty map will be
+   * returned.
+   *
+   * ~~~(c++)
+   * QVariantMap mapStats = engine.statistics();
+   * QVariantMap mapProcessTime = mapStats["filter"].toMap()["processTime"].toMap();
+   * qDebug("filter: %lld calls, %lld us total",
+   *        mapProcessTime["count"].toLongLong(),
+   *        mapProcessTime["totalTime"].toLongLong());
+   * ~~~
+   */
+  Q_INVOKABLE QVariantMap statistics() const;
+
+  /**
+   * Resets all statistics.
+   */
+  Q_INVOKABLE void resetStatistics();
+
+  void setSchedulingMode(SchedulingMode schedulingMode);
+  SchedulingMode schedulingMode() const;
+  void setSchedulerThreadCount(int schedulerThreadCount);
+  int schedulerThreadCount() const;
+  void setStatisticsEnabled(bool statisticsEnabled);
+  bool statisticsEnabled() const;
+
   /**
    * Creates a deep copy of the engine.
    */
@@ -350,10 +450,26 @@ public:
                          QVariantMap* config = 0);
 
 protected:
+  /// @internal
+  class PII_YDIN_EXPORT Data : public PiiOperationCompound::Data
+  {
+  public:
+    Data();
+    ~Data();
+
+    SchedulingMode schedulingMode;
+    int iSchedulerThreadCount;
+    PiiOperationScheduler* pScheduler;
+    bool bStatisticsEnabled;
+  };
+  PII_D_FUNC;
+
   /// @internal
   PiiEngine(Data* data);
 
 private:
+  void installScheduler(PiiOperationScheduler* scheduler);
+
   typedef QHash<QString,Plugin> PluginMap;
   static QStringList compoundsUsedPlugins(PiiOperationCompound* compound);
   static QString operationsUsedPlugin(PiiOperation* operation);
@@ -29,10 +29,15 @@ PiiInputSocket::Data::Data() :
   bConnected(false),
   bOptional(false),
   pController(PiiNullInputController::instance()),
-  iQueueStart(0),
-  iQueueLength(0)
+  producerMode(SingleProducer),
+  pStatistics(0)
 {}
 
+PiiInputSocket::Data::~Data()
+{
+  delete pStatistics;
+}
+
 bool PiiInputSocket::Data::setInputConnected(bool connected)
 {
   return bConnected = connected;
@@ -70,27 +75,74 @@ void PiiInputSocket::setQueueCapacity(int queueCapacity)
 }
 
 void PiiInputSocket::receive(const PiiVariant& obj)
+{
+  tryReceive(obj);
+}
+
+bool PiiInputSocket::tryReceive(const PiiVariant& obj)
 {
   PII_D;
-  d->lstQueue[queueIndex(d->iQueueLength)] = obj;
-  ++d->iQueueLength;
+  const int iCapacity = d->lstQueue.size();
+  if (d->producerMode == SingleProducer)
+    {
+      // Nobody else moves the tail.
+      const int iTail = d->iPublished.load(), iHead = d->iHead.loadAcquire();
+      if (d->distance(iHead, iTail) >= iCapacity)
+        {
+          if (d->pStatistics != 0)
+            d->pStatistics->objectRejected();
+          return false;
+        }
+      d->lstQueue[d->slot(iTail)] = obj;
+      d->iPublished.fetchAndStore(d->next(iTail));
+      if (d->pStatistics != 0)
+        d->pStatistics->objectReceived(d->distance(iHead, iTail) + 1);
+      return true;
+    }
+
+  // Reserve a slot.
+  int iTail, iHead;
+  do
+    {
+      iTail = d->iReserved.loadAcquire();
+      iHead = d->iHead.loadAcquire();
+      if (d->distance(iHead, iTail) >= iCapacity)
+        {
+          if (d->pStatistics != 0)
+            d->pStatistics->objectRejected();
+          return false;
+        }
+    }
+  while (!d->iReserved.testAndSet(iTail, d->next(iTail)));
+
+  d->lstQueue[d->slot(iTail)] = obj;
+
+  // Publish in reservation order. Other producers are at most a
+  // slot assignment away.
+  while (!d->iPublished.testAndSet(iTail, d->next(iTail)))
+    QThread::yieldCurrentThread();
+  if (d->pStatistics != 0)
+    d->pStatistics->objectReceived(d->distance(iHead, iTail) + 1);
+  return true;
 }
 
 void PiiInputSocket::shift()
 {
   PII_D;
-  Q_ASSERT(d->iQueueLength > 0);
+  const int iHead = d->iHead.load();
+  Q_ASSERT(d->distance(iHead, d->iPublished.loadAcquire()) > 0);
 
   // Move queue head to the outgoing slot.
-  d->varProcessableObject = d->lstQueue[d->iQueueStart];
+  const int iSlot = d->slot(iHead);
+  d->varProcessableObject = d->lstQueue[iSlot];
   // Destroy the old head.
-  d->lstQueue[d->iQueueStart] = PiiVariant();
-  // Rotate the queue
-  d->iQueueStart = (d->iQueueStart+1) % d->lstQueue.size();
-  --d->iQueueLength;
+  d->lstQueue[iSlot] = PiiVariant();
+  // Rotate the queue. After this, producers may reuse the slot.
+  d->iHead.fetchAndStore(d->next(iHead));
   // Signal the sender if the queue was full (there may be a thread
   // waiting).
-  if (d->iQueueLength == d->lstQueue.size()-1 && d->pListener != 0)
+  const int iTail = d->producerMode == SingleProducer ? d->iPublished.load() : d->iReserved.load();
+  if (d->distance(iHead, iTail) == d->lstQueue.size() && d->pListener != 0)
     d->pListener->inputReady(this);
 }
 
@@ -136,7 +188,8 @@ void PiiInputSocket::jump(int oldIndex, int newIndex)
 int PiiInputSocket::indexOf(unsigned int type, int startIndex) const
 {
   const PII_D;
-  for (int i=startIndex; i<d->iQueueLength; ++i)
+  const int iQueueLength = queueLength();
+  for (int i=startIndex; i<iQueueLength; ++i)
     {
       int iQueueIndex = queueIndex(i);
       if (d->lstQueue[iQueueIndex].type() == type)
@@ -152,8 +205,17 @@ void PiiInputSocket::reset()
     d->lstQueue[i] = PiiVariant();
   d->varProcessableObject = PiiVariant();
   d->lstProcessableObjects.clear();
-  d->iQueueLength = 0;
-  d->iQueueStart = 0;
+  d->iHead.store(0);
+  d->iReserved.store(0);
+  d->iPublished.store(0);
+}
+
+void PiiInputSocket::setProducerMode(ProducerMode producerMode)
+{
+  PII_D;
+  d->producerMode = producerMode;
+  // Both modes must start from a consistent state.
+  d->iReserved.store(d->iPublished.load());
 }
 
 void PiiInputSocket::setController(PiiInputController* controller)
@@ -185,11 +247,60 @@ PiiVariant PiiInputSocket::firstObject() const
 
 
 PiiInputController* PiiInputSocket::controller() const { return _d()->pController; }
-PiiVariant PiiInputSocket::queuedObject(int index) const { return _d()->lstQueue[queueIndex(index)]; }
-unsigned int PiiInputSocket::queuedType(int index) const { return _d()->lstQueue[queueIndex(index)].type(); }
-int PiiInputSocket::queueLength() const { return _d()->iQueueLength; }
+
+PiiVariant PiiInputSocket::queuedObject(int index) const
+{
+  // Slots beyond the published part of the queue may be being
+  // written to.
+  if (index >= queueLength())
+    return PiiVariant();
+  return _d()->lstQueue[queueIndex(index)];
+}
+
+unsigned int PiiInputSocket::queuedType(int index) const
+{
+  if (index >= queueLength())
+    return PiiVariant::InvalidType;
+  return _d()->lstQueue[queueIndex(index)].type();
+}
+
+int PiiInputSocket::queueLength() const
+{
+  const PII_D;
+  return d->distance(d->iHead.load(), d->iPublished.loadAcquire());
+}
+
+bool PiiInputSocket::canReceive() const
+{
+  const PII_D;
+  const int iTail = d->producerMode == SingleProducer ? d->iPublished.load() : d->iReserved.load();
+  return d->distance(d->iHead.loadAcquire(), iTail) < d->lstQueue.size();
+}
+
+void PiiInputSocket::setStatisticsEnabled(bool statisticsEnabled)
+{
+  PII_D;
+  if (statisticsEnabled == (d->pStatistics != 0))
+    return;
+  if (statisticsEnabled)
+    d->pStatistics = new PiiOperationStatistics::InputStatistics;
+  else
+    {
+      delete d->pStatistics;
+      d->pStatistics = 0;
+    }
+}
+
+void PiiInputSocket::resetStatistics()
+{
+  PII_D;
+  if (d->pStatistics != 0)
+    d->pStatistics->reset();
+}
+
+const PiiOperationStatistics::InputStatistics* PiiInputSocket::statistics() const { return _d()->pStatistics; }
 int PiiInputSocket::queueCapacity() const { return _d()->lstQueue.size(); }
-bool PiiInputSocket::canReceive() const { return _d()->lstQueue.size() > _d()->iQueueLength; }
+PiiInputSocket::ProducerMode PiiInputSocket::producerMode() const { return _d()->producerMode; }
 void PiiInputSocket::setOptional(bool optional) { _d()->bOptional = optional; }
 bool PiiInputSocket::isOptional() const { return _d()->bOptional; }
 
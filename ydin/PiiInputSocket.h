@@ -19,7 +19,9 @@
 #include "PiiSocket.h"
 #include "PiiAbstractInputSocket.h"
 #include "PiiInputController.h"
+#include "PiiOperationStatistics.h"
 
+#include <PiiAtomicInt.h>
 #include <QVarLengthArray>
 #include <QPair>
 
@@ -70,6 +72,15 @@ class PiiOutputSocket;
  * can be retrieved with [firstObject()]. New objects may then appear
  * at any time until the queue is full again.
  *
+ * The input queue is a lock-free bounded ring buffer. Objects can be
+ * put into the queue with [tryReceive()] without holding any locks.
+ * The receiving side ([shift()], [queuedObject()], [jump()] etc.)
+ * must be serialized by the receiving operation, which is what the
+ * operation processors do. By default, the queue assumes that
+ * objects are sent by one thread at a time, which is always the case
+ * if the input is fed by a PiiOutputSocket. If the input may receive
+ * objects from many threads concurrently, the [producerMode] needs
+ * to be changed to `MultipleProducers`.
  */
 class PII_YDIN_EXPORT PiiInputSocket : public PiiAbstractInputSocket
 {
@@ -84,7 +95,29 @@ class PII_YDIN_EXPORT PiiInputSocket : public PiiAbstractInputSocket
    */
   Q_PROPERTY(int queueCapacity READ queueCapacity WRITE setQueueCapacity);
 
+  /**
+   * The number of threads that may concurrently send objects to the
+   * input queue. The default is `SingleProducer`. This property can
+   * only be changed when the parent operation is stopped.
+   */
+  Q_PROPERTY(ProducerMode producerMode READ producerMode WRITE setProducerMode);
+  Q_ENUMS(ProducerMode);
+
 public:
+  /**
+   * Producer modes for the input queue.
+   *
+   * - `SingleProducer` - objects are sent to the queue by at most
+   *   one thread at a time. This mode is the fastest one and always
+   *   applies if the input is connected to a PiiOutputSocket.
+   *
+   * - `MultipleProducers` - objects may be sent by any number of
+   *   threads concurrently. Producers first reserve a slot in the
+   *   queue with an atomic compare-and-swap and then publish their
+   *   objects in reservation order.
+   */
+  enum ProducerMode { SingleProducer, MultipleProducers };
+
   /**
    * Constructs a new input socket with the given name.
    */
@@ -177,10 +210,23 @@ public:
   void reset();
 
   /**
-   * Puts `obj` into the incoming queue.
+   * Puts `obj` into the incoming queue. The caller must ensure that
+   * the queue is not full, either by holding a lock that prevents
+   * concurrent calls or by checking [canReceive()] first. If the
+   * queue is full, the object will be discarded.
    */
   void receive(const PiiVariant& obj);
 
+  /**
+   * Puts `obj` into the incoming queue if there is room for it. This
+   * function needs no external synchronization with the receiving
+   * side and never blocks.
+   *
+   * @return `true` if the object was put into the queue, `false` if
+   * the queue was full.
+   */
+  bool tryReceive(const PiiVariant& obj);
+
   /**
    * Checks if the input queue in this socket still has room for a new
    * object. This function is a shorthand for queueCapacity() >
@@ -188,6 +234,30 @@ public:
    */
   bool canReceive() const;
 
+  void setProducerMode(ProducerMode producerMode);
+  ProducerMode producerMode() const;
+
+  /**
+   * Enables or disables the collection of statistics. If statistics
+   * are enabled, the number of received and rejected objects and the
+   * length of the input queue will be recorded. This function must
+   * not be called while the parent operation is running.
+   * PiiEngine calls this function automatically according to its
+   * [statisticsEnabled](PiiEngine::statisticsEnabled) property.
+   */
+  void setStatisticsEnabled(bool statisticsEnabled);
+
+  /**
+   * Returns the statistics of this input, or zero if statistics are
+   * not enabled.
+   */
+  const PiiOperationStatistics::InputStatistics* statistics() const;
+
+  /**
+   * Resets the statistics, if they are enabled.
+   */
+  void resetStatistics();
+
   /**
    * Sets the input queue capacity.
    */
@@ -245,6 +315,7 @@ protected:
   {
   public:
     Data();
+    ~Data();
 
     bool setInputConnected(bool connected);
 
@@ -255,8 +326,30 @@ protected:
     QVarLengthArray<PiiVariant, 4> lstQueue;
     PiiVariant varProcessableObject;
     QVarLengthArray<QPair<Qt::HANDLE, PiiVariant> > lstProcessableObjects;
-    int iQueueStart, iQueueLength;
+    /* Queue positions run from 0 to 2*capacity-1 so that a full queue
+     * can be distinguished from an empty one. iHead is moved by the
+     * receiver only. Producers move iReserved before writing to a
+     * slot and iPublished once the object is there. In
+     * SingleProducer mode, iReserved is not used.
+     */
+    PiiAtomicInt iHead, iReserved, iPublished;
+    ProducerMode producerMode;
     mutable QMutex firstObjectMutex;
+    PiiOperationStatistics::InputStatistics* pStatistics;
+
+    inline int distance(int from, int to) const
+    {
+      int iDistance = to - from;
+      return iDistance < 0 ? iDistance + 2*lstQueue.size() : iDistance;
+    }
+    inline int next(int position) const
+    {
+      return position + 1 == 2*lstQueue.size() ? 0 : position + 1;
+    }
+    inline int slot(int position) const
+    {
+      return position < lstQueue.size() ? position : position - lstQueue.size();
+    }
   };
   PII_D_FUNC;
 
@@ -264,7 +357,7 @@ protected:
   PiiInputSocket(const QString& name, Data* data);
 
 private:
-  inline int queueIndex(int index) const { return (_d()->iQueueStart+index) % _d()->lstQueue.size(); }
+  inline int queueIndex(int index) const { return (_d()->iHead.load()+index) % _d()->lstQueue.size(); }
 };
 
 Q_DECLARE_METATYPE(PiiInputSocket*);
@@ -0,0 +1,221 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiOperationScheduler.h"
+
+#include <PiiAtomicInt.h>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+#include <QVector>
+
+class PiiOperationScheduler::Worker : public QThread
+{
+public:
+  Worker(PiiOperationScheduler::Data* data, int index) :
+    _pData(data), _iIndex(index)
+  {}
+
+  void push(Task* task)
+  {
+    QMutexLocker lock(&_queueMutex);
+    _lstTasks.append(task);
+  }
+
+  // The owner takes tasks from the back ...
+  Task* takeLast()
+  {
+    QMutexLocker lock(&_queueMutex);
+    return _lstTasks.isEmpty() ? 0 : _lstTasks.takeLast();
+  }
+
+  // ... and thieves from the front.
+  Task* takeFirst()
+  {
+    QMutexLocker lock(&_queueMutex);
+    return _lstTasks.isEmpty() ? 0 : _lstTasks.takeFirst();
+  }
+
+  int remove(Task* task)
+  {
+    QMutexLocker lock(&_queueMutex);
+    return _lstTasks.removeAll(task);
+  }
+
+  int clear()
+  {
+    QMutexLocker lock(&_queueMutex);
+    int iCount = _lstTasks.size();
+    _lstTasks.clear();
+    return iCount;
+  }
+
+  PiiOperationScheduler::Data* scheduler() const { return _pData; }
+
+protected:
+  void run();
+
+private:
+  PiiOperationScheduler::Data* _pData;
+  int _iIndex;
+  QMutex _queueMutex;
+  QList<Task*> _lstTasks;
+};
+
+class PiiOperationScheduler::Data
+{
+public:
+  Data(int threadCount) :
+    iThreadCount(threadCount > 0 ? threadCount : qMax(QThread::idealThreadCount(), 1)),
+    bRunning(false)
+  {}
+
+  Task* nextTask(int workerIndex);
+
+  int iThreadCount;
+  volatile bool bRunning;
+  QVector<Worker*> vecWorkers;
+  PiiAtomicInt iQueuedTasks, iSleepingWorkers, iNextWorker;
+  QMutex sleepMutex;
+  QWaitCondition workCondition;
+};
+
+PiiOperationScheduler::Task::~Task() {}
+
+PiiOperationScheduler::Task* PiiOperationScheduler::Data::nextTask(int workerIndex)
+{
+  const int iWorkerCount = vecWorkers.size();
+  forever
+    {
+      if (!bRunning)
+        return 0;
+
+      // Own queue first, then try to steal from the others, starting
+      // from the next worker.
+      Task* pTask = vecWorkers[workerIndex]->takeLast();
+      for (int i=1; pTask == 0 && i<iWorkerCount; ++i)
+        pTask = vecWorkers[(workerIndex + i) % iWorkerCount]->takeFirst();
+
+      if (pTask != 0)
+        {
+          --iQueuedTasks;
+          return pTask;
+        }
+
+      // Nothing to do. The sleeping worker counter must be
+      // incremented before checking the task counter. submit() does
+      // the same in reverse order, which ensures that a wake-up
+      // signal cannot get lost.
+      QMutexLocker lock(&sleepMutex);
+      ++iSleepingWorkers;
+      if (bRunning && iQueuedTasks.load() <= 0)
+        workCondition.wait(&sleepMutex);
+      --iSleepingWorkers;
+    }
+}
+
+void PiiOperationScheduler::Worker::run()
+{
+  while (Task* pTask = _pData->nextTask(_iIndex))
+    pTask->execute();
+}
+
+PiiOperationScheduler::PiiOperationScheduler(int threadCount) :
+  d(new Data(threadCount))
+{
+}
+
+PiiOperationScheduler::~PiiOperationScheduler()
+{
+  stop();
+  delete d;
+}
+
+int PiiOperationScheduler::threadCount() const
+{
+  return d->iThreadCount;
+}
+
+void PiiOperationScheduler::start()
+{
+  if (d->bRunning)
+    return;
+
+  d->bRunning = true;
+  d->vecWorkers.resize(d->iThreadCount);
+  for (int i=0; i<d->iThreadCount; ++i)
+    d->vecWorkers[i] = new Worker(d, i);
+  for (int i=0; i<d->iThreadCount; ++i)
+    {
+      d->vecWorkers[i]->setObjectName(QString("PiiOperationScheduler %1").arg(i));
+      d->vecWorkers[i]->start();
+    }
+}
+
+void PiiOperationScheduler::stop()
+{
+  if (!d->bRunning)
+    return;
+
+  synchronized (&d->sleepMutex)
+    {
+      d->bRunning = false;
+      d->workCondition.wakeAll();
+    }
+
+  for (int i=0; i<d->vecWorkers.size(); ++i)
+    d->vecWorkers[i]->wait();
+
+  for (int i=0; i<d->vecWorkers.size(); ++i)
+    {
+      d->iQueuedTasks -= d->vecWorkers[i]->clear();
+      delete d->vecWorkers[i];
+    }
+  d->vecWorkers.clear();
+}
+
+bool PiiOperationScheduler::isRunning() const
+{
+  return d->bRunning;
+}
+
+void PiiOperationScheduler::submit(Task* task)
+{
+  if (!d->bRunning)
+    return;
+
+  // Workers push to their own queue. Others distribute tasks evenly.
+  Worker* pWorker = dynamic_cast<Worker*>(QThread::currentThread());
+  if (pWorker == 0 || pWorker->scheduler() != d)
+    pWorker = d->vecWorkers[(d->iNextWorker++ & 0x7fffffff) % d->vecWorkers.size()];
+
+  pWorker->push(task);
+  ++d->iQueuedTasks;
+
+  if (d->iSleepingWorkers.load() > 0)
+    synchronized (&d->sleepMutex) d->workCondition.wakeOne();
+}
+
+void PiiOperationScheduler::cancel(Task* task)
+{
+  for (int i=0; i<d->vecWorkers.size(); ++i)
+    d->iQueuedTasks -= d->vecWorkers[i]->remove(task);
+}
+
+bool PiiOperationScheduler::isWorkerThread() const
+{
+  Worker* pWorker = dynamic_cast<Worker*>(QThread::currentThread());
+  return pWorker != 0 && pWorker->scheduler() == d;
+}
@@ -0,0 +1,124 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIOPERATIONSCHEDULER_H
+#define _PIIOPERATIONSCHEDULER_H
+
+#include "PiiYdin.h"
+#include <QThread>
+
+/**
+ * A fixed-size pool of worker threads that execute operations on
+ * behalf of an engine. Instead of giving each threaded operation a
+ * thread of its own, [PiiEngine] can be configured to share one
+ * scheduler among all of its operations (see
+ * PiiEngine::schedulingMode). Whenever an operation has objects to
+ * process, it is submitted to the scheduler as a [task](Task).
+ *
+ * Each worker thread has a double-ended task queue of its own. Tasks
+ * submitted by a worker thread are pushed to the back of the
+ * worker's own queue, and the worker always takes its next task from
+ * the back. Consequently, an object emitted by an operation is
+ * usually processed by the receiving operation in the same thread
+ * right after the sender finishes, while the data is still in cache.
+ * Idle workers steal tasks from the front of other workers' queues.
+ * Tasks submitted from threads not owned by the scheduler are
+ * distributed to the workers in round-robin order.
+ *
+ * @internal
+ */
+class PII_YDIN_EXPORT PiiOperationScheduler
+{
+public:
+  /**
+   * An interface for objects that can be executed by the scheduler.
+   * The scheduler does not take the ownership of tasks.
+   */
+  class PII_YDIN_EXPORT Task
+  {
+  public:
+    virtual ~Task();
+
+    /**
+     * Executes the task in the context of a worker thread.
+     * Implementations must not throw exceptions.
+     */
+    virtual void execute() = 0;
+  };
+
+  /**
+   * Creates a new scheduler with *threadCount* worker threads. The
+   * threads will be created once [start()] is called. If
+   * *threadCount* is less than one, QThread::idealThreadCount() will
+   * be used.
+   */
+  PiiOperationScheduler(int threadCount = 0);
+
+  /**
+   * Stops the worker threads and destroys the scheduler.
+   */
+  ~PiiOperationScheduler();
+
+  /**
+   * Returns the number of worker threads.
+   */
+  int threadCount() const;
+
+  /**
+   * Creates and starts the worker threads. Does nothing if the
+   * threads are already running.
+   */
+  void start();
+
+  /**
+   * Stops all worker threads and waits until they have exited. Tasks
+   * that are still in queue will be discarded.
+   */
+  void stop();
+
+  /**
+   * Returns `true` if the worker threads are running and `false`
+   * otherwise.
+   */
+  bool isRunning() const;
+
+  /**
+   * Puts *task* into a queue for execution. The same task must not
+   * be submitted again before its execute() function has been
+   * called.
+   */
+  void submit(Task* task);
+
+  /**
+   * Removes all queued instances of *task*. If the task is currently
+   * being executed, this function does not wait for it to finish.
+   */
+  void cancel(Task* task);
+
+  /**
+   * Returns `true` if the calling thread is one of the worker threads
+   * of this scheduler and `false` otherwise.
+   */
+  bool isWorkerThread() const;
+
+private:
+  class Worker;
+  class Data;
+  Data* d;
+
+  PII_DISABLE_COPY(PiiOperationScheduler);
+};
+
+#endif //_PIIOPERATIONSCHEDULER_H
@@ -0,0 +1,200 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiOperationStatistics.h"
+#include "PiiDefaultOperation.h"
+
+#include <PiiTimer.h>
+
+// The low part of a counter carries over at this limit.
+static const int iCarryLimit = 1 << 28;
+
+void PiiOperationStatistics::Counter::addPart(int value)
+{
+  int iLow = (_iLow += value);
+  // Many threads may see the same overflow. Each of them moves
+  // iCarryLimit to the high part, which may temporarily make the low
+  // part negative. The sum is always correct.
+  while (iLow >= iCarryLimit)
+    {
+      iLow = (_iLow -= iCarryLimit);
+      ++_iHigh;
+    }
+}
+
+void PiiOperationStatistics::Counter::add(qint64 value)
+{
+  while (value > iCarryLimit)
+    {
+      addPart(iCarryLimit);
+      value -= iCarryLimit;
+    }
+  addPart(int(value));
+}
+
+qint64 PiiOperationStatistics::Counter::value() const
+{
+  return qint64(_iHigh.load()) * iCarryLimit + _iLow.load();
+}
+
+void PiiOperationStatistics::Counter::reset()
+{
+  _iHigh.store(0);
+  _iLow.store(0);
+}
+
+void PiiOperationStatistics::TimeHistogram::add(qint64 microseconds)
+{
+  int iBucket = 0;
+  for (qint64 lTime = microseconds; lTime > 0 && iBucket < BucketCount-1; lTime >>= 1)
+    ++iBucket;
+  ++_aiBuckets[iBucket];
+  _count.add(1);
+  _totalTime.add(microseconds);
+}
+
+void PiiOperationStatistics::TimeHistogram::reset()
+{
+  for (int i=0; i<BucketCount; ++i)
+    _aiBuckets[i].store(0);
+  _count.reset();
+  _totalTime.reset();
+}
+
+QVariantMap PiiOperationStatistics::TimeHistogram::toVariantMap() const
+{
+  int iLastBucket = BucketCount;
+  while (iLastBucket > 0 && _aiBuckets[iLastBucket-1].load() == 0)
+    --iLastBucket;
+
+  QVariantList lstHistogram;
+  for (int i=0; i<iLastBucket; ++i)
+    lstHistogram << _aiBuckets[i].load();
+
+  QVariantMap mapResult;
+  mapResult["count"] = count();
+  mapResult["totalTime"] = totalTime();
+  mapResult["histogram"] = lstHistogram;
+  return mapResult;
+}
+
+void PiiOperationStatistics::InputStatistics::objectReceived(int queueLength)
+{
+  received.add(1);
+  queueLengthSum.add(queueLength);
+  for (int iMax = iMaxQueueLength.load(); queueLength > iMax; iMax = iMaxQueueLength.load())
+    if (iMaxQueueLength.testAndSet(iMax, queueLength))
+      break;
+}
+
+void PiiOperationStatistics::InputStatistics::reset()
+{
+  received.reset();
+  rejected.reset();
+  queueLengthSum.reset();
+  iMaxQueueLength.store(0);
+}
+
+QVariantMap PiiOperationStatistics::InputStatistics::toVariantMap() const
+{
+  const qint64 lReceived = received.value();
+  QVariantMap mapResult;
+  mapResult["received"] = lReceived;
+  mapResult["rejected"] = rejected.value();
+  mapResult["averageQueueLength"] = lReceived > 0 ? double(queueLengthSum.value()) / lReceived : 0.0;
+  mapResult["maxQueueLength"] = iMaxQueueLength.load();
+  return mapResult;
+}
+
+PiiOperationStatistics::OutputStatistics::OutputStatistics() :
+  lResetTime(clock())
+{}
+
+void PiiOperationStatistics::OutputStatistics::reset()
+{
+  emitted.reset();
+  blockedTime.reset();
+  lResetTime = clock();
+}
+
+QVariantMap PiiOperationStatistics::OutputStatistics::toVariantMap() const
+{
+  const qint64 lEmitted = emitted.value(), lElapsed = clock() - lResetTime;
+  QVariantMap mapResult;
+  mapResult["emitted"] = lEmitted;
+  mapResult["objectsPerSecond"] = lElapsed > 0 ? lEmitted * 1e6 / lElapsed : 0.0;
+  mapResult["blockedTime"] = blockedTime.toVariantMap();
+  return mapResult;
+}
+
+void PiiOperationStatistics::reset()
+{
+  processTime.reset();
+}
+
+QVariantMap PiiOperationStatistics::toVariantMap() const
+{
+  QVariantMap mapResult;
+  mapResult["processTime"] = processTime.toVariantMap();
+  return mapResult;
+}
+
+qint64 PiiOperationStatistics::clock()
+{
+  static PiiTimer globalClock;
+  return globalClock.microseconds();
+}
+
+static void collectOperation(PiiDefaultOperation* operation, QVariantMap& result)
+{
+  const PiiOperationStatistics* pStatistics = operation->statistics();
+  if (pStatistics == 0)
+    return;
+
+  QVariantMap mapOperation(pStatistics->toVariantMap());
+
+  QVariantMap mapInputs;
+  for (int i=0; i<operation->inputCount(); ++i)
+    {
+      PiiInputSocket* pInput = operation->inputAt(i);
+      if (pInput->statistics() != 0)
+        mapInputs[pInput->objectName()] = pInput->statistics()->toVariantMap();
+    }
+  mapOperation["inputs"] = mapInputs;
+
+  QVariantMap mapOutputs;
+  for (int i=0; i<operation->outputCount(); ++i)
+    {
+      PiiOutputSocket* pOutput = operation->outputAt(i);
+      if (pOutput->statistics() != 0)
+        mapOutputs[pOutput->objectName()] = pOutput->statistics()->toVariantMap();
+    }
+  mapOperation["outputs"] = mapOutputs;
+
+  result[operation->fullName()] = mapOperation;
+}
+
+QVariantMap PiiOperationStatistics::collect(PiiOperation* operation)
+{
+  QVariantMap mapResult;
+  PiiDefaultOperation* pOperation = qobject_cast<PiiDefaultOperation*>(operation);
+  if (pOperation != 0)
+    collectOperation(pOperation, mapResult);
+
+  QList<PiiDefaultOperation*> lstChildren = operation->findChildren<PiiDefaultOperation*>();
+  for (int i=0; i<lstChildren.size(); ++i)
+    collectOperation(lstChildren[i], mapResult);
+  return mapResult;
+}
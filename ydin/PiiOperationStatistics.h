@@ -0,0 +1,185 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIIOPERATIONSTATISTICS_H
+#define _PIIOPERATIONSTATISTICS_H
+
+#include "PiiYdin.h"
+#include <PiiAtomicInt.h>
+#include <QVariantMap>
+
+class PiiOperation;
+
+/**
+ * Run-time statistics of an operation and its sockets. Statistics
+ * are collected only if they have been enabled with
+ * PiiEngine::statisticsEnabled. The collection is designed to be
+ * cheap enough for production use: all values are updated with
+ * atomic operations in the thread that produces them, and no locks
+ * are ever taken.
+ *
+ * All times are measured in microseconds. Use [collect()] to get a
+ * snapshot of the statistics of a whole configuration.
+ *
+ * @internal
+ */
+class PII_YDIN_EXPORT PiiOperationStatistics
+{
+public:
+  /**
+   * A counter whose value may exceed the range of a 32-bit integer.
+   * Since 64-bit atomic integers are not available on all supported
+   * platforms, the value is stored in two 32-bit atomic integers.
+   * The low part carries to the high part whenever it exceeds a
+   * limit. Concurrent readers may see a slightly outdated value, but
+   * no increments will ever be lost.
+   */
+  class PII_YDIN_EXPORT Counter
+  {
+  public:
+    void add(qint64 value);
+    qint64 value() const;
+    void reset();
+
+  private:
+    inline void addPart(int value);
+    PiiAtomicInt _iHigh, _iLow;
+  };
+
+  /**
+   * A histogram of durations. Bucket 0 counts durations shorter than
+   * one microsecond. Bucket *i* > 0 counts durations of at least
+   * 2<sup>i-1</sup> but less than 2<sup>i</sup> microseconds. The
+   * last bucket collects everything longer.
+   */
+  class PII_YDIN_EXPORT TimeHistogram
+  {
+  public:
+    enum { BucketCount = 32 };
+
+    void add(qint64 microseconds);
+    void reset();
+
+    /// Returns the number of durations recorded.
+    qint64 count() const { return _count.value(); }
+    /// Returns the sum of all durations.
+    qint64 totalTime() const { return _totalTime.value(); }
+    /// Returns the number of durations in *bucket*.
+    int bucket(int bucket) const { return _aiBuckets[bucket].load(); }
+
+    /**
+     * Returns the histogram as a map with the keys "count",
+     * "totalTime" and "histogram". Trailing empty buckets are left
+     * out of the histogram.
+     */
+    QVariantMap toVariantMap() const;
+
+  private:
+    PiiAtomicInt _aiBuckets[BucketCount];
+    Counter _count, _totalTime;
+  };
+
+  /**
+   * Statistics of an input socket.
+   */
+  class PII_YDIN_EXPORT InputStatistics
+  {
+  public:
+    InputStatistics() : iMaxQueueLength(0) {}
+
+    /**
+     * Records a received object. *queueLength* is the length of the
+     * input queue after the object was put there.
+     */
+    void objectReceived(int queueLength);
+    /// Records an object rejected due to a full queue.
+    void objectRejected() { rejected.add(1); }
+    void reset();
+
+    /**
+     * Returns the statistics as a map with the keys "received",
+     * "rejected", "averageQueueLength" and "maxQueueLength".
+     */
+    QVariantMap toVariantMap() const;
+
+    /// The number of objects received.
+    Counter received;
+    /// The number of times the queue was full.
+    Counter rejected;
+    /// The sum of queue lengths after each received object.
+    Counter queueLengthSum;
+    PiiAtomicInt iMaxQueueLength;
+  };
+
+  /**
+   * Statistics of an output socket.
+   */
+  class PII_YDIN_EXPORT OutputStatistics
+  {
+  public:
+    OutputStatistics();
+
+    void reset();
+
+    /**
+     * Returns the statistics as a map with the keys "emitted",
+     * "objectsPerSecond" and "blockedTime". Objects per second is
+     * calculated over the time since the last reset.
+     */
+    QVariantMap toVariantMap() const;
+
+    /// The number of objects emitted.
+    Counter emitted;
+    /// The time spent waiting for full input queues.
+    TimeHistogram blockedTime;
+    /// The time of the last reset, see [PiiOperationStatistics::clock()].
+    qint64 lResetTime;
+  };
+
+  /**
+   * Records a completed call to process().
+   */
+  void processed(qint64 microseconds) { processTime.add(microseconds); }
+
+  void reset();
+
+  /**
+   * Returns the operation's statistics as a map with the key
+   * "processTime".
+   */
+  QVariantMap toVariantMap() const;
+
+  /// The time spent in process().
+  TimeHistogram processTime;
+
+  /**
+   * Returns a monotonic time stamp in microseconds. The time stamps
+   * are shared by all statistics and comparable to each other.
+   */
+  static qint64 clock();
+
+  /**
+   * Collects the statistics of *operation* and all operations
+   * contained in it. The returned map uses the
+   * [full names](PiiOperation::fullName()) of operations as keys.
+   * Each value is a map that contains the operation's statistics
+   * (see [toVariantMap()]). In addition, the keys "inputs" and
+   * "outputs" contain maps from socket names to socket statistics.
+   * Operations with no statistics are left out.
+   */
+  static QVariantMap collect(PiiOperation* operation);
+};
+
+#endif //_PIIOPERATIONSTATISTICS_H
@@ -17,6 +17,7 @@
 #include "PiiInputSocket.h"
 #include "PiiYdinTypes.h"
 #include "PiiOperation.h"
+#include "PiiTraceRecorder.h"
 
 #include <PiiUtil.h>
 #include <PiiSerializableExport.h> // MSVC
@@ -28,18 +29,19 @@ using namespace PiiYdin;
 PiiOutputSocket::Data::Data() :
   PiiAbstractOutputSocket::Data(),
   iGroupId(0),
-  freeInputCondition(PiiWaitCondition::NoQueue),
   pFirstInput(0),
   pFirstController(0),
   bInterrupted(false),
   pbInputCompleted(0),
-  activeThreadId(0)
+  activeThreadId(0),
+  pStatistics(0)
 {}
 
 PiiOutputSocket::Data::~Data()
 {
   delete[] pbInputCompleted;
   pbInputCompleted = 0;
+  delete pStatistics;
 }
 
 bool PiiOutputSocket::Data::setOutputConnected(bool connected)
@@ -117,8 +119,8 @@ void PiiOutputSocket::interrupt()
 {
   PII_D;
   d->bInterrupted = true;
-  // Bypass any forthcoming wait() call.
-  d->freeInputCondition.wakeOne();
+  // Bypass any forthcoming park() call.
+  d->freeInputCondition.unpark();
   d->state = PiiSocketState();
 }
 
@@ -126,7 +128,7 @@ void PiiOutputSocket::reset()
 {
   PII_D;
   d->bInterrupted = false;
-  d->freeInputCondition.wakeAll();
+  d->freeInputCondition.unparkAll();
   d->lstBuffer.clear();
   d->activeThreadId = 0;
 }
@@ -207,8 +209,12 @@ void PiiOutputSocket::startEmit(Qt::HANDLE activeThreadId)
   //piiDebug("Start %p (%d)", (void*)activeThreadId, d->lstThreads.size());
   // Must check that the thread isn't already in queue. If it is, wait
   // until it is finished.
-  while (d->queueIndex(activeThreadId) != -1 && !d->bInterrupted)
-    d->endEmitCondition.wait(&d->emitLock, 100);
+  if (d->queueIndex(activeThreadId) != -1)
+    {
+      PiiTraceRecorder::Scope trace(PiiTraceRecorder::Emit, this);
+      while (d->queueIndex(activeThreadId) != -1 && !d->bInterrupted)
+        d->endEmitCondition.wait(&d->emitLock, 100);
+    }
 
   d->lstThreads.append(ThreadInfo(activeThreadId));
 }
@@ -216,11 +222,20 @@ void PiiOutputSocket::startEmit(Qt::HANDLE activeThreadId)
 void PiiOutputSocket::endEmit(Qt::HANDLE activeThreadId)
 {
   PII_D;
+  if (tryEndEmit(activeThreadId))
+    return;
+
+  PiiTraceRecorder::Scope trace(PiiTraceRecorder::Emit, this);
+  const qint64 lBlockStart = d->pStatistics != 0 ? PiiOperationStatistics::clock() : 0;
   do
     {
+      d->freeInputCondition.park();
       if (tryEndEmit(activeThreadId))
-        return;
-      d->freeInputCondition.wait();
+        {
+          if (d->pStatistics != 0)
+            d->pStatistics->blockedTime.add(PiiOperationStatistics::clock() - lBlockStart);
+          return;
+        }
     }
   while (!d->bInterrupted);
   throw PiiExecutionException(PiiExecutionException::Interrupted);
@@ -257,6 +272,8 @@ bool PiiOutputSocket::tryEndEmit(Qt::HANDLE activeThreadId)
 
 void PiiOutputSocket::emitObject(const PiiVariant& object)
 {
+  if (_d()->pStatistics != 0)
+    _d()->pStatistics->emitted.add(1);
   if (_d()->lstThreads.isEmpty())
     emitNonThreaded(object);
   else
@@ -287,7 +304,7 @@ bool PiiOutputSocket::tryEmit(const PiiVariant& object)
   if (bAllCompleted)
     {
       Pii::fillN(d->pbInputCompleted, d->lstInputs.size(), false);
-      d->freeInputCondition.wakeAll();
+      d->freeInputCondition.unparkAll();
     }
 
   return bAllCompleted;
@@ -296,12 +313,21 @@ bool PiiOutputSocket::tryEmit(const PiiVariant& object)
 void PiiOutputSocket::emitNonThreaded(const PiiVariant& object)
 {
   PII_D;
+  if (tryEmit(object))
+    return;
+
   // Try to send until the object is successfully received.
+  PiiTraceRecorder::Scope trace(PiiTraceRecorder::Emit, this);
+  const qint64 lBlockStart = d->pStatistics != 0 ? PiiOperationStatistics::clock() : 0;
   do
     {
+      d->freeInputCondition.park();
       if (tryEmit(object))
-        return;
-      d->freeInputCondition.wait();
+        {
+          if (d->pStatistics != 0)
+            d->pStatistics->blockedTime.add(PiiOperationStatistics::clock() - lBlockStart);
+          return;
+        }
     }
   while (!d->bInterrupted);
   throw PiiExecutionException(PiiExecutionException::Interrupted);
@@ -309,7 +335,7 @@ void PiiOutputSocket::emitNonThreaded(const PiiVariant& object)
 
 void PiiOutputSocket::Data::inputReady(PiiAbstractInputSocket* /*input*/)
 {
-  freeInputCondition.wakeOne();
+  freeInputCondition.unpark();
 }
 
 void PiiOutputSocket::synchronizeTo(PiiInputSocket* input)
@@ -351,6 +377,32 @@ void PiiOutputSocket::endMany()
   _d()->state.flowLevel.deref();
 }
 
+void PiiOutputSocket::setStatisticsEnabled(bool statisticsEnabled)
+{
+  PII_D;
+  if (statisticsEnabled == (d->pStatistics != 0))
+    return;
+  if (statisticsEnabled)
+    d->pStatistics = new PiiOperationStatistics::OutputStatistics;
+  else
+    {
+      delete d->pStatistics;
+      d->pStatistics = 0;
+    }
+}
+
+void PiiOutputSocket::resetStatistics()
+{
+  PII_D;
+  if (d->pStatistics != 0)
+    d->pStatistics->reset();
+}
+
+const PiiOperationStatistics::OutputStatistics* PiiOutputSocket::statistics() const
+{
+  return _d()->pStatistics;
+}
+
 void PiiOutputSocket::setInputListener(PiiInputListener* listener)
 {
   if (listener == 0) listener = _d();
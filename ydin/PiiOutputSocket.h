@@ -21,10 +21,12 @@
 #include "PiiSocketState.h"
 #include "PiiExecutionException.h"
 #include "PiiInputListener.h"
+#include "PiiOperationStatistics.h"
 
 #include <PiiVariant.h>
 #include <PiiMatrix.h>
 #include <PiiWaitCondition.h>
+#include <PiiParker.h>
 
 #include <QLinkedList>
 #include <QVarLengthArray>
@@ -344,6 +346,27 @@ public:
    */
   void setInputListener(PiiInputListener* listener = 0);
 
+  /**
+   * Enables or disables the collection of statistics. If statistics
+   * are enabled, the number of emitted objects and the time spent
+   * waiting for receivers will be recorded. This function must not
+   * be called while the parent operation is running. PiiEngine calls
+   * this function automatically according to its
+   * [statisticsEnabled](PiiEngine::statisticsEnabled) property.
+   */
+  void setStatisticsEnabled(bool statisticsEnabled);
+
+  /**
+   * Returns the statistics of this output, or zero if statistics are
+   * not enabled.
+   */
+  const PiiOperationStatistics::OutputStatistics* statistics() const;
+
+  /**
+   * Resets the statistics, if they are enabled.
+   */
+  void resetStatistics();
+
 protected:
   /// @hide
   struct ThreadInfo
@@ -380,9 +403,8 @@ protected:
 
     int iGroupId;
     bool bConnected;
-    // A wait condition that is used when some inputs aren't ready to
-    // receive new objects.
-    PiiWaitCondition freeInputCondition, *pFreeInputCondition;
+    // Used when some inputs aren't ready to receive new objects.
+    PiiParker freeInputCondition;
     PiiAbstractInputSocket* pFirstInput;
     PiiInputController* pFirstController;
     bool bInterrupted;
@@ -393,6 +415,7 @@ protected:
     ThreadList lstThreads;
     QMutex emitLock;
     QWaitCondition endEmitCondition;
+    PiiOperationStatistics::OutputStatistics* pStatistics;
   };
   PII_UNSAFE_D_FUNC;
 
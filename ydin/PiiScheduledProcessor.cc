@@ -0,0 +1,328 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#include "PiiDefaultOperation.h"
+#include "PiiScheduledProcessor.h"
+
+#include <PiiTimer.h>
+
+PiiScheduledProcessor::PiiScheduledProcessor(PiiDefaultOperation* parent, PiiOperationScheduler* scheduler) :
+  PiiOperationProcessor(parent),
+  _pScheduler(scheduler),
+  _pStateMutex(parent->stateLock()),
+  _priority(QThread::InheritPriority),
+  _bScheduled(false), _bExecuting(false), _bPending(false)
+{
+}
+
+PiiScheduledProcessor::~PiiScheduledProcessor()
+{
+  _pScheduler->cancel(this);
+  QMutexLocker lock(&_taskMutex);
+  while (_bExecuting)
+    _idleCondition.wait(&_taskMutex);
+}
+
+bool PiiScheduledProcessor::isActive() const
+{
+  return _pParentOp->state() not_member_of (PiiOperation::Stopped, PiiOperation::Interrupted);
+}
+
+// _pStateMutex must be held when calling this function
+void PiiScheduledProcessor::schedule()
+{
+  QMutexLocker lock(&_taskMutex);
+  _bPending = true;
+  // If a worker is already running (or about to run) the operation,
+  // it will see the new objects anyway.
+  if (!_bScheduled && !_bExecuting)
+    {
+      _bScheduled = true;
+      _pScheduler->submit(this);
+    }
+}
+
+void PiiScheduledProcessor::execute()
+{
+  synchronized (&_taskMutex) _bScheduled = false;
+  processQueued();
+}
+
+bool PiiScheduledProcessor::processQueued()
+{
+  synchronized (_pStateMutex)
+    {
+      if (!isActive())
+        return false;
+      QMutexLocker lock(&_taskMutex);
+      if (_bExecuting)
+        return false;
+      _bExecuting = true;
+
+      // A paused operation resumes once it receives new objects.
+      if (_pParentOp->state() == PiiOperation::Paused)
+        _pParentOp->setState(PiiOperation::Running);
+    }
+
+  bool bFinished = false;
+  try
+    {
+      prepareAndProcess();
+    }
+  catch (PiiExecutionException& ex)
+    {
+      _pStateMutex->lock();
+      if (ex.code() == PiiExecutionException::Paused &&
+          _pParentOp->state() != PiiOperation::Interrupted)
+        {
+          _pParentOp->setState(PiiOperation::Paused);
+          _pStateMutex->unlock();
+        }
+      // Any other reason will cause termination.
+      else
+        {
+          bFinished = true;
+          _pParentOp->setState(PiiOperation::Stopping);
+          _pStateMutex->unlock();
+          if (ex.code() == PiiExecutionException::Error)
+            emit _pParentOp->errorOccured(_pParentOp, ex.message());
+        }
+    }
+
+  synchronized (_pStateMutex)
+    {
+      if (bFinished || _pParentOp->state() == PiiOperation::Interrupted)
+        _pParentOp->setState(PiiOperation::Stopped);
+
+      QMutexLocker lock(&_taskMutex);
+      _bExecuting = false;
+      // Objects may have arrived after the flow controller was last
+      // called.
+      if (_bPending && !_bScheduled && isActive())
+        {
+          _bScheduled = true;
+          _pScheduler->submit(this);
+        }
+      _idleCondition.wakeAll();
+    }
+  return true;
+}
+
+void PiiScheduledProcessor::prepareAndProcess()
+{
+  QMutexLocker lock(_pStateMutex);
+  while (_pParentOp->state() != PiiOperation::Interrupted)
+    {
+      // Everything received so far will be handled by this loop.
+      synchronized (&_taskMutex) _bPending = false;
+
+      PiiFlowController::FlowState state = _pFlowController->prepareProcess(); // may throw
+      if (state == PiiFlowController::IncompleteState)
+        return;
+
+      lock.unlock();
+
+      _pParentOp->sendSyncEvents(_pFlowController);
+
+      switch (state)
+        {
+        case PiiFlowController::ProcessableState:
+          _pParentOp->processLocked();
+        case PiiFlowController::SynchronizedState:
+        case PiiFlowController::IncompleteState:
+          break;
+        case PiiFlowController::ReconfigurableState:
+          _pParentOp->applyPropertySet(_pFlowController->propertySetName()); // may throw
+          break;
+        case PiiFlowController::PausedState:
+          _pParentOp->operationPaused(); // throws
+        case PiiFlowController::FinishedState:
+          _pParentOp->operationStopped(); // throws
+        case PiiFlowController::ResumedState:
+          _pParentOp->operationResumed(); // may throw
+          break;
+        }
+      lock.relock();
+    }
+}
+
+bool PiiScheduledProcessor::tryToReceive(PiiAbstractInputSocket* sender,
+                                         const PiiVariant& object) throw ()
+{
+  PiiInputSocket* pInput = static_cast<PiiInputSocket*>(sender);
+  synchronized (_pStateMutex)
+    {
+      if (pInput->canReceive())
+        {
+          pInput->receive(object);
+          if (isActive())
+            schedule();
+          return true;
+        }
+    }
+
+  // The input queue is full. If the sender is a worker thread and
+  // nobody is processing this operation, the sender needs to help.
+  // Otherwise all workers may end up waiting for each other.
+  if (!_pScheduler->isWorkerThread() || !processQueued())
+    return false;
+
+  QMutexLocker lock(_pStateMutex);
+  if (!pInput->canReceive())
+    return false;
+  pInput->receive(object);
+  if (isActive())
+    schedule();
+  return true;
+}
+
+void PiiScheduledProcessor::check(bool reset)
+{
+  if (reset)
+    {
+      // Tasks queued during the previous run may have been discarded.
+      _pScheduler->cancel(this);
+      QMutexLocker lock(&_taskMutex);
+      _bScheduled = _bPending = false;
+    }
+}
+
+void PiiScheduledProcessor::start()
+{
+  QMutexLocker lock(_pStateMutex);
+  if (_pParentOp->state() == PiiOperation::Stopped)
+    _pParentOp->setState(PiiOperation::Running);
+  else if (_pParentOp->state() == PiiOperation::Paused)
+    {
+      _pParentOp->setState(PiiOperation::Running);
+      // Ensure that input queues will be emptied if something was
+      // there before pause.
+      if (_pFlowController != 0)
+        schedule();
+      else
+        {
+          try { _pParentOp->operationResumed(); } catch (...) {}
+        }
+    }
+}
+
+void PiiScheduledProcessor::interrupt()
+{
+  QMutexLocker lock(_pStateMutex);
+  if (_pParentOp->state() == PiiOperation::Stopped)
+    return;
+
+  QMutexLocker taskLock(&_taskMutex);
+  // If a worker is currently running the operation, it will change
+  // the state to Stopped once it is done.
+  if (_bExecuting)
+    _pParentOp->setState(PiiOperation::Interrupted);
+  else
+    {
+      _pParentOp->setState(PiiOperation::Stopped);
+      _idleCondition.wakeAll();
+    }
+}
+
+void PiiScheduledProcessor::pause()
+{
+  stop(PiiOperation::Paused);
+}
+
+void PiiScheduledProcessor::stop()
+{
+  stop(PiiOperation::Stopped);
+}
+
+void PiiScheduledProcessor::stop(PiiOperation::State finalState)
+{
+  QMutexLocker lock(_pStateMutex);
+  if (_pParentOp->state() != PiiOperation::Running)
+    return;
+
+  // With connected inputs, the state will change once the flow
+  // controller receives pause/stop tags.
+  if (_pFlowController != 0)
+    {
+      _pParentOp->setState(finalState == PiiOperation::Stopped ?
+                           PiiOperation::Stopping :
+                           PiiOperation::Pausing);
+      return;
+    }
+  lock.unlock();
+
+  try
+    {
+      if (finalState == PiiOperation::Paused)
+        _pParentOp->operationPaused(); // throws
+      else
+        _pParentOp->operationStopped(); // throws
+    }
+  catch (...)
+    {
+      synchronized (_pStateMutex) _pParentOp->setState(finalState);
+    }
+  synchronized (&_taskMutex) _idleCondition.wakeAll();
+}
+
+void PiiScheduledProcessor::reconfigure(const QString& propertySetName)
+{
+  try
+    {
+      // At least one connected input -> reconfigure only after
+      // receiving tags.
+      if (_pFlowController != 0)
+        return;
+
+      // Set properties and send tags.
+      _pParentOp->applyPropertySet(propertySetName); // may throw
+    }
+  catch (PiiExecutionException& ex)
+    {
+      emit _pParentOp->errorOccured(_pParentOp,
+                                    QCoreApplication::translate("PiiDefaultOperation",
+                                                                "Reconfiguring %1 failed. %2")
+                                    .arg(_pParentOp->metaObject()->className()).arg(ex.message()));
+    }
+}
+
+bool PiiScheduledProcessor::wait(unsigned long time)
+{
+  PiiTimer timer;
+  QMutexLocker lock(&_taskMutex);
+  while (_bExecuting || _pParentOp->state() != PiiOperation::Stopped)
+    {
+      unsigned long ulElapsed = (unsigned long)timer.milliseconds();
+      if (ulElapsed >= time)
+        return false;
+      _idleCondition.wait(&_taskMutex, qMin((unsigned long)100, time - ulElapsed));
+    }
+  return true;
+}
+
+void PiiScheduledProcessor::setProcessingPriority(QThread::Priority priority)
+{
+  _priority = priority;
+}
+
+QThread::Priority PiiScheduledProcessor::processingPriority() const
+{
+  return _priority;
+}
+
+int PiiScheduledProcessor::activeInputGroup() const
+{
+  return _pFlowController->activeInputGroup();
+}
@@ -0,0 +1,93 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+#ifndef _PIISCHEDULEDPROCESSOR_H
+#define _PIISCHEDULEDPROCESSOR_H
+
+#include "PiiOperationProcessor.h"
+#include "PiiOperationScheduler.h"
+
+#include <QMutex>
+#include <QWaitCondition>
+
+/**
+ * A processor that executes its parent operation in the worker
+ * threads of a shared PiiOperationScheduler. Semantically, the
+ * processor is equivalent to PiiThreadedProcessor: process() and
+ * syncEvent() are never called concurrently, and objects are
+ * processed in the order the flow controller releases them. Instead
+ * of sleeping in a thread of its own, the processor submits itself
+ * to the scheduler whenever new objects arrive.
+ *
+ * If a worker thread tries to send an object to a full input queue
+ * and the receiving operation is not being executed by any thread,
+ * the worker processes the queued objects itself. This ensures that
+ * a fixed number of worker threads can never end up waiting for each
+ * other.
+ *
+ * @internal
+ */
+class PiiScheduledProcessor :
+  public PiiOperationProcessor,
+  public PiiOperationScheduler::Task
+{
+public:
+  PiiScheduledProcessor(PiiDefaultOperation* parent, PiiOperationScheduler* scheduler);
+  ~PiiScheduledProcessor();
+
+  void check(bool reset);
+  void start();
+  void interrupt();
+  void pause();
+  void stop();
+  void reconfigure(const QString& propertySetName);
+
+  /**
+   * Waits until the operation has stopped and no worker thread is
+   * executing it.
+   */
+  bool wait(unsigned long time = ULONG_MAX);
+
+  bool tryToReceive(PiiAbstractInputSocket* sender, const PiiVariant& object) throw ();
+
+  /**
+   * Worker threads are shared, and their priority cannot be changed
+   * per operation. The priority is stored but has no effect.
+   */
+  void setProcessingPriority(QThread::Priority priority);
+  QThread::Priority processingPriority() const;
+
+  int activeInputGroup() const;
+
+  void execute();
+
+private:
+  inline bool isActive() const;
+  inline void schedule();
+  bool processQueued();
+  void prepareAndProcess();
+  void stop(PiiOperation::State finalState);
+
+  PiiOperationScheduler* _pScheduler;
+  QMutex* _pStateMutex;
+  QThread::Priority _priority;
+  // Protects the scheduling flags below. Always locked after
+  // _pStateMutex, if both are needed.
+  QMutex _taskMutex;
+  QWaitCondition _idleCondition;
+  bool _bScheduled, _bExecuting, _bPending;
+};
+
+#endif //_PIISCHEDULEDPROCESSOR_H
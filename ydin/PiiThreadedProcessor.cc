@@ -18,7 +18,7 @@
 
 PiiThreadedProcessor::PiiThreadedProcessor(PiiDefaultOperation* parent) :
   PiiOperationProcessor(parent),
-  _inputCondition(PiiWaitCondition::NoQueue), _priority(InheritPriority),
+  _priority(InheritPriority),
   _pStateMutex(parent->stateLock())
 {
   // Set state to stopped once the thread finishes execution
@@ -51,7 +51,7 @@ void PiiThreadedProcessor::check(bool reset)
 {
   // If the processor is being reset, we clear any pending signals.
   if (reset)
-    _inputCondition.wakeAll();
+    _inputCondition.unparkAll();
 
   _bMustReconfigure = false;
   _strPropertySetName = QString();
@@ -75,7 +75,7 @@ void PiiThreadedProcessor::start()
   else if (_pParentOp->state() == PiiOperation::Paused)
     {
       // Wake it up.
-      _inputCondition.wakeOne();
+      _inputCondition.unpark();
     }
 }
 
@@ -89,7 +89,7 @@ void PiiThreadedProcessor::interrupt()
 
   // This ensures the signal is handled even if runner is waiting for
   // input.
-  _inputCondition.wakeOne();
+  _inputCondition.unpark();
 }
 
 void PiiThreadedProcessor::pause()
@@ -124,14 +124,14 @@ bool PiiThreadedProcessor::wait(unsigned long time)
 bool PiiThreadedProcessor::tryToReceive(PiiAbstractInputSocket* sender,
                                         const PiiVariant& object) throw ()
 {
-  QMutexLocker inputLock(_pStateMutex);
-  PiiInputSocket* pInput = static_cast<PiiInputSocket*>(sender);
-  if (pInput->canReceive())
+  // The input queue is safe to use without the state lock. The
+  // runner thread may see the object either in this or in the next
+  // round of processing.
+  if (static_cast<PiiInputSocket*>(sender)->tryReceive(object))
     {
-      pInput->receive(object);
       // Send a signal to start the next round of processing and
       // return immediately.
-      _inputCondition.wakeOne();
+      _inputCondition.unpark();
       return true;
     }
 
@@ -140,15 +140,14 @@ bool PiiThreadedProcessor::tryToReceive(PiiAbstractInputSocket* sender,
 
 void PiiThreadedProcessor::prepareAndProcess()
 {
-  // This lock ensures that no input socket is able to take in objects
-  // for a while. They are thus unable to signal objectAccepted(),
-  // which means that _inputCondition.wakeOne() won't be called. Since
-  // we are going to process any object received so far, it is safe to
-  // reset the input condition.
+  // Input sockets receive objects without holding the state lock.
+  // Any object published before the permit is cleared will be seen by
+  // the flow controller. Objects published after it set the permit
+  // again, which makes the next wait return immediately.
   QMutexLocker lock(_pStateMutex);
   while (true)
     {
-      _inputCondition.wakeAll();
+      _inputCondition.unparkAll();
       //qDebug("%s: calling flow controller", qPrintable(objectName()));
       PiiFlowController::FlowState state = _pFlowController->prepareProcess(); // may throw
       //qDebug("%s: flow controller returned %d", qPrintable(objectName()), int(state));
@@ -200,7 +199,7 @@ void PiiThreadedProcessor::run()
           // received.
           if (_pFlowController != 0)
             {
-              _inputCondition.wait();
+              _inputCondition.park();
               // If the waiting was terminated by interrupt(), kill
               // the thread.
               if (_pParentOp->state() == PiiOperation::Interrupted)
@@ -240,7 +239,7 @@ void PiiThreadedProcessor::run()
               _pParentOp->setState(PiiOperation::Paused);
               _pStateMutex->unlock();
               // Suspend the thread.
-              _inputCondition.wait();
+              _inputCondition.park();
 
               // Suspension finished. Now change state back to
               // running. But only if we haven't been interrupted...
@@ -256,7 +255,7 @@ void PiiThreadedProcessor::run()
                   else
                     // Ensure that input queues will be emptied if
                     // something was there before pause.
-                    _inputCondition.wakeOne();
+                    _inputCondition.unpark();
 
                   _pParentOp->setState(PiiOperation::Running);
                 }
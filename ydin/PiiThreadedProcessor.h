@@ -17,6 +17,7 @@
 #define _PIITHREADEDPROCESSOR_H
 
 #include "PiiOperationProcessor.h"
+#include <PiiParker.h>
 #include <QThread>
 
 class QMutex;
@@ -78,8 +79,9 @@ public:
 
   /**
    * Invoked when a new object appears on any input socket. This
-   * function just signals the runner thread that new data is
-   * available.
+   * function puts the object into the lock-free input queue and
+   * signals the runner thread that new data is available. No locks
+   * are taken unless the runner thread is sleeping.
    */
   bool tryToReceive(PiiAbstractInputSocket* sender, const PiiVariant& object) throw ();
 
@@ -97,7 +99,7 @@ private slots:
 private:
   inline void prepareAndProcess();
 
-  PiiWaitCondition _inputCondition;
+  PiiParker _inputCondition;
   Priority _priority;
   QMutex *_pStateMutex;
   bool _bMustReconfigure;
@@ -0,0 +1,272 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#include "PiiTraceRecorder.h"
+#include "PiiOperation.h"
+#include "PiiSocket.h"
+
+#include <QThread>
+#include <QThreadStorage>
+#include <QMutex>
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <QFile>
+
+PiiAtomicInt PiiTraceRecorder::_iEnabled;
+
+static const char* categoryName(PiiTraceRecorder::Category category)
+{
+  static const char* aNames[] = { "process", "emit", "sync", "reconfigure" };
+  return aNames[category];
+}
+
+static QByteArray jsonString(const QString& str)
+{
+  QByteArray aResult("\"");
+  const QByteArray aUtf8(str.toUtf8());
+  for (int i=0; i<aUtf8.size(); ++i)
+    {
+      const char c = aUtf8[i];
+      if (c == '"' || c == '\\')
+        aResult += '\\';
+      if (uchar(c) < 0x20)
+        aResult += ' ';
+      else
+        aResult += c;
+    }
+  aResult += '"';
+  return aResult;
+}
+
+/* Events recorded by a single thread. Only the owner thread writes
+ * to the buffer, and only while iBusy is set. Readers first disable
+ * recording and then wait until iBusy is cleared.
+ */
+class PiiTraceRecorder::ThreadBuffer
+{
+public:
+  struct Event
+  {
+    qint64 lStart, lDuration;
+    int iName, iCategory;
+  };
+
+  ThreadBuffer(int threadId, const QString& threadName, int capacity) :
+    iThreadId(threadId),
+    strThreadName(threadName),
+    iNext(0), iCount(0)
+  {
+    reset(capacity);
+  }
+
+  void reset(int capacity)
+  {
+    vecEvents.fill(Event(), capacity);
+    iNext = iCount = 0;
+    hashNames.clear();
+    lstNames.clear();
+  }
+
+  void append(Category category, const QObject* source, qint64 start, qint64 duration)
+  {
+    int iName = hashNames.value(source, -1);
+    if (iName == -1)
+      {
+        iName = lstNames.size();
+        lstNames << jsonString(nameOf(source));
+        hashNames.insert(source, iName);
+      }
+    Event& event = vecEvents[iNext];
+    event.lStart = start;
+    event.lDuration = duration;
+    event.iName = iName;
+    event.iCategory = category;
+    if (++iNext == vecEvents.size())
+      iNext = 0;
+    if (iCount < vecEvents.size())
+      ++iCount;
+  }
+
+  void waitIdle()
+  {
+    while (iBusy.loadAcquire() != 0)
+      QThread::yieldCurrentThread();
+  }
+
+  static QString nameOf(const QObject* source)
+  {
+    if (const PiiOperation* pOperation = qobject_cast<const PiiOperation*>(source))
+      return pOperation->fullName();
+    if (const PiiSocket* pSocket = qobject_cast<const PiiSocket*>(source))
+      return pSocket->fullName();
+    return source->objectName();
+  }
+
+  const int iThreadId;
+  const QString strThreadName;
+  PiiAtomicInt iBusy, iFinished;
+  QVector<Event> vecEvents;
+  int iNext, iCount;
+  QHash<const QObject*, int> hashNames;
+  QList<QByteArray> lstNames;
+};
+
+class PiiTraceRecorder::Data
+{
+public:
+  Data() : iEventsPerThread(65536), iNextThreadId(1) {}
+
+  // Disables recording and waits until no thread is writing.
+  // Returns the previous state. Must be called with mutex held.
+  bool pause()
+  {
+    bool bWasEnabled = _iEnabled.fetchAndStore(0) != 0;
+    for (int i=0; i<lstBuffers.size(); ++i)
+      lstBuffers[i]->waitIdle();
+    return bWasEnabled;
+  }
+
+  QMutex mutex;
+  QList<ThreadBuffer*> lstBuffers;
+  int iEventsPerThread;
+  int iNextThreadId;
+};
+
+/* Marks the buffer finished when the owner thread exits. The buffer
+ * itself is retained so that the events can be dumped afterwards.
+ */
+class PiiTraceRecorder::BufferHolder
+{
+public:
+  BufferHolder(ThreadBuffer* buffer) : pBuffer(buffer) {}
+  ~BufferHolder() { pBuffer->iFinished.store(1); }
+
+  ThreadBuffer* pBuffer;
+};
+
+PiiTraceRecorder::Data* PiiTraceRecorder::data()
+{
+  // Never deleted; threads may record events during static
+  // destruction.
+  static Data* pData = new Data;
+  return pData;
+}
+
+PiiTraceRecorder::ThreadBuffer* PiiTraceRecorder::currentBuffer()
+{
+  static QThreadStorage<BufferHolder*> buffers;
+  if (!buffers.hasLocalData())
+    {
+      Data* d = data();
+      QMutexLocker lock(&d->mutex);
+      QString strThreadName = QThread::currentThread()->objectName();
+      if (strThreadName.isEmpty())
+        strThreadName = QString("Thread %1").arg(d->iNextThreadId);
+      ThreadBuffer* pBuffer = new ThreadBuffer(d->iNextThreadId++, strThreadName, d->iEventsPerThread);
+      d->lstBuffers << pBuffer;
+      buffers.setLocalData(new BufferHolder(pBuffer));
+    }
+  return buffers.localData()->pBuffer;
+}
+
+void PiiTraceRecorder::start(int eventsPerThread)
+{
+  Data* d = data();
+  QMutexLocker lock(&d->mutex);
+  d->pause();
+  d->iEventsPerThread = qMax(eventsPerThread, 1);
+  for (int i=d->lstBuffers.size(); i--; )
+    {
+      if (d->lstBuffers[i]->iFinished.load() != 0)
+        delete d->lstBuffers.takeAt(i);
+      else
+        d->lstBuffers[i]->reset(d->iEventsPerThread);
+    }
+  _iEnabled.fetchAndStore(1);
+}
+
+void PiiTraceRecorder::stop()
+{
+  Data* d = data();
+  QMutexLocker lock(&d->mutex);
+  d->pause();
+}
+
+void PiiTraceRecorder::record(Category category, const QObject* source, qint64 start, qint64 duration)
+{
+  if (!isEnabled())
+    return;
+  ThreadBuffer* pBuffer = currentBuffer();
+  // Readers disable recording before checking the busy flag. Since
+  // both flags are changed with ordered operations, either the
+  // reader sees the flag set or we see recording disabled.
+  pBuffer->iBusy.fetchAndStore(1);
+  if (isEnabled())
+    pBuffer->append(category, source, start, duration);
+  pBuffer->iBusy.fetchAndStore(0);
+}
+
+QByteArray PiiTraceRecorder::toChromeTrace()
+{
+  Data* d = data();
+  QMutexLocker lock(&d->mutex);
+  // Recording is paused while the buffers are read.
+  bool bWasEnabled = d->pause();
+
+  QByteArray aResult("{\"traceEvents\":[");
+  bool bFirst = true;
+  for (int i=0; i<d->lstBuffers.size(); ++i)
+    {
+      ThreadBuffer* pBuffer = d->lstBuffers[i];
+      if (pBuffer->iCount == 0)
+        continue;
+      const QByteArray aThread = ",\"pid\":1,\"tid\":" + QByteArray::number(pBuffer->iThreadId);
+      if (!bFirst)
+        aResult += ",\n";
+      bFirst = false;
+      aResult += "{\"name\":\"thread_name\",\"ph\":\"M\"" + aThread +
+        ",\"args\":{\"name\":" + jsonString(pBuffer->strThreadName) + "}}";
+
+      // Oldest events first
+      const int iCapacity = pBuffer->vecEvents.size();
+      int iIndex = (pBuffer->iNext - pBuffer->iCount + iCapacity) % iCapacity;
+      for (int j=0; j<pBuffer->iCount; ++j)
+        {
+          const ThreadBuffer::Event& event = pBuffer->vecEvents[iIndex];
+          aResult += ",\n{\"name\":" + pBuffer->lstNames[event.iName] +
+            ",\"cat\":\"" + categoryName(Category(event.iCategory)) +
+            "\",\"ph\":\"X\",\"ts\":" + QByteArray::number(event.lStart) +
+            ",\"dur\":" + QByteArray::number(event.lDuration) + aThread + "}";
+          if (++iIndex == iCapacity)
+            iIndex = 0;
+        }
+    }
+  aResult += "],\"displayTimeUnit\":\"ms\"}\n";
+
+  if (bWasEnabled)
+    _iEnabled.fetchAndStore(1);
+  return aResult;
+}
+
+bool PiiTraceRecorder::save(const QString& fileName)
+{
+  QFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    return false;
+  const QByteArray aTrace(toChromeTrace());
+  return file.write(aTrace) == aTrace.size();
+}
@@ -0,0 +1,160 @@
+/* This file is part of Into.
+ * Copyright (C) Intopii 2013.
+ * All rights reserved.
+ *
+ * Licensees holding a commercial Into license may use this file in
+ * accordance with the commercial license agreement. Please see
+ * LICENSE.commercial for commercial licensing terms.
+ *
+ * Alternatively, this file may be used under the terms of the GNU
+ * Affero General Public License version 3 as published by the Free
+ * Software Foundation. In addition, Intopii gives you special rights
+ * to use Into as a part of open source software projects. Please
+ * refer to LICENSE.AGPL3 for details.
+ */
+
+
+#ifndef _PIITRACERECORDER_H
+#define _PIITRACERECORDER_H
+
+#include "PiiYdin.h"
+#include "PiiOperationStatistics.h"
+
+#include <QByteArray>
+
+class QObject;
+
+/**
+ * A timeline recorder for debugging pipeline stalls. When tracing is
+ * enabled, operations record the time they spend in process(),
+ * waiting for receivers in output sockets, sending synchronization
+ * events and applying property sets. Each thread writes its events
+ * into a ring buffer of its own without taking locks. The recorded
+ * timeline can be written in the [Chrome trace event
+ * format](https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU)
+ * that can be viewed with `chrome://tracing` or the Perfetto UI.
+ * Each thread is shown as a separate track, and each event is
+ * labeled with the full name of the operation or socket that
+ * produced it.
+ *
+ * Tracing is disabled by default. When disabled, each trace point
+ * costs a single memory read.
+ *
+ * ~~~(c++)
+ * PiiTraceRecorder::start();
+ * engine.execute();
+ * // ...
+ * engine.wait(PiiOperation::Stopped);
+ * PiiTraceRecorder::stop();
+ * PiiTraceRecorder::save("pipeline.json");
+ * ~~~
+ *
+ * @internal
+ */
+class PII_YDIN_EXPORT PiiTraceRecorder
+{
+public:
+  /**
+   * Categories of recorded events.
+   */
+  enum Category
+    {
+      /// Time spent in PiiDefaultOperation::process().
+      Process,
+      /// Time an output socket waits for receivers to accept an
+      /// object, or for other threads to finish their emissions.
+      Emit,
+      /// Time spent in PiiFlowController::sendSyncEvents().
+      Sync,
+      /// Time spent in PiiOperation::applyPropertySet().
+      Reconfigure
+    };
+
+  /**
+   * Records the time between its construction and destruction as a
+   * single event. Nothing will be recorded if tracing was disabled
+   * at construction time.
+   *
+   * ~~~(c++)
+   * void MyClass::func()
+   * {
+   *   PiiTraceRecorder::Scope scope(PiiTraceRecorder::Process, this);
+   *   // ...
+   * }
+   * ~~~
+   */
+  class Scope
+  {
+  public:
+    Scope(Category category, const QObject* source) :
+      _category(category),
+      _pSource(isEnabled() ? source : 0),
+      _lStart(_pSource != 0 ? PiiOperationStatistics::clock() : 0)
+    {}
+
+    ~Scope()
+    {
+      if (_pSource != 0)
+        record(_category, _pSource, _lStart, PiiOperationStatistics::clock() - _lStart);
+    }
+
+  private:
+    Category _category;
+    const QObject* _pSource;
+    qint64 _lStart;
+
+    PII_DISABLE_COPY(Scope);
+  };
+
+  /**
+   * Discards all previously recorded events and starts recording.
+   * Each thread will store at most *eventsPerThread* events. Once
+   * the limit is reached, new events will overwrite the oldest ones.
+   */
+  static void start(int eventsPerThread = 65536);
+
+  /**
+   * Stops recording. The recorded events will be retained until
+   * tracing is started again.
+   */
+  static void stop();
+
+  /**
+   * Returns `true` if events are currently being recorded and
+   * `false` otherwise.
+   */
+  static inline bool isEnabled() { return _iEnabled.load() != 0; }
+
+  /**
+   * Records an event that started at *start* and lasted *duration*
+   * microseconds. Both times are measured with
+   * PiiOperationStatistics::clock(). The event is labeled with the
+   * full name of *source*, which is usually an operation or a
+   * socket. Does nothing if tracing is disabled.
+   */
+  static void record(Category category, const QObject* source, qint64 start, qint64 duration);
+
+  /**
+   * Returns all recorded events as a JSON document in the Chrome
+   * trace event format. If tracing is enabled, events recorded
+   * concurrently may or may not be included.
+   */
+  static QByteArray toChromeTrace();
+
+  /**
+   * Writes the result of [toChromeTrace()] to *fileName*. Returns
+   * `true` on success and `false` if the file could not be written.
+   */
+  static bool save(const QString& fileName);
+
+private:
+  class ThreadBuffer;
+  class BufferHolder;
+  class Data;
+  static Data* data();
+  static ThreadBuffer* currentBuffer();
+
+  static PiiAtomicInt _iEnabled;
+};
+
+#endif //_PIITRACERECORDER_H
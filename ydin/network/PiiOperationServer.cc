@@ -22,6 +22,7 @@
 #include <PiiSerializationUtil.h>
 #include <PiiGenericTextInputArchive.h>
 #include <PiiGenericTextOutputArchive.h>
+#include <PiiOperationStatistics.h>
 
 PiiOperationServer::Data::Data(PiiOperation* operation) :
   PiiQObjectServer::Data(operation,
@@ -52,6 +53,7 @@ PiiOperationServer::PiiOperationServer(PiiOperation* operation) :
   addFunction("reconfigure", operation, &PiiOperation::reconfigure);
 
   addFunction("connectInput", this, &PiiOperationServer::connectInput);
+  addFunction("statistics", this, &PiiOperationServer::statistics);
 }
 
 QStringList PiiOperationServer::listRoot() const
@@ -125,6 +127,11 @@ void PiiOperationServer::connectInput(const QString& inputName)
     }
 }
 
+QVariantMap PiiOperationServer::statistics()
+{
+  return PiiOperationStatistics::collect(operation());
+}
+
 void PiiOperationServer::handleRequest(const QString& uri, PiiHttpDevice* dev,
                                        PiiHttpProtocol::TimeLimiter* controller)
 {
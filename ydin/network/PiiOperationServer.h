@@ -35,6 +35,12 @@ PII_MAP_METATYPE(PiiOperation::State, int);
  * the server. A request to these URIs returns a list of input and
  * output names, respectively.
  *
+ * The run-time statistics of the operation and all operations
+ * contained in it can be retrieved by calling the "statistics"
+ * function (GET /functions/statistics). The result is in the format
+ * returned by PiiEngine::statistics(). Statistics are collected only
+ * if enabled with PiiEngine::statisticsEnabled.
+ *
  */
 class PII_YDIN_EXPORT PiiOperationServer : public PiiQObjectServer
 {
@@ -83,6 +89,7 @@ private:
   inline PiiOperation* operation() const { return static_cast<PiiOperation*>(_d()->pObject); }
   PiiAbstractOutputSocket* findOutput(const QString& name) const;
   void connectInput(const QString& inputName);
+  QVariantMap statistics();
   void sendToInput(const QString& inputName, PiiHttpDevice* dev,
                    PiiHttpProtocol::TimeLimiter* controller);
 };